@@ -0,0 +1,104 @@
+/***************************************************************************//**
+ *   @file   bottleneck.js
+ *   @brief  Busiest acquisition stages of the Oscilloscope
+********************************************************************************
+ * Copyright 2019(c) Analog Devices, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  - Neither the name of Analog Devices, Inc. nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *  - The use of this software may or may not infringe the patent rights
+ *    of one or more patent holders.  This license does not release you
+ *    from the requirement that you obtain separate licenses from these
+ *    patent holders to use this software.
+ *  - Use of the software either in source or binary form, must be run
+ *    on or directly connected to an Analog Devices Inc. component.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ANALOG DEVICES "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, NON-INFRINGEMENT,
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL ANALOG DEVICES BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, INTELLECTUAL PROPERTY RIGHTS, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/*
+
+/*
+ * Runs the Oscilloscope with the performance monitor on, then prints the
+ * GNU Radio blocks of each device by mean work() time, the counters of
+ * the tools and how late the GUI thread served its events, as CSV lines.
+ * The block timings need [PerfCounters] on = True in the GNU Radio
+ * configuration, they read zero otherwise.
+ */
+
+var URI = "ip:127.0.0.1"
+var DURATION_MS = 5000
+
+function print_blocks(blocks)
+{
+	for (var device in blocks) {
+		var names = Object.keys(blocks[device])
+
+		names.sort(function(a, b) {
+			return blocks[device][b].work_avg_us -
+				blocks[device][a].work_avg_us
+		})
+
+		for (var i = 0; i < names.length; i++) {
+			var b = blocks[device][names[i]]
+
+			printToConsole([ "block", device, names[i],
+					 b.work_avg_us.toFixed(1),
+					 b.input_full.toFixed(2),
+					 b.output_full.toFixed(2),
+					 b.items_per_s.toFixed(0) ].join(","))
+		}
+	}
+}
+
+function main()
+{
+	if (!launcher.connect(URI)) {
+		printToConsole("Could not connect to " + URI)
+		return
+	}
+
+	launcher.performance_monitor = true
+	osc.running = true
+	msleep(DURATION_MS)
+
+	var perf = launcher.performance
+
+	osc.running = false
+	launcher.performance_monitor = false
+
+	printToConsole("block,device,name,work_avg_us,input_full,output_full,items_per_s")
+	print_blocks(perf.blocks)
+
+	for (var group in perf) {
+		if (group == "blocks")
+			continue
+		for (var name in perf[group])
+			printToConsole([ "counter", group, name,
+					 perf[group][name] ].join(","))
+	}
+
+	launcher.disconnect()
+}
+
+main()
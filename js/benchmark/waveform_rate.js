@@ -0,0 +1,221 @@
+/***************************************************************************//**
+ *   @file   waveform_rate.js
+ *   @brief  Waveform rate benchmark of the acquisition tools
+********************************************************************************
+ * Copyright 2019(c) Analog Devices, Inc.
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *  - Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  - Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in
+ *    the documentation and/or other materials provided with the
+ *    distribution.
+ *  - Neither the name of Analog Devices, Inc. nor the names of its
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ *  - The use of this software may or may not infringe the patent rights
+ *    of one or more patent holders.  This license does not release you
+ *    from the requirement that you obtain separate licenses from these
+ *    patent holders to use this software.
+ *  - Use of the software either in source or binary form, must be run
+ *    on or directly connected to an Analog Devices Inc. component.
+ *
+ * THIS SOFTWARE IS PROVIDED BY ANALOG DEVICES "AS IS" AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, NON-INFRINGEMENT,
+ * MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL ANALOG DEVICES BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, INTELLECTUAL PROPERTY RIGHTS, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*******************************************************************************/
+
+/*
+ * Runs the Oscilloscope, Spectrum Analyzer, Voltmeter and Logic Analyzer
+ * one after the other for a fixed time and reports, for each setting
+ * under test:
+ *  - the rate of frames (or DMM readings, or LA samples) per second,
+ *  - the frames dropped between the sink and the plot,
+ *  - the mean capture latency intervals and the time spent by the source
+ *    waiting for the buffer refills,
+ * as CSV lines on the console and, optionally, in a file.
+ *
+ * Run it against the M2K emulator (iio-emu, on ip:127.0.0.1 by default)
+ * to compare builds without hardware, or against a board for the real
+ * rates. Given the CSV of an earlier run as baseline, every rate that
+ * fell by more than TOLERANCE is reported as a regression.
+ */
+
+var URI = "ip:127.0.0.1"
+var DURATION_MS = 5000
+var WARMUP_MS = 1000
+var OSC_TIME_BASES = [ 0.000001, 0.00001, 0.0001, 0.001 ]
+var OUTPUT = ""		/* CSV file to write, none if empty */
+var BASELINE = ""	/* CSV file of an earlier run, none if empty */
+var TOLERANCE = 0.1
+
+var results = []
+
+function report(tool, setting, rate, dropped, latency, refill_us)
+{
+	var line = [ tool, setting, rate.toFixed(2), dropped,
+		     latency.toFixed(6), refill_us.toFixed(1) ].join(",")
+
+	results.push(line)
+	printToConsole(line)
+}
+
+function delta(before, after, key)
+{
+	if (before[key] === undefined || after[key] === undefined)
+		return 0
+	return after[key] - before[key]
+}
+
+function mean_refill(stats)
+{
+	var sum = 0
+
+	for (var i = 0; i < stats.length; i++)
+		sum += stats[i].refill_avg_us
+	return stats.length ? sum / stats.length : 0
+}
+
+function bench_oscilloscope()
+{
+	osc.channels[0].enabled = true
+	osc.channels[1].enabled = true
+
+	for (var i = 0; i < OSC_TIME_BASES.length; i++) {
+		osc.time_base = OSC_TIME_BASES[i]
+		osc.running = true
+		msleep(WARMUP_MS)
+
+		osc.clearCaptureLatency()
+		var before = osc.frame_counters
+		msleep(DURATION_MS)
+		var after = osc.frame_counters
+		var latency = osc.capture_latency
+		var stats = osc.acquisition_stats
+		osc.running = false
+
+		var displayed = delta(before, after, "displayed")
+		var dead_time = latency.trigger_wait.mean +
+			latency.rearm.mean
+
+		report("osc", OSC_TIME_BASES[i],
+		       displayed * 1000 / DURATION_MS,
+		       delta(before, after, "acquired") - displayed,
+		       dead_time, mean_refill(stats))
+	}
+}
+
+function bench_spectrum()
+{
+	spectrum.running = true
+	msleep(WARMUP_MS)
+
+	var before = spectrum.frameCounters
+	msleep(DURATION_MS)
+	var after = spectrum.frameCounters
+	var stats = spectrum.acquisitionStats
+	spectrum.running = false
+
+	var posted = delta(before, after, "posted")
+
+	report("spectrum", spectrum.resBW, posted * 1000 / DURATION_MS,
+	       delta(before, after, "acquired") - posted, 0,
+	       mean_refill(stats))
+}
+
+function bench_dmm()
+{
+	dmm.running = true
+	msleep(WARMUP_MS)
+
+	var before = dmm.readings
+	msleep(DURATION_MS)
+	var after = dmm.readings
+	dmm.running = false
+
+	report("dmm", dmm.integration_nplc,
+	       (after - before) * 1000 / DURATION_MS, 0, 0, 0)
+}
+
+function bench_logic()
+{
+	logic.run_mode = "STREAM"
+	logic.running = true
+	msleep(WARMUP_MS)
+
+	var before = logic.capture_time
+	msleep(DURATION_MS)
+	var after = logic.capture_time
+	logic.running = false
+
+	var samples = delta(before, after, "sample")
+	var elapsed = delta(before, after, "time") / 1e9
+
+	report("logic", "stream", elapsed > 0 ? samples / elapsed : 0,
+	       0, 0, 0)
+}
+
+function compare_baseline()
+{
+	var previous = {}
+	var regressions = 0
+	var lines = fileIO.readAll(BASELINE).split("\n")
+
+	for (var n = 0; n < lines.length; n++) {
+		var fields = lines[n].split(",")
+		if (fields.length > 2 && !isNaN(parseFloat(fields[2])))
+			previous[fields[0] + "," + fields[1]] =
+				parseFloat(fields[2])
+	}
+
+	for (var i = 0; i < results.length; i++) {
+		var fields = results[i].split(",")
+		var key = fields[0] + "," + fields[1]
+		var rate = parseFloat(fields[2])
+
+		if (previous[key] !== undefined &&
+				rate < previous[key] * (1 - TOLERANCE)) {
+			printToConsole("REGRESSION " + key + ": " + rate +
+				       " < " + previous[key])
+			regressions++
+		}
+	}
+
+	printToConsole(regressions + " regression(s)")
+}
+
+function main()
+{
+	if (!launcher.connect(URI)) {
+		printToConsole("Could not connect to " + URI)
+		return
+	}
+
+	launcher.reset()
+	printToConsole("tool,setting,rate,dropped,latency_s,refill_us")
+
+	bench_oscilloscope()
+	bench_spectrum()
+	bench_dmm()
+	bench_logic()
+
+	if (OUTPUT)
+		fileIO.writeToFile(results.join("\n") + "\n", OUTPUT)
+	if (BASELINE)
+		compare_baseline()
+
+	launcher.disconnect()
+}
+
+main()
@@ -16,20 +16,14 @@ function get_min_sampling_freq()
 function generate()
 {
 
-console.log("##############")
-status_window.print("#############")
 	var i=0
-	console.log(pg.get_nr_of_samples())
-	for(i=0;i<pg.get_nr_of_samples();i++)
-		pg.buffer[i] = 0;
+	// A typed array is handed over in one go, it starts all low
+	var buffer = new Uint16Array(pg.get_nr_of_samples())
 	for(i=0;i<nrOfPulses;i++)
 	{
-		for(var j=i*samplesPerPulse;j<((i*samplesPerPulse)+loPulse);j++)
-			pg.buffer[j] = 0x0000;
 		for(var j=((i*samplesPerPulse)+loPulse);(j<((i+1)*samplesPerPulse));j++)
-			pg.buffer[j] = 0xffff;
+			buffer[j] = 0xffff;
 	}
-	//pg.buffersize = nrOfPulses*samplesPerPulse
-	pg.buffersize = pg.get_nr_of_samples()
+	return buffer
 }
 
@@ -50,6 +50,7 @@
 #include <iostream>
 
 #include "ConstellationDisplayPlot.h"
+#include "persistence_map.h"
 
 using namespace adiscope;
 
@@ -144,6 +145,8 @@ ConstellationDisplayPlot::ConstellationDisplayPlot(int nplots, QWidget* parent)
     setLineStyle(i, Qt::NoPen);
     setLineMarker(i, QwtSymbol::Ellipse);
   }
+
+  d_density_items.resize(d_nplots, nullptr);
 }
 
 ConstellationDisplayPlot::~ConstellationDisplayPlot()
@@ -189,9 +192,41 @@ ConstellationDisplayPlot::set_pen_size(int size)
   }
 }
 
+void
+ConstellationDisplayPlot::setDensity(int which,
+				     const std::shared_ptr<PersistenceMap> &map)
+{
+  if(which < 0 || which >= d_nplots)
+    return;
+
+  if(d_density_items[which]) {
+    d_density_items[which]->detach();
+    delete d_density_items[which];
+    d_density_items[which] = nullptr;
+  }
+
+  if(map) {
+    PersistencePlotItem *item = new PersistencePlotItem(map,
+		    d_plot_curve[which]->pen().color());
+    item->setAxes(d_plot_curve[which]->xAxis(), d_plot_curve[which]->yAxis());
+    item->attach(this);
+    d_density_items[which] = item;
+  }
+
+  d_plot_curve[which]->setVisible(!map);
+  replot();
+}
+
 void
 ConstellationDisplayPlot::replot()
 {
+  // The x range of a density map may have changed since the last time
+  for(PersistencePlotItem *item : d_density_items) {
+    if(item)
+      item->setTimeRange(item->map()->columnRangeMin(),
+			 item->map()->columnRangeMax());
+  }
+
   QwtPlot::replot();
 }
 
@@ -267,6 +302,9 @@ void
 ConstellationDisplayPlot::newData(const QEvent* updateEvent)
 {
   ConstUpdateEvent *tevent = (ConstUpdateEvent*)updateEvent;
+  if(!tevent->fetchFrame())
+    return;
+
   const std::vector<double*> realDataPoints = tevent->getRealPoints();
   const std::vector<double*> imagDataPoints = tevent->getImagPoints();
   const uint64_t numDataPoints = tevent->getNumDataPoints();
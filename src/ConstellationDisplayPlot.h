@@ -44,12 +44,16 @@
 
 #include <stdint.h>
 #include <cstdio>
+#include <memory>
 #include <vector>
 
 #include "DisplayPlot.h"
 #include "spectrumUpdateEvents.h"
 
 namespace adiscope {
+class PersistenceMap;
+class PersistencePlotItem;
+
 /*!
  * \brief QWidget for displaying constellaton (I&Q) plots.
  * \ingroup qtgui_blk
@@ -81,6 +85,10 @@ public:
 		double ymin, double ymax);
   void set_pen_size(int size);
 
+  /* Draws a density map instead of the points of a plot, over the
+   * column and value ranges of the map (nullptr to get the points back) */
+  void setDensity(int which, const std::shared_ptr<PersistenceMap> &map);
+
 public Q_SLOTS:
   void setAutoScale(bool state);
 
@@ -96,6 +104,8 @@ private:
   std::vector<double*> d_imag_data;
 
   int64_t d_pen_size;
+
+  std::vector<PersistencePlotItem *> d_density_items;
 };
 } //adiscope
 
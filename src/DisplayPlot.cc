@@ -47,6 +47,9 @@
 #include <qwt_plot_zoomer.h>
 #include <qwt_legend.h>
 #include <qwt_plot_layout.h>
+#ifdef OPENGL_CANVAS
+#include <qwt_plot_opengl_canvas.h>
+#endif
 
 #include <QColor>
 #include <cmath>
@@ -504,9 +507,33 @@ void PlotAxisConfiguration::setMouseGesturesEnabled(bool en)
  * DisplayPlot class
  */
 
+bool DisplayPlot::d_opengl_canvas = false;
+
+void DisplayPlot::setOpenGLCanvasEnabled(bool enabled)
+{
+#ifdef OPENGL_CANVAS
+  d_opengl_canvas = enabled;
+#endif
+}
+
+bool DisplayPlot::openGLCanvasEnabled()
+{
+  return d_opengl_canvas;
+}
+
+void DisplayPlot::setupCanvas(QwtPlot *plot)
+{
+#ifdef OPENGL_CANVAS
+  if (d_opengl_canvas) {
+    plot->setCanvas(new QwtPlotOpenGLCanvas(plot));
+  }
+#endif
+}
+
 DisplayPlot::DisplayPlot(int nplots, QWidget* parent,
 			 unsigned int xNumDivs, unsigned int yNumDivs)
   : PrintablePlot(parent), d_nplots(nplots), d_stop(false),
+    d_display_suspended(false), d_replot_pending(false),
     d_coloredLabels(false), d_mouseGesturesEnabled(false),
     d_displayScale(1), d_xAxisNumDiv(1),
     d_yAxisNumDiv(1)
@@ -524,6 +551,9 @@ DisplayPlot::DisplayPlot(int nplots, QWidget* parent,
   qRegisterMetaType<QColorList>("QColorList");
   resize(parent->width(), parent->height());
 
+  // Before anything gets installed on the canvas
+  setupCanvas(this);
+
   d_autoscale_state = false;
 
   d_yAxisUnit = "";
@@ -601,7 +631,10 @@ DisplayPlot::DisplayPlot(int nplots, QWidget* parent,
   this->plotLayout()->setCanvasMargin(0, QwtPlot::xTop);
   this->plotLayout()->setCanvasMargin(0, QwtPlot::xBottom);
 
-  ((QFrame*) canvas())->setLineWidth(0);
+  QFrame *canvasFrame = qobject_cast<QFrame *>(canvas());
+  if (canvasFrame) {
+    canvasFrame->setLineWidth(0);
+  }
 
   // Avoid jumping when labels with more/less digits
   // appear/disappear when scrolling vertically
@@ -997,6 +1030,17 @@ DisplayPlot::setStop(bool on)
   d_stop = on;
 }
 
+void
+DisplayPlot::setDisplaySuspended(bool suspended)
+{
+  d_display_suspended = suspended;
+
+  if(!suspended && d_replot_pending) {
+    d_replot_pending = false;
+    replot();
+  }
+}
+
 void
 DisplayPlot::resizeSlot( QSize *s )
 {
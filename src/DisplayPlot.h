@@ -291,6 +291,12 @@ public:
 	      unsigned int yNumDivs = 10);
   virtual ~DisplayPlot();
 
+  // Plots created after enabling this paint through OpenGL instead of
+  // the raster canvas. Only available when built with OPENGL_CANVAS.
+  static void setOpenGLCanvasEnabled(bool enabled);
+  static bool openGLCanvasEnabled();
+  static void setupCanvas(QwtPlot *plot);
+
   virtual void replot() = 0;
 
   const QColor getLineColor1 () const;
@@ -488,6 +494,11 @@ public Q_SLOTS:
 
   void setStop(bool on);
 
+  // While suspended, the new data is still taken in (the measurements
+  // read it) but not drawn; the plot gets drawn once on resuming, if
+  // anything came meanwhile. For plots that can't be seen.
+  void setDisplaySuspended(bool suspended);
+
   void resizeSlot(QSize *s);
 
   // Because of the preprocessing of slots in QT, these are not
@@ -532,6 +543,8 @@ protected:
   int d_nplots;
   std::vector<QwtPlotCurve*> d_plot_curve;
 
+  static bool d_opengl_canvas;
+
   QString d_yAxisUnit;
   QString d_xAxisUnit;
 
@@ -549,6 +562,8 @@ protected:
   int64_t d_numPoints;
 
   bool d_stop;
+  bool d_display_suspended;
+  bool d_replot_pending;
 
   double d_displayScale;
 
@@ -26,10 +26,18 @@
 #include "marker_controller.h"
 #include "limitedplotzoomer.h"
 #include "osc_scale_engine.h"
+#include "logging_categories.h"
+#include "memory_budget.hpp"
 
 #include <qwt_symbol.h>
+#include <volk/volk.h>
 #include <boost/make_shared.hpp>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
 using namespace adiscope;
 
 class FftDisplayZoomer: public LimitedPlotZoomer
@@ -70,6 +78,7 @@ FftDisplayPlot::FftDisplayPlot(int nplots, QWidget *parent) :
 	d_stop_frequency(1000),
 	d_sampl_rate(1),
 	d_preset_sampl_rate(d_sampl_rate),
+	d_preset_start_frequency(0),
 	d_presetMagType(MagnitudeType::DBFS),
 	d_mrkCtrl(nullptr),
 	d_emitNewMkrData(true),
@@ -327,7 +336,7 @@ void FftDisplayPlot::useLogFreq(bool use_log_freq)
 	replot();
 }
 
-void FftDisplayPlot::plotData(const std::vector<double *> &pts,
+void FftDisplayPlot::plotData(const std::vector<float *> &pts,
 		uint64_t num_points)
 {
 	uint64_t halfNumPoints = num_points / 2;
@@ -336,10 +345,11 @@ void FftDisplayPlot::plotData(const std::vector<double *> &pts,
 	bool magTypeChanged = false;
 
 	// Update sample rate if required
-	if (d_sampl_rate != d_preset_sampl_rate) {
+	if (d_sampl_rate != d_preset_sampl_rate ||
+			d_start_frequency != d_preset_start_frequency) {
 		d_sampl_rate = d_preset_sampl_rate;
-		d_start_frequency = 0;
-		d_stop_frequency = d_sampl_rate / 2;
+		d_start_frequency = d_preset_start_frequency;
+		d_stop_frequency = d_start_frequency + d_sampl_rate / 2;
 		samplRateChanged = true;
 
 		Q_EMIT sampleRateUpdated(d_sampl_rate);
@@ -394,14 +404,15 @@ void FftDisplayPlot::plotData(const std::vector<double *> &pts,
 
 			uint h = d_ch_avg_obj[i]->history();
 			d_ch_avg_obj[i] = getNewAvgObject(
-				d_ch_average_type[i], halfNumPoints, h);
+				d_ch_average_type[i], halfNumPoints, h,
+				d_ch_avg_obj[i]);
 		}
 	}
 
 	// We store the received data before touching it
 	for (unsigned int i = 0; i < d_nplots; i++) {
-		memcpy(y_original_data[i], pts[i],
-				halfNumPoints * sizeof(double));
+		volk_32f_convert_64f(y_original_data[i], pts[i],
+				halfNumPoints);
 	}
 
 	// When the magnitude type changes, we reset the data that is
@@ -440,6 +451,8 @@ void FftDisplayPlot::plotData(const std::vector<double *> &pts,
 
 				if (marker.data->x > d_stop_frequency) {
 					marker.data->bin = d_numPoints - 1;
+				} else if (marker.data->x < d_start_frequency) {
+					marker.data->bin = 0;
 				} else {
 					marker.data->bin = posAtFrequency(
 						marker.data->x);
@@ -453,7 +466,11 @@ void FftDisplayPlot::plotData(const std::vector<double *> &pts,
 	detectMarkers();
 
 	_editFirstPoint();
-	replot();
+	if (d_display_suspended) {
+		d_replot_pending = true;
+	} else {
+		replot();
+	}
 
 	Q_EMIT newData();
 }
@@ -471,6 +488,39 @@ void FftDisplayPlot::_editFirstPoint()
 
 }
 
+/*
+ * log2(x) without the libm call, so the dB conversion loop vectorizes.
+ * The mantissa is brought into [sqrt(2)/2, sqrt(2)) and its log taken
+ * from the atanh series, whose truncation error stays under 1e-9, far
+ * below what a trace can show. Zero and negative inputs give -inf
+ * like log10() did.
+ */
+static inline double fastLog2(double x)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &x, sizeof(bits));
+
+	int64_t e = (int64_t)((bits >> 52) & 0x7ff) - 1023;
+	bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+
+	double m;
+	std::memcpy(&m, &bits, sizeof(m));
+
+	if (m > M_SQRT2) {
+		m *= 0.5;
+		e++;
+	}
+
+	double t = (m - 1) / (m + 1);
+	double t2 = t * t;
+	double ln = 2 * t * (1 + t2 * (1.0 / 3 + t2 * (1.0 / 5 +
+		t2 * (1.0 / 7 + t2 * (1.0 / 9 + t2 * (1.0 / 11))))));
+
+	double r = e + ln * M_LOG2E;
+
+	return (x > 0) ? r : -INFINITY;
+}
+
 void FftDisplayPlot::averageDataAndComputeMagnitude(std::vector<double *>
 	in_data, std::vector<double *> out_data, uint64_t nb_points)
 {
@@ -494,35 +544,48 @@ void FftDisplayPlot::averageDataAndComputeMagnitude(std::vector<double *>
 			break;
 		}
 
-		for (int s = 0; s < nb_points; s++) {
-			//dB Full-Scale
-			switch (d_magType) {
-			case DBFS:
-				out_data[i][s] = 10 * log10((source[i][s] /
-					(2048 * 2048)) /
-					(nb_points * nb_points));
-				break;
-			case DBV:
-				out_data[i][s] = 10 * log10(source[i][s]) +
-					20 * log10(y_scale_factor[i]) -
-					20 * log10(nb_points) -
-					20 * log10(sqrt(2));
-				break;
-			case DBU:
-				out_data[i][s] = 10 * log10(source[i][s]) +
-					20 * log10(y_scale_factor[i]) -
-					20 * log10(nb_points) -
-					20 * log10(sqrt(2) * 0.77459667);
-				break;
-			case VPEAK:
-				out_data[i][s] = sqrt(source[i][s]) *
-					y_scale_factor[i] / nb_points;
-				break;
-			case VRMS:
-				out_data[i][s] = sqrt(source[i][s]) *
-					y_scale_factor[i] / sqrt(2) / nb_points;
-				break;
-			};
+		// The magnitude type and the channel scale only change a
+		// constant, so each channel is converted in one pass
+		double offset = 0;
+		double gain = 1;
+		bool log_scale = true;
+
+		switch (d_magType) {
+		case DBFS: //dB Full-Scale
+			offset = -20 * log10(2048) - 20 * log10(nb_points);
+			break;
+		case DBV:
+			offset = 20 * log10(y_scale_factor[i]) -
+				20 * log10(nb_points) - 20 * log10(sqrt(2));
+			break;
+		case DBU:
+			offset = 20 * log10(y_scale_factor[i]) -
+				20 * log10(nb_points) -
+				20 * log10(sqrt(2) * 0.77459667);
+			break;
+		case VPEAK:
+			gain = y_scale_factor[i] / nb_points;
+			log_scale = false;
+			break;
+		case VRMS:
+			gain = y_scale_factor[i] / sqrt(2) / nb_points;
+			log_scale = false;
+			break;
+		};
+
+		const double *src = source[i];
+		double *dst = out_data[i];
+
+		if (log_scale) {
+			const double db_per_octave = 10 * log10(2);
+
+			for (uint64_t s = 0; s < nb_points; s++) {
+				dst[s] = db_per_octave * fastLog2(src[s]) + offset;
+			}
+		} else {
+			for (uint64_t s = 0; s < nb_points; s++) {
+				dst[s] = sqrt(src[s]) * gain;
+			}
 		}
 
 		if (needs_dB_avg) {
@@ -566,6 +629,20 @@ int64_t FftDisplayPlot::posAtFrequency(double freq, int chIdx) const
 	return pos;
 }
 
+const double *FftDisplayPlot::channelData(uint chIdx) const
+{
+	if (chIdx >= d_nplots) {
+		return nullptr;
+	}
+
+	return y_data[chIdx];
+}
+
+uint64_t FftDisplayPlot::numPoints() const
+{
+	return d_numPoints;
+}
+
 void FftDisplayPlot::customEvent(QEvent *e)
 {
 	if (e->type() == TimeUpdateEvent::Type()) {
@@ -588,6 +665,7 @@ void FftDisplayPlot::setSampleRate(double sr, double units,
 	d_stop_frequency = sr / 2;
 	d_sampl_rate = sr;
 	d_preset_sampl_rate = sr;
+	d_preset_start_frequency = 0;
 
 	_resetXAxisPoints();
 }
@@ -602,6 +680,11 @@ void FftDisplayPlot::presetSampleRate(double sr)
 	d_preset_sampl_rate = sr;
 }
 
+void FftDisplayPlot::presetStartFrequency(double start)
+{
+	d_preset_start_frequency = start;
+}
+
 FftDisplayPlot::AverageType FftDisplayPlot::averageType(uint chIdx) const
 {
 	if (chIdx < d_ch_average_type.size())
@@ -629,7 +712,8 @@ void FftDisplayPlot::setAverage(uint chIdx, enum AverageType avg_type,
 	}
 
 	d_ch_average_type[chIdx] = avg_type;
-	d_ch_avg_obj[chIdx] = getNewAvgObject(avg_type, d_numPoints, history);
+	d_ch_avg_obj[chIdx] = getNewAvgObject(avg_type, d_numPoints, history,
+		d_ch_avg_obj[chIdx]);
 }
 
 void FftDisplayPlot::resetAverageHistory()
@@ -639,9 +723,44 @@ void FftDisplayPlot::resetAverageHistory()
 			d_ch_avg_obj[i]->reset();
 }
 
-FftDisplayPlot::average_sptr FftDisplayPlot::getNewAvgObject(
-	enum AverageType avg_type, uint data_width, uint history)
+size_t FftDisplayPlot::averageMemory() const
 {
+	size_t bytes = 0;
+
+	for (const average_sptr& avg : d_ch_avg_obj)
+		if (avg)
+			bytes += avg->memoryBytes();
+
+	return bytes;
+}
+
+FftDisplayPlot::average_sptr FftDisplayPlot::getNewAvgObject(
+	enum AverageType avg_type, uint data_width, uint history,
+	const average_sptr& replaced)
+{
+	// The types keeping every frame of the history get a shorter one
+	// when it doesn't fit in the memory budget
+	const bool keeps_frames = avg_type == PEAK_HOLD ||
+		avg_type == MIN_HOLD || avg_type == LINEAR_RMS ||
+		avg_type == LINEAR_DB;
+
+	if (keeps_frames && history > 1) {
+		MemoryBudget *budget = MemoryBudget::instance();
+		const size_t frame = (size_t)data_width *
+			(sizeof(double) + sizeof(unsigned int));
+		const size_t released = replaced ? replaced->memoryBytes() : 0;
+		const size_t needed = frame * history;
+
+		if (needed > released && !budget->reserve(needed - released)) {
+			size_t fits = (budget->available() + released) / frame;
+
+			history = std::max<size_t>(1, std::min<size_t>(history,
+								      fits));
+			CAT_DEBUG(CAT_SPECTRUM_ANALYZER) << "Averaging history"
+				<< "cut to" << history << "by the memory budget";
+		}
+	}
+
 	switch (avg_type) {
 		case SAMPLE:
 			return nullptr;
@@ -698,8 +817,6 @@ void FftDisplayPlot::findPeaks(int chn)
 	QList<std::shared_ptr<struct marker_data>>& markers = d_peaks[chn];
 	QList<std::shared_ptr<struct marker_data>>& f_sort_mrks = d_freq_asc_sorted_peaks[chn];
 	int marker_count = markers.size();
-	int maxX[marker_count + 1];
-	float maxY[marker_count + 1];
 	double *x = nullptr;
 	double *y = nullptr;
 	unsigned int num_points = 0;
@@ -717,52 +834,67 @@ void FftDisplayPlot::findPeaks(int chn)
 		return;
 	}
 
-	for (int i = 0; i <= marker_count; i++) {
-		maxX[i] = 0;
-		maxY[i] = -200.0;
+	if (marker_count == 0) {
+		return;
 	}
 
-	maxY[0] = y[0];
-
 	auto start = 3;
 	auto stop = num_points;
 
 	if(m_visiblePeakSearch)
 	{
-		auto coef  = num_points/d_stop_frequency;
-		if (m_sweepStart * coef > 0) {
-			start = m_sweepStart * coef;
+		auto coef  = num_points/(d_stop_frequency - d_start_frequency);
+		if ((m_sweepStart - d_start_frequency) * coef > 0) {
+			start = (m_sweepStart - d_start_frequency) * coef;
+		}
+		stop = (m_sweepStop - d_start_frequency) * coef;
+		if (stop > num_points) {
+			stop = num_points;
 		}
-		stop = m_sweepStop * coef;
-		maxY[0] = y[start];
 	}
 
-	for (int i = start; i < stop; i++) {
-		for (int j = 0; j < marker_count; j++ ) {
-			if (i < 2) {
-				continue;
-			}
-			if  ((y[i - 1] > maxY[j]) &&
-					((!((y[i - 2] > y[i - 1]) &&
-					 (y[i - 1] > y[i]))) &&
-					 (!((y[i - 2] < y[i - 1]) &&
-					 (y[i - 1] < y[i]))))) {
-
-				for (int k = marker_count; k > j; k--) {
-					maxY[k] = maxY[k - 1];
-					maxX[k] = maxX[k - 1];
-				}
-				maxY[j] = y[i - 1];
-				maxX[j] = i - 1;
-				break;
-			}
+	// The marker_count highest peaks in one pass, kept in a heap
+	// whose top is the weakest of them. On equal magnitudes the
+	// earlier peak wins. The heap starts filled with placeholders on
+	// bin 0 that any real peak displaces.
+	struct peak {
+		float y;
+		int bin;
+	};
+	auto stronger = [](const peak& a, const peak& b) {
+		return a.y > b.y || (a.y == b.y && a.bin < b.bin);
+	};
+	std::vector<peak> best(marker_count, peak{-200.0f, 0});
+	best[0].y = (m_visiblePeakSearch && start < num_points) ?
+		y[start] : y[0];
+	std::make_heap(best.begin(), best.end(), stronger);
+
+	for (int i = std::max(start, 2); i < (int)stop; i++) {
+		float value = y[i - 1];
+
+		// Most bins fail this and skip the slope test
+		if (!(value > best.front().y)) {
+			continue;
+		}
+
+		bool rising = (y[i - 2] < y[i - 1]) && (y[i - 1] < y[i]);
+		bool falling = (y[i - 2] > y[i - 1]) && (y[i - 1] > y[i]);
+
+		if (rising || falling) {
+			continue;
 		}
+
+		std::pop_heap(best.begin(), best.end(), stronger);
+		best.back() = peak{value, i - 1};
+		std::push_heap(best.begin(), best.end(), stronger);
 	}
 
+	std::sort_heap(best.begin(), best.end(), stronger);
+
 	for (int i = 0; i < marker_count; i++) {
-		markers[i]->x = x[maxX[i]];
-		markers[i]->y = y[maxX[i]];
-		markers[i]->bin = maxX[i];
+		markers[i]->x = x[best[i].bin];
+		markers[i]->y = y[best[i].bin];
+		markers[i]->bin = best[i].bin;
 	}
 
 	for (int i = 0; i < markers.size(); i++) {
@@ -1235,13 +1367,13 @@ void FftDisplayPlot::onMrkCtrlMarkerPosChanged(std::shared_ptr<SpectrumMarker> &
 	}
 
 	if (markerPos < 0) {
-		qDebug() << "unknown marker in marker controller";
+		CAT_DEBUG_EVERY(CAT_SPECTRUM_ANALYZER, 1000) << "unknown marker in marker controller";
 		return;
 	}
 
 	int bin = posAtFrequency(marker->value().x(), chn);
 	if (bin < 0) {
-		qDebug() << "bin should not be negative";
+		CAT_DEBUG_EVERY(CAT_SPECTRUM_ANALYZER, 1000) << "bin should not be negative";
 		return;
 	}
 	if (bin >= d_numPoints && chn < d_nplots) {
@@ -1266,7 +1398,7 @@ void FftDisplayPlot::onMrkCtrlMarkerPosChanged(std::shared_ptr<SpectrumMarker> &
 	if (ydata) {
 		y = ydata[bin];
 	} else {
-		qDebug() << "problem";
+		CAT_DEBUG_EVERY(CAT_SPECTRUM_ANALYZER, 1000) << "problem";
 		y = axisScaleDiv(QwtPlot::yLeft).upperBound();
 	}
 
@@ -93,6 +93,7 @@ namespace adiscope {
 		double d_stop_frequency;
 		double d_sampl_rate;
 		double d_preset_sampl_rate;
+		double d_preset_start_frequency;
 
 		bool d_firstInit;
 
@@ -124,7 +125,7 @@ namespace adiscope {
 		std::vector<double *> d_refXdata;
 		std::vector<double *> d_refYdata;
 
-		void plotData(const std::vector<double *> &pts,
+		void plotData(const std::vector<float *> &pts,
 				uint64_t num_points);
 		void _resetXAxisPoints();
 
@@ -133,7 +134,8 @@ namespace adiscope {
 			in_data, std::vector<double *> out_data,
 			uint64_t nb_points);
 		average_sptr getNewAvgObject(enum AverageType avg_type,
-			uint data_width, uint history);
+			uint data_width, uint history,
+			const average_sptr& replaced);
 
 		void add_marker(int chn);
 		void remove_marker(int chn, int which);
@@ -162,6 +164,10 @@ namespace adiscope {
 		void setScaleFactor(int chIdx, double scale);
 
 		int64_t posAtFrequency(double freq, int chIdx = -1) const;
+
+		// Displayed trace of a channel, numPoints() values
+		const double *channelData(uint chIdx) const;
+		uint64_t numPoints() const;
 		QString leftVerAxisUnit() const;
 		void setLeftVertAxisUnit(const QString& unit);
 
@@ -173,6 +179,7 @@ namespace adiscope {
 		void setAverage(uint chIdx, enum AverageType avg_type,
 			uint history);
 		void resetAverageHistory();
+		size_t averageMemory() const;
 		void setStartStop(double start, double stop);
 		void setVisiblePeakSearch(bool enabled);
 
@@ -227,6 +234,7 @@ namespace adiscope {
 		void setSampleRate(double sr, double units,
 			const std::string &strunits);
 		void presetSampleRate(double sr);
+		void presetStartFrequency(double start);
 		void useLogFreq(bool use_log_freq);
 		void customEvent(QEvent *e);
 		bool getLogScale() const;
@@ -220,15 +220,10 @@ HistogramDisplayPlot::HistogramDisplayPlot(int nplots, QWidget* parent)
   : DisplayPlot(nplots, parent)
 {
   d_bins = 100;
-  d_accum = false;
   d_height = 0;
   stop = false;
   d_orientation = Qt::Horizontal;
-  d_minPos = 0;
-  d_maxPos = 0;
   d_zoomed = false;
-  d_xmin = 1e20;
-  d_xmax = -1e20;
 
   setLeftVertAxesCount(2);
 
@@ -239,7 +234,6 @@ HistogramDisplayPlot::HistogramDisplayPlot(int nplots, QWidget* parent)
   d_semilogx = false;
   d_semilogy = false;
   d_autoscale_state = false;
-  d_autoscalex_state = false;
 
   setAxesCount(QwtPlot::xBottom, 2);
   horizAxes.resize(2);
@@ -461,12 +455,6 @@ void HistogramDisplayPlot::setXaxisSpan(double start, double stop)
 	}
 }
 
-void HistogramDisplayPlot::setDataInterval(int min, int max)
-{
-	d_minPos = min;
-	d_maxPos = max;
-}
-
 void
 HistogramDisplayPlot::replot()
 {
@@ -474,61 +462,26 @@ HistogramDisplayPlot::replot()
 }
 
 void
-HistogramDisplayPlot::plotNewData(const std::vector<double*> dataPoints,
-				   const int64_t numDataPoints,
-				   const double timeInterval)
+HistogramDisplayPlot::plotNewData(const std::vector<double*> counts,
+				   const int64_t numBins,
+				   double left, double right,
+				   const uint64_t numSamples)
 {
   if(!d_stop) {
-    if((numDataPoints > 0)) {
-
-	    _updateXScales(numDataPoints);
-	    if (d_minPos < 0) {
-		    d_minPos = 0;
-	    }
-	    if (d_maxPos > numDataPoints || d_maxPos == 0) {
-		    d_maxPos = numDataPoints;
-	    }
-	    if (d_minPos > d_maxPos) {
-		    d_minPos = 0;
-		    d_maxPos = numDataPoints;
-	    }
-
-      // keep track of the min/max values for when autoscaleX is called.
-      double xminTemp = 1e20;
-      double xmaxTemp = -1e20;
-      for(int n = 0; n < d_nplots; n++) {
-	xminTemp = std::min(xminTemp, *std::min_element(dataPoints[n] + d_minPos, dataPoints[n]+d_maxPos));
-	xmaxTemp = std::max(xmaxTemp, *std::max_element(dataPoints[n] + d_minPos, dataPoints[n]+d_maxPos));
-      }
+    if((numBins > 0)) {
 
-      const double EPS = 0.1;
-      if (std::abs(xminTemp - d_xmin) > EPS ||
-	  std::abs(xmaxTemp - d_xmax) > EPS) {
-	  if (d_minPos == 0 && d_maxPos == numDataPoints) {
-		d_autoscalex_state = true;
-	  }
+	    _updateXScales(numSamples);
+
+      // The binning is done by the sink
+      if(numBins != d_bins) {
+	setNumBins(numBins);
       }
-      d_xmin = xminTemp;
-      d_xmax = xmaxTemp;
-
-      // If autoscalex has been clicked, clear the data for the new
-      // bin widths and reset the x-axis.
-      if(d_autoscalex_state) {
-        for(int n = 0; n < d_nplots; n++)
-	  memset(d_ydata[n], 0, d_bins*sizeof(double));
-        _resetXAxisPoints(d_xmin, d_xmax);
-        d_autoscalex_state = false;
+      if(left != d_left || right != d_right) {
+	_setXAxisRange(left, right);
       }
 
-      int index;
-      for(int n = 0; n < d_nplots; n++) {
-        if(!d_accum)
-	  memset(d_ydata[n], 0, d_bins*sizeof(double));
-	for(int64_t point = d_minPos; point < d_maxPos; point++) {
-          index = boost::math::iround(1e-20 + (dataPoints[n][point] - d_left)/d_width);
-          if((index >= 0) && (index < d_bins))
-	    d_ydata[n][index] += 1;
-        }
+      for(int n = 0; n < d_nplots && n < (int)counts.size(); n++) {
+	memcpy(d_ydata[n], counts[n], d_bins*sizeof(double));
 	d_histograms[n]->setValues(d_xdata, d_ydata[n], d_bins);
       }
 
@@ -554,8 +507,8 @@ HistogramDisplayPlot::plotNewData(const std::vector<double*> dataPoints,
       if (d_orientation == Qt::Vertical) {
 	      for (int i = 0; i < d_histograms.size(); ++i) {
 		      double h = histogramHeights[i] + (0.2 * histogramHeights[i]);
-		      if (h > numDataPoints) {
-			      h = numDataPoints;
+		      if (h > numSamples) {
+			      h = numSamples;
 		      }
 		      double pr = h * 0.15;
 
@@ -581,12 +534,12 @@ void
 HistogramDisplayPlot::newData(const QEvent* updateEvent)
 {
   HistogramUpdateEvent *hevent = (HistogramUpdateEvent*)updateEvent;
-  const std::vector<double*> dataPoints = hevent->getDataPoints();
-  const uint64_t numDataPoints = hevent->getNumDataPoints();
+  if(!hevent->fetchFrame())
+    return;
 
-  plotNewData(dataPoints,
-		 numDataPoints,
-		 0);
+  plotNewData(hevent->getDataPoints(), hevent->getNumBins(),
+	      hevent->getLeft(), hevent->getRight(),
+	      hevent->getNumSamples());
 }
 
 void
@@ -610,8 +563,15 @@ HistogramDisplayPlot::_resetXAxisPoints(double left, double right)
   if((left == right) || (left > right))
     throw std::runtime_error("HistogramDisplayPlot::_resetXAxisPoints left and/or right values are invalid");
 
-  d_left  = left *(1 - copysign(0.1, left));
-  d_right = right*(1 + copysign(0.1, right));
+  _setXAxisRange(left *(1 - copysign(0.1, left)),
+		 right*(1 + copysign(0.1, right)));
+}
+
+void
+HistogramDisplayPlot::_setXAxisRange(double left, double right)
+{
+  d_left  = left;
+  d_right = right;
   d_width = (d_right - d_left)/(d_bins);
   for(long loc = 0; loc < d_bins; loc++){
     d_xdata[loc] = d_left + loc*d_width;
@@ -733,14 +693,6 @@ void HistogramDisplayPlot::setSelectedChannel(unsigned int value)
 	}
 }
 
-void
-HistogramDisplayPlot::setAutoScaleX()
-{
-	if(d_orientation == Qt::Horizontal) {
-		d_autoscalex_state = true;
-	}
-}
-
 void
 HistogramDisplayPlot::setAutoScale(bool state)
 {
@@ -790,12 +742,6 @@ HistogramDisplayPlot::setSemilogy(bool en)
   }
 }
 
-void
-HistogramDisplayPlot::setAccumulate(bool state)
-{
-  d_accum = state;
-}
-
 void
 HistogramDisplayPlot::setMarkerAlpha(int which, int alpha)
 {
@@ -879,7 +825,7 @@ HistogramDisplayPlot::setNumBins(int bins)
 
   delete [] d_xdata;
   d_xdata = new double[d_bins];
-  _resetXAxisPoints(d_left, d_right);
+  _setXAxisRange(d_left, d_right);
 
   for(int i = 0; i < d_nplots; i++) {
     delete [] d_ydata[i];
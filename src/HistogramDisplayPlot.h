@@ -91,23 +91,22 @@ public:
   HistogramDisplayPlot(int nplots, QWidget*);
   virtual ~HistogramDisplayPlot();
 
-  void plotNewData(const std::vector<double*> dataPoints,
-		   const int64_t numDataPoints, const double timeInterval);
+  /* Bin counts from the sink, bin k centered on left + k * width */
+  void plotNewData(const std::vector<double*> counts,
+		   const int64_t numBins, double left, double right,
+		   const uint64_t numSamples);
 
   void replot();
 
   void setXaxisSpan(double start, double stop);
-  void setDataInterval(int min, int max);
   void setOrientation(Qt::Orientation orientation);
   Qt::Orientation getOrientation();
   bool isZoomed();
 
 public Q_SLOTS:
   void setAutoScale(bool state);
-  void setAutoScaleX();
   void setSemilogx(bool en);
   void setSemilogy(bool en);
-  void setAccumulate(bool en);
 
   void setMarkerAlpha(int which, int alpha);
   int getMarkerAlpha(int which) const;
@@ -128,6 +127,7 @@ private Q_SLOTS:
   void _onZoom(const QRectF &rect);
 private:
   void _resetXAxisPoints(double left, double right);
+  void _setXAxisRange(double left, double right);
   void _autoScaleY(double bottom, double top);
   void _updateXScales(unsigned int totalSamples);
   void _orientationChanged();
@@ -142,14 +142,11 @@ private:
   std::vector<double*> d_ydata;
 
   int d_bins;
-  bool d_accum;
-  double d_xmin, d_xmax, d_left, d_right;
+  double d_left, d_right;
   double d_width;
-  int d_minPos, d_maxPos;
 
   bool d_semilogx;
   bool d_semilogy;
-  bool d_autoscalex_state;
   bool stop;
   bool d_zoomed;
 
@@ -45,6 +45,7 @@
 #include <qwt_scale_draw.h>
 #include <qwt_legend.h>
 #include <QColor>
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <volk/volk.h>
@@ -54,6 +55,9 @@
 #include "osc_scale_engine.h"
 
 #include "smoothcurvefitter.h"
+#include "minmaxplotcurve.h"
+#include "persistence_map.h"
+#include "pipeline_trace.hpp"
 
 using namespace adiscope;
 
@@ -239,6 +243,9 @@ TimeDomainDisplayPlot::TimeDomainDisplayPlot(QWidget* parent, unsigned int xNumD
 	  d_zoomer.push_back(new TimeDomainDisplayZoomer(this->canvas()));
 	  d_zoomer[i]->setEnabled(false);
   }
+
+  d_direct_painter = new QwtPlotDirectPainter(this);
+  d_direct_painter->setAttribute(QwtPlotDirectPainter::CopyBackingStore, true);
 }
 
 
@@ -268,11 +275,14 @@ TimeDomainDisplayPlot::replot()
 
 void
 TimeDomainDisplayPlot::plotNewData(const std::string &sender,
-				   const std::vector<double*> &dataPoints,
+				   const std::vector<float*> &dataPoints,
 				   const int64_t numDataPoints,
 				   const double timeInterval,
-				   const std::vector< std::vector<gr::tag_t> > &tags)
+				   const std::vector< std::vector<gr::tag_t> > &tags,
+				   const int64_t offset)
 {
+  PIPELINE_TRACE("plotNewData");
+
   int sinkIndex = d_sinkManager.indexOfSink(sender);
 
   if(!d_stop) {
@@ -283,34 +293,62 @@ TimeDomainDisplayPlot::plotNewData(const std::string &sender,
       unsigned long long sinkNumPoints = sink->channelsDataLength();
       bool reset_x_axis_points = d_sink_reset_x_axis_pts[sinkIndex];
 
-      if(numDataPoints != sinkNumPoints){
-	sinkNumPoints = numDataPoints;
-	sink->setChannelsDataLength(numDataPoints);
-
-	delete[] d_xdata[sinkIndex];
-	d_xdata[sinkIndex] = new double[numDataPoints];
+      // With an offset, the points get appended to the ones already
+      // received for this frame (rolling mode)
+      const int64_t totalPoints = offset + numDataPoints;
+      bool append = (offset > 0) && ((unsigned long long)offset <= sinkNumPoints);
+      bool redraw_all = !append || d_curves_hidden;
+
+      if(totalPoints != sinkNumPoints){
+	sinkNumPoints = totalPoints;
+	sink->setChannelsDataLength(totalPoints);
+
+	// The arrays only get reallocated when they need to grow; while
+	// appending, they grow in bigger steps and keep their content
+	unsigned long long capacity = d_ydata_capacity[sinkIndex];
+	bool grow = (unsigned long long)totalPoints > capacity;
+	if (grow)
+	  d_ydata_capacity[sinkIndex] = append ?
+		  std::max((unsigned long long)totalPoints, 2 * capacity) :
+		  totalPoints;
 
 	int ref_offset = countReferenceWaveform(start);
 	for(int i = start; i < start + sinkNumChannels; i++) {
-	  delete[] d_ydata[i];
-	  d_ydata[i] = new double[numDataPoints];
-
-	  d_plot_curve[i + ref_offset]->setRawSamples(d_xdata[sinkIndex], d_ydata[i], numDataPoints);
+	  if (grow) {
+	    double *ydata = new double[d_ydata_capacity[sinkIndex]];
+	    if (append)
+	      std::copy(d_ydata[i], d_ydata[i] + offset, ydata);
+	    delete[] d_ydata[i];
+	    d_ydata[i] = ydata;
+	  }
+
+	  d_plot_curve[i + ref_offset]->setData(new UniformSampledData(
+			d_ydata[i], totalPoints, 0.0, 1.0));
 	}
 
-	_resetXAxisPoints(d_xdata[sinkIndex], numDataPoints, d_sample_rate);
+	_resetXAxisPoints(sinkIndex);
       } else if (reset_x_axis_points) {
-          _resetXAxisPoints(d_xdata[sinkIndex], numDataPoints, d_sample_rate);
+          _resetXAxisPoints(sinkIndex);
           reset_x_axis_points = false;
       }
 
+      int ref_offset = countReferenceWaveform(start);
       for(int i = 0; i < sinkNumChannels; i++) {
+	auto curve = dynamic_cast<MinMaxPlotCurve *>(
+		d_plot_curve[start + i + ref_offset]);
+	if (curve)
+	  curve->invalidateEnvelope();
+
+	_updatePersistenceTimeRange(d_plot_curve[start + i + ref_offset]);
+
+	// Only the new points get converted
+	double *ydata = d_ydata[start + i] + (append ? offset : 0);
 	if(d_semilogy) {
 	  for(int n = 0; n < numDataPoints; n++)
-	    d_ydata[start + i][n] = fabs(dataPoints[i][n]);
+	    ydata[n] = fabs(dataPoints[i][n]);
 	}
 	else {
-	  memcpy(d_ydata[start + i], dataPoints[i], numDataPoints*sizeof(double));
+	  volk_32f_convert_64f(ydata, dataPoints[i], numDataPoints);
 	}
       }
 
@@ -448,26 +486,44 @@ TimeDomainDisplayPlot::plotNewData(const std::string &sender,
 //        }
 //      }
 
-//      if(d_autoscale_state) {
-//	double bottom=1e20, top=-1e20;
-//	for(int n = 0; n < d_nplots; n++) {
-//	  for(int64_t point = 0; point < numDataPoints; point++) {
-//	    if(d_ydata[n][point] < bottom) {
-//	      bottom = d_ydata[n][point];
-//	    }
-//	    if(d_ydata[n][point] > top) {
-//	      top = d_ydata[n][point];
-//	    }
-//	  }
-//	}
-//	_autoScale(bottom, top);
-//        if(d_autoscale_shot) {
-//          d_autoscale_state = false;
-//          d_autoscale_shot = false;
-//        }
-//      }
+      auto range = d_autoscale_ranges.find(sender);
+      if(d_autoscale_state && range != d_autoscale_ranges.end()) {
+	double bottom = range->second.first;
+	double top = range->second.second;
+
+	// The points get plotted as their absolute value
+	if(d_semilogy) {
+	  double abs_top = std::max(fabs(bottom), fabs(top));
+	  bottom = (bottom > 0) ? bottom : ((top < 0) ? -top : 0);
+	  top = abs_top;
+	}
 
-      replot();
+	QwtInterval before = axisInterval(QwtPlot::yLeft);
+	_autoScale(bottom, top);
+	if (axisInterval(QwtPlot::yLeft) != before)
+	  redraw_all = true;
+
+        if(d_autoscale_shot) {
+          d_autoscale_state = false;
+          d_autoscale_shot = false;
+        }
+      }
+
+      // Rolling mode: when the rest of the plot didn't change, only
+      // paint the new part of the curves on top of the canvas, starting
+      // from the last point drawn so that the line stays connected.
+      if (d_display_suspended) {
+	d_replot_pending = true;
+      } else if (!redraw_all && qobject_cast<QwtPlotCanvas *>(canvas())) {
+	int ref_offset = countReferenceWaveform(start);
+	for (int i = 0; i < sinkNumChannels; i++) {
+	  QwtPlotCurve *curve = d_plot_curve[start + i + ref_offset];
+	  if (curve->isVisible())
+	    d_direct_painter->drawSeries(curve, offset - 1, totalPoints - 1);
+	}
+      } else {
+	replot();
+      }
 
       Q_EMIT newData();
 
@@ -478,21 +534,48 @@ TimeDomainDisplayPlot::plotNewData(const std::string &sender,
 void TimeDomainDisplayPlot::newData(const QEvent* updateEvent)
 {
 	IdentifiableTimeUpdateEvent *tevent = (IdentifiableTimeUpdateEvent*)updateEvent;
-	const std::vector<double*> dataPoints = tevent->getTimeDomainPoints();
+
+	// A newer frame of the same sink is already queued, only draw that one
+	if (tevent->isSuperseded()) {
+		return;
+	}
+
+	const std::vector<float*> dataPoints = tevent->getTimeDomainPoints();
 	const uint64_t numDataPoints = tevent->getNumTimeDomainDataPoints();
+	const uint64_t offset = tevent->isAppend() ? tevent->getOffset() : 0;
+
+	if (d_autoscale_state && !dataPoints.empty()) {
+		double bottom = tevent->getMin(0), top = tevent->getMax(0);
+
+		for (size_t i = 1; i < dataPoints.size(); i++) {
+			bottom = std::min(bottom, (double)tevent->getMin(i));
+			top = std::max(top, (double)tevent->getMax(i));
+		}
+
+		// Appended points extend the range of the frame
+		auto range = d_autoscale_ranges.find(tevent->senderName());
+		if (offset > 0 && range != d_autoscale_ranges.end()) {
+			bottom = std::min(bottom, range->second.first);
+			top = std::max(top, range->second.second);
+		}
+
+		d_autoscale_ranges[tevent->senderName()] =
+			std::make_pair(bottom, top);
+	}
 	const std::vector< std::vector<gr::tag_t> > tags = tevent->getTags();
 	const std::string sender = tevent->senderName();
 
-	if ((d_nbPtsXAxis != 0) && (d_nbPtsXAxis <= numDataPoints)
+	if ((d_nbPtsXAxis != 0) && (d_nbPtsXAxis <= offset + numDataPoints)
 			&& sender == "Osc Time") {
-		Q_EMIT filledScreen(true, numDataPoints);
+		Q_EMIT filledScreen(true, offset + numDataPoints);
 	}
 
 	this->plotNewData(sender,
 			dataPoints,
 			numDataPoints,
 			0,
-			tags);
+			tags,
+			offset);
 }
 
 void TimeDomainDisplayPlot::customEvent(QEvent * e)
@@ -531,12 +614,60 @@ TimeDomainDisplayPlot::legendEntryChecked(const QVariant &plotItem, bool on, int
 }
 
 void
-TimeDomainDisplayPlot::_resetXAxisPoints(double*& xAxis, unsigned long long numPoints, double sampleRate)
+TimeDomainDisplayPlot::setPersistence(unsigned int curveIdx,
+				      const std::shared_ptr<PersistenceMap> &map)
+{
+  QwtPlotCurve *curve = Curve(curveIdx);
+  if (!curve)
+    return;
+
+  auto it = d_persistence_items.find(curve);
+  if (it != d_persistence_items.end()) {
+    it->second->detach();
+    delete it->second;
+    d_persistence_items.erase(it);
+  }
+
+  if (map) {
+    PersistencePlotItem *item = new PersistencePlotItem(map,
+		    curve->pen().color());
+    item->setAxes(curve->xAxis(), curve->yAxis());
+    item->attach(this);
+    d_persistence_items[curve] = item;
+    _updatePersistenceTimeRange(curve);
+  }
+
+  replot();
+}
+
+void
+TimeDomainDisplayPlot::_updatePersistenceTimeRange(QwtPlotCurve *curve)
 {
-  double delt = 1.0 / sampleRate;
+  auto it = d_persistence_items.find(curve);
+  if (it == d_persistence_items.end())
+    return;
+
+  auto data = dynamic_cast<UniformSampledData *>(curve->data());
+  if (data)
+    it->second->setTimeRange(data->xStart(),
+		    data->xStart() + data->size() * data->xStep());
+}
 
-  for (long loc = 0; loc < numPoints; loc++)
-    xAxis[loc] = (d_data_starting_point + loc) * delt;
+void
+TimeDomainDisplayPlot::_resetXAxisPoints(int sinkIndex)
+{
+  double delt = 1.0 / d_sample_rate;
+  Sink *sink = d_sinkManager.sink(sinkIndex);
+  int start = d_sinkManager.sinkFirstChannelPos(sink->name());
+  int ref_offset = countReferenceWaveform(start);
+
+  // The x coordinates are implicit, only the mapping gets updated
+  for (int i = start; i < start + sink->numChannels(); i++) {
+    auto data = dynamic_cast<UniformSampledData *>(
+		    d_plot_curve[i + ref_offset]->data());
+    if (data)
+      data->setXAxis(d_data_starting_point * delt, delt);
+  }
 
 
   // Set up zoomer base for maximum unzoom x-axis
@@ -659,7 +790,7 @@ TimeDomainDisplayPlot::setSampleRate(double sr, double units,
     d_sample_rate = sr/units;
 
     for (unsigned int i = 0; i < d_sinkManager.sinkListLength(); i++)
-      _resetXAxisPoints(d_xdata[i], d_sinkManager.sink(i)->channelsDataLength(), d_sample_rate);
+      _resetXAxisPoints(i);
   }
 }
 
@@ -709,9 +840,13 @@ void TimeDomainDisplayPlot::setPlotLineStyle(unsigned int chIdx, unsigned int st
 	}
 
 	auto curve = d_plot_curve[chIdx];
+	auto minmax = dynamic_cast<MinMaxPlotCurve *>(curve);
 
 	curve->setPaintAttribute(QwtPlotCurve::ClipPolygons, true);
 	curve->setCurveAttribute(QwtPlotCurve::Fitted, false);
+	if (minmax) {
+		minmax->setSincInterpolation(false);
+	}
 
 	switch (style) {
 		case 0:
@@ -736,6 +871,14 @@ void TimeDomainDisplayPlot::setPlotLineStyle(unsigned int chIdx, unsigned int st
 		curve->setStyle(QwtPlotCurve::CurveStyle::Lines);
 		replot();
 		break;
+		case 5:
+		/* Lines until zoomed in enough, see MinMaxPlotCurve */
+		if (minmax) {
+			minmax->setSincInterpolation(true);
+		}
+		curve->setStyle(QwtPlotCurve::CurveStyle::Lines);
+		replot();
+		break;
 	}
 }
 
@@ -745,11 +888,14 @@ int TimeDomainDisplayPlot::getPlotLineStyle(unsigned int chIdx) const
 		return -1;
 	}
 
+	auto minmax = dynamic_cast<MinMaxPlotCurve *>(d_plot_curve[chIdx]);
 	auto style = d_plot_curve[chIdx]->style();
 	switch (style) {
 		case QwtPlotCurve::CurveStyle::Lines:
 		if (d_plot_curve[chIdx]->testCurveAttribute(QwtPlotCurve::Fitted)) {
 			return 4;
+		} else if (minmax && minmax->sincInterpolation()) {
+			return 5;
 		} else {
 			return 0;
 		}
@@ -782,7 +928,7 @@ TimeDomainDisplayPlot::setSemilogx(bool en)
 #endif /*QWT_VERSION < 0x060100 */
   }
   for (unsigned int i = 0; i < d_sinkManager.sinkListLength(); i++)
-    _resetXAxisPoints(d_xdata[i], d_sinkManager.sink(i)->channelsDataLength(), d_sample_rate);
+    _resetXAxisPoints(i);
 }
 
 void
@@ -960,6 +1106,31 @@ bool TimeDomainDisplayPlot::isReferenceWaveform(QwtPlotCurve *curve)
 	return d_ref_curves.values().contains(curve);
 }
 
+size_t TimeDomainDisplayPlot::referenceMemory() const
+{
+	size_t bytes = 0;
+	size_t pos = 0;
+
+	// d_ref_ydata follows the order of the references in d_plot_curve
+	for (QwtPlotCurve *curve : d_plot_curve) {
+		if (!d_ref_curves.values().contains(curve)) {
+			continue;
+		}
+
+		if (pos < d_ref_ydata.size() && d_ref_ydata[pos]) {
+			size_t samples = curve->dataSize();
+
+			// The curves of uneven samples keep a copy of both axes
+			bool uniform = dynamic_cast<UniformSampledData *>(
+						curve->data());
+			bytes += samples * sizeof(double) * (uniform ? 1 : 3);
+		}
+		pos++;
+	}
+
+	return bytes;
+}
+
 bool TimeDomainDisplayPlot::isMathWaveform(QwtPlotCurve *curve) const
 {
 	return d_math_curves.values().contains(curve);
@@ -989,14 +1160,61 @@ int TimeDomainDisplayPlot::countReferenceWaveform(int position)
 	return count;
 }
 
-void TimeDomainDisplayPlot::registerReferenceWaveform(QString name, QVector<double> xData, QVector<double> yData)
+void TimeDomainDisplayPlot::registerReferenceWaveform(QString name,
+		const QVector<double> &xData, const QVector<double> &yData)
 {
 
 	QColor color = getChannelColor();
 
-	QwtPlotCurve *curve = new QwtPlotCurve();
-	curve->setSamples(xData, yData);
+	// The samples are only stored once, in d_ref_ydata. When they are
+	// evenly spaced (always the case for imported waveforms), the curve
+	// computes the x values, so realigning it is only a matter of
+	// changing its start. Drawing goes through the min/max envelope,
+	// which only walks the visible part and is cached until the time
+	// base or the position change.
+	int size = std::min(xData.size(), yData.size());
+
+	d_ref_ydata.push_back(new double[yData.size()]);
+	int n = d_ref_ydata.size() - 1;
+	std::copy(yData.begin(), yData.end(), d_ref_ydata[n]);
+
+	bool uniform = (size >= 2);
+	double step = uniform ? (xData[1] - xData[0]) : 1.0;
+	for (int i = 2; uniform && i < size; i++) {
+		uniform = qFuzzyCompare(1.0 + (xData[i] - xData[i - 1]),
+				1.0 + step);
+	}
+
+	QwtPlotCurve *curve = new MinMaxPlotCurve();
+	if (uniform) {
+		curve->setData(new UniformSampledData(d_ref_ydata[n], size,
+					xData[0], step));
+	} else {
+		curve->setSamples(xData, yData);
+	}
+
+	attachReferenceCurve(name, curve, color);
+}
+
+void TimeDomainDisplayPlot::registerReferenceWaveform(QString name,
+		UniformSampledData *data,
+		std::shared_ptr<const MinMaxPyramid> pyramid)
+{
+	QColor color = getChannelColor();
+
+	// Nothing to free with the curve, the data owns the samples
+	d_ref_ydata.push_back(nullptr);
+
+	MinMaxPlotCurve *curve = new MinMaxPlotCurve();
+	curve->setData(data);
+	curve->setPyramid(pyramid);
 
+	attachReferenceCurve(name, curve, color);
+}
+
+void TimeDomainDisplayPlot::attachReferenceCurve(QString name,
+		QwtPlotCurve *curve, const QColor &color)
+{
 	curve->setPen(QPen(color));
 	curve->setRenderHint(QwtPlotItem::RenderAntialiased);
 
@@ -1007,12 +1225,6 @@ void TimeDomainDisplayPlot::registerReferenceWaveform(QString name, QVector<doub
 
 	curve->attach(this);
 
-	d_ref_ydata.push_back(new double[yData.size()]);
-	int n = d_ref_ydata.size() - 1;
-	memset(d_ref_ydata[n], 0x0, yData.size() * sizeof(double));
-	for (int i = 0; i < yData.size(); ++i)
-		d_ref_ydata[d_ref_ydata.size() - 1][i] = yData[i];
-
 	d_plot_curve.push_back(curve);
 	d_ref_curves.insert(name, curve);
 	d_nplots += 1;
@@ -1046,10 +1258,11 @@ void TimeDomainDisplayPlot::unregisterReferenceWaveform(QString name)
 	}
 	cleanUpJustBeforeChannelRemoval(i);
 
-	delete[] d_ref_ydata[pos];
-	d_ref_ydata.erase(d_ref_ydata.begin() + pos);
+	// The curve may point into the samples, so it goes first
 	curve->detach();
 	delete curve;
+	delete[] d_ref_ydata[pos];
+	d_ref_ydata.erase(d_ref_ydata.begin() + pos);
 
 	d_nb_ref_curves--;
 }
@@ -1137,11 +1350,22 @@ void TimeDomainDisplayPlot::realignReferenceWaveforms(double timebase, double ti
 	QList<QwtPlotCurve *> curves = d_ref_curves.values();
 
 	for (auto &curve : curves) {
-		double x_axis_step_size = curve->data()->sample(1).x() -
-				curve->data()->sample(0).x();
 		double mid_point_on_screen = (timebase * 8) - ((timebase * 8) - timeposition);
 		int nr_of_samples_in_file = curve->data()->size();
 
+		// Only the start moves, the samples and their min/max
+		// pyramid stay as they are
+		auto data = dynamic_cast<UniformSampledData *>(curve->data());
+		if (data) {
+			data->setXAxis(mid_point_on_screen -
+					(nr_of_samples_in_file / 2) * data->xStep(),
+					data->xStep());
+			continue;
+		}
+
+		double x_axis_step_size = curve->data()->sample(1).x() -
+				curve->data()->sample(0).x();
+
 		QVector<double> xData;
 		QVector<double> yData;
 
@@ -1176,7 +1400,7 @@ bool TimeDomainDisplayPlot::registerSink(std::string sinkUniqueNme, unsigned int
 	if (ret) {
 		int numCurves = d_ydata.size();
 		int sinkIndex = d_sinkManager.indexOfSink(sinkUniqueNme);
-		d_xdata.push_back(new double[channelsDataLength]);
+		d_ydata_capacity.push_back(channelsDataLength);
 
 		for (int i = 0; i < numChannels; i++) {
 			int n = i + numCurves;
@@ -1185,7 +1409,7 @@ bool TimeDomainDisplayPlot::registerSink(std::string sinkUniqueNme, unsigned int
 
 			QColor color = getChannelColor();
 
-			QwtPlotCurve *curve = new QwtPlotCurve(QString("Data %1").arg(n));
+			QwtPlotCurve *curve = new MinMaxPlotCurve(QString("Data %1").arg(n));
 			curve->setPen(QPen(color));
 			curve->setRenderHint(QwtPlotItem::RenderAntialiased);
 			d_plot_curve.push_back(curve);
@@ -1199,7 +1423,8 @@ bool TimeDomainDisplayPlot::registerSink(std::string sinkUniqueNme, unsigned int
 				d_plot_curve.back()->setPaintAttribute(QwtPlotCurve::FilterPointsAggressive, true);
 			}
 
-			d_plot_curve.back()->setRawSamples(d_xdata[sinkIndex], d_ydata[n], channelsDataLength);
+			d_plot_curve.back()->setData(new UniformSampledData(
+					d_ydata[n], channelsDataLength, 0.0, 1.0));
 			d_plot_curve.back()->setSymbol(symbol);
 
 			d_plot_curve.back()->setCurveFitter(new SmoothCurveFitter());
@@ -1210,7 +1435,7 @@ bool TimeDomainDisplayPlot::registerSink(std::string sinkUniqueNme, unsigned int
 			Q_EMIT channelAdded(n + d_nb_ref_curves);
 		}
 		d_nplots += numChannels;
-		_resetXAxisPoints(d_xdata[sinkIndex], channelsDataLength, d_sample_rate);
+		_resetXAxisPoints(sinkIndex);
 		d_tag_markers.resize(d_nplots);
 
 		d_sink_reset_x_axis_pts.push_back(false);
@@ -1235,9 +1460,7 @@ bool TimeDomainDisplayPlot::unregisterSink(std::string sinkName)
 	int sinkIndex = d_sinkManager.indexOfSink(sinkName);
 	if (sinkIndex >= 0) {
 
-		// Remove X axis associated with the channels of the sink
-		delete[] d_xdata[sinkIndex];
-		d_xdata.erase(d_xdata.begin() + sinkIndex);
+		d_ydata_capacity.erase(d_ydata_capacity.begin() + sinkIndex);
 
 		// Remove Y axes corresponding to each channel of the sink
 		int offset = d_sinkManager.sinkFirstChannelPos(sinkName);
@@ -1251,6 +1474,13 @@ bool TimeDomainDisplayPlot::unregisterSink(std::string sinkName)
 		/* Remove the QwtPlotCurve */
 		int ref_offset = countReferenceWaveform(offset);
 		for (int i = offset; i < offset + numChannels; i++) {
+			auto item = d_persistence_items.find(d_plot_curve[i + ref_offset]);
+			if (item != d_persistence_items.end()) {
+				item->second->detach();
+				delete item->second;
+				d_persistence_items.erase(item);
+			}
+
 			d_plot_curve[i + ref_offset]->detach();
 			delete d_plot_curve[i + ref_offset];
 		}
@@ -48,10 +48,64 @@
 #include <gnuradio/tags.h>
 
 #include "DisplayPlot.h"
+#include "minmaxplotcurve.h"
 #include "spectrumUpdateEvents.h"
 
+#include <qwt_series_data.h>
+#include <qwt_plot_directpainter.h>
+
+#include <map>
+#include <memory>
+
 namespace adiscope {
 
+class PersistenceMap;
+class PersistencePlotItem;
+
+/*
+ * Samples of a uniformly sampled channel: only the y values are stored,
+ * the x coordinate of sample i is computed as start + i * step.
+ */
+class UniformSampledData: public QwtSeriesData<QPointF>
+{
+public:
+	UniformSampledData(const double *y, size_t size,
+			double start, double step):
+		d_y(y), d_size(size), d_start(start), d_step(step) { }
+
+	virtual size_t size() const { return d_size; }
+
+	virtual QPointF sample(size_t i) const
+	{
+		return QPointF(d_start + i * d_step, d_y[i]);
+	}
+
+	virtual QRectF boundingRect() const
+	{
+		if (cachedBoundingRect.width() < 0.0)
+			cachedBoundingRect = qwtBoundingRect(*this);
+
+		return cachedBoundingRect;
+	}
+
+	void setXAxis(double start, double step)
+	{
+		d_start = start;
+		d_step = step;
+		cachedBoundingRect = QRectF(0.0, 0.0, -1.0, -1.0);
+	}
+
+	const double *yData() const { return d_y; }
+	double xStart() const { return d_start; }
+	double xStep() const { return d_step; }
+
+private:
+	const double *d_y;
+	size_t d_size;
+	double d_start;
+	double d_step;
+};
+
 class Sink{
 public:
 	Sink(const std::string &name, unsigned int numChannels, unsigned long long channelsDataLength):
@@ -104,10 +158,11 @@ public:
   virtual ~TimeDomainDisplayPlot();
 
   void plotNewData(const std::string &sender,
-		   const std::vector<double*> &dataPoints,
+		   const std::vector<float*> &dataPoints,
 		   const int64_t numDataPoints, const double timeInterval,
                    const std::vector< std::vector<gr::tag_t> > &tags \
-		   = std::vector< std::vector<gr::tag_t> >());
+		   = std::vector< std::vector<gr::tag_t> >(),
+		   const int64_t offset = 0);
   void replot();
 
   void stemPlot(bool en);
@@ -143,8 +198,15 @@ public:
   void removeZoomer(unsigned int zoomerIdx);
   void setXAxisNumPoints(unsigned int);
 
-  void registerReferenceWaveform(QString name, QVector<double> xData, QVector<double> yData);
+  void registerReferenceWaveform(QString name, const QVector<double> &xData,
+				 const QVector<double> &yData);
+  // Samples owned by data, e.g. mapped from a file, drawn with a
+  // pyramid built ahead of time when there is one
+  void registerReferenceWaveform(QString name, UniformSampledData *data,
+				 std::shared_ptr<const MinMaxPyramid> pyramid);
   void unregisterReferenceWaveform(QString name);
+  // The bytes of the imported references, the mapped ones excluded
+  size_t referenceMemory() const;
   void addPreview(QVector<QVector<double>> curvesToBePreviewed, double reftimebase,
                   double timebase, double timeposition);
   void clearPreview();
@@ -196,6 +258,10 @@ public Q_SLOTS:
 
   void updatePreview(double reftimebase, double timebase, double timeposition);
 
+  // Draw the hit counts of a map behind the curve, nullptr removes it
+  void setPersistence(unsigned int curveIdx,
+		      const std::shared_ptr<PersistenceMap> &map);
+
 protected:
   virtual void configureAxis(int axisPos, int axisIdx);
   virtual void cleanUpJustBeforeChannelRemoval(int chnIdx);
@@ -205,7 +271,7 @@ private Q_SLOTS:
 
 protected:
   std::vector<double*> d_ydata;
-  std::vector<double*> d_xdata;
+  std::vector<unsigned long long> d_ydata_capacity;
   std::vector<double*> d_ref_ydata;
   QVector<QVector<double>> d_preview_xdata;
   QVector<QVector<double>> d_preview_ydata;
@@ -215,14 +281,26 @@ protected:
   int countReferenceWaveform(int position);
 
 private:
-  void _resetXAxisPoints(double*& xAxis, unsigned long long numPoints, double sampleRate);
+  void _resetXAxisPoints(int sinkIndex);
+  void _updatePersistenceTimeRange(QwtPlotCurve *curve);
   void _autoScale(double bottom, double top);
+  void attachReferenceCurve(QString name, QwtPlotCurve *curve,
+			    const QColor &color);
 
   double d_sample_rate;
   double d_delay;
   long d_data_starting_point;
   std::vector<bool> d_sink_reset_x_axis_pts;
 
+  std::map<QwtPlotCurve *, PersistencePlotItem *> d_persistence_items;
+
+  // Range of the current frame of each sink, as computed by the sink;
+  // the autoscale uses it instead of going over the samples again
+  std::map<std::string, std::pair<double, double> > d_autoscale_ranges;
+
+  // Draws the samples appended in rolling mode without a full replot
+  QwtPlotDirectPainter *d_direct_painter;
+
   bool d_semilogx;
   bool d_semilogy;
   bool d_autoscale_shot;
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACQUISITION_CLOCK_H
+#define ACQUISITION_CLOCK_H
+
+#include <pmt/pmt.h>
+
+#include <chrono>
+#include <stdint.h>
+
+/* Key of the tags on the first sample of every acquisition buffer. The
+ * value holds the time the buffer reached the flowgraph on the
+ * acquisition clock and the index of the sample in the stream of the
+ * device, which stays valid when the sinks re-offset the tags. */
+#define ACQUISITION_TIME_TAG "acquisition_time"
+
+namespace adiscope {
+namespace acquisition_clock {
+
+/* Nanoseconds of the monotonic clock all the tools time their
+ * acquisitions with, so that their captures can be lined up */
+inline uint64_t now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+}
+
+inline pmt::pmt_t tag_value(uint64_t time, uint64_t sample)
+{
+	return pmt::cons(pmt::from_uint64(time), pmt::from_uint64(sample));
+}
+
+inline bool from_tag_value(const pmt::pmt_t &value, uint64_t &time,
+		uint64_t &sample)
+{
+	if (!pmt::is_pair(value) || !pmt::is_uint64(pmt::car(value)) ||
+			!pmt::is_uint64(pmt::cdr(value))) {
+		return false;
+	}
+
+	time = pmt::to_uint64(pmt::car(value));
+	sample = pmt::to_uint64(pmt::cdr(value));
+	return true;
+}
+
+/* Time of the sample samples_after the one of the given time */
+inline uint64_t time_of(uint64_t time, int64_t samples_after,
+		double sample_rate)
+{
+	return time + (int64_t)(samples_after * 1e9 / sample_rate);
+}
+
+}
+}
+
+#endif // ACQUISITION_CLOCK_H
@@ -21,25 +21,41 @@
 #include "adc_sample_conv.hpp"
 #include "osc_adc.h"
 
+#include <volk/volk.h>
+#include <algorithm>
+
 using namespace gr;
 using namespace adiscope;
 
 adc_sample_conv::adc_sample_conv(int nconnections,
 				 std::shared_ptr<M2kAdc> adc,
-				 bool inverse) :
+				 bool inverse, bool raw_input) :
 	gr::sync_block("adc_sample_conv",
-			gr::io_signature::make(nconnections, nconnections, sizeof(float)),
+			gr::io_signature::make(nconnections, nconnections,
+				(raw_input && !inverse) ? sizeof(short)
+							: sizeof(float)),
 			gr::io_signature::make(nconnections, nconnections, sizeof(float))),
 	d_nconnections(nconnections),
 	inverse(inverse),
+	raw_input(raw_input && !inverse),
+	d_ac_block_size(1),
 	m2k_adc(adc)
 {
+	const int alignment_multiple = volk_get_alignment() / sizeof(float);
+	set_alignment(std::max(1, alignment_multiple));
+
 	for (int i = 0; i < d_nconnections; i++) {
 		d_correction_gains.push_back(1.0);
 		d_filter_compensations.push_back(1.0);
 		d_offsets.push_back(0.0);
 		d_hardware_gains.push_back(0.02);
+		d_ac_coupled.push_back(false);
+		d_dc_offsets.push_back(0.0);
 	}
+
+	d_coefficients.resize(d_nconnections);
+	for (int i = 0; i < d_nconnections; i++)
+		updateCoefficients(i);
 }
 
 adc_sample_conv::~adc_sample_conv()
@@ -62,32 +78,93 @@ float adc_sample_conv::convVoltsToSample(float voltage, float correctionGain,
 			(2048 * 1.3 * hw_gain) / 0.78);
 }
 
+float adc_sample_conv::sampleToVoltsScale(float correctionGain,
+	float filterCompensation, float hw_gain)
+{
+	return 0.78 / ((1 << 11) * 1.3 * hw_gain) *
+		correctionGain * filterCompensation;
+}
+
+void adc_sample_conv::updateCoefficients(int connection)
+{
+	/* Both conversions are affine, so fold the four coefficients into
+	 * one scale and one bias and let VOLK do the heavy lifting */
+	Coefficients &c = d_coefficients[connection];
+
+	c.scale = sampleToVoltsScale(d_correction_gains[connection],
+			d_filter_compensations[connection],
+			d_hardware_gains[connection]);
+	c.bias = d_offsets[connection];
+	c.ac_coupled = d_ac_coupled[connection] && !inverse;
+
+	if (inverse) {
+		c.scale = 1.0f / c.scale;
+		c.bias = -d_offsets[connection] * c.scale;
+	}
+}
+
 int adc_sample_conv::work(int noutput_items,
 		gr_vector_const_void_star &input_items,
 		gr_vector_void_star &output_items)
 {
 	updateCorrectionGain();
 
-	gr::thread::scoped_lock lock(d_setlock);
+	/* One snapshot per call: a change made meanwhile applies from the
+	 * next call on, to all the coefficients of a connection at once */
+	int block_size;
+	{
+		gr::thread::scoped_lock lock(d_setlock);
+		d_work_coefficients = d_coefficients;
+		block_size = d_ac_block_size;
+	}
 
 	for (unsigned int i = 0; i < input_items.size(); i++) {
-		const float* in = static_cast<const float *>(input_items[i]);
 		float *out = static_cast<float *>(output_items[i]);
+		const Coefficients &c = d_work_coefficients[i];
+		float scale = c.scale;
+		float bias = c.bias;
 
-		if (inverse)
-			for (int j = 0; j < noutput_items; j++)
-				out[j] = convVoltsToSample(in[j],
-						d_correction_gains[i],
-						d_filter_compensations[i],
-						d_offsets[i],
-						d_hardware_gains[i]);
-		else
+		if (raw_input) {
+			const int16_t *in = static_cast<const int16_t *>(
+					input_items[i]);
+
+			/* volk divides by the given scalar */
+			volk_16i_s32f_convert_32f(out, in, 1.0f / scale,
+					noutput_items);
+		} else {
+			const float *in = static_cast<const float *>(
+					input_items[i]);
+
+			volk_32f_s32f_multiply_32f(out, in, scale,
+					noutput_items);
+		}
+
+		if (c.ac_coupled) {
+			/* The offset is part of the mean, so it doesn't
+			 * have to be added first */
+			float dc_offset = d_dc_offsets[i];
+
+			for (int first = 0; first < noutput_items;
+					first += block_size) {
+				int n = std::min(block_size,
+						noutput_items - first);
+				float mean;
+
+				volk_32f_accumulator_s32f(&mean, out + first, n);
+				mean /= n;
+
+				for (int j = first; j < first + n; j++)
+					out[j] -= mean;
+
+				dc_offset = mean + bias;
+			}
+
+			gr::thread::scoped_lock lock(d_setlock);
+			d_dc_offsets[i] = dc_offset;
+		} else if (bias != 0.0f) {
 			for (int j = 0; j < noutput_items; j++)
-				out[j] = convSampleToVolts(in[j],
-					d_correction_gains[i],
-					d_filter_compensations[i],
-					d_offsets[i],
-					d_hardware_gains[i]);
+				out[j] += bias;
+		}
 	}
 
 	return noutput_items;
@@ -113,6 +190,7 @@ void adc_sample_conv::setCorrectionGain(int connection, float gain)
 	if (d_correction_gains[connection] != gain) {
 		gr::thread::scoped_lock lock(d_setlock);
 		d_correction_gains[connection] = gain;
+		updateCoefficients(connection);
 	}
 }
 
@@ -132,6 +210,7 @@ void adc_sample_conv::setFilterCompensation(int connection, float val)
 	if (d_filter_compensations[connection] != val) {
 		gr::thread::scoped_lock lock(d_setlock);
 		d_filter_compensations[connection] = val;
+		updateCoefficients(connection);
 	}
 }
 
@@ -151,6 +230,7 @@ void adc_sample_conv::setOffset(int connection, float offset)
 	if (d_offsets[connection] != offset) {
 		gr::thread::scoped_lock lock(d_setlock);
 		d_offsets[connection] = offset;
+		updateCoefficients(connection);
 	}
 }
 
@@ -170,6 +250,7 @@ void adc_sample_conv::setHardwareGain(int connection, float gain)
 	if (d_hardware_gains[connection] != gain) {
 		gr::thread::scoped_lock lock(d_setlock);
 		d_hardware_gains[connection] = gain;
+		updateCoefficients(connection);
 	}
 }
 
@@ -180,3 +261,47 @@ float adc_sample_conv::hardwareGain(int connection) const
 
 	return 0.0;
 }
+
+void adc_sample_conv::setAcCoupling(int connection, bool enabled)
+{
+	if (connection < 0 || connection >= d_nconnections)
+		return;
+
+	if (d_ac_coupled[connection] != enabled) {
+		gr::thread::scoped_lock lock(d_setlock);
+		d_ac_coupled[connection] = enabled;
+		d_dc_offsets[connection] = 0.0;
+		updateCoefficients(connection);
+	}
+}
+
+bool adc_sample_conv::acCoupling(int connection) const
+{
+	if (connection >= 0 && connection < d_nconnections)
+		return d_ac_coupled[connection];
+
+	return false;
+}
+
+void adc_sample_conv::setAcBlockSize(size_t size)
+{
+	gr::thread::scoped_lock lock(d_setlock);
+	d_ac_block_size = std::max<size_t>(size, 1);
+}
+
+int adc_sample_conv::acOutputMultiple() const
+{
+	bool any = std::find(d_ac_coupled.begin(), d_ac_coupled.end(),
+			true) != d_ac_coupled.end();
+
+	return (any && !inverse) ? d_ac_block_size : 1;
+}
+
+float adc_sample_conv::dcOffset(int connection)
+{
+	if (connection < 0 || connection >= d_nconnections)
+		return 0.0;
+
+	gr::thread::scoped_lock lock(d_setlock);
+	return d_dc_offsets[connection];
+}
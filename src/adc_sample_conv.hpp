@@ -30,19 +30,39 @@ namespace adiscope {
 	class adc_sample_conv : public gr::sync_block
 	{
 	private:
+		/* Everything work() applies to a connection, derived from
+		 * the settings whenever one of them changes, so that the
+		 * samples always see a consistent set */
+		struct Coefficients {
+			float scale;
+			float bias;
+			bool ac_coupled;
+		};
+
 		int d_nconnections;
 		bool inverse;
+		bool raw_input;
 		std::vector<float> d_correction_gains;
 		std::vector<float> d_filter_compensations;
 		std::vector<float> d_offsets;
 		std::vector<float> d_hardware_gains;
+		std::vector<bool> d_ac_coupled;
+		std::vector<Coefficients> d_coefficients;
+		std::vector<Coefficients> d_work_coefficients;
+		std::vector<float> d_dc_offsets;
+		size_t d_ac_block_size;
 		std::shared_ptr<M2kAdc> m2k_adc;
 		void updateCorrectionGain();
+		void updateCoefficients(int connection);
 
 	public:
+		/* With raw_input set, the block takes the int16 samples of
+		 * the ADC and does the conversion to float in the same pass
+		 * that applies the gains and the offset. */
 		explicit adc_sample_conv(int nconnections,
 					 std::shared_ptr<M2kAdc> m2k_adc,
-					 bool inverse = false);
+					 bool inverse = false,
+					 bool raw_input = false);
 		~adc_sample_conv();
 
 		static float convSampleToVolts(float sample,
@@ -56,6 +76,12 @@ namespace adiscope {
 				float offset = 0,
 				float hw_gain = 0.02);
 
+		/* Scale factor applied by convSampleToVolts(), before the
+		 * offset is added */
+		static float sampleToVoltsScale(float correctionGain = 1,
+				float filterCompensation = 1,
+				float hw_gain = 0.02);
+
 		void setCorrectionGain(int connection, float gain);
 		float correctionGain(int connection);
 
@@ -68,6 +94,20 @@ namespace adiscope {
 		void setHardwareGain(int connection, float gain);
 		float hardwareGain(int connection) const;
 
+		/* AC coupling: the mean of every block of samples is
+		 * removed from it, in the same pass as the conversion.
+		 * Whole blocks need an output multiple of the block size,
+		 * which has to be set while the flowgraph is stopped. */
+		void setAcCoupling(int connection, bool enabled);
+		bool acCoupling(int connection) const;
+
+		void setAcBlockSize(size_t size);
+		int acOutputMultiple() const;
+
+		/* Mean removed from the last block of an AC coupled
+		 * connection, in volts */
+		float dcOffset(int connection);
+
 		int work(int noutput_items,
 				gr_vector_const_void_star &input_items,
 				gr_vector_void_star &output_items);
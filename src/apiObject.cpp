@@ -19,6 +19,7 @@
  */
 
 #include "apiObject.hpp"
+#include "settings_store.hpp"
 
 #include <QDebug>
 #include <QJSEngine>
@@ -28,6 +29,15 @@
 
 using namespace adiscope;
 
+bool ApiObject::dataWindow(qint64 size, qint64& offset, qint64& length)
+{
+	offset = qBound<qint64>(0, offset, size);
+	if (length < 0 || length > size - offset)
+		length = size - offset;
+
+	return length > 0;
+}
+
 ApiObject::ApiObject() : QObject(nullptr)
 {
 }
@@ -90,6 +100,16 @@ void ApiObject::load(QSettings& settings, const QString& prop,
 	settings.endArray();
 }
 
+/* Settings already in effect are not written again, the setters often
+ * reconfigure the hardware even when nothing changes */
+static bool sameValue(const QVariant& current, QVariant value)
+{
+	if (!current.isValid() || !value.convert(current.userType()))
+		return false;
+
+	return value == current;
+}
+
 void ApiObject::load_nogroup(ApiObject *obj, QSettings& settings)
 {
 	auto meta = obj->metaObject();
@@ -104,19 +124,19 @@ void ApiObject::load_nogroup(ApiObject *obj, QSettings& settings)
 		if (prop.isWritable()) {
 			if (data.canConvert<QList<bool>>()) {
 				auto list = load<bool>(settings, prop.name());
-				if (!list.empty())
+				if (!list.empty() && list != data.value<QList<bool>>())
 					prop.write(obj, QVariant::fromValue(list));
 			} else if (data.canConvert<QList<int>>()) {
 				auto list = load<int>(settings, prop.name());
-				if (!list.empty())
+				if (!list.empty() && list != data.value<QList<int>>())
 					prop.write(obj, QVariant::fromValue(list));
 			} else if (data.canConvert<QList<double>>()) {
 				auto list = load<double>(settings, prop.name());
-				if (!list.empty())
+				if (!list.empty() && list != data.value<QList<double>>())
 					prop.write(obj, QVariant::fromValue(list));
 			} else if (data.canConvert<QList<QString>>()) {
 				auto list = load<QString>(settings, prop.name());
-				if (!list.empty())
+				if (!list.empty() && list != data.value<QList<QString>>())
 					prop.write(obj, QVariant::fromValue(list));
 			} else {
 				auto value = settings.value(prop.name());
@@ -125,7 +145,7 @@ void ApiObject::load_nogroup(ApiObject *obj, QSettings& settings)
 					<< prop.name()
 					<< "value" << value;
 
-				if (!value.isNull())
+				if (!value.isNull() && !sameValue(data, value))
 					prop.write(obj, value);
 			}
 		} else {
@@ -189,9 +209,13 @@ void ApiObject::save_nogroup(ApiObject *obj, QSettings& settings)
 
 void ApiObject::load(QSettings& settings)
 {
+	SettingsStore::getInstance().import(settings, objectName());
+
 	settings.beginGroup(objectName());
 
+	beginLoad();
 	load_nogroup(this, settings);
+	endLoad();
 
 	settings.endGroup();
 
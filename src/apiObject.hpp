@@ -47,6 +47,18 @@ namespace adiscope {
 
 		void js_register(QJSEngine *engine);
 
+	protected:
+		/* Called around load(), so that the changes of the settings
+		 * can be applied as a batch (see iio_manager::hold()) */
+		virtual void beginLoad() {}
+		virtual void endLoad() {}
+
+		/* Clamp the [offset, offset + length) window of a capture
+		 * of the given size; a negative length reads up to the end.
+		 * Returns false if nothing is left to read. */
+		static bool dataWindow(qint64 size, qint64& offset,
+				qint64& length);
+
 	private:
 		template <typename T> void save(QSettings& settings,
 				const QString& prop, const QList<T>& list);
@@ -21,6 +21,7 @@
 #include "average.h"
 #include <algorithm>
 #include <cstring>
+#include <functional>
 
 using namespace adiscope;
 
@@ -62,6 +63,11 @@ unsigned int SpectrumAverage::history() const
 	return m_history_size;
 }
 
+size_t SpectrumAverage::memoryBytes() const
+{
+	return (size_t)m_data_width * sizeof(double);
+}
+
 /*
  * class AverageHistoryOne
  */
@@ -82,39 +88,34 @@ AverageHistoryN::AverageHistoryN(unsigned int data_width, unsigned int history):
 	SpectrumAverage(data_width, history), m_insert_index(0),
 	m_inserted_count(0)
 {
-	alloc_history(m_data_width, m_history_size);
+	m_history = new double[m_history_size * m_data_width];
 }
 
 AverageHistoryN::~AverageHistoryN()
 {
-	free_history();
+	delete[] m_history;
 }
 
-void AverageHistoryN::reset()
+size_t AverageHistoryN::memoryBytes() const
 {
-	m_inserted_count = 0;
-	m_insert_index = 0;
+	return SpectrumAverage::memoryBytes() +
+		(size_t)m_history_size * m_data_width * sizeof(double);
 }
 
-void AverageHistoryN::alloc_history(unsigned int data_width,
-	unsigned int history_size)
+double *AverageHistoryN::historyRow(unsigned int index) const
 {
-	m_history = new double*[history_size];
-	for (unsigned int i = 0; i < history_size; i++)
-		m_history[i] = new double[data_width];
-
+	return m_history + (size_t)index * m_data_width;
 }
 
-void AverageHistoryN::free_history()
+void AverageHistoryN::reset()
 {
-	for (unsigned int i = 0; i < m_history_size; i++)
-		delete[] m_history[i];
-	delete[] m_history;
+	m_inserted_count = 0;
+	m_insert_index = 0;
 }
 
 void AverageHistoryN::pushNewData(double *data)
 {
-	std::memcpy(m_history[m_insert_index], data,
+	std::memcpy(historyRow(m_insert_index), data,
 		m_data_width * sizeof(double));
 	m_insert_index = (m_insert_index + 1) % m_history_size;
 	m_inserted_count = std::min(m_inserted_count + 1, m_history_size);
@@ -200,101 +201,95 @@ void ExponentialAverage::pushNewData(double *data)
 }
 
 /*
- * class PeakHold
+ * class HoldHistoryN
  */
-PeakHold::PeakHold(unsigned int data_width, unsigned int history):
-	AverageHistoryN(data_width, history)
+HoldHistoryN::HoldHistoryN(unsigned int data_width, unsigned int history,
+	bool keep_max): AverageHistoryN(data_width, history),
+	m_keep_max(keep_max)
 {
+	m_queue = new unsigned int[(size_t)m_data_width * m_history_size];
+	m_queue_head = new unsigned int[m_data_width]();
+	m_queue_len = new unsigned int[m_data_width]();
 }
 
-void PeakHold::pushNewData(double *data)
+HoldHistoryN::~HoldHistoryN()
 {
-	double *peaks = m_average;
-
-	if (m_inserted_count == 0 || m_history_size == 1) {
-		std::memcpy(peaks, data, m_data_width * sizeof(double));
-	} else {
-		for (unsigned int i = 0; i < m_data_width; i++) {
-			if (data[i] > peaks[i])
-				peaks[i] = data[i];
-
-			if (m_inserted_count != m_history_size)
-				continue;
-
-			// If the value that we're about to drop (overwrite) is
-			// currently the peak we need to find a new peak
-			if (m_history[m_insert_index][i] == peaks[i])
-				peaks[i] = getPeakFromHistoryColumn(i);
-		}
-	}
-
-	// Let the base class handle the data storing
-	AverageHistoryN::pushNewData(data);
+	delete[] m_queue;
+	delete[] m_queue_head;
+	delete[] m_queue_len;
 }
 
-double PeakHold::getPeakFromHistoryColumn(unsigned int col)
+size_t HoldHistoryN::memoryBytes() const
 {
-	if (m_inserted_count < 2)
-		return m_history[0][col];
-
-	unsigned int start = (m_insert_index != 0) ? 0 : 1;
-	double peak = m_history[start][col];
-
-	for (unsigned int i = start + 1; i < m_inserted_count; i++) {
-		if (i != m_insert_index && m_history[i][col] > peak)
-			peak = m_history[i][col];
-	}
-
-	return peak;
+	return AverageHistoryN::memoryBytes() +
+		((size_t)m_history_size + 2) * m_data_width *
+		sizeof(unsigned int);
 }
 
-/*
- * class MinHold
- */
-MinHold::MinHold(unsigned int data_width, unsigned int history):
-	AverageHistoryN(data_width, history)
+void HoldHistoryN::pushNewData(double *data)
 {
+	if (m_keep_max)
+		pushExtremum(data, std::greater_equal<double>());
+	else
+		pushExtremum(data, std::less_equal<double>());
 }
 
-void MinHold::pushNewData(double *data)
+template <class Better>
+void HoldHistoryN::pushExtremum(double *data, Better better)
 {
-	double *mins = m_average;
+	const unsigned int n = m_history_size;
+	const bool full = (m_inserted_count == n);
 
-	if (m_inserted_count == 0 || m_history_size == 1) {
-		std::memcpy(mins, data, m_data_width * sizeof(double));
-	} else {
-		for (unsigned int i = 0; i < m_data_width; i++) {
-			if (data[i] < mins[i])
-				mins[i] = data[i];
+	// The new frame goes in first so the queues can refer to it
+	AverageHistoryN::pushNewData(data);
+	const unsigned int row = (m_insert_index + n - 1) % n;
 
-			if (m_inserted_count != m_history_size)
-				continue;
+	for (unsigned int i = 0; i < m_data_width; i++) {
+		unsigned int *queue = m_queue + (size_t)i * n;
+		unsigned int head = m_queue_head[i];
+		unsigned int len = m_queue_len[i];
 
-			// If the value that we're about to drop (overwrite) is
-			// currently the min we need to find a new min
-			if (m_history[m_insert_index][i] == mins[i])
-				mins[i] = getMinFromHistoryColumn(i);
+		// Drop the row that was just overwritten
+		if (full && len && queue[head] == row) {
+			head = (head + 1) % n;
+			len--;
 		}
-	}
 
-	// Let the base class handle the data storing
-	AverageHistoryN::pushNewData(data);
+		// Rows the new value dominates can never be the extremum
+		while (len && better(data[i],
+				historyRow(queue[(head + len - 1) % n])[i]))
+			len--;
+
+		queue[(head + len) % n] = row;
+		len++;
+
+		m_queue_head[i] = head;
+		m_queue_len[i] = len;
+		m_average[i] = historyRow(queue[head])[i];
+	}
 }
 
-double MinHold::getMinFromHistoryColumn(unsigned int col)
+void HoldHistoryN::reset()
 {
-	if (m_inserted_count < 2)
-		return m_history[0][col];
-
-	unsigned int start = (m_insert_index != 0) ? 0 : 1;
-	double min = m_history[start][col];
+	std::fill_n(m_queue_head, m_data_width, 0);
+	std::fill_n(m_queue_len, m_data_width, 0);
+	AverageHistoryN::reset();
+}
 
-	for (unsigned int i = start + 1; i < m_inserted_count; i++) {
-		if (i != m_insert_index && m_history[i][col] < min)
-			min = m_history[i][col];
-	}
+/*
+ * class PeakHold
+ */
+PeakHold::PeakHold(unsigned int data_width, unsigned int history):
+	HoldHistoryN(data_width, history, true)
+{
+}
 
-	return min;
+/*
+ * class MinHold
+ */
+MinHold::MinHold(unsigned int data_width, unsigned int history):
+	HoldHistoryN(data_width, history, false)
+{
 }
 
 /*
@@ -318,10 +313,12 @@ void LinearRMS::pushNewData(double *data)
 			m_sqr_sums[i] += (data[i] * data[i]);
 		}
 	} else {
+		// Contiguous rows: this loop vectorizes
+		const double *oldest = historyRow(m_insert_index);
+
 		for (unsigned int i = 0; i < m_data_width; i++) {
-			m_sqr_sums[i] -= (m_history[m_insert_index][i] *
-				m_history[m_insert_index][i]);
-			m_sqr_sums[i] += (data[i] * data[i]);
+			m_sqr_sums[i] += (data[i] * data[i]) -
+				(oldest[i] * oldest[i]);
 		}
 	}
 
@@ -364,9 +361,10 @@ void LinearAverage::pushNewData(double *data)
 			m_sums[i] += data[i];
 		}
 	} else {
+		const double *oldest = historyRow(m_insert_index);
+
 		for (unsigned int i = 0; i < m_data_width; i++) {
-			m_sums[i] -= m_history[m_insert_index][i];
-			m_sums[i] += data[i];
+			m_sums[i] += data[i] - oldest[i];
 		}
 	}
 
@@ -21,6 +21,8 @@
 #ifndef AVERAGE_H
 #define AVERAGE_H
 
+#include <cstddef>
+
 namespace adiscope {
 
 
@@ -35,6 +37,9 @@ public:
 	unsigned int dataWidth() const;
 	unsigned int history() const;
 
+	// The bytes of the averaging state
+	virtual size_t memoryBytes() const;
+
 protected:
 	unsigned int m_data_width;
 	unsigned int m_history_size;
@@ -58,15 +63,41 @@ public:
 	virtual ~AverageHistoryN();
 	virtual void pushNewData(double *data);
 	virtual void reset();
+	virtual size_t memoryBytes() const;
 
 protected:
-	double **m_history;
+	double *historyRow(unsigned int index) const;
+
+	// One contiguous block of m_history_size rows of m_data_width
+	double *m_history;
 	unsigned int m_insert_index;
 	unsigned int m_inserted_count;
+};
+
+/*
+ * Peak or min over the last m_history_size frames. Each bin keeps a
+ * monotonic queue of the rows that can still become its extremum, so a
+ * new frame costs O(1) amortized per bin instead of a column rescan.
+ */
+class HoldHistoryN: public AverageHistoryN
+{
+public:
+	HoldHistoryN(unsigned int data_width, unsigned int history,
+		bool keep_max);
+	virtual ~HoldHistoryN();
+	virtual void pushNewData(double *data);
+	virtual void reset();
+	virtual size_t memoryBytes() const;
 
 private:
-	void alloc_history(unsigned int data_width, unsigned int history_size);
-	void free_history();
+	template <class Better>
+	void pushExtremum(double *data, Better better);
+
+	bool m_keep_max;
+	// m_history_size row indices per bin, used as a ring
+	unsigned int *m_queue;
+	unsigned int *m_queue_head;
+	unsigned int *m_queue_len;
 };
 
 class PeakHoldContinuous: public AverageHistoryOne
@@ -97,24 +128,16 @@ public:
 	virtual void pushNewData(double *data);
 };
 
-class PeakHold: public AverageHistoryN
+class PeakHold: public HoldHistoryN
 {
 public:
 	PeakHold(unsigned int data_width, unsigned int history);
-	virtual void pushNewData(double *data);
-
-private:
-	double getPeakFromHistoryColumn(unsigned int col);
 };
 
-class MinHold: public AverageHistoryN
+class MinHold: public HoldHistoryN
 {
 public:
 	MinHold(unsigned int data_width, unsigned int history);
-	virtual void pushNewData(double *data);
-
-private:
-	double getMinFromHistoryColumn(unsigned int col);
 };
 
 class LinearRMS: public AverageHistoryN
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "batch_measurement.h"
+#include "measure.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+BatchMeasurement::BatchMeasurement():
+	d_frames_total(0),
+	d_frames_measured(0)
+{
+}
+
+BatchMeasurement::~BatchMeasurement()
+{
+}
+
+void BatchMeasurement::start(unsigned int nframes,
+		const std::vector<const Measure *> &templates,
+		const std::vector<Selection> &selection)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_measures.clear();
+	for (size_t i = 0; i < templates.size(); i++) {
+		Measure *measure = new Measure(i);
+
+		measure->copySettings(*templates[i]);
+
+		// Only the selection gets computed
+		for (auto &data : measure->measurments())
+			data->setEnabled(false);
+		d_measures.push_back(std::unique_ptr<Measure>(measure));
+	}
+
+	d_selection.clear();
+	for (const Selection &each : selection) {
+		if (each.first < 0 || each.first >= (int)d_measures.size() ||
+				each.second < 0 || each.second >=
+				Measure::DEFAULT_MEASUREMENT_COUNT)
+			continue;
+
+		d_measures[each.first]->measurement(each.second)->setEnabled(true);
+		d_selection.push_back(each);
+	}
+
+	d_results.clear();
+	d_results.reserve((size_t)nframes * d_selection.size());
+	d_frames_total = nframes;
+	d_frames_measured = 0;
+}
+
+void BatchMeasurement::cancel()
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_frames_total = d_frames_measured;
+}
+
+bool BatchMeasurement::done() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	return d_frames_measured >= d_frames_total;
+}
+
+unsigned int BatchMeasurement::framesMeasured() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	return d_frames_measured;
+}
+
+std::vector<double> BatchMeasurement::results() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	return d_results;
+}
+
+void BatchMeasurement::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	if (d_frames_measured >= d_frames_total || nitems <= 0)
+		return;
+
+	d_samples.resize(nitems);
+
+	for (size_t i = 0; i < d_measures.size(); i++) {
+		Measure *measure = d_measures[i].get();
+
+		if (!measure->activeMeasurementsCount())
+			continue;
+
+		if (i < channels.size()) {
+			std::copy(channels[i], channels[i] + nitems,
+					d_samples.begin());
+			measure->setDataSource(d_samples.data(), nitems);
+		}
+		measure->measure();
+
+		// The buffer is reused by the next channel
+		measure->setDataSource(nullptr, 0);
+	}
+
+	// What couldn't be measured on this frame is NaN
+	for (const Selection &each : d_selection) {
+		auto data = d_measures[each.first]->measurement(each.second);
+		d_results.push_back(data->measured() ? data->value() : NAN);
+	}
+
+	d_frames_measured++;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BATCH_MEASUREMENT_H
+#define BATCH_MEASUREMENT_H
+
+#include "frame_listener.h"
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace adiscope {
+
+class Measure;
+
+/*
+ * Measures a run of consecutive frames of the time sink right in the
+ * flowgraph thread, so that scripts can characterize many captures
+ * (segmented or not) with one call instead of a round trip through the
+ * GUI for every value.
+ *
+ * For every frame, one value per (channel, measurement id) pair of the
+ * selection is appended to the results, in the order of the selection.
+ */
+class BatchMeasurement : public frame_listener
+{
+public:
+	typedef std::pair<int, int> Selection;
+
+	BatchMeasurement();
+	~BatchMeasurement();
+
+	/* The settings of the measurements (sample rate, levels, gating)
+	 * are copied from templates, one per channel of the frames */
+	void start(unsigned int nframes,
+			const std::vector<const Measure *> &templates,
+			const std::vector<Selection> &selection);
+	void cancel();
+
+	bool done() const;
+	unsigned int framesMeasured() const;
+	std::vector<double> results() const;
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	mutable std::mutex d_mutex;
+	std::vector<std::unique_ptr<Measure>> d_measures;
+	std::vector<Selection> d_selection;
+	std::vector<double> d_samples;
+	std::vector<double> d_results;
+	unsigned int d_frames_total;
+	unsigned int d_frames_measured;
+};
+}
+
+#endif // BATCH_MEASUREMENT_H
@@ -22,12 +22,20 @@
 #include "calibration.hpp"
 #include "osc_adc.h"
 #include "hw_dac.h"
+#include "iio_attr_transaction.hpp"
 
 #include <errno.h>
 #include <QDebug>
 #include <QtGlobal>
 #include <iio.h>
 #include <QThread>
+#include <QSettings>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <cmath>
+#include <vector>
+#include <volk/volk.h>
 
 #include "calibration_api.hpp"
 
@@ -45,6 +53,7 @@ Calibration::Calibration(struct iio_context *ctx, QJSEngine *engine,
 	m_ctx(ctx),
 	m_dac_a_buffer(NULL),
 	m_dac_b_buffer(NULL),
+	m_adc_buffer(NULL),
 	m_initialized(false)
 {
 	m_api->setObjectName("calib");
@@ -57,6 +66,7 @@ Calibration::~Calibration()
 		iio_buffer_destroy(m_dac_a_buffer);
 	if (m_dac_b_buffer)
 		iio_buffer_destroy(m_dac_b_buffer);
+	adc_close_buffer();
 	delete m_api;
 }
 
@@ -161,24 +171,34 @@ void Calibration::setHardwareInCalibMode()
 		}
 	}
 
-	/* Save the previous values for sampling frequency and oversampling ratio */
-	iio_device_attr_read_double(m_m2k_adc, "sampling_frequency",
-		&adc_sampl_freq);
-	iio_device_attr_read_double(m_m2k_adc, "oversampling_ratio",
-		&adc_oversampl);
-	iio_device_attr_read_double(m_m2k_dac_a, "sampling_frequency",
+	/* Save the previous values for sampling frequency and oversampling
+	 * ratio, one transfer per device */
+	IioAttrTransaction attrs;
+
+	for (struct iio_device *dev : { m_m2k_adc, m_m2k_dac_a,
+			m_m2k_dac_b }) {
+		attrs.read(dev, "sampling_frequency");
+		attrs.read(dev, "oversampling_ratio");
+	}
+
+	attrs.commit();
+
+	attrs.valueDouble(m_m2k_adc, "sampling_frequency", &adc_sampl_freq);
+	attrs.valueDouble(m_m2k_adc, "oversampling_ratio", &adc_oversampl);
+	attrs.valueDouble(m_m2k_dac_a, "sampling_frequency",
 		&dac_a_sampl_freq);
-	iio_device_attr_read_double(m_m2k_dac_a, "oversampling_ratio",
+	attrs.valueDouble(m_m2k_dac_a, "oversampling_ratio",
 		&dac_a_oversampl);
-	iio_device_attr_read_double(m_m2k_dac_b, "sampling_frequency",
+	attrs.valueDouble(m_m2k_dac_b, "sampling_frequency",
 		&dac_b_sampl_freq);
-	iio_device_attr_read_double(m_m2k_dac_b, "oversampling_ratio",
+	attrs.valueDouble(m_m2k_dac_b, "oversampling_ratio",
 		&dac_b_oversampl);
 }
 
 void Calibration::configHwSamplerate()
 {
 	// Make sure we calibrate at the highest sample rate
+	adc_close_buffer();
 	m2k_adc->setSampleRate(1e8);
 	iio_device_attr_write_longlong(m2k_adc->iio_adc_dev(), "oversampling_ratio", 1);
 	m2k_dac_a->setSampleRate(75E6);
@@ -194,6 +214,8 @@ void Calibration::restoreHardwareFromCalibMode()
 	struct iio_channel *trigger0Mode;
 	struct iio_channel *trigger1Mode;
 
+	adc_close_buffer();
+
 	if (trigg_dev) {
 		trigger0Mode = iio_device_find_channel(trigg_dev, "voltage4",
 							false);
@@ -210,19 +232,21 @@ void Calibration::restoreHardwareFromCalibMode()
 		}
 	}
 
-	/* Restore the previous values for sampling frequency and oversampling ratio */
-	iio_device_attr_write_double(m_m2k_adc, "sampling_frequency",
-		adc_sampl_freq);
-	iio_device_attr_write_double(m_m2k_adc, "oversampling_ratio",
-		adc_oversampl);
-	iio_device_attr_write_double(m_m2k_dac_a, "sampling_frequency",
+	/* Restore the previous values for sampling frequency and
+	 * oversampling ratio, one transfer per device */
+	IioAttrTransaction attrs;
+
+	attrs.writeDouble(m_m2k_adc, "sampling_frequency", adc_sampl_freq);
+	attrs.writeDouble(m_m2k_adc, "oversampling_ratio", adc_oversampl);
+	attrs.writeDouble(m_m2k_dac_a, "sampling_frequency",
 		dac_a_sampl_freq);
-	iio_device_attr_write_double(m_m2k_dac_a, "oversampling_ratio",
+	attrs.writeDouble(m_m2k_dac_a, "oversampling_ratio",
 		dac_a_oversampl);
-	iio_device_attr_write_double(m_m2k_dac_b, "sampling_frequency",
+	attrs.writeDouble(m_m2k_dac_b, "sampling_frequency",
 		dac_b_sampl_freq);
-	iio_device_attr_write_double(m_m2k_dac_b, "oversampling_ratio",
+	attrs.writeDouble(m_m2k_dac_b, "oversampling_ratio",
 		dac_b_oversampl);
+	attrs.commit();
 }
 
 bool Calibration::calibrateADCoffset()
@@ -243,21 +267,18 @@ bool Calibration::calibrateADCoffset()
 	iio_channel_attr_write_longlong(m_ad5625_channel2, "raw", 2048);
 	iio_channel_attr_write_longlong(m_ad5625_channel3, "raw", 2048);
 
-	// Allow some time for the voltage to settle
-	QThread::msleep(50);
-
+	// Allow up to 50ms for the voltage to settle
 	const unsigned int num_samples = 1e5;
-	int16_t dataCh0[num_samples];
-	int16_t dataCh1[num_samples];
+	double avg0, avg1;
 
-	bool ret = adc_data_capture(dataCh0, dataCh1, num_samples);
-		if (!ret) {
+	bool ret = adc_average(avg0, avg1, num_samples, 50);
+	if (!ret) {
 		qDebug(CAT_CALIBRATION) << "failed to get samples";
 		return false;
 	}
 
-	int16_t ch0_avg = average(dataCh0, num_samples);
-	int16_t ch1_avg = average(dataCh1, num_samples);
+	int16_t ch0_avg = avg0;
+	int16_t ch1_avg = avg1;
 
 	// Convert from raw format to signed raw
 	int16_t tmp;
@@ -304,20 +325,15 @@ bool Calibration::calibrateADCgain()
 
 	double vref1 = 0.46172;
 	const unsigned int num_samples = 1e5;
-	int16_t dataCh0[num_samples];
-	int16_t dataCh1[num_samples];
 	double avg0, avg1;
 	bool ret;
 
-	ret = adc_data_capture(dataCh0, dataCh1, num_samples);
+	ret = adc_average(avg0, avg1, num_samples, 0);
 	if (!ret) {
 		qDebug(CAT_CALIBRATION) << "failed to get samples";
 		return false;
 	}
 
-	avg0 = average(dataCh0, num_samples);
-	avg1 = average(dataCh1, num_samples);
-
 	// Convert from raw format to signed raw
 	int16_t tmp;
 
@@ -412,6 +428,142 @@ bool Calibration::resetCalibration()
 	return true;
 }
 
+/* Past these the board is calibrated again */
+static const double cache_max_temp_drift = 3.0;
+static const int cache_max_age_days = 30;
+static const double cache_max_offset_volts = 0.005;
+
+/* A file of its own next to the settings of Scopy, the session files
+ * of the launcher are reset along with the state of the tools */
+static QString cacheFile()
+{
+	QSettings settings;
+
+	return QFileInfo(settings.fileName()).absolutePath() +
+		"/calibration.ini";
+}
+
+QString Calibration::cacheGroup() const
+{
+	const char *serial = iio_context_get_attr_value(m_ctx, "hw_serial");
+
+	return serial ? QString("calibration_cache/%1").arg(serial) : QString();
+}
+
+bool Calibration::loadCachedCalibration()
+{
+	QString group = cacheGroup();
+
+	if (!m_initialized || group.isEmpty()) {
+		return false;
+	}
+
+	const char *fw = iio_context_get_attr_value(m_ctx, "fw_version");
+	double temp = getIioDevTemp("ad9963");
+	QSettings settings(cacheFile(), QSettings::IniFormat);
+
+	settings.beginGroup(group);
+
+	QDateTime date = settings.value("date").toDateTime();
+	if (!date.isValid() ||
+			date.daysTo(QDateTime::currentDateTime()) > cache_max_age_days ||
+			settings.value("fw_version").toString() != QString(fw) ||
+			std::fabs(settings.value("temperature").toDouble() - temp) >
+			cache_max_temp_drift) {
+		return false;
+	}
+
+	m_adc_ch0_offset = settings.value("adc_ch0_offset").toInt();
+	m_adc_ch1_offset = settings.value("adc_ch1_offset").toInt();
+	m_adc_ch0_gain = settings.value("adc_ch0_gain").toDouble();
+	m_adc_ch1_gain = settings.value("adc_ch1_gain").toDouble();
+	m_dac_a_ch_offset = settings.value("dac_a_offset").toInt();
+	m_dac_b_ch_offset = settings.value("dac_b_offset").toInt();
+	m_dac_a_ch_vlsb = settings.value("dac_a_vlsb").toDouble();
+	m_dac_b_ch_vlsb = settings.value("dac_b_vlsb").toDouble();
+	settings.endGroup();
+
+	updateCorrections();
+
+	qDebug(CAT_CALIBRATION) << "Using the calibration of" << date
+				<< "at" << temp << "C";
+
+	/* What changes first with the board, the gains follow the
+	 * references and are kept */
+	if (!checkADCoffset()) {
+		qDebug(CAT_CALIBRATION) << "ADC offsets drifted, calibrating";
+		clearCachedCalibration();
+		return false;
+	}
+
+	return true;
+}
+
+void Calibration::storeCalibration()
+{
+	QString group = cacheGroup();
+
+	if (group.isEmpty()) {
+		return;
+	}
+
+	const char *fw = iio_context_get_attr_value(m_ctx, "fw_version");
+	QSettings settings(cacheFile(), QSettings::IniFormat);
+
+	settings.beginGroup(group);
+	settings.setValue("date", QDateTime::currentDateTime());
+	settings.setValue("fw_version", QString(fw));
+	settings.setValue("temperature", getIioDevTemp("ad9963"));
+	settings.setValue("adc_ch0_offset", m_adc_ch0_offset);
+	settings.setValue("adc_ch1_offset", m_adc_ch1_offset);
+	settings.setValue("adc_ch0_gain", m_adc_ch0_gain);
+	settings.setValue("adc_ch1_gain", m_adc_ch1_gain);
+	settings.setValue("dac_a_offset", m_dac_a_ch_offset);
+	settings.setValue("dac_b_offset", m_dac_b_ch_offset);
+	settings.setValue("dac_a_vlsb", m_dac_a_ch_vlsb);
+	settings.setValue("dac_b_vlsb", m_dac_b_ch_vlsb);
+	settings.endGroup();
+}
+
+void Calibration::clearCachedCalibration()
+{
+	QString group = cacheGroup();
+
+	if (!group.isEmpty()) {
+		QSettings(cacheFile(), QSettings::IniFormat).remove(group);
+	}
+}
+
+bool Calibration::checkADCoffset()
+{
+	/* The corrected offsets put the grounded inputs at 0 V */
+	setCalibrationMode(ADC_GND);
+
+	const unsigned int num_samples = 1e4;
+	double avg0, avg1;
+
+	bool ok = adc_average(avg0, avg1, num_samples, 50);
+	setCalibrationMode(NONE);
+
+	if (!ok) {
+		return false;
+	}
+
+	int16_t ch0_avg = avg0;
+	int16_t ch1_avg = avg1;
+	int16_t tmp;
+
+	tmp = ch0_avg;
+	iio_channel_convert(m_adc_channel0, (void *)&ch0_avg,
+		(const void *)&tmp);
+	tmp = ch1_avg;
+	iio_channel_convert(m_adc_channel1, (void *)&ch1_avg,
+		(const void *)&tmp);
+
+	return std::fabs(convSampleToVolts(ch0_avg)) < cache_max_offset_volts &&
+		std::fabs(convSampleToVolts(ch1_avg)) < cache_max_offset_volts;
+}
+
 void Calibration::setChannelEnableState(struct iio_channel *chn, bool en)
 {
 	if (en)
@@ -430,68 +582,204 @@ double Calibration::average(int16_t *data, size_t numElements)
 	return (sum / (double)numElements);
 }
 
-bool Calibration::adc_data_capture(int16_t *dataCh0, int16_t *dataCh1,
-	size_t num_sampl_per_chn)
+/* Samples per channel in each refill of the ADC buffer */
+static const size_t adc_block_samples = 8192;
+/* Blocks the kernel may have queued before a change of the inputs */
+static const unsigned int adc_stale_blocks = 4;
+/* Drift of the block means, in raw codes, still considered settled */
+static const double adc_settle_tolerance = 0.5;
+/* Capturing stops when both means are known within this, in raw codes */
+static const double adc_target_std_error = 0.05;
+
+Calibration::AdcStats::AdcStats():
+	mean{0, 0},
+	variance{0, 0},
+	count(0)
 {
-	if (!dataCh0 && !dataCh1) {
-		qDebug(CAT_CALIBRATION) << "At least one channels needs to be activated."
-			" Aborting calibration.";
-		return false;
+}
+
+void Calibration::AdcStats::merge(const AdcStats& other)
+{
+	size_t total = count + other.count;
+
+	if (!total) {
+		return;
+	}
+
+	/* Pairwise update of the mean and the variance */
+	for (int ch = 0; ch < 2; ch++) {
+		double delta = other.mean[ch] - mean[ch];
+		double m2 = variance[ch] * count +
+			other.variance[ch] * other.count +
+			delta * delta * count * other.count / total;
+
+		mean[ch] += delta * other.count / total;
+		variance[ch] = m2 / total;
+	}
+
+	count = total;
+}
+
+double Calibration::AdcStats::stdError(int ch) const
+{
+	if (!count) {
+		return INFINITY;
+	}
+
+	return std::sqrt(variance[ch] / count);
+}
+
+bool Calibration::adc_open_buffer()
+{
+	if (m_adc_buffer) {
+		return true;
 	}
 
 	// Store channels enable state
-	bool channel0Enabled = iio_channel_is_enabled(m_adc_channel0);
-	bool channel1Enabled = iio_channel_is_enabled(m_adc_channel1);
+	m_adc_ch0_enabled = iio_channel_is_enabled(m_adc_channel0);
+	m_adc_ch1_enabled = iio_channel_is_enabled(m_adc_channel1);
 
-	// Enable the required channels
-	setChannelEnableState(m_adc_channel0, !!dataCh0);
-	setChannelEnableState(m_adc_channel1, !!dataCh1);
+	iio_channel_enable(m_adc_channel0);
+	iio_channel_enable(m_adc_channel1);
 
-	struct iio_buffer *buffer = iio_device_create_buffer(m_m2k_adc,
-		num_sampl_per_chn, false);
+	m_adc_buffer = iio_device_create_buffer(m_m2k_adc,
+		adc_block_samples, false);
 
-	if (!buffer) {
+	if (!m_adc_buffer) {
 		qDebug(CAT_CALIBRATION) << "Could not create m2k-adc buffer!" <<
 			strerror(errno) << "Aborting calibration.";
-		setChannelEnableState(m_adc_channel0, channel0Enabled);
-		setChannelEnableState(m_adc_channel1, channel1Enabled);
+		setChannelEnableState(m_adc_channel0, m_adc_ch0_enabled);
+		setChannelEnableState(m_adc_channel1, m_adc_ch1_enabled);
 		return false;
 	}
 
-	int ret = iio_buffer_refill(buffer);
+	return true;
+}
+
+void Calibration::adc_close_buffer()
+{
+	if (!m_adc_buffer) {
+		return;
+	}
+
+	iio_buffer_destroy(m_adc_buffer);
+	m_adc_buffer = NULL;
+
+	// Restore channels enable states
+	setChannelEnableState(m_adc_channel0, m_adc_ch0_enabled);
+	setChannelEnableState(m_adc_channel1, m_adc_ch1_enabled);
+}
+
+bool Calibration::adc_capture_block(AdcStats& block)
+{
+	int ret = iio_buffer_refill(m_adc_buffer);
 
 	if (ret < 0) {
 		qDebug(CAT_CALIBRATION) << "Could not refill m2k-adc buffer! Error:" << ret <<
 			"Aborting calibration";
-		iio_buffer_destroy(buffer);
-		setChannelEnableState(m_adc_channel0, channel0Enabled);
-		setChannelEnableState(m_adc_channel1, channel1Enabled);
 		return false;
 	}
 
-	ptrdiff_t p_inc = iio_buffer_step(buffer);
-	uintptr_t p_dat;
-	uintptr_t p_end = (uintptr_t)iio_buffer_end(buffer);
-	unsigned int i;
-	for (i = 0, p_dat = (uintptr_t)iio_buffer_first(buffer, m_adc_channel0);
-			p_dat < p_end; p_dat += p_inc, i++)
-	{
-		if (dataCh0 && dataCh1) {
-			dataCh0[i] = ((int16_t*)p_dat)[0];
-			dataCh1[i] = ((int16_t*)p_dat)[1];
-
-		} else if (dataCh0) {
-			dataCh0[i] = ((int16_t*)p_dat)[0];
-		} else if (dataCh1) {
-			dataCh1[i] = ((int16_t*)p_dat)[0];
+	/* Both channels are enabled */
+	size_t n = m_adc_raw.load(m_adc_buffer,
+		{ m_adc_channel0, m_adc_channel1 });
+
+	if (!n) {
+		qDebug(CAT_CALIBRATION) << "Empty m2k-adc buffer. Aborting calibration";
+		return false;
+	}
+
+	m_adc_samples.resize(n);
+
+	for (int ch = 0; ch < 2; ch++) {
+		float mean, stddev;
+
+		volk_16i_s32f_convert_32f(m_adc_samples.data(),
+			m_adc_raw.channel(ch), 1.0f, n);
+		volk_32f_stddev_and_mean_32f_x2(&stddev, &mean,
+			m_adc_samples.data(), n);
+
+		block.mean[ch] = mean;
+		block.variance[ch] = (double)stddev * stddev;
+	}
+
+	block.count = n;
+
+	return true;
+}
+
+bool Calibration::adc_settle(unsigned int settle_ms)
+{
+	AdcStats block;
+	QElapsedTimer timer;
+
+	timer.start();
+
+	/* Anything already queued was captured before the change */
+	for (unsigned int i = 0; i < adc_stale_blocks; i++) {
+		if (!adc_capture_block(block)) {
+			return false;
 		}
 	}
 
-	iio_buffer_destroy(buffer);
+	/* Settled when the means barely moved over a tenth of the delay
+	 * allowed, capturing meanwhile instead of sleeping */
+	const qint64 window = qMax(1u, settle_ms / 10);
+	double ref0 = block.mean[0];
+	double ref1 = block.mean[1];
+	qint64 ref_time = timer.elapsed();
 
-	// Restore channels enable states
-	setChannelEnableState(m_adc_channel0, channel0Enabled);
-	setChannelEnableState(m_adc_channel1, channel1Enabled);
+	while (timer.elapsed() < settle_ms) {
+		if (!adc_capture_block(block)) {
+			return false;
+		}
+
+		if (timer.elapsed() - ref_time < window) {
+			continue;
+		}
+
+		double tol0 = qMax(adc_settle_tolerance, 4 * block.stdError(0));
+		double tol1 = qMax(adc_settle_tolerance, 4 * block.stdError(1));
+
+		if (std::fabs(block.mean[0] - ref0) < tol0 &&
+				std::fabs(block.mean[1] - ref1) < tol1) {
+			break;
+		}
+
+		ref0 = block.mean[0];
+		ref1 = block.mean[1];
+		ref_time = timer.elapsed();
+	}
+
+	return true;
+}
+
+bool Calibration::adc_average(double& avg0, double& avg1, size_t max_samples,
+	unsigned int settle_ms)
+{
+	if (!adc_open_buffer() || !adc_settle(settle_ms)) {
+		return false;
+	}
+
+	AdcStats stats;
+
+	while (stats.count < max_samples) {
+		AdcStats block;
+
+		if (!adc_capture_block(block)) {
+			return false;
+		}
+
+		stats.merge(block);
+
+		if (stats.stdError(0) < adc_target_std_error &&
+				stats.stdError(1) < adc_target_std_error) {
+			break;
+		}
+	}
+
+	avg0 = stats.mean[0];
+	avg1 = stats.mean[1];
 
 	return true;
 }
@@ -504,8 +792,7 @@ bool Calibration::fine_tune(size_t span, int16_t centerVal0, int16_t centerVal1,
 	double *averagesCh0 = new double[span + 1];
 	double *averagesCh1 = new double[span + 1];
 	double minAvg0, minAvg1;
-	int16_t *dataCh0 = new int16_t[num_samples];
-	int16_t *dataCh1 = new int16_t[num_samples];
+	double avg0, avg1;
 	int16_t offset0, offset1;
 	size_t i, i0 = 0, i1 = 0;
 	bool ret = true;
@@ -522,18 +809,16 @@ bool Calibration::fine_tune(size_t span, int16_t centerVal0, int16_t centerVal1,
 		offset0++;
 		offset1++;
 
-		// Allow some time for the voltage to settle
-		QThread::msleep(5);
-
-		ret = adc_data_capture(dataCh0, dataCh1, num_samples);
+		// Allow up to 5ms for the voltage to settle
+		ret = adc_average(avg0, avg1, num_samples, 5);
 
 		if (!ret) {
 			qDebug(CAT_CALIBRATION) << "failed to get samples";
 			goto out_cleanup;
 		}
 
-		averagesCh0[i] = qAbs(average(dataCh0, num_samples));
-		averagesCh1[i] = qAbs(average(dataCh1, num_samples));
+		averagesCh0[i] = qAbs(avg0);
+		averagesCh1[i] = qAbs(avg1);
 	}
 
 	minAvg0 = qAbs(averagesCh0[0]);
@@ -569,8 +854,6 @@ out_cleanup:
 	delete[] candidateOffsets1;
 	delete[] averagesCh0;
 	delete[] averagesCh1;
-	delete[] dataCh0;
-	delete[] dataCh1;
 	return ret;
 }
 
@@ -643,21 +926,18 @@ bool Calibration::calibrateDACoffset()
 	}
 
 
-	// Allow some time for the voltage to settle
-	QThread::msleep(50);
-
+	// Allow up to 50ms for the voltage to settle
 	const unsigned int num_samples = 1e5;
-	int16_t dataCh0[num_samples];
-	int16_t dataCh1[num_samples];
+	double avg0, avg1;
 
-	bool ret = adc_data_capture(dataCh0, dataCh1, num_samples);
-		if (!ret) {
+	bool ret = adc_average(avg0, avg1, num_samples, 50);
+	if (!ret) {
 		qDebug(CAT_CALIBRATION) << "failed to get samples";
 		return false;
 	}
 
-	int16_t ch0_avg = average(dataCh0, num_samples);
-	int16_t ch1_avg = average(dataCh1, num_samples);
+	int16_t ch0_avg = avg0;
+	int16_t ch1_avg = avg1;
 
 	// Convert from raw format to signed raw
 	int16_t tmp;
@@ -707,21 +987,18 @@ bool Calibration::calibrateDACgain()
 		return false;
 	}
 
-	// Allow some time for the voltage to settle
-	QThread::msleep(50);
-
+	// Allow up to 50ms for the voltage to settle
 	const unsigned int num_samples = 1e5;
-	int16_t dataCh0[num_samples];
-	int16_t dataCh1[num_samples];
+	double avg0, avg1;
 
-	bool ret = adc_data_capture(dataCh0, dataCh1, num_samples);
-		if (!ret) {
+	bool ret = adc_average(avg0, avg1, num_samples, 50);
+	if (!ret) {
 		qDebug(CAT_CALIBRATION) << "failed to get samples";
 		return false;
 	}
 
-	int16_t ch0_avg = average(dataCh0, num_samples);
-	int16_t ch1_avg = average(dataCh1, num_samples);
+	int16_t ch0_avg = avg0;
+	int16_t ch1_avg = avg1;
 
 	// Convert from raw format to signed raw
 	int16_t tmp;
@@ -941,13 +1218,20 @@ double Calibration::getIioDevTemp(const QString& devName) const
 		struct iio_channel *chn = iio_device_find_channel(dev, "temp0",
 			false);
 		if (chn) {
-			double offset;
-			double raw;
-			double scale;
-
-			iio_channel_attr_read_double(chn, "offset", &offset);
-			iio_channel_attr_read_double(chn, "raw", &raw);
-			iio_channel_attr_read_double(chn, "scale", &scale);
+			double offset = 0.0;
+			double raw = 0.0;
+			double scale = 0.0;
+			IioAttrTransaction attrs;
+
+			/* A single transfer for the three */
+			attrs.read(chn, "offset");
+			attrs.read(chn, "raw");
+			attrs.read(chn, "scale");
+			attrs.commit();
+
+			attrs.valueDouble(chn, "offset", &offset);
+			attrs.valueDouble(chn, "raw", &raw);
+			attrs.valueDouble(chn, "scale", &scale);
 
 			temp = (raw + offset) * scale / 1000;
 		}
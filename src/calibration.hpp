@@ -22,11 +22,13 @@
 #define CALIBRATION_HPP
 
 #include "apiObject.hpp"
+#include "deinterleaved_buffer.hpp"
 
 #include <cstdint>
 #include <cstdlib>
 #include <string>
 #include <memory>
+#include <vector>
 
 extern "C" {
 	struct iio_context;
@@ -90,6 +92,18 @@ public:
 	bool resetCalibration();
 	void updateCorrections();
 
+	/*
+	 * The values of the last calibration of this board are kept with
+	 * its firmware revision and temperature. When both still match
+	 * they are applied again, after a quick check of the ADC offsets
+	 * on the grounded inputs, instead of running calibrateAll();
+	 * false when they can not be used. Needs the hardware in
+	 * calibration mode, as calibrateAll() does.
+	 */
+	bool loadCachedCalibration();
+	void storeCalibration();
+	void clearCachedCalibration();
+
 	double getIioDevTemp(const QString& devName) const;
 
 	static void setChannelEnableState(struct iio_channel *chn, bool en);
@@ -105,10 +119,34 @@ public:
 	void dacOutputStop();
 
 private:
-	bool adc_data_capture(int16_t *dataCh0, int16_t *dataCh1,
-			      size_t num_sampl_per_chn);
+	/* Mean and variance of both ADC channels, in raw codes */
+	struct AdcStats {
+		double mean[2];
+		double variance[2];
+		size_t count;
+
+		AdcStats();
+		void merge(const AdcStats& other);
+		double stdError(int ch) const;
+	};
+
+	/*
+	 * The ADC buffer is created on the first capture and kept until
+	 * the hardware leaves calibration mode, each measurement only
+	 * refills it. adc_average() first waits for the inputs to settle,
+	 * at most settle_ms, then captures until both means are known
+	 * well enough or max_samples were read.
+	 */
+	bool adc_open_buffer();
+	void adc_close_buffer();
+	bool adc_capture_block(AdcStats& block);
+	bool adc_settle(unsigned int settle_ms);
+	bool adc_average(double& avg0, double& avg1, size_t max_samples,
+			 unsigned int settle_ms);
 	bool fine_tune(size_t span, int16_t centerVal0, int16_t centerVal1,
 		size_t num_samples);
+	bool checkADCoffset();
+	QString cacheGroup() const;
 
 	bool dacOutputDC(struct iio_device *dac, struct iio_channel *channel,
 		struct iio_buffer** buffer, size_t value);
@@ -146,6 +184,11 @@ private:
 
 	struct iio_buffer *m_dac_a_buffer;
 	struct iio_buffer *m_dac_b_buffer;
+	struct iio_buffer *m_adc_buffer;
+	bool m_adc_ch0_enabled;
+	bool m_adc_ch1_enabled;
+	DeinterleavedBuffer m_adc_raw;
+	std::vector<float> m_adc_samples;
 
 	int m_adc_ch0_offset;
 	int m_adc_ch1_offset;
@@ -0,0 +1,701 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture_archive.hpp"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace adiscope;
+
+namespace {
+const char archive_magic[8] = { 'S', 'C', 'O', 'P', 'Y', 'A', 'R', 'C' };
+const char index_magic[8] = { 'S', 'C', 'O', 'P', 'Y', 'I', 'D', 'X' };
+const uint32_t archive_version = 1;
+
+/* Raw bytes per chunk, big enough for the codecs to find repeats and
+ * small enough for a random read to stay cheap */
+const uint64_t chunk_bytes = 1 << 20;
+
+enum Codec {
+	STORED = 0,
+	ZLIB = 1,
+	ZSTD = 2,
+};
+
+/* Written as they are, the hosts Scopy runs on are little endian */
+struct Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t metadata_size;
+	double sample_rate;
+};
+
+struct Footer {
+	uint64_t index_offset;
+	uint64_t chunk_count;
+	char magic[8];
+};
+
+void put_varint(QByteArray &out, uint64_t value)
+{
+	while (value >= 0x80) {
+		out.append((char)(value | 0x80));
+		value >>= 7;
+	}
+	out.append((char)value);
+}
+
+bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value)
+{
+	value = 0;
+	for (unsigned int shift = 0; p < end && shift < 64; shift += 7) {
+		uint8_t byte = *p++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint64_t load_value(const uint8_t *p, unsigned int size)
+{
+	uint64_t value = 0;
+	memcpy(&value, p, size);
+	return value;
+}
+
+void encode(const CaptureArchive::Stream &stream, const uint8_t *in,
+	    uint64_t count, QByteArray &out)
+{
+	out.clear();
+
+	switch (stream.encoding) {
+	case CaptureArchive::ANALOG_INT16: {
+		/* Neighbour samples are close, their difference mostly
+		 * fits the low byte and the high bytes compress away */
+		out.resize(count * 2);
+		char *lo = out.data();
+		char *hi = lo + count;
+		int16_t prev = 0;
+
+		for (uint64_t i = 0; i < count; i++) {
+			int16_t sample;
+			memcpy(&sample, in + i * 2, 2);
+			int16_t delta = (int16_t)(uint16_t)(sample - prev);
+			uint16_t zz = (uint16_t)((uint16_t)delta << 1) ^
+				(delta < 0 ? 0xffff : 0);
+			lo[i] = (char)zz;
+			hi[i] = (char)(zz >> 8);
+			prev = sample;
+		}
+		break;
+	}
+	case CaptureArchive::FLOAT64:
+		out.resize(count * 8);
+		for (unsigned int b = 0; b < 8; b++) {
+			char *plane = out.data() + b * count;
+			for (uint64_t i = 0; i < count; i++) {
+				plane[i] = in[i * 8 + b];
+			}
+		}
+		break;
+	case CaptureArchive::LOGIC: {
+		const unsigned int us = stream.unit_size;
+		if (!count) {
+			break;
+		}
+
+		uint64_t value = load_value(in, us);
+		uint64_t run = 1;
+		out.append((const char *)in, us);
+
+		for (uint64_t i = 1; i < count; i++) {
+			uint64_t cur = load_value(in + i * us, us);
+			if (cur == value) {
+				run++;
+				continue;
+			}
+
+			uint64_t changed = cur ^ value;
+			put_varint(out, run);
+			out.append((const char *)&changed, us);
+			value = cur;
+			run = 1;
+		}
+		put_varint(out, run);
+		break;
+	}
+	}
+}
+
+bool decode(const CaptureArchive::Stream &stream, const QByteArray &in,
+	    uint64_t count, std::vector<uint8_t> &out)
+{
+	const uint8_t *p = (const uint8_t *)in.constData();
+	const uint8_t *end = p + in.size();
+	const unsigned int us = stream.unit_size;
+
+	out.resize(count * us);
+
+	switch (stream.encoding) {
+	case CaptureArchive::ANALOG_INT16: {
+		if ((uint64_t)in.size() != count * 2) {
+			return false;
+		}
+
+		const uint8_t *lo = p;
+		const uint8_t *hi = p + count;
+		uint16_t prev = 0;
+
+		for (uint64_t i = 0; i < count; i++) {
+			uint16_t zz = lo[i] | (hi[i] << 8);
+			uint16_t delta = (zz >> 1) ^ (uint16_t)(0 - (zz & 1));
+			prev = (uint16_t)(prev + delta);
+			memcpy(&out[i * 2], &prev, 2);
+		}
+		return true;
+	}
+	case CaptureArchive::FLOAT64:
+		if ((uint64_t)in.size() != count * 8) {
+			return false;
+		}
+
+		for (unsigned int b = 0; b < 8; b++) {
+			const uint8_t *plane = p + b * count;
+			for (uint64_t i = 0; i < count; i++) {
+				out[i * 8 + b] = plane[i];
+			}
+		}
+		return true;
+	case CaptureArchive::LOGIC: {
+		if (!count) {
+			return true;
+		}
+		if ((size_t)(end - p) < us) {
+			return false;
+		}
+
+		uint64_t value = load_value(p, us);
+		uint64_t pos = 0;
+		p += us;
+
+		for (;;) {
+			uint64_t run;
+			if (!get_varint(p, end, run) || run > count - pos) {
+				return false;
+			}
+
+			for (uint64_t i = 0; i < run; i++) {
+				memcpy(&out[(pos + i) * us], &value, us);
+			}
+			pos += run;
+
+			if (pos == count) {
+				return true;
+			}
+			if ((size_t)(end - p) < us) {
+				return false;
+			}
+			value ^= load_value(p, us);
+			p += us;
+		}
+	}
+	}
+
+	return false;
+}
+
+QByteArray compress(const QByteArray &raw, uint32_t &codec)
+{
+#ifdef HAVE_ZSTD
+	QByteArray out(ZSTD_compressBound(raw.size()), Qt::Uninitialized);
+	size_t size = ZSTD_compress(out.data(), out.size(),
+			raw.constData(), raw.size(), 1);
+
+	if (!ZSTD_isError(size) && size < (size_t)raw.size()) {
+		out.resize(size);
+		codec = ZSTD;
+		return out;
+	}
+#else
+	QByteArray out = qCompress(raw, 1);
+
+	if (out.size() < raw.size()) {
+		codec = ZLIB;
+		return out;
+	}
+#endif
+
+	codec = STORED;
+	return raw;
+}
+
+bool decompress(const QByteArray &in, uint32_t codec, uint64_t raw_size,
+		QByteArray &out)
+{
+	switch (codec) {
+	case STORED:
+		out = in;
+		break;
+	case ZLIB:
+		out = qUncompress(in);
+		break;
+#ifdef HAVE_ZSTD
+	case ZSTD: {
+		out.resize(raw_size);
+		size_t size = ZSTD_decompress(out.data(), out.size(),
+				in.constData(), in.size());
+		if (ZSTD_isError(size)) {
+			return false;
+		}
+		break;
+	}
+#endif
+	default:
+		/* Zstandard chunks in a build without it */
+		return false;
+	}
+
+	return (uint64_t)out.size() == raw_size;
+}
+}
+
+CaptureArchive::CaptureArchive() :
+	sample_rate(0),
+	cached_stream(-1),
+	cached_chunk(0)
+{
+}
+
+CaptureArchive::~CaptureArchive()
+{
+}
+
+bool CaptureArchive::write(const QString& path,
+			   const std::vector<Stream>& streams,
+			   const std::vector<StreamReader>& readers,
+			   double sample_rate, const QJsonObject& metadata,
+			   const Progress& progress)
+{
+	if (streams.size() != readers.size()) {
+		return false;
+	}
+
+	QFile out(path);
+	if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+
+	QJsonObject root = metadata;
+	QJsonArray list;
+	for (const Stream &stream : streams) {
+		QJsonObject obj;
+		obj["name"] = stream.name;
+		obj["encoding"] = (int)stream.encoding;
+		obj["unit_size"] = (int)stream.unit_size;
+		obj["samples"] = (double)stream.samples;
+		obj["scale"] = stream.scale;
+		obj["offset"] = stream.offset;
+		list.append(obj);
+	}
+	root["streams"] = list;
+
+	QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+	Header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, archive_magic, sizeof(header.magic));
+	header.version = archive_version;
+	header.metadata_size = json.size();
+	header.sample_rate = sample_rate;
+
+	bool ok = out.write((const char *)&header, sizeof(header)) ==
+		sizeof(header) && out.write(json) == json.size();
+
+	struct Job {
+		uint32_t stream;
+		uint64_t first;
+		uint64_t count;
+	};
+	std::vector<Job> jobs;
+
+	for (size_t s = 0; s < streams.size(); s++) {
+		uint64_t per_chunk = std::max<uint64_t>(1,
+				chunk_bytes / std::max(1u, streams[s].unit_size));
+		for (uint64_t first = 0; first < streams[s].samples;
+				first += per_chunk) {
+			jobs.push_back({ (uint32_t)s, first, std::min(per_chunk,
+					streams[s].samples - first) });
+		}
+	}
+
+	/*
+	 * The workers take the chunks in order, at most window ahead of
+	 * the last one written, and leave them in the slot the writer
+	 * waits on; the file is written here as they come.
+	 */
+	struct Slot {
+		QByteArray data;
+		uint32_t codec;
+		uint64_t raw_size;
+		bool ready;
+	};
+
+	const unsigned int nb_threads =
+		std::max(1u, std::thread::hardware_concurrency());
+	const size_t window = nb_threads * 2;
+	std::vector<Slot> slots(window);
+	std::mutex mutex;
+	std::condition_variable cond;
+	size_t next = 0, written = 0;
+	bool stop = false;
+
+	for (Slot &slot : slots) {
+		slot.ready = false;
+	}
+
+	auto worker = [&]() {
+		std::vector<uint8_t> raw;
+		QByteArray encoded;
+
+		for (;;) {
+			size_t i;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				cond.wait(lock, [&]() {
+					return stop || next >= jobs.size() ||
+						next < written + window;
+				});
+				if (stop || next >= jobs.size()) {
+					return;
+				}
+				i = next++;
+			}
+
+			const Job &job = jobs[i];
+			const Stream &stream = streams[job.stream];
+
+			raw.resize(job.count * stream.unit_size);
+			readers[job.stream](job.first, job.count, raw.data());
+			encode(stream, raw.data(), job.count, encoded);
+
+			uint32_t codec;
+			QByteArray data = compress(encoded, codec);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				Slot &slot = slots[i % window];
+				slot.data = data;
+				slot.codec = codec;
+				slot.raw_size = encoded.size();
+				slot.ready = true;
+			}
+			cond.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (unsigned int t = 0; ok && t < nb_threads; t++) {
+		threads.emplace_back(worker);
+	}
+
+	std::vector<ChunkEntry> entries;
+	entries.reserve(jobs.size());
+
+	for (size_t i = 0; ok && i < jobs.size(); i++) {
+		Slot slot;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cond.wait(lock, [&]() {
+				return slots[i % window].ready;
+			});
+			slot = slots[i % window];
+			slots[i % window].data.clear();
+			slots[i % window].ready = false;
+			written = i + 1;
+		}
+		cond.notify_all();
+
+		ChunkEntry entry;
+		entry.stream = jobs[i].stream;
+		entry.codec = slot.codec;
+		entry.first = jobs[i].first;
+		entry.count = jobs[i].count;
+		entry.offset = out.pos();
+		entry.size = slot.data.size();
+		entry.raw_size = slot.raw_size;
+		entries.push_back(entry);
+
+		ok = out.write(slot.data) == slot.data.size();
+
+		if (ok && progress && !progress(i + 1, jobs.size())) {
+			ok = false;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	cond.notify_all();
+	for (auto &thread : threads) {
+		thread.join();
+	}
+
+	if (ok) {
+		Footer footer;
+		footer.index_offset = out.pos();
+		footer.chunk_count = entries.size();
+		memcpy(footer.magic, index_magic, sizeof(footer.magic));
+
+		const qint64 index_size = entries.size() * sizeof(ChunkEntry);
+		ok = out.write((const char *)entries.data(), index_size) ==
+			index_size && out.write((const char *)&footer,
+					sizeof(footer)) == sizeof(footer);
+	}
+
+	out.close();
+
+	if (!ok) {
+		QFile::remove(path);
+	}
+
+	return ok;
+}
+
+bool CaptureArchive::isArchive(const QString& path)
+{
+	QFile f(path);
+	char magic[sizeof(archive_magic)];
+
+	return f.open(QIODevice::ReadOnly) &&
+		f.read(magic, sizeof(magic)) == sizeof(magic) &&
+		!memcmp(magic, archive_magic, sizeof(magic));
+}
+
+bool CaptureArchive::open(const QString& path)
+{
+	close();
+
+	file.setFileName(path);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+
+	Header header;
+	if (file.read((char *)&header, sizeof(header)) != sizeof(header) ||
+			memcmp(header.magic, archive_magic, sizeof(header.magic)) ||
+			header.version != archive_version) {
+		close();
+		return false;
+	}
+
+	QJsonObject root = QJsonDocument::fromJson(
+			file.read(header.metadata_size)).object();
+	QJsonArray list = root.take("streams").toArray();
+
+	for (const QJsonValue &value : list) {
+		QJsonObject obj = value.toObject();
+		Stream stream;
+		stream.name = obj["name"].toString();
+		stream.encoding = (Encoding)obj["encoding"].toInt();
+		stream.unit_size = obj["unit_size"].toInt();
+		stream.samples = (uint64_t)obj["samples"].toDouble();
+		stream.scale = obj["scale"].toDouble(1.0);
+		stream.offset = obj["offset"].toDouble();
+
+		if (stream.encoding > LOGIC || stream.unit_size == 0 ||
+				stream.unit_size > sizeof(uint64_t)) {
+			close();
+			return false;
+		}
+		stream_list.push_back(stream);
+	}
+
+	Footer footer;
+	if (file.size() < (qint64)sizeof(footer) ||
+			!file.seek(file.size() - sizeof(footer)) ||
+			file.read((char *)&footer, sizeof(footer)) != sizeof(footer) ||
+			memcmp(footer.magic, index_magic, sizeof(footer.magic)) ||
+			!file.seek(footer.index_offset)) {
+		close();
+		return false;
+	}
+
+	std::vector<ChunkEntry> entries(footer.chunk_count);
+	const qint64 index_size = entries.size() * sizeof(ChunkEntry);
+	if (file.read((char *)entries.data(), index_size) != index_size) {
+		close();
+		return false;
+	}
+
+	index.resize(stream_list.size());
+	for (const ChunkEntry &entry : entries) {
+		if (entry.stream >= stream_list.size()) {
+			close();
+			return false;
+		}
+		index[entry.stream].push_back(entry);
+	}
+
+	for (auto &chunks : index) {
+		std::sort(chunks.begin(), chunks.end(),
+			[](const ChunkEntry &a, const ChunkEntry &b) {
+				return a.first < b.first;
+			});
+	}
+
+	sample_rate = header.sample_rate;
+	user_metadata = root;
+
+	return true;
+}
+
+void CaptureArchive::close()
+{
+	file.close();
+	stream_list.clear();
+	index.clear();
+	user_metadata = QJsonObject();
+	sample_rate = 0;
+	cached_stream = -1;
+	cached.clear();
+}
+
+const std::vector<CaptureArchive::Stream>& CaptureArchive::streams() const
+{
+	return stream_list;
+}
+
+double CaptureArchive::sampleRate() const
+{
+	return sample_rate;
+}
+
+QJsonObject CaptureArchive::metadata() const
+{
+	return user_metadata;
+}
+
+bool CaptureArchive::loadChunk(int stream, size_t chunk)
+{
+	if (cached_stream == stream && cached_chunk == chunk) {
+		return true;
+	}
+
+	const ChunkEntry &entry = index[stream][chunk];
+	QByteArray data, raw;
+
+	cached_stream = -1;
+
+	if (!file.seek(entry.offset)) {
+		return false;
+	}
+	data = file.read(entry.size);
+
+	if ((uint64_t)data.size() != entry.size ||
+			!decompress(data, entry.codec, entry.raw_size, raw) ||
+			!decode(stream_list[stream], raw, entry.count, cached)) {
+		return false;
+	}
+
+	cached_stream = stream;
+	cached_chunk = chunk;
+
+	return true;
+}
+
+bool CaptureArchive::read(int stream, uint64_t first, uint64_t count,
+			  uint8_t *out)
+{
+	if (stream < 0 || stream >= (int)stream_list.size() ||
+			first + count > stream_list[stream].samples) {
+		return false;
+	}
+
+	const std::vector<ChunkEntry> &chunks = index[stream];
+	const unsigned int us = stream_list[stream].unit_size;
+
+	while (count) {
+		auto it = std::upper_bound(chunks.begin(), chunks.end(), first,
+			[](uint64_t sample, const ChunkEntry &entry) {
+				return sample < entry.first;
+			});
+
+		if (it == chunks.begin()) {
+			return false;
+		}
+		--it;
+
+		if (first >= it->first + it->count ||
+				!loadChunk(stream, it - chunks.begin())) {
+			return false;
+		}
+
+		uint64_t offset = first - it->first;
+		uint64_t n = std::min(count, it->count - offset);
+
+		memcpy(out, cached.data() + offset * us, n * us);
+		out += n * us;
+		first += n;
+		count -= n;
+	}
+
+	return true;
+}
+
+bool CaptureArchive::readValues(int stream, uint64_t first, uint64_t count,
+				double *out)
+{
+	if (stream < 0 || stream >= (int)stream_list.size()) {
+		return false;
+	}
+
+	const Stream &s = stream_list[stream];
+
+	switch (s.encoding) {
+	case FLOAT64:
+		return read(stream, first, count, (uint8_t *)out);
+	case ANALOG_INT16: {
+		std::vector<int16_t> codes(count);
+		if (!read(stream, first, count, (uint8_t *)codes.data())) {
+			return false;
+		}
+		for (uint64_t i = 0; i < count; i++) {
+			out[i] = s.scale * codes[i] + s.offset;
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
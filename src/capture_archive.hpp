@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_ARCHIVE_HPP
+#define CAPTURE_ARCHIVE_HPP
+
+#include <QByteArray>
+#include <QFile>
+#include <QJsonObject>
+#include <QString>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Compressed capture archive, for the captures too long to be kept as
+ * text.
+ *
+ * Each stream (a channel, or the packed samples of a logic capture) is
+ * cut into chunks of about a MiB, each encoded to suit its samples and
+ * then compressed on its own:
+ *  - ANALOG_INT16: ADC codes, as the zigzagged difference to the
+ *    previous sample, low bytes first then high bytes;
+ *  - FLOAT64: doubles, byte planes one after the other;
+ *  - LOGIC: samples of up to 8 bytes, as the run length of each value
+ *    (a varint) followed by the bits changing at its end.
+ *
+ * The chunks are encoded and compressed on all the cores while the
+ * ones already done are written in order, so writing an archive is
+ * limited by the disk rather than by the CPU. Zstandard is used when
+ * built with it, zlib otherwise; a chunk that does not shrink is
+ * stored.
+ *
+ * The index of the chunks is written after them, a reader only reads
+ * the chunks holding the samples asked for.
+ *
+ * Layout, little endian: Header, metadata json (the streams and the
+ * caller's keys), chunks, index (ChunkEntry per chunk), Footer.
+ */
+class CaptureArchive
+{
+public:
+	enum Encoding {
+		ANALOG_INT16 = 0,
+		FLOAT64 = 1,
+		LOGIC = 2,
+	};
+
+	struct Stream {
+		QString name;
+		Encoding encoding;
+		/* Bytes per sample, 2 and 8 for the analog encodings */
+		unsigned int unit_size;
+		uint64_t samples;
+		/* An ANALOG_INT16 sample is scale * code + offset */
+		double scale;
+		double offset;
+	};
+
+	/* Fills out with count samples of a stream, starting at first;
+	 * called from the compression threads */
+	typedef std::function<void(uint64_t first, uint64_t count,
+				   uint8_t *out)> StreamReader;
+	/* Chunks written out of total, returning false cancels */
+	typedef std::function<bool(size_t done, size_t total)> Progress;
+
+	CaptureArchive();
+	~CaptureArchive();
+
+	/* One reader per stream; a failed or cancelled write removes
+	 * the file */
+	static bool write(const QString& path,
+			  const std::vector<Stream>& streams,
+			  const std::vector<StreamReader>& readers,
+			  double sample_rate,
+			  const QJsonObject& metadata = QJsonObject(),
+			  const Progress& progress = Progress());
+
+	static bool isArchive(const QString& path);
+
+	bool open(const QString& path);
+	void close();
+
+	const std::vector<Stream>& streams() const;
+	double sampleRate() const;
+	/* The keys given to write() */
+	QJsonObject metadata() const;
+
+	/* Copies count samples of a stream, false if past its end or
+	 * if a chunk is corrupted */
+	bool read(int stream, uint64_t first, uint64_t count, uint8_t *out);
+
+	/* Same for an analog stream, the samples in volts */
+	bool readValues(int stream, uint64_t first, uint64_t count,
+			double *out);
+
+private:
+	struct ChunkEntry {
+		uint32_t stream;
+		uint32_t codec;
+		uint64_t first;
+		uint64_t count;
+		uint64_t offset;
+		uint64_t size;
+		/* Size once decompressed, before the decoding */
+		uint64_t raw_size;
+	};
+
+	bool loadChunk(int stream, size_t chunk);
+
+	QFile file;
+	std::vector<Stream> stream_list;
+	/* Per stream, the entries in sample order */
+	std::vector<std::vector<ChunkEntry>> index;
+	double sample_rate;
+	QJsonObject user_metadata;
+
+	/* The last chunk decoded, reads are mostly sequential */
+	int cached_stream;
+	size_t cached_chunk;
+	std::vector<uint8_t> cached;
+};
+}
+
+#endif /* CAPTURE_ARCHIVE_HPP */
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture_buffer_pool.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace adiscope;
+
+const size_t CaptureBufferPool::alignment;
+const size_t CaptureBufferPool::default_cache_limit;
+
+/* Below this the buffers come from the heap and are not kept, a mapping
+ * of their own is not worth it */
+static const size_t min_mapped = 256 * 1024;
+
+static const size_t page_size = 4096;
+
+static size_t roundUp(size_t bytes, size_t multiple)
+{
+	return (bytes + multiple - 1) / multiple * multiple;
+}
+
+/* Writing a byte of each page makes the system back all of them now */
+static void prefault(void *ptr, size_t size)
+{
+	volatile char *bytes = static_cast<volatile char *>(ptr);
+
+	for (size_t i = 0; i < size; i += page_size)
+		bytes[i] = 0;
+}
+
+void CaptureBufferPool::Deleter::operator()(void *ptr) const
+{
+	CaptureBufferPool::getInstance().release(ptr);
+}
+
+CaptureBufferPool::CaptureBufferPool() :
+	kept_bytes(0),
+	limit(default_cache_limit)
+{
+}
+
+CaptureBufferPool& CaptureBufferPool::getInstance()
+{
+	/* Never destroyed, buffers may still be released while the
+	 * other statics go away */
+	static CaptureBufferPool *Instance = new CaptureBufferPool;
+
+	return *Instance;
+}
+
+size_t CaptureBufferPool::hugePageSize()
+{
+#ifdef __linux__
+	return 2 * 1024 * 1024;
+#elif defined(_WIN32)
+	return GetLargePageMinimum();
+#else
+	return 0;
+#endif
+}
+
+CaptureBufferPool::Block CaptureBufferPool::map(size_t bytes)
+{
+	Block block = { nullptr, 0, false };
+	size_t huge = hugePageSize();
+	bool large = huge && bytes >= huge;
+
+	/* Whole huge pages only where rounding up wastes little */
+	bool whole_huge = large && roundUp(bytes, huge) - bytes <= bytes / 8;
+
+	if (bytes < min_mapped) {
+		block.size = roundUp(bytes, alignment);
+#ifdef _WIN32
+		block.ptr = _aligned_malloc(block.size, alignment);
+#else
+		if (posix_memalign(&block.ptr, alignment, block.size))
+			block.ptr = nullptr;
+#endif
+		if (!block.ptr)
+			throw std::bad_alloc();
+
+		memset(block.ptr, 0, block.size);
+		return block;
+	}
+
+	block.size = roundUp(bytes, whole_huge ? huge : page_size);
+	block.mapped = true;
+
+#ifdef __linux__
+	/* Reserved huge pages first, there are none unless configured */
+	if (whole_huge) {
+		void *ptr = mmap(nullptr, block.size, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB |
+				MAP_POPULATE, -1, 0);
+
+		if (ptr != MAP_FAILED) {
+			block.ptr = ptr;
+			return block;
+		}
+	}
+
+	/* Aligned to a huge page, so the transparent huge pages can back
+	 * it from the start; the slack around it is unmapped */
+	size_t span = block.size + (large ? huge : 0);
+	char *raw = static_cast<char *>(mmap(nullptr, span,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+			-1, 0));
+	if (raw == MAP_FAILED)
+		throw std::bad_alloc();
+
+	char *ptr = raw;
+	if (large) {
+		ptr = reinterpret_cast<char *>(roundUp(
+				reinterpret_cast<uintptr_t>(raw), huge));
+
+		size_t head = ptr - raw;
+		size_t tail = span - head - block.size;
+
+		if (head)
+			munmap(raw, head);
+		if (tail)
+			munmap(ptr + block.size, tail);
+	}
+
+#ifdef MADV_HUGEPAGE
+	/* Transparent huge pages, if the system gives them on request */
+	if (large)
+		madvise(ptr, block.size, MADV_HUGEPAGE);
+#endif
+
+	prefault(ptr, block.size);
+	block.ptr = ptr;
+#elif defined(_WIN32)
+	/* Large pages need the lock memory right, they are always
+	 * resident */
+	if (whole_huge) {
+		block.ptr = VirtualAlloc(nullptr, block.size,
+				MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+				PAGE_READWRITE);
+		if (block.ptr)
+			return block;
+	}
+
+	block.ptr = VirtualAlloc(nullptr, block.size,
+			MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (!block.ptr)
+		throw std::bad_alloc();
+
+	prefault(block.ptr, block.size);
+#else
+	block.mapped = false;
+	if (posix_memalign(&block.ptr, page_size, block.size))
+		throw std::bad_alloc();
+
+	memset(block.ptr, 0, block.size);
+#endif
+
+	return block;
+}
+
+void CaptureBufferPool::unmap(const Block& block)
+{
+	if (!block.mapped) {
+#ifdef _WIN32
+		_aligned_free(block.ptr);
+#else
+		free(block.ptr);
+#endif
+		return;
+	}
+
+#ifdef _WIN32
+	VirtualFree(block.ptr, 0, MEM_RELEASE);
+#else
+	munmap(block.ptr, block.size);
+#endif
+}
+
+void *CaptureBufferPool::allocate(size_t bytes, bool zero)
+{
+	bytes = std::max<size_t>(bytes, 1);
+
+	if (bytes >= min_mapped) {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		/* The smallest kept buffer that doesn't waste too much */
+		auto best = kept.end();
+		for (auto it = kept.begin(); it != kept.end(); ++it) {
+			if (it->size >= bytes && it->size <= bytes + bytes / 4 &&
+			    (best == kept.end() || it->size < best->size))
+				best = it;
+		}
+
+		if (best != kept.end()) {
+			Block block = *best;
+
+			kept.erase(best);
+			kept_bytes -= block.size;
+			in_use[block.ptr] = block;
+			lock.unlock();
+
+			if (zero)
+				memset(block.ptr, 0, bytes);
+
+			return block.ptr;
+		}
+	}
+
+	/* New buffers start zeroed */
+	Block block = map(bytes);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	in_use[block.ptr] = block;
+
+	return block.ptr;
+}
+
+void CaptureBufferPool::release(void *ptr)
+{
+	if (!ptr)
+		return;
+
+	std::vector<Block> removed;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = in_use.find(ptr);
+
+		assert(it != in_use.end());
+		if (it == in_use.end())
+			return;
+
+		Block block = it->second;
+		in_use.erase(it);
+
+		if (block.size >= min_mapped && block.size <= limit) {
+			kept.push_back(block);
+			kept_bytes += block.size;
+			removed = _trim(limit);
+		} else {
+			removed.push_back(block);
+		}
+	}
+
+	for (const Block& block : removed)
+		unmap(block);
+}
+
+void CaptureBufferPool::setCacheLimit(size_t bytes)
+{
+	std::vector<Block> removed;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		limit = bytes;
+		removed = _trim(limit);
+	}
+
+	for (const Block& block : removed)
+		unmap(block);
+}
+
+size_t CaptureBufferPool::cacheLimit() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return limit;
+}
+
+size_t CaptureBufferPool::cached() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return kept_bytes;
+}
+
+void CaptureBufferPool::trim()
+{
+	std::vector<Block> removed;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		removed = _trim(0);
+	}
+
+	for (const Block& block : removed)
+		unmap(block);
+}
+
+std::vector<CaptureBufferPool::Block> CaptureBufferPool::_trim(size_t bytes)
+{
+	std::vector<Block> removed;
+	auto it = kept.begin();
+
+	while (kept_bytes > bytes && it != kept.end()) {
+		kept_bytes -= it->size;
+		removed.push_back(*it);
+		++it;
+	}
+
+	kept.erase(kept.begin(), it);
+
+	return removed;
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_BUFFER_POOL_HPP
+#define CAPTURE_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * The memory of the capture buffers: the sample buffers of the scope
+ * sinks, the chunks of the logic segments and the pattern generator
+ * buffer.
+ *
+ * The large buffers are mapped on huge pages where the system has them
+ * (hugetlbfs or transparent huge pages on Linux, large pages on Windows
+ * with the lock memory right), which takes most of the TLB misses out
+ * of walking a deep capture. All the pages are faulted in when a buffer
+ * is made, not while the samples come in.
+ *
+ * The buffers given back are kept, up to the cache limit, and handed
+ * out again for a buffer of about the same size: the next acquisition
+ * of the same depth pays neither the mapping nor the faults.
+ *
+ * Every buffer is aligned for the widest SIMD loads. Thread safe.
+ */
+class CaptureBufferPool
+{
+public:
+	static const size_t alignment = 64;
+
+	/* The bytes kept for reuse unless set otherwise; the memory budget
+	 * lowers it to a part of the budget */
+	static const size_t default_cache_limit = 32 * 1024 * 1024;
+
+	/* Goes with std::unique_ptr */
+	struct Deleter {
+		void operator()(void *ptr) const;
+	};
+
+	static CaptureBufferPool& getInstance();
+
+	/* At least bytes, zeroed unless told otherwise; throws
+	 * std::bad_alloc if the system has no more memory */
+	void *allocate(size_t bytes, bool zero = true);
+
+	/* Back to the pool, nullptr does nothing */
+	void release(void *ptr);
+
+	/* The bytes kept for reuse at most, 0 to keep none */
+	void setCacheLimit(size_t bytes);
+	size_t cacheLimit() const;
+
+	size_t cached() const;
+
+	/* Gives the kept buffers back to the system */
+	void trim();
+
+private:
+	struct Block {
+		void *ptr;
+		size_t size;
+		bool mapped;
+	};
+
+	CaptureBufferPool();
+
+	static size_t hugePageSize();
+	static Block map(size_t bytes);
+	static void unmap(const Block& block);
+
+	/* Takes out the oldest kept buffers past the given bytes, to be
+	 * unmapped without the lock */
+	std::vector<Block> _trim(size_t bytes);
+
+	mutable std::mutex mutex;
+	std::unordered_map<void *, Block> in_use;
+	std::vector<Block> kept;
+	size_t kept_bytes;
+	size_t limit;
+};
+}
+
+#endif /* CAPTURE_BUFFER_POOL_HPP */
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture_latency.h"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace adiscope;
+
+CaptureLatency::CaptureLatency(unsigned int capacity):
+	d_captures(std::max(capacity, 2u)),
+	d_head(0),
+	d_count(0)
+{
+}
+
+CaptureLatency::Capture &CaptureLatency::at(unsigned int age)
+{
+	unsigned int size = d_captures.size();
+
+	return d_captures[(d_head + size - 1 - age) % size];
+}
+
+const CaptureLatency::Capture &CaptureLatency::at(unsigned int age) const
+{
+	unsigned int size = d_captures.size();
+
+	return d_captures[(d_head + size - 1 - age) % size];
+}
+
+void CaptureLatency::mark(Event event)
+{
+	int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	if (event == ARMED) {
+		Capture &capture = d_captures[d_head];
+
+		std::fill(capture.t, capture.t + EVENT_COUNT, 0);
+		capture.t[ARMED] = now;
+		d_head = (d_head + 1) % d_captures.size();
+		d_count = std::min<unsigned int>(d_count + 1,
+				d_captures.size());
+		return;
+	}
+
+	if (d_count == 0)
+		return;
+
+	if (event == PLOTTED) {
+		// The sink may already be waiting for the next one
+		for (unsigned int age = 0; age < d_count; age++) {
+			Capture &capture = at(age);
+
+			if (capture.t[ACQUIRED]) {
+				if (!capture.t[PLOTTED])
+					capture.t[PLOTTED] = now;
+				break;
+			}
+		}
+		return;
+	}
+
+	Capture &capture = at(0);
+
+	if (!capture.t[event])
+		capture.t[event] = now;
+}
+
+void CaptureLatency::clear()
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_head = 0;
+	d_count = 0;
+}
+
+unsigned int CaptureLatency::captures() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	return d_count;
+}
+
+std::vector<double> CaptureLatency::durations(Interval interval) const
+{
+	std::vector<double> values;
+
+	for (unsigned int age = d_count; age-- > 0; ) {
+		const Capture &capture = at(age);
+		int64_t begin, end;
+
+		switch (interval) {
+		case TRIGGER_WAIT:
+			begin = capture.t[ARMED];
+			end = capture.t[TRIGGERED];
+			break;
+		case TRANSFER:
+			begin = capture.t[TRIGGERED];
+			end = capture.t[ACQUIRED];
+			break;
+		case DISPLAY:
+			begin = capture.t[ACQUIRED];
+			end = capture.t[PLOTTED];
+			break;
+		case REARM:
+			if (age == 0)
+				continue;
+			begin = capture.t[ACQUIRED];
+			end = at(age - 1).t[ARMED];
+			break;
+		default:
+			continue;
+		}
+
+		if (begin && end && end >= begin)
+			values.push_back((end - begin) * 1e-9);
+	}
+
+	return values;
+}
+
+CaptureLatency::Summary CaptureLatency::summary(Interval interval,
+		unsigned int nbins) const
+{
+	std::vector<double> values;
+	Summary summary;
+
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		values = durations(interval);
+	}
+
+	nbins = std::max(nbins, 1u);
+	summary.count = values.size();
+	summary.min = summary.max = summary.mean = 0.0;
+	summary.bin_width = 0.0;
+	summary.histogram.assign(nbins, 0);
+
+	if (values.empty())
+		return summary;
+
+	auto range = std::minmax_element(values.begin(), values.end());
+	double sum = 0.0;
+
+	for (double value : values)
+		sum += value;
+
+	summary.min = *range.first;
+	summary.max = *range.second;
+	summary.mean = sum / values.size();
+
+	// The bins cover [0, max], the last one includes max
+	summary.bin_width = summary.max > 0.0 ? summary.max / nbins : 1e-9;
+	for (double value : values) {
+		unsigned int bin = value / summary.bin_width;
+
+		summary.histogram[std::min(bin, nbins - 1)]++;
+	}
+
+	return summary;
+}
+
+const char *CaptureLatency::intervalName(Interval interval)
+{
+	switch (interval) {
+	case TRIGGER_WAIT:
+		return "trigger_wait";
+	case TRANSFER:
+		return "transfer";
+	case DISPLAY:
+		return "display";
+	case REARM:
+		return "rearm";
+	default:
+		return "";
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_LATENCY_H
+#define CAPTURE_LATENCY_H
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Timestamps of the events of the last captures, kept in a ring buffer:
+ * when the sink got ready for a frame, when the frame started (trigger
+ * found), when it was complete and when the plot displayed it. The
+ * intervals between them tell where the dead time between two captures
+ * goes.
+ *
+ * The sink marks the first three events from the flowgraph thread, the
+ * oscilloscope marks the last one from the GUI thread.
+ */
+class CaptureLatency
+{
+public:
+	enum Event {
+		ARMED,
+		TRIGGERED,
+		ACQUIRED,
+		PLOTTED,
+		EVENT_COUNT,
+	};
+
+	enum Interval {
+		TRIGGER_WAIT,	// armed to triggered
+		TRANSFER,	// triggered to acquired
+		DISPLAY,	// acquired to plotted
+		REARM,		// acquired to armed for the next capture
+		INTERVAL_COUNT,
+	};
+
+	struct Summary {
+		unsigned int count;
+		double min, max, mean;	// seconds
+		double bin_width;	// seconds, bins start at 0
+		std::vector<unsigned int> histogram;
+	};
+
+	CaptureLatency(unsigned int capacity = 256);
+
+	/* ARMED starts a new capture, the other events complete it.
+	 * PLOTTED goes to the last acquired capture. */
+	void mark(Event event);
+	void clear();
+
+	unsigned int captures() const;
+
+	Summary summary(Interval interval, unsigned int nbins = 32) const;
+
+	static const char *intervalName(Interval interval);
+
+private:
+	struct Capture {
+		int64_t t[EVENT_COUNT];	// ns, 0 if not seen
+	};
+
+	mutable std::mutex d_mutex;
+	std::vector<Capture> d_captures;
+	unsigned int d_head;	// next to be written
+	unsigned int d_count;
+
+	Capture &at(unsigned int age);		// 0 is the newest
+	const Capture &at(unsigned int age) const;
+	std::vector<double> durations(Interval interval) const;
+};
+}
+
+#endif // CAPTURE_LATENCY_H
@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "capture_store.h"
+
+using namespace adiscope;
+
+CaptureStore::CaptureStore(QObject *parent) :
+	QObject(parent)
+{
+}
+
+void CaptureStore::setAnalog(
+		const std::shared_ptr<const AnalogCapture> &capture)
+{
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		d_analog = capture;
+	}
+
+	Q_EMIT analogChanged();
+}
+
+std::shared_ptr<const CaptureStore::AnalogCapture> CaptureStore::analog() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+	return d_analog;
+}
+
+void CaptureStore::setLogic(
+		const std::shared_ptr<const LogicCapture> &capture)
+{
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		d_logic = capture;
+	}
+
+	Q_EMIT logicChanged();
+}
+
+std::shared_ptr<const CaptureStore::LogicCapture> CaptureStore::logic() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+	return d_logic;
+}
+
+void CaptureStore::clear()
+{
+	setAnalog(nullptr);
+	setLogic(nullptr);
+}
+
+AnalogCaptureWriter::AnalogCaptureWriter(CaptureStore *store) :
+	d_store(store),
+	d_sample_rate(1.0),
+	d_start_time(0.0)
+{
+}
+
+void AnalogCaptureWriter::setTimebase(double sample_rate, double start_time)
+{
+	d_sample_rate = sample_rate;
+	d_start_time = start_time;
+}
+
+void AnalogCaptureWriter::frame_ready(
+		const std::vector<const float *> &channels, int nitems)
+{
+	auto capture = std::make_shared<CaptureStore::AnalogCapture>();
+
+	capture->channels.reserve(channels.size());
+	for (const float *ch : channels) {
+		capture->channels.emplace_back(ch, ch + nitems);
+	}
+
+	capture->sample_rate = d_sample_rate;
+	capture->start_time = d_start_time;
+	capture->timestamp = std::chrono::steady_clock::now();
+
+	d_store->setAnalog(capture);
+}
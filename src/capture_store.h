@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CAPTURE_STORE_H
+#define CAPTURE_STORE_H
+
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+#include "frame_listener.h"
+
+namespace pv {
+namespace data {
+class LogicSegment;
+}
+}
+
+namespace adiscope {
+
+/*
+ * The last capture of each instrument, timestamped and placed on the
+ * time axis of its trigger, so that a tool can show the data of another
+ * one on its own timebase. With the cross-instrument trigger both tools
+ * trigger on the same event and their times line up directly.
+ *
+ * Writers publish from any thread; readers get a shared pointer to an
+ * immutable capture, the logic segment may still be growing while a
+ * capture streams in.
+ */
+class CaptureStore : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef std::chrono::steady_clock::time_point Timestamp;
+
+	struct AnalogCapture {
+		std::vector<std::vector<float>> channels;
+		double sample_rate;
+		/* Time of the first sample from the trigger, in seconds */
+		double start_time;
+		Timestamp timestamp;
+	};
+
+	struct LogicCapture {
+		std::shared_ptr<pv::data::LogicSegment> segment;
+		/* The enabled channels, names indexed by channel */
+		uint64_t channel_mask;
+		QStringList channel_names;
+		double sample_rate;
+		double start_time;
+		bool triggered;
+		Timestamp timestamp;
+	};
+
+	explicit CaptureStore(QObject *parent = nullptr);
+
+	void setAnalog(const std::shared_ptr<const AnalogCapture> &capture);
+	std::shared_ptr<const AnalogCapture> analog() const;
+
+	void setLogic(const std::shared_ptr<const LogicCapture> &capture);
+	std::shared_ptr<const LogicCapture> logic() const;
+
+	void clear();
+
+Q_SIGNALS:
+	/* Emitted from the publishing thread */
+	void analogChanged();
+	void logicChanged();
+
+private:
+	mutable std::mutex d_mutex;
+	std::shared_ptr<const AnalogCapture> d_analog;
+	std::shared_ptr<const LogicCapture> d_logic;
+};
+
+/*
+ * Publishes the frames of a scope sink into a store, with the time of
+ * their first sample as the plot has it.
+ */
+class AnalogCaptureWriter : public frame_listener
+{
+public:
+	explicit AnalogCaptureWriter(CaptureStore *store);
+
+	/* Set from the GUI thread, used for the next frames */
+	void setTimebase(double sample_rate, double start_time);
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	CaptureStore *d_store;
+	std::atomic<double> d_sample_rate;
+	std::atomic<double> d_start_time;
+};
+}
+
+#endif // CAPTURE_STORE_H
@@ -20,6 +20,7 @@
 
 #include "connectDialog.hpp"
 #include "dynamicWidget.hpp"
+#include "context_cache.hpp"
 #include <QtConcurrentRun>
 #include <functional>
 
@@ -97,6 +98,7 @@ void ConnectDialog::validateInput()
 	ui->connectBtn->setDisabled(true);
 
 	QString new_uri = "ip:" + ui->hostname->text();
+	this->uri = new_uri;
 	this->ui->hostname->setDisabled(true);
 	QtConcurrent::run(std::bind(&ConnectDialog::createContext,this,new_uri));
 }
@@ -106,8 +108,7 @@ void ConnectDialog::createContext(const QString& uri)
 
 	this->parent()->installEventFilter(this);
 
-	struct iio_context *ctx_from_uri = iio_create_context_from_uri(
-	                uri.toStdString().c_str());
+	struct iio_context *ctx_from_uri = ContextCache::getInstance().take(uri);
 
 	this->parent()->removeEventFilter(this);
 
@@ -129,7 +130,8 @@ void ConnectDialog::updatePopUp(struct iio_context *ctx)
 		setDynamicProperty(ui->hostname, "valid", true);
 		ui->connectBtn->setText(tr("Add"));
 
-		iio_context_destroy(ctx);
+		/* Adding the device and connecting to it use this one */
+		ContextCache::getInstance().put(uri, ctx);
 	} else {
 		setDynamicProperty(ui->hostname, "valid", false);
 		setDynamicProperty(ui->hostname, "invalid", true);
@@ -56,6 +56,7 @@ private Q_SLOTS:
 private:
 	Ui::Connect *ui;
 	bool connected;
+	QString uri;
 	void createContext(const QString& uri);
 	bool eventFilter(QObject *watched, QEvent *event);
 };
@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "context_cache.hpp"
+
+#include <QDateTime>
+#include <QMutexLocker>
+#include <QSettings>
+
+#include <iio.h>
+
+using namespace adiscope;
+
+/* Long enough to add a device and connect to it */
+static const qint64 max_age_ms = 60000;
+static const int max_known_uris = 16;
+static const char *known_uris_key = "discovery/known_uris";
+
+/* Saved with the session, the launcher copies its ".bak" file over the
+ * settings on exit */
+static QString settingsFile()
+{
+	QSettings oldSettings;
+
+	return oldSettings.fileName() + ".bak";
+}
+
+ContextCache &ContextCache::getInstance()
+{
+	static ContextCache Instance;
+
+	return Instance;
+}
+
+ContextCache::ContextCache()
+{
+}
+
+ContextCache::~ContextCache()
+{
+	for (const Entry& entry : contexts) {
+		iio_context_destroy(entry.ctx);
+	}
+}
+
+struct iio_context *ContextCache::take(const QString& uri)
+{
+	{
+		QMutexLocker locker(&lock);
+
+		expireLocked();
+		takes[uri]++;
+
+		auto it = contexts.find(uri);
+
+		if (it != contexts.end()) {
+			struct iio_context *ctx = it->ctx;
+
+			contexts.erase(it);
+			return ctx;
+		}
+	}
+
+	return iio_create_context_from_uri(uri.toStdString().c_str());
+}
+
+void ContextCache::put(const QString& uri, struct iio_context *ctx)
+{
+	if (!ctx) {
+		return;
+	}
+
+	QMutexLocker locker(&lock);
+	auto it = contexts.find(uri);
+
+	/* Only one context per device is worth keeping */
+	if (it != contexts.end()) {
+		if (it->ctx != ctx) {
+			iio_context_destroy(it->ctx);
+		}
+		contexts.erase(it);
+	}
+
+	contexts.insert(uri, Entry{ctx, QDateTime::currentMSecsSinceEpoch()});
+	expireLocked();
+}
+
+bool ContextCache::use(const QString& uri,
+		const std::function<void(struct iio_context *)>& f)
+{
+	QMutexLocker locker(&lock);
+
+	expireLocked();
+
+	auto it = contexts.find(uri);
+
+	if (it == contexts.end()) {
+		quint64 taken = takes.value(uri);
+
+		/* Created without the lock, it takes a while over the
+		 * network */
+		locker.unlock();
+
+		struct iio_context *ctx = iio_create_context_from_uri(
+				uri.toStdString().c_str());
+
+		if (!ctx) {
+			return false;
+		}
+
+		locker.relock();
+
+		/* Connected meanwhile, with a context of its own */
+		if (takes.value(uri) != taken) {
+			locker.unlock();
+			iio_context_destroy(ctx);
+			return false;
+		}
+
+		it = contexts.find(uri);
+
+		if (it == contexts.end()) {
+			it = contexts.insert(uri, Entry{ctx,
+					QDateTime::currentMSecsSinceEpoch()});
+		} else {
+			iio_context_destroy(ctx);
+		}
+	}
+
+	f(it->ctx);
+
+	return true;
+}
+
+void ContextCache::drop(const QString& uri)
+{
+	QMutexLocker locker(&lock);
+	auto it = contexts.find(uri);
+
+	if (it != contexts.end()) {
+		iio_context_destroy(it->ctx);
+		contexts.erase(it);
+	}
+}
+
+void ContextCache::retainUsb(const QStringList& found)
+{
+	QMutexLocker locker(&lock);
+
+	for (auto it = contexts.begin(); it != contexts.end();) {
+		if (it.key().startsWith("usb:") && !found.contains(it.key())) {
+			iio_context_destroy(it->ctx);
+			it = contexts.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+void ContextCache::expireLocked()
+{
+	qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+	for (auto it = contexts.begin(); it != contexts.end();) {
+		if (now - it->stored > max_age_ms) {
+			iio_context_destroy(it->ctx);
+			it = contexts.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+QStringList ContextCache::knownUris() const
+{
+	QSettings settings(settingsFile(), QSettings::IniFormat);
+
+	return settings.value(known_uris_key).toStringList();
+}
+
+void ContextCache::remember(const QString& uri)
+{
+	QSettings settings(settingsFile(), QSettings::IniFormat);
+	QStringList uris = settings.value(known_uris_key).toStringList();
+
+	/* The most recent first */
+	uris.removeAll(uri);
+	uris.prepend(uri);
+
+	while (uris.size() > max_known_uris) {
+		uris.removeLast();
+	}
+
+	settings.setValue(known_uris_key, uris);
+}
+
+void ContextCache::forget(const QString& uri)
+{
+	QSettings settings(settingsFile(), QSettings::IniFormat);
+	QStringList uris = settings.value(known_uris_key).toStringList();
+
+	uris.removeAll(uri);
+	settings.setValue(known_uris_key, uris);
+	drop(uri);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONTEXT_CACHE_HPP
+#define CONTEXT_CACHE_HPP
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <functional>
+
+extern "C" {
+	struct iio_context;
+}
+
+namespace adiscope {
+
+/*
+ * Contexts created while devices are found, added and identified, kept
+ * for a while so that connecting reuses them instead of creating a new
+ * context each time, which on USB and network is the slow part.
+ *
+ * A context is either held here or owned by whoever took it. The URIs
+ * that connected before are remembered between runs, so the network
+ * ones can be probed again at startup.
+ */
+class ContextCache
+{
+public:
+	static ContextCache& getInstance();
+
+	/* The cached context of uri, created when there is none. The
+	 * caller owns it, nullptr when it can not be created */
+	struct iio_context *take(const QString& uri);
+
+	/* Keeps ctx for the next take() of uri */
+	void put(const QString& uri, struct iio_context *ctx);
+
+	/* Calls f with the context of uri, which stays in the cache and is
+	 * locked meanwhile: a take() waits for f rather than creating a
+	 * second context. One is created and kept when there is none,
+	 * unless uri was taken while it was being created; false if f was
+	 * not called */
+	bool use(const QString& uri,
+		 const std::function<void(struct iio_context *)>& f);
+
+	/* Destroys the context of uri, if held */
+	void drop(const QString& uri);
+
+	/* Destroys the USB contexts the last scan did not find */
+	void retainUsb(const QStringList& found);
+
+	QStringList knownUris() const;
+	void remember(const QString& uri);
+	void forget(const QString& uri);
+
+private:
+	ContextCache();
+	~ContextCache();
+
+	void expireLocked();
+
+	struct Entry {
+		struct iio_context *ctx;
+		qint64 stored;
+	};
+
+	QMutex lock;
+	QMap<QString, Entry> contexts;
+
+	/* Counts the take() of each uri, to tell if one happened */
+	QMap<QString, quint64> takes;
+};
+}
+
+#endif /* CONTEXT_CACHE_HPP */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "average.h"
+#include "cross_spectrum_sink.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+cross_spectrum_sink::cross_spectrum_sink(size_t fft_size)
+	: block("cross_spectrum_sink",
+			io_signature::make(2, 2, sizeof(gr_complex)),
+			io_signature::make(0, 0, 0)),
+	d_fft_size(fft_size),
+	d_bins(fft_size / 2),
+	d_frames(0),
+	d_row(4 * d_bins),
+	d_cross(d_bins),
+	d_power(d_bins)
+{
+	set_averaging(false, 1);
+}
+
+cross_spectrum_sink::~cross_spectrum_sink()
+{
+}
+
+void cross_spectrum_sink::set_averaging(bool exponential,
+		unsigned int history)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	history = std::max(1u, history);
+
+	if (exponential) {
+		d_average.reset(new ExponentialAverage(d_row.size(), history));
+	} else {
+		d_average.reset(new LinearAverage(d_row.size(), history));
+	}
+
+	d_frames = 0;
+}
+
+void cross_spectrum_sink::reset()
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_average->reset();
+	d_frames = 0;
+}
+
+unsigned int cross_spectrum_sink::frames() const
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	return d_frames;
+}
+
+bool cross_spectrum_sink::result(std::vector<double>& cross_power,
+		std::vector<double>& coherence,
+		std::vector<double>& phase) const
+{
+	std::vector<double> avg(d_row.size());
+
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+
+		if (!d_frames) {
+			return false;
+		}
+
+		d_average->getAverage(avg.data(), avg.size());
+	}
+
+	const double *sxx = &avg[0];
+	const double *syy = &avg[d_bins];
+	const double *re = &avg[2 * d_bins];
+	const double *im = &avg[3 * d_bins];
+
+	cross_power.resize(d_bins);
+	coherence.resize(d_bins);
+	phase.resize(d_bins);
+
+	for (size_t k = 0; k < d_bins; k++) {
+		double cross = re[k] * re[k] + im[k] * im[k];
+		double autos = sxx[k] * syy[k];
+
+		cross_power[k] = std::sqrt(cross);
+		coherence[k] = autos > 0.0 ? std::min(1.0, cross / autos) : 0.0;
+		phase[k] = std::atan2(-im[k], re[k]) * 180.0 / M_PI;
+	}
+
+	return true;
+}
+
+void cross_spectrum_sink::forecast(int noutput_items,
+		gr_vector_int &ninput_items_required)
+{
+	for (size_t k = 0; k < ninput_items_required.size(); k++) {
+		ninput_items_required[k] = d_fft_size;
+	}
+}
+
+int cross_spectrum_sink::general_work(int noutput_items,
+		gr_vector_int &ninput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	const gr_complex *x = static_cast<const gr_complex *>(input_items[0]);
+	const gr_complex *y = static_cast<const gr_complex *>(input_items[1]);
+	size_t nframes = std::min(ninput_items[0], ninput_items[1]) /
+		d_fft_size;
+
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	for (size_t f = 0; f < nframes; f++) {
+		const gr_complex *fx = &x[f * d_fft_size];
+		const gr_complex *fy = &y[f * d_fft_size];
+
+		/* Sxy = X conj(Y), the phase of X relative to Y */
+		volk_32fc_x2_multiply_conjugate_32fc(d_cross.data(), fx, fy,
+				d_bins);
+
+		volk_32fc_magnitude_squared_32f(d_power.data(), fx, d_bins);
+		std::copy(d_power.begin(), d_power.end(), d_row.begin());
+
+		volk_32fc_magnitude_squared_32f(d_power.data(), fy, d_bins);
+		std::copy(d_power.begin(), d_power.end(),
+				d_row.begin() + d_bins);
+
+		for (size_t k = 0; k < d_bins; k++) {
+			d_row[2 * d_bins + k] = d_cross[k].real();
+			d_row[3 * d_bins + k] = d_cross[k].imag();
+		}
+
+		d_average->pushNewData(d_row.data());
+		d_frames = std::min(d_frames + 1, d_average->history());
+	}
+
+	consume_each(nframes * d_fft_size);
+
+	return 0;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CROSS_SPECTRUM_SINK_HPP
+#define CROSS_SPECTRUM_SINK_HPP
+
+#include <gnuradio/block.h>
+#include <gnuradio/gr_complex.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace adiscope {
+	class SpectrumAverage;
+
+	/*
+	 * Cross power spectrum, coherence and phase of two channels, from
+	 * the complex bins of their fft_power_blocks: input 0 is X, input
+	 * 1 is Y, fft_size bins per frame, of which the first half is
+	 * used. The frames of both have to start on the same sample.
+	 *
+	 * The auto and cross spectra are averaged over the frames as the
+	 * power spectra are, with the averaging of the Spectrum Analyzer:
+	 * the coherence of a single frame is 1 everywhere, it only tells
+	 * something once several are averaged.
+	 */
+	class cross_spectrum_sink : public gr::block
+	{
+	public:
+		typedef boost::shared_ptr<cross_spectrum_sink> sptr;
+
+		explicit cross_spectrum_sink(size_t fft_size);
+		~cross_spectrum_sink();
+
+		/* Over the last history frames, or exponentially weighted;
+		 * starts the averaging over */
+		void set_averaging(bool exponential, unsigned int history);
+		void reset();
+
+		/* Frames averaged so far, up to the history */
+		unsigned int frames() const;
+
+		/* Per bin of the first half: |Sxy|, |Sxy|^2 / (Sxx Syy)
+		 * and the phase of Y relative to X in degrees. False until
+		 * a frame came. */
+		bool result(std::vector<double>& cross_power,
+				std::vector<double>& coherence,
+				std::vector<double>& phase) const;
+
+		void forecast(int noutput_items,
+				gr_vector_int &ninput_items_required);
+
+		int general_work(int noutput_items,
+				gr_vector_int &ninput_items,
+				gr_vector_const_void_star &input_items,
+				gr_vector_void_star &output_items);
+
+	private:
+		size_t d_fft_size;
+		size_t d_bins;
+
+		mutable std::mutex d_mutex;
+		std::unique_ptr<SpectrumAverage> d_average;
+		unsigned int d_frames;
+
+		/* Sxx, Syy, Re Sxy and Im Sxy of a frame, one after the
+		 * other, so that one averager does all four */
+		std::vector<double> d_row;
+		std::vector<gr_complex> d_cross;
+		std::vector<float> d_power;
+	};
+}
+
+#endif /* CROSS_SPECTRUM_SINK_HPP */
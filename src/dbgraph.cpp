@@ -26,6 +26,8 @@
 
 #include <qwt_plot_layout.h>
 
+#include <QTimer>
+
 using namespace adiscope;
 
 void dBgraph::setupCursors()
@@ -106,6 +108,7 @@ void dBgraph::setupReadouts()
 dBgraph::dBgraph(QWidget *parent) : QwtPlot(parent),
 	curve("data"),
 	reference("reference"),
+	secondary("secondary"),
 	d_cursorsCentered(false),
 	d_cursorsEnabled(false),
 	xmin(10),
@@ -113,10 +116,13 @@ dBgraph::dBgraph(QWidget *parent) : QwtPlot(parent),
 	ymin(10),
 	ymax(10),
 	d_plotPosition(0),
+	d_secondaryPosition(0),
 	numSamples(0),
 	delta_label(false),
 	d_plotBarEnabled(true)
 {
+	DisplayPlot::setupCanvas(this);
+
 	enableAxis(QwtPlot::xBottom, false);
 	enableAxis(QwtPlot::xTop, true);
 
@@ -140,6 +146,11 @@ dBgraph::dBgraph(QWidget *parent) : QwtPlot(parent),
 	reference.setYAxis(QwtPlot::yLeft);
 	reference.setPen(Qt::red, 1.5);
 
+	secondary.setRenderHint(QwtPlotItem::RenderAntialiased);
+	secondary.setXAxis(QwtPlot::xTop);
+	secondary.setYAxis(QwtPlot::yLeft);
+	secondary.setPen(QPen(QColor(74, 100, 255), 1.5, Qt::DashLine));
+
 	thickness = 1;
 
 	OscScaleEngine *scaleLeft = new OscScaleEngine;
@@ -196,7 +207,10 @@ dBgraph::dBgraph(QWidget *parent) : QwtPlot(parent),
 	zoomer->setMousePattern(QwtEventPattern::MouseSelect2,
 				Qt::RightButton, Qt::ControlModifier);
 
-	static_cast<QFrame *>(canvas())->setLineWidth(0);
+	QFrame *canvasFrame = qobject_cast<QFrame *>(canvas());
+	if (canvasFrame) {
+		canvasFrame->setLineWidth(0);
+	}
 	setContentsMargins(10, 10, 24, 20);
 
 	picker = new PlotPickerWrapper(QwtPlot::xTop,QwtPlot::yLeft,this->canvas());
@@ -227,6 +241,17 @@ dBgraph::dBgraph(QWidget *parent) : QwtPlot(parent),
 
 	setupReadouts();
 
+	d_replotTimer = new QTimer(this);
+	d_replotTimer->setSingleShot(true);
+	d_replotTimer->setInterval(1000 / 25);
+	connect(d_replotTimer, &QTimer::timeout, [=]() {
+		if (d_cursorsEnabled) {
+			onCursor1Moved(d_vBar1->transform(d_vBar1->plotCoord()).x());
+			onCursor2Moved(d_vBar2->transform(d_vBar2->plotCoord()).x());
+		}
+
+		replot();
+	});
 }
 
 dBgraph::~dBgraph()
@@ -289,12 +314,37 @@ void dBgraph::plot(double x, double y)
 
 	curve.setRawSamples(xdata.data(), ydata.data(), xdata.size());
 
-	if (d_cursorsEnabled) {
-		onCursor1Moved(d_vBar1->transform(d_vBar1->plotCoord()).x());
-		onCursor2Moved(d_vBar2->transform(d_vBar2->plotCoord()).x());
+	// Replotting for every point makes a sweep quadratic in its
+	// number of points, the pending points are drawn together instead
+	if (!d_replotTimer->isActive()) {
+		d_replotTimer->start();
 	}
+}
 
-	replot();
+void dBgraph::plotSecondary(double x, double y)
+{
+	if (xsecondary.isEmpty()) {
+		secondary.attach(this);
+	}
+
+	if (xsecondary.size() == numSamples) {
+		xsecondary[d_secondaryPosition] = x;
+		ysecondary[d_secondaryPosition] = y;
+
+		if (++d_secondaryPosition == numSamples) {
+			d_secondaryPosition = 0;
+		}
+	} else {
+		xsecondary.push_back(x);
+		ysecondary.push_back(y);
+	}
+
+	secondary.setRawSamples(xsecondary.data(), ysecondary.data(),
+				xsecondary.size());
+
+	if (!d_replotTimer->isActive()) {
+		d_replotTimer->start();
+	}
 }
 
 int dBgraph::getNumSamples() const
@@ -357,6 +407,10 @@ void dBgraph::reset()
 {
 	xdata.clear();
 	ydata.clear();
+	xsecondary.clear();
+	ysecondary.clear();
+	secondary.detach();
+	d_secondaryPosition = 0;
 	markerIntersection1->detach();
 	markerIntersection2->detach();
 	d_plotPosition = 0;
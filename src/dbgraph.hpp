@@ -25,12 +25,13 @@
 #include <qwt_plot_curve.h>
 #include <qwt_plot_marker.h>
 
-#include "customFifo.hpp"
 #include "symbol_controller.h"
 #include "plot_line_handle.h"
 #include "cursor_readouts.h"
 #include "plotpickerwrapper.h"
 
+class QTimer;
+
 namespace adiscope {
 class OscScaleDraw;
 class PrefixFormatter;
@@ -108,6 +109,10 @@ public Q_SLOTS:
 	void plot(double x, double y);
 	void reset();
 
+	/* A second curve over the same x, e.g. the distortion at each
+	 * frequency of a sweep; cleared by reset() */
+	void plotSecondary(double x, double y);
+
 	void setNumSamples(int num);
 	void setColor(const QColor& color);
 	void setThickness(int index);
@@ -157,6 +162,7 @@ protected Q_SLOTS:
 private:
 	QwtPlotCurve curve;
 	QwtPlotCurve reference;
+	QwtPlotCurve secondary;
 	QwtPlotMarker *markerIntersection1;
 	QwtPlotMarker *markerIntersection2;
 	unsigned int numSamples;
@@ -175,6 +181,12 @@ private:
 
 	QVector<double> xdata, ydata;
 	unsigned int d_plotPosition;
+	QVector<double> xsecondary, ysecondary;
+	unsigned int d_secondaryPosition;
+
+	// Points plotted during a sweep are drawn together at most
+	// once per interval of this timer
+	QTimer *d_replotTimer;
 
 	SymbolController *d_symbolCtrl;
 	VertBar *d_vBar1;
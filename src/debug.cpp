@@ -19,6 +19,12 @@
  */
 
 #include "debug.h"
+#include "iio_attr_transaction.hpp"
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrentRun>
 
 static const size_t maxAttrSize = 512;
 
@@ -311,3 +317,164 @@ struct iio_context *Debug::getIioContext(void)
 	return ctx;
 }
 
+Debug::Snapshot Debug::readDeviceAttributes(struct iio_device *device)
+{
+	IioAttrTransaction transaction;
+	Snapshot snapshot;
+	QString devName(iio_device_get_name(device));
+	unsigned int nb_channels = iio_device_get_channels_count(device);
+
+	for (unsigned int k = 0; k < iio_device_get_attrs_count(device); k++) {
+		transaction.read(device, iio_device_get_attr(device, k));
+	}
+
+	for (unsigned int j = 0; j < nb_channels; j++) {
+		struct iio_channel *ch = iio_device_get_channel(device, j);
+
+		for (unsigned int k = 0; k < iio_channel_get_attrs_count(ch); k++) {
+			transaction.read(ch, iio_channel_get_attr(ch, k));
+		}
+	}
+
+	/* The values that could not be read are left out */
+	transaction.commit();
+
+	for (unsigned int k = 0; k < iio_device_get_attrs_count(device); k++) {
+		const char *attr = iio_device_get_attr(device, k);
+		std::string value;
+
+		if (transaction.value(device, attr, value)) {
+			snapshot.insert(devName + "/Global/" + attr,
+			                QString::fromStdString(value));
+		}
+	}
+
+	for (unsigned int j = 0; j < nb_channels; j++) {
+		struct iio_channel *ch = iio_device_get_channel(device, j);
+		QString channel = QString(iio_channel_is_output(ch) ?
+		                          "output " : "input ") +
+		                  iio_channel_get_id(ch);
+
+		for (unsigned int k = 0; k < iio_channel_get_attrs_count(ch); k++) {
+			const char *attr = iio_channel_get_attr(ch, k);
+			std::string value;
+
+			if (transaction.value(ch, attr, value)) {
+				snapshot.insert(devName + "/" + channel + "/" + attr,
+				                QString::fromStdString(value));
+			}
+		}
+	}
+
+	return snapshot;
+}
+
+Debug::Snapshot Debug::snapshotAttributes() const
+{
+	QList<QFuture<Snapshot>> devices;
+	Snapshot snapshot;
+
+	if (!connected) {
+		return snapshot;
+	}
+
+	for (unsigned int i = 0; i < iio_context_get_devices_count(ctx); i++) {
+		devices << QtConcurrent::run(&Debug::readDeviceAttributes,
+		                             iio_context_get_device(ctx, i));
+	}
+
+	for (QFuture<Snapshot>& device : devices) {
+		snapshot.unite(device.result());
+	}
+
+	return snapshot;
+}
+
+Debug::Snapshot Debug::snapshotRegisters(const QString& devName,
+                const QList<uint32_t>& addresses) const
+{
+	Snapshot snapshot;
+
+	if (!connected) {
+		return snapshot;
+	}
+
+	struct iio_device *device = iio_context_find_device(ctx,
+	                            devName.toLatin1().data());
+
+	if (!device) {
+		return snapshot;
+	}
+
+	for (uint32_t address : addresses) {
+		uint32_t value;
+
+		if (iio_device_reg_read(device, address, &value) == 0) {
+			snapshot.insert(QString("%1/register/0x%2").arg(devName)
+			                .arg(address, 0, 16),
+			                QString("0x%1").arg(value, 0, 16));
+		}
+	}
+
+	return snapshot;
+}
+
+bool Debug::saveSnapshot(const Snapshot& snapshot, const QString& filename)
+{
+	QJsonObject obj;
+	QFile file(filename);
+
+	for (auto it = snapshot.constBegin(); it != snapshot.constEnd(); ++it) {
+		obj.insert(it.key(), it.value());
+	}
+
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+	return true;
+}
+
+Debug::Snapshot Debug::loadSnapshot(const QString& filename)
+{
+	Snapshot snapshot;
+	QFile file(filename);
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		return snapshot;
+	}
+
+	QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+
+	for (auto it = obj.constBegin(); it != obj.constEnd(); ++it) {
+		snapshot.insert(it.key(), it.value().toString());
+	}
+
+	return snapshot;
+}
+
+QStringList Debug::diffSnapshots(const Snapshot& before, const Snapshot& after)
+{
+	QStringList diff;
+
+	for (auto it = before.constBegin(); it != before.constEnd(); ++it) {
+		auto now = after.constFind(it.key());
+
+		if (now == after.constEnd()) {
+			diff << QString("- %1: %2").arg(it.key()).arg(it.value());
+		} else if (now.value() != it.value()) {
+			diff << QString("~ %1: %2 -> %3").arg(it.key())
+			     .arg(it.value()).arg(now.value());
+		}
+	}
+
+	for (auto it = after.constBegin(); it != after.constEnd(); ++it) {
+		if (!before.contains(it.key())) {
+			diff << QString("+ %1: %2").arg(it.key()).arg(it.value());
+		}
+	}
+
+	return diff;
+}
+
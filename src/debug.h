@@ -25,6 +25,7 @@
 #include <iio.h>
 #include <QDebug>
 #include <QVector>
+#include <QMap>
 
 namespace adiscope {
 
@@ -33,6 +34,11 @@ class Debug : public QObject
 	Q_OBJECT
 
 public:
+	/* Values by "device/channel/attribute", with the channel named as
+	 * in the channel list ("Global" for the device attributes), and
+	 * by "device/register/0x<address>" */
+	typedef QMap<QString, QString> Snapshot;
+
 	explicit Debug(QObject *parent = nullptr);
 	QStringList getDeviceList(void) const;
 	QStringList getChannelList(void) const;
@@ -56,6 +62,19 @@ public:
 	                       const QString& attribute,
 	                       const QString& value);
 
+	/* Reads the attributes of all the devices, each device on its own
+	 * thread with all its attributes in as few transfers as possible */
+	Snapshot snapshotAttributes() const;
+	Snapshot snapshotRegisters(const QString& devName,
+	                           const QList<uint32_t>& addresses) const;
+
+	static bool saveSnapshot(const Snapshot& snapshot,
+	                         const QString& filename);
+	static Snapshot loadSnapshot(const QString& filename);
+	/* One line per value added, removed or changed from before */
+	static QStringList diffSnapshots(const Snapshot& before,
+	                                 const Snapshot& after);
+
 Q_SIGNALS:
 	void channelsChanged(const QStringList channelList);
 
@@ -65,6 +84,8 @@ public Q_SLOTS:
 	void scanChannelAttributes(QString devName, QString& channel);
 
 private:
+	static Snapshot readDeviceAttributes(struct iio_device *device);
+
 	struct iio_context *ctx;
 	QStringList deviceList;
 	QStringList channelList;
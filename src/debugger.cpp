@@ -22,6 +22,7 @@
 #include "ui_debugger.h"
 #include <QDebug>
 #include <QFileDialog>
+#include <QMessageBox>
 
 
 using namespace adiscope;
@@ -353,3 +354,59 @@ void adiscope::Debugger::on_runButton_clicked()
 		qDebug()<<" - Success";
 	}
 }
+
+Debug::Snapshot adiscope::Debugger::takeSnapshot()
+{
+	Debug::Snapshot snapshot = debug.snapshotAttributes();
+
+	/* The registers of the register map currently loaded, if any */
+	snapshot.unite(debug.snapshotRegisters(ui->DevicecomboBox->currentText(),
+	                                       reg->getRegisterAddresses()));
+
+	return snapshot;
+}
+
+void adiscope::Debugger::on_snapshotButton_clicked()
+{
+	QString fileName = QFileDialog::getSaveFileName(this,
+	                   tr("Save Snapshot"), "",
+	                   tr("Snapshot (*.json)"), nullptr,
+	                   (m_useNativeDialogs ? QFileDialog::Options() :
+	                    QFileDialog::DontUseNativeDialog));
+
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	if (!Debug::saveSnapshot(takeSnapshot(), fileName)) {
+		QMessageBox::warning(this, tr("Save Snapshot"),
+		                     tr("Unable to write %1").arg(fileName));
+	}
+}
+
+void adiscope::Debugger::on_compareButton_clicked()
+{
+	QString fileName = QFileDialog::getOpenFileName(this,
+	                   tr("Compare Snapshot"), "",
+	                   tr("Snapshot (*.json)"), nullptr,
+	                   (m_useNativeDialogs ? QFileDialog::Options() :
+	                    QFileDialog::DontUseNativeDialog));
+
+	if (fileName.isEmpty()) {
+		return;
+	}
+
+	QStringList diff = Debug::diffSnapshots(Debug::loadSnapshot(fileName),
+	                                        takeSnapshot());
+
+	QMessageBox box(QMessageBox::Information, tr("Compare Snapshot"),
+	                diff.isEmpty() ? tr("No difference") :
+	                tr("%1 values differ").arg(diff.size()),
+	                QMessageBox::Ok, this);
+
+	if (!diff.isEmpty()) {
+		box.setDetailedText(diff.join("\n"));
+	}
+
+	box.exec();
+}
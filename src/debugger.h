@@ -81,7 +81,13 @@ private Q_SLOTS:
 
 	void on_runButton_clicked();
 
+	void on_snapshotButton_clicked();
+
+	void on_compareButton_clicked();
+
 private:
+	Debug::Snapshot takeSnapshot();
+
 	Ui::Debugger *ui;
 	QPushButton *menuRunButton;
 	Filter *filter;
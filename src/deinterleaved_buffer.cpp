@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "deinterleaved_buffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <iio.h>
+#include <volk/volk.h>
+
+using namespace adiscope;
+
+DeinterleavedBuffer::DeinterleavedBuffer() :
+	d_capacity(0),
+	d_size(0)
+{
+}
+
+DeinterleavedBuffer::~DeinterleavedBuffer()
+{
+	for (int16_t *buf : d_channels)
+		volk_free(buf);
+}
+
+void DeinterleavedBuffer::reserve(unsigned int nb_channels, size_t samples)
+{
+	if (nb_channels == d_channels.size() && samples <= d_capacity)
+		return;
+
+	for (int16_t *buf : d_channels)
+		volk_free(buf);
+
+	d_capacity = std::max(samples, d_capacity);
+	d_channels.assign(nb_channels, nullptr);
+
+	for (unsigned int i = 0; i < nb_channels; i++)
+		d_channels[i] = static_cast<int16_t *>(volk_malloc(
+				d_capacity * sizeof(int16_t),
+				volk_get_alignment()));
+}
+
+size_t DeinterleavedBuffer::load(struct iio_buffer *buffer,
+		const std::vector<struct iio_channel *>& channels,
+		size_t max_samples)
+{
+	d_size = 0;
+	if (channels.empty())
+		return 0;
+
+	ptrdiff_t step = iio_buffer_step(buffer);
+	uintptr_t first = (uintptr_t)iio_buffer_first(buffer, channels[0]);
+	uintptr_t end = (uintptr_t)iio_buffer_end(buffer);
+	size_t len = step > 0 && end > first ? (end - first) / step : 0;
+
+	len = std::min(len, max_samples);
+	reserve(channels.size(), len);
+
+	if (channels.size() == 2 && step == 2 * sizeof(int16_t) &&
+			(uintptr_t)iio_buffer_first(buffer, channels[1]) ==
+			first + sizeof(int16_t)) {
+		volk_16ic_deinterleave_16i_x2(d_channels[0], d_channels[1],
+				(const lv_16sc_t *)first, len);
+	} else {
+		for (size_t ch = 0; ch < channels.size(); ch++) {
+			uintptr_t src = (uintptr_t)iio_buffer_first(buffer,
+					channels[ch]);
+			int16_t *dst = d_channels[ch];
+
+			for (size_t i = 0; i < len; i++, src += step)
+				memcpy(&dst[i], (const void *)src,
+				       sizeof(int16_t));
+		}
+	}
+
+	d_size = len;
+	return len;
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEINTERLEAVED_BUFFER_HPP
+#define DEINTERLEAVED_BUFFER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+	struct iio_buffer;
+	struct iio_channel;
+}
+
+namespace adiscope {
+
+/*
+ * The 16 bit samples of some channels of a refilled IIO buffer, one
+ * aligned array per channel, for the tools reading the ADC buffers
+ * directly instead of going through the flowgraph.
+ *
+ * Two channels packed next to each other, the layout of the M2K ADC
+ * with both channels enabled, go through the VOLK deinterleave kernel;
+ * any other layout through iio_buffer_step(). The arrays are kept from
+ * one load to the next, so a capture loop doesn't allocate.
+ */
+class DeinterleavedBuffer
+{
+public:
+	DeinterleavedBuffer();
+	~DeinterleavedBuffer();
+
+	DeinterleavedBuffer(const DeinterleavedBuffer&) = delete;
+	DeinterleavedBuffer& operator=(const DeinterleavedBuffer&) = delete;
+
+	/* Samples of the given channels, in that order; returns the number
+	 * of samples per channel, which is at most max_samples */
+	size_t load(struct iio_buffer *buffer,
+		    const std::vector<struct iio_channel *>& channels,
+		    size_t max_samples = SIZE_MAX);
+
+	size_t size() const { return d_size; }
+	unsigned int channelCount() const { return d_channels.size(); }
+	const int16_t *channel(unsigned int index) const
+	{
+		return d_channels[index];
+	}
+	const int16_t *const *channels() const { return d_channels.data(); }
+
+private:
+	void reserve(unsigned int nb_channels, size_t samples);
+
+	std::vector<int16_t *> d_channels;
+	size_t d_capacity;
+	size_t d_size;
+};
+
+} /* namespace adiscope */
+
+#endif /* DEINTERLEAVED_BUFFER_HPP */
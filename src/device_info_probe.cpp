@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "device_info_probe.hpp"
+#include "context_cache.hpp"
+
+#include <QApplication>
+#include <QMutexLocker>
+#include <QtConcurrentRun>
+
+#include <iio.h>
+
+using namespace adiscope;
+
+DeviceInfoProbe::DeviceInfoProbe(QObject *parent) :
+	QObject(parent)
+{
+	/* One device at a time, a slow one doesn't hold a thread per
+	 * request */
+	worker.setMaxThreadCount(1);
+}
+
+DeviceInfoProbe::~DeviceInfoProbe()
+{
+	worker.waitForDone();
+}
+
+DeviceInfoProbe *DeviceInfoProbe::instance()
+{
+	/* Goes away with the application, after the pages */
+	static DeviceInfoProbe *probe = new DeviceInfoProbe(qApp);
+
+	return probe;
+}
+
+bool DeviceInfoProbe::cached(const QString& uri, Info& info) const
+{
+	QMutexLocker locker(&lock);
+	auto it = infos.find(uri);
+
+	if (it == infos.end())
+		return false;
+
+	info = *it;
+	return true;
+}
+
+void DeviceInfoProbe::request(const QString& uri)
+{
+	{
+		QMutexLocker locker(&lock);
+
+		if (pending.contains(uri))
+			return;
+
+		pending.insert(uri);
+	}
+
+	QtConcurrent::run(&worker, this, &DeviceInfoProbe::probe, uri);
+}
+
+bool DeviceInfoProbe::read(const QString& uri, struct iio_context *ctx,
+		Info& info)
+{
+	if (!readContext(ctx, info))
+		return false;
+
+	QMutexLocker locker(&lock);
+	infos[uri] = info;
+
+	return true;
+}
+
+bool DeviceInfoProbe::readContext(struct iio_context *ctx, Info& info)
+{
+	char git_tag[8];
+
+	if (iio_context_get_version(ctx, &info.major, &info.minor, git_tag))
+		return false;
+
+	info.description = QString::fromUtf8(iio_context_get_description(ctx));
+	info.attributes.clear();
+
+	unsigned int count = iio_context_get_attrs_count(ctx);
+	for (unsigned int i = 0; i < count; i++) {
+		const char *name;
+		const char *value;
+
+		if (!iio_context_get_attr(ctx, i, &name, &value)) {
+			info.attributes.append(qMakePair(
+					QString::fromUtf8(name),
+					QString::fromUtf8(value)));
+		}
+	}
+
+	return true;
+}
+
+void DeviceInfoProbe::probe(const QString& uri)
+{
+	Info info;
+	bool found = false;
+
+	/* Read in the cache, where connecting finds the context */
+	ContextCache::getInstance().use(uri, [&](struct iio_context *ctx) {
+		found = readContext(ctx, info);
+	});
+
+	{
+		QMutexLocker locker(&lock);
+
+		pending.remove(uri);
+		if (found)
+			infos[uri] = info;
+	}
+
+	if (found)
+		Q_EMIT infoReady(uri);
+}
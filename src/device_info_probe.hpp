@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DEVICE_INFO_PROBE_HPP
+#define DEVICE_INFO_PROBE_HPP
+
+#include <QList>
+#include <QMap>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QString>
+#include <QThreadPool>
+
+extern "C" {
+	struct iio_context;
+}
+
+namespace adiscope {
+
+/*
+ * Reads what the homepage shows about the devices (the IIO version,
+ * the description and the context attributes) on a worker thread, all
+ * of a device in one go, and keeps the last of each for the pages to
+ * show at once.
+ *
+ * Creating the context is what costs over the network, the worker reads
+ * it in the ContextCache and leaves it there for the next read and for
+ * connecting; a device connected while its context was being created
+ * keeps its own. The devices are read one at a time.
+ */
+class DeviceInfoProbe : public QObject
+{
+	Q_OBJECT
+
+public:
+	struct Info {
+		unsigned int major;
+		unsigned int minor;
+		QString description;
+		QList<QPair<QString, QString>> attributes;
+	};
+
+	static DeviceInfoProbe *instance();
+
+	/* The last info read of uri; false if it was never read */
+	bool cached(const QString& uri, Info& info) const;
+
+	/* Reads the info of uri on the worker, then infoReady(); a request
+	 * for a uri already waiting is not queued again */
+	void request(const QString& uri);
+
+	/* Read from a context the caller holds, on the calling thread;
+	 * the result is cached for uri */
+	bool read(const QString& uri, struct iio_context *ctx, Info& info);
+
+Q_SIGNALS:
+	/* From the worker thread */
+	void infoReady(const QString& uri);
+
+private:
+	explicit DeviceInfoProbe(QObject *parent = nullptr);
+	~DeviceInfoProbe();
+
+	static bool readContext(struct iio_context *ctx, Info& info);
+	void probe(const QString& uri);
+
+	QThreadPool worker;
+	mutable QMutex lock;
+	QMap<QString, Info> infos;
+	QSet<QString> pending;
+};
+}
+
+#endif /* DEVICE_INFO_PROBE_HPP */
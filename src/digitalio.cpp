@@ -105,6 +105,7 @@ void DigitalIO::setDirection()
 	auto direction = static_cast<QPushButton *>(sender())->isChecked();
 	auto ch = sender()->parent()->property("dio").toInt();
 	setDirection(ch,direction);
+	updateUi(last_gpi);
 }
 
 void DigitalIO::setOutput(int ch, int out)
@@ -116,10 +117,12 @@ void DigitalIO::setOutput(int ch, int out)
 
 void DigitalIO::setVisible(bool visible)
 {
-	if (visible)
-		poll->start(polling_rate);
-	else
-		poll->stop();
+	if (monitor) {
+		if (visible)
+			monitor->start(polling_rate);
+		else
+			monitor->stop();
+	}
 	Tool::setVisible(visible);
 }
 
@@ -135,6 +138,8 @@ void DigitalIO::setSlider(int val)
 		setOutput(i+v*8, output);
 		findIndividualUi(i+v*8)->second->output->setChecked(output);
 	}
+
+	updateUi(last_gpi);
 }
 
 void DigitalIO::setOutput()
@@ -146,6 +151,8 @@ void DigitalIO::setOutput()
 	if (diom->getDirection(ch) && diom->getOutputEnabled()) { // only if output
 		setDynamicProperty(findIndividualUi(ch)->second->input,"high",output);
 	}
+
+	updateUi(last_gpi);
 }
 
 DigitalIO::DigitalIO(struct iio_context *ctx, Filter *filt, ToolMenuItem *toolMenuItem,
@@ -154,7 +161,9 @@ DigitalIO::DigitalIO(struct iio_context *ctx, Filter *filt, ToolMenuItem *toolMe
 	Tool(ctx, toolMenuItem, new DigitalIO_API(this), "Digital IO", parent),
 	ui(new Ui::DigitalIO),
 	offline_mode(offline_mode),
-	diom(diom)
+	monitor(nullptr),
+	diom(diom),
+	last_gpi(0)
 {
 
 	// UI
@@ -172,10 +181,11 @@ DigitalIO::DigitalIO(struct iio_context *ctx, Filter *filt, ToolMenuItem *toolMe
 	if (!offline_mode) {
 		connect(diom,SIGNAL(locked()),this,SLOT(lockUi()));
 		connect(diom,SIGNAL(unlocked()),this,SLOT(lockUi()));
-	}
 
-	poll = new QTimer(this);
-	connect(poll,SIGNAL(timeout()),this,SLOT(updateUi()));
+		/* The widgets only get updated when an input changes */
+		monitor = new DigitalIoMonitor(ctx, filt, diom, this);
+		connect(monitor, SIGNAL(changed(int)), this, SLOT(updateUi(int)));
+	}
 
 	api->setObjectName(QString::fromStdString(Filter::tool_name(
 	                               TOOL_DIGITALIO)));
@@ -188,6 +198,7 @@ DigitalIO::DigitalIO(struct iio_context *ctx, Filter *filt, ToolMenuItem *toolMe
 DigitalIO::~DigitalIO()
 {
 	if (!offline_mode) {
+		monitor->stop();
 	}
 
 	if (saveOnExit) {
@@ -219,7 +230,15 @@ QPair<QWidget *,Ui::dioChannel *> *DigitalIO::findIndividualUi(int ch)
 void DigitalIO::updateUi()
 {
 	if (!offline_mode) {
-		auto gpi = diom->getGpi();
+		updateUi(diom->getGpi());
+	}
+}
+
+void DigitalIO::updateUi(int gpi)
+{
+	last_gpi = gpi;
+
+	if (!offline_mode) {
 		auto gpigrp1 = gpi & 0xff;
 		auto gpigrp2 = (gpi & 0xff00) >> 8;
 
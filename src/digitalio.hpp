@@ -28,9 +28,9 @@
 #include <string>
 #include <QList>
 #include <QPair>
-#include <QTimer>
 #include "filter.hpp"
 #include "digitalchannel_manager.hpp"
+#include "digitalio_monitor.hpp"
 
 #include "apiObject.hpp"
 #include "tool.hpp"
@@ -93,9 +93,10 @@ private:
 	Filter *filt;
 	bool offline_mode;
 	QList<DigitalIoGroup *> groups;
-	QTimer *poll;
+	DigitalIoMonitor *monitor;
 	DIOManager *diom;
-	int polling_rate = 500; // ms
+	int polling_rate = 10; // ms
+	int last_gpi;
 
 	QPair<QWidget *,Ui::dioChannel *>  *findIndividualUi(int ch);
 
@@ -112,6 +113,7 @@ public Q_SLOTS:
 	void run() override;
 	void stop() override;
 	void updateUi();
+	void updateUi(int gpi);
 	void setDirection();
 	void setOutput();
 	void setSlider(int val);
@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iio.h>
+
+#include <chrono>
+#include <cstring>
+
+#include "digitalio_monitor.hpp"
+#include "digitalchannel_manager.hpp"
+#include "filter.hpp"
+
+using namespace adiscope;
+
+DigitalIoMonitor::DigitalIoMonitor(struct iio_context *ctx, Filter *filt,
+                                   DIOManager *diom, QObject *parent) :
+	QObject(parent),
+	diom(diom),
+	dev(filt->find_device(ctx, TOOL_LOGIC_ANALYZER)),
+	running(false),
+	buffered(false),
+	interval_ms(10)
+{
+}
+
+DigitalIoMonitor::~DigitalIoMonitor()
+{
+	stop();
+}
+
+void DigitalIoMonitor::start(unsigned int interval_ms)
+{
+	stop();
+
+	this->interval_ms = interval_ms;
+	buffered = dev != nullptr;
+	running = true;
+	thread = std::thread(&DigitalIoMonitor::run, this);
+}
+
+void DigitalIoMonitor::stop()
+{
+	running = false;
+
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+void DigitalIoMonitor::setInterval(unsigned int interval_ms)
+{
+	this->interval_ms = interval_ms;
+}
+
+bool DigitalIoMonitor::isBuffered() const
+{
+	return buffered;
+}
+
+void DigitalIoMonitor::enableChannels()
+{
+	for (unsigned int i = 0; i < iio_device_get_channels_count(dev); i++) {
+		struct iio_channel *chn = iio_device_get_channel(dev, i);
+
+		if (!iio_channel_is_output(chn) &&
+		    iio_channel_is_scan_element(chn)) {
+			iio_channel_enable(chn);
+		}
+	}
+}
+
+bool DigitalIoMonitor::readBuffer(int& gpi, bool& busy)
+{
+	enableChannels();
+
+	struct iio_buffer *buffer = iio_device_create_buffer(dev,
+			buffer_samples, false);
+
+	busy = !buffer;
+	if (!buffer) {
+		return false;
+	}
+
+	bool ok = iio_buffer_refill(buffer) > 0;
+
+	if (ok) {
+		ptrdiff_t step = iio_buffer_step(buffer);
+		const char *end = (const char *)iio_buffer_end(buffer);
+		uint16_t sample;
+
+		/* The newest state of the pins */
+		memcpy(&sample, end - step, sizeof(sample));
+		gpi = sample;
+	}
+
+	iio_buffer_destroy(buffer);
+
+	return ok;
+}
+
+int DigitalIoMonitor::readAttributes() const
+{
+	int gpi = 0;
+
+	for (int i = 0; i < 16; i++) {
+		gpi |= diom->getInRaw(i) << i;
+	}
+
+	return gpi;
+}
+
+void DigitalIoMonitor::run()
+{
+	int last = -1;
+
+	while (running) {
+		int gpi;
+		bool busy = false;
+
+		if (!buffered || !readBuffer(gpi, busy)) {
+			if (!busy) {
+				buffered = false;
+			}
+
+			gpi = readAttributes();
+		}
+
+		if (gpi != last) {
+			last = gpi;
+			Q_EMIT changed(gpi);
+		}
+
+		std::this_thread::sleep_for(
+			std::chrono::milliseconds(interval_ms.load()));
+	}
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DIGITALIO_MONITOR_HPP
+#define DIGITALIO_MONITOR_HPP
+
+#include <QObject>
+
+#include <atomic>
+#include <thread>
+
+extern "C" {
+	struct iio_context;
+	struct iio_device;
+}
+
+namespace adiscope {
+class DIOManager;
+class Filter;
+
+/*
+ * Samples the 16 digital inputs on a worker thread and signals the
+ * GUI only when they change, so the sampling interval doesn't depend
+ * on the refresh of the widgets.
+ *
+ * All the inputs come from a single transfer: a short capture of the
+ * logic analyzer, whose last sample holds the state of every pin.
+ * The buffer is only held for the capture, so the Logic Analyzer can
+ * take the device at any time; while it owns it, the pins are read
+ * one "raw" attribute at a time instead. A capture that doesn't come
+ * back (a trigger is armed on the device) disables the buffered
+ * reads until the next start().
+ */
+class DigitalIoMonitor : public QObject
+{
+	Q_OBJECT
+
+public:
+	DigitalIoMonitor(struct iio_context *ctx, Filter *filt,
+	                 DIOManager *diom, QObject *parent = nullptr);
+	~DigitalIoMonitor();
+
+	void start(unsigned int interval_ms);
+	void stop();
+	void setInterval(unsigned int interval_ms);
+
+	/* True while the inputs are read from the logic analyzer */
+	bool isBuffered() const;
+
+Q_SIGNALS:
+	void changed(int gpi);
+
+private:
+	void run();
+	void enableChannels();
+	bool readBuffer(int& gpi, bool& busy);
+	int readAttributes() const;
+
+	static const unsigned int buffer_samples = 16;
+
+	DIOManager *diom;
+	struct iio_device *dev;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<bool> buffered;
+	std::atomic<unsigned int> interval_ms;
+};
+}
+
+#endif // DIGITALIO_MONITOR_HPP
@@ -26,25 +26,16 @@
 #include "hardware_trigger.hpp"
 #include "utils.h"
 
-#include <gnuradio/blocks/keep_one_in_n.h>
-#include <gnuradio/blocks/moving_average.h>
-#include <gnuradio/blocks/rms_ff.h>
-#include <gnuradio/blocks/short_to_float.h>
-#include <gnuradio/blocks/sub.h>
-#include <gnuradio/filter/dc_blocker_ff.h>
-
 #include <boost/make_shared.hpp>
 
 #include <memory>
-#include <QDateTime>
-#include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <QMessageBox>
-#include <QTextStream>
-#include <QThread>
 #include <QJSEngine>
 
 #include "dmm_api.hpp"
+#include "performance_monitor.hpp"
 
 using namespace adiscope;
 
@@ -54,11 +45,16 @@ DMM::DMM(struct iio_context *ctx, Filter *filt, std::shared_ptr<GenericAdc> adc,
 	ui(new Ui::DMM), signal(boost::make_shared<signal_sample>()),
 	manager(iio_manager::get_instance(ctx, filt->device_name(TOOL_DMM))),
 	adc(adc),
-	interrupt_data_logging(false),
 	data_logging(false),
 	filename(""),
+	data_logger(new DmmDataLogger([adc](unsigned int ch, double value) {
+		return adc->convSampleToVolts(ch, value);
+	}, this)),
 	use_timer(false),
 	logging_refresh_rate(0),
+	integration_nplc(5.0),
+	line_frequency(50.0),
+	readings(0),
 	wheelEventGuard(nullptr)
 {
 	ui->setupUi(this);
@@ -116,8 +112,12 @@ DMM::DMM(struct iio_context *ctx, Filter *filt, std::shared_ptr<GenericAdc> adc,
 			use_timer = false;
 		else use_timer = true;
 		logging_refresh_rate = value * 1000;
+		data_logger->setInterval(use_timer ? logging_refresh_rate : 0);
 	});
 
+	connect(data_logger, SIGNAL(writeFailed()),
+		this, SLOT(dataLoggingFailed()));
+
 	data_logging_timer->setValue(0);
 	enableDataLogging(false);
 
@@ -154,21 +154,28 @@ DMM::DMM(struct iio_context *ctx, Filter *filt, std::shared_ptr<GenericAdc> adc,
 	/* Lock the flowgraph if we are already started */
 	bool started = isIioManagerStarted();
 	if (started)
-		manager->lock();
+		manager->lock_hot();
 
 	configureModes();
 
 	connect(&*signal, SIGNAL(triggered(std::vector<float>)),
 			this, SLOT(updateValuesList(std::vector<float>)));
 
+	/* The logger takes the readings in the flowgraph thread */
+	connect(&*signal, &signal_sample::triggered,
+		data_logger, &DmmDataLogger::push, Qt::DirectConnection);
+
 	if (started)
-		manager->unlock();
+		manager->unlock_hot();
 
 	api->setObjectName(QString::fromStdString(Filter::tool_name(
 			TOOL_DMM)));
 	api->load(*settings);
 	api->js_register(engine);
 
+	PerformanceMonitor::instance()->addRate(this, api->objectName(),
+		"readings", [=]() { return (double)readings; });
+
 	if(!wheelEventGuard)
 		wheelEventGuard = new MouseWheelWidgetGuard(ui->widget_2);
 	wheelEventGuard->installEventRecursively(ui->widget_2);
@@ -178,18 +185,19 @@ void DMM::disconnectAll()
 {
 	bool started = isIioManagerStarted();
 	if (started)
-		manager->lock();
+		manager->lock_hot();
 
 	manager->disconnect(id_ch1);
 	manager->disconnect(id_ch2);
 
 	if (started)
-		manager->unlock();
+		manager->unlock_hot();
 }
 
 DMM::~DMM()
 {
 	ui->run_button->setChecked(false);
+	data_logger->stop();
 	disconnectAll();
 
 	if (saveOnExit) {
@@ -202,9 +210,6 @@ DMM::~DMM()
 
 void DMM::updateValuesList(std::vector<float> values)
 {
-	if(!use_timer)
-		boost::unique_lock<boost::mutex> lock(data_mutex);
-
 	double volts_ch1 = adc->convSampleToVolts(0, (double) values[0]);
 	double volts_ch2 = adc->convSampleToVolts(1, (double) values[1]);
 
@@ -220,8 +225,7 @@ void DMM::updateValuesList(std::vector<float> values)
 	checkPeakValues(0, volts_ch1);
 	checkPeakValues(1, volts_ch2);
 
-	if(!use_timer)
-		data_cond.notify_all();
+	readings++;
 }
 
 void DMM::checkPeakValues(int ch, double peak)
@@ -245,6 +249,18 @@ bool DMM::isIioManagerStarted() const
 	return manager->started() && ui->run_button->isChecked();
 }
 
+uint8_t DMM::acMask() const
+{
+	uint8_t mask = 0;
+
+	if (ui->btn_ch1_ac->isChecked() || ui->btn_ch1_ac2->isChecked())
+		mask |= 1;
+	if (ui->btn_ch2_ac->isChecked() || ui->btn_ch2_ac2->isChecked())
+		mask |= 2;
+
+	return mask;
+}
+
 void DMM::collapseDataLog(bool checked)
 {
 	if(checked)
@@ -313,74 +329,75 @@ void DMM::toggleTimer(bool start)
 }
 
 
-gr::basic_block_sptr DMM::configureGraph(gr::basic_block_sptr s2f,
-		bool is_low_ac, bool is_high_ac)
+unsigned int DMM::cicDecimation(bool is_high_ac) const
 {
-	/* 10 fps refresh rate for the plot */
-	auto keep_one = gr::blocks::keep_one_in_n::make(sizeof(float),
-			is_high_ac ? (sample_rate / 10.0) : 1000.0);
-
-	/* TODO: figure out best value for the blocker parameter */
-	auto blocker = gr::filter::dc_blocker_ff::make(1000, true);
-
-	manager->connect(s2f, 0, blocker, 0);
+	/* The high frequency AC mode needs the full rate, the others
+	 * are read at 10 kHz */
+	return is_high_ac ? 1 : sample_rate / 1e4;
+}
 
-	if (is_low_ac || is_high_ac) {
-		/* TODO: figure out best value for the RMS parameter */
-		auto rms = gr::blocks::rms_ff::make(0.0001);
-		manager->connect(blocker, 0, rms, 0);
+dmm_integrator_block::Mode DMM::integratorMode(bool is_low_ac,
+		bool is_high_ac) const
+{
+	return (is_low_ac || is_high_ac) ?
+		dmm_integrator_block::AC_RMS : dmm_integrator_block::DC;
+}
 
-		manager->connect(rms, 0, keep_one, 0);
-	} else {
-		auto sub = gr::blocks::sub_ff::make();
+boost::shared_ptr<dmm_integrator_block> DMM::configureGraph(bool is_low_ac,
+		bool is_high_ac)
+{
+	unsigned int decim = cicDecimation(is_high_ac);
+
+	return boost::shared_ptr<dmm_integrator_block>(
+			new dmm_integrator_block(
+				integratorMode(is_low_ac, is_high_ac), decim,
+				dmm_integrator_block::window_for(sample_rate,
+					integration_nplc, line_frequency,
+					decim)));
+}
 
-		manager->connect(s2f, 0, sub, 0);
-		manager->connect(blocker, 0, sub, 1);
-		manager->connect(sub, 0, keep_one, 0);
-	}
+void DMM::updateIntegrator(dmm_integrator_block *integrator,
+		bool is_low_ac, bool is_high_ac)
+{
+	unsigned int decim = cicDecimation(is_high_ac);
 
-	return keep_one;
+	integrator->set_mode(integratorMode(is_low_ac, is_high_ac));
+	integrator->set_integration(decim,
+			dmm_integrator_block::window_for(sample_rate,
+				integration_nplc, line_frequency, decim));
 }
 
 void DMM::configureModes()
 {
-	auto s2f1 = gr::blocks::short_to_float::make();
-	auto s2f2 = gr::blocks::short_to_float::make();
-
 	bool is_low_ac_ch1 = ui->btn_ch1_ac->isChecked();
 	bool is_low_ac_ch2 = ui->btn_ch2_ac->isChecked();
 	bool is_high_ac_ch1 = ui->btn_ch1_ac2->isChecked();
 	bool is_high_ac_ch2 = ui->btn_ch2_ac2->isChecked();
 
-	if (is_high_ac_ch1) {
-		id_ch1 = manager->connect(s2f1, 0, 0, false, sample_rate / 10);
-	} else {
-		/* Low-frequency AC: decimate data rate */
-		auto keep_one1 = gr::blocks::keep_one_in_n::make(
-				sizeof(short), sample_rate / 1e4);
-		id_ch1 = manager->connect(keep_one1, 0, 0, false,
-				sample_rate / 10);
+	integrator_ch1 = configureGraph(is_low_ac_ch1, is_high_ac_ch1);
+	integrator_ch2 = configureGraph(is_low_ac_ch2, is_high_ac_ch2);
 
-		manager->connect(keep_one1, 0, s2f1, 0);
-	}
+	id_ch1 = manager->connect(integrator_ch1, 0, 0, false,
+			sample_rate / 10);
+	id_ch2 = manager->connect(integrator_ch2, 1, 0, false,
+			sample_rate / 10);
 
-	if (is_high_ac_ch2) {
-		id_ch2 = manager->connect(s2f2, 1, 0, false, sample_rate / 10);
-	} else {
-		/* Low-frequency AC: decimate data rate */
-		auto keep_one2 = gr::blocks::keep_one_in_n::make(
-				sizeof(short), sample_rate / 1e4);
-		id_ch2 = manager->connect(keep_one2, 1, 0, false,
-				sample_rate / 10);
+	manager->connect(integrator_ch1, 0, signal, 0);
+	manager->connect(integrator_ch2, 0, signal, 1);
+}
 
-		manager->connect(keep_one2, 0, s2f2, 0);
-	}
+void DMM::setIntegrationTime(double nplc, double line_frequency)
+{
+	if (nplc <= 0.0 || line_frequency <= 0.0)
+		return;
 
-	auto block1 = configureGraph(s2f1, is_low_ac_ch1, is_high_ac_ch1);
-	auto block2 = configureGraph(s2f2, is_low_ac_ch2, is_high_ac_ch2);
+	integration_nplc = nplc;
+	this->line_frequency = line_frequency;
 
-	manager->connect(block1, 0, signal, 0);
-	manager->connect(block2, 0, signal, 1);
+	updateIntegrator(integrator_ch1.get(), ui->btn_ch1_ac->isChecked(),
+			ui->btn_ch1_ac2->isChecked());
+	updateIntegrator(integrator_ch2.get(), ui->btn_ch2_ac->isChecked(),
+			ui->btn_ch2_ac2->isChecked());
 }
 
 void DMM::chooseFile()
@@ -388,7 +405,8 @@ void DMM::chooseFile()
 	QString selectedFilter;
 
 	filename = QFileDialog::getSaveFileName(this,
-	    tr("Export"), "", tr("Comma-separated values files (*.csv);;All Files(*)"),
+	    tr("Export"), "", tr("Comma-separated values files (*.csv);;"
+				 "Binary log files (*.bin);;All Files(*)"),
 	    &selectedFilter, (m_useNativeDialogs ? QFileDialog::Options() : QFileDialog::DontUseNativeDialog));
 
 	ui->filename->setText(filename);
@@ -438,52 +456,52 @@ void DMM::toggleDataLogging(bool en)
 		ui->btn_append->setEnabled(false);
 	}
 
+	/* If running, start the logger */
 	if(en && ui->run_button->isChecked()) {
-		QFile file(filename);
-
-		if(ui->btn_overwrite->isChecked() || file.size() == 0) {
-			if( !file.open(QIODevice::WriteOnly)) {
-				ui->lblFileStatus->setText(tr("File is open in another program"));
-				setDynamicProperty(ui->filename, "invalid", true);
-				if(ui->run_button->isChecked()) {
-					ui->btnDataLogging->setChecked(false);
-				}
-				return;
-			} else {
-				ui->lblFileStatus->setText(tr("Choose a file"));
-				setDynamicProperty(ui->filename, "invalid", false);
-			}
-			QTextStream out(&file);
-
-			/* Write the header */
-			out << ";Generated by Scopy-" << QString(SCOPY_VERSION_GIT) << "\n" <<
-			       ";Started on " <<  QDateTime::currentDateTime().toString() << "\n";
-			out << "Timestamp,Channel_0_DC_RMS,Channel_0_AC_RMS,Channel_1_DC_RMS,Channel_1_AC_RMS\n";
-
-			file.close();
-		}
+		startDataLogger();
 	}
 	else {
 		ui->btn_overwrite->setEnabled(true);
 		ui->btn_append->setEnabled(true);
 	}
 
-	/* If running, start the thread */
-	if(ui->run_button->isChecked() && en) {
-		if(data_logging_thread.joinable())
-			return;
-
-		interrupt_data_logging = false;
-		data_logging_thread = std::thread(&DMM::dataLoggingThread, this);
+	if(!en) {
+		data_logger->stop();
 	}
-	else if(!en) {
-		if(!use_timer)
-			data_cond.notify_all();
-		interrupt_data_logging = true;
-		if(data_logging_thread.joinable()) {
-			data_logging_thread.detach();
+}
+
+bool DMM::startDataLogger()
+{
+	if (data_logger->isRunning())
+		return true;
+
+	auto format = QFileInfo(filename).suffix() == "bin" ?
+		DmmDataLogger::BINARY : DmmDataLogger::CSV;
+
+	data_logger->setAcMask(acMask());
+	data_logger->setInterval(use_timer ? logging_refresh_rate : 0);
+
+	if (!data_logger->start(filename, ui->btn_append->isChecked(),
+				format)) {
+		ui->lblFileStatus->setText(tr("File is open in another program"));
+		setDynamicProperty(ui->filename, "invalid", true);
+		if(ui->run_button->isChecked()) {
+			ui->btnDataLogging->setChecked(false);
 		}
+		return false;
 	}
+
+	ui->lblFileStatus->setText(tr("Choose a file"));
+	setDynamicProperty(ui->filename, "invalid", false);
+	return true;
+}
+
+void DMM::dataLoggingFailed()
+{
+	data_logger->stop();
+	ui->lblFileStatus->setText(tr("Could not write to the file"));
+	setDynamicProperty(ui->filename, "invalid", true);
+	ui->btnDataLogging->setChecked(false);
 }
 
 void DMM::startDataLogging(bool start)
@@ -495,111 +513,28 @@ void DMM::startDataLogging(bool start)
 	if(start) {
 		if(filename == "")
 			return;
-		if(data_logging_thread.joinable())
-			return;
 
-		interrupt_data_logging = false;
 		ui->btn_overwrite->setEnabled(false);
 		ui->btn_append->setEnabled(false);
-		data_logging_thread = std::thread(&DMM::dataLoggingThread, this);
-
+		startDataLogger();
 	}
 	else {
-		if(!use_timer)
-			data_cond.notify_all();
-		interrupt_data_logging = true;
-		if(data_logging_thread.joinable()) {
-			data_logging_thread.detach();
-		}
+		data_logger->stop();
 		ui->btn_overwrite->setEnabled(true);
 		ui->btn_append->setEnabled(true);
 	}
 }
 
-void DMM::dataLoggingThread()
-{
-	QString separator = ",";
-	QFile file(filename);
-
-	QTextStream out(&file);
-
-	while(!interrupt_data_logging) {
-		if (!file.isOpen()) {
-			if (!file.open(QIODevice::Append)) {
-				ui->lblFileStatus->setText(tr("File is open in another program"));
-				setDynamicProperty(ui->filename, "invalid", true);
-				if(ui->run_button->isChecked()) {
-					ui->btnDataLogging->setChecked(false);
-				}
-				return;
-			} else {
-				ui->lblFileStatus->setText(tr("Choose a file"));
-			}
-		}
-		bool is_low_ac_ch1 = ui->btn_ch1_ac->isChecked();
-		bool is_low_ac_ch2 = ui->btn_ch2_ac->isChecked();
-		bool is_high_ac_ch1 = ui->btn_ch1_ac2->isChecked();
-		bool is_high_ac_ch2 = ui->btn_ch2_ac2->isChecked();
-		QString ch1_dc_rms="-", ch2_dc_rms="-", ch1_ac_rms="-", ch2_ac_rms="-";
-
-		out << QDateTime::currentDateTime().time().toString() << separator;
-
-		if(!use_timer) {
-			boost::unique_lock<boost::mutex> lock(data_mutex);
-			data_cond.wait(lock);
-		}
-
-
-		if(!is_low_ac_ch1 && !is_high_ac_ch1) {
-			ch1_dc_rms = QString::number(ui->lcdCh1->value());
-		}
-		else {
-			ch1_ac_rms = QString::number(ui->lcdCh1->value());
-		}
-
-
-		if(!is_low_ac_ch2 && !is_high_ac_ch2) {
-			ch2_dc_rms = QString::number(ui->lcdCh2->value());
-		}
-		else {
-			ch2_ac_rms = QString::number(ui->lcdCh2->value());
-		}
-
-		/* Write the values to file */
-		out <<  ch1_dc_rms << separator <<
-			ch1_ac_rms << separator <<
-			ch2_dc_rms << separator <<
-			ch2_ac_rms << "\n";
-
-		if (file.isOpen()) {
-			file.close();
-		}
-		if (use_timer) {
-			QThread::msleep(logging_refresh_rate);
-		}
-	}
-	if (file.isOpen()) {
-		file.close();
-	}
-}
-
 void DMM::toggleAC()
 {
-	bool started = isIioManagerStarted();
-	if (started)
-		manager->lock();
-
-	manager->disconnect(id_ch1);
-	manager->disconnect(id_ch2);
-
-	configureModes();
-
-	if (started) {
-		writeAllSettingsToHardware();
-		manager->start(id_ch1);
-		manager->start(id_ch2);
-		manager->unlock();
-	}
+	/* The integrators switch in place: the flowgraph, which can be
+	 * feeding the other tools of the device, isn't locked */
+	updateIntegrator(integrator_ch1.get(), ui->btn_ch1_ac->isChecked(),
+			ui->btn_ch1_ac2->isChecked());
+	updateIntegrator(integrator_ch2.get(), ui->btn_ch2_ac->isChecked(),
+			ui->btn_ch2_ac2->isChecked());
+
+	data_logger->setAcMask(acMask());
 }
 
 int DMM::numSamplesFromIdx(int idx)
@@ -611,6 +546,12 @@ int DMM::numSamplesFromIdx(int idx)
 		return 100;
 	case 2:
 		return 600;
+	case 3:
+		return 6000;
+	case 4:
+		return 36000;
+	case 5:
+		return 864000;
 	default:
 		throw std::runtime_error("Invalid IDX");
 	}
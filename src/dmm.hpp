@@ -26,15 +26,14 @@
 #include <atomic>
 
 #include "apiObject.hpp"
+#include "dmm_data_logger.hpp"
+#include "dmm_integrator_block.hpp"
 #include "filter.hpp"
 #include "iio_manager.hpp"
 #include "signal_sample.hpp"
 #include "tool.hpp"
 #include "scroll_filter.hpp"
-#include <thread>
 #include "spinbox_a.hpp"
-#include <boost/thread/mutex.hpp>
-#include <boost/thread/condition_variable.hpp>
 
 namespace Ui {
 	class DMM;
@@ -68,28 +67,41 @@ namespace adiscope {
 		boost::shared_ptr<signal_sample> signal;
 		unsigned long sample_rate;
 
-		std::atomic<bool> interrupt_data_logging;
 		std::atomic<bool> data_logging;
 		QString filename;
-		std::thread data_logging_thread;
+		DmmDataLogger *data_logger;
 		bool use_timer;
 		unsigned long logging_refresh_rate;
 		PositionSpinButton *data_logging_timer;
 
-		boost::mutex data_mutex;
-		boost::condition_variable data_cond;
+		/* Integration time, in power line cycles */
+		double integration_nplc;
+		double line_frequency;
+		/* Readings displayed since the tool was created */
+		quint64 readings;
+		boost::shared_ptr<dmm_integrator_block> integrator_ch1;
+		boost::shared_ptr<dmm_integrator_block> integrator_ch2;
+
 		MouseWheelWidgetGuard *wheelEventGuard;
 
 		std::vector<double> m_min, m_max;
 
 		void disconnectAll();
-		gr::basic_block_sptr configureGraph(gr::basic_block_sptr s2f,
+		unsigned int cicDecimation(bool is_high_ac) const;
+		dmm_integrator_block::Mode integratorMode(bool is_low_ac,
+				bool is_high_ac) const;
+		boost::shared_ptr<dmm_integrator_block> configureGraph(
+				bool is_low_ac, bool is_high_ac);
+		void updateIntegrator(dmm_integrator_block *integrator,
 				bool is_low_ac, bool is_high_ac);
 		void configureModes();
+		void setIntegrationTime(double nplc, double line_frequency);
 		int numSamplesFromIdx(int idx);
 		void writeAllSettingsToHardware();
 		void checkPeakValues(int, double);
 		bool isIioManagerStarted() const;
+		uint8_t acMask() const;
+		bool startDataLogger();
 
 	public Q_SLOTS:
 		void toggleTimer(bool start);
@@ -110,7 +122,7 @@ namespace adiscope {
 
 		void startDataLogging(bool);
 
-		void dataLoggingThread();
+		void dataLoggingFailed();
 
 		void chooseFile();
 
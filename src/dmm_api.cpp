@@ -184,4 +184,29 @@ void DMM_API::setDataLoggingAppend(bool val)
 	dmm->ui->btn_overwrite->setChecked(!val);
 }
 
+double DMM_API::getIntegrationNplc() const
+{
+	return dmm->integration_nplc;
+}
+
+void DMM_API::setIntegrationNplc(double nplc)
+{
+	dmm->setIntegrationTime(nplc, dmm->line_frequency);
+}
+
+double DMM_API::getLineFrequency() const
+{
+	return dmm->line_frequency;
+}
+
+qulonglong DMM_API::getReadings() const
+{
+	return dmm->readings;
+}
+
+void DMM_API::setLineFrequency(double freq)
+{
+	dmm->setIntegrationTime(dmm->integration_nplc, freq);
+}
+
 }
@@ -63,6 +63,11 @@ class DMM_API : public ApiObject
 		   WRITE setDataLoggingAppend)
 	Q_PROPERTY(bool peak_hold_en READ getPeakHoldEn
 		  WRITE setPeakHoldEn)
+	Q_PROPERTY(double integration_nplc READ getIntegrationNplc
+		   WRITE setIntegrationNplc)
+	Q_PROPERTY(double line_frequency READ getLineFrequency
+		   WRITE setLineFrequency)
+	Q_PROPERTY(qulonglong readings READ getReadings STORED false)
 
 public:
 	bool get_mode_ac_high_ch1() const;
@@ -104,6 +109,14 @@ public:
 	bool getPeakHoldEn() const;
 	void setPeakHoldEn(bool);
 
+	double getIntegrationNplc() const;
+	void setIntegrationNplc(double);
+
+	double getLineFrequency() const;
+	void setLineFrequency(double);
+
+	qulonglong getReadings() const;
+
 	Q_INVOKABLE void show();
 
 	explicit DMM_API(DMM *dmm) : ApiObject(), dmm(dmm) {}
@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dmm_data_logger.hpp"
+
+#include <config.h>
+
+#include <QByteArray>
+#include <QDateTime>
+#include <QtEndian>
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace adiscope;
+
+DmmDataLogger::DmmDataLogger(const Conversion& conversion, QObject *parent) :
+	QObject(parent),
+	conversion(conversion),
+	format(CSV),
+	running(false),
+	interrupt(false),
+	ring(ring_size),
+	head(0),
+	tail(0),
+	nb_dropped(0),
+	interval_ns(0),
+	ac_mask(0),
+	last_push_ns(-1)
+{
+}
+
+DmmDataLogger::~DmmDataLogger()
+{
+	stop();
+}
+
+bool DmmDataLogger::start(const QString& filename, bool append,
+			  Format format)
+{
+	if (running) {
+		return true;
+	}
+
+	/* A writer that stopped on an error */
+	if (thread.joinable()) {
+		thread.join();
+	}
+
+	file.setFileName(filename);
+	if (!file.open(append ? QIODevice::Append :
+		       QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return false;
+	}
+
+	this->format = format;
+	nb_dropped = 0;
+	last_push_ns = -1;
+	start_time = std::chrono::steady_clock::now();
+	writeHeader(!append || file.size() == 0);
+
+	interrupt = false;
+	running = true;
+	thread = std::thread(&DmmDataLogger::run, this);
+
+	return true;
+}
+
+void DmmDataLogger::stop()
+{
+	running = false;
+	interrupt = true;
+
+	/* The writer drains what is left in the ring first */
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+bool DmmDataLogger::isRunning() const
+{
+	return running;
+}
+
+void DmmDataLogger::setInterval(unsigned long ms)
+{
+	interval_ns = (int64_t)ms * 1000000;
+}
+
+void DmmDataLogger::setAcMask(uint8_t mask)
+{
+	ac_mask = mask;
+}
+
+uint64_t DmmDataLogger::dropped() const
+{
+	return nb_dropped;
+}
+
+void DmmDataLogger::push(const std::vector<float>& values)
+{
+	if (!running) {
+		return;
+	}
+
+	int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start_time).count();
+	int64_t interval = interval_ns.load(std::memory_order_relaxed);
+
+	if (interval && last_push_ns >= 0 && now - last_push_ns < interval) {
+		return;
+	}
+
+	size_t h = head.load(std::memory_order_relaxed);
+
+	if (h - tail.load(std::memory_order_acquire) == ring_size) {
+		nb_dropped++;
+		return;
+	}
+
+	Record& record = ring[h & (ring_size - 1)];
+
+	record.time_ns = now;
+	record.ac_mask = ac_mask.load(std::memory_order_relaxed);
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		record.value[i] = i < values.size() ? values[i] : 0.0f;
+	}
+
+	head.store(h + 1, std::memory_order_release);
+	last_push_ns = now;
+}
+
+void DmmDataLogger::run()
+{
+	std::vector<Record> records;
+	auto last_sync = std::chrono::steady_clock::now();
+
+	records.reserve(block_size);
+
+	for (;;) {
+		/* Read before draining, so that nothing pushed before
+		 * stop() is left behind */
+		bool stopping = interrupt;
+		size_t t = tail.load(std::memory_order_relaxed);
+		size_t h = head.load(std::memory_order_acquire);
+
+		while (t != h && records.size() < block_size) {
+			records.push_back(ring[t & (ring_size - 1)]);
+			t++;
+		}
+
+		tail.store(t, std::memory_order_release);
+
+		if (!records.empty()) {
+			if (format == BINARY) {
+				writeBinary(records);
+			} else {
+				writeCsv(records);
+			}
+
+			records.clear();
+
+			if (file.error() != QFileDevice::NoError) {
+				running = false;
+				Q_EMIT writeFailed();
+				break;
+			}
+		}
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (now - last_sync >= std::chrono::seconds(1)) {
+			sync();
+			last_sync = now;
+		}
+
+		if (t == h) {
+			if (stopping) {
+				break;
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+
+	sync();
+	file.close();
+}
+
+void DmmDataLogger::writeHeader(bool new_file)
+{
+	QDateTime started = QDateTime::currentDateTime();
+
+	if (format == BINARY) {
+		QByteArray header("SCOPYDMM", 8);
+		uchar field[8];
+
+		qToLittleEndian<quint32>(1, field);
+		header.append((const char *)field, 4);
+		qToLittleEndian<quint32>(nb_channels, field);
+		header.append((const char *)field, 4);
+		qToLittleEndian<qint64>(started.toMSecsSinceEpoch(), field);
+		header.append((const char *)field, 8);
+
+		file.write(header);
+		return;
+	}
+
+	QByteArray header;
+
+	if (new_file) {
+		header += ";Generated by Scopy-" + QByteArray(SCOPY_VERSION_GIT) + "\n";
+	}
+
+	header += ";Started on " + started.toString().toUtf8() + "\n";
+
+	if (new_file) {
+		header += "Timestamp,Channel_0_DC_RMS,Channel_0_AC_RMS,"
+			"Channel_1_DC_RMS,Channel_1_AC_RMS\n";
+	}
+
+	file.write(header);
+}
+
+void DmmDataLogger::writeCsv(const std::vector<Record>& records)
+{
+	QByteArray out;
+
+	out.reserve(records.size() * 64);
+
+	for (const Record& record : records) {
+		out += QByteArray::number(record.time_ns / 1e9, 'f', 6);
+
+		for (unsigned int i = 0; i < nb_channels; i++) {
+			QByteArray value = QByteArray::number(
+					conversion(i, record.value[i]), 'g', 10);
+			bool ac = record.ac_mask & (1 << i);
+
+			out += ',';
+			out += ac ? QByteArray("-") : value;
+			out += ',';
+			out += ac ? value : QByteArray("-");
+		}
+
+		out += '\n';
+	}
+
+	file.write(out);
+}
+
+void DmmDataLogger::writeBinary(const std::vector<Record>& records)
+{
+	size_t n = records.size();
+	QByteArray out(4 + n * (8 + 1 + nb_channels * 8), Qt::Uninitialized);
+	uchar *p = (uchar *)out.data();
+
+	qToLittleEndian<quint32>(n, p);
+	p += 4;
+
+	for (const Record& record : records) {
+		qToLittleEndian<qint64>(record.time_ns, p);
+		p += 8;
+	}
+
+	for (const Record& record : records) {
+		*p++ = record.ac_mask;
+	}
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		for (const Record& record : records) {
+			double value = conversion(i, record.value[i]);
+			quint64 bits;
+
+			memcpy(&bits, &value, sizeof(bits));
+			qToLittleEndian<quint64>(bits, p);
+			p += 8;
+		}
+	}
+
+	file.write(out);
+}
+
+void DmmDataLogger::sync()
+{
+	if (!file.flush()) {
+		return;
+	}
+
+#ifdef _WIN32
+	_commit(file.handle());
+#else
+	fsync(file.handle());
+#endif
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DMM_DATA_LOGGER_HPP
+#define DMM_DATA_LOGGER_HPP
+
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Logs the voltmeter readings to a file from its own thread.
+ *
+ * push() is called straight from the signal_sample block, in the
+ * flowgraph thread, and only stores the raw values with a monotonic
+ * timestamp in a single-producer/single-consumer ring; it never
+ * blocks, a full ring drops the record and counts it. The writer
+ * thread drains the ring in batches into a file kept open for the
+ * whole session, converts the values to volts, and flushes the file
+ * to the disk once a second.
+ *
+ * Timestamps are the seconds (CSV) or nanoseconds (binary) elapsed
+ * since the start of the session, whose wall clock time is in the
+ * header.
+ *
+ * The binary format is columnar: a header, then blocks of up to
+ * block_size records, each holding the record count (uint32) and the
+ * timestamps (int64), the AC mode masks (uint8) and the values of
+ * every channel (float64), one column after the other. All of it is
+ * little endian. An appended session starts with its own header.
+ */
+class DmmDataLogger : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum Format {
+		CSV,
+		BINARY,
+	};
+
+	typedef std::function<double(unsigned int, double)> Conversion;
+
+	static const unsigned int nb_channels = 2;
+
+	explicit DmmDataLogger(const Conversion& conversion,
+			       QObject *parent = nullptr);
+	~DmmDataLogger();
+
+	/* Opens the file and starts the writer thread, does nothing
+	 * when already running */
+	bool start(const QString& filename, bool append, Format format);
+	void stop();
+	bool isRunning() const;
+
+	/* Minimum time between two records, 0 logs every reading */
+	void setInterval(unsigned long ms);
+
+	/* Bit n set when channel n measures AC */
+	void setAcMask(uint8_t mask);
+
+	uint64_t dropped() const;
+
+public Q_SLOTS:
+	/* Flowgraph thread only */
+	void push(const std::vector<float>& values);
+
+Q_SIGNALS:
+	void writeFailed();
+
+private:
+	struct Record {
+		int64_t time_ns;
+		float value[nb_channels];
+		uint8_t ac_mask;
+	};
+
+	static const size_t ring_size = 1 << 16;
+	static const size_t block_size = 4096;
+
+	void run();
+	void writeHeader(bool new_file);
+	void writeCsv(const std::vector<Record>& records);
+	void writeBinary(const std::vector<Record>& records);
+	void sync();
+
+	Conversion conversion;
+	Format format;
+	QFile file;
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<bool> interrupt;
+
+	std::vector<Record> ring;
+	std::atomic<size_t> head;
+	std::atomic<size_t> tail;
+	std::atomic<uint64_t> nb_dropped;
+
+	std::atomic<int64_t> interval_ns;
+	std::atomic<uint8_t> ac_mask;
+	std::chrono::steady_clock::time_point start_time;
+	int64_t last_push_ns;
+};
+}
+
+#endif /* DMM_DATA_LOGGER_HPP */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include "dmm_integrator_block.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+dmm_integrator_block::dmm_integrator_block(Mode mode,
+		unsigned int cic_decimation, size_t window)
+	: block("dmm_integrator_block",
+			io_signature::make(1, 1, sizeof(short)),
+			io_signature::make(1, 1, sizeof(float))),
+	d_mode(mode)
+{
+	set_integration(cic_decimation, window);
+}
+
+dmm_integrator_block::~dmm_integrator_block()
+{
+}
+
+void dmm_integrator_block::set_integration(unsigned int cic_decimation,
+		size_t window)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_decim = std::max(1u, cic_decimation);
+	d_window = std::max<size_t>(1, window);
+	set_relative_rate(1.0 / ((double)d_decim * d_window));
+	reset();
+}
+
+void dmm_integrator_block::set_mode(Mode mode)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_mode = mode;
+	reset();
+}
+
+size_t dmm_integrator_block::window_for(double sample_rate, double nplc,
+		double line_frequency, unsigned int cic_decimation)
+{
+	double samples = sample_rate * nplc / line_frequency;
+
+	return std::max<size_t>(1, std::llround(samples /
+				std::max(1u, cic_decimation)));
+}
+
+void dmm_integrator_block::reset()
+{
+	d_cic_sum = 0;
+	d_cic_count = 0;
+	d_sum = 0;
+	d_sum_sq = 0.0;
+	d_count = 0;
+}
+
+float dmm_integrator_block::reading() const
+{
+	double n = (double)d_decim * d_window;
+	double mean = d_sum / n;
+	double mean_sq = d_sum_sq / ((double)d_decim * d_decim * d_window);
+
+	switch (d_mode) {
+	case AC_RMS:
+		return std::sqrt(std::max(0.0, mean_sq - mean * mean));
+	case TRUE_RMS:
+		return std::sqrt(mean_sq);
+	default:
+		return mean;
+	}
+}
+
+void dmm_integrator_block::forecast(int noutput_items,
+		gr_vector_int &ninput_items_required)
+{
+	/* Windows are accumulated across calls */
+	ninput_items_required[0] = 1;
+}
+
+int dmm_integrator_block::general_work(int noutput_items,
+		gr_vector_int &ninput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	const short *in = static_cast<const short *>(input_items[0]);
+	float *out = static_cast<float *>(output_items[0]);
+	size_t n = ninput_items[0];
+	size_t i = 0;
+	int produced = 0;
+
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	while (i < n && produced < noutput_items) {
+		if (d_decim == 1) {
+			size_t take = std::min(n - i, d_window - d_count);
+			int64_t sum = 0, sum_sq = 0;
+
+			/* Plain integer sums: they need no reordering of
+			 * rounded operations, so this vectorizes */
+			for (size_t k = i; k < i + take; k++) {
+				int32_t x = in[k];
+
+				sum += x;
+				sum_sq += x * x;
+			}
+
+			d_sum += sum;
+			d_sum_sq += (double)sum_sq;
+			d_count += take;
+			i += take;
+		} else {
+			size_t take = std::min<size_t>(n - i,
+					d_decim - d_cic_count);
+			int64_t sum = 0;
+
+			for (size_t k = i; k < i + take; k++) {
+				sum += in[k];
+			}
+
+			d_cic_sum += sum;
+			d_cic_count += take;
+			i += take;
+
+			if (d_cic_count == d_decim) {
+				d_sum += d_cic_sum;
+				d_sum_sq += (double)d_cic_sum * d_cic_sum;
+				d_count++;
+				d_cic_sum = 0;
+				d_cic_count = 0;
+			}
+		}
+
+		if (d_count == d_window) {
+			out[produced++] = reading();
+			reset();
+		}
+	}
+
+	consume_each(i);
+
+	return produced;
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DMM_INTEGRATOR_BLOCK_HPP
+#define DMM_INTEGRATOR_BLOCK_HPP
+
+#include <gnuradio/block.h>
+
+#include <cstdint>
+#include <mutex>
+
+namespace adiscope {
+	/*
+	 * Voltmeter reading of a raw ADC channel: one value per
+	 * integration window, the DC mean, the AC RMS (around the window
+	 * mean) or the true RMS of the samples.
+	 *
+	 * The samples first go through a first order CIC (integrate and
+	 * dump) decimation by cic_decimation, whose sinc response is flat
+	 * enough over the band of the low rate modes and, unlike keeping
+	 * one sample out of n, doesn't alias. The window then spans
+	 * window decimated samples.
+	 *
+	 * Sums are kept in integers while the squares are exact, so a
+	 * small AC component on a large DC level doesn't cancel out. The
+	 * window doesn't have to fit in the flowgraph buffers: the block
+	 * accumulates whatever input it gets and outputs when a window
+	 * is complete.
+	 */
+	class dmm_integrator_block : public gr::block
+	{
+	public:
+		enum Mode {
+			DC,
+			AC_RMS,
+			TRUE_RMS,
+		};
+
+		dmm_integrator_block(Mode mode, unsigned int cic_decimation,
+				size_t window);
+		~dmm_integrator_block();
+
+		/* Both restart the current window, they can be called
+		 * while the flowgraph runs */
+		void set_integration(unsigned int cic_decimation,
+				size_t window);
+		void set_mode(Mode mode);
+
+		/* Decimated samples per window for an integration time of
+		 * nplc cycles of the power line */
+		static size_t window_for(double sample_rate, double nplc,
+				double line_frequency,
+				unsigned int cic_decimation);
+
+		void forecast(int noutput_items,
+				gr_vector_int &ninput_items_required);
+
+		int general_work(int noutput_items,
+				gr_vector_int &ninput_items,
+				gr_vector_const_void_star &input_items,
+				gr_vector_void_star &output_items);
+
+	private:
+		void reset();
+		float reading() const;
+
+		std::mutex d_mutex;
+		Mode d_mode;
+		unsigned int d_decim;
+		size_t d_window;
+
+		/* The CIC sample being integrated */
+		int64_t d_cic_sum;
+		unsigned int d_cic_count;
+
+		/* The window, in raw samples and in squared CIC samples */
+		int64_t d_sum;
+		double d_sum_sq;
+		size_t d_count;
+	};
+}
+
+#endif /* DMM_INTEGRATOR_BLOCK_HPP */
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "edge_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+EdgeDetector::EdgeDetector(float level, float hysteresis)
+{
+	reset(level, hysteresis);
+}
+
+void EdgeDetector::reset(float level, float hysteresis)
+{
+	d_level = level;
+	d_low = level - hysteresis / 2;
+	d_high = level + hysteresis / 2;
+	d_state = UNKNOWN;
+	d_prev = 0.0f;
+	d_prev_time = 0.0;
+	d_has_prev = false;
+	d_crossing = 0.0;
+	d_position = 0.0;
+}
+
+void EdgeDetector::detect(const float *samples, size_t count,
+		std::vector<Edge> &edges)
+{
+	for (size_t i = 0; i < count; i++) {
+		float x = samples[i];
+
+		if (std::isnan(x)) {
+			continue;
+		}
+
+		double t = d_position + i;
+
+		if (d_has_prev && ((d_prev < d_level) != (x < d_level))) {
+			d_crossing = d_prev_time + (d_level - d_prev) /
+				(x - d_prev) * (t - d_prev_time);
+		}
+
+		if (x >= d_high) {
+			if (d_state == LOW) {
+				edges.push_back({ d_crossing, true });
+			}
+			d_state = HIGH;
+		} else if (x <= d_low) {
+			if (d_state == HIGH) {
+				edges.push_back({ d_crossing, false });
+			}
+			d_state = LOW;
+		}
+
+		d_prev = x;
+		d_prev_time = t;
+		d_has_prev = true;
+	}
+
+	d_position += count;
+}
+
+void EdgeDetector::carryOver(const float *samples, size_t count, int &side,
+		double &crossing, bool &has_crossing) const
+{
+	side = 0;
+	has_crossing = false;
+
+	for (size_t i = count; i-- > 0 && !side;) {
+		if (samples[i] >= d_high) {
+			side = 1;
+		} else if (samples[i] <= d_low) {
+			side = -1;
+		}
+	}
+
+	// NaNs are skipped, as in detect()
+	size_t next = count;
+	for (size_t i = count; i-- > 0;) {
+		if (std::isnan(samples[i])) {
+			continue;
+		}
+
+		if (next < count && ((samples[i] < d_level) !=
+					(samples[next] < d_level))) {
+			crossing = i + (d_level - samples[i]) /
+				(samples[next] - samples[i]) * (next - i);
+			has_crossing = true;
+			break;
+		}
+		next = i;
+	}
+}
+
+void EdgeDetector::resume(int side, float prev, double crossing,
+		double position)
+{
+	d_state = side > 0 ? HIGH : (side < 0 ? LOW : UNKNOWN);
+	d_prev = prev;
+	d_prev_time = position - 1;
+	d_has_prev = !std::isnan(prev);
+	d_crossing = crossing;
+	d_position = position;
+}
+
+void EdgeDetector::levelOf(const float *samples, size_t count,
+		float hysteresis_ratio, float &level, float &hysteresis)
+{
+	if (!count) {
+		level = hysteresis = 0.0f;
+		return;
+	}
+
+	auto range = std::minmax_element(samples, samples + count);
+	float span = *range.second - *range.first;
+
+	level = *range.first + span / 2;
+	hysteresis = span * hysteresis_ratio;
+}
+
+double EdgeDetector::unitInterval(const std::vector<Edge> &edges)
+{
+	if (edges.size() < 2) {
+		return 0.0;
+	}
+
+	double shortest = INFINITY;
+	for (size_t i = 1; i < edges.size(); i++) {
+		shortest = std::min(shortest,
+				edges[i].time - edges[i - 1].time);
+	}
+
+	if (!(shortest > 0.0)) {
+		return 0.0;
+	}
+
+	// Every interval is a whole number of unit intervals, which
+	// averages out the jitter of the shortest one
+	double units = 0.0;
+	for (size_t i = 1; i < edges.size(); i++) {
+		units += std::max(1.0, std::round((edges[i].time -
+				edges[i - 1].time) / shortest));
+	}
+
+	return (edges.back().time - edges.front().time) / units;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EDGE_DETECTOR_H
+#define EDGE_DETECTOR_H
+
+#include <stddef.h>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Times of the edges of a signal, with sub-sample resolution.
+ *
+ * As with the crossing detection of the measurements, an edge only
+ * counts once the signal went from one side of the hysteresis band
+ * around the level to the other. Its time is where the line between the
+ * two samples around the level crosses it, the last such crossing
+ * before the signal left the band.
+ *
+ * The state is kept from one call of detect() to the next, so a long
+ * capture can be fed one chunk at a time.
+ */
+class EdgeDetector
+{
+public:
+	struct Edge {
+		double time; // in samples, since the first one ever fed
+		bool rising;
+	};
+
+	EdgeDetector(float level = 0.0f, float hysteresis = 0.0f);
+
+	/* Starts over */
+	void reset(float level, float hysteresis);
+
+	/* Appends the edges found in the next count samples */
+	void detect(const float *samples, size_t count,
+			std::vector<Edge> &edges);
+
+	/* Samples fed since the last reset */
+	double position() const { return d_position; }
+
+	/* What a detector would carry over from the count samples to the
+	 * next ones: the side of the band of the last sample out of it
+	 * (-1 below, 1 above, 0 none) and the time of the last level
+	 * crossing from samples[0], false if there's none */
+	void carryOver(const float *samples, size_t count, int &side,
+			double &crossing, bool &has_crossing) const;
+
+	/* Picks up where a detector that was carrying those over from
+	 * the samples before position stopped, prev being the last one;
+	 * with the chunks of a capture resumed this way, detecting them
+	 * in parallel finds the same edges as detecting it in one go */
+	void resume(int side, float prev, double crossing, double position);
+
+	/* The level and hysteresis of a frame: the middle of its range
+	 * and a fraction of it */
+	static void levelOf(const float *samples, size_t count,
+			float hysteresis_ratio, float &level,
+			float &hysteresis);
+
+	/* The shortest interval between edges, refined with the mean of
+	 * all the intervals measured in that unit. 0 without two edges. */
+	static double unitInterval(const std::vector<Edge> &edges);
+
+private:
+	enum State {
+		UNKNOWN,
+		LOW,
+		HIGH,
+	};
+
+	float d_level, d_low, d_high;
+	State d_state;
+	float d_prev;
+	double d_prev_time;
+	bool d_has_prev;
+	double d_crossing;
+	double d_position;
+};
+}
+
+#endif // EDGE_DETECTOR_H
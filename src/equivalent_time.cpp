@@ -0,0 +1,207 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "equivalent_time.h"
+#include "edge_detector.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Samples fed to the edge detector before the trigger, for the signal
+// to settle on one side of the band first, and after it
+#define ET_EDGE_PRE_SAMPLES 64
+#define ET_EDGE_POST_SAMPLES 8
+
+// Furthest from the trigger an edge can be, in samples
+#define ET_EDGE_TOLERANCE 2.0
+
+#define ET_HYSTERESIS_RATIO 0.1f
+
+using namespace adiscope;
+
+EquivalentTime::EquivalentTime() :
+	d_nb_channels(0),
+	d_nitems(0),
+	d_factor(1),
+	d_trigger_index(0),
+	d_trigger_channel(0)
+{
+	reset();
+}
+
+void EquivalentTime::configure(unsigned int nb_channels, int nitems,
+		unsigned int factor, int trigger_index,
+		unsigned int trigger_channel)
+{
+	d_nb_channels = nb_channels;
+	d_nitems = std::max(nitems, 0);
+	d_factor = std::max(factor, 1u);
+	d_trigger_index = trigger_index;
+	d_trigger_channel = trigger_channel;
+
+	d_sums.resize(d_nb_channels);
+	for (auto &sums : d_sums) {
+		sums.resize((size_t)d_nitems * d_factor);
+	}
+	d_counts.resize((size_t)d_nitems * d_factor);
+
+	reset();
+}
+
+void EquivalentTime::reset()
+{
+	for (auto &sums : d_sums) {
+		std::fill(sums.begin(), sums.end(), 0.0f);
+	}
+	std::fill(d_counts.begin(), d_counts.end(), 0);
+
+	d_captures = 0;
+	d_rejected = 0;
+	d_filled = 0;
+	d_level = 0.0f;
+	d_hysteresis = 0.0f;
+	d_rising = true;
+}
+
+double EquivalentTime::coverage() const
+{
+	return d_counts.empty() ? 0.0 : (double)d_filled / d_counts.size();
+}
+
+bool EquivalentTime::_offsetOf(const float *samples, int nitems,
+		double &offset)
+{
+	if (!d_captures) {
+		EdgeDetector::levelOf(samples, nitems, ET_HYSTERESIS_RATIO,
+				d_level, d_hysteresis);
+	}
+
+	int start = std::max(d_trigger_index - ET_EDGE_PRE_SAMPLES, 0);
+	int end = std::min(d_trigger_index + ET_EDGE_POST_SAMPLES, nitems);
+	if (end <= start) {
+		return false;
+	}
+
+	std::vector<EdgeDetector::Edge> edges;
+	EdgeDetector detector(d_level, d_hysteresis);
+	detector.detect(samples + start, end - start, edges);
+
+	const EdgeDetector::Edge *nearest = nullptr;
+	double distance = ET_EDGE_TOLERANCE;
+
+	for (const auto &edge : edges) {
+		double off = edge.time + start - d_trigger_index;
+
+		if ((!d_captures || edge.rising == d_rising) &&
+				std::abs(off) <= distance) {
+			nearest = &edge;
+			distance = std::abs(off);
+			offset = off;
+		}
+	}
+
+	if (!nearest) {
+		return false;
+	}
+
+	if (!d_captures) {
+		d_rising = nearest->rising;
+	}
+
+	return true;
+}
+
+void EquivalentTime::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	double offset = 0.0;
+
+	if (nitems != d_nitems || channels.size() < d_nb_channels ||
+			d_trigger_channel >= channels.size() ||
+			!_offsetOf(channels[d_trigger_channel], nitems,
+				offset)) {
+		d_rejected++;
+		return;
+	}
+
+	// The edge of every capture lands on bin trigger_index * factor
+	const long factor = d_factor;
+	const long shift = std::lround(-offset * d_factor);
+	const long size = (long)d_counts.size();
+
+	// Samples whose bin falls inside the record
+	long first = shift < 0 ? (-shift + factor - 1) / factor : 0;
+	long last = std::min((long)nitems, (size - shift + factor - 1) / factor);
+
+	for (long i = first; i < last; i++) {
+		if (!d_counts[i * factor + shift]++) {
+			d_filled++;
+		}
+	}
+
+	for (unsigned int n = 0; n < d_nb_channels; n++) {
+		std::vector<float> &sums = d_sums[n];
+		const float *x = channels[n];
+
+		for (long i = first; i < last; i++) {
+			sums[i * factor + shift] += x[i];
+		}
+	}
+
+	d_captures++;
+}
+
+void EquivalentTime::record(unsigned int chn, std::vector<float> &out) const
+{
+	out.clear();
+
+	if (chn >= d_nb_channels || !d_filled) {
+		return;
+	}
+
+	const std::vector<float> &sums = d_sums[chn];
+	const size_t size = d_counts.size();
+
+	out.resize(size);
+
+	// Bins hit so far, the gaps between them filled in on the way
+	long prev = -1;
+
+	for (size_t i = 0; i < size; i++) {
+		if (!d_counts[i]) {
+			continue;
+		}
+
+		out[i] = sums[i] / d_counts[i];
+
+		if (prev < 0) {
+			std::fill(out.begin(), out.begin() + i, out[i]);
+		} else if ((long)i - prev > 1) {
+			float step = (out[i] - out[prev]) / (i - prev);
+
+			for (size_t j = prev + 1; j < i; j++) {
+				out[j] = out[prev] + step * (j - prev);
+			}
+		}
+
+		prev = i;
+	}
+
+	std::fill(out.begin() + prev + 1, out.end(), out[prev]);
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EQUIVALENT_TIME_H
+#define EQUIVALENT_TIME_H
+
+#include "frame_listener.h"
+
+#include <stddef.h>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Equivalent-time record of a repetitive signal, built from many
+ * triggered frames at a sample rate factor times the real one.
+ *
+ * The frames aren't sampled at the same phase of the signal: where its
+ * edge crosses the level between two samples, interpolated on the
+ * trigger channel, gives the offset of each one. The samples of a frame
+ * then go to every factor-th bin of the record, shifted by that offset
+ * rounded to a bin. Frames without such an edge close to the trigger,
+ * or of the other polarity than the first one, are rejected.
+ */
+class EquivalentTime : public frame_listener
+{
+public:
+	EquivalentTime();
+
+	/* Frames of nb_channels channels of nitems samples, the trigger
+	 * at trigger_index; also starts over */
+	void configure(unsigned int nb_channels, int nitems,
+			unsigned int factor, int trigger_index,
+			unsigned int trigger_channel);
+	void reset();
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems) override;
+
+	unsigned int factor() const { return d_factor; }
+	unsigned int captures() const { return d_captures; }
+	unsigned int rejected() const { return d_rejected; }
+
+	/* Fraction of the bins of the record hit by a sample */
+	double coverage() const;
+
+	/* nitems * factor samples, the mean of each bin; the empty ones
+	 * are interpolated between their neighbours. Empty without a
+	 * capture. */
+	void record(unsigned int chn, std::vector<float> &out) const;
+
+private:
+	bool _offsetOf(const float *samples, int nitems, double &offset);
+
+	unsigned int d_nb_channels;
+	int d_nitems;
+	unsigned int d_factor;
+	int d_trigger_index;
+	unsigned int d_trigger_channel;
+
+	unsigned int d_captures, d_rejected;
+	size_t d_filled;
+
+	// Set by the first capture
+	float d_level, d_hysteresis;
+	bool d_rising;
+
+	std::vector<std::vector<float>> d_sums;
+	std::vector<unsigned int> d_counts;
+};
+}
+
+#endif // EQUIVALENT_TIME_H
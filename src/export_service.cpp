@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "export_service.hpp"
+#include "pipeline_trace.hpp"
+
+#include <QApplication>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QProgressDialog>
+#include <QtConcurrentRun>
+
+#include <atomic>
+#include <exception>
+
+using namespace adiscope;
+
+struct ExportService::Task {
+	int id;
+	QString fileName;
+	QPointer<QProgressDialog> dialog;
+	std::atomic<bool> cancel;
+	std::atomic<int> percent;
+};
+
+ExportService::ExportService(QObject *parent) :
+	QObject(parent),
+	next_id(0)
+{
+	/* The disk is the limit, a second export keeps it busy while
+	 * the first one formats, more would only share the bandwidth */
+	pool.setMaxThreadCount(2);
+
+	connect(this, &ExportService::progressChanged,
+		this, &ExportService::updateProgress, Qt::QueuedConnection);
+}
+
+ExportService::~ExportService()
+{
+	pool.waitForDone();
+}
+
+ExportService *ExportService::instance()
+{
+	/* Goes away with the application, after the last export */
+	static ExportService *service = new ExportService(qApp);
+
+	return service;
+}
+
+QFuture<bool> ExportService::start(QWidget *parent, const QString& fileName,
+				   Job job, bool cancellable)
+{
+	std::shared_ptr<Task> task = std::make_shared<Task>();
+	task->id = next_id++;
+	task->fileName = fileName;
+	task->cancel = false;
+	task->percent = -1;
+
+	/* No cancel button without a text */
+	QProgressDialog *dialog = new QProgressDialog(
+		tr("Exporting %1").arg(fileName),
+		cancellable ? tr("Cancel") : QString(), 0, 100, parent);
+	dialog->setWindowModality(Qt::NonModal);
+	dialog->setMinimumDuration(500);
+	dialog->setAutoReset(false);
+	dialog->setAutoClose(false);
+	if (!cancellable) {
+		/* Only busy is shown, these report no progress */
+		dialog->setRange(0, 0);
+	}
+	dialog->setValue(0);
+	task->dialog = dialog;
+
+	connect(dialog, &QProgressDialog::canceled, [task]() {
+		task->cancel = true;
+	});
+
+	tasks.insert(task->id, task);
+
+	Progress progress = [this, task](size_t done, size_t total) {
+		int percent = total ? done * 100 / total : 100;
+
+		if (task->percent.exchange(percent) != percent) {
+			Q_EMIT progressChanged(task->id, percent);
+		}
+
+		return !task->cancel;
+	};
+
+	QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+	connect(watcher, &QFutureWatcher<bool>::finished, this,
+			[this, task, watcher]() {
+		bool done = watcher->result() && !task->cancel;
+
+		if (!done) {
+			QFile::remove(task->fileName);
+		}
+
+		if (task->dialog) {
+			task->dialog->deleteLater();
+		}
+
+		tasks.remove(task->id);
+		watcher->deleteLater();
+
+		Q_EMIT finished(task->fileName, done);
+	});
+
+	QFuture<bool> future = QtConcurrent::run(&pool,
+			[job, progress]() -> bool {
+		PIPELINE_TRACE("export");
+
+		try {
+			return job(progress);
+		} catch (const std::exception&) {
+			return false;
+		}
+	});
+	watcher->setFuture(future);
+
+	return future;
+}
+
+QFuture<bool> ExportService::start(QWidget *parent, const QString& fileName,
+				   std::shared_ptr<FileManager> fm)
+{
+	return start(parent, fileName, [fm](const Progress& progress) {
+		return fm->performWrite(progress);
+	});
+}
+
+int ExportService::pending() const
+{
+	return tasks.size();
+}
+
+void ExportService::waitForDone()
+{
+	pool.waitForDone();
+}
+
+void ExportService::updateProgress(int id, int percent)
+{
+	auto it = tasks.find(id);
+
+	if (it != tasks.end() && (*it)->dialog &&
+			(*it)->dialog->maximum() > 0) {
+		(*it)->dialog->setValue(percent);
+	}
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EXPORT_SERVICE_HPP
+#define EXPORT_SERVICE_HPP
+
+#include <QFuture>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QThreadPool>
+
+#include <functional>
+#include <memory>
+
+#include "filemanager.h"
+
+class QProgressDialog;
+class QWidget;
+
+namespace adiscope {
+
+/*
+ * Runs the exports of all the tools on a thread pool of its own, so
+ * the GUI thread only snapshots what is exported and goes back to
+ * the acquisition.
+ *
+ * A job gets a progress function to call with the rows (or samples)
+ * written so far; it returns false once the user cancelled from the
+ * dialog, and the job then stops and removes its partial file. The
+ * dialog is not modal and belongs to the tool starting the export,
+ * it is only shown for the exports lasting more than half a second.
+ *
+ * The data a job reads must stay valid until it finishes whatever the
+ * tool does meanwhile: implicitly shared vectors or shared_ptr held
+ * buffers captured by value, never the live plot buffers.
+ */
+class ExportService : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef FileManager::WriteProgress Progress;
+	typedef std::function<bool(const Progress& progress)> Job;
+
+	static ExportService *instance();
+
+	/* Queues job writing fileName, the dialog shows its progress;
+	 * the future gives what the job returned */
+	QFuture<bool> start(QWidget *parent, const QString& fileName,
+			    Job job, bool cancellable = true);
+
+	/* Writes what was saved to fm, which is kept until then */
+	QFuture<bool> start(QWidget *parent, const QString& fileName,
+			    std::shared_ptr<FileManager> fm);
+
+	/* Exports queued or running */
+	int pending() const;
+
+	/* Blocks until all the queued exports are written */
+	void waitForDone();
+
+Q_SIGNALS:
+	void finished(const QString& fileName, bool done);
+
+	/* Emitted by the workers, delivered in the GUI thread */
+	void progressChanged(int id, int percent);
+
+private Q_SLOTS:
+	void updateProgress(int id, int percent);
+
+private:
+	struct Task;
+
+	explicit ExportService(QObject *parent = nullptr);
+	~ExportService();
+
+	QThreadPool pool;
+	QMap<int, std::shared_ptr<Task>> tasks;
+	int next_id;
+};
+}
+
+#endif /* EXPORT_SERVICE_HPP */
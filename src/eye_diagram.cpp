@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "eye_diagram.h"
+#include "persistence_map.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+/* Hysteresis of the edges, relative to the range of the frame */
+#define EYE_HYSTERESIS_RATIO 0.1f
+
+EyeDiagram::EyeDiagram() :
+	d_sample_rate(1.0),
+	d_bit_rate(0.0)
+{
+}
+
+void EyeDiagram::setMaps(
+		const std::vector<std::shared_ptr<PersistenceMap>> &maps)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_maps = maps;
+	d_unit_intervals.assign(maps.size(), 0.0);
+}
+
+std::shared_ptr<PersistenceMap> EyeDiagram::map(unsigned int channel) const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	return channel < d_maps.size() ? d_maps[channel] : nullptr;
+}
+
+void EyeDiagram::setSampleRate(double sample_rate)
+{
+	if (sample_rate > 0.0 && sample_rate != d_sample_rate) {
+		d_sample_rate = sample_rate;
+		clear();
+	}
+}
+
+void EyeDiagram::setBitRate(double bit_rate)
+{
+	bit_rate = std::max(bit_rate, 0.0);
+
+	if (bit_rate != d_bit_rate) {
+		d_bit_rate = bit_rate;
+		clear();
+	}
+}
+
+double EyeDiagram::bitRate() const
+{
+	return d_bit_rate;
+}
+
+double EyeDiagram::unitInterval(unsigned int channel) const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (channel >= d_unit_intervals.size()) {
+		return 0.0;
+	}
+
+	return d_unit_intervals[channel] / d_sample_rate;
+}
+
+void EyeDiagram::clear()
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	for (auto &map : d_maps) {
+		if (map) {
+			map->clear();
+		}
+	}
+	std::fill(d_unit_intervals.begin(), d_unit_intervals.end(), 0.0);
+}
+
+QImage EyeDiagram::image(unsigned int channel, const QSize &size,
+		const QColor &color) const
+{
+	auto eye = map(channel);
+
+	if (!eye) {
+		return QImage();
+	}
+
+	PersistencePlotItem item(eye, color);
+	item.setTimeRange(0.0, 1.0);
+
+	return item.image(size);
+}
+
+double EyeDiagram::_phase(const std::vector<EdgeDetector::Edge> &edges,
+		double ui)
+{
+	// A circular mean, an edge just before and one just after a unit
+	// interval boundary are close to each other
+	double s = 0.0, c = 0.0;
+
+	for (const auto &edge : edges) {
+		double angle = 2 * M_PI * edge.time / ui;
+		s += std::sin(angle);
+		c += std::cos(angle);
+	}
+
+	return std::atan2(s, c) / (2 * M_PI) * ui;
+}
+
+void EyeDiagram::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	const double fixed_ui = d_bit_rate > 0.0 ?
+		d_sample_rate / d_bit_rate : 0.0;
+
+	for (size_t n = 0; n < channels.size() && n < d_maps.size(); n++) {
+		if (!d_maps[n]) {
+			continue;
+		}
+
+		float level, hysteresis;
+		EdgeDetector::levelOf(channels[n], nitems,
+				EYE_HYSTERESIS_RATIO, level, hysteresis);
+
+		d_edges.clear();
+		d_detector.reset(level, hysteresis);
+		d_detector.detect(channels[n], nitems, d_edges);
+
+		double ui = fixed_ui > 0.0 ? fixed_ui :
+			EdgeDetector::unitInterval(d_edges);
+
+		// Nothing to align on, or less than an eye in the frame
+		if (d_edges.empty() || !(ui > 0.0) || 2 * ui > nitems) {
+			continue;
+		}
+
+		d_maps[n]->accumulateFolded(channels[n], nitems, ui,
+				_phase(d_edges, ui));
+		d_unit_intervals[n] = ui;
+	}
+}
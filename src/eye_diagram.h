@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EYE_DIAGRAM_H
+#define EYE_DIAGRAM_H
+
+#include "frame_listener.h"
+#include "edge_detector.h"
+
+#include <QColor>
+#include <QImage>
+#include <QSize>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace adiscope {
+
+class PersistenceMap;
+
+/*
+ * Eye diagrams of the channels of a scope sink: every frame is folded
+ * on two unit intervals and accumulated into a PersistenceMap per
+ * channel, capture after capture.
+ *
+ * The unit interval comes from the bit rate or, without one, is
+ * recovered from the edges of each frame. The fold is aligned on the
+ * mean phase of all the edges of the frame, so the trigger position
+ * doesn't matter.
+ */
+class EyeDiagram : public frame_listener
+{
+public:
+	EyeDiagram();
+
+	/* One map per channel, nullptr for the ones left out; starts over */
+	void setMaps(const std::vector<std::shared_ptr<PersistenceMap>> &maps);
+	std::shared_ptr<PersistenceMap> map(unsigned int channel) const;
+
+	void setSampleRate(double sample_rate);
+
+	/* 0 recovers the clock from the signal */
+	void setBitRate(double bit_rate);
+	double bitRate() const;
+
+	/* Unit interval of the last frame of a channel, in seconds */
+	double unitInterval(unsigned int channel) const;
+
+	void clear();
+
+	/* The map of a channel on its own, two unit intervals wide */
+	QImage image(unsigned int channel, const QSize &size,
+			const QColor &color) const;
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	mutable std::mutex d_mutex;
+	std::vector<std::shared_ptr<PersistenceMap>> d_maps;
+	std::vector<double> d_unit_intervals;
+	std::atomic<double> d_sample_rate;
+	std::atomic<double> d_bit_rate;
+
+	EdgeDetector d_detector;
+	std::vector<EdgeDetector::Edge> d_edges;
+
+	/* Mean phase of the edges modulo ui, in samples */
+	static double _phase(const std::vector<EdgeDetector::Edge> &edges,
+			double ui);
+};
+}
+
+#endif // EYE_DIAGRAM_H
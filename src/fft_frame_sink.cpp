@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "fft_frame_sink.h"
+#include "spectrumUpdateEvents.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+
+using namespace adiscope;
+
+/* Frames of the FFT the GUI may hold, as for a scope sink */
+#define FFT_EVENT_POOL_SIZE 3
+
+FftFrameSink::FftFrameSink(QObject *plot, unsigned int nb_channels) :
+	d_plot(plot),
+	d_nb_channels(nb_channels),
+	d_pool(std::make_shared<TimeUpdateBufferPool>(FFT_EVENT_POOL_SIZE,
+				nb_channels)),
+	d_update_time(0),
+	d_last_time(0),
+	d_displayed(true)
+{
+}
+
+void FftFrameSink::setFftSize(size_t fft_size)
+{
+	// Taken from the pool before the lock, planning can take a while
+	power_spectrum::sptr spectrum = fft_size ?
+		power_spectrum::get(fft_size) : nullptr;
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+	d_spectrum.swap(spectrum);
+}
+
+size_t FftFrameSink::fftSize() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_spectrum ? d_spectrum->fft_size() : 0;
+}
+
+void FftFrameSink::setUpdateTime(double seconds)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_update_time = seconds * gr::high_res_timer_tps();
+	d_last_time = 0;
+}
+
+void FftFrameSink::setDisplayed(bool displayed)
+{
+	d_displayed = displayed;
+}
+
+void FftFrameSink::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	if (!d_displayed) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (!d_spectrum || nitems <= 0 || channels.size() < d_nb_channels) {
+		return;
+	}
+
+	gr::high_res_timer_type now = gr::high_res_timer_now();
+	if (now - d_last_time <= d_update_time) {
+		return;
+	}
+
+	// Dropped if the GUI hasn't drawn the previous frames yet
+	const size_t fft_size = d_spectrum->fft_size();
+	TimeUpdateBufferPool::Slot *slot = d_pool->acquire(fft_size);
+	if (!slot) {
+		return;
+	}
+
+	d_last_time = now;
+
+	for (unsigned int n = 0; n < d_nb_channels; n++) {
+		const float *in = channels[n];
+
+		if ((size_t)nitems < fft_size) {
+			d_padded.assign(fft_size, 0.0f);
+			std::copy(in, in + nitems, d_padded.begin());
+			in = d_padded.data();
+		}
+
+		float *out = slot->points[n];
+		d_spectrum->compute(in, out);
+
+		auto range = std::minmax_element(out, out + fft_size);
+		slot->min[n] = *range.first;
+		slot->max[n] = *range.second;
+		slot->tags[n].clear();
+	}
+
+	slot->offset = 0;
+	slot->append = false;
+
+	QCoreApplication::postEvent(d_plot,
+			new TimeUpdateEvent(d_pool, slot, fft_size));
+}
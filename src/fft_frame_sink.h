@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FFT_FRAME_SINK_H
+#define FFT_FRAME_SINK_H
+
+#include "frame_listener.h"
+#include "power_spectrum.hpp"
+
+#include <gnuradio/high_res_timer.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class QObject;
+
+namespace adiscope {
+
+class TimeUpdateBufferPool;
+
+/*
+ * The FFT view of the Oscilloscope, computed on the frames of the time
+ * sink with the transforms of the Spectrum Analyzer rather than in a
+ * branch of the flowgraph of its own: only the frames that get posted
+ * to the plot are transformed.
+ *
+ * A frame is transformed from its first sample, zero-padded to the FFT
+ * size if shorter. The plot gets the power of every bin and its mirror,
+ * as from a complex FFT.
+ */
+class FftFrameSink : public frame_listener
+{
+public:
+	FftFrameSink(QObject *plot, unsigned int nb_channels);
+
+	void setFftSize(size_t fft_size);
+	size_t fftSize() const;
+
+	/* Minimum time between two frames posted to the plot */
+	void setUpdateTime(double seconds);
+
+	/* Nothing gets transformed while the plot can't be seen */
+	void setDisplayed(bool displayed);
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	mutable std::mutex d_mutex;
+	QObject *d_plot;
+	unsigned int d_nb_channels;
+	power_spectrum::sptr d_spectrum;
+	std::shared_ptr<TimeUpdateBufferPool> d_pool;
+
+	gr::high_res_timer_type d_update_time;
+	gr::high_res_timer_type d_last_time;
+	std::atomic<bool> d_displayed;
+
+	/* A frame shorter than the FFT, zero-padded */
+	std::vector<float> d_padded;
+};
+}
+
+#endif // FFT_FRAME_SINK_H
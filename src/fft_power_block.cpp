@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/filter/firdes.h>
+#include <gnuradio/io_signature.h>
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "fft_power_block.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+fft_power_block::fft_power_block(size_t fft_size, double overlap,
+		unsigned int nbthreads)
+	: block("fft_power_block",
+			io_signature::make(1, 1, sizeof(float)),
+			io_signature::make2(1, 2, sizeof(float),
+				sizeof(gr_complex))),
+	d_fft_size(fft_size),
+	d_hop(fft_size),
+	d_nbthreads(nbthreads),
+	d_spectrum(power_spectrum::get(fft_size, nbthreads)),
+	d_gpu(gpu_power_spectrum::create(fft_size)),
+	d_window(*power_spectrum::hamming(fft_size)),
+	d_decim(1)
+{
+	/* Whole frames only */
+	set_output_multiple(fft_size);
+	set_overlap(overlap);
+}
+
+fft_power_block::~fft_power_block()
+{
+}
+
+void fft_power_block::set_window(const std::vector<float>& window)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	if (window.size() == d_fft_size) {
+		d_window = window;
+		d_spectrum->set_window(window);
+
+		if (d_gpu && !d_gpu->set_window(window)) {
+			d_gpu.reset();
+		}
+	}
+}
+
+void fft_power_block::set_overlap(double overlap)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	if (overlap < 0.0 || overlap >= 1.0) {
+		overlap = 0.0;
+	}
+
+	d_hop = std::max<size_t>(1, (size_t)((1.0 - overlap) * d_fft_size));
+	d_zoom_frame.clear();
+	update_relative_rate();
+}
+
+void fft_power_block::update_relative_rate()
+{
+	set_relative_rate((double)d_fft_size / (d_hop * d_decim));
+}
+
+double fft_power_block::overlap() const
+{
+	return 1.0 - (double)d_hop / d_fft_size;
+}
+
+unsigned int fft_power_block::optimal_threads(size_t fft_size,
+		unsigned int nb_ffts)
+{
+	/* Below this the thread wake-up costs more than the transform */
+	static const size_t min_size_per_thread = 65536;
+	static const unsigned int max_threads = 8;
+
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int free_cores = std::max(1u, cores / std::max(1u, nb_ffts));
+	unsigned int wanted = std::max<size_t>(1,
+			fft_size / min_size_per_thread);
+
+	return std::min({ wanted, free_cores, max_threads });
+}
+
+void fft_power_block::set_zoom(double sample_rate, double start,
+		unsigned int decimation)
+{
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	d_decim = std::max(1u, decimation);
+	d_zoom_in.clear();
+	d_zoom_frame.clear();
+	update_relative_rate();
+
+	if (d_decim == 1) {
+		d_zoom_fft.reset();
+		d_zoom_taps.clear();
+		return;
+	}
+
+	if (!d_zoom_fft) {
+		d_zoom_fft.reset(new fft::fft_complex(d_fft_size, true,
+					d_nbthreads));
+	}
+
+	/*
+	 * After the shift the wanted band is [0, rate / 4] at the
+	 * decimated rate; everything past 3 / 4 of it would fold back
+	 * onto the displayed half, so that is where the stop band starts.
+	 */
+	double rate = sample_rate / d_decim;
+	std::vector<float> taps = filter::firdes::low_pass(1.0, sample_rate,
+			rate / 2, rate / 2);
+	double w = 2.0 * M_PI * start / sample_rate;
+	size_t ntaps = taps.size();
+
+	/* Shifting the taps instead of the input only costs a multiply
+	 * per kept sample instead of one per input sample */
+	d_zoom_taps.resize(ntaps);
+	for (size_t k = 0; k < ntaps; k++) {
+		d_zoom_taps[ntaps - 1 - k] = taps[k] *
+			std::polar(1.0f, (float)(w * k));
+	}
+
+	d_zoom_phase = gr_complex(1.0f, 0.0f);
+	d_zoom_phase_inc = std::polar(1.0f, (float)std::fmod(
+				-w * d_decim, 2.0 * M_PI));
+}
+
+unsigned int fft_power_block::zoom_decimation() const
+{
+	return d_decim;
+}
+
+void fft_power_block::forecast(int noutput_items,
+		gr_vector_int &ninput_items_required)
+{
+	size_t frames = std::max<size_t>(1, noutput_items / d_fft_size);
+
+	if (d_decim > 1) {
+		ninput_items_required[0] = frames * d_hop * d_decim;
+	} else {
+		ninput_items_required[0] = (frames - 1) * d_hop + d_fft_size;
+	}
+}
+
+int fft_power_block::general_work(int noutput_items,
+		gr_vector_int &ninput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	const float *in = static_cast<const float *>(input_items[0]);
+	float *out = static_cast<float *>(output_items[0]);
+	gr_complex *bins = (output_items.size() > 1) ?
+		static_cast<gr_complex *>(output_items[1]) : nullptr;
+
+	std::lock_guard<std::mutex> lock(d_mutex);
+
+	if (d_decim > 1) {
+		return zoom_work(noutput_items, ninput_items[0], in, out, bins);
+	}
+
+	size_t start = 0, frame = 0;
+	size_t half = d_fft_size / 2;
+
+	if (d_gpu && !bins && ninput_items[0] >= (int)d_fft_size) {
+		size_t nframes = std::min<size_t>(noutput_items / d_fft_size,
+				(ninput_items[0] - d_fft_size) / d_hop + 1);
+
+		if (d_gpu->compute(in, d_hop, nframes, out)) {
+			consume_each(nframes * d_hop);
+			return nframes * d_fft_size;
+		}
+
+		/* The frames of this call are done again below */
+		d_gpu.reset();
+	}
+
+	for (; frame + d_fft_size <= (size_t)noutput_items &&
+			start + d_fft_size <= (size_t)ninput_items[0];
+			frame += d_fft_size, start += d_hop) {
+		d_spectrum->compute(&in[start], &out[frame]);
+
+		if (bins) {
+			const gr_complex *x = d_spectrum->bins();
+			gr_complex *b = &bins[frame];
+
+			std::copy(x, x + half + 1, b);
+			for (size_t k = half + 1; k < d_fft_size; k++) {
+				b[k] = std::conj(x[d_fft_size - k]);
+			}
+		}
+	}
+
+	/* The tail of the last frame is the head of the next one */
+	consume_each(start);
+
+	return frame;
+}
+
+int fft_power_block::zoom_work(int noutput_items, int ninput_items,
+		const float *in, float *out, gr_complex *bins)
+{
+	size_t ntaps = d_zoom_taps.size();
+	size_t room = noutput_items / d_fft_size;
+	size_t take = std::min<size_t>(ninput_items, room * d_hop * d_decim);
+	size_t produced = 0, pos = 0;
+
+	d_zoom_in.insert(d_zoom_in.end(), in, in + take);
+
+	for (;;) {
+		if (d_zoom_frame.size() == d_fft_size) {
+			if (produced + d_fft_size > (size_t)noutput_items) {
+				break;
+			}
+
+			volk_32fc_32f_multiply_32fc(d_zoom_fft->get_inbuf(),
+					d_zoom_frame.data(), d_window.data(),
+					d_fft_size);
+			d_zoom_fft->execute();
+			volk_32fc_magnitude_squared_32f(&out[produced],
+					d_zoom_fft->get_outbuf(), d_fft_size);
+			if (bins) {
+				std::copy(d_zoom_fft->get_outbuf(),
+						d_zoom_fft->get_outbuf() +
+						d_fft_size, &bins[produced]);
+			}
+			produced += d_fft_size;
+
+			d_zoom_frame.erase(d_zoom_frame.begin(),
+					d_zoom_frame.begin() + d_hop);
+		}
+
+		if (pos + ntaps > d_zoom_in.size()) {
+			break;
+		}
+
+		/* One decimated sample: shifted low-pass, then the phase
+		 * the shift would have had at this sample */
+		gr_complex y;
+		volk_32fc_32f_dot_prod_32fc(&y, d_zoom_taps.data(),
+				&d_zoom_in[pos], ntaps);
+		d_zoom_frame.push_back(y * d_zoom_phase);
+		d_zoom_phase *= d_zoom_phase_inc;
+		pos += d_decim;
+	}
+
+	d_zoom_in.erase(d_zoom_in.begin(), d_zoom_in.begin() + pos);
+	d_zoom_phase /= std::abs(d_zoom_phase);
+
+	consume_each(take);
+
+	return produced;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FFT_POWER_BLOCK_HPP
+#define FFT_POWER_BLOCK_HPP
+
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/block.h>
+
+#include "gpu_power_spectrum.hpp"
+#include "power_spectrum.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace adiscope {
+	/*
+	 * Power spectrum of a real stream, frame by frame: window, real to
+	 * complex FFT and squared magnitude in a single block. It replaces
+	 * the stream_to_vector -> fft_vfc -> vector_to_stream ->
+	 * complex_to_mag_squared chain, which did the complex FFT of the
+	 * real samples and copied every frame three more times.
+	 *
+	 * Every fft_size input samples give fft_size output values, the
+	 * power of the fft_size / 2 + 1 computed bins followed by their
+	 * mirror, as the complex chain gave them. Tags keep their offsets.
+	 *
+	 * Consecutive frames can overlap (Welch): the frame start then only
+	 * advances by (1 - overlap) * fft_size samples, so the samples
+	 * already received are reused and the averaging downstream gets
+	 * more frames out of the same acquisition time.
+	 *
+	 * In zoom mode the block first shifts the given start frequency to
+	 * DC and low-pass decimates the stream, then runs a complex FFT, so
+	 * the first fft_size / 2 outputs span start .. start + rate / 2 at
+	 * the decimated rate.
+	 *
+	 * An optional second output gets the complex bins the powers were
+	 * computed from, in the same layout, for the blocks that relate the
+	 * spectra of two channels without transforming them again.
+	 *
+	 * Large frames go to the GPU when it is enabled and there is one,
+	 * a few at a time, unless the complex bins are wanted or zoomed in;
+	 * the CPU takes over for good if the device fails.
+	 */
+	class fft_power_block : public gr::block
+	{
+	public:
+		fft_power_block(size_t fft_size, double overlap = 0.0,
+				unsigned int nbthreads = 1);
+		~fft_power_block();
+
+		void set_window(const std::vector<float>& window);
+
+		/* Fraction of a frame shared with the previous one, [0, 1) */
+		void set_overlap(double overlap);
+		double overlap() const;
+
+		/* Zoom on [start, start + sample_rate / decimation / 4],
+		 * a decimation of 1 turns the zoom off */
+		void set_zoom(double sample_rate, double start,
+				unsigned int decimation);
+		unsigned int zoom_decimation() const;
+
+		/* FFT threads worth using for this size when nb_ffts
+		 * transforms run in parallel, from the core count */
+		static unsigned int optimal_threads(size_t fft_size,
+				unsigned int nb_ffts = 1);
+
+		void forecast(int noutput_items,
+				gr_vector_int &ninput_items_required);
+
+		int general_work(int noutput_items,
+				gr_vector_int &ninput_items,
+				gr_vector_const_void_star &input_items,
+				gr_vector_void_star &output_items);
+
+	private:
+		void update_relative_rate();
+		int zoom_work(int noutput_items, int ninput_items,
+				const float *in, float *out, gr_complex *bins);
+
+		size_t d_fft_size;
+		size_t d_hop;
+		unsigned int d_nbthreads;
+		power_spectrum::sptr d_spectrum;
+		std::unique_ptr<gpu_power_spectrum> d_gpu;
+
+		std::mutex d_mutex;
+		std::vector<float> d_window;
+
+		unsigned int d_decim;
+		std::unique_ptr<gr::fft::fft_complex> d_zoom_fft;
+		/* Low-pass taps shifted by the start frequency, reversed */
+		std::vector<gr_complex> d_zoom_taps;
+		gr_complex d_zoom_phase;
+		gr_complex d_zoom_phase_inc;
+		std::vector<float> d_zoom_in;
+		std::vector<gr_complex> d_zoom_frame;
+	};
+}
+
+#endif /* FFT_POWER_BLOCK_HPP */
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "fft_stitch_block.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+fft_stitch_block::fft_stitch_block(size_t fft_size, unsigned int nb_segments)
+	: block("fft_stitch_block",
+			io_signature::make(nb_segments, nb_segments,
+				sizeof(float)),
+			io_signature::make(1, 1, sizeof(float))),
+	d_fft_size(fft_size),
+	d_nb_segments(nb_segments),
+	d_frame_size(nb_segments * fft_size / 2)
+{
+	set_output_multiple(d_frame_size);
+	set_relative_rate((double)d_frame_size / fft_size);
+}
+
+fft_stitch_block::~fft_stitch_block()
+{
+}
+
+size_t fft_stitch_block::segment_bins() const
+{
+	return d_fft_size / 4;
+}
+
+void fft_stitch_block::forecast(int noutput_items,
+		gr_vector_int &ninput_items_required)
+{
+	size_t frames = std::max<size_t>(1, noutput_items / d_frame_size);
+
+	for (size_t k = 0; k < ninput_items_required.size(); k++) {
+		ninput_items_required[k] = frames * d_fft_size;
+	}
+}
+
+int fft_stitch_block::general_work(int noutput_items,
+		gr_vector_int &ninput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	float *out = static_cast<float *>(output_items[0]);
+	size_t bins = segment_bins();
+	size_t frames = noutput_items / d_frame_size;
+
+	for (unsigned int k = 0; k < d_nb_segments; k++) {
+		frames = std::min<size_t>(frames, ninput_items[k] / d_fft_size);
+	}
+
+	for (size_t f = 0; f < frames; f++) {
+		float *frame = &out[f * d_frame_size];
+
+		for (unsigned int k = 0; k < d_nb_segments; k++) {
+			const float *in = static_cast<const float *>(
+					input_items[k]) + f * d_fft_size;
+
+			memcpy(&frame[k * bins], in, bins * sizeof(float));
+		}
+
+		std::fill(&frame[d_nb_segments * bins],
+				&frame[d_frame_size], 0.0f);
+	}
+
+	consume_each(frames * d_fft_size);
+
+	return frames * d_frame_size;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FFT_STITCH_BLOCK_HPP
+#define FFT_STITCH_BLOCK_HPP
+
+#include <gnuradio/block.h>
+
+namespace adiscope {
+	/*
+	 * Joins the zoomed spectra of adjacent segments into one frame.
+	 * Input k carries fft_size power values whose first fft_size / 4
+	 * bins are segment k; they are laid end to end in the first half
+	 * of a frame of nb_segments * fft_size / 2 values, the second half
+	 * is zero, matching the layout of a single spectrum frame.
+	 */
+	class fft_stitch_block : public gr::block
+	{
+	public:
+		fft_stitch_block(size_t fft_size, unsigned int nb_segments);
+		~fft_stitch_block();
+
+		/* Bins taken from each segment */
+		size_t segment_bins() const;
+
+		void forecast(int noutput_items,
+				gr_vector_int &ninput_items_required);
+
+		int general_work(int noutput_items,
+				gr_vector_int &ninput_items,
+				gr_vector_const_void_star &input_items,
+				gr_vector_void_star &output_items);
+
+	private:
+		size_t d_fft_size;
+		unsigned int d_nb_segments;
+		size_t d_frame_size;
+	};
+}
+
+#endif /* FFT_STITCH_BLOCK_HPP */
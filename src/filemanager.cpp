@@ -19,18 +19,373 @@
  */
 
 #include "filemanager.h"
+#include "capture_archive.hpp"
+#include "mat_file.hpp"
 #include "config.h"
 
 #include <QDebug>
 #include <QFile>
 #include <QDate>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTextStream>
+#include <QtEndian>
+
+#include <qwt_series_data.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <clocale>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 using namespace adiscope;
 
+namespace {
+/* Below this a chunk is parsed faster than a thread starts */
+const ptrdiff_t min_chunk_size = 1 << 20;
+
+struct Line {
+	const char *begin;
+	const char *end;
+};
+
+/* The line starting at p, without its end of line; returns the start
+ * of the next one */
+const char *next_line(const char *p, const char *end, Line &line)
+{
+	const char *nl = static_cast<const char *>(
+			memchr(p, '\n', end - p));
+	const char *stop = nl ? nl : end;
+
+	line.begin = p;
+	line.end = (stop > p && stop[-1] == '\r') ? stop - 1 : stop;
+
+	return nl ? nl + 1 : end;
+}
+
+/* Fields as QString::split(sep, QString::SkipEmptyParts) counts them */
+int count_fields(const Line &line, char sep)
+{
+	int count = 0;
+	bool in_field = false;
+
+	for (const char *c = line.begin; c != line.end; c++) {
+		if (*c == sep) {
+			in_field = false;
+		} else if (!in_field) {
+			in_field = true;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/*
+ * Decimal number in the C locale, as QString::toDouble() reads it.
+ * Mantissas of up to 15 digits with small exponents are exact as a
+ * single multiply or divide and cover what Scopy writes; anything
+ * else goes through Qt.
+ */
+bool parse_double(const char *b, const char *e, double &value)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20,
+		1e21, 1e22
+	};
+
+	while (b < e && isspace((unsigned char)*b)) {
+		b++;
+	}
+	while (e > b && isspace((unsigned char)e[-1])) {
+		e--;
+	}
+
+	const char *p = b;
+	bool negative = false;
+	uint64_t mantissa = 0;
+	int digits = 0, exponent = 0;
+	bool any = false, exact = true;
+
+	if (p < e && (*p == '-' || *p == '+')) {
+		negative = *p++ == '-';
+	}
+
+	for (; p < e && isdigit((unsigned char)*p); p++) {
+		any = true;
+		if (digits < 15) {
+			mantissa = mantissa * 10 + (*p - '0');
+			digits += mantissa != 0;
+		} else {
+			exact &= *p == '0';
+			exponent++;
+		}
+	}
+
+	if (p < e && *p == '.') {
+		for (p++; p < e && isdigit((unsigned char)*p); p++) {
+			any = true;
+			if (digits < 15) {
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+				exponent--;
+			} else {
+				exact &= *p == '0';
+			}
+		}
+	}
+
+	if (any && p < e && (*p == 'e' || *p == 'E')) {
+		const char *q = p + 1;
+		bool exp_negative = false;
+		int exp = 0;
+
+		if (q < e && (*q == '-' || *q == '+')) {
+			exp_negative = *q++ == '-';
+		}
+		if (q < e && isdigit((unsigned char)*q)) {
+			for (; q < e && isdigit((unsigned char)*q); q++) {
+				exp = std::min(exp * 10 + (*q - '0'), 10000);
+			}
+			exponent += exp_negative ? -exp : exp;
+			p = q;
+		}
+	}
+
+	if (any && exact && p == e && exponent >= -22 && exponent <= 22) {
+		value = exponent < 0 ? mantissa / pow10[-exponent]
+			: mantissa * pow10[exponent];
+		value = negative ? -value : value;
+		return true;
+	}
+
+	bool ok;
+	value = QByteArray::fromRawData(b, e - b).toDouble(&ok);
+
+	return ok;
+}
+
+/* Rows pulled from the export columns at a time */
+const size_t write_chunk_rows = 16384;
+const size_t write_buffer_size = 4 * 1024 * 1024;
+
+/*
+ * Output buffer of performWrite. The text is formatted straight into
+ * one buffer while a worker writes the previous one to the file.
+ */
+class ExportWriter
+{
+public:
+	explicit ExportWriter(QFile &file) :
+		file(file),
+		buf(write_buffer_size),
+		pending(write_buffer_size),
+		pos(0), pending_size(0),
+		busy(false), stopping(false), ok(true),
+		thread(&ExportWriter::run, this)
+	{
+	}
+
+	~ExportWriter()
+	{
+		finish();
+	}
+
+	/* Room for at least n more bytes */
+	char *reserve(size_t n)
+	{
+		if (pos + n > buf.size()) {
+			hand_off();
+			if (n > buf.size()) {
+				buf.resize(n);
+			}
+		}
+		return buf.data() + pos;
+	}
+
+	void commit(const char *end)
+	{
+		pos = end - buf.data();
+	}
+
+	bool good()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		return ok;
+	}
+
+	/* Writes what is left and waits for the worker */
+	bool finish()
+	{
+		if (pos) {
+			hand_off();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+
+		if (thread.joinable()) {
+			thread.join();
+		}
+
+		return ok;
+	}
+
+private:
+	void hand_off()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]() { return !busy; });
+
+		std::swap(buf, pending);
+		pending_size = pos;
+		pos = 0;
+		busy = true;
+
+		lock.unlock();
+		wake.notify_one();
+	}
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		for (;;) {
+			wake.wait(lock, [this]() { return busy || stopping; });
+			if (!busy) {
+				break;
+			}
+
+			lock.unlock();
+			bool written = file.write(pending.data(), pending_size) ==
+				(qint64)pending_size;
+			lock.lock();
+
+			ok = ok && written;
+			busy = false;
+			idle.notify_one();
+		}
+	}
+
+	QFile &file;
+	std::vector<char> buf, pending;
+	size_t pos, pending_size;
+
+	std::mutex mutex;
+	std::condition_variable wake, idle;
+	bool busy, stopping, ok;
+	std::thread thread;
+};
+
+char *format_uint(char *out, uint64_t value)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n) {
+		*out++ = digits[--n];
+	}
+
+	return out;
+}
+
+/*
+ * Shortest of 15 or 17 significant digits reading back as the same
+ * double. printf follows the C locale of the process, so its decimal
+ * point is replaced by the '.' the import expects.
+ */
+char *format_double(char *out, double value, char decimal_point)
+{
+	if (std::fabs(value) < 9007199254740992.0 &&
+			value == std::floor(value)) {
+		if (value < 0) {
+			*out++ = '-';
+		}
+		return format_uint(out, (uint64_t)std::fabs(value));
+	}
+
+	int n = snprintf(out, 32, "%.15g", value);
+	if (strtod(out, nullptr) != value) {
+		n = snprintf(out, 32, "%.17g", value);
+	}
+
+	if (decimal_point != '.') {
+		std::replace(out, out + n, decimal_point, '.');
+	}
+
+	return out + n;
+}
+
+void write_bytes(ExportWriter &writer, const QByteArray &bytes)
+{
+	char *p = writer.reserve(bytes.size());
+	memcpy(p, bytes.constData(), bytes.size());
+	writer.commit(p + bytes.size());
+}
+
+/* NumPy format 1.0 header of a C order rows x cols array */
+QByteArray npy_header(const char *descr, size_t rows, size_t cols)
+{
+	QByteArray dict = QString("{'descr': '%1', 'fortran_order': False, "
+				  "'shape': (%2, %3), }").arg(descr)
+		.arg((qulonglong)rows).arg((qulonglong)cols).toLatin1();
+
+	/* The data starts 64 byte aligned, after a '\n' ended header */
+	int len = 10 + dict.size() + 1;
+	dict.append(QByteArray((64 - len % 64) % 64, ' '));
+	dict.append('\n');
+
+	QByteArray header("\x93NUMPY\x01\x00", 8);
+	char size[2];
+	qToLittleEndian<quint16>(dict.size(), reinterpret_cast<uchar *>(size));
+	header.append(size, 2);
+	header.append(dict);
+
+	return header;
+}
+
+/* Runs fn(0) .. fn(count - 1), all but the first on their own thread */
+void run_chunks(size_t count, const std::function<void(size_t)> &fn)
+{
+	std::vector<std::thread> threads;
+
+	for (size_t i = 1; i < count; i++) {
+		threads.emplace_back(fn, i);
+	}
+
+	fn(0);
+
+	for (auto &thread : threads) {
+		thread.join();
+	}
+}
+}
+
 FileManager::FileManager(QString toolName) :
 	hasHeader(false),
 	sampleRate(0),
 	nrOfSamples(0),
+	fileType(CSV),
+	separator(","),
 	toolName(toolName)
 {
 
@@ -48,9 +403,6 @@ void FileManager::open(QString fileName,
 	//throws exception if the file is corrupted, has a header but not the scopy one
 	//columns with different sizes etc..
 
-	QVector<QVector<QString>> raw_data;
-	bool srOk = true;
-	bool dataOk = true;
 
 	openedFor = filepurpose;
 
@@ -61,10 +413,21 @@ void FileManager::open(QString fileName,
 		separator = "\t";
 		fileType = TXT;
 		//find sep to read txt files
+	} else if (fileName.endsWith(".npy")) {
+		fileType = NPY;
+	} else if (fileName.endsWith(".bin")) {
+		fileType = BIN;
+	} else if (fileName.endsWith(".scarc")) {
+		fileType = ARCHIVE;
+	} else if (fileName.endsWith(".mat")) {
+		fileType = MAT;
 	}
 
 	//clear previous data if the manager was used for other exports
 	data.clear();
+	columns.clear();
+	exportColumns.clear();
+	calibration.clear();
 	columnNames.clear();
 	this->filename = fileName;
 
@@ -74,113 +437,233 @@ void FileManager::open(QString fileName,
 			throw FileManagerException("No file selected");
 		}
 
+		if (fileType == ARCHIVE) {
+			importArchive();
+			return;
+		}
+
+		if (fileType == MAT) {
+			importMat();
+			return;
+		}
+
 		QFile file(fileName);
 		if (!file.open(QIODevice::ReadOnly)) {
 			throw FileManagerException("Can't open selected file");
 		}
 
-		QTextStream in(&file);
+		/* Mapped, the pages are only read once, by the parser */
+		QByteArray contents;
+		qint64 size = file.size();
+		const char *begin = size > 0 ?
+			reinterpret_cast<const char *>(file.map(0, size)) : nullptr;
 
-		for (int i = 0; i < data.size(); ++i)
-			data[i].clear();
+		if (!begin && size > 0) {
+			contents = file.readAll();
+			begin = contents.constData();
+			size = contents.size();
+		}
 
-		while (!in.atEnd()) {
-			QVector<QString> line_data;
-			QString line = in.readLine();
-			QStringList list = line.split(separator, QString::SkipEmptyParts);
-			for (QString list_item : list) {
-				line_data.push_back(list_item);
-			}
-			if (line_data.size() > 0) {
-				raw_data.push_back(line_data);
-			}
+		parseImport(begin, begin + size);
+	}
+}
+
+void FileManager::parseImport(const char *begin, const char *end)
+{
+	QVector<QVector<QString>> raw_data;
+	const char sep = separator.isEmpty() ? ',' :
+		separator.at(0).toLatin1();
+	const char *body = begin;
+	bool srOk = true;
+
+	/* Only the header is split into strings */
+	const int header_lines = ScopyFileHeader::getHeader().size() + 1;
+	for (const char *p = begin; p < end &&
+			raw_data.size() < header_lines;) {
+		Line line;
+		p = next_line(p, end, line);
+
+		QStringList list = QString::fromUtf8(line.begin,
+				line.end - line.begin).split(separator,
+				QString::SkipEmptyParts);
+		if (list.size() > 0) {
+			raw_data.push_back(list.toVector());
+			body = p;
 		}
+	}
 
-		//check if it has a header or not
-		/*
-		*  Header format
-		*
-		*       ;Scopy version <separator> abcdefg
-		*       ;Exported on <separator> Wed Apr 4 13:49:01 2018
-		*       ;Device <separator> M2K
-		*       ;Nr of samples <separator> 1234
-		*       ;Sample rate <separator> 1234 or 0 if it does not have samp. rate
-		*       ;Tool: <separator> Oscilloscope/ Spectrum ...
-		*       ;Additional Information
-		*/
-
-		hasHeader = ScopyFileHeader::hasValidHeader(raw_data);
-		if (hasHeader) {
+	//check if it has a header or not
+	/*
+	*  Header format
+	*
+	*       ;Scopy version <separator> abcdefg
+	*       ;Exported on <separator> Wed Apr 4 13:49:01 2018
+	*       ;Device <separator> M2K
+	*       ;Nr of samples <separator> 1234
+	*       ;Sample rate <separator> 1234 or 0 if it does not have samp. rate
+	*       ;Tool: <separator> Oscilloscope/ Spectrum ...
+	*       ;Additional Information
+	*/
+
+	hasHeader = ScopyFileHeader::hasValidHeader(raw_data);
+	if (hasHeader) {
 
-			format = SCOPY;
+		format = SCOPY;
 
-			//first column in data is the time!!! when retrieving channel data start from data[1]
-			for (int i = 1; i < raw_data[6].size(); ++i) {
-				additionalInformation.push_back(raw_data[6][i]);
-			}
+		if (raw_data.size() < header_lines || raw_data[4].size() < 2) {
+			throw FileManagerException("File is corrupted!");
+		}
 
-			sampleRate = raw_data[4][1].toDouble(&srOk);
-			if (!srOk) {
-				throw FileManagerException("File is corrupted!");
-			}
-			//should be 0 if read from network/spectrum analyzer exported file
+		//first column in data is the time!!! when retrieving channel data start from data[1]
+		for (int i = 1; i < raw_data[6].size(); ++i) {
+			additionalInformation.push_back(raw_data[6][i]);
+		}
+
+		sampleRate = raw_data[4][1].toDouble(&srOk);
+		if (!srOk) {
+			throw FileManagerException("File is corrupted!");
+		}
+		//should be 0 if read from network/spectrum analyzer exported file
 
-			for (int j = 1; j < raw_data[7].size(); ++j)
-				columnNames.push_back(raw_data[7][j]);
+		for (int j = 1; j < raw_data[7].size(); ++j)
+			columnNames.push_back(raw_data[7][j]);
+	} else {
 
-			data.resize(raw_data.size() - 8);
-			for (int i = 0; i < data.size(); ++i) {
-				data[i].resize(raw_data[i + 8].size() - 1);
-			}
+		format = RAW;
+		body = begin;
+	}
 
-			for (int i = 8; i < raw_data.size(); ++i) {
-				for (int j = 1; j < raw_data[i].size(); ++j) {
-					data[i - 8][j - 1] = raw_data[i][j].toDouble(&dataOk);
-					if (!dataOk) {
-						throw FileManagerException("File is corrupted!");
-					}
+	/* The first data line gives the width every other one must have */
+	const int skip = hasHeader ? 1 : 0;
+	int fields = 0;
+	for (const char *p = body; p < end && !fields;) {
+		Line line;
+		p = next_line(p, end, line);
+		fields = count_fields(line, sep);
+	}
+
+	if (fields <= skip) {
+		nrOfSamples = 0;
+		return;
+	}
+
+	/* Chunks end on line boundaries, so each one is parsed alone */
+	size_t nb_chunks = std::max<size_t>(1, std::min<size_t>(
+			std::thread::hardware_concurrency(),
+			(end - body) / min_chunk_size));
+	std::vector<const char *> bounds(nb_chunks + 1, end);
+
+	bounds[0] = body;
+	for (size_t i = 1; i < nb_chunks; i++) {
+		const char *p = std::max(bounds[i - 1],
+				body + (end - body) * i / nb_chunks);
+		const char *nl = static_cast<const char *>(
+				memchr(p, '\n', end - p));
+		bounds[i] = nl ? nl + 1 : end;
+	}
+
+	/* First pass, the line count of each chunk gives its first row */
+	std::vector<size_t> first_row(nb_chunks + 1, 0);
+	run_chunks(nb_chunks, [&](size_t chunk) {
+		size_t rows = 0;
+		for (const char *p = bounds[chunk]; p < bounds[chunk + 1];) {
+			Line line;
+			p = next_line(p, bounds[chunk + 1], line);
+			rows += count_fields(line, sep) > 0;
+		}
+		first_row[chunk + 1] = rows;
+	});
+
+	for (size_t i = 0; i < nb_chunks; i++) {
+		first_row[i + 1] += first_row[i];
+	}
+
+	const size_t rows = first_row[nb_chunks];
+	const int width = fields - skip;
+	std::vector<double *> out(width);
+
+	columns.resize(width);
+	for (int i = 0; i < width; i++) {
+		columns[i].resize(rows);
+		out[i] = columns[i].data();
+	}
+
+	/* Second pass, straight into the columns */
+	std::atomic<bool> corrupted(false);
+	run_chunks(nb_chunks, [&](size_t chunk) {
+		size_t row = first_row[chunk];
+
+		for (const char *p = bounds[chunk];
+				p < bounds[chunk + 1] && !corrupted;) {
+			Line line;
+			p = next_line(p, bounds[chunk + 1], line);
+
+			int field = 0;
+			const char *c = line.begin;
+			while (c < line.end) {
+				if (*c == sep) {
+					c++;
+					continue;
 				}
-			}
-		} else {
 
-			format = RAW;
+				const char *stop = static_cast<const char *>(
+						memchr(c, sep, line.end - c));
+				stop = stop ? stop : line.end;
 
-			data.resize(raw_data.size());
-			for (int i = 0; i < data.size(); ++i) {
-				data[i].resize(raw_data[i].size());
-			}
+				if (field >= fields) {
+					corrupted = true;
+					break;
+				}
 
-			for (int i = 0; i < raw_data.size(); ++i) {
-				for (int j = 0; j < raw_data[i].size(); ++j) {
-					data[i][j] = raw_data[i][j].toDouble(&dataOk);
-					if (!dataOk) {
-						throw FileManagerException("File is corrupted!");
-					}
+				if (field >= skip && !parse_double(c, stop,
+						out[field - skip][row])) {
+					corrupted = true;
+					break;
 				}
+
+				field++;
+				c = stop;
+			}
+
+			if (field > 0) {
+				corrupted = corrupted || field != fields;
+				row++;
 			}
 		}
+	});
 
-		nrOfSamples = data.size();
+	if (corrupted) {
+		columns.clear();
+		throw FileManagerException("File is corrupted!");
 	}
+
+	nrOfSamples = rows;
 }
 
 void FileManager::save(QVector<double> data, QString name)
 {
-	this->columnNames.push_back(name);
-
-	if (this->data.size() == 0) {
-		this->data.resize(data.size());
-	}
-
-	for (int i = 0; i < data.size(); ++i) {
-		this->data[i].push_back(data[i]);
-	}
+	save(data.size(), [data](size_t first, size_t count, double *out) {
+		std::copy_n(data.constData() + first, count, out);
+	}, name);
+	exportColumns.back().values = data;
 }
 
 void FileManager::save(QVector<QVector<double> > data, QStringList columnNames)
 {
-	for (auto &column : data) {
-		this->data.push_back(column);
+	/* The rows of data become columns, one per value of the widest */
+	int width = 0;
+	for (auto &row : data) {
+		width = std::max(width, row.size());
+	}
+
+	for (int j = 0; j < width; ++j) {
+		exportColumns.push_back({ (size_t)data.size(),
+			[data, j](size_t first, size_t count, double *out) {
+				for (size_t i = 0; i < count; ++i) {
+					const QVector<double> &row = data[first + i];
+					out[i] = j < row.size() ? row[j] : 0.0;
+				}
+			}});
 	}
 
 	for (auto &column_name : columnNames) {
@@ -188,29 +671,46 @@ void FileManager::save(QVector<QVector<double> > data, QStringList columnNames)
 	}
 }
 
-QVector<double> FileManager::read(int index)
+void FileManager::save(size_t size, ColumnReader reader, QString name)
 {
-	if (index < 0 || index + 1 >= data.size()) {
-		return QVector<double>();
-	}
+	exportColumns.push_back({ size, reader });
+	columnNames.push_back(name);
+}
 
+QVector<double> FileManager::read(int index)
+{
 	if (hasHeader) {
 		index++;
 	}
 
-	QVector<double> channel_data;
-	for (int i = 0; i < nrOfSamples; ++i) {
-		channel_data.push_back(data[i][index]);
+	if (index < 0 || index >= columns.size()) {
+		return QVector<double>();
 	}
 
-	return channel_data;
+	return columns[index];
 }
 
 QVector<QVector<double>> FileManager::read()
 {
+	/* Rows are only built for the callers still wanting them */
+	if (data.isEmpty() && !columns.isEmpty()) {
+		data.resize(nrOfSamples);
+		for (int i = 0; i < data.size(); ++i) {
+			data[i].resize(columns.size());
+			for (int j = 0; j < columns.size(); ++j) {
+				data[i][j] = columns[j][i];
+			}
+		}
+	}
+
 	return data;
 }
 
+QVector<QVector<double>> FileManager::readColumns() const
+{
+	return columns;
+}
+
 void FileManager::setColumnName(int index, QString name)
 {
 	if (index < 0 || index >= data.size()) {
@@ -250,30 +750,27 @@ double FileManager::getNrOfSamples() const
 
 int FileManager::getNrOfChannels() const
 {
-	if (data.size() == 0) {
-		return 0;
+	int width = columns.size();
+
+	if (width == 0) {
+		if (data.size() == 0) {
+			return 0;
+		}
+		width = data[0].size();
 	}
 
 	if (hasHeader) {
-		return data[0].size() - 1;
+		return width - 1;
 	} else {
-		return data[0].size();
+		return width;
 	}
 }
 
-void FileManager::performWrite()
+QByteArray FileManager::textHeader(size_t rows) const
 {
-	QString additionalInfo = "";
-	if (openedFor == IMPORT) {
-		qDebug() << "Can't write when opened for import!";
-		return;
-	}
-
-	QFile exportFile(filename);
-	exportFile.open(QIODevice::WriteOnly);
-	QTextStream exportStream(&exportFile);
-
-	additionalInfo = (additionalInformation.size() != 0) ? additionalInformation[0] : "";
+	QString text;
+	QTextStream exportStream(&text);
+	QString additionalInfo = (additionalInformation.size() != 0) ? additionalInformation[0] : "";
 
 	QStringList header = ScopyFileHeader::getHeader();
 
@@ -281,7 +778,7 @@ void FileManager::performWrite()
 	exportStream << header[0] << separator << QString(SCOPY_VERSION_GIT) << "\n";
 	exportStream << header[1] << separator << QDate::currentDate().toString("dddd MMMM dd/MM/yyyy") << "\n";
 	exportStream << header[2] << separator << "M2K" << "\n";
-	exportStream << header[3] << separator << data.size() << "\n";
+	exportStream << header[3] << separator << (qulonglong)rows << "\n";
 	exportStream << header[4] << separator << sampleRate << "\n";
 	exportStream << header[5] << separator << toolName << "\n";
 	exportStream << header[6] << separator << additionalInfo << "\n";
@@ -296,20 +793,406 @@ void FileManager::performWrite()
 		skipFirstSeparator = false;
 	}
 	exportStream << "\n";
+	exportStream.flush();
+
+	return text.toUtf8();
+}
+
+bool FileManager::writeSidecar(size_t rows, const std::vector<int> &written) const
+{
+	QFileInfo info(filename);
+	QFile sidecar(info.path() + "/" + info.completeBaseName() + ".json");
+	if (!sidecar.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	QJsonObject root = metadata;
+	QJsonArray cols;
+
+	for (int j : written) {
+		QJsonObject col;
+		col["name"] = j < columnNames.size() ? columnNames[j] : QString();
+		if (fileType == BIN) {
+			col["scale"] = calibration[j].first;
+			col["offset"] = calibration[j].second;
+		}
+		cols.append(col);
+	}
+
+	root["file"] = info.fileName();
+	root["dtype"] = fileType == BIN ? "<i2" : "<f4";
+	root["shape"] = QJsonArray() << (qint64)rows << (int)written.size();
+	root["columns"] = cols;
+	root["sample_rate"] = sampleRate;
+	root["tool"] = toolName;
+	root["version"] = QString(SCOPY_VERSION_GIT);
+	if (!additionalInformation.isEmpty()) {
+		root["additional_information"] =
+			QJsonArray::fromStringList(additionalInformation);
+	}
+
+	QByteArray json = QJsonDocument(root).toJson();
+
+	return sidecar.write(json) == json.size();
+}
+
+bool FileManager::performWrite(WriteProgress progress)
+{
+	if (openedFor == IMPORT) {
+		qDebug() << "Can't write when opened for import!";
+		return false;
+	}
+
+	if (fileType == ARCHIVE) {
+		return writeArchive(progress);
+	}
+
+	if (fileType == MAT) {
+		return writeMat(progress);
+	}
+
+	QFile exportFile(filename);
+	if (!exportFile.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	size_t rows = 0;
+	for (const ExportColumn &column : exportColumns) {
+		rows = std::max(rows, column.size);
+	}
+
+	/* Every column goes to the text and .npy files, only the ones
+	 * with a calibration back to ADC codes to the raw one */
+	std::vector<int> written;
+	for (size_t j = 0; j < exportColumns.size(); ++j) {
+		if (fileType != BIN || calibration.contains(j)) {
+			written.push_back(j);
+		}
+	}
+
+	ExportWriter writer(exportFile);
+	std::vector<std::vector<double>> chunk(exportColumns.size(),
+			std::vector<double>(write_chunk_rows));
+	std::function<void(size_t, size_t)> writeChunk;
+
+	/* The rows are encoded from chunks pulled from the columns, the
+	 * sources are never copied whole */
+	const QByteArray sep = separator.toUtf8();
+	const char decimal_point = *localeconv()->decimal_point;
+
+	switch (fileType) {
+	case NPY:
+		write_bytes(writer, npy_header("<f4", rows, written.size()));
+		writeChunk = [&](size_t first, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				char *p = writer.reserve(written.size() * 4);
+				for (int j : written) {
+					float value = first + i < exportColumns[j].size ?
+						chunk[j][i] : NAN;
+					quint32 bits;
+					memcpy(&bits, &value, sizeof(bits));
+					qToLittleEndian(bits, reinterpret_cast<uchar *>(p));
+					p += 4;
+				}
+				writer.commit(p);
+			}
+		};
+		break;
+	case BIN:
+		writeChunk = [&](size_t first, size_t count) {
+			for (size_t i = 0; i < count; ++i) {
+				char *p = writer.reserve(written.size() * 2);
+				for (int j : written) {
+					const QPair<double, double> &cal = calibration[j];
+					double code = first + i < exportColumns[j].size ?
+						std::round((chunk[j][i] - cal.second) /
+							   cal.first) : 0.0;
+					qint16 value = std::max(-32768.0,
+							std::min(32767.0, code));
+					qToLittleEndian(value, reinterpret_cast<uchar *>(p));
+					p += 2;
+				}
+				writer.commit(p);
+			}
+		};
+		break;
+	default:
+		write_bytes(writer, textHeader(rows));
+		writeChunk = [&](size_t first, size_t count) {
+			const size_t row_size = 21 + exportColumns.size() *
+				(sep.size() + 32);
+
+			for (size_t i = 0; i < count; ++i) {
+				char *p = writer.reserve(row_size);
+				p = format_uint(p, first + i);
+				for (size_t j = 0; j < exportColumns.size(); ++j) {
+					if (first + i >= exportColumns[j].size) {
+						continue;
+					}
+					memcpy(p, sep.constData(), sep.size());
+					p = format_double(p + sep.size(), chunk[j][i],
+							decimal_point);
+				}
+				*p++ = '\n';
+				writer.commit(p);
+			}
+		};
+		break;
+	}
+
+	bool cancelled = false;
+
+	for (size_t first = 0; first < rows && !cancelled && writer.good();
+			first += write_chunk_rows) {
+		size_t count = std::min(write_chunk_rows, rows - first);
+
+		for (int j : written) {
+			const ExportColumn &column = exportColumns[j];
+			if (column.size > first) {
+				column.reader(first, std::min(count,
+						column.size - first), chunk[j].data());
+			}
+		}
+
+		writeChunk(first, count);
 
-	for (int i = 0; i < data.size(); ++i) {
-		skipFirstSeparator = true;
-		exportStream << QString::number(i) << separator;
-		for (int j = 0; j < data[i].size(); ++j) {
-			if(!skipFirstSeparator)
-				exportStream << separator;
-			exportStream << data[i][j];
-			skipFirstSeparator = false;
+		if (progress && !progress(first + count, rows)) {
+			cancelled = true;
 		}
-		exportStream << "\n";
 	}
 
+	bool ok = writer.finish() && !cancelled;
 	exportFile.close();
+
+	if (ok && (fileType == NPY || fileType == BIN)) {
+		ok = writeSidecar(rows, written);
+	}
+
+	if (!ok) {
+		QFile::remove(filename);
+	}
+
+	return ok;
+}
+
+bool FileManager::writeArchive(const WriteProgress &progress)
+{
+	std::vector<CaptureArchive::Stream> streams;
+	std::vector<CaptureArchive::StreamReader> readers;
+
+	for (size_t j = 0; j < exportColumns.size(); ++j) {
+		const ExportColumn column = exportColumns[j];
+		CaptureArchive::Stream stream;
+
+		stream.name = (int)j < columnNames.size() ? columnNames[j] : QString();
+		stream.samples = column.size;
+
+		/* The columns having a calibration go back to codes, the
+		 * archive keeps it to give the volts when read */
+		if (calibration.contains(j)) {
+			const QPair<double, double> cal = calibration[j];
+
+			stream.encoding = CaptureArchive::ANALOG_INT16;
+			stream.unit_size = sizeof(qint16);
+			stream.scale = cal.first;
+			stream.offset = cal.second;
+			readers.push_back([column, cal](uint64_t first,
+					uint64_t count, uint8_t *out) {
+				std::vector<double> values(count);
+				column.reader(first, count, values.data());
+
+				for (uint64_t i = 0; i < count; ++i) {
+					double code = std::round((values[i] -
+							cal.second) / cal.first);
+					qint16 value = std::max(-32768.0,
+							std::min(32767.0, code));
+					memcpy(out + i * sizeof(value), &value,
+					       sizeof(value));
+				}
+			});
+		} else {
+			stream.encoding = CaptureArchive::FLOAT64;
+			stream.unit_size = sizeof(double);
+			stream.scale = 1.0;
+			stream.offset = 0.0;
+			readers.push_back([column](uint64_t first,
+					uint64_t count, uint8_t *out) {
+				column.reader(first, count,
+					      reinterpret_cast<double *>(out));
+			});
+		}
+
+		streams.push_back(stream);
+	}
+
+	QJsonObject root = metadata;
+	root["tool"] = toolName;
+	root["version"] = QString(SCOPY_VERSION_GIT);
+	if (!additionalInformation.isEmpty()) {
+		root["additional_information"] =
+			QJsonArray::fromStringList(additionalInformation);
+	}
+
+	return CaptureArchive::write(filename, streams, readers, sampleRate,
+				     root, progress);
+}
+
+void FileManager::importArchive()
+{
+	CaptureArchive archive;
+
+	if (!archive.open(filename)) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	const std::vector<CaptureArchive::Stream> &streams = archive.streams();
+	uint64_t rows = streams.empty() ? 0 : streams[0].samples;
+
+	/* Laid out as a Scopy text file: the sample index, then one
+	 * column per stream */
+	columns.resize(streams.size() + 1);
+	columns[0].resize(rows);
+	for (uint64_t i = 0; i < rows; ++i) {
+		columns[0][i] = i;
+	}
+
+	for (size_t j = 0; j < streams.size(); ++j) {
+		if (streams[j].encoding == CaptureArchive::LOGIC) {
+			columns.clear();
+			throw FileManagerException("Logic captures can only be "
+						   "loaded by the Logic Analyzer");
+		}
+
+		columns[j + 1].resize(streams[j].samples);
+		if (streams[j].samples != rows ||
+				!archive.readValues(j, 0, rows,
+						    columns[j + 1].data())) {
+			columns.clear();
+			throw FileManagerException("File is corrupted!");
+		}
+
+		columnNames.push_back(streams[j].name);
+	}
+
+	QJsonArray info = archive.metadata()["additional_information"].toArray();
+	for (const QJsonValue &value : info) {
+		additionalInformation.push_back(value.toString());
+	}
+
+	hasHeader = true;
+	format = SCOPY;
+	sampleRate = archive.sampleRate();
+	nrOfSamples = rows;
+}
+
+bool FileManager::writeMat(const WriteProgress &progress)
+{
+	/* Only the columns not saved from a vector are read into one,
+	 * the others are written from theirs */
+	std::vector<QVector<double>> values;
+	std::vector<MatFile::Column> matColumns;
+
+	values.reserve(exportColumns.size());
+	for (size_t j = 0; j < exportColumns.size(); ++j) {
+		const ExportColumn &column = exportColumns[j];
+		QVector<double> columnValues = column.values;
+
+		if ((size_t)columnValues.size() != column.size) {
+			columnValues.resize(column.size);
+			column.reader(0, column.size, columnValues.data());
+		}
+		values.push_back(columnValues);
+
+		matColumns.push_back({ (int)j < columnNames.size() ?
+				columnNames[j] : QString("column"),
+				values.back().constData(), column.size });
+	}
+
+	return MatFile::write(filename, matColumns, sampleRate, progress);
+}
+
+void FileManager::importMat()
+{
+	std::shared_ptr<MatFile> mat = MatFile::open(filename);
+
+	if (!mat) {
+		throw FileManagerException("Can't open selected file");
+	}
+
+	/* The vectors as long as the first one are the columns */
+	std::vector<int> vars;
+	size_t rows = 0;
+	for (size_t i = 0; i < mat->variables().size(); ++i) {
+		const MatFile::Variable &var = mat->variables()[i];
+		size_t length = var.rows * var.cols;
+
+		if (!var.usable || var.name == MatFile::sampleRateName) {
+			continue;
+		}
+		if (vars.empty()) {
+			rows = length;
+		}
+		if (length == rows) {
+			vars.push_back(i);
+		}
+	}
+
+	hasHeader = mat->readScalar(MatFile::sampleRateName, sampleRate);
+
+	/* With a sample rate it is laid out as a Scopy file, the sample
+	 * index first, else as a raw one */
+	if (hasHeader) {
+		format = SCOPY;
+		columns.resize(1);
+		columns[0].resize(rows);
+		for (size_t i = 0; i < rows; ++i) {
+			columns[0][i] = i;
+		}
+	} else {
+		format = RAW;
+		sampleRate = 0;
+	}
+
+	for (int var : vars) {
+		QVector<double> column(rows);
+
+		if (!mat->read(var, 0, rows, column.data())) {
+			columns.clear();
+			throw FileManagerException("File is corrupted!");
+		}
+
+		columns.push_back(column);
+		if (hasHeader) {
+			columnNames.push_back(mat->variables()[var].name);
+		}
+	}
+
+	nrOfSamples = rows;
+}
+
+void FileManager::setCalibration(int column, double scale, double offset)
+{
+	if (scale != 0.0) {
+		calibration[column] = qMakePair(scale, offset);
+	}
+}
+
+void FileManager::setMetadata(const QString &key, const QJsonValue &value)
+{
+	metadata[key] = value;
+}
+
+QVector<double> FileManager::seriesSnapshot(
+		const QwtSeriesData<QPointF> *series, bool y)
+{
+	QVector<double> values(series->size());
+
+	for (size_t i = 0; i < series->size(); ++i) {
+		QPointF point = series->sample(i);
+		values[i] = y ? point.y() : point.x();
+	}
+
+	return values;
 }
 
 QStringList FileManager::getAdditionalInformation() const
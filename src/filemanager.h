@@ -24,9 +24,17 @@
 #include <QString>
 #include <QVector>
 #include <QStringList>
+#include <QJsonObject>
+#include <QMap>
+#include <QPair>
 
 #include <exception>
+#include <functional>
 #include <iostream>
+#include <vector>
+
+class QPointF;
+template <typename T> class QwtSeriesData;
 
 
 namespace adiscope {
@@ -46,9 +54,26 @@ public:
 
 	enum FileType {
 		CSV,
-		TXT
+		TXT,
+		/* float32 NumPy array, metadata in a .json next to it */
+		NPY,
+		/* int16 ADC codes of the calibrated columns, the
+		 * calibration and metadata in a .json next to it */
+		BIN,
+		/* Compressed CaptureArchive, the calibrated columns as
+		 * their codes, imported back too */
+		ARCHIVE,
+		/* MATLAB, a variable per column and the sample rate, with
+		 * MATLAB_SUPPORT_SIGGEN only */
+		MAT
 	};
 
+	/* Fills out with count values of a column, starting at first */
+	typedef std::function<void(size_t first, size_t count, double *out)>
+		ColumnReader;
+	/* Rows written so far out of total, returning false cancels */
+	typedef std::function<bool(size_t done, size_t total)> WriteProgress;
+
 	FileManager(QString toolName);
 	~FileManager();
 
@@ -56,10 +81,17 @@ public:
 
 	void save(QVector<double> data, QString name);
 	void save(QVector<QVector<double>> data, QStringList column_names);
+	/* The values are only pulled by performWrite, a chunk at a time;
+	 * an ARCHIVE export calls reader from several threads at once */
+	void save(size_t size, ColumnReader reader, QString name);
 
 	QVector<double> read(int index);
 	QVector<QVector<double>> read();
 
+	/* Imported data one vector per column, the sample index column
+	 * of a Scopy file excluded */
+	QVector<QVector<double>> readColumns() const;
+
 	void setColumnName(int index, QString name);
 	QString getColumnName(int index);
 
@@ -69,7 +101,20 @@ public:
 	double getNrOfSamples() const;
 	int getNrOfChannels() const;
 
-	void performWrite();
+	/* False if the file could not be written or the write was
+	 * cancelled, the partial file is removed */
+	bool performWrite(WriteProgress progress = WriteProgress());
+
+	/* Column values are scale * code + offset, a BIN export writes
+	 * the codes of the columns having one */
+	void setCalibration(int column, double scale, double offset);
+	/* Extra entry of the .json written next to NPY and BIN exports */
+	void setMetadata(const QString &key, const QJsonValue &value);
+
+	/* The x or y values of a plot curve, copied once so they can be
+	 * written while the plot goes on updating */
+	static QVector<double> seriesSnapshot(
+			const QwtSeriesData<QPointF> *series, bool y);
 
 	QStringList getAdditionalInformation() const;
 	void setAdditionalInformation(const QString& value);
@@ -78,8 +123,27 @@ public:
 	void setFormat(const FileFormat &value);
 
 private:
+	void parseImport(const char *begin, const char *end);
+	void importArchive();
+	bool writeArchive(const WriteProgress &progress);
+	void importMat();
+	bool writeMat(const WriteProgress &progress);
+	QByteArray textHeader(size_t rows) const;
+	bool writeSidecar(size_t rows, const std::vector<int> &written) const;
 
 	QVector<QVector<double>> data;
+	QVector<QVector<double>> columns;
+
+	struct ExportColumn {
+		size_t size;
+		ColumnReader reader;
+		/* The vector given to save(), if any, the MAT export
+		 * writes straight from it */
+		QVector<double> values;
+	};
+	std::vector<ExportColumn> exportColumns;
+	QMap<int, QPair<double, double>> calibration;
+	QJsonObject metadata;
 	QStringList columnNames;
 	QString filename;
 	bool hasHeader;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef M2K_FRAME_HANDOFF_H
+#define M2K_FRAME_HANDOFF_H
+
+#include <atomic>
+
+namespace adiscope {
+
+/*
+ * Lock-free triple buffer used to hand frames from a GNU Radio sink
+ * (the single producer) to its plot widget (the single consumer).
+ *
+ * The producer fills write_buffer() and publish()es it, which never
+ * blocks: an unread frame still waiting in the middle slot is simply
+ * replaced by the newer one. The consumer fetch()es and then reads
+ * read_buffer(), which it owns until its next fetch(), so the newest
+ * complete frame is always the one being displayed.
+ *
+ * publish() returns true only when the consumer has to be woken up,
+ * i.e. when it has picked up the previous notification already. This
+ * way the sink posts at most one event at a time, whatever the GUI's
+ * refresh rate is.
+ */
+template <typename T>
+class frame_handoff
+{
+public:
+	frame_handoff() :
+		d_back(0),
+		d_middle(1),
+		d_front(2),
+		d_notify_pending(false)
+	{
+	}
+
+	/* Producer side */
+	T &write_buffer()
+	{
+		return d_frames[d_back];
+	}
+
+	bool publish()
+	{
+		int old = d_middle.exchange(d_back | FRAME_NEW,
+				std::memory_order_acq_rel);
+		d_back = old & FRAME_INDEX;
+
+		return !d_notify_pending.exchange(true,
+				std::memory_order_acq_rel);
+	}
+
+	/* Consumer side. Returns false if there's no frame newer than the
+	 * one already in read_buffer(). */
+	bool fetch()
+	{
+		/* Cleared first, so that a frame published from now on
+		 * comes with a new notification */
+		d_notify_pending.store(false, std::memory_order_release);
+
+		if (!(d_middle.load(std::memory_order_acquire) & FRAME_NEW))
+			return false;
+
+		int old = d_middle.exchange(d_front,
+				std::memory_order_acq_rel);
+		d_front = old & FRAME_INDEX;
+
+		return true;
+	}
+
+	const T &read_buffer() const
+	{
+		return d_frames[d_front];
+	}
+
+private:
+	static const int FRAME_INDEX = 0x3;
+	static const int FRAME_NEW = 0x4;
+
+	T d_frames[3];
+	int d_back;
+	std::atomic<int> d_middle;
+	int d_front;
+	std::atomic<bool> d_notify_pending;
+
+	frame_handoff(const frame_handoff&) = delete;
+	frame_handoff& operator=(const frame_handoff&) = delete;
+};
+
+} /* namespace adiscope */
+
+#endif /* M2K_FRAME_HANDOFF_H */
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FRAME_LISTENER_H
+#define FRAME_LISTENER_H
+
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Receives the complete frames captured by another sink, so that a view
+ * of the same channels can be built without another branch of the
+ * flowgraph copying the samples again.
+ */
+class frame_listener
+{
+public:
+	virtual ~frame_listener() {}
+
+	/* Called from the flowgraph thread, one pointer per channel to
+	 * nitems samples, only valid during the call */
+	virtual void frame_ready(const std::vector<const float *> &channels,
+			int nitems) = 0;
+};
+}
+
+#endif // FRAME_LISTENER_H
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "frequency_compensation_cascade.h"
+#include "acquisition_clock.h"
+
+#include <gnuradio/io_signature.h>
+
+#include <cstring>
+
+using namespace adiscope;
+
+/* Chunks of a stage filtered side by side; the loops over them are
+ * the ones the compiler turns into SIMD */
+#define CASCADE_LANES 8
+
+/* Below this many samples per lane the fix-up isn't worth it */
+#define CASCADE_MIN_CHUNK 16
+
+frequency_compensation_cascade::sptr frequency_compensation_cascade::make(
+		const std::vector<frequency_compensation_filter::sptr> &stages)
+{
+	return gnuradio::get_initial_sptr(
+			new frequency_compensation_cascade(stages));
+}
+
+frequency_compensation_cascade::frequency_compensation_cascade(
+		const std::vector<frequency_compensation_filter::sptr> &stages) :
+	gr::sync_block("frequency_compensation_cascade",
+			gr::io_signature::make(1, 1, sizeof(short)),
+			gr::io_signature::make(1, 1, sizeof(short))),
+	d_stages(stages),
+	d_state(stages.size()),
+	d_alpha(stages.size()),
+	d_gain(stages.size()),
+	d_buffer_start_key(pmt::intern("buffer_start")),
+	d_time_key(pmt::intern(ACQUISITION_TIME_TAG))
+{
+	for (auto &state : d_state) {
+		state.enabled = false;
+		state.prev_in = 0;
+		state.out = 0;
+	}
+
+	d_active.reserve(stages.size());
+}
+
+int frequency_compensation_cascade::work(int noutput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	const short *in = static_cast<const short *>(input_items[0]);
+	short *out = static_cast<short *>(output_items[0]);
+
+	_tag_buffers(noutput_items);
+
+	/* Snapshot the configuration of the stages once per call */
+	d_active.clear();
+
+	for (unsigned int k = 0; k < d_stages.size(); k++) {
+		if (!d_stages[k]->get_enable()) {
+			d_state[k].enabled = false;
+			continue;
+		}
+
+		float delta = 1.0 / d_stages[k]->get_sample_rate();
+		float TC = d_stages[k]->get_TC() * float(1.0E-6);
+
+		d_alpha[k] = TC / (TC + delta);
+		d_gain[k] = d_stages[k]->get_filter_gain();
+
+		/* A stage that was just enabled starts from the current
+		 * sample, so that it doesn't see a step at its input */
+		if (!d_state[k].enabled) {
+			d_state[k].enabled = true;
+			d_state[k].prev_in = in[0];
+			d_state[k].out = 0;
+		}
+
+		d_active.push_back(k);
+	}
+
+	if (d_active.empty()) {
+		memcpy(out, in, noutput_items * sizeof(short));
+		return noutput_items;
+	}
+
+	/* Each stage is a first order high-pass filter whose output,
+	 * scaled by the stage gain, is added back to its input. The state
+	 * of the stages is carried over between calls. The stages run one
+	 * after the other over the whole buffer. */
+	if (d_x.size() < (size_t)noutput_items) {
+		d_x.resize(noutput_items);
+		d_diff.resize(noutput_items);
+		d_lanes.resize(noutput_items);
+	}
+
+	for (int i = 0; i < noutput_items; i++) {
+		d_x[i] = in[i];
+	}
+
+	for (unsigned int k : d_active) {
+		_run_stage(d_state[k], d_alpha[k], d_gain[k], noutput_items);
+	}
+
+	for (int i = 0; i < noutput_items; i++) {
+		out[i] = static_cast<short>(d_x[i]);
+	}
+
+	return noutput_items;
+}
+
+void frequency_compensation_cascade::_tag_buffers(int noutput_items)
+{
+	uint64_t nr = nitems_read(0);
+
+	get_tags_in_range(d_tags, 0, nr, nr + noutput_items,
+			d_buffer_start_key);
+	if (d_tags.empty()) {
+		return;
+	}
+
+	/* The refill that brought these samples just returned */
+	uint64_t now = acquisition_clock::now();
+
+	for (const auto &tag : d_tags) {
+		add_item_tag(0, tag.offset, d_time_key,
+				acquisition_clock::tag_value(now, tag.offset));
+	}
+}
+
+void frequency_compensation_cascade::_run_stage(stage_state &st,
+		float alpha, float gain, int n)
+{
+	float *x = d_x.data();
+	float *diff = d_diff.data();
+
+	diff[0] = x[0] - st.prev_in;
+	for (int i = 1; i < n; i++) {
+		diff[i] = x[i] - x[i - 1];
+	}
+	st.prev_in = x[n - 1];
+
+	const int chunk = n / CASCADE_LANES;
+	int done = 0;
+
+	if (chunk >= CASCADE_MIN_CHUNK) {
+		/* y[i] = alpha * (y[i - 1] + diff[i]) is linear, so each
+		 * chunk can be filtered from a zero state, side by side
+		 * with the others (the first one starts from the state of
+		 * the stage). The state a chunk really starts from then
+		 * adds alpha^(j + 1) * state to its j-th output. */
+		float *lanes = d_lanes.data();
+
+		for (int c = 0; c < CASCADE_LANES; c++) {
+			const float *src = diff + c * chunk;
+
+			for (int j = 0; j < chunk; j++) {
+				lanes[j * CASCADE_LANES + c] = src[j];
+			}
+		}
+
+		float y[CASCADE_LANES] = { st.out };
+
+		for (int j = 0; j < chunk; j++) {
+			float *row = lanes + j * CASCADE_LANES;
+
+			for (int c = 0; c < CASCADE_LANES; c++) {
+				y[c] = alpha * (y[c] + row[c]);
+				row[c] = y[c];
+			}
+		}
+
+		d_powers.resize(chunk);
+		float p = alpha;
+		for (int j = 0; j < chunk; j++) {
+			d_powers[j] = p;
+			p *= alpha;
+		}
+
+		/* The state each chunk starts from, in order */
+		float carry[CASCADE_LANES];
+		float state = y[0];
+
+		carry[0] = 0.0f;
+		for (int c = 1; c < CASCADE_LANES; c++) {
+			carry[c] = state;
+			state = y[c] + d_powers[chunk - 1] * state;
+		}
+
+		for (int c = 0; c < CASCADE_LANES; c++) {
+			float *dst = x + c * chunk;
+			const float *power = d_powers.data();
+
+			for (int j = 0; j < chunk; j++) {
+				dst[j] += gain * (lanes[j * CASCADE_LANES + c] +
+						power[j] * carry[c]);
+			}
+		}
+
+		st.out = state;
+		done = chunk * CASCADE_LANES;
+	}
+
+	for (int i = done; i < n; i++) {
+		st.out = alpha * (st.out + diff[i]);
+		x[i] += st.out * gain;
+	}
+}
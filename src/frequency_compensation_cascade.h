@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FREQUENCY_COMPENSATION_CASCADE_H
+#define FREQUENCY_COMPENSATION_CASCADE_H
+
+#include <gnuradio/sync_block.h>
+
+#include "frequency_compensation_filter.h"
+
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Applies a chain of frequency compensation stages in a single pass over
+ * the samples. The stages are regular frequency_compensation_filter
+ * objects and are only used for their configuration, so they can still be
+ * tuned through their own setters while the cascade is running.
+ *
+ * Being the first block after the source of every channel, it also tags
+ * the start of each acquisition buffer with its acquisition time (see
+ * acquisition_clock.h).
+ */
+class frequency_compensation_cascade : public gr::sync_block
+{
+public:
+	typedef boost::shared_ptr<frequency_compensation_cascade> sptr;
+
+	static sptr make(const std::vector<
+			 frequency_compensation_filter::sptr> &stages);
+
+	int work(int noutput_items,
+		 gr_vector_const_void_star &input_items,
+		 gr_vector_void_star &output_items);
+
+	size_t stages_count() const { return d_stages.size(); }
+
+private:
+	struct stage_state {
+		bool enabled;
+		float prev_in;
+		float out;
+	};
+
+	std::vector<frequency_compensation_filter::sptr> d_stages;
+	std::vector<stage_state> d_state;
+
+	std::vector<float> d_alpha;
+	std::vector<float> d_gain;
+	std::vector<unsigned int> d_active;
+
+	/* Scratch buffers of work(): the samples between the stages, the
+	 * differences seen by a stage, the same interleaved by lane and
+	 * the powers of the stage coefficient */
+	std::vector<float> d_x;
+	std::vector<float> d_diff;
+	std::vector<float> d_lanes;
+	std::vector<float> d_powers;
+
+	pmt::pmt_t d_buffer_start_key;
+	pmt::pmt_t d_time_key;
+	std::vector<gr::tag_t> d_tags;
+
+	void _run_stage(stage_state &st, float alpha, float gain, int n);
+	void _tag_buffers(int noutput_items);
+
+	explicit frequency_compensation_cascade(const std::vector<
+			frequency_compensation_filter::sptr> &stages);
+};
+}
+
+#endif /* FREQUENCY_COMPENSATION_CASCADE_H */
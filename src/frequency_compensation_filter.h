@@ -50,6 +50,7 @@ public:
 	virtual void set_filter_gain(float gain, int gain_mode = 2) = 0;
 	virtual float get_filter_gain(int gain_mode = 2) = 0;
 	virtual void set_sample_rate(float sample_rate) = 0;
+	virtual float get_sample_rate() = 0;
 	virtual bool get_high_gain() = 0;
 	virtual void set_high_gain(bool en) = 0;
 };
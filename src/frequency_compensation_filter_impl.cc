@@ -145,6 +145,11 @@ void frequency_compensation_filter_impl::set_sample_rate(float sample_rate)
 	this->sample_rate = sample_rate;
 }
 
+float frequency_compensation_filter_impl::get_sample_rate()
+{
+	return this->sample_rate;
+}
+
 bool frequency_compensation_filter_impl::get_high_gain()
 {
 	return this->high_gain;
@@ -54,6 +54,7 @@ public:
 	void set_filter_gain(float gain, int gain_mode);
 	float get_filter_gain(int gain_mode) override;
 	void set_sample_rate(float sample_rate);
+	float get_sample_rate() override;
 	bool get_high_gain() override;
 	void set_high_gain(bool en);
 };
@@ -0,0 +1,406 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gpu_power_spectrum.hpp"
+#include "logging_categories.h"
+#include "power_spectrum.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#ifdef HAVE_OPENCL_FFT
+#define CL_TARGET_OPENCL_VERSION 120
+#include <clFFT.h>
+#endif
+
+using namespace adiscope;
+
+const size_t gpu_power_spectrum::min_fft_size;
+const size_t gpu_power_spectrum::batch;
+
+static std::atomic<bool> gpu_enabled(false);
+
+#ifdef HAVE_OPENCL_FFT
+
+static const char *kernels_source = R"(
+__kernel void frames(__global const float *in, __global const float *window,
+		__global float *out, uint fft_size, uint hop)
+{
+	size_t k = get_global_id(0);
+	size_t f = get_global_id(1);
+
+	out[f * fft_size + k] = in[f * hop + k] * window[k];
+}
+
+__kernel void power(__global const float2 *bins, __global float *out,
+		uint fft_size)
+{
+	size_t k = get_global_id(0);
+	size_t f = get_global_id(1);
+	size_t half = fft_size / 2;
+	float2 b = bins[f * (half + 1) + (k <= half ? k : fft_size - k)];
+
+	out[f * fft_size + k] = b.x * b.x + b.y * b.y;
+}
+)";
+
+/* The device and the kernels, set up once for all the transforms */
+struct gpu_device
+{
+	bool ok = false;
+	cl_device_id device = nullptr;
+	cl_context context = nullptr;
+	cl_program program = nullptr;
+};
+
+static bool find_gpu(cl_device_id *device)
+{
+	cl_uint nb_platforms = 0;
+
+	if (clGetPlatformIDs(0, nullptr, &nb_platforms) != CL_SUCCESS ||
+			!nb_platforms) {
+		return false;
+	}
+
+	std::vector<cl_platform_id> platforms(nb_platforms);
+	clGetPlatformIDs(nb_platforms, platforms.data(), nullptr);
+
+	for (cl_platform_id platform : platforms) {
+		if (clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, device,
+					nullptr) == CL_SUCCESS) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static const gpu_device& shared_device()
+{
+	static std::once_flag once;
+	static gpu_device dev;
+
+	std::call_once(once, []() {
+		cl_int err;
+
+		if (!find_gpu(&dev.device)) {
+			CAT_DEBUG(CAT_SPECTRUM_ANALYZER) << "No OpenCL GPU, "
+				"the spectra are computed on the CPU";
+			return;
+		}
+
+		dev.context = clCreateContext(nullptr, 1, &dev.device,
+				nullptr, nullptr, &err);
+		if (err != CL_SUCCESS) {
+			return;
+		}
+
+		dev.program = clCreateProgramWithSource(dev.context, 1,
+				&kernels_source, nullptr, &err);
+		if (err != CL_SUCCESS || clBuildProgram(dev.program, 1,
+					&dev.device, nullptr, nullptr,
+					nullptr) != CL_SUCCESS) {
+			CAT_DEBUG(CAT_SPECTRUM_ANALYZER) << "Building the "
+				"OpenCL kernels failed";
+			return;
+		}
+
+		clfftSetupData setup;
+		if (clfftInitSetupData(&setup) != CLFFT_SUCCESS ||
+				clfftSetup(&setup) != CLFFT_SUCCESS) {
+			return;
+		}
+
+		dev.ok = true;
+	});
+
+	return dev;
+}
+
+struct gpu_power_spectrum::device_state
+{
+	cl_command_queue queue = nullptr;
+	cl_kernel frames = nullptr;
+	cl_kernel power = nullptr;
+	cl_mem in = nullptr;
+	cl_mem window = nullptr;
+	cl_mem windowed = nullptr;
+	cl_mem bins = nullptr;
+	cl_mem out = nullptr;
+	clfftPlanHandle plan = 0;
+	bool planned = false;
+
+	bool setup(const gpu_device& dev, size_t fft_size);
+
+	~device_state()
+	{
+		if (planned) {
+			clfftDestroyPlan(&plan);
+		}
+
+		for (cl_mem mem : { in, window, windowed, bins, out }) {
+			if (mem) {
+				clReleaseMemObject(mem);
+			}
+		}
+
+		if (frames) {
+			clReleaseKernel(frames);
+		}
+		if (power) {
+			clReleaseKernel(power);
+		}
+		if (queue) {
+			clReleaseCommandQueue(queue);
+		}
+	}
+};
+
+bool gpu_power_spectrum::device_state::setup(const gpu_device& dev,
+		size_t fft_size)
+{
+	size_t half = fft_size / 2;
+	size_t frames_size = batch * fft_size * sizeof(float);
+	cl_int err;
+
+	queue = clCreateCommandQueue(dev.context, dev.device, 0, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	/* Kernels keep their arguments, so each transform has its own */
+	frames = clCreateKernel(dev.program, "frames", &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	power = clCreateKernel(dev.program, "power", &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	/* Frames are at most fft_size apart, so batch frames fit in there */
+	in = clCreateBuffer(dev.context, CL_MEM_READ_ONLY, frames_size,
+			nullptr, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	window = clCreateBuffer(dev.context, CL_MEM_READ_ONLY,
+			fft_size * sizeof(float), nullptr, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	windowed = clCreateBuffer(dev.context, CL_MEM_READ_WRITE, frames_size,
+			nullptr, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	bins = clCreateBuffer(dev.context, CL_MEM_READ_WRITE,
+			batch * (half + 1) * 2 * sizeof(float), nullptr, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	out = clCreateBuffer(dev.context, CL_MEM_WRITE_ONLY, frames_size,
+			nullptr, &err);
+	if (err != CL_SUCCESS) {
+		return false;
+	}
+
+	size_t length = fft_size;
+
+	if (clfftCreateDefaultPlan(&plan, dev.context, CLFFT_1D,
+				&length) != CLFFT_SUCCESS) {
+		return false;
+	}
+	planned = true;
+
+	/* Unscaled, as FFTW gives them */
+	return clfftSetPlanPrecision(plan, CLFFT_SINGLE) == CLFFT_SUCCESS &&
+		clfftSetLayout(plan, CLFFT_REAL,
+				CLFFT_HERMITIAN_INTERLEAVED) == CLFFT_SUCCESS &&
+		clfftSetResultLocation(plan,
+				CLFFT_OUTOFPLACE) == CLFFT_SUCCESS &&
+		clfftSetPlanBatchSize(plan, batch) == CLFFT_SUCCESS &&
+		clfftSetPlanDistance(plan, fft_size,
+				half + 1) == CLFFT_SUCCESS &&
+		clfftSetPlanScale(plan, CLFFT_FORWARD, 1.0f) == CLFFT_SUCCESS &&
+		clfftBakePlan(plan, 1, &queue, nullptr,
+				nullptr) == CLFFT_SUCCESS;
+}
+
+bool gpu_power_spectrum::supported()
+{
+	return true;
+}
+
+std::unique_ptr<gpu_power_spectrum> gpu_power_spectrum::create(
+		size_t fft_size)
+{
+	if (!gpu_enabled || fft_size < min_fft_size || fft_size % 2) {
+		return nullptr;
+	}
+
+	const gpu_device& dev = shared_device();
+
+	if (!dev.ok) {
+		return nullptr;
+	}
+
+	std::unique_ptr<gpu_power_spectrum> spectrum(
+			new gpu_power_spectrum(fft_size));
+
+	if (!spectrum->d_state->setup(dev, fft_size) ||
+			!spectrum->set_window(*power_spectrum::hamming(
+					fft_size))) {
+		CAT_DEBUG(CAT_SPECTRUM_ANALYZER) << "No room on the GPU for"
+			<< fft_size << "point transforms";
+		return nullptr;
+	}
+
+	return spectrum;
+}
+
+bool gpu_power_spectrum::set_window(const std::vector<float>& window)
+{
+	if (window.size() != d_fft_size) {
+		return true;
+	}
+
+	return clEnqueueWriteBuffer(d_state->queue, d_state->window, CL_TRUE,
+			0, d_fft_size * sizeof(float), window.data(), 0,
+			nullptr, nullptr) == CL_SUCCESS;
+}
+
+bool gpu_power_spectrum::compute(const float *in, size_t hop,
+		size_t nframes, float *out)
+{
+	device_state& s = *d_state;
+	cl_uint size = d_fft_size;
+	cl_uint step = hop;
+
+	if (hop > d_fft_size) {
+		return false;
+	}
+
+	if (clSetKernelArg(s.frames, 0, sizeof(cl_mem), &s.in) ||
+			clSetKernelArg(s.frames, 1, sizeof(cl_mem), &s.window) ||
+			clSetKernelArg(s.frames, 2, sizeof(cl_mem),
+				&s.windowed) ||
+			clSetKernelArg(s.frames, 3, sizeof(cl_uint), &size) ||
+			clSetKernelArg(s.frames, 4, sizeof(cl_uint), &step) ||
+			clSetKernelArg(s.power, 0, sizeof(cl_mem), &s.bins) ||
+			clSetKernelArg(s.power, 1, sizeof(cl_mem), &s.out) ||
+			clSetKernelArg(s.power, 2, sizeof(cl_uint), &size)) {
+		return false;
+	}
+
+	for (size_t done = 0; done < nframes; done += batch) {
+		size_t n = std::min(batch, nframes - done);
+		size_t span = (n - 1) * hop + d_fft_size;
+		size_t global[2] = { d_fft_size, n };
+
+		/*
+		 * The queue is in order and the read at the end blocks, so
+		 * the input is still there when the write runs. The plan
+		 * always does a whole batch, the frames past n are stale
+		 * and never read back.
+		 */
+		if (clEnqueueWriteBuffer(s.queue, s.in, CL_FALSE, 0,
+					span * sizeof(float),
+					&in[done * hop], 0, nullptr,
+					nullptr) != CL_SUCCESS ||
+				clEnqueueNDRangeKernel(s.queue, s.frames, 2,
+					nullptr, global, nullptr, 0, nullptr,
+					nullptr) != CL_SUCCESS ||
+				clfftEnqueueTransform(s.plan, CLFFT_FORWARD, 1,
+					&s.queue, 0, nullptr, nullptr,
+					&s.windowed, &s.bins,
+					nullptr) != CLFFT_SUCCESS ||
+				clEnqueueNDRangeKernel(s.queue, s.power, 2,
+					nullptr, global, nullptr, 0, nullptr,
+					nullptr) != CL_SUCCESS ||
+				clEnqueueReadBuffer(s.queue, s.out, CL_TRUE, 0,
+					n * d_fft_size * sizeof(float),
+					&out[done * d_fft_size], 0, nullptr,
+					nullptr) != CL_SUCCESS) {
+			CAT_DEBUG(CAT_SPECTRUM_ANALYZER) << "GPU transform "
+				"failed, back to the CPU";
+			clFinish(s.queue);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+#else /* HAVE_OPENCL_FFT */
+
+struct gpu_power_spectrum::device_state
+{
+};
+
+bool gpu_power_spectrum::supported()
+{
+	return false;
+}
+
+std::unique_ptr<gpu_power_spectrum> gpu_power_spectrum::create(
+		size_t fft_size)
+{
+	return nullptr;
+}
+
+bool gpu_power_spectrum::set_window(const std::vector<float>& window)
+{
+	return false;
+}
+
+bool gpu_power_spectrum::compute(const float *in, size_t hop,
+		size_t nframes, float *out)
+{
+	return false;
+}
+
+#endif /* HAVE_OPENCL_FFT */
+
+gpu_power_spectrum::gpu_power_spectrum(size_t fft_size)
+	: d_fft_size(fft_size),
+	d_state(new device_state)
+{
+}
+
+gpu_power_spectrum::~gpu_power_spectrum()
+{
+}
+
+void gpu_power_spectrum::set_enabled(bool enabled)
+{
+	gpu_enabled = enabled;
+}
+
+bool gpu_power_spectrum::enabled()
+{
+	return gpu_enabled;
+}
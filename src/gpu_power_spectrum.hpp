@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef GPU_POWER_SPECTRUM_HPP
+#define GPU_POWER_SPECTRUM_HPP
+
+#include <memory>
+#include <vector>
+
+namespace adiscope {
+	/*
+	 * The work of power_spectrum::compute() on an OpenCL device, for a
+	 * few frames at once: the frames are cut out of the input and
+	 * windowed, transformed by one batched clFFT and reduced to their
+	 * squared magnitudes on the device, so only the samples go there
+	 * and only the powers come back.
+	 *
+	 * Only worth it for the large transforms, the copies cost more than
+	 * the FFT of a small frame. Without OpenCL in the build, or without
+	 * a device, create() gives nothing and the CPU does the work.
+	 */
+	class gpu_power_spectrum
+	{
+	public:
+		/* Smallest fft_size given to the device */
+		static const size_t min_fft_size = 1 << 18;
+
+		/* Frames transformed together */
+		static const size_t batch = 4;
+
+		/* Nothing if disabled, too small or no usable device */
+		static std::unique_ptr<gpu_power_spectrum> create(
+				size_t fft_size);
+
+		/* Picked by the transforms created from then on */
+		static void set_enabled(bool enabled);
+		static bool enabled();
+
+		/* Built with OpenCL; says nothing about a device */
+		static bool supported();
+
+		~gpu_power_spectrum();
+
+		/* False if the device failed; of fft_size samples */
+		bool set_window(const std::vector<float>& window);
+
+		/* nframes frames, each hop samples after the previous one,
+		 * fft_size outputs each as power_spectrum::compute() gives
+		 * them. False if the device failed, out is then undefined
+		 * and the transform is not to be used again. */
+		bool compute(const float *in, size_t hop, size_t nframes,
+				float *out);
+
+	private:
+		struct device_state;
+
+		explicit gpu_power_spectrum(size_t fft_size);
+
+		size_t d_fft_size;
+		std::unique_ptr<device_state> d_state;
+	};
+}
+
+#endif /* GPU_POWER_SPECTRUM_HPP */
@@ -428,6 +428,48 @@ void HardwareTrigger::setSourceChannel(uint chnIdx, bool intern_checked, bool ex
 	setSource(source);
 }
 
+HardwareTrigger::combination HardwareTrigger::sourceCombination() const
+{
+	QString mode = source();
+
+	if (mode.startsWith("a_OR_b")) {
+		return COMBINE_OR;
+	} else if (mode == "a_AND_b") {
+		return COMBINE_AND;
+	} else if (mode == "a_XOR_b") {
+		return COMBINE_XOR;
+	}
+
+	return COMBINE_NONE;
+}
+
+void HardwareTrigger::setSourceCombination(combination comb)
+{
+	if (numChannels() != 2) {
+		throw std::invalid_argument(
+			"Channel combinations need exactly 2 channels");
+	}
+
+	// Indices in lut_trigg_source
+	int idx;
+
+	switch (comb) {
+	case COMBINE_OR:
+		idx = m_trigger_in ? 8 : 2;
+		break;
+	case COMBINE_AND:
+		idx = 3;
+		break;
+	case COMBINE_XOR:
+		idx = 4;
+		break;
+	default:
+		throw std::invalid_argument("Not a channel combination");
+	}
+
+	setSource(lut_trigg_source[idx]);
+}
+
 int HardwareTrigger::delay() const
 {
 	long long delay;
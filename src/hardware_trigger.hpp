@@ -70,6 +70,13 @@ public:
 		trigger_in = 4,
 	};
 
+	enum combination {
+		COMBINE_NONE = 0,
+		COMBINE_OR = 1,
+		COMBINE_AND = 2,
+		COMBINE_XOR = 3,
+	};
+
 	struct Settings {
 		QList<condition> analog_condition;
 		QList<condition> digital_condition;
@@ -109,6 +116,15 @@ public:
 	int sourceChannel() const;
 	void setSourceChannel(uint chnIdx, bool intern_checked, bool extern_trigger_in_checked);
 
+	/*
+	 * Trigger on the combination of both channels, each qualified by its
+	 * own condition, level, hysteresis and mode, so that the device only
+	 * fills a buffer once the combination is met. Trigger in can only be
+	 * ORed on top of an OR.
+	 */
+	combination sourceCombination() const;
+	void setSourceCombination(combination comb);
+
 	bool triggerIn() const;
 	void setTriggerIn(bool bo);
 
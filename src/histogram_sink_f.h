@@ -45,6 +45,8 @@
 #include <gnuradio/sync_block.h>
 #include <qapplication.h>
 
+#include "frame_listener.h"
+
 namespace adiscope {
 
     /*!
@@ -73,8 +75,16 @@ namespace adiscope {
      * accumulates the data between calls to work. When accumulate is
      * activated, the y-axis autoscaling is turned on by default as
      * the values will quickly grow in the this direction.
+     *
+     * The binning is done by the sink, so only the bin counts go to
+     * the plot and the number of bins doesn't depend on its size. In
+     * accumulate mode every frame gets counted, plotted or not.
+     *
+     * Instead of being connected in the flowgraph, it can also be fed
+     * the frames of a scope sink as a frame_listener.
      */
-    class histogram_sink_f : virtual public gr::sync_block
+    class histogram_sink_f : virtual public gr::sync_block,
+                             public frame_listener
     {
     public:
       // adiscope::histogram_sink_f::sptr
@@ -110,6 +120,21 @@ namespace adiscope {
       virtual void set_update_time(double t) = 0;
       virtual void set_nsamps(const int newsize) = 0;
       virtual void set_bins(const int bins) = 0;
+
+      /* Counts add up over the frames until reset() or until the bins
+       * change, instead of being those of the newest frame */
+      virtual void set_accumulate(bool en) = 0;
+
+      /* Only samples [min, max) of each frame are counted */
+      virtual void set_data_interval(int min, int max) = 0;
+
+      /* Fit the bins to the values of the next frame */
+      virtual void autoscale_x() = 0;
+
+      /* Whether the plot can be seen; while it can't, nothing is posted
+       * to it and the frames only get counted when the counts add up.
+       * On by default. */
+      virtual void set_displayed(bool displayed) = 0;
     };
 
 } /* namespace adiscope */
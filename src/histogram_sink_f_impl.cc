@@ -44,8 +44,11 @@
 #endif
 
 #include "histogram_sink_f_impl.h"
+#include "sink_copy.h"
+#include "pipeline_trace.hpp"
 
 #include <algorithm>
+#include <cmath>
 
 #include <gnuradio/io_signature.h>
 #include <gnuradio/prefs.h>
@@ -78,22 +81,28 @@ namespace adiscope {
                    io_signature::make(nconnections, nconnections, sizeof(float)),
                    io_signature::make(0, 0, 0)),
 	d_size(size), d_bins(bins), d_xmin(xmin), d_xmax(xmax), d_name(name),
-	d_nconnections(nconnections)
+	d_nconnections(nconnections), d_min_pos(0), d_max_pos(0),
+	d_accumulate(false), d_autoscale_x(false), d_displayed(true),
+	d_counted(0)
     {
       d_index = 0;
 
       for(int i = 0; i < d_nconnections; i++) {
-	d_residbufs.push_back((double*)volk_malloc(d_size*sizeof(double),
-                                                   volk_get_alignment()));
-	memset(d_residbufs[i], 0, d_size*sizeof(double));
+	d_residbufs.push_back((float*)volk_malloc(d_size*sizeof(float),
+                                                  volk_get_alignment()));
+	memset(d_residbufs[i], 0, d_size*sizeof(float));
       }
 
+      d_counts.resize(d_nconnections);
+      _set_range(d_xmin, d_xmax);
+
       // Set alignment properties for VOLK
       const int alignment_multiple =
 	volk_get_alignment() / sizeof(gr_complex);
       set_alignment(std::max(1,alignment_multiple));
 
       this->plot = (HistogramDisplayPlot*)plot;
+      d_frames = std::make_shared<HistogramFrameHandoff>();
       initialize();
     }
 
@@ -149,10 +158,10 @@ namespace adiscope {
 	// Resize residbuf and replace data
 	for(int i = 0; i < d_nconnections; i++) {
 	  volk_free(d_residbufs[i]);
-	  d_residbufs[i] = (double*)volk_malloc(newsize*sizeof(double),
-                                                volk_get_alignment());
+	  d_residbufs[i] = (float*)volk_malloc(newsize*sizeof(float),
+                                               volk_get_alignment());
 
-	  memset(d_residbufs[i], 0, newsize*sizeof(double));
+	  memset(d_residbufs[i], 0, newsize*sizeof(float));
 	}
 
 	// Set new size and reset buffer index
@@ -161,15 +170,45 @@ namespace adiscope {
 	d_index = 0;
 
       }
-      plot->setDataInterval(0, d_size);
+      d_min_pos = 0;
+      d_max_pos = d_size;
     }
 
     void
     histogram_sink_f_impl::set_bins(const int bins)
     {
       gr::thread::scoped_lock lock(d_setlock);
-      d_bins = bins;
-      plot->setNumBins(d_bins);
+      d_bins = std::max(bins, 1);
+      _set_range(d_xmin, d_xmax);
+    }
+
+    void
+    histogram_sink_f_impl::set_displayed(bool displayed)
+    {
+      d_displayed = displayed;
+    }
+
+    void
+    histogram_sink_f_impl::set_accumulate(bool en)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_accumulate = en;
+      _clear_counts();
+    }
+
+    void
+    histogram_sink_f_impl::set_data_interval(int min, int max)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_min_pos = min;
+      d_max_pos = max;
+    }
+
+    void
+    histogram_sink_f_impl::autoscale_x()
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_autoscale_x = true;
     }
 
     int
@@ -187,7 +226,151 @@ namespace adiscope {
     void
     histogram_sink_f_impl::reset()
     {
+      gr::thread::scoped_lock lock(d_setlock);
       d_index = 0;
+      _clear_counts();
+    }
+
+    void
+    histogram_sink_f_impl::_set_range(double min, double max)
+    {
+      // Same 10% margins the plot used to add
+      double left = min * (1 - copysign(0.1, min));
+      double right = max * (1 + copysign(0.1, max));
+      if(!(right > left)) {
+        left -= 0.5;
+        right += 0.5;
+      }
+
+      d_left = left;
+      d_right = right;
+      d_width = (d_right - d_left) / d_bins;
+      _clear_counts();
+    }
+
+    void
+    histogram_sink_f_impl::_clear_counts()
+    {
+      for(size_t n = 0; n < d_counts.size(); n++) {
+        d_counts[n].assign(d_bins, 0);
+      }
+      d_counted = 0;
+    }
+
+    void
+    histogram_sink_f_impl::_bin(const float *samples, int nitems,
+                                uint64_t *counts)
+    {
+      // Bin positions in Q16 fixed point: half a bin is added so that
+      // the truncation rounds to the nearest bin center. The first loop
+      // is branch-free and gets vectorized; out of range values (NaNs
+      // included) are clamped to -1, which no bin takes.
+      const int block = 1024;
+      const float scale = 65536.0f / (float)d_width;
+      const float offset = (float)(-d_left) * scale + 32768.0f;
+      const float qmax = 65536.0f * (float)d_bins;
+
+      d_bin_index.resize(block);
+      int32_t *index = d_bin_index.data();
+
+      for(int b = 0; b < nitems; b += block) {
+        int n = std::min(block, nitems - b);
+
+        for(int i = 0; i < n; i++) {
+          float q = samples[b + i] * scale + offset;
+          q = q > -1.0f ? q : -1.0f;
+          q = q < qmax ? q : qmax;
+          index[i] = (int32_t)q >> 16;
+        }
+
+        for(int i = 0; i < n; i++) {
+          if((uint32_t)index[i] < (uint32_t)d_bins)
+            counts[index[i]]++;
+        }
+      }
+    }
+
+    void
+    histogram_sink_f_impl::_process_frame(const std::vector<const float *> &channels,
+                                          int nitems)
+    {
+      int nplots = std::min(d_nconnections, (int)channels.size());
+      bool update = d_displayed &&
+              gr::high_res_timer_now() - d_last_time > d_update_time;
+
+      // A frame that won't be shown doesn't need counting, unless the
+      // counts add up
+      if(!update && !d_accumulate) {
+        return;
+      }
+
+      int min_pos = std::max(d_min_pos, 0);
+      int max_pos = d_max_pos;
+      if(max_pos > nitems || max_pos == 0)
+        max_pos = nitems;
+      if(min_pos > max_pos) {
+        min_pos = 0;
+        max_pos = nitems;
+      }
+
+      // Bins fitted to the values when they moved, as the plot did
+      float fmin = 1e20f, fmax = -1e20f;
+      for(int n = 0; n < nplots; n++) {
+        const float *in = channels[n];
+        for(int i = min_pos; i < max_pos; i++) {
+          fmin = in[i] < fmin ? in[i] : fmin;
+          fmax = in[i] > fmax ? in[i] : fmax;
+        }
+      }
+
+      const double EPS = 0.1;
+      if((std::abs(fmin - d_xmin) > EPS || std::abs(fmax - d_xmax) > EPS) &&
+                      min_pos == 0 && max_pos == nitems) {
+        d_autoscale_x = true;
+      }
+      d_xmin = fmin;
+      d_xmax = fmax;
+
+      if(d_autoscale_x && d_xmax >= d_xmin) {
+        _set_range(d_xmin, d_xmax);
+        d_autoscale_x = false;
+      }
+
+      if(!d_accumulate) {
+        _clear_counts();
+      }
+
+      for(int n = 0; n < nplots; n++) {
+        _bin(channels[n] + min_pos, max_pos - min_pos, d_counts[n].data());
+      }
+      d_counted += nitems;
+
+      if(!update) {
+        return;
+      }
+      d_last_time = gr::high_res_timer_now();
+
+      HistogramFrame &frame = d_frames->write_buffer();
+      frame.counts.resize(nplots);
+      for(int n = 0; n < nplots; n++) {
+        frame.counts[n].assign(d_counts[n].begin(), d_counts[n].end());
+      }
+      frame.left = d_left;
+      frame.right = d_right;
+      frame.samples = d_counted;
+
+      if (d_frames->publish() && d_qApplication)
+        d_qApplication->postEvent(this->plot,
+                                  new HistogramUpdateEvent(d_frames));
+    }
+
+    void
+    histogram_sink_f_impl::frame_ready(const std::vector<const float *> &channels,
+                                       int nitems)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      _process_frame(channels, nitems);
     }
 
     int
@@ -195,31 +378,26 @@ namespace adiscope {
 			   gr_vector_const_void_star &input_items,
 			   gr_vector_void_star &output_items)
     {
-      int n=0, j=0, idx=0;
-      const float *in = (const float*)input_items[idx];
+      PIPELINE_TRACE("histogram_sink_f work");
+
+      int j=0;
 
       for(int i=0; i < noutput_items; i+=d_size) {
 	unsigned int datasize = noutput_items - i;
 	unsigned int resid = d_size-d_index;
-	idx = 0;
 
 	// If we have enough input for one full plot, do it
 	if(datasize >= resid) {
 
 	  // Fill up residbufs with d_size number of items
-	  for(n = 0; n < d_nconnections; n++) {
-	    in = (const float*)input_items[idx++];
-	    volk_32f_convert_64f_u(&d_residbufs[n][d_index],
-				   &in[j], resid);
-	  }
-
-	  // Update the plot if its time
-	  if(gr::high_res_timer_now() - d_last_time > d_update_time) {
-	    d_last_time = gr::high_res_timer_now();
-	    if (d_qApplication)
-	      d_qApplication->postEvent(this->plot,
-				      new HistogramUpdateEvent(d_residbufs, d_size));
-	  }
+	  sink_copy<float, float>(d_nconnections, d_residbufs.data(), d_index,
+				  input_items.data(), j, resid);
+
+	  // A frame the GUI didn't get to yet gets replaced, and only
+	  // one notification is ever queued.
+	  std::vector<const float *> frame(d_residbufs.begin(),
+	                                   d_residbufs.end());
+	  _process_frame(frame, d_size);
 
 	  d_index = 0;
 	  j += resid;
@@ -227,11 +405,8 @@ namespace adiscope {
 	// Otherwise, copy what we received into the residbufs for next time
 	// because we set the output_multiple, this should never need to be called
 	else {
-	  for(n = 0; n < d_nconnections; n++) {
-	    in = (const float*)input_items[idx++];
-	    volk_32f_convert_64f_u(&d_residbufs[n][d_index],
-				   &in[j], datasize);
-	  }
+	  sink_copy<float, float>(d_nconnections, d_residbufs.data(), d_index,
+				  input_items.data(), j, datasize);
 	  d_index += datasize;
 	  j += datasize;
 	}
@@ -44,6 +44,8 @@
 
 #include <gnuradio/high_res_timer.h>
 
+#include <atomic>
+
 #include "histogram_sink_f.h"
 #include "HistogramDisplayPlot.h"
 
@@ -53,6 +55,11 @@ namespace adiscope {
     {
     private:
       void initialize();
+      void _set_range(double min, double max);
+      void _clear_counts();
+      void _process_frame(const std::vector<const float *> &channels,
+                          int nitems);
+      void _bin(const float *samples, int nitems, uint64_t *counts);
 
       int d_size;
       int d_bins;
@@ -61,9 +68,20 @@ namespace adiscope {
       int d_nconnections;
 
       int d_index;
-      std::vector<double*> d_residbufs;
+      std::vector<float*> d_residbufs;
+
+      // Binning: bin k is centered on d_left + k * d_width
+      double d_left, d_right, d_width;
+      int d_min_pos, d_max_pos;
+      bool d_accumulate;
+      bool d_autoscale_x;
+      std::atomic<bool> d_displayed;
+      std::vector< std::vector<uint64_t> > d_counts;
+      uint64_t d_counted;
+      std::vector<int32_t> d_bin_index;
 
       HistogramDisplayPlot *plot;
+      std::shared_ptr<HistogramFrameHandoff> d_frames;
 
       gr::high_res_timer_type d_update_time;
       gr::high_res_timer_type d_last_time;
@@ -83,11 +101,18 @@ namespace adiscope {
       void set_update_time(double t);
       void set_nsamps(const int newsize);
       void set_bins(const int bins);
+      void set_accumulate(bool en);
+      void set_data_interval(int min, int max);
+      void autoscale_x();
+      void set_displayed(bool displayed);
 
       int  nsamps() const;
       int  bins() const;
       void reset();
 
+      void frame_ready(const std::vector<const float *> &channels,
+                       int nitems);
+
       int work(int noutput_items,
 	       gr_vector_const_void_star &input_items,
 	       gr_vector_void_star &output_items);
@@ -0,0 +1,425 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iio.h>
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <locale>
+#include <sstream>
+
+#include "iio_attr_transaction.hpp"
+
+using namespace adiscope;
+
+namespace {
+struct TargetValues {
+	void *object;
+	bool is_channel;
+	std::map<std::string, std::string> values;
+};
+
+/* Groups the operations by device or channel, in the order each one
+ * first appears, a later write of an attribute replacing the earlier */
+template<typename Operation>
+std::vector<TargetValues> group(const std::vector<Operation>& ops,
+				bool writes)
+{
+	std::vector<TargetValues> groups;
+
+	for (const Operation& op : ops) {
+		if (op.is_write != writes) {
+			continue;
+		}
+
+		auto it = groups.begin();
+		for (; it != groups.end(); ++it) {
+			if (it->object == op.target.object) {
+				break;
+			}
+		}
+
+		if (it == groups.end()) {
+			groups.push_back({ op.target.object,
+					   op.target.is_channel, {} });
+			it = groups.end() - 1;
+		}
+
+		it->values[op.attr] = op.value;
+	}
+
+	return groups;
+}
+
+ssize_t fill_attr(const char *attr, void *buf, size_t len, void *d)
+{
+	auto values = static_cast<const std::map<std::string,
+			std::string> *>(d);
+	auto it = values->find(attr);
+
+	/* Attributes left empty are not written */
+	if (it == values->end()) {
+		return 0;
+	}
+
+	size_t size = it->second.size() + 1;
+
+	if (size > len) {
+		return -ENOMEM;
+	}
+
+	memcpy(buf, it->second.c_str(), size);
+
+	return size;
+}
+
+ssize_t fill_dev_attr(struct iio_device *, const char *attr, void *buf,
+		      size_t len, void *d)
+{
+	return fill_attr(attr, buf, len, d);
+}
+
+ssize_t fill_chn_attr(struct iio_channel *, const char *attr, void *buf,
+		      size_t len, void *d)
+{
+	return fill_attr(attr, buf, len, d);
+}
+
+int store_attr(const char *attr, const char *value, size_t len, void *d)
+{
+	auto values = static_cast<std::map<std::string, std::string> *>(d);
+	auto it = values->find(attr);
+
+	if (it != values->end()) {
+		it->second.assign(value, strnlen(value, len));
+	}
+
+	return 0;
+}
+
+int store_dev_attr(struct iio_device *, const char *attr, const char *value,
+		   size_t len, void *d)
+{
+	return store_attr(attr, value, len, d);
+}
+
+int store_chn_attr(struct iio_channel *, const char *attr, const char *value,
+		   size_t len, void *d)
+{
+	return store_attr(attr, value, len, d);
+}
+}
+
+IioAttrTransaction::IioAttrTransaction()
+{
+}
+
+IioAttrTransaction::~IioAttrTransaction()
+{
+}
+
+std::string IioAttrTransaction::toString(long long value)
+{
+	return std::to_string(value);
+}
+
+std::string IioAttrTransaction::toString(double value)
+{
+	/* The same text as libiio, whatever the locale */
+	std::ostringstream out;
+
+	out.imbue(std::locale::classic());
+	out.setf(std::ios::fixed);
+	out.precision(6);
+	out << value;
+
+	return out.str();
+}
+
+void IioAttrTransaction::queue(void *object, bool is_channel,
+			       const char *attr, const std::string& value,
+			       bool is_write)
+{
+	if (!object) {
+		return;
+	}
+
+	pending.push_back({ { object, is_channel }, attr, value, is_write });
+}
+
+void IioAttrTransaction::write(struct iio_device *dev, const char *attr,
+			       const std::string& value)
+{
+	queue(dev, false, attr, value, true);
+}
+
+void IioAttrTransaction::writeBool(struct iio_device *dev, const char *attr,
+				   bool value)
+{
+	write(dev, attr, value ? "1" : "0");
+}
+
+void IioAttrTransaction::writeLongLong(struct iio_device *dev,
+				       const char *attr, long long value)
+{
+	write(dev, attr, toString(value));
+}
+
+void IioAttrTransaction::writeDouble(struct iio_device *dev,
+				     const char *attr, double value)
+{
+	write(dev, attr, toString(value));
+}
+
+void IioAttrTransaction::write(struct iio_channel *chn, const char *attr,
+			       const std::string& value)
+{
+	queue(chn, true, attr, value, true);
+}
+
+void IioAttrTransaction::writeBool(struct iio_channel *chn, const char *attr,
+				   bool value)
+{
+	write(chn, attr, value ? "1" : "0");
+}
+
+void IioAttrTransaction::writeLongLong(struct iio_channel *chn,
+				       const char *attr, long long value)
+{
+	write(chn, attr, toString(value));
+}
+
+void IioAttrTransaction::writeDouble(struct iio_channel *chn,
+				     const char *attr, double value)
+{
+	write(chn, attr, toString(value));
+}
+
+void IioAttrTransaction::read(struct iio_device *dev, const char *attr)
+{
+	queue(dev, false, attr, std::string(), false);
+}
+
+void IioAttrTransaction::read(struct iio_channel *chn, const char *attr)
+{
+	queue(chn, true, attr, std::string(), false);
+}
+
+int IioAttrTransaction::commit()
+{
+	int ret = commitWrites();
+	int ret_reads = commitReads();
+
+	pending.clear();
+
+	return ret < 0 ? ret : ret_reads;
+}
+
+int IioAttrTransaction::commitWrites()
+{
+	int ret = 0;
+
+	for (TargetValues& target : group(pending, true)) {
+		/* Already there */
+		for (auto it = target.values.begin();
+		     it != target.values.end();) {
+			auto known = shadow.find(Key(target.object, it->first));
+
+			if (known != shadow.end() && known->second == it->second) {
+				it = target.values.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		if (target.values.empty()) {
+			continue;
+		}
+
+		ssize_t err;
+
+		if (target.values.size() == 1) {
+			const auto& value = *target.values.begin();
+
+			err = target.is_channel ?
+				iio_channel_attr_write((struct iio_channel *)
+						target.object, value.first.c_str(),
+						value.second.c_str()) :
+				iio_device_attr_write((struct iio_device *)
+						target.object, value.first.c_str(),
+						value.second.c_str());
+		} else {
+			err = target.is_channel ?
+				iio_channel_attr_write_all((struct iio_channel *)
+						target.object, fill_chn_attr,
+						&target.values) :
+				iio_device_attr_write_all((struct iio_device *)
+						target.object, fill_dev_attr,
+						&target.values);
+		}
+
+		for (const auto& value : target.values) {
+			if (err < 0) {
+				shadow.erase(Key(target.object, value.first));
+			} else {
+				shadow[Key(target.object, value.first)] =
+					value.second;
+			}
+		}
+
+		if (err < 0 && ret == 0) {
+			ret = err;
+		}
+	}
+
+	return ret;
+}
+
+int IioAttrTransaction::commitReads()
+{
+	int ret = 0;
+
+	for (TargetValues& target : group(pending, false)) {
+		ssize_t err;
+
+		if (target.values.size() == 1) {
+			auto& value = *target.values.begin();
+			char buf[4096];
+
+			err = target.is_channel ?
+				iio_channel_attr_read((struct iio_channel *)
+						target.object, value.first.c_str(),
+						buf, sizeof(buf)) :
+				iio_device_attr_read((struct iio_device *)
+						target.object, value.first.c_str(),
+						buf, sizeof(buf));
+
+			if (err >= 0) {
+				value.second.assign(buf);
+			}
+		} else {
+			err = target.is_channel ?
+				iio_channel_attr_read_all((struct iio_channel *)
+						target.object, store_chn_attr,
+						&target.values) :
+				iio_device_attr_read_all((struct iio_device *)
+						target.object, store_dev_attr,
+						&target.values);
+		}
+
+		for (const auto& value : target.values) {
+			if (err < 0) {
+				shadow.erase(Key(target.object, value.first));
+			} else {
+				shadow[Key(target.object, value.first)] =
+					value.second;
+			}
+		}
+
+		if (err < 0 && ret == 0) {
+			ret = err;
+		}
+	}
+
+	return ret;
+}
+
+bool IioAttrTransaction::shadowed(const void *object, const char *attr,
+				  std::string& value) const
+{
+	auto it = shadow.find(Key(object, attr));
+
+	if (it == shadow.end()) {
+		return false;
+	}
+
+	value = it->second;
+
+	return true;
+}
+
+bool IioAttrTransaction::value(struct iio_device *dev, const char *attr,
+			       std::string& value) const
+{
+	return shadowed(dev, attr, value);
+}
+
+bool IioAttrTransaction::value(struct iio_channel *chn, const char *attr,
+			       std::string& value) const
+{
+	return shadowed(chn, attr, value);
+}
+
+bool IioAttrTransaction::valueDouble(struct iio_device *dev,
+				     const char *attr, double *value) const
+{
+	std::string text;
+
+	if (!shadowed(dev, attr, text)) {
+		return false;
+	}
+
+	std::istringstream in(text);
+
+	in.imbue(std::locale::classic());
+	in >> *value;
+
+	return !in.fail();
+}
+
+bool IioAttrTransaction::valueDouble(struct iio_channel *chn,
+				     const char *attr, double *value) const
+{
+	std::string text;
+
+	if (!shadowed(chn, attr, text)) {
+		return false;
+	}
+
+	std::istringstream in(text);
+
+	in.imbue(std::locale::classic());
+	in >> *value;
+
+	return !in.fail();
+}
+
+bool IioAttrTransaction::valueLongLong(struct iio_channel *chn,
+				       const char *attr,
+				       long long *value) const
+{
+	std::string text;
+
+	if (!shadowed(chn, attr, text)) {
+		return false;
+	}
+
+	char *end;
+
+	*value = strtoll(text.c_str(), &end, 0);
+
+	return end != text.c_str();
+}
+
+void IioAttrTransaction::invalidate()
+{
+	shadow.clear();
+}
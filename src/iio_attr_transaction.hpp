@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef IIO_ATTR_TRANSACTION_HPP
+#define IIO_ATTR_TRANSACTION_HPP
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" {
+	struct iio_channel;
+	struct iio_device;
+}
+
+namespace adiscope {
+
+/*
+ * Queues IIO attribute writes and reads and sends them with as few
+ * transfers as possible, which matters most over the network backend
+ * where every attribute access is a round trip.
+ *
+ * commit() sends the writes first, then the reads. The attributes of
+ * a same device or channel go in a single "all attributes" transfer
+ * when there are several of them, a single one is accessed directly.
+ * Within a device or channel the attributes are then written in the
+ * order the device lists them, not in the order they were queued:
+ * commit in between when the order matters.
+ *
+ * Every value written or read is kept in a shadow, and a write of the
+ * value the attribute already has in the shadow is dropped. Reading
+ * back a value from the shadow doesn't touch the device. The shadow
+ * only knows about the accesses done through this object, so
+ * invalidate() it when something else can have changed the
+ * attributes.
+ */
+class IioAttrTransaction
+{
+public:
+	IioAttrTransaction();
+	~IioAttrTransaction();
+
+	void write(struct iio_device *dev, const char *attr,
+		   const std::string& value);
+	void writeBool(struct iio_device *dev, const char *attr, bool value);
+	void writeLongLong(struct iio_device *dev, const char *attr,
+			   long long value);
+	void writeDouble(struct iio_device *dev, const char *attr,
+			 double value);
+
+	void write(struct iio_channel *chn, const char *attr,
+		   const std::string& value);
+	void writeBool(struct iio_channel *chn, const char *attr, bool value);
+	void writeLongLong(struct iio_channel *chn, const char *attr,
+			   long long value);
+	void writeDouble(struct iio_channel *chn, const char *attr,
+			 double value);
+
+	void read(struct iio_device *dev, const char *attr);
+	void read(struct iio_channel *chn, const char *attr);
+
+	/* 0, or the negative error code of the first failed transfer */
+	int commit();
+
+	/* The shadow value, false when it is unknown */
+	bool value(struct iio_device *dev, const char *attr,
+		   std::string& value) const;
+	bool value(struct iio_channel *chn, const char *attr,
+		   std::string& value) const;
+	bool valueDouble(struct iio_device *dev, const char *attr,
+			 double *value) const;
+	bool valueDouble(struct iio_channel *chn, const char *attr,
+			 double *value) const;
+	bool valueLongLong(struct iio_channel *chn, const char *attr,
+			   long long *value) const;
+
+	void invalidate();
+
+private:
+	struct Target {
+		void *object;
+		bool is_channel;
+	};
+
+	typedef std::pair<const void *, std::string> Key;
+	typedef std::map<std::string, std::string> Values;
+
+	void queue(void *object, bool is_channel, const char *attr,
+		   const std::string& value, bool is_write);
+	int commitWrites();
+	int commitReads();
+	bool shadowed(const void *object, const char *attr,
+		      std::string& value) const;
+
+	static std::string toString(long long value);
+	static std::string toString(double value);
+
+	struct Operation {
+		Target target;
+		std::string attr;
+		std::string value;
+		bool is_write;
+	};
+
+	std::vector<Operation> pending;
+	std::map<Key, std::string> shadow;
+};
+}
+
+#endif /* IIO_ATTR_TRANSACTION_HPP */
@@ -21,9 +21,15 @@
 #include "logging_categories.h"
 #include "iio_manager.hpp"
 #include "timeout_block.hpp"
+#include "thread_scheduling.hpp"
 
 #include <QDebug>
 
+#include <algorithm>
+#include <set>
+
+#include <gnuradio/block_detail.h>
+#include <gnuradio/high_res_timer.h>
 #include <gnuradio/blocks/null_sink.h>
 #include <gnuradio/blocks/short_to_float.h>
 
@@ -32,7 +38,8 @@
 using namespace adiscope;
 using namespace gr;
 
-std::map<const std::string, iio_manager::map_entry> iio_manager::dev_map;
+std::map<iio_manager::map_key, iio_manager::map_entry> iio_manager::dev_map;
+std::mutex iio_manager::dev_map_mutex;
 unsigned iio_manager::_id = 0;
 
 iio_manager::iio_manager(unsigned int block_id,
@@ -40,8 +47,13 @@ iio_manager::iio_manager(unsigned int block_id,
 		unsigned long _buffer_size) :
 	QObject(nullptr),
 	top_block("IIO Manager " + std::to_string(block_id)),
-	id(block_id), _started(false), buffer_size(_buffer_size)
+	id(block_id), _started(false), buffer_size(_buffer_size),
+	kernel_buffers(IIO_KERNEL_BUFFERS_COUNT),
+	nb_timeouts(0),
+	hold_depth(0), held_stopped(false), restart_held(false)
 {
+	float_src_users[0] = float_src_users[1] = 0;
+
 	if (!ctx)
 		throw std::runtime_error("IIO context not created");
 
@@ -50,11 +62,20 @@ iio_manager::iio_manager(unsigned int block_id,
 		throw std::runtime_error("Device not found");
 
 	nb_channels = iio_device_get_channels_count(dev);
+	iio_dev = dev;
 
-	iio_block = iio::device_source::make_from(ctx, _dev,
-			std::vector<std::string>(), _dev,
-			std::vector<std::string>(),
-			_buffer_size);
+	auto replay = ReplayFile::open(ReplayFile::ADC);
+	if (replay) {
+		replay_block = replay_source::make(replay, dev, nb_channels,
+				_buffer_size);
+		source = replay_block;
+	} else {
+		iio_block = iio::device_source::make_from(ctx, _dev,
+				std::vector<std::string>(), _dev,
+				std::vector<std::string>(),
+				_buffer_size);
+		source = iio_block;
+	}
 
 	/* Avoid unconnected channel errors by connecting a dummy sink */
 	auto dummy_copy = blocks::copy::make(sizeof(short));
@@ -68,10 +89,14 @@ iio_manager::iio_manager(unsigned int block_id,
 	freq_comp_filt[1][1] = adiscope::frequency_compensation_filter::make(false);
 
 	for (unsigned i = 0; i < nb_channels; i++) {
-		hier_block2::connect(iio_block,i,freq_comp_filt[i][0],0);
-		hier_block2::connect(freq_comp_filt[i][0],0,freq_comp_filt[i][1],0);
+		std::vector<frequency_compensation_filter::sptr> stages;
+		stages.push_back(freq_comp_filt[i][0]);
+		stages.push_back(freq_comp_filt[i][1]);
 
-		hier_block2::connect(freq_comp_filt[i][1], 0, dummy_copy, i);
+		freq_comp[i] = frequency_compensation_cascade::make(stages);
+
+		hier_block2::connect(source, i, freq_comp[i], 0);
+		hier_block2::connect(freq_comp[i], 0, dummy_copy, i);
 
 		hier_block2::connect(dummy_copy, i, dummy, i);
 
@@ -79,11 +104,18 @@ iio_manager::iio_manager(unsigned int block_id,
 
 	dummy_copy->set_enabled(true);
 
-	auto timeout_b = gnuradio::get_initial_sptr(new timeout_block("msg"));
-	hier_block2::msg_connect(iio_block, "msg", timeout_b, "msg");
+	if (iio_block) {
+		auto timeout_b = gnuradio::get_initial_sptr(
+				new timeout_block("msg"));
+		hier_block2::msg_connect(iio_block, "msg", timeout_b, "msg");
+
+		QObject::connect(&*timeout_b, SIGNAL(timeout()), this,
+				SLOT(got_timeout()));
+	}
 
-	QObject::connect(&*timeout_b, SIGNAL(timeout()), this,
-			SLOT(got_timeout()));
+	stats_timer.setInterval(1000);
+	QObject::connect(&stats_timer, SIGNAL(timeout()), this,
+			SIGNAL(port_stats_updated()));
 }
 
 iio_manager::~iio_manager()
@@ -94,19 +126,25 @@ boost::shared_ptr<iio_manager> iio_manager::get_instance(
 		struct iio_context *ctx, const std::string &_dev,
 		unsigned long buffer_size)
 {
+	std::unique_lock<std::mutex> lock(dev_map_mutex);
+	const map_key key(ctx, _dev);
+
 	/* Search the dev_map if we already have a manager for the
-	 * given device */
-	if (!dev_map.empty()) {
-		for (auto it = dev_map.begin(); it != dev_map.end(); ++it) {
-			if (it->first.compare(_dev) != 0)
-				continue;
+	 * given device of this context */
+	auto found = dev_map.find(key);
+	if (found != dev_map.end()) {
+		auto shared_manager = found->second.lock();
+		if (shared_manager)
+			return shared_manager;
+	}
 
-			/* We found the entry. */
-			if (!it->second.expired())
-				return it->second.lock();
-			else
-				break;
-		}
+	/* Drop the entries of the managers that are gone, the contexts
+	 * they belonged to may have been destroyed since */
+	for (auto it = dev_map.begin(); it != dev_map.end();) {
+		if (it->second.expired())
+			it = dev_map.erase(it);
+		else
+			++it;
 	}
 
 	/* No manager found - create a new one */
@@ -114,14 +152,82 @@ boost::shared_ptr<iio_manager> iio_manager::get_instance(
 	boost::shared_ptr<iio_manager> shared_manager(manager);
 
 	/* Add it to the map */
-	auto it = dev_map.insert(std::pair<const std::string, map_entry>(
-				_dev, shared_manager));
-	if (it.second == false)
-		it.first->second = shared_manager;
+	dev_map[key] = shared_manager;
 
 	return shared_manager;
 }
 
+std::vector<boost::shared_ptr<iio_manager>> iio_manager::instances()
+{
+	std::unique_lock<std::mutex> lock(dev_map_mutex);
+	std::vector<boost::shared_ptr<iio_manager>> managers;
+
+	for (auto it = dev_map.cbegin(); it != dev_map.cend(); ++it) {
+		auto manager = it->second.lock();
+		if (manager)
+			managers.push_back(manager);
+	}
+
+	return managers;
+}
+
+std::string iio_manager::device_name() const
+{
+	const char *name = iio_device_get_name(iio_dev);
+
+	return name ? name : iio_device_get_id(iio_dev);
+}
+
+void iio_manager::lock()
+{
+	if (held_stopped)
+		return;
+
+	top_block::stop();
+	top_block::wait();
+
+	if (hold_depth)
+		held_stopped = true;
+}
+
+void iio_manager::unlock()
+{
+	if (hold_depth) {
+		restart_held = true;
+		return;
+	}
+
+	start_top_block();
+}
+
+void iio_manager::start_top_block()
+{
+	ThreadScheduling::AcquisitionScope scope;
+
+	top_block::start();
+}
+
+void iio_manager::hold()
+{
+	hold_depth++;
+}
+
+void iio_manager::release()
+{
+	if (!hold_depth || --hold_depth)
+		return;
+
+	/* The clients may all have been stopped meanwhile */
+	if (held_stopped && restart_held && _started) {
+		qDebug(CAT_IIO_MANAGER) << "Restarting top block after"
+			<< "a batch of changes";
+		start_top_block();
+	}
+
+	held_stopped = false;
+	restart_held = false;
+}
+
 iio_manager::port_id iio_manager::connect(basic_block_sptr dst,
 		int src_port, int dst_port, bool use_float,
 		unsigned long _buffer_size)
@@ -130,25 +236,32 @@ iio_manager::port_id iio_manager::connect(basic_block_sptr dst,
 
 	/* The copy block is used as a valve to turn on/off this
 	 * specific channel. */
-	auto copy = blocks::copy::make(sizeof(short));
-	copy_blocks.push_back(std::make_pair(copy, _buffer_size));
+	auto copy = blocks::copy::make(use_float ? sizeof(float)
+			: sizeof(short));
+
+	port_entry entry;
+	entry.copy = copy;
+	entry.buffer_size = _buffer_size;
+	entry.channel = src_port;
+	entry.use_float = use_float;
+	entry.samples_at_start = 0;
+	entry.timeouts_at_start = 0;
+	copy_blocks.push_back(entry);
 
 	/* Disable the valve by default. */
 	copy->set_enabled(false);
 
-	/* Connect the IIO block to the valve, and the valve to the
-	 * destination block */
-	iio_manager::connect(freq_comp_filt[src_port][1], 0, copy, 0);
+	/* Connect the IIO block (or the shared float conversion of this
+	 * channel) to the valve, and the valve to the destination block.
+	 * All the valves of a channel read the same GNU Radio buffer, so
+	 * the samples are converted only once no matter how many clients
+	 * are connected. */
+	if (use_float)
+		iio_manager::connect(get_float_source(src_port), 0, copy, 0);
+	else
+		iio_manager::connect(freq_comp[src_port], 0, copy, 0);
 
-	/* TODO: Find a way to share one short_to_float block per channel,
-	 * instead of having each client instanciate its own */
-	if (use_float) {
-		auto s2f = blocks::short_to_float::make();
-		iio_manager::connect(copy, 0, s2f, 0);
-		iio_manager::connect(s2f, 0, dst, dst_port);
-	} else {
-		iio_manager::connect(copy, 0, dst, dst_port);
-	}
+	iio_manager::connect(copy, 0, dst, dst_port);
 
 	/* Returns an ID that identifies the connection to the port,
 	 * as there can be multiple blocks connected to one port */
@@ -161,28 +274,77 @@ void iio_manager::disconnect(iio_manager::port_id copy)
 
 	copy->set_enabled(false);
 
+	int channel = -1;
+
 	for (auto it = copy_blocks.begin(); it != copy_blocks.end(); ++it) {
-		if (it->first == copy) {
+		if (it->copy == copy) {
+			if (it->use_float)
+				channel = it->channel;
 			copy_blocks.erase(it);
 			break;
 		}
 	}
 
 	del_connection(copy, false);
+
+	if (channel >= 0) {
+		iio_manager::disconnect(float_src[channel], 0, copy, 0);
+		put_float_source(channel);
+	}
+
 	hier_block2::disconnect(copy);
 }
 
+gr::basic_block_sptr iio_manager::get_float_source(int channel)
+{
+	if (!float_src[channel]) {
+		qDebug(CAT_IIO_MANAGER) << "Creating shared float source for channel"
+					<< channel;
+		float_src[channel] = blocks::short_to_float::make();
+		iio_manager::connect(freq_comp[channel], 0,
+				float_src[channel], 0);
+	}
+
+	float_src_users[channel]++;
+	return float_src[channel];
+}
+
+void iio_manager::put_float_source(int channel)
+{
+	if (!float_src[channel] || --float_src_users[channel])
+		return;
+
+	qDebug(CAT_IIO_MANAGER) << "Removing shared float source for channel"
+				<< channel;
+	iio_manager::disconnect(freq_comp[channel], 0,
+			float_src[channel], 0);
+	float_src[channel].reset();
+}
+
+bool iio_manager::is_shared_source(gr::basic_block_sptr block) const
+{
+	for (unsigned int i = 0; i < 2; i++) {
+		if (block == freq_comp[i] || block == float_src[i])
+			return true;
+	}
+
+	return false;
+}
+
 void iio_manager::update_buffer_size_unlocked()
 {
 	unsigned long size = 0;
 
 	for (auto it = copy_blocks.begin(); it != copy_blocks.end(); ++it) {
-		if (it->first->enabled() && size < it->second)
-			size = it->second;
+		if (it->copy->enabled() && size < it->buffer_size)
+			size = it->buffer_size;
 	}
 
 	if (size) {
-		iio_block->set_buffer_size(size);
+		if (iio_block)
+			iio_block->set_buffer_size(size);
+		else
+			replay_block->set_buffer_size(size);
 		this->buffer_size = size;
 	}
 }
@@ -197,11 +359,27 @@ void iio_manager::start(iio_manager::port_id copy)
 	qDebug(CAT_IIO_MANAGER) << "Enabling copy block" << copy->alias().c_str();
 	copy->set_enabled(true);
 
+	for (auto it = copy_blocks.begin(); it != copy_blocks.end(); ++it) {
+		if (it->copy == copy) {
+			it->samples_at_start = _started ?
+				copy->nitems_written(0) : 0;
+			it->timeouts_at_start = nb_timeouts;
+			break;
+		}
+	}
+
 	update_buffer_size_unlocked();
 
 	if (!_started) {
-		qDebug(CAT_IIO_MANAGER) << "Starting top block";
-		top_block::start();
+		stats_timer.start();
+
+		if (held_stopped) {
+			/* Started by release() with the other changes */
+			restart_held = true;
+		} else {
+			qDebug(CAT_IIO_MANAGER) << "Starting top block";
+			start_top_block();
+		}
 	}
 
 	_started = true;
@@ -229,12 +407,13 @@ void iio_manager::stop(iio_manager::port_id copy)
 	/* Verify whether all blocks are disabled */
 	for (auto it = copy_blocks.cbegin();
 			!inuse && it != copy_blocks.cend(); ++it)
-		inuse = it->first->enabled();
+		inuse = it->copy->enabled();
 
 	if (!inuse) {
 		qDebug(CAT_IIO_MANAGER) << "Stopping top block";
 		top_block::stop();
 		top_block::wait();
+		stats_timer.stop();
 
 		_started = false;
 	} else {
@@ -245,7 +424,7 @@ void iio_manager::stop(iio_manager::port_id copy)
 void iio_manager::stop_all()
 {
 	for (auto it = copy_blocks.begin(); it != copy_blocks.end(); ++it)
-		stop(it->first);
+		stop(it->copy);
 }
 
 void iio_manager::connect(gr::basic_block_sptr src, int src_port,
@@ -286,7 +465,7 @@ void iio_manager::del_connection(gr::basic_block_sptr block, bool reverse)
 		for (auto it = connections.begin();
 				it != connections.end(); ++it) {
 			if (reverse) {
-				if (block != it->dst || it->src == freq_comp_filt[0][1] || it->src == freq_comp_filt[1][1])
+				if (block != it->dst || is_shared_source(it->src))
 					continue;
 			} else if (block != it->src) {
 				continue;
@@ -322,8 +501,8 @@ void iio_manager::set_buffer_size(iio_manager::port_id copy, unsigned long size)
 	std::unique_lock<std::mutex> lock(copy_mutex);
 
 	for (auto it = copy_blocks.begin(); it != copy_blocks.end(); ++it) {
-		if (it->first == copy) {
-			it->second = size;
+		if (it->copy == copy) {
+			it->buffer_size = size;
 			break;
 		}
 	}
@@ -333,10 +512,148 @@ void iio_manager::set_buffer_size(iio_manager::port_id copy, unsigned long size)
 
 void iio_manager::got_timeout()
 {
+	nb_timeouts++;
 	Q_EMIT timeout();
 }
 
+iio_manager::port_stats iio_manager::get_port_stats(port_id copy)
+{
+	std::unique_lock<std::mutex> lock(copy_mutex);
+	port_stats stats = {};
+
+	for (auto it = copy_blocks.cbegin(); it != copy_blocks.cend(); ++it) {
+		if (it->copy != copy)
+			continue;
+
+		/* The block detail only exists while the block is part of
+		 * a flattened flowgraph */
+		if (_started && copy->detail()) {
+			uint64_t written = copy->nitems_written(0);
+
+			if (written >= it->samples_at_start)
+				stats.samples = written - it->samples_at_start;
+			stats.blocked = copy->pc_output_buffers_full_avg(0);
+		}
+
+		stats.timeouts = nb_timeouts - it->timeouts_at_start;
+		break;
+	}
+
+	if (_started && source->detail()) {
+		double us_per_tick = 1e6 / gr::high_res_timer_tps();
+
+		stats.refill_avg_us = source->pc_work_time_avg() *
+			us_per_tick;
+		stats.refill_var_us = source->pc_work_time_var() *
+			us_per_tick * us_per_tick;
+	}
+
+	return stats;
+}
+
+std::vector<iio_manager::block_stats> iio_manager::get_block_stats()
+{
+	std::unique_lock<std::mutex> lock(copy_mutex);
+	std::vector<gr::basic_block_sptr> blocks;
+	std::vector<block_stats> stats;
+
+	blocks.push_back(source);
+	for (unsigned int i = 0; i < 2; i++) {
+		blocks.push_back(freq_comp[i]);
+		blocks.push_back(float_src[i]);
+	}
+	for (auto it = copy_blocks.cbegin(); it != copy_blocks.cend(); ++it)
+		blocks.push_back(it->copy);
+	for (auto it = connections.cbegin(); it != connections.cend(); ++it) {
+		blocks.push_back(it->src);
+		blocks.push_back(it->dst);
+	}
+
+	double us_per_tick = 1e6 / gr::high_res_timer_tps();
+	std::set<long> seen;
+
+	for (auto it = blocks.cbegin(); it != blocks.cend(); ++it) {
+		/* Only the blocks running work() have counters, not the
+		 * hierarchical ones */
+		gr::block_sptr block = boost::dynamic_pointer_cast<
+			gr::block>(*it);
+		if (!block || !seen.insert(block->unique_id()).second)
+			continue;
+
+		block_stats s = {};
+		s.name = block->alias();
+
+		/* The block detail only exists while the block is part of
+		 * a flattened flowgraph */
+		gr::block_detail_sptr detail = block->detail();
+		if (_started && detail) {
+			s.work_avg_us = block->pc_work_time_avg() * us_per_tick;
+
+			for (int i = 0; i < detail->ninputs(); i++)
+				s.input_full = std::max(s.input_full,
+					block->pc_input_buffers_full_avg(i));
+			for (int i = 0; i < detail->noutputs(); i++)
+				s.output_full = std::max(s.output_full,
+					block->pc_output_buffers_full_avg(i));
+
+			if (detail->noutputs())
+				s.items = block->nitems_written(0);
+			else if (detail->ninputs())
+				s.items = block->nitems_read(0);
+		}
+
+		stats.push_back(s);
+	}
+
+	return stats;
+}
+
+QVariantMap iio_manager::port_stats::toVariantMap() const
+{
+	QVariantMap map;
+
+	map["samples"] = QVariant::fromValue(static_cast<double>(samples));
+	map["timeouts"] = timeouts;
+	map["blocked"] = blocked;
+	map["refill_avg_us"] = refill_avg_us;
+	map["refill_var_us"] = refill_var_us;
+
+	return map;
+}
+
 void iio_manager::set_device_timeout(unsigned int mseconds)
 {
-	iio_block->set_timeout_ms(mseconds);
+	if (iio_block)
+		iio_block->set_timeout_ms(mseconds);
+}
+
+void iio_manager::set_kernel_buffers_count(unsigned int count)
+{
+	if (!count || count == kernel_buffers)
+		return;
+
+	std::unique_lock<std::mutex> lock(copy_mutex);
+
+	/* The count can't change while the IIO buffer is open (-EBUSY), and
+	 * is only used when the buffer is created, which happens when the
+	 * device source starts */
+	bool restart = _started;
+	if (restart) {
+		top_block::stop();
+		top_block::wait();
+	}
+
+	int ret = iio_device_set_kernel_buffers_count(iio_dev, count);
+	if (ret < 0) {
+		qDebug(CAT_IIO_MANAGER) << "Unable to set the kernel buffers count to"
+					<< count << "error:" << ret;
+
+		iio_device_set_kernel_buffers_count(iio_dev, kernel_buffers);
+	} else {
+		qDebug(CAT_IIO_MANAGER) << "Kernel buffers count set to" << count;
+		kernel_buffers = count;
+	}
+
+	if (restart)
+		start_top_block();
 }
@@ -22,18 +22,26 @@
 #define IIO_MANAGER_HPP
 
 #include <QObject>
+#include <QTimer>
+#include <QVariantMap>
 
 #include <gnuradio/top_block.h>
 #include <iio/device_source.h>
 #include <gnuradio/blocks/copy.h>
 #include <gnuradio/blocks/float_to_complex.h>
+#include <gnuradio/blocks/short_to_float.h>
 #include <frequency_compensation_filter.h>
+#include <frequency_compensation_cascade.h>
+#include <replay_source.h>
 
 #include <mutex>
 
 /* 1k samples by default */
 #define IIO_BUFFER_SIZE 0x400
 
+/* Same as the libiio default */
+#define IIO_KERNEL_BUFFERS_COUNT 4
+
 namespace adiscope {
 	class iio_manager : public QObject, public gr::top_block
 	{
@@ -43,6 +51,41 @@ namespace adiscope {
 		typedef boost::weak_ptr<iio_manager> map_entry;
 		typedef gr::blocks::copy::sptr port_id;
 
+		/* Acquisition statistics of one port, since the port was
+		 * started. The timing values come from the GNU Radio
+		 * performance counters and stay at zero unless they are
+		 * enabled in the GNU Radio configuration ([PerfCounters]). */
+		struct port_stats {
+			/* Samples delivered to the client */
+			uint64_t samples;
+			/* Timeouts of the source device */
+			unsigned int timeouts;
+			/* Fraction of time the client's buffer was full, i.e.
+			 * the client was holding back the acquisition */
+			float blocked;
+			/* Average and variance (in us) of the time spent by
+			 * the source device waiting for a buffer refill */
+			double refill_avg_us;
+			double refill_var_us;
+
+			QVariantMap toVariantMap() const;
+		};
+
+		/* Performance counters of one block of the flowgraph, zero
+		 * while it is stopped or while the counters are disabled */
+		struct block_stats {
+			std::string name;
+			/* Average time of one call to work(), in us */
+			double work_avg_us;
+			/* Average fullness, 0 to 1, of the fullest input and
+			 * output buffer */
+			float input_full;
+			float output_full;
+			/* Items written to the first output, or read from the
+			 * first input of a sink */
+			uint64_t items;
+		};
+
 		const unsigned id;
 
 		/* Get a shared pointer to the instance of iio_manager that
@@ -54,9 +97,16 @@ namespace adiscope {
 
 		~iio_manager();
 
+		/* The managers of all the devices in use */
+		static std::vector<boost::shared_ptr<iio_manager>> instances();
+
+		std::string device_name() const;
+
 		/* Connect a block to one of the channels of the IIO source.
 		 * This function returns the ID, that can later be used with
 		 * start() and stop().
+		 * When use_float is set, the client is fed from the float
+		 * conversion shared by all the clients of that channel.
 		 * Warning: the flowgraph needs to be locked first! */
 		port_id connect(gr::basic_block_sptr dst, int src_port,
 				int dst_port, bool use_float = false,
@@ -95,27 +145,98 @@ namespace adiscope {
 		 * are not properly routed to the blocks connected during the
 		 * reconfiguration. So until GNU Radio gets fixed, we just force
 		 * the whole flowgraph to stop when connecting new blocks. */
-		void lock() { gr::top_block::stop(); gr::top_block::wait(); }
-		void unlock() { gr::top_block::start(); }
+		void lock();
+		void unlock();
+
+		/* Between hold() and release(), the flowgraph stays stopped
+		 * after the first lock() and is restarted once by release()
+		 * instead of by each unlock(), so that a batch of settings
+		 * (e.g. a profile being loaded) restarts it at most once.
+		 * The calls nest. */
+		void hold();
+		void release();
+
+		/* Reconfigure the flowgraph while it is running, using the
+		 * regular GNU Radio lock/unlock mechanism. The other clients
+		 * keep receiving data during the reconfiguration, but the
+		 * blocks connected this way won't see the tags that were
+		 * already in flight, so only use this to connect chains that
+		 * don't rely on tags (DMM, level sinks, ...) or to disconnect
+		 * clients. Use lock()/unlock() for everything else. */
+		void lock_hot() { gr::top_block::lock(); }
+		void unlock_hot() { gr::top_block::unlock(); }
+
+		/* Get the acquisition statistics for the given port */
+		port_stats get_port_stats(port_id id);
+
+		/* Get the counters of the source, the shared stages and of
+		 * every block the clients connected */
+		std::vector<block_stats> get_block_stats();
 
 		/* Set the timeout for the source device */
 		void set_device_timeout(unsigned int mseconds);
 
+		/* Set the number of kernel buffers used by the source device.
+		 * More buffers let the DMA keep acquiring while the previous
+		 * ones are processed, at the cost of latency and memory.
+		 * If the flowgraph is running it is restarted so that the
+		 * IIO buffer gets recreated with the new count. */
+		void set_kernel_buffers_count(unsigned int count);
+		unsigned int kernel_buffers_count() const
+		{ return kernel_buffers; }
+
+		/* Configuration of the compensation stages of each channel.
+		 * The stages themselves are not part of the flowgraph, they
+		 * are all applied by the per-channel cascade block. */
 		adiscope::frequency_compensation_filter::sptr freq_comp_filt[2][2];
 
 	private:
-		static std::map<const std::string, map_entry> dev_map;
+		/* Managers are per device of a given context, so that two
+		 * boards with the same device names can be used at once */
+		typedef std::pair<const struct iio_context *, std::string>
+			map_key;
+		static std::map<map_key, map_entry> dev_map;
+		static std::mutex dev_map_mutex;
 		static unsigned _id;
 		std::mutex copy_mutex;
 		bool _started;
 
+		unsigned int hold_depth;
+		bool held_stopped, restart_held;
+
 		unsigned long buffer_size;
 		std::vector<unsigned long> buffer_sizes;
 
-		std::vector<std::pair<port_id, unsigned long> > copy_blocks;
+		struct port_entry {
+			port_id copy;
+			unsigned long buffer_size;
+			int channel;
+			bool use_float;
+			uint64_t samples_at_start;
+			unsigned int timeouts_at_start;
+		};
+
+		std::vector<port_entry> copy_blocks;
 
+		/* One float conversion per ADC channel, shared by all the
+		 * clients that requested float samples. The blocks are
+		 * reference-counted and only live in the flowgraph while at
+		 * least one client is connected to them. */
+		gr::blocks::short_to_float::sptr float_src[2];
+		unsigned int float_src_users[2];
+
+		/* The device source, or the replay one when a replay file
+		 * was given for the ADC; source is whichever is used */
 		gr::iio::device_source::sptr iio_block;
+		adiscope::replay_source::sptr replay_block;
+		gr::block_sptr source;
+		adiscope::frequency_compensation_cascade::sptr freq_comp[2];
+		struct iio_device *iio_dev;
 		unsigned int nb_channels;
+		unsigned int kernel_buffers;
+		unsigned int nb_timeouts;
+
+		QTimer stats_timer;
 
 		struct connection {
 			gr::basic_block_sptr src;
@@ -130,14 +251,25 @@ namespace adiscope {
 				unsigned long buffer_size);
 
 		void del_connection(gr::basic_block_sptr block, bool reverse);
+		bool is_shared_source(gr::basic_block_sptr block) const;
+
+		gr::basic_block_sptr get_float_source(int channel);
+		void put_float_source(int channel);
 
 		void update_buffer_size_unlocked();
 
+		/* top_block::start() with the acquisition cores and priority
+		 * given to the scheduler threads */
+		void start_top_block();
+
 	private Q_SLOTS:
 		void got_timeout();
 
 	Q_SIGNALS:
 		void timeout();
+
+		/* Emitted periodically while the flowgraph is running */
+		void port_stats_updated();
 	};
 }
 
@@ -21,6 +21,8 @@
 #include "info_page.hpp"
 #include "ui_info_page.h"
 #include "preferences.h"
+#include "context_cache.hpp"
+#include "device_info_probe.hpp"
 
 #include <QString>
 #include <QTimer>
@@ -59,6 +61,8 @@ InfoPage::InfoPage(QString uri, Preferences *pref,
 		this, SLOT(ledTimeout()));
 	connect(m_blink_timer, SIGNAL(timeout()),
 		this, SLOT(blinkTimeout()));
+	connect(DeviceInfoProbe::instance(), &DeviceInfoProbe::infoReady,
+		this, &InfoPage::deviceInfoReady);
 	readPreferences();
 }
 
@@ -89,43 +93,50 @@ void InfoPage::setCtx(struct iio_context *ctx)
 
 void InfoPage::getDeviceInfo()
 {
-	struct iio_context* temp_ctx = m_ctx;
+	DeviceInfoProbe::Info info;
+
+	/* What was read last shows at once, the device is read again on
+	 * the worker; the one in use is read from its own context */
+	if (DeviceInfoProbe::instance()->cached(m_uri, info) ||
+	    (m_ctx && DeviceInfoProbe::instance()->read(m_uri, m_ctx, info))) {
+		setDeviceInfo(info);
+	} else {
+		ui->btnIdentify->setEnabled(supportsIdentification());
+		refreshInfoWidget();
+	}
+
 	if (!m_ctx) {
-		temp_ctx = iio_create_context_from_uri(m_uri.toStdString().c_str());
+		DeviceInfoProbe::instance()->request(m_uri);
 	}
+}
 
-	std::string str = "";
-	if (temp_ctx) {
-		const char *name;
-		const char *value;
-		char ctx_git_tag[8];
-		unsigned int ctx_major, ctx_minor;
-		iio_context_get_version(temp_ctx, &ctx_major, &ctx_minor, ctx_git_tag);
-
-		m_info_params.insert("IIO version",
-				     QString::fromStdString(to_string(ctx_major) + "." +
-							    to_string(ctx_minor)));
-
-		QString description(iio_context_get_description(temp_ctx));
-		m_info_params.insert("Linux", description);
-
-		int attr_no = iio_context_get_attrs_count(temp_ctx);
-		for (int i = 0; i < attr_no; i++) {
-			if (!iio_context_get_attr(temp_ctx, i, &name, &value)) {
-				auto pair = translateInfoParams(QString::fromUtf8(name));
-				if (pair.second == "")
-					continue;
-				if (pair.first) {
-					m_info_params_advanced.insert(pair.second, QString::fromUtf8(value));
-				} else {
-					m_info_params.insert(pair.second, QString::fromUtf8(value));
-				}
-			}
-		}
+void InfoPage::deviceInfoReady(const QString& uri)
+{
+	DeviceInfoProbe::Info info;
 
-		if (!m_ctx) {
-			iio_context_destroy(temp_ctx);
-			temp_ctx = nullptr;
+	if (uri == m_uri && DeviceInfoProbe::instance()->cached(m_uri, info)) {
+		setDeviceInfo(info);
+	}
+}
+
+void InfoPage::setDeviceInfo(const DeviceInfoProbe::Info& info)
+{
+	m_info_params.clear();
+	m_info_params_advanced.clear();
+
+	m_info_params.insert("IIO version",
+			     QString::number(info.major) + "." +
+			     QString::number(info.minor));
+	m_info_params.insert("Linux", info.description);
+
+	for (const auto& attr : info.attributes) {
+		auto pair = translateInfoParams(attr.first);
+		if (pair.second == "")
+			continue;
+		if (pair.first) {
+			m_info_params_advanced.insert(pair.second, attr.second);
+		} else {
+			m_info_params.insert(pair.second, attr.second);
 		}
 	}
 
@@ -262,7 +273,7 @@ void InfoPage::identifyDevice(bool clicked)
 		Q_EMIT stopSearching(true);
 
 		if (!m_connected) {
-			m_ctx = iio_create_context_from_uri(m_uri.toStdString().c_str());
+			m_ctx = ContextCache::getInstance().take(m_uri);
 		}
 
 		if (!m_ctx) {
@@ -282,7 +293,7 @@ void InfoPage::startIdentification(bool start)
 {
 	setStatusLabel("Can't identify this device.");
 	if (!m_connected) {
-		iio_context_destroy(m_ctx);
+		ContextCache::getInstance().put(m_uri, m_ctx);
 		m_ctx = nullptr;
 	}
 	if (m_search_interrupted) {
@@ -307,7 +318,7 @@ void InfoPage::ledTimeout()
 
 	if (m_ctx) {
 		if (!m_connected) {
-			iio_context_destroy(m_ctx);
+			ContextCache::getInstance().put(m_uri, m_ctx);
 			m_ctx = nullptr;
 		}
 	}
@@ -380,7 +391,7 @@ void M2kInfoPage::startIdentification(bool start)
 			if (!m2k_fabric) {
 				setStatusLabel("Can't identify this device.");
 				if (!m_connected) {
-					iio_context_destroy(m_ctx);
+					ContextCache::getInstance().put(m_uri, m_ctx);
 					m_ctx = nullptr;
 				}
 				m_fabric_channel = nullptr;
@@ -400,7 +411,7 @@ void M2kInfoPage::startIdentification(bool start)
 				setStatusLabel("Can't identify device. Please try to update your firmware!");
 
 				if (!m_connected) {
-					iio_context_destroy(m_ctx);
+					ContextCache::getInstance().put(m_uri, m_ctx);
 					m_ctx = nullptr;
 				}
 				m_fabric_channel = nullptr;
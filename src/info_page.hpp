@@ -28,6 +28,7 @@
 #include <QFuture>
 
 #include "iio.h"
+#include "device_info_probe.hpp"
 
 namespace Ui {
 class InfoPage;
@@ -74,6 +75,7 @@ public Q_SLOTS:
 private Q_SLOTS:
 	virtual void blinkTimeout();
 	void ledTimeout();
+	void deviceInfoReady(const QString& uri);
 
 Q_SIGNALS:
 	void stopSearching(bool);
@@ -83,6 +85,7 @@ protected:
 
 private:
 	QPair<bool, QString> translateInfoParams(QString);
+	void setDeviceInfo(const DeviceInfoProbe::Info& info);
 	const QStringList identifySupportedModels = {"Analog Devices M2k Rev.C (Z7010)","Analog Devices M2k Rev.D (Z7010)"};
 	const QStringList calibrateSupportedModels = {"Analog Devices M2k Rev.C (Z7010)","Analog Devices M2k Rev.D (Z7010)"};
 
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "jitter_analysis.h"
+
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+/* Below this, a capture isn't worth splitting */
+#define JITTER_MIN_CHUNK 65536
+
+namespace {
+struct Chunk {
+	size_t start, end;
+	int side;
+	double crossing;
+	bool has_crossing;
+	std::vector<EdgeDetector::Edge> edges;
+};
+}
+
+JitterAnalysis::Result::Result(unsigned int windowSize) :
+	edges(0),
+	unit_interval(0.0),
+	period(windowSize),
+	cycle_to_cycle(windowSize),
+	tie(windowSize)
+{
+}
+
+void JitterAnalysis::Result::clear()
+{
+	edges = 0;
+	unit_interval = 0.0;
+	period.clear();
+	cycle_to_cycle.clear();
+	tie.clear();
+	periods.clear();
+	ties.clear();
+}
+
+std::vector<EdgeDetector::Edge> JitterAnalysis::edges(const float *samples,
+		size_t count, float level, float hysteresis,
+		unsigned int chunks)
+{
+	if (!chunks) {
+		chunks = std::max(QThread::idealThreadCount(), 1);
+	}
+	chunks = std::max<size_t>(1, std::min<size_t>(chunks,
+				count / JITTER_MIN_CHUNK));
+
+	std::vector<Chunk> parts(chunks);
+	for (unsigned int i = 0; i < chunks; i++) {
+		parts[i].start = count * i / chunks;
+		parts[i].end = count * (i + 1) / chunks;
+	}
+
+	const EdgeDetector detector(level, hysteresis);
+
+	/* First what each chunk carries over to the next one, which only
+	 * needs its last few samples in the common case. A chunk starts
+	 * with the pair of samples across its boundary. */
+	auto carry = [&](Chunk *part) {
+		size_t first = part->start ? part->start - 1 : 0;
+
+		detector.carryOver(samples + first, part->end - first,
+				part->side, part->crossing,
+				part->has_crossing);
+		part->crossing += first;
+	};
+
+	QList<QFuture<void>> futures;
+	for (unsigned int i = 0; i + 1 < chunks; i++) {
+		futures << QtConcurrent::run(carry, &parts[i]);
+	}
+	for (auto &future : futures) {
+		future.waitForFinished();
+	}
+
+	/* Then every chunk is detected from the state left by the ones
+	 * before it; a chunk with no crossing or no sample out of the
+	 * band passes on what it got */
+	auto detect = [&](Chunk *part, int side, double crossing) {
+		EdgeDetector chunk(level, hysteresis);
+
+		if (part->start) {
+			chunk.resume(side, samples[part->start - 1], crossing,
+					part->start);
+		}
+		chunk.detect(samples + part->start, part->end - part->start,
+				part->edges);
+	};
+
+	futures.clear();
+	int side = 0;
+	double crossing = 0.0;
+	for (unsigned int i = 0; i < chunks; i++) {
+		futures << QtConcurrent::run(detect, &parts[i], side, crossing);
+
+		if (parts[i].side) {
+			side = parts[i].side;
+		}
+		if (parts[i].has_crossing) {
+			crossing = parts[i].crossing;
+		}
+	}
+	for (auto &future : futures) {
+		future.waitForFinished();
+	}
+
+	std::vector<EdgeDetector::Edge> all;
+	for (const auto &part : parts) {
+		all.insert(all.end(), part.edges.begin(), part.edges.end());
+	}
+
+	return all;
+}
+
+void JitterAnalysis::analyze(const std::vector<EdgeDetector::Edge> &edges,
+		double sample_rate, Result &result)
+{
+	if (edges.size() < 2 || !(sample_rate > 0.0)) {
+		return;
+	}
+
+	const double ts = 1.0 / sample_rate;
+	result.edges += edges.size();
+	result.periods.clear();
+	result.ties.clear();
+
+	/* Period and cycle-to-cycle jitter, rising edge to rising edge */
+	double last_rising = NAN, last_period = NAN;
+	for (const auto &edge : edges) {
+		if (!edge.rising) {
+			continue;
+		}
+
+		if (!std::isnan(last_rising)) {
+			double period = (edge.time - last_rising) * ts;
+
+			result.period.pushNewData(period);
+			result.periods.push_back(period);
+			if (!std::isnan(last_period)) {
+				result.cycle_to_cycle.pushNewData(
+						period - last_period);
+			}
+			last_period = period;
+		}
+		last_rising = edge.time;
+	}
+
+	/* TIE: least squares fit of the edge times on their unit interval
+	 * index, both centered to keep the sums small */
+	double ui = EdgeDetector::unitInterval(edges);
+	if (!(ui > 0.0)) {
+		return;
+	}
+
+	const double t0 = edges.front().time;
+	size_t n = edges.size();
+	std::vector<double> index(n);
+	double mean_k = 0.0, mean_t = 0.0;
+
+	for (size_t i = 0; i < n; i++) {
+		index[i] = std::round((edges[i].time - t0) / ui);
+		mean_k += index[i];
+		mean_t += edges[i].time - t0;
+	}
+	mean_k /= n;
+	mean_t /= n;
+
+	double skk = 0.0, skt = 0.0;
+	for (size_t i = 0; i < n; i++) {
+		double dk = index[i] - mean_k;
+		skk += dk * dk;
+		skt += dk * (edges[i].time - t0 - mean_t);
+	}
+
+	double slope = skk > 0.0 ? skt / skk : ui;
+	result.unit_interval = slope * ts;
+
+	for (size_t i = 0; i < n; i++) {
+		double ideal = mean_t + slope * (index[i] - mean_k);
+		double tie = (edges[i].time - t0 - ideal) * ts;
+
+		result.tie.pushNewData(tie);
+		result.ties.push_back(tie);
+	}
+}
+
+double JitterAnalysis::histogram(const std::vector<double> &values,
+		unsigned int nbins, std::vector<unsigned int> &counts,
+		double &min)
+{
+	counts.assign(nbins, 0);
+	min = 0.0;
+
+	if (values.empty() || !nbins) {
+		return 0.0;
+	}
+
+	auto range = std::minmax_element(values.begin(), values.end());
+	min = *range.first;
+
+	double width = (*range.second - min) / nbins;
+	if (!(width > 0.0)) {
+		counts[0] = values.size();
+		return 0.0;
+	}
+
+	for (double value : values) {
+		unsigned int bin = std::min<unsigned int>(
+				(value - min) / width, nbins - 1);
+		counts[bin]++;
+	}
+
+	return width;
+}
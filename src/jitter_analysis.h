@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef JITTER_ANALYSIS_H
+#define JITTER_ANALYSIS_H
+
+#include "edge_detector.h"
+#include "measure.h"
+
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Timing jitter of a long capture, from the edges EdgeDetector finds
+ * with sub-sample resolution. The capture is split in chunks that are
+ * detected in parallel, then resumed at each other's boundary so that
+ * no edge gets lost or doubled.
+ *
+ * The period and cycle-to-cycle jitter come from the rising edges. The
+ * time interval error is that of every edge from an ideal clock of one
+ * unit interval (the least squares fit of the edges on their unit
+ * interval index), so it works for data as well as clock signals.
+ */
+class JitterAnalysis
+{
+public:
+	struct Result {
+		Result(unsigned int windowSize = 100);
+		void clear();
+
+		unsigned int edges;
+		/* In seconds, of the last analyzed capture */
+		double unit_interval;
+		Statistic period;
+		Statistic cycle_to_cycle;
+		Statistic tie;
+
+		/* The values of the last analyzed capture */
+		std::vector<double> periods;
+		std::vector<double> ties;
+	};
+
+	/* Level and hysteresis as for EdgeDetector; 0 chunks uses one per
+	 * core */
+	static std::vector<EdgeDetector::Edge> edges(const float *samples,
+			size_t count, float level, float hysteresis,
+			unsigned int chunks = 0);
+
+	/* Adds the values of the edges to the result, in seconds */
+	static void analyze(const std::vector<EdgeDetector::Edge> &edges,
+			double sample_rate, Result &result);
+
+	/* Counts of the values in nbins equal bins over their range,
+	 * returns the width of a bin, the first one starting at min */
+	static double histogram(const std::vector<double> &values,
+			unsigned int nbins, std::vector<unsigned int> &counts,
+			double &min);
+};
+}
+
+#endif // JITTER_ANALYSIS_H
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "kernel_benchmark.hpp"
+#include "average.h"
+#include "filemanager.h"
+#include "measure.h"
+#include "pg_channel_manager.hpp"
+#include "pg_patterns.hpp"
+#include "pulseview/pv/data/logicsegment.hpp"
+
+#include <QTemporaryDir>
+
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+
+using namespace adiscope;
+
+KernelBenchmark::KernelBenchmark(size_t size, unsigned int iterations) :
+	d_size(std::max<size_t>(size, 16)),
+	d_iterations(std::max(iterations, 1u)),
+	d_signal(d_size),
+	d_spectrum(d_size)
+{
+	/* Seeded, so that every run sees the same input */
+	std::mt19937 gen(1);
+	std::normal_distribution<double> noise(0, 0.01);
+
+	for (size_t i = 0; i < d_size; i++) {
+		d_signal[i] = ((i / 64) % 2 ? 1.0 : -1.0) + noise(gen);
+		d_spectrum[i] = 1.0 / (1 + (double)(i % 257)) +
+			std::abs(noise(gen));
+	}
+}
+
+template <typename F>
+double KernelBenchmark::meanTime(F f) const
+{
+	typedef std::chrono::steady_clock clock;
+
+	f();
+
+	clock::time_point start = clock::now();
+
+	for (unsigned int i = 0; i < d_iterations; i++)
+		f();
+
+	std::chrono::duration<double, std::micro> elapsed =
+		clock::now() - start;
+
+	return elapsed.count() / d_iterations;
+}
+
+QVariantMap KernelBenchmark::run()
+{
+	QVariantMap results;
+
+	results["size"] = (qulonglong)d_size;
+	results["iterations"] = d_iterations;
+
+	benchMeasure(results);
+	benchAverages(results);
+	benchLogicSegment(results);
+	benchPatternCommit(results);
+	benchFileManager(results);
+
+	return results;
+}
+
+void KernelBenchmark::benchMeasure(QVariantMap &results)
+{
+	Measure measure(0, d_signal.data(), d_size);
+
+	measure.setSampleRate(1e8);
+	measure.setAdcBitCount(12);
+
+	results["measure.all"] = meanTime([&]() {
+		measure.measureAll();
+	});
+}
+
+void KernelBenchmark::benchAverages(QVariantMap &results)
+{
+	const unsigned int history = 16;
+	std::vector<double> out(d_size);
+	typedef std::function<SpectrumAverage *()> Factory;
+	const std::vector<std::pair<QString, Factory>> averages = {
+		{ "peak_hold_continuous", [&]() {
+			return new PeakHoldContinuous(d_size, history); } },
+		{ "min_hold_continuous", [&]() {
+			return new MinHoldContinuous(d_size, history); } },
+		{ "exponential_rms", [&]() {
+			return new ExponentialRMS(d_size, history); } },
+		{ "exponential_average", [&]() {
+			return new ExponentialAverage(d_size, history); } },
+		{ "peak_hold", [&]() {
+			return new PeakHold(d_size, history); } },
+		{ "min_hold", [&]() {
+			return new MinHold(d_size, history); } },
+		{ "linear_rms", [&]() {
+			return new LinearRMS(d_size, history); } },
+		{ "linear_average", [&]() {
+			return new LinearAverage(d_size, history); } },
+	};
+
+	/* What the spectrum plot does with every new FFT; one at a time,
+	 * the histories of the large sizes take a lot of memory */
+	for (auto &average : averages) {
+		std::unique_ptr<SpectrumAverage> avg(average.second());
+
+		results["average." + average.first] = meanTime([&]() {
+			avg->pushNewData(d_spectrum.data());
+			avg->getAverage(out.data(), d_size);
+		});
+	}
+}
+
+void KernelBenchmark::benchLogicSegment(QVariantMap &results)
+{
+	/* 16 channels, appended a kernel buffer at a time */
+	const uint64_t chunk = std::min<size_t>(d_size, 1 << 16);
+	std::vector<uint16_t> samples(chunk);
+
+	for (size_t i = 0; i < chunk; i++)
+		samples[i] = (i / 16) ^ (i / 1024);
+
+	for (bool compressed : { false, true }) {
+		auto segment = std::make_shared<pv::data::LogicSegment>(
+			sizeof(uint16_t), 100000000, 0, compressed);
+		QString name = compressed ? "logic_segment.append_compressed" :
+			"logic_segment.append";
+
+		results[name] = meanTime([&]() {
+			segment->append_payload(samples.data(),
+				chunk * sizeof(uint16_t));
+		});
+	}
+}
+
+void KernelBenchmark::benchPatternCommit(QVariantMap &results)
+{
+	PatternGeneratorChannelManager manager;
+	std::vector<short> buffer(d_size);
+
+	/* A random pattern on an 8 channel group, which goes through the
+	 * buffer of the pattern and not the runs */
+	manager.join({ 0, 1, 2, 3, 4, 5, 6, 7 });
+	PatternGeneratorChannelGroup *chg = manager.get_channel_group(0);
+
+	delete chg->pattern;
+	chg->pattern = PatternFactory::create(RandomPatternId);
+	chg->pattern->generate_pattern(1000000, d_size,
+			chg->get_channel_count());
+
+	results["pattern.commit_buffer"] = meanTime([&]() {
+		manager.commitBuffer(chg, buffer.data(), d_size);
+	});
+}
+
+void KernelBenchmark::benchFileManager(QVariantMap &results)
+{
+	QTemporaryDir dir;
+
+	if (!dir.isValid())
+		return;
+
+	QVector<double> ch1(d_size), ch2(d_size);
+
+	for (size_t i = 0; i < d_size; i++) {
+		ch1[i] = d_signal[i];
+		ch2[i] = -d_signal[i];
+	}
+
+	for (const QString &ext : { QString("csv"), QString("npy") }) {
+		QString path = dir.path() + "/bench." + ext;
+
+		results["file.export_" + ext] = meanTime([&]() {
+			FileManager fm("Oscilloscope");
+
+			fm.open(path, FileManager::EXPORT);
+			fm.setSampleRate(1e8);
+			fm.save(ch1, "CH1");
+			fm.save(ch2, "CH2");
+			fm.performWrite();
+		});
+	}
+
+	QString csv = dir.path() + "/bench.csv";
+
+	try {
+		results["file.import_csv"] = meanTime([&]() {
+			FileManager fm("Oscilloscope");
+
+			fm.open(csv, FileManager::IMPORT);
+		});
+	} catch (FileManagerException &e) {
+		results["file.import_csv"] = QString(e.what());
+	}
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef KERNEL_BENCHMARK_HPP
+#define KERNEL_BENCHMARK_HPP
+
+#include <QVariantMap>
+#include <QString>
+
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Timings of the hot DSP and storage routines on fixed synthetic inputs,
+ * for checking an optimization with numbers on the machine at hand. It
+ * runs in the application, from the scripts (launcher.benchmarkKernels),
+ * so it exercises the same build and libraries as the tools do.
+ *
+ * Every entry of the results is the mean duration of one call, in
+ * microseconds, over the given number of iterations following an
+ * untimed warm-up call.
+ */
+class KernelBenchmark
+{
+public:
+	KernelBenchmark(size_t size, unsigned int iterations);
+
+	QVariantMap run();
+
+private:
+	template <typename F> double meanTime(F f) const;
+
+	void benchMeasure(QVariantMap &results);
+	void benchAverages(QVariantMap &results);
+	void benchLogicSegment(QVariantMap &results);
+	void benchPatternCommit(QVariantMap &results);
+	void benchFileManager(QVariantMap &results);
+
+	size_t d_size;
+	unsigned int d_iterations;
+	/* A noisy square wave, volts */
+	std::vector<double> d_signal;
+	/* A spectrum, magnitude squared */
+	std::vector<double> d_spectrum;
+};
+
+} /* namespace adiscope */
+
+#endif /* KERNEL_BENCHMARK_HPP */
@@ -30,6 +30,7 @@ LogicAnalyzerSymmetricBufferMode::LogicAnalyzerSymmetricBufferMode() :
 	m_timeDivsCount(10),
 	m_entireBufferMaxSize(0),
 	m_triggerBufferMaxSize(0),
+	m_deepCapture(false),
 	m_timeBase(0.0),
 	m_triggerPos(0.0),
 	m_sampleRate(0.0),
@@ -94,6 +95,15 @@ void LogicAnalyzerSymmetricBufferMode::setTimeDivisionCount(int count)
 	m_timeDivsCount = count;
 }
 
+void LogicAnalyzerSymmetricBufferMode::setDeepCapture(bool en)
+{
+	if (m_deepCapture != en) {
+		m_deepCapture = en;
+		if (m_timeBase != 0.0)
+			configParamsOnTimeBaseChanged();
+	}
+}
+
 void LogicAnalyzerSymmetricBufferMode::setTimeBase(double secsPerDiv)
 {
 	if (m_timeBase != secsPerDiv) {
@@ -118,8 +128,13 @@ void LogicAnalyzerSymmetricBufferMode::configParamsOnTimeBaseChanged()
 	int sr_divider = 1;
 	sampleRate = m_maxSampleRate / sr_divider;
 
+	// A deep capture keeps the highest rate and moves the trigger
+	// left instead, see the clamp of the trigger position below
+	const long long maxBufferSize = m_deepCapture ?
+		m_entireBufferMaxSize : m_triggerBufferMaxSize;
+
 	long bufferSize = getVisibleBufferSize(sampleRate);
-	while ((m_triggerBufferMaxSize < bufferSize) && (sr_divider <
+	while ((maxBufferSize < bufferSize) && (sr_divider <
 			m_maxSampleRate)) {
 		sr_divider++;
 		sampleRate = ceil(m_maxSampleRate / sr_divider);
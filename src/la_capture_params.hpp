@@ -36,6 +36,12 @@ public:
 	void setTriggerBufferMaxSize(unsigned long maxSize);
 	void setTimeDivisionCount(int count);
 
+	/*
+	 * Only the samples before the trigger have to fit in the trigger
+	 * buffer of the hardware, the rest of a deep capture streams
+	 */
+	void setDeepCapture(bool en);
+
 	void setTimeBase(double secsPerDiv);
 	void setTriggerPos(double pos);
 
@@ -58,6 +64,7 @@ private:
 	unsigned int m_timeDivsCount;
 	long long m_entireBufferMaxSize;
 	long long m_triggerBufferMaxSize;
+	bool m_deepCapture;
 
 	double m_timeBase;
 	double m_triggerPos;
@@ -33,6 +33,7 @@
 #include "ui_la_decoder_reqChannel.h"
 #include "ui_logic_channel_settings.h"
 #include <QScrollBar>
+#include <QSignalBlocker>
 #include <libsigrokcxx/libsigrokcxx.hpp>
 #include <QPainter>
 #include <QListView>
@@ -455,7 +456,7 @@ void LogicAnalyzerChannelUI::triggerChanged(int index)
 		chm_ui->la->setHWTrigger(get_channel()->get_id(), trigger_val);
 		chm_ui->la->setTriggerCache(get_channel()->get_id(), trigger_val);
 	}
-	Q_EMIT requestUpdateUI();
+	chm_ui->requestRefresh(chgroup);
 }
 
 void LogicAnalyzerChannelUI::rolesChangedLHS(const QString text)
@@ -1381,7 +1382,7 @@ void LogicAnalyzerChannelGroupUI::triggerChanged(int index)
 			chm_ui->la->setTriggerCache(ch->get_id(), trigger_val);
 		}
 	}
-	Q_EMIT requestUpdateUI();
+	chm_ui->requestRefresh(lchg);
 }
 
 LogicAnalyzerChannelGroup *LogicAnalyzerChannelGroupUI::getChannelGroup()
@@ -1630,10 +1631,16 @@ LogicAnalyzerChannelManagerUI::LogicAnalyzerChannelManagerUI(QWidget *parent,
 	hoverWidget(nullptr),
 	generalSettings(nullptr),
 	locationSettingsLayout(settingsLayout),
-	streaming_mode(false)
+	streaming_mode(false),
+	updateTimer(new QTimer(this)),
+	rebuildPending(false)
 {
 	ui->setupUi(this);
 	main_win = main_win_;
+	updateTimer->setSingleShot(true);
+	updateTimer->setInterval(0);
+	connect(updateTimer, &QTimer::timeout,
+		this, &LogicAnalyzerChannelManagerUI::applyPendingUpdates);
 	this->chm = chm;
 	this->la = la;
 	this->chm->initDecoderList();
@@ -2165,6 +2172,11 @@ void LogicAnalyzerChannelManagerUI::setupGroupedChannel(LogicAnalyzerChannelGrou
 
 void LogicAnalyzerChannelManagerUI::update_ui()
 {
+	/* Everything gets rebuilt from the model, nothing is left pending */
+	rebuildPending = false;
+	dirtyGroups.clear();
+	updateTimer->stop();
+
 	bool isRunning = la->isRunning();
 	if(isRunning)
 		la->startStop(false);
@@ -2272,9 +2284,64 @@ void LogicAnalyzerChannelManagerUI::chmRangeChanged(int min, int max)
 
 void LogicAnalyzerChannelManagerUI::triggerUpdateUi()
 {
-	int val = ui->scrollArea->verticalScrollBar()->value();
-	update_ui();
-	ui->scrollArea->verticalScrollBar()->setValue(val);
+	requestRebuild();
+}
+
+void LogicAnalyzerChannelManagerUI::requestRebuild()
+{
+	rebuildPending = true;
+	updateTimer->start();
+}
+
+void LogicAnalyzerChannelManagerUI::requestRefresh(LogicAnalyzerChannelGroup *chg)
+{
+	dirtyGroups.insert(chg);
+	updateTimer->start();
+}
+
+void LogicAnalyzerChannelManagerUI::applyPendingUpdates()
+{
+	/* The rebuild covers the refreshes and it stops the capture while
+	 * the traces are replaced, so it only runs for structural edits */
+	if (rebuildPending) {
+		int val = ui->scrollArea->verticalScrollBar()->value();
+		update_ui();
+		ui->scrollArea->verticalScrollBar()->setValue(val);
+		return;
+	}
+
+	for (auto chg : dirtyGroups) {
+		auto chgUi = getUiFromChGroup(chg);
+		if (chgUi) {
+			refreshGroup(chgUi);
+		}
+	}
+	dirtyGroups.clear();
+}
+
+void LogicAnalyzerChannelManagerUI::refreshGroup(LogicAnalyzerChannelGroupUI *chgUi)
+{
+	auto syncTrigger = [=](QComboBox *combo, LogicAnalyzerChannel *ch) {
+		const std::string value = chm->get_channel(ch->get_id())->getTrigger();
+		auto it = std::find(trigger_mapping.begin(),
+				    trigger_mapping.end(), value);
+		if (it != trigger_mapping.end() &&
+				combo->currentIndex() != it - trigger_mapping.begin()) {
+			QSignalBlocker blocker(combo);
+			combo->setCurrentIndex(it - trigger_mapping.begin());
+		}
+	};
+
+	auto chg = chgUi->getChannelGroup();
+	if (!chg->is_grouped()) {
+		syncTrigger(chgUi->ui->comboBox,
+			    static_cast<LogicAnalyzerChannel *>(chg->get_channel()));
+	}
+	for (auto chUi : chgUi->ch_ui) {
+		syncTrigger(chUi->ui->comboBox, chUi->getChannel());
+	}
+
+	chgUi->updateTrace();
 }
 
 void LogicAnalyzerChannelManagerUI::collapse(bool check)
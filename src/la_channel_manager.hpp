@@ -29,6 +29,8 @@
 #include <QFrame>
 #include <QBitmap>
 #include <QVBoxLayout>
+#include <QTimer>
+#include <set>
 
 namespace Ui {
 class LAChannelManager;
@@ -344,6 +346,13 @@ public:
 	std::vector<LogicAnalyzerChannelGroupUI*> getEnabledChannelGroups();
 	bool checkChannelInGroup(int);
 
+	/* Edits only mark what they touched; the widgets catch up once,
+	 * on the next pass of the event loop. A rebuild is for changes of
+	 * the structure (grouping, order, visibility), a refresh only
+	 * syncs the widgets and the traces of one group with the model. */
+	void requestRebuild();
+	void requestRefresh(LogicAnalyzerChannelGroup *chg);
+
 public Q_SLOTS:
 	void chmScrollChanged(int value);
 	void remove();
@@ -360,6 +369,7 @@ private Q_SLOTS:
 	void hideInactive_clicked(bool hide);
 	void chmRangeChanged(int min, int max);
 	void colorChanged(QColor color);
+	void applyPendingUpdates();
 private:
 	bool hidden;
 	bool collapsed;
@@ -374,6 +384,11 @@ private:
 	MouseWheelWidgetGuard *eventFilterGuard;
 	void enableCgSettings(bool en);
 	std::vector<std::string> trigger_mapping;
+
+	QTimer *updateTimer;
+	bool rebuildPending;
+	std::set<LogicAnalyzerChannelGroup *> dirtyGroups;
+	void refreshGroup(LogicAnalyzerChannelGroupUI *chgUi);
 Q_SIGNALS:
 	void widthChanged(int);
 	void channels_changed();
@@ -19,6 +19,8 @@
  */
 #include "logging_categories.h"
 
+#include <chrono>
+
 #ifndef QT_NO_DEBUG_OUTPUT
 Q_LOGGING_CATEGORY(CAT_TOOL_LAUNCHER, "toolLauncher")
 Q_LOGGING_CATEGORY(CAT_OSCILLOSCOPE, "oscilloscope")
@@ -33,4 +35,27 @@ Q_LOGGING_CATEGORY(CAT_PATTERN_GENERATOR, "patternGenerator")
 Q_LOGGING_CATEGORY(CAT_CALIBRATION, "calibration")
 Q_LOGGING_CATEGORY(CAT_CALIBRATION_MANUAL, "calibration.manual")
 Q_LOGGING_CATEGORY(CAT_IIO_MANAGER, "iioManager")
+Q_LOGGING_CATEGORY(CAT_STARTUP, "startup")
+Q_LOGGING_CATEGORY(CAT_SCRIPT_SERVER, "scriptServer")
 #endif
+
+using namespace adiscope;
+
+LogRateLimit::LogRateLimit(int interval_ms) :
+	interval(interval_ms),
+	next(0)
+{
+}
+
+bool LogRateLimit::pass()
+{
+	const int64_t now = std::chrono::duration_cast<
+		std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+	int64_t due = next.load(std::memory_order_relaxed);
+
+	/* Of the threads that get here at once, one wins */
+	return now >= due && next.compare_exchange_strong(due,
+							  now + interval);
+}
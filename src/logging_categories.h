@@ -22,6 +22,25 @@
 
 #include <QLoggingCategory>
 
+#include <atomic>
+#include <stdint.h>
+
+namespace adiscope {
+
+/* Lets a message through at most once every interval_ms */
+class LogRateLimit
+{
+public:
+	explicit LogRateLimit(int interval_ms);
+
+	bool pass();
+
+private:
+	const int64_t interval;
+	std::atomic<int64_t> next;
+};
+}
+
 #ifndef QT_NO_DEBUG_OUTPUT
 Q_DECLARE_LOGGING_CATEGORY(CAT_TOOL_LAUNCHER)
 Q_DECLARE_LOGGING_CATEGORY(CAT_OSCILLOSCOPE)
@@ -36,6 +55,8 @@ Q_DECLARE_LOGGING_CATEGORY(CAT_PATTERN_GENERATOR)
 Q_DECLARE_LOGGING_CATEGORY(CAT_CALIBRATION)
 Q_DECLARE_LOGGING_CATEGORY(CAT_CALIBRATION_MANUAL)
 Q_DECLARE_LOGGING_CATEGORY(CAT_IIO_MANAGER)
+Q_DECLARE_LOGGING_CATEGORY(CAT_STARTUP)
+Q_DECLARE_LOGGING_CATEGORY(CAT_SCRIPT_SERVER)
 #else
 #define CAT_TOOL_LAUNCHER
 #define CAT_OSCILLOSCOPE
@@ -50,6 +71,39 @@ Q_DECLARE_LOGGING_CATEGORY(CAT_IIO_MANAGER)
 #define CAT_CALIBRATION
 #define CAT_CALIBRATION_MANUAL
 #define CAT_IIO_MANAGER
+#define CAT_STARTUP
+#define CAT_SCRIPT_SERVER
+#endif
+
+/*
+ * Debug messages of a category that only cost the check of its cached
+ * enabled flag when it is off, the stream after the macro is not
+ * evaluated. Without debug output they compile to nothing.
+ *
+ * CAT_DEBUG_EVERY() lets one message of the statement through every
+ * interval_ms at most, for those of each frame or sweep step.
+ */
+#ifndef QT_NO_DEBUG_OUTPUT
+#define CAT_DEBUG(category) \
+	for (bool cat_debug_on = category().isDebugEnabled(); cat_debug_on; \
+			cat_debug_on = false) \
+		QMessageLogger(QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, \
+			       QT_MESSAGELOG_FUNC, \
+			       category().categoryName()).debug()
+
+#define CAT_DEBUG_EVERY(category, interval_ms) \
+	for (bool cat_debug_on = category().isDebugEnabled(); cat_debug_on; \
+			cat_debug_on = false) \
+		for (static adiscope::LogRateLimit cat_debug_limit(interval_ms); \
+				cat_debug_on && cat_debug_limit.pass(); \
+				cat_debug_on = false) \
+			QMessageLogger(QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, \
+				       QT_MESSAGELOG_FUNC, \
+				       category().categoryName()).debug()
+#else
+#define CAT_DEBUG(category) while (false) QMessageLogger().noDebug()
+#define CAT_DEBUG_EVERY(category, interval_ms) \
+	while (false) QMessageLogger().noDebug()
 #endif
 
 #endif // LOGGING_CATEGORIES_H
@@ -25,6 +25,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <cstring>
 #include <iio.h>
 
 /* Qt includes */
@@ -34,11 +35,16 @@
 #include <QTimer>
 #include <QFileDialog>
 #include <QFile>
+#include <QDir>
 #include <QMessageBox>
 #include <QDateTime>
 #include <QButtonGroup>
 #include <QDateTime>
 #include <QImageWriter>
+#include <QFutureWatcher>
+#include <QEventLoop>
+#include <QTextStream>
+#include <QJsonObject>
 
 /* Local includes */
 #include "pulseview/pv/mainwindow.hpp"
@@ -50,6 +56,7 @@
 #include "pulseview/pv/view/ruler.hpp"
 #include "pulseview/pv/data/logic.hpp"
 #include "pulseview/pv/data/logicsegment.hpp"
+#include "pulseview/pv/view/logicsignal.hpp"
 #include "logic_analyzer.hpp"
 #include "spinbox_a.hpp"
 #include "scroll_filter.hpp"
@@ -61,7 +68,11 @@
 #include "config.h"
 #include "osc_export_settings.h"
 #include "filemanager.h"
+#include "export_service.hpp"
+#include "capture_archive.hpp"
 #include "logic_analyzer_api.hpp"
+#include "capture_store.h"
+#include "memory_budget.hpp"
 
 /* Sigrok includes */
 #include <libsigrokcxx/libsigrokcxx.hpp>
@@ -86,6 +97,10 @@ using sigrok::ConfigKey;
 
 const unsigned long LogicAnalyzer::maxBuffersize = 16000;
 const unsigned long LogicAnalyzer::maxTriggerBufferSize = 8192;
+const unsigned long LogicAnalyzer::maxEntireBufferSize = 500000;
+const unsigned long LogicAnalyzer::maxDeepBufferSize = 200000000;
+const unsigned long LogicAnalyzer::deepCaptureBlockSize = 262144;
+const uint64_t LogicAnalyzer::deepCaptureMemoryLimit = 256 * 1024 * 1024;
 
 std::vector<std::string> LogicAnalyzer::trigger_mapping = {
 		"none",
@@ -139,7 +154,11 @@ LogicAnalyzer::LogicAnalyzer(struct iio_context *ctx,
 	scrolling_offset(0.0),
 	trigger_offset(0.0),
 	wheelEventGuard(nullptr),
-	active_plot_timebase(0.001)
+	active_plot_timebase(0.001),
+	deep_capture(false),
+	stream_pretrigger_samples(0),
+	stream_trigger_active(false),
+	protocol_trigger_baudrate(115200)
 
 {
 	ui->setupUi(this);
@@ -157,7 +176,7 @@ LogicAnalyzer::LogicAnalyzer(struct iio_context *ctx,
 
 	symmBufferMode = make_shared<LogicAnalyzerSymmetricBufferMode>();
 	symmBufferMode->setMaxSampleRate(maxSamplingFrequency);
-	symmBufferMode->setEntireBufferMaxSize(500000);
+	symmBufferMode->setEntireBufferMaxSize(maxEntireBufferSize);
 	symmBufferMode->setTriggerBufferMaxSize(8192); // 8192 is what hardware supports
 	symmBufferMode->setTimeDivisionCount(10);
 
@@ -390,6 +409,8 @@ LogicAnalyzer::LogicAnalyzer(struct iio_context *ctx,
 		this, SLOT(startTimer()));
 	connect(this, SIGNAL(stoptimeout()),
 		this, SLOT(stopTimer()));
+	connect(this, SIGNAL(streamtriggered(qulonglong)),
+		this, SLOT(onStreamTriggered(qulonglong)));
 	connect(timer, &QTimer::timeout,
 		this, &LogicAnalyzer::triggerTimeout);
 
@@ -464,6 +485,18 @@ LogicAnalyzer::LogicAnalyzer(struct iio_context *ctx,
 	api->load(*settings);
 	api->js_register(engine);
 
+	MemoryBudget::instance()->addUsage(this, api->objectName(),
+		tr("capture"), [=]() {
+		uint64_t bytes = 0;
+		auto logic = main_win->session_.get_logic_data();
+
+		if (logic) {
+			for (const auto& segment : logic->logic_segments())
+				bytes += segment->memory_used();
+		}
+		return (size_t)bytes;
+	});
+
 	ui->btnPrint->setFixedWidth(40);
 	connect(ui->btnPrint, &QPushButton::clicked, [=]() {
 		QImage img (ui->plotWidget->width(), ui->plotWidget->height(), QImage::Format_ARGB32);
@@ -697,6 +730,136 @@ void LogicAnalyzer::updateAreaTimeTrigger()
 	ui->areaTimeTriggerLayout->setContentsMargins(newValue, 0, 0, 0);
 }
 
+namespace {
+/* Samples read from the segment at a time by the exporters */
+const uint64_t exportBlockSamples = 65536;
+const size_t exportBufferSize = 4 * 1024 * 1024;
+
+/*
+ * Output buffer of the exporters. The text is formatted straight into
+ * it and written to the file in large blocks, which is much cheaper than
+ * a QTextStream conversion per value.
+ */
+class ExportBuffer
+{
+public:
+	explicit ExportBuffer(QFile &file) :
+		file(file), buf(exportBufferSize), pos(0), ok(true)
+	{
+	}
+
+	/* Room for at least n more bytes */
+	char *reserve(size_t n)
+	{
+		if (pos + n > buf.size()) {
+			flush();
+			if (n > buf.size())
+				buf.resize(n);
+		}
+		return buf.data() + pos;
+	}
+
+	void commit(const char *end)
+	{
+		pos = end - buf.data();
+	}
+
+	bool flush()
+	{
+		if (pos && file.write(buf.data(), pos) != (qint64)pos)
+			ok = false;
+		pos = 0;
+		return ok;
+	}
+
+private:
+	QFile &file;
+	std::vector<char> buf;
+	size_t pos;
+	bool ok;
+};
+
+char *formatUInt(char *out, uint64_t value)
+{
+	char digits[20];
+	int n = 0;
+
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+
+	while (n)
+		*out++ = digits[--n];
+
+	return out;
+}
+
+uint64_t loadBytes(const uint8_t *ptr, unsigned int size)
+{
+	uint64_t value = 0;
+	memcpy(&value, ptr, size);
+	return value;
+}
+
+/*
+ * Reads the segment in blocks, each one preceded by the last sample of
+ * the one before, so sample k always has its predecessor at k - 1.
+ */
+class ExportReader
+{
+public:
+	explicit ExportReader(std::shared_ptr<pv::data::LogicSegment> segment) :
+		segment(segment),
+		unit_size(segment->unit_size()),
+		buf((exportBlockSamples + 1) * unit_size),
+		next(0), first(0), last(0)
+	{
+	}
+
+	/* The samples of the next block start at data() + unit_size(),
+	 * returns their count, 0 at the end */
+	uint64_t read()
+	{
+		uint64_t total = segment->get_sample_count();
+		uint64_t count = std::min(exportBlockSamples, total - next);
+
+		if (!count)
+			return 0;
+
+		if (next)
+			memcpy(buf.data(), buf.data() + last * unit_size,
+				unit_size);
+		else
+			memset(buf.data(), 0, unit_size);
+
+		/* One copy out of each chunk, with the chunk locked */
+		uint8_t *dest = buf.data() + unit_size;
+		segment->for_each_chunk(next, next + count,
+			[&](const uint8_t *data, uint64_t, uint64_t n) {
+			memcpy(dest, data, n * unit_size);
+			dest += n * unit_size;
+			return true;
+		});
+
+		first = next;
+		last = count;
+		next += count;
+		return count;
+	}
+
+	const uint8_t *data() const { return buf.data(); }
+	uint64_t start() const { return first; }
+
+	const std::shared_ptr<pv::data::LogicSegment> segment;
+	const unsigned int unit_size;
+
+private:
+	std::vector<uint8_t> buf;
+	uint64_t next, first, last;
+};
+}
+
 QString LogicAnalyzer::saveToFile()
 {
 	QString separator = "";
@@ -704,6 +867,8 @@ QString LogicAnalyzer::saveToFile()
 	QString endRow = "\n";
 	QString selectedFilter;
 	bool done = false;
+	bool capture = false;
+	bool archive = false;
 	bool noChannelEnabled = true;
 	
 	exportConfig = exportSettings->getExportConfig();
@@ -721,6 +886,8 @@ QString LogicAnalyzer::saveToFile()
 	filter += QString(tr("Comma-separated values files (*.csv)"));
 	filter += QString(tr("Tab-delimited values files (*.txt)"));
 	filter += QString(tr("Value Change Dump(*.vcd)"));
+	filter += QString(tr("Logic capture (*.lacap)"));
+	filter += QString(tr("Compressed capture archives (*.scarc)"));
 	filter += QString(tr("All Files(*)"));
 
 	QString fileName = QFileDialog::getSaveFileName(this,
@@ -746,13 +913,31 @@ QString LogicAnalyzer::saveToFile()
 			startRow = "$";
 			fileName += ".vcd";
 		}
+		if(selectedFilter.contains("Logic capture", Qt::CaseInsensitive)) {
+			fileName += ".lacap";
+			capture = true;
+		}
+		if(selectedFilter.contains("archive", Qt::CaseInsensitive)) {
+			fileName += ".scarc";
+			archive = true;
+		}
 	}
 
 
-	if( separator != "" ) {
-		done = exportTabCsv(separator, fileName);
+	std::shared_ptr<pv::data::Logic> logic_data = main_win->session_.get_logic_data();
+	if (!logic_data || logic_data->logic_segments().empty()) {
+		return "";
+	}
+	shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
 
-	} else {
+	std::vector<unsigned int> channels;
+	for(unsigned int ch = 0; ch < no_channels; ch++) {
+		if( exportConfig[ch] ) {
+			channels.push_back(ch);
+		}
+	}
+
+	if( separator == "" && !capture && !archive ) {
 		QFile file(fileName);
 		if( !file.open(QIODevice::WriteOnly)) {
 			return "";
@@ -769,22 +954,65 @@ QString LogicAnalyzer::saveToFile()
 
 
 		file.close();
+	}
+
+	/*
+	 * The CSV and VCD exports hold the segment, a new capture fills
+	 * another one, so the acquisition resumes while they stream it in
+	 * the background. The capture file is written from the session
+	 * state in one go: it is waited for and only shows busy.
+	 */
+	ExportService *service = ExportService::instance();
 
-		done = exportVCD(fileName, startRow, endRow);
+	if( capture ) {
+		QFuture<bool> future = service->start(this, fileName,
+				[this, fileName](const ExportService::Progress&) {
+			return saveCapture(fileName);
+		}, false);
+
+		QFutureWatcher<bool> watcher;
+		QEventLoop loop;
+		connect(&watcher, SIGNAL(finished()), &loop, SLOT(quit()));
+		watcher.setFuture(future);
+
+		if (!watcher.isFinished()) {
+			loop.exec();
+		}
+		done = future.result();
+	} else if( archive ) {
+		service->start(this, fileName,
+				[=](const ExportService::Progress& progress) {
+			return saveArchive(fileName, segment, progress);
+		});
+		done = true;
+	} else if( separator != "" ) {
+		service->start(this, fileName,
+				[=](const ExportService::Progress& progress) {
+			return exportTabCsv(separator, fileName, segment,
+					    channels, progress);
+		});
+		done = true;
+	} else {
+		service->start(this, fileName,
+				[=](const ExportService::Progress& progress) {
+			return exportVCD(fileName, startRow, endRow, segment,
+					 channels, progress);
+		});
+		done = true;
 	}
 
 	return (done ? fileName : "");
 }
 
-bool LogicAnalyzer::exportVCD(QString filename, QString startSep, QString endSep)
+bool LogicAnalyzer::exportVCD(QString filename, QString startSep, QString endSep,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		std::vector<unsigned int> channels,
+		const FileManager::WriteProgress &progress)
 {
-	uint64_t current_sample, prev_sample;
-	int current_bit, prev_bit, p;
 	QString timescaleFormat;
 	double timescale;
-	bool timestamp_written = false;
 
-        if( active_sampleRate == 0 ) {
+        if( segment->samplerate() == 0 ) {
                 return false;
         }
 
@@ -797,7 +1025,7 @@ bool LogicAnalyzer::exportVCD(QString filename, QString startSep, QString endSep
 	QTextStream out(&file);
 
 	/* Write the specific header */
-	timescale = 1 / active_sampleRate;
+	timescale = 1 / segment->samplerate();
 	if( timescale < 1e-6 ) {
 		timescaleFormat = "ns";
 		timescale *= 1e9;
@@ -815,101 +1043,163 @@ bool LogicAnalyzer::exportVCD(QString filename, QString startSep, QString endSep
 
 	out << startSep << "timescale " << QString::number(timescale) << " " << timescaleFormat << endSep;
 	out << startSep << "scope module Scopy" << endSep;
-	int counter = 0;
-	for(unsigned int ch = 0; ch < no_channels; ch++) {
-		if( exportConfig[ch] ) {
-			char c = '!' + counter;
-			out << startSep << "var wire 1 " << c << " DIO" <<
-			       QString::number(ch) << endSep;
-			counter++;
-		}
+	for(unsigned int i = 0; i < channels.size(); i++) {
+		char c = '!' + i;
+		out << startSep << "var wire 1 " << c << " DIO" <<
+		       QString::number(channels[i]) << endSep;
 	}
 	out << startSep << "upscope" << endSep;
 	out << startSep << "enddefinitions" << endSep;
-
-	/* Write the values */
-	std::shared_ptr<pv::data::Logic> logic_data = main_win->session_.get_logic_data();
-	if(logic_data) {
-		shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
-		uint64_t sample_count = segment->get_sample_count();
-		for(uint64_t i = 0; i < sample_count; i++) {
-			current_sample = segment->get_sample(i);
-			if( i == 0)
-				prev_sample = current_sample;
-			else
-				prev_sample = segment->get_sample(i-1);
-			timestamp_written = false;
-			p = 0;
-			for(unsigned int ch = 0; ch < no_channels; ch++) {
-
-				current_bit = (current_sample >> ch) & 1;
-				prev_bit = (prev_sample >> ch) & 1;
-
-				if((current_bit == prev_bit) && (i != 0)) {
-					p++;
+	out.flush();
+
+	/* Write the values, only the samples where an exported channel
+	 * changes, with the channels that changed */
+	ExportReader reader(segment);
+	ExportBuffer buffer(file);
+	const unsigned int us = reader.unit_size;
+	const uint64_t total = segment->get_sample_count();
+	uint64_t mask = 0;
+	for (unsigned int ch : channels) {
+		mask |= (uint64_t)1 << ch;
+	}
+
+	/* Runs without changes are skipped a 64 bit word at a time, each
+	 * word compared to the same one shifted by a sample */
+	const bool wordwise = us <= 4 && 8 % us == 0;
+	const unsigned int per_word = 8 / us;
+	uint64_t word_mask = 0;
+	for (unsigned int j = 0; wordwise && j < per_word; j++) {
+		word_mask |= mask << (j * us * 8);
+	}
+
+	uint64_t prev = 0;
+	bool cancelled = false;
+	uint64_t count;
+
+	while (!cancelled && (count = reader.read())) {
+		const uint8_t *data = reader.data();
+		uint64_t k = 1;
+
+		for (; k <= count; k++) {
+			/* the first sample has no predecessor to compare to */
+			if (wordwise && (k > 1 || reader.start()) &&
+					k + per_word - 1 <= count) {
+				uint64_t a, b;
+				memcpy(&a, data + (k - 1) * us, 8);
+				memcpy(&b, data + k * us, 8);
+				if (!((a ^ b) & word_mask)) {
+					k += per_word - 1;
 					continue;
 				}
-				if( !timestamp_written )
-					out << "#" << QString::number(i);
-				if(exportConfig[ch]) {
-					char c = '0' + current_bit;
-					char c2 = '!' + p;
-					out << ' ' << c << c2;
-					p++;
-					timestamp_written = true;
+			}
+
+			uint64_t cur = loadBytes(data + k * us, us);
+			uint64_t index = reader.start() + k - 1;
+			uint64_t changed = index ? (cur ^ prev) & mask : mask;
+
+			if (!changed) {
+				continue;
+			}
+
+			char *p = buffer.reserve(24 + 3 * channels.size());
+			*p++ = '#';
+			p = formatUInt(p, index);
+			for (unsigned int i = 0; i < channels.size(); i++) {
+				if ((changed >> channels[i]) & 1) {
+					*p++ = ' ';
+					*p++ = '0' + ((cur >> channels[i]) & 1);
+					*p++ = '!' + i;
 				}
 			}
-			if(timestamp_written)
-				out << "\n";
+			*p++ = '\n';
+			buffer.commit(p);
+			prev = cur;
 		}
+
+		cancelled = !progress(reader.start() + count, total);
 	}
-	else {
-		file.close();
-		return false;
-	}
+
+	bool ok = buffer.flush();
 	file.close();
-	return true;
+	return ok && !cancelled;
 }
 
-bool LogicAnalyzer::exportTabCsv(QString separator, QString filename)
+bool LogicAnalyzer::exportTabCsv(QString separator, QString filename,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		std::vector<unsigned int> channels,
+		const FileManager::WriteProgress &progress)
 {
-	FileManager fm("Logic Analyzer");
-	fm.open(filename, FileManager::EXPORT);
-
-	QStringList chNames;
-	for(unsigned int ch = 0; ch < no_channels; ch++) {
-		if( exportConfig[ch] ) {
-			chNames.push_back("Channel " + QString::number(ch));
-		}
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return false;
 	}
 
-	QVector<QVector<double>> data;
-
-	std::shared_ptr<pv::data::Logic> logic_data = main_win->session_.get_logic_data();
-	if (!logic_data) {
-		return false;
-	} else {
-		shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
-		for (unsigned int i = 0; i < segment->get_sample_count(); ++i) {
-			uint64_t sample = segment->get_sample(i);
-			QVector<double> line;
-			for (unsigned int ch = 0; ch < no_channels; ++ch) {
-				int bit = (sample >> ch) & 1;
-				if(exportConfig[ch]) {
-					line.push_back(bit);
+	/* Same header as the one FileManager writes, the rows are streamed
+	 * instead of going through a table of doubles */
+	QTextStream out(&file);
+	QStringList header = ScopyFileHeader::getHeader();
+	const uint64_t total = segment->get_sample_count();
+
+	out << header[0] << separator << QString(SCOPY_VERSION_GIT) << "\n";
+	out << header[1] << separator << QDate::currentDate().toString("dddd MMMM dd/MM/yyyy") << "\n";
+	out << header[2] << separator << "M2K" << "\n";
+	out << header[3] << separator << (qulonglong)total << "\n";
+	out << header[4] << separator << segment->samplerate() << "\n";
+	out << header[5] << separator << "Logic Analyzer" << "\n";
+	out << header[6] << separator << "" << "\n";
+
+	out << "Sample";
+	for (unsigned int ch : channels) {
+		out << separator << "Channel " << QString::number(ch);
+	}
+	out << "\n";
+	out.flush();
+
+	ExportReader reader(segment);
+	ExportBuffer buffer(file);
+	const unsigned int us = reader.unit_size;
+	const QByteArray sep = separator.toUtf8();
+	uint64_t mask = 0;
+	for (unsigned int ch : channels) {
+		mask |= (uint64_t)1 << ch;
+	}
+
+	/* The values of a row only change with the sample, the text after
+	 * the index is kept and formatted again on changes */
+	std::vector<char> row;
+	uint64_t prev = 0;
+	bool cancelled = false;
+	uint64_t count;
+
+	while (!cancelled && (count = reader.read())) {
+		const uint8_t *data = reader.data();
+
+		for (uint64_t k = 1; k <= count; k++) {
+			uint64_t cur = loadBytes(data + k * us, us);
+
+			if (row.empty() || ((cur ^ prev) & mask)) {
+				row.clear();
+				for (unsigned int ch : channels) {
+					row.insert(row.end(), sep.begin(),
+						   sep.end());
+					row.push_back('0' + ((cur >> ch) & 1));
 				}
+				row.push_back('\n');
+				prev = cur;
 			}
-			data.push_back(line);
-		}
-	}
 
-	fm.setSampleRate(main_win->session_.get_samplerate());
-
-	fm.save(data, chNames);
+			char *p = buffer.reserve(20 + row.size());
+			p = formatUInt(p, reader.start() + k - 1);
+			memcpy(p, row.data(), row.size());
+			buffer.commit(p + row.size());
+		}
 
-	fm.performWrite();
+		cancelled = !progress(reader.start() + count, total);
+	}
 
-	return true;
+	bool ok = buffer.flush();
+	file.close();
+	return ok && !cancelled;
 }
 
 void LogicAnalyzer::btnExportPressed()
@@ -957,6 +1247,99 @@ void LogicAnalyzer::stopTimeout()
 	Q_EMIT stoptimeout();
 }
 
+void LogicAnalyzer::streamTriggered(uint64_t pretrigger)
+{
+	Q_EMIT streamtriggered(pretrigger);
+}
+
+void LogicAnalyzer::onStreamTriggered(qulonglong pretrigger)
+{
+	triggerUpdater->setInput(Triggered);
+	main_win->view_->viewport()->setTimeTriggerSample(pretrigger);
+}
+
+bool LogicAnalyzer::captureTime(uint64_t &time, uint64_t &sample) const
+{
+	if (!logic_analyzer_ptr)
+		return false;
+
+	return logic_analyzer_ptr->last_block_time(time, sample);
+}
+
+unsigned long LogicAnalyzer::streamPretrigger() const
+{
+	return stream_pretrigger_samples;
+}
+
+void LogicAnalyzer::setStreamPretrigger(unsigned long samples)
+{
+	stream_pretrigger_samples = std::min<unsigned long>(samples,
+		pv::devices::PreTriggerBuffer::MaxSamples);
+}
+
+void LogicAnalyzer::configureStreamTrigger()
+{
+	pv::devices::StreamTrigger trigger;
+	pv::devices::ProtocolTrigger protocol = protocol_trigger;
+
+	const bool software = acquisition_mode == STREAM &&
+		stream_pretrigger_samples > 0 &&
+		!trigger_settings_ui->btnTriggerMode->isChecked() &&
+		!trigger_settings_ui->trigg_extern_en->isChecked();
+
+	if (software) {
+		for (unsigned int i = 0; i < get_no_channels(dev) && i < 16; i++) {
+			const std::string &value = chm.get_channel(i)->getTrigger();
+			const uint16_t bit = 1 << i;
+
+			if (value == "edge-any") {
+				trigger.rising |= bit;
+				trigger.falling |= bit;
+			} else if (value == "edge-rising") {
+				trigger.rising |= bit;
+			} else if (value == "edge-falling") {
+				trigger.falling |= bit;
+			} else if (value == "level-high") {
+				trigger.high |= bit;
+			} else if (value == "level-low") {
+				trigger.low |= bit;
+			}
+		}
+		trigger.match_all =
+			trigger_settings_ui->cmb_trigg_logic->currentText() == "AND";
+
+		if (protocol_trigger_baudrate > 0)
+			protocol.samples_per_bit = active_sampleRate /
+				protocol_trigger_baudrate;
+	} else {
+		protocol.type = pv::devices::ProtocolTrigger::None;
+	}
+
+	stream_trigger_active = trigger.enabled() || protocol.enabled();
+	logic_analyzer_ptr->set_protocol_trigger(protocol);
+	logic_analyzer_ptr->set_stream_trigger(trigger,
+		stream_trigger_active ? stream_pretrigger_samples : 0);
+
+	// The stream has to start at once for the history to fill up
+	if (stream_trigger_active) {
+		for (unsigned int i = 0; i < get_no_channels(dev); i++) {
+			setHWTrigger(i, trigger_mapping[0]);
+		}
+		triggerUpdater->setInput(Waiting);
+	}
+}
+
+void LogicAnalyzer::restoreHWTriggers()
+{
+	if (!stream_trigger_active)
+		return;
+
+	stream_trigger_active = false;
+	for (unsigned int i = 0; i < get_no_channels(dev); i++) {
+		setHWTrigger(i, chm.get_channel(i)->getTrigger());
+	}
+}
+
 void LogicAnalyzer::stopTimer()
 {
 	if(trigger_settings_ui->btnTriggerMode->isChecked()) {
@@ -1162,7 +1545,7 @@ void LogicAnalyzer::configParams(double timebase, double timepos)
         timer_timeout_ms = plotTimeSpan * 1000  + 100; //transfer time
 
         acquisition_mode = ui->btnRepeated->isChecked() ? REPEATED : STREAM;
-        acquisition_mode = (acquisition_mode == REPEATED
+        acquisition_mode = (acquisition_mode == REPEATED && !deep_capture
                             && plotTimeSpan >= timespanLimitStream) ? SCREEN : acquisition_mode;
 
         main_win->session_.set_screen_mode(false);
@@ -1265,9 +1648,16 @@ void LogicAnalyzer::configParams(double timebase, double timepos)
                 main_win->session_.set_entire_buffersize(0);
                 if( logic_analyzer_ptr )
                 {
-                        if(logic_analyzer_ptr->get_buffersize() != active_sampleCount)
+                        // Past what a single IIO buffer holds the capture
+                        // streams in blocks, back to back
+                        const unsigned long block_size =
+                                (active_sampleCount > maxEntireBufferSize) ?
+                                deepCaptureBlockSize : active_sampleCount;
+
+                        logic_analyzer_ptr->set_entire_buffersize(active_sampleCount);
+                        if(logic_analyzer_ptr->get_buffersize() != block_size)
                         {
-                                logic_analyzer_ptr->set_buffersize(active_sampleCount, true);
+                                logic_analyzer_ptr->set_buffersize(block_size, false);
                                 set_buffersize();
                         }
                 }
@@ -1359,7 +1749,8 @@ void LogicAnalyzer::startStop(bool start)
 	if (start) {
 		//Reset the triggered register
 		iio_device_attr_write_bool(dev, "streaming", false);
-		if(acquisition_mode != REPEATED){
+		if(acquisition_mode != REPEATED ||
+				active_sampleCount > maxEntireBufferSize) {
 			iio_device_attr_write_bool(dev, "streaming", true);
 		}
 		if (reset_horiz_offset) {
@@ -1385,10 +1776,13 @@ void LogicAnalyzer::startStop(bool start)
 		setTriggerDelay();
 		if(!armed)
 			autoCaptureEnable(true);
+		configureStreamTrigger();
 		updateBufferPreviewer();
+		updateSpill();
 	} else {
 		main_win->view_->viewport()->enableDrag();
 		m_running = false;
+		restoreHWTriggers();
 		ui->btnRunStop->setText(tr("Run"));
 		if(timer->isActive()) {
 			timer->stop();
@@ -1458,6 +1852,7 @@ void LogicAnalyzer::singleRun(bool checked)
 		//	if (timePosition->value() != active_timePos)
 		//		timePosition->setValue(active_timePos);
 		logic_analyzer_ptr->set_single(true);
+		configureStreamTrigger();
 		main_win->run_stop();
 		m_running = false;
 		updateBufferPreviewer();
@@ -1468,6 +1863,7 @@ void LogicAnalyzer::singleRun(bool checked)
 				&& logic_analyzer_ptr->is_running()) {
 			main_win->run_stop();
 		}
+		restoreHWTriggers();
 		m_running = false;
 		if(timer->isActive())
 			timer->stop();
@@ -1983,6 +2379,135 @@ void LogicAnalyzer::setTimeout(bool checked)
 		timer->stop();
 }
 
+bool LogicAnalyzer::deepCapture() const
+{
+	return deep_capture;
+}
+
+void LogicAnalyzer::setDeepCapture(bool en)
+{
+	if (deep_capture == en)
+		return;
+
+	deep_capture = en;
+	symmBufferMode->setEntireBufferMaxSize(en ? maxDeepBufferSize :
+		maxEntireBufferSize);
+	symmBufferMode->setDeepCapture(en);
+	updateSpill();
+
+	// The trigger may have moved to fit the new buffer
+	configParams(timeBase->value(),
+		-symmBufferMode->captureParameters().timePos);
+}
+
+QString LogicAnalyzer::spillDirectory() const
+{
+	return spill_dir;
+}
+
+void LogicAnalyzer::setSpillDirectory(const QString &dir)
+{
+	spill_dir = dir;
+	updateSpill();
+}
+
+bool LogicAnalyzer::saveCapture(const QString &path)
+{
+	return main_win->session_.save_logic(path);
+}
+
+bool LogicAnalyzer::loadCapture(const QString &path)
+{
+	if (m_running) {
+		startStop(false);
+	}
+
+	if (CaptureArchive::isArchive(path)) {
+		return main_win->session_.load_logic(loadArchive(path));
+	}
+
+	return main_win->session_.load_logic(path);
+}
+
+bool LogicAnalyzer::saveArchive(QString filename,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		const FileManager::WriteProgress &progress)
+{
+	/* The packed samples, as a capture file has them */
+	CaptureArchive::Stream stream;
+	stream.name = "Logic";
+	stream.encoding = CaptureArchive::LOGIC;
+	stream.unit_size = segment->unit_size();
+	stream.samples = segment->get_sample_count();
+	stream.scale = 1.0;
+	stream.offset = 0.0;
+
+	CaptureArchive::StreamReader reader = [segment](uint64_t first,
+			uint64_t count, uint8_t *out) {
+		segment->get_samples(out, first, first + count);
+	};
+
+	QJsonObject metadata;
+	metadata["tool"] = "Logic Analyzer";
+	metadata["version"] = QString(SCOPY_VERSION_GIT);
+
+	return CaptureArchive::write(filename, { stream }, { reader },
+			segment->samplerate(), metadata, progress);
+}
+
+std::shared_ptr<pv::data::LogicSegment> LogicAnalyzer::loadArchive(
+		const QString &path)
+{
+	CaptureArchive archive;
+
+	if (!archive.open(path) || archive.streams().size() != 1 ||
+			archive.streams()[0].encoding != CaptureArchive::LOGIC) {
+		return nullptr;
+	}
+
+	const CaptureArchive::Stream &stream = archive.streams()[0];
+	auto segment = std::make_shared<pv::data::LogicSegment>(
+			stream.unit_size, archive.sampleRate(), stream.samples);
+
+	/* Decoded a block at a time, the chunks are read in order */
+	const uint64_t block = 1 << 20;
+	std::vector<uint8_t> data;
+
+	for (uint64_t first = 0; first < stream.samples; first += block) {
+		uint64_t count = std::min(block, stream.samples - first);
+
+		data.resize(count * stream.unit_size);
+		if (!archive.read(0, first, count, data.data())) {
+			return nullptr;
+		}
+		segment->append_payload(data.data(), data.size());
+	}
+
+	return segment;
+}
+
+void LogicAnalyzer::updateSpill()
+{
+	/*
+	 * Within a memory budget a deep capture keeps what doesn't fit in
+	 * a file, in the temporary directory without a spill directory
+	 */
+	MemoryBudget *budget = MemoryBudget::instance();
+	const bool spill = deep_capture &&
+		(!spill_dir.isEmpty() || budget->budget() > 0);
+	uint64_t limit = deepCaptureMemoryLimit;
+
+	if (budget->budget() > 0) {
+		/* 0 would keep it all in memory */
+		budget->reserve(limit);
+		limit = std::max<uint64_t>(1,
+			std::min<uint64_t>(limit, budget->available()));
+	}
+
+	main_win->session_.set_spill(spill ? limit : 0,
+		spill_dir.isEmpty() ? QDir::tempPath() : spill_dir);
+}
+
 void LogicAnalyzer::runModeChanged(bool repeated)
 {
         bool en;
@@ -1998,7 +2523,8 @@ void LogicAnalyzer::runModeChanged(bool repeated)
 
                 main_win->session_.set_screen_mode(false);
                 en = false;
-                if(timeBase->value() * 10 >= timespanLimitStream) {
+                if(timeBase->value() * 10 >= timespanLimitStream &&
+                                !deep_capture) {
                         d_timeTriggerHandle->setPosition(0);
                         acquisition_mode = SCREEN;
                         main_win->session_.set_screen_mode(true);
@@ -2085,6 +2611,8 @@ void LogicAnalyzer::onDataReceived()
 	/* Single shot */
 	if( !m_running )
 		triggerUpdater->setEnabled(m_running);
+
+	publishCapture();
 }
 
 void LogicAnalyzer::onFrameEnded()
@@ -2093,5 +2621,44 @@ void LogicAnalyzer::onFrameEnded()
 	 * and data was received */
 	if(ui->btnSingleRun->isChecked() && main_win->session_.is_data())
 		ui->btnSingleRun->setChecked(false);
+
+	publishCapture();
+}
+
+void LogicAnalyzer::publishCapture()
+{
+	std::shared_ptr<pv::data::Logic> logic_data = main_win->session_.get_logic_data();
+	if (!logic_data || logic_data->logic_segments().empty()) {
+		return;
+	}
+
+	auto capture = std::make_shared<CaptureStore::LogicCapture>();
+	capture->segment = logic_data->logic_segments().front();
+	capture->channel_mask = 0;
+	capture->sample_rate = capture->segment->samplerate();
+	capture->timestamp = std::chrono::steady_clock::now();
+
+	for (const auto &s : main_win->session_.signals()) {
+		auto l = std::dynamic_pointer_cast<pv::view::LogicSignal>(s);
+		if (!l || l->logic_data() != logic_data ||
+				!l->channel()->enabled() || l->channel()->index() >= 64) {
+			continue;
+		}
+
+		const int index = l->channel()->index();
+		capture->channel_mask |= 1ULL << index;
+		while (capture->channel_names.size() <= index) {
+			capture->channel_names.append(QString());
+		}
+		capture->channel_names[index] = l->name();
+	}
+
+	/* The trigger delay is the position of the first sample from the
+	 * trigger; a stream has no trigger, it starts at 0 */
+	capture->triggered = acquisition_mode == REPEATED;
+	capture->start_time = capture->triggered && capture->sample_rate > 0 ?
+		active_hw_trigger_sample_count / capture->sample_rate : 0;
+
+	captureStore->setLogic(capture);
 }
 
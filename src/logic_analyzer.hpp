@@ -38,6 +38,7 @@
 #include "plot_utils.hpp"
 #include "tool.hpp"
 #include "customPushButton.hpp"
+#include "filemanager.h"
 
 using namespace pv;
 using namespace pv::toolbars;
@@ -49,6 +50,9 @@ namespace view {
 class Viewport;
 class Ruler;
 }
+namespace data {
+class LogicSegment;
+}
 class Session;
 }
 
@@ -128,6 +132,47 @@ public:
 	bool isRunning() const;
 	bool hasCrossInstrumentTrigger();
 
+	/*
+	 * A deep capture streams up to maxDeepBufferSize samples after the
+	 * trigger, only the pre-trigger samples are bound by the hardware
+	 * trigger buffer. With a spill directory the samples past
+	 * deepCaptureMemoryLimit bytes are kept in a file there; with a
+	 * memory budget past what is left of it, in the temporary
+	 * directory when no spill directory is set.
+	 */
+	bool deepCapture() const;
+	void setDeepCapture(bool en);
+	QString spillDirectory() const;
+	void setSpillDirectory(const QString &dir);
+
+	/*
+	 * A capture file keeps the samples of all the channels as they are
+	 * stored and is mapped back when loaded, a loaded capture replaces
+	 * the data so the decoders can run on it again. loadCapture() also
+	 * takes the compressed archives the export writes.
+	 */
+	bool saveCapture(const QString &path);
+	bool loadCapture(const QString &path);
+
+	/*
+	 * In stream mode the channel triggers, or the protocol trigger, are
+	 * checked in software on the incoming samples, up to
+	 * streamPretrigger samples from before the trigger being kept and
+	 * shown; 0 leaves the trigger to the hardware, which only starts
+	 * the stream.
+	 */
+	unsigned long streamPretrigger() const;
+	void setStreamPretrigger(unsigned long samples);
+	/* From the stream thread, once the trigger was found */
+	void streamTriggered(uint64_t pretrigger);
+
+	/*
+	 * Acquisition time (acquisition_clock.h) of the last buffer read
+	 * from the device and index of its first sample, on the same clock
+	 * as the Oscilloscope frame times.
+	 */
+	bool captureTime(uint64_t &time, uint64_t &sample) const;
+
 private Q_SLOTS:
 	void toggleRightMenu(bool);
 	void rightMenuFinished(bool opened);
@@ -162,6 +207,7 @@ private Q_SLOTS:
 	void checkEnabledChannels();
 	void toolDetached(bool);
 	void toggleExternalTriggerConditionsWidget(int index);
+	void onStreamTriggered(qulonglong pretrigger);
 public Q_SLOTS:
 	void startStop(bool start);
 	void run() override;
@@ -176,6 +222,7 @@ public Q_SLOTS:
 Q_SIGNALS:
 	void starttimeout();
 	void stoptimeout();
+	void streamtriggered(qulonglong pretrigger);
 	void activateExportButton();
 	void showTool();
 
@@ -217,7 +264,26 @@ private:
 	void disconnectAll();
 	static unsigned int get_no_channels(struct iio_device *dev);
 
+	/* Hand the current segment to the capture store, placed on the
+	 * time axis of the trigger */
+	void publishCapture();
+
 	static const unsigned long maxBuffersize;
+	static const unsigned long maxEntireBufferSize;
+	static const unsigned long maxDeepBufferSize;
+	static const unsigned long deepCaptureBlockSize;
+	static const uint64_t deepCaptureMemoryLimit;
+	bool deep_capture;
+	QString spill_dir;
+	unsigned long stream_pretrigger_samples;
+	bool stream_trigger_active;
+	/* Replaces the channel triggers in stream mode when enabled, the
+	 * UART bit length is set from protocol_trigger_baudrate */
+	pv::devices::ProtocolTrigger protocol_trigger;
+	double protocol_trigger_baudrate;
+	void configureStreamTrigger();
+	void restoreHWTriggers();
+	void updateSpill();
 	long long maxSamplingFrequency;
 	void configureMaxSampleRate();
 	static const unsigned long maxTriggerBufferSize;
@@ -299,8 +365,22 @@ private:
 	ExportSettings *exportSettings;
 	QMap<int, bool> exportConfig;
 	void init_export_settings();
-	bool exportTabCsv(QString separator, QString);
-	bool exportVCD(QString, QString, QString);
+	/* Both run on an export worker, they stream the segment to the
+	 * file in blocks and report the samples done to progress */
+	static bool exportTabCsv(QString separator, QString filename,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		std::vector<unsigned int> channels,
+		const FileManager::WriteProgress &progress);
+	static bool exportVCD(QString filename, QString startSep, QString endSep,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		std::vector<unsigned int> channels,
+		const FileManager::WriteProgress &progress);
+	/* A compressed archive of the capture, loaded back decoded */
+	static bool saveArchive(QString filename,
+		std::shared_ptr<pv::data::LogicSegment> segment,
+		const FileManager::WriteProgress &progress);
+	static std::shared_ptr<pv::data::LogicSegment> loadArchive(
+		const QString &path);
 	void init_buffer_scrolling();
 	void triggerRightMenuToggle(CustomPushButton *btn, bool checked);
 };
@@ -26,6 +26,9 @@
 #include <pulseview/pv/data/logicsegment.hpp>
 #include <pulseview/pv/data/logic.hpp>
 
+#include <algorithm>
+#include <cstring>
+
 namespace adiscope {
 /*
  * class LogicAnalyzer_API
@@ -42,6 +45,16 @@ void LogicAnalyzer_API::show()
         Q_EMIT lga->showTool();
 }
 
+bool LogicAnalyzer_API::saveCapture(const QString &path)
+{
+	return lga->saveCapture(path);
+}
+
+bool LogicAnalyzer_API::loadCapture(const QString &path)
+{
+	return lga->loadCapture(path);
+}
+
 bool LogicAnalyzer_API::running() const
 {
 	return lga->ui->btnRunStop->isChecked();
@@ -220,6 +233,151 @@ void LogicAnalyzer_API::setExportAll(bool en)
 	lga->exportSettings->getExportAllButton()->setChecked(en);
 }
 
+bool LogicAnalyzer_API::compressedStorage() const
+{
+	return lga->main_win->session_.is_logic_compression();
+}
+
+void LogicAnalyzer_API::setCompressedStorage(bool en)
+{
+	lga->main_win->session_.set_logic_compression(en);
+}
+
+bool LogicAnalyzer_API::deepCapture() const
+{
+	return lga->deepCapture();
+}
+
+void LogicAnalyzer_API::setDeepCapture(bool en)
+{
+	lga->setDeepCapture(en);
+}
+
+QString LogicAnalyzer_API::spillDirectory() const
+{
+	return lga->spillDirectory();
+}
+
+void LogicAnalyzer_API::setSpillDirectory(const QString &dir)
+{
+	lga->setSpillDirectory(dir);
+}
+
+double LogicAnalyzer_API::decodeHorizon() const
+{
+	return lga->main_win->session_.get_decode_horizon();
+}
+
+void LogicAnalyzer_API::setDecodeHorizon(double seconds)
+{
+	lga->main_win->session_.set_decode_horizon(seconds);
+}
+
+int LogicAnalyzer_API::streamPretrigger() const
+{
+	return lga->streamPretrigger();
+}
+
+void LogicAnalyzer_API::setStreamPretrigger(int samples)
+{
+	lga->setStreamPretrigger(std::max(samples, 0));
+}
+
+QVariantMap LogicAnalyzer_API::captureTime() const
+{
+	QVariantMap map;
+	uint64_t time, sample;
+
+	if (lga->captureTime(time, sample)) {
+		map["time"] = (qulonglong)time;
+		map["sample"] = (qulonglong)sample;
+	}
+
+	return map;
+}
+
+static const QStringList protocol_trigger_types = {
+	"none", "uart", "i2c", "spi",
+};
+
+QString LogicAnalyzer_API::protocolTrigger() const
+{
+	return protocol_trigger_types[lga->protocol_trigger.type];
+}
+
+void LogicAnalyzer_API::setProtocolTrigger(const QString &type)
+{
+	int index = protocol_trigger_types.indexOf(type.toLower());
+
+	lga->protocol_trigger.type = (pv::devices::ProtocolTrigger::Type)
+		std::max(index, 0);
+}
+
+QList<int> LogicAnalyzer_API::protocolTriggerChannels() const
+{
+	const int *channels = lga->protocol_trigger.channels;
+
+	return QList<int>() << channels[0] << channels[1] << channels[2];
+}
+
+void LogicAnalyzer_API::setProtocolTriggerChannels(const QList<int> &channels)
+{
+	for (int i = 0; i < 3; i++) {
+		lga->protocol_trigger.channels[i] =
+			i < channels.size() ? channels[i] : -1;
+	}
+}
+
+int LogicAnalyzer_API::protocolTriggerValue() const
+{
+	return lga->protocol_trigger.value;
+}
+
+void LogicAnalyzer_API::setProtocolTriggerValue(int value)
+{
+	lga->protocol_trigger.value = value;
+}
+
+int LogicAnalyzer_API::protocolTriggerMask() const
+{
+	return lga->protocol_trigger.mask;
+}
+
+void LogicAnalyzer_API::setProtocolTriggerMask(int mask)
+{
+	lga->protocol_trigger.mask = mask;
+}
+
+int LogicAnalyzer_API::protocolTriggerBits() const
+{
+	return lga->protocol_trigger.bits;
+}
+
+void LogicAnalyzer_API::setProtocolTriggerBits(int bits)
+{
+	lga->protocol_trigger.bits = std::max(1, std::min(bits, 32));
+}
+
+double LogicAnalyzer_API::protocolTriggerBaudrate() const
+{
+	return lga->protocol_trigger_baudrate;
+}
+
+void LogicAnalyzer_API::setProtocolTriggerBaudrate(double baudrate)
+{
+	lga->protocol_trigger_baudrate = baudrate;
+}
+
+bool LogicAnalyzer_API::protocolTriggerRisingEdge() const
+{
+	return lga->protocol_trigger.rising_edge;
+}
+
+void LogicAnalyzer_API::setProtocolTriggerRisingEdge(bool en)
+{
+	lga->protocol_trigger.rising_edge = en;
+}
+
 void LogicAnalyzer_API::load(QSettings &s)
 {
 	lga->apiLoading = true;
@@ -430,11 +588,74 @@ QList<int> LogicAnalyzer_API::data() const
 		std::shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
 		if(!segment)
 			return list;
-		for (unsigned int i = 0; i < segment->get_sample_count(); ++i) {
-			uint64_t sample = segment->get_sample(i);
-			list.append((int)sample);
-		}
+
+		const unsigned int us = std::min(segment->unit_size(), 4u);
+		const uint64_t total = segment->get_sample_count();
+
+		list.reserve(total);
+		segment->for_each_chunk(0, total, [&](const uint8_t *data,
+				uint64_t, uint64_t count) {
+			const unsigned int step = segment->unit_size();
+
+			for (uint64_t k = 0; k < count; k++) {
+				uint32_t sample = 0;
+				memcpy(&sample, data + k * step, us);
+				list.append((int)sample);
+			}
+			return true;
+		});
 	}
 	return list;
 }
+
+QByteArray LogicAnalyzer_API::dataBuffer(qint64 offset, qint64 length) const
+{
+	QByteArray buffer;
+
+	std::shared_ptr<pv::data::Logic> logic_data = lga->main_win->session_.get_logic_data();
+	if (!logic_data || logic_data->logic_segments().empty())
+		return buffer;
+
+	std::shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
+	if (!segment || !dataWindow(segment->get_sample_count(), offset, length))
+		return buffer;
+
+	buffer.resize(length * segment->unit_size());
+	segment->get_samples(reinterpret_cast<uint8_t *>(buffer.data()),
+			     offset, offset + length);
+	return buffer;
+}
+
+QByteArray LogicAnalyzer_API::channelBits(int channel, qint64 offset,
+		qint64 length) const
+{
+	QByteArray buffer;
+
+	std::shared_ptr<pv::data::Logic> logic_data = lga->main_win->session_.get_logic_data();
+	if (!logic_data || logic_data->logic_segments().empty() || channel < 0)
+		return buffer;
+
+	std::shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
+	if (!segment || !dataWindow(segment->get_sample_count(), offset, length))
+		return buffer;
+
+	std::vector< std::vector<uint64_t> > planes;
+	segment->get_bit_planes(planes, { (unsigned int)channel },
+				offset, offset + length);
+
+	/* The words are little endian, so bit n % 8 of byte n / 8 */
+	buffer.resize((length + 7) / 8);
+	memcpy(buffer.data(), planes[0].data(), buffer.size());
+	return buffer;
+}
+
+int LogicAnalyzer_API::unitSize() const
+{
+	std::shared_ptr<pv::data::Logic> logic_data = lga->main_win->session_.get_logic_data();
+	if (!logic_data || logic_data->logic_segments().empty())
+		return 0;
+
+	std::shared_ptr<pv::data::LogicSegment> segment = logic_data->logic_segments().front();
+	return segment ? segment->unit_size() : 0;
+}
 }
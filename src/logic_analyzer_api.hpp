@@ -42,7 +42,34 @@ class LogicAnalyzer_API : public ApiObject
 	Q_PROPERTY(bool cursors_locked READ cursorsLocked WRITE setCursorsLocked)
 	Q_PROPERTY(bool inactive_hidden READ inactiveHidden WRITE setInactiveHidden)
 	Q_PROPERTY(bool export_all READ getExportAll WRITE setExportAll)
+	Q_PROPERTY(bool compressed_storage READ compressedStorage
+			WRITE setCompressedStorage)
+	Q_PROPERTY(bool deep_capture READ deepCapture WRITE setDeepCapture)
+	Q_PROPERTY(QString spill_directory READ spillDirectory
+			WRITE setSpillDirectory)
+	Q_PROPERTY(double decode_horizon READ decodeHorizon
+			WRITE setDecodeHorizon)
+	Q_PROPERTY(int stream_pretrigger READ streamPretrigger
+			WRITE setStreamPretrigger)
+	Q_PROPERTY(QString protocol_trigger READ protocolTrigger
+			WRITE setProtocolTrigger)
+	Q_PROPERTY(QList<int> protocol_trigger_channels
+			READ protocolTriggerChannels
+			WRITE setProtocolTriggerChannels)
+	Q_PROPERTY(int protocol_trigger_value READ protocolTriggerValue
+			WRITE setProtocolTriggerValue)
+	Q_PROPERTY(int protocol_trigger_mask READ protocolTriggerMask
+			WRITE setProtocolTriggerMask)
+	Q_PROPERTY(int protocol_trigger_bits READ protocolTriggerBits
+			WRITE setProtocolTriggerBits)
+	Q_PROPERTY(double protocol_trigger_baudrate
+			READ protocolTriggerBaudrate
+			WRITE setProtocolTriggerBaudrate)
+	Q_PROPERTY(bool protocol_trigger_rising_edge
+			READ protocolTriggerRisingEdge
+			WRITE setProtocolTriggerRisingEdge)
 	Q_PROPERTY(QList<int> data READ data STORED false)
+	Q_PROPERTY(QVariantMap capture_time READ captureTime STORED false)
 
 public:
 	explicit LogicAnalyzer_API(LogicAnalyzer *lga) :
@@ -92,9 +119,59 @@ public:
 	bool getExportAll() const;
 	void setExportAll(bool);
 
+	bool compressedStorage() const;
+	void setCompressedStorage(bool en);
+
+	bool deepCapture() const;
+	void setDeepCapture(bool en);
+
+	QString spillDirectory() const;
+	void setSpillDirectory(const QString &dir);
+
+	double decodeHorizon() const;
+	void setDecodeHorizon(double seconds);
+
+	int streamPretrigger() const;
+	void setStreamPretrigger(int samples);
+
+	/* Acquisition time (ns) and first sample index of the last
+	 * buffer read; empty before the first one */
+	QVariantMap captureTime() const;
+
+	/* "none", "uart", "i2c" or "spi" */
+	QString protocolTrigger() const;
+	void setProtocolTrigger(const QString &type);
+	QList<int> protocolTriggerChannels() const;
+	void setProtocolTriggerChannels(const QList<int> &channels);
+	int protocolTriggerValue() const;
+	void setProtocolTriggerValue(int value);
+	int protocolTriggerMask() const;
+	void setProtocolTriggerMask(int mask);
+	int protocolTriggerBits() const;
+	void setProtocolTriggerBits(int bits);
+	double protocolTriggerBaudrate() const;
+	void setProtocolTriggerBaudrate(double baudrate);
+	bool protocolTriggerRisingEdge() const;
+	void setProtocolTriggerRisingEdge(bool en);
+
 	Q_INVOKABLE void show();
+	Q_INVOKABLE bool saveCapture(const QString &path);
+	Q_INVOKABLE bool loadCapture(const QString &path);
 
 	QList<int> data() const;
+
+	/* The raw samples of the capture as an ArrayBuffer, one bit per
+	 * channel in samples of unitSize() bytes (an Uint16Array for the
+	 * M2K's 16 channels) */
+	Q_INVOKABLE QByteArray dataBuffer(qint64 offset = 0,
+			qint64 length = -1) const;
+	Q_INVOKABLE int unitSize() const;
+
+	/* The samples of one channel packed 8 per byte, sample n at bit
+	 * n % 8 of byte n / 8 */
+	Q_INVOKABLE QByteArray channelBits(int channel, qint64 offset = 0,
+			qint64 length = -1) const;
+
 	void load(QSettings &s);
 
 private:
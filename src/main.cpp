@@ -28,9 +28,12 @@
 #include <QFontDatabase>
 #include <QTranslator>
 #include <QLocale>
+#include <QTimer>
 #include "config.h"
 #include "tool_launcher.hpp"
 #include "scopyApplication.hpp"
+#include "startup_trace.hpp"
+#include "replay_file.hpp"
 #include <stdio.h>
 
 
@@ -38,6 +41,8 @@ using namespace adiscope;
 
 int main(int argc, char **argv)
 {
+	StartupTrace::phase("Starting");
+
 #if BREAKPAD_HANDLER
 #ifdef Q_OS_LINUX
 	google_breakpad::MinidumpDescriptor descriptor("/tmp");
@@ -60,6 +65,7 @@ int main(int argc, char **argv)
 #else
 	QApplication app(argc, argv);
 #endif
+	StartupTrace::phase("Application");
 
 	QFontDatabase::addApplicationFont(":/open-sans-regular.ttf");
 	QFont font("Open Sans");
@@ -72,6 +78,7 @@ int main(int argc, char **argv)
 		QString stylesheet = QString::fromLatin1(file.readAll());
 		app.setStyleSheet(stylesheet);
 	}
+	StartupTrace::phase("Fonts and style sheet");
 
 	auto pythonpath = qgetenv("SCOPY_PYTHONPATH");
 	if (!pythonpath.isNull())
@@ -97,13 +104,23 @@ int main(int argc, char **argv)
 
 	parser.addOptions({
 		{ {"s", "script"}, "Run given script.", "script" },
+		{ {"t", "thread"}, "Run the script on its own thread, reaching the tools through the scopy object." },
 		{ {"n", "nogui"}, "Run Scopy without GUI" },
 		{ {"d", "nodecoders"}, "Run Scopy without digital decoders"},
-		{ {"nd", "nonativedialog"}, "Run Scopy without native file dialogs"}
+		{ {"nd", "nonativedialog"}, "Run Scopy without native file dialogs"},
+		{ {"p", "port"}, "Accept remote scripts on the given local TCP port.", "port" },
+		{ "replay-adc", "Play the raw ADC samples of the given file instead of the device's.", "file" },
+		{ "replay-logic", "Play the raw logic analyzer samples of the given file instead of the device's.", "file" },
+		{ "replay-speed", "Replay at the given multiple of the sample rate, 0 as fast as possible (default 1).", "speed" }
 	});
 
 	parser.process(app);
 
+	ReplayFile::setPath(ReplayFile::ADC, parser.value("replay-adc"));
+	ReplayFile::setPath(ReplayFile::LOGIC, parser.value("replay-logic"));
+	if (parser.isSet("replay-speed"))
+		ReplayFile::setSpeed(parser.value("replay-speed").toDouble());
+
 	QTranslator myappTranslator;
 
 	// TODO: Use Preferences_API to get language key - cannot be done right now
@@ -130,8 +147,10 @@ int main(int argc, char **argv)
 
 	myappTranslator.load(languageFileName);
 	app.installTranslator(&myappTranslator);
+	StartupTrace::phase("Translations");
 
 	ToolLauncher launcher(prevCrashDump);
+	StartupTrace::phase("Tool launcher");
 
 	bool nogui = parser.isSet("nogui");
 	bool nodecoders = parser.isSet("nodecoders");
@@ -146,12 +165,28 @@ int main(int argc, char **argv)
 	qDebug() << "Using" << (nonativedialog ? "Qt" : "Native") << "file dialogs";
 	launcher.setNativeDialogs(!nonativedialog);
 
+	if (parser.isSet("port")) {
+		bool ok = false;
+		quint16 port = parser.value("port").toUShort(&ok);
+		if (!ok || !launcher.listenForScripts(port)) {
+			qCritical() << "Unable to accept remote scripts on port"
+				    << parser.value("port");
+			return EXIT_FAILURE;
+		}
+	}
+
 	QString script = parser.value("script");
 	if (nogui) {
 		launcher.hide();
 	} else {
 		launcher.show();
 	}
+	StartupTrace::phase("Window shown");
+
+	QTimer::singleShot(0, []() {
+		StartupTrace::phase("First event loop pass");
+	});
+
 	if (!script.isEmpty()) {
 		QFile file(script);
 		if (!file.open(QFile::ReadOnly)) {
@@ -169,7 +204,8 @@ int main(int argc, char **argv)
 		file.close();
 
 		QMetaObject::invokeMethod(&launcher,
-				 "runProgram",
+				 parser.isSet("thread") ?
+				 "runProgramThreaded" : "runProgram",
 				 Qt::QueuedConnection,
 				 Q_ARG(QString, contents),
 				 Q_ARG(QString, script));
@@ -0,0 +1,432 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mapped_reference.hpp"
+#include "filemanager.h"
+
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+using namespace adiscope;
+
+namespace {
+const uint32_t mipmap_version = 1;
+const uint32_t byte_order_mark = 0x01020304;
+
+struct MipmapHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t factor;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint64_t rows;
+	uint32_t columns;
+	uint32_t byte_order;
+};
+
+/* Plot data of one column, the x values computed from the start */
+class MappedReferenceData : public UniformSampledData
+{
+public:
+	MappedReferenceData(std::shared_ptr<const MappedReference> ref,
+			    int column, double start, double step) :
+		UniformSampledData(nullptr, ref->rows(), start, step),
+		d_ref(ref), d_column(column),
+		d_pyramid(ref->pyramid(column))
+	{
+	}
+
+	virtual QPointF sample(size_t i) const
+	{
+		return QPointF(xStart() + i * xStep(), d_ref->value(i, d_column));
+	}
+
+	/* The top of the pyramid already has the extent of the samples */
+	virtual QRectF boundingRect() const
+	{
+		size_t levels = d_pyramid->levels();
+		if (!levels) {
+			return QRectF(0.0, 0.0, -1.0, -1.0);
+		}
+
+		double min, max;
+		d_pyramid->entry(levels - 1, 0, min, max);
+
+		return QRectF(xStart(), min, (size() - 1) * xStep(), max - min);
+	}
+
+private:
+	std::shared_ptr<const MappedReference> d_ref;
+	int d_column;
+	std::shared_ptr<const MinMaxPyramid> d_pyramid;
+};
+}
+
+class MappedReference::ColumnPyramid : public MinMaxPyramid
+{
+public:
+	ColumnPyramid(std::shared_ptr<const MappedReference> ref,
+		      const float *base, const std::vector<size_t> &sizes) :
+		d_ref(ref), d_base(base), d_sizes(sizes)
+	{
+		size_t offset = 0;
+
+		for (size_t size : sizes) {
+			d_offsets.push_back(offset);
+			offset += size;
+		}
+	}
+
+	size_t levels() const { return d_sizes.size(); }
+	size_t levelSize(size_t level) const { return d_sizes[level]; }
+
+	void entry(size_t level, size_t index, double &min, double &max) const
+	{
+		const float *mm = d_base + 2 * (d_offsets[level] + index);
+
+		min = mm[0];
+		max = mm[1];
+	}
+
+private:
+	std::shared_ptr<const MappedReference> d_ref;
+	const float *d_base;
+	std::vector<size_t> d_sizes;
+	std::vector<size_t> d_offsets;
+};
+
+MappedReference::MappedReference(const QString &filename) :
+	d_filename(filename),
+	d_rows(0),
+	d_columns(0),
+	d_fortran(false),
+	d_double(false),
+	d_f4(nullptr),
+	d_f8(nullptr),
+	d_metadata(false),
+	d_sample_rate(0),
+	d_pyramids(nullptr)
+{
+	if (filename.isEmpty()) {
+		throw FileManagerException("No file selected");
+	}
+
+	d_file.setFileName(filename);
+	if (!d_file.open(QIODevice::ReadOnly)) {
+		throw FileManagerException("Can't open selected file");
+	}
+
+	parseHeader();
+	readMetadata();
+	loadPyramids();
+}
+
+MappedReference::~MappedReference()
+{
+}
+
+bool MappedReference::isMappedReference(const QString &filename)
+{
+	return filename.endsWith(".npy");
+}
+
+size_t MappedReference::rows() const
+{
+	return d_rows;
+}
+
+int MappedReference::columns() const
+{
+	return d_columns;
+}
+
+double MappedReference::sampleRate() const
+{
+	return d_sample_rate;
+}
+
+bool MappedReference::hasXColumn() const
+{
+	return d_metadata;
+}
+
+QString MappedReference::columnName(int column) const
+{
+	return column < d_names.size() ? d_names[column] : QString();
+}
+
+void MappedReference::parseHeader()
+{
+	qint64 size = d_file.size();
+	const uchar *map = size >= 10 ? d_file.map(0, size) : nullptr;
+
+	if (!map || memcmp(map, "\x93NUMPY", 6)) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	/* Version 1 has a 16 bit header length, the later ones 32 bit */
+	size_t start = map[6] == 1 ? 10 : 12;
+	if ((qint64)start > size) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	size_t header_len = map[6] == 1 ? qFromLittleEndian<quint16>(map + 8)
+		: qFromLittleEndian<quint32>(map + 8);
+	if ((qint64)(start + header_len) > size) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	QString dict = QString::fromLatin1(
+			reinterpret_cast<const char *>(map + start), header_len);
+	QRegularExpressionMatch descr = QRegularExpression(
+			"'descr'\\s*:\\s*'[<|=]?(f4|f8)'").match(dict);
+	QRegularExpressionMatch order = QRegularExpression(
+			"'fortran_order'\\s*:\\s*(True|False)").match(dict);
+	QRegularExpressionMatch shape = QRegularExpression(
+			"'shape'\\s*:\\s*\\(\\s*(\\d+)\\s*,?\\s*(\\d*)\\s*,?\\s*\\)")
+		.match(dict);
+
+	/* Little endian floats only, as 2D arrays at most */
+	if (!descr.hasMatch() || !order.hasMatch() || !shape.hasMatch() ||
+			(Q_BYTE_ORDER != Q_LITTLE_ENDIAN)) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	d_double = descr.captured(1) == "f8";
+	d_fortran = order.captured(1) == "True";
+	d_rows = shape.captured(1).toULongLong();
+	d_columns = shape.captured(2).isEmpty() ? 1 :
+		shape.captured(2).toInt();
+
+	size_t element = d_double ? sizeof(double) : sizeof(float);
+	size_t offset = start + header_len;
+
+	if (d_columns <= 0 || offset % element ||
+			(qint64)(offset + d_rows * d_columns * element) > size) {
+		throw FileManagerException("File is corrupted!");
+	}
+
+	d_f4 = reinterpret_cast<const float *>(map + offset);
+	d_f8 = reinterpret_cast<const double *>(map + offset);
+}
+
+void MappedReference::readMetadata()
+{
+	QFileInfo info(d_filename);
+	QFile sidecar(info.path() + "/" + info.completeBaseName() + ".json");
+
+	for (int i = 0; i < d_columns; i++) {
+		d_names.push_back(QString::number(i));
+	}
+
+	if (!sidecar.open(QIODevice::ReadOnly)) {
+		return;
+	}
+
+	QJsonObject root = QJsonDocument::fromJson(sidecar.readAll()).object();
+	if (root.isEmpty()) {
+		return;
+	}
+
+	d_metadata = true;
+	d_sample_rate = root["sample_rate"].toDouble();
+
+	QJsonArray cols = root["columns"].toArray();
+	for (int i = 0; i < cols.size() && i < d_columns; i++) {
+		d_names[i] = cols[i].toObject()["name"].toString();
+	}
+}
+
+std::vector<size_t> MappedReference::levelSizes() const
+{
+	const size_t factor = MinMaxPlotCurve::PyramidFactor;
+	std::vector<size_t> sizes;
+
+	if (!d_rows) {
+		return sizes;
+	}
+
+	sizes.push_back((d_rows + factor - 1) / factor);
+	while (sizes.back() > 1) {
+		sizes.push_back((sizes.back() + factor - 1) / factor);
+	}
+
+	return sizes;
+}
+
+void MappedReference::loadPyramids()
+{
+	d_cache.setFileName(d_filename + ".mipmap");
+
+	if (d_cache.open(QIODevice::ReadOnly) && mapPyramids(d_cache)) {
+		return;
+	}
+	d_cache.close();
+
+	std::vector<size_t> sizes = levelSizes();
+	size_t entries = 0;
+	for (size_t size : sizes) {
+		entries += size;
+	}
+
+	d_pyramids_storage.resize(2 * entries * d_columns);
+	buildPyramids(d_pyramids_storage.data());
+	d_pyramids = d_pyramids_storage.data();
+
+	/* Mapped instead on the next import */
+	QFileInfo info(d_file);
+	MipmapHeader header;
+	memcpy(header.magic, "SCOPYMIP", sizeof(header.magic));
+	header.version = mipmap_version;
+	header.factor = MinMaxPlotCurve::PyramidFactor;
+	header.source_size = d_file.size();
+	header.source_mtime = info.lastModified().toMSecsSinceEpoch();
+	header.rows = d_rows;
+	header.columns = d_columns;
+	header.byte_order = byte_order_mark;
+
+	QFile cache(d_cache.fileName());
+	qint64 bytes = d_pyramids_storage.size() * sizeof(float);
+
+	if (!cache.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return;
+	}
+
+	if (cache.write(reinterpret_cast<const char *>(&header),
+			sizeof(header)) != sizeof(header) ||
+			cache.write(reinterpret_cast<const char *>(d_pyramids),
+				    bytes) != bytes) {
+		cache.close();
+		cache.remove();
+	}
+}
+
+bool MappedReference::mapPyramids(QFile &cache)
+{
+	std::vector<size_t> sizes = levelSizes();
+	size_t entries = 0;
+	for (size_t size : sizes) {
+		entries += size;
+	}
+
+	qint64 size = sizeof(MipmapHeader) +
+		2 * entries * d_columns * sizeof(float);
+	if (cache.size() != size) {
+		return false;
+	}
+
+	const uchar *map = cache.map(0, size);
+	if (!map) {
+		return false;
+	}
+
+	MipmapHeader header;
+	memcpy(&header, map, sizeof(header));
+
+	QFileInfo info(d_file);
+	if (memcmp(header.magic, "SCOPYMIP", sizeof(header.magic)) ||
+			header.version != mipmap_version ||
+			header.factor != MinMaxPlotCurve::PyramidFactor ||
+			header.source_size != (uint64_t)d_file.size() ||
+			header.source_mtime !=
+				info.lastModified().toMSecsSinceEpoch() ||
+			header.rows != d_rows ||
+			header.columns != (uint32_t)d_columns ||
+			header.byte_order != byte_order_mark) {
+		cache.unmap(const_cast<uchar *>(map));
+		return false;
+	}
+
+	d_pyramids = reinterpret_cast<const float *>(map + sizeof(header));
+
+	return true;
+}
+
+void MappedReference::buildPyramids(float *out) const
+{
+	/* Same pyramid as MinMaxPlotCurve builds, kept as float pairs */
+	const size_t factor = MinMaxPlotCurve::PyramidFactor;
+	std::vector<size_t> sizes = levelSizes();
+
+	for (int c = 0; c < d_columns; c++) {
+		float *level = out;
+
+		for (size_t b = 0; sizes.size() && b < sizes[0]; b++) {
+			size_t begin = b * factor;
+			size_t end = std::min(begin + factor, d_rows);
+			double min = value(begin, c), max = min;
+
+			for (size_t i = begin + 1; i < end; i++) {
+				double y = value(i, c);
+				min = std::min(min, y);
+				max = std::max(max, y);
+			}
+
+			*out++ = min;
+			*out++ = max;
+		}
+
+		for (size_t l = 1; l < sizes.size(); l++) {
+			const float *prev = level;
+			level = out;
+
+			for (size_t b = 0; b < sizes[l]; b++) {
+				size_t begin = b * factor;
+				size_t end = std::min(begin + factor, sizes[l - 1]);
+				float min = prev[2 * begin], max = prev[2 * begin + 1];
+
+				for (size_t i = begin + 1; i < end; i++) {
+					min = std::min(min, prev[2 * i]);
+					max = std::max(max, prev[2 * i + 1]);
+				}
+
+				*out++ = min;
+				*out++ = max;
+			}
+		}
+	}
+}
+
+std::shared_ptr<const MinMaxPyramid> MappedReference::pyramid(int column) const
+{
+	std::vector<size_t> sizes = levelSizes();
+	size_t entries = 0;
+	for (size_t size : sizes) {
+		entries += size;
+	}
+
+	return std::make_shared<ColumnPyramid>(shared_from_this(),
+			d_pyramids + 2 * entries * column, sizes);
+}
+
+UniformSampledData *MappedReference::seriesData(int column, double start,
+		double step) const
+{
+	return new MappedReferenceData(shared_from_this(), column, start, step);
+}
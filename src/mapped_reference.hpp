@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPED_REFERENCE_HPP
+#define MAPPED_REFERENCE_HPP
+
+#include <QFile>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <vector>
+
+#include "TimeDomainDisplayPlot.h"
+#include "minmaxplotcurve.h"
+
+namespace adiscope {
+
+/*
+ * Reference waveforms read in place from a NumPy .npy file (float32 or
+ * float64, one column per waveform) such as the ones FileManager
+ * exports, with the sample rate and column names of the .json written
+ * next to it when there is one.
+ *
+ * The min/max pyramid of every column is computed once and cached in
+ * <file>.mipmap, mapped as well on the next imports, so reopening the
+ * same references costs neither a pass over the samples nor a copy of
+ * them. The cache is rebuilt when the file changes; if it can't be
+ * written the pyramid is only kept in memory.
+ *
+ * Errors are reported as FileManagerException, like the text imports.
+ */
+class MappedReference : public std::enable_shared_from_this<MappedReference>
+{
+public:
+	/* Only through std::make_shared, the plot data shares it */
+	explicit MappedReference(const QString &filename);
+	~MappedReference();
+
+	static bool isMappedReference(const QString &filename);
+
+	size_t rows() const;
+	int columns() const;
+
+	/* 0 when the file has no metadata */
+	double sampleRate() const;
+	/* Column 0 holds the x values (time, frequency) when the file
+	 * has metadata, as in the Scopy text files */
+	bool hasXColumn() const;
+	QString columnName(int column) const;
+
+	double value(size_t row, int column) const
+	{
+		size_t index = d_fortran ? column * d_rows + row
+			: row * d_columns + column;
+
+		return d_double ? d_f8[index] : d_f4[index];
+	}
+
+	std::shared_ptr<const MinMaxPyramid> pyramid(int column) const;
+
+	/* The samples of a column as plot data, which keeps the file
+	 * mapped */
+	UniformSampledData *seriesData(int column, double start,
+				       double step) const;
+
+private:
+	class ColumnPyramid;
+
+	void parseHeader();
+	void readMetadata();
+	void loadPyramids();
+	bool mapPyramids(QFile &cache);
+	void buildPyramids(float *out) const;
+	std::vector<size_t> levelSizes() const;
+
+	QString d_filename;
+	QFile d_file;
+	QFile d_cache;
+	size_t d_rows;
+	int d_columns;
+	bool d_fortran;
+	bool d_double;
+	const float *d_f4;
+	const double *d_f8;
+
+	bool d_metadata;
+	double d_sample_rate;
+	QStringList d_names;
+
+	/* min, max pairs, every level of column 0, then of column 1... */
+	const float *d_pyramids;
+	std::vector<float> d_pyramids_storage;
+};
+}
+
+#endif /* MAPPED_REFERENCE_HPP */
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mask_test.h"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace adiscope;
+
+/* Samples compared before looking for where a violation was */
+#define MASK_BLOCK_SIZE 256
+
+MaskTest::MaskTest(unsigned int pool_size) :
+	d_has_mask(false),
+	d_learn(false),
+	d_learn_dx(0),
+	d_pool(std::max(pool_size, 1u)),
+	d_quit(false),
+	d_enabled(false),
+	d_stop_on_failure(false),
+	d_halted(false),
+	d_passed(0),
+	d_failed(0),
+	d_skipped(0),
+	d_failure_channel(-1),
+	d_failure_sample(-1)
+{
+	for (unsigned int i = 0; i < d_pool.size(); i++) {
+		d_free.push_back(i);
+	}
+
+	d_worker = std::thread(&MaskTest::_work, this);
+}
+
+MaskTest::~MaskTest()
+{
+	{
+		std::unique_lock<std::mutex> lock(d_queue_mutex);
+		d_quit = true;
+	}
+	d_queue_cond.notify_all();
+	d_worker.join();
+}
+
+void MaskTest::setMask(unsigned int channel, const std::vector<float> &lower,
+		const std::vector<float> &upper)
+{
+	std::unique_lock<std::mutex> lock(d_mask_mutex);
+	size_t size = std::min(lower.size(), upper.size());
+
+	if (d_masks.size() <= channel) {
+		d_masks.resize(channel + 1);
+	}
+
+	d_masks[channel].lower.assign(lower.begin(), lower.begin() + size);
+	d_masks[channel].upper.assign(upper.begin(), upper.begin() + size);
+
+	d_has_mask = std::any_of(d_masks.begin(), d_masks.end(),
+			[](const Envelope &env) { return !env.lower.empty(); });
+}
+
+void MaskTest::clearMask()
+{
+	std::unique_lock<std::mutex> lock(d_mask_mutex);
+
+	d_masks.clear();
+	d_has_mask = false;
+}
+
+bool MaskTest::hasMask() const
+{
+	return d_has_mask;
+}
+
+bool MaskTest::mask(unsigned int channel, std::vector<float> &lower,
+		std::vector<float> &upper) const
+{
+	std::unique_lock<std::mutex> lock(d_mask_mutex);
+
+	if (channel >= d_masks.size() || d_masks[channel].lower.empty()) {
+		return false;
+	}
+
+	lower = d_masks[channel].lower;
+	upper = d_masks[channel].upper;
+	return true;
+}
+
+void MaskTest::envelopes(const float *ref, size_t nitems, unsigned int dx,
+		float dy, std::vector<float> &lower, std::vector<float> &upper)
+{
+	lower.resize(nitems);
+	upper.resize(nitems);
+
+	for (size_t i = 0; i < nitems; i++) {
+		size_t first = i > dx ? i - dx : 0;
+		size_t last = std::min(i + dx + 1, nitems);
+		auto range = std::minmax_element(ref + first, ref + last);
+
+		lower[i] = *range.first - dy;
+		upper[i] = *range.second + dy;
+	}
+}
+
+void MaskTest::learn(unsigned int dx, const std::vector<float> &dy)
+{
+	{
+		std::unique_lock<std::mutex> lock(d_mask_mutex);
+		d_learn_dx = dx;
+		d_learn_dy = dy;
+	}
+	d_learn = true;
+}
+
+bool MaskTest::learning() const
+{
+	return d_learn;
+}
+
+void MaskTest::_learn(const Frame &frame)
+{
+	std::unique_lock<std::mutex> lock(d_mask_mutex);
+
+	d_masks.assign(frame.nchannels, Envelope());
+
+	for (unsigned int n = 0; n < frame.nchannels &&
+			n < d_learn_dy.size(); n++) {
+		if (d_learn_dy[n] < 0) {
+			continue;
+		}
+
+		envelopes(&frame.samples[(size_t)n * frame.nitems],
+				frame.nitems, d_learn_dx, d_learn_dy[n],
+				d_masks[n].lower, d_masks[n].upper);
+	}
+
+	d_has_mask = std::any_of(d_masks.begin(), d_masks.end(),
+			[](const Envelope &env) { return !env.lower.empty(); });
+}
+
+void MaskTest::setEnabled(bool enabled)
+{
+	d_enabled = enabled;
+}
+
+bool MaskTest::isEnabled() const
+{
+	return d_enabled;
+}
+
+void MaskTest::setStopOnFailure(bool stop)
+{
+	d_stop_on_failure = stop;
+}
+
+bool MaskTest::stopOnFailure() const
+{
+	return d_stop_on_failure;
+}
+
+void MaskTest::setFailureCallback(const std::function<void()> &callback)
+{
+	d_failure_callback = callback;
+}
+
+bool MaskTest::halted() const
+{
+	return d_halted;
+}
+
+void MaskTest::resetCounters()
+{
+	d_passed = 0;
+	d_failed = 0;
+	d_skipped = 0;
+	d_failure_channel = -1;
+	d_failure_sample = -1;
+	d_halted = false;
+}
+
+uint64_t MaskTest::passed() const
+{
+	return d_passed;
+}
+
+uint64_t MaskTest::failed() const
+{
+	return d_failed;
+}
+
+uint64_t MaskTest::skipped() const
+{
+	return d_skipped;
+}
+
+int MaskTest::lastFailureChannel() const
+{
+	return d_failure_channel;
+}
+
+int MaskTest::lastFailureSample() const
+{
+	return d_failure_sample;
+}
+
+void MaskTest::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	if (nitems <= 0 || (!d_learn &&
+			(!d_enabled || !d_has_mask || d_halted))) {
+		return;
+	}
+
+	unsigned int index;
+	{
+		std::unique_lock<std::mutex> lock(d_queue_mutex);
+
+		if (d_free.empty()) {
+			d_skipped++;
+			return;
+		}
+
+		index = d_free.back();
+		d_free.pop_back();
+	}
+
+	// The worker doesn't touch a frame that isn't queued, no need to
+	// hold the lock while copying
+	Frame &frame = d_pool[index];
+	frame.nchannels = channels.size();
+	frame.nitems = nitems;
+	frame.samples.resize((size_t)frame.nchannels * nitems);
+
+	for (unsigned int n = 0; n < frame.nchannels; n++) {
+		memcpy(&frame.samples[(size_t)n * nitems], channels[n],
+				nitems * sizeof(float));
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(d_queue_mutex);
+		d_ready.push_back(index);
+	}
+	d_queue_cond.notify_one();
+}
+
+void MaskTest::_work()
+{
+	std::unique_lock<std::mutex> lock(d_queue_mutex);
+
+	while (true) {
+		d_queue_cond.wait(lock, [this]() {
+				return d_quit || !d_ready.empty(); });
+
+		if (d_quit) {
+			break;
+		}
+
+		unsigned int index = d_ready.front();
+		d_ready.pop_front();
+
+		lock.unlock();
+
+		// The reference frame itself isn't tested
+		if (d_learn.exchange(false)) {
+			_learn(d_pool[index]);
+		} else if (d_enabled && d_has_mask && !d_halted) {
+			bool pass = _test(d_pool[index]);
+
+			if (pass) {
+				d_passed++;
+			} else {
+				d_failed++;
+
+				if (d_stop_on_failure) {
+					d_halted = true;
+					if (d_failure_callback) {
+						d_failure_callback();
+					}
+				}
+			}
+		}
+
+		lock.lock();
+		d_free.push_back(index);
+	}
+}
+
+bool MaskTest::_test(const Frame &frame)
+{
+	std::unique_lock<std::mutex> lock(d_mask_mutex);
+
+	unsigned int nchannels = std::min<size_t>(frame.nchannels,
+			d_masks.size());
+
+	for (unsigned int n = 0; n < nchannels; n++) {
+		const Envelope &env = d_masks[n];
+		int nitems = std::min<size_t>(frame.nitems, env.lower.size());
+
+		if (!nitems) {
+			continue;
+		}
+
+		int sample = _first_violation(
+				&frame.samples[(size_t)n * frame.nitems],
+				env.lower.data(), env.upper.data(), nitems);
+		if (sample >= 0) {
+			d_failure_channel = n;
+			d_failure_sample = sample;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int MaskTest::_first_violation(const float *samples, const float *lower,
+		const float *upper, int nitems)
+{
+	for (int start = 0; start < nitems; start += MASK_BLOCK_SIZE) {
+		int end = std::min(start + MASK_BLOCK_SIZE, nitems);
+		int violations = 0;
+
+		// Branchless, so that the compiler can vectorize it; the
+		// block only gets scanned again when it has a violation
+		for (int i = start; i < end; i++) {
+			violations += (samples[i] < lower[i]) |
+				(samples[i] > upper[i]);
+		}
+
+		if (violations) {
+			for (int i = start; i < end; i++) {
+				if (samples[i] < lower[i] ||
+						samples[i] > upper[i]) {
+					return i;
+				}
+			}
+		}
+	}
+
+	return -1;
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASK_TEST_H
+#define MASK_TEST_H
+
+#include "frame_listener.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Go/no-go test of every frame of the time sink against tolerance masks.
+ *
+ * A mask is a lower and an upper envelope per channel, one value per
+ * sample of the frame, sample 0 being the first one of the triggered
+ * frame. A frame passes when the samples of all the masked channels are
+ * within their envelopes.
+ *
+ * The frames are copied into a small pool from the flowgraph thread and
+ * tested on a worker thread, so the acquisition never waits for the
+ * test. A frame that finds the pool full is counted as skipped.
+ */
+class MaskTest : public frame_listener
+{
+public:
+	explicit MaskTest(unsigned int pool_size = 8);
+	~MaskTest();
+
+	/* A channel without envelopes is not tested. The envelopes are
+	 * cut to the shortest of the two. */
+	void setMask(unsigned int channel, const std::vector<float> &lower,
+			const std::vector<float> &upper);
+	void clearMask();
+	bool hasMask() const;
+	bool mask(unsigned int channel, std::vector<float> &lower,
+			std::vector<float> &upper) const;
+
+	/* The envelopes around a reference frame: the min/max of the
+	 * samples within dx samples of each one, minus/plus dy */
+	static void envelopes(const float *ref, size_t nitems,
+			unsigned int dx, float dy, std::vector<float> &lower,
+			std::vector<float> &upper);
+
+	/* The masks of the next frame as envelopes() builds them, dy
+	 * being per channel; channels with a negative dy are not masked */
+	void learn(unsigned int dx, const std::vector<float> &dy);
+	bool learning() const;
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+
+	/* After the first failing frame, nothing else is tested until the
+	 * counters are reset. The callback runs on the worker thread, it
+	 * is set once, before the test is enabled. */
+	void setStopOnFailure(bool stop);
+	bool stopOnFailure() const;
+	void setFailureCallback(const std::function<void()> &callback);
+	bool halted() const;
+
+	void resetCounters();
+	uint64_t passed() const;
+	uint64_t failed() const;
+	uint64_t skipped() const;
+
+	/* Channel and sample of the first violation of the last failing
+	 * frame, -1 if none failed */
+	int lastFailureChannel() const;
+	int lastFailureSample() const;
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	struct Envelope {
+		std::vector<float> lower;
+		std::vector<float> upper;
+	};
+
+	struct Frame {
+		std::vector<float> samples;
+		unsigned int nchannels;
+		int nitems;
+	};
+
+	mutable std::mutex d_mask_mutex;
+	std::vector<Envelope> d_masks;
+	std::atomic<bool> d_has_mask;
+	std::atomic<bool> d_learn;
+	unsigned int d_learn_dx;
+	std::vector<float> d_learn_dy;
+
+	std::mutex d_queue_mutex;
+	std::condition_variable d_queue_cond;
+	std::vector<Frame> d_pool;
+	std::vector<unsigned int> d_free;
+	std::deque<unsigned int> d_ready;
+	bool d_quit;
+
+	std::atomic<bool> d_enabled;
+	std::atomic<bool> d_stop_on_failure;
+	std::atomic<bool> d_halted;
+	std::function<void()> d_failure_callback;
+
+	std::atomic<uint64_t> d_passed;
+	std::atomic<uint64_t> d_failed;
+	std::atomic<uint64_t> d_skipped;
+	std::atomic<int> d_failure_channel;
+	std::atomic<int> d_failure_sample;
+
+	std::thread d_worker;
+
+	void _work();
+	void _learn(const Frame &frame);
+	bool _test(const Frame &frame);
+
+	/* Index of the first sample outside of [lower, upper], -1 if none */
+	static int _first_violation(const float *samples, const float *lower,
+			const float *upper, int nitems);
+
+	MaskTest(const MaskTest &) = delete;
+	MaskTest &operator=(const MaskTest &) = delete;
+};
+}
+
+#endif // MASK_TEST_H
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mat_file.hpp"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QSet>
+
+#ifdef MATLAB_SUPPORT_SIGGEN
+#include <matio.h>
+#endif
+
+using namespace adiscope;
+
+const char *MatFile::sampleRateName = "sample_rate";
+
+#ifdef MATLAB_SUPPORT_SIGGEN
+namespace {
+std::mutex cache_mutex;
+QMap<QString, std::weak_ptr<MatFile>> cache;
+
+/* A valid MATLAB identifier, unique among the ones already used */
+QByteArray variable_name(const QString& name, QSet<QByteArray>& used)
+{
+	QByteArray out;
+
+	for (QChar c : name) {
+		char l = c.toLatin1();
+		bool valid = (l >= 'a' && l <= 'z') || (l >= 'A' && l <= 'Z') ||
+			(l >= '0' && l <= '9');
+		if (valid) {
+			out.append(l);
+		} else if (!out.isEmpty() && !out.endsWith('_')) {
+			out.append('_');
+		}
+	}
+
+	while (out.endsWith('_')) {
+		out.chop(1);
+	}
+	if (out.isEmpty() || (out[0] >= '0' && out[0] <= '9')) {
+		out.prepend("v");
+	}
+	out = out.left(60);
+
+	QByteArray unique = out;
+	for (int i = 2; used.contains(unique); i++) {
+		unique = out + "_" + QByteArray::number(i);
+	}
+	used.insert(unique);
+
+	return unique;
+}
+}
+#endif
+
+MatFile::MatFile() :
+	mat(nullptr),
+	size(0)
+{
+}
+
+MatFile::~MatFile()
+{
+#ifdef MATLAB_SUPPORT_SIGGEN
+	for (matvar_t *info : infos) {
+		Mat_VarFree(info);
+	}
+	if (mat) {
+		Mat_Close(mat);
+	}
+#endif
+}
+
+std::shared_ptr<MatFile> MatFile::open(const QString& path)
+{
+#ifdef MATLAB_SUPPORT_SIGGEN
+	QFileInfo info(path);
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	std::shared_ptr<MatFile> file = cache.value(path).lock();
+	if (file && file->modified == info.lastModified() &&
+			file->size == info.size()) {
+		return file;
+	}
+
+	file = std::shared_ptr<MatFile>(new MatFile());
+	if (!file->load(path)) {
+		cache.remove(path);
+		return nullptr;
+	}
+
+	file->modified = info.lastModified();
+	file->size = info.size();
+	cache.insert(path, file);
+
+	return file;
+#else
+	Q_UNUSED(path);
+	return nullptr;
+#endif
+}
+
+bool MatFile::load(const QString& path)
+{
+#ifdef MATLAB_SUPPORT_SIGGEN
+	mat = Mat_Open(path.toLocal8Bit().constData(), MAT_ACC_RDONLY);
+	if (!mat) {
+		return false;
+	}
+
+	/* Only the headers, the data is read by read() */
+	matvar_t *info;
+	while ((info = Mat_VarReadNextInfo(mat)) != NULL) {
+		Variable var;
+		var.name = QString(info->name);
+		var.rows = info->rank >= 1 ? info->dims[0] : 0;
+		var.cols = info->rank >= 2 ? info->dims[1] : 1;
+		var.usable = info->rank == 2 && (var.rows == 1 || var.cols == 1) &&
+			info->class_type == MAT_C_DOUBLE && !info->isComplex;
+
+		infos.push_back(info);
+		vars.push_back(var);
+	}
+
+	return true;
+#else
+	Q_UNUSED(path);
+	return false;
+#endif
+}
+
+const std::vector<MatFile::Variable>& MatFile::variables() const
+{
+	return vars;
+}
+
+int MatFile::find(const QString& name) const
+{
+	for (size_t i = 0; i < vars.size(); i++) {
+		if (vars[i].name == name) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+bool MatFile::read(int variable, size_t first, size_t count, double *out)
+{
+#ifdef MATLAB_SUPPORT_SIGGEN
+	if (variable < 0 || variable >= (int)vars.size() ||
+			!vars[variable].usable) {
+		return false;
+	}
+
+	const Variable &var = vars[variable];
+	if (first + count > var.rows * var.cols) {
+		return false;
+	}
+	if (!count) {
+		return true;
+	}
+
+	/* A column or a row, the slice is along the long side */
+	int start[2] = { 0, 0 };
+	int stride[2] = { 1, 1 };
+	int edge[2] = { 1, 1 };
+	int along = var.cols == 1 ? 0 : 1;
+	start[along] = first;
+	edge[along] = count;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return Mat_VarReadData(mat, infos[variable], out, start, stride,
+			       edge) == 0;
+#else
+	Q_UNUSED(variable);
+	Q_UNUSED(first);
+	Q_UNUSED(count);
+	Q_UNUSED(out);
+	return false;
+#endif
+}
+
+bool MatFile::readScalar(const QString& name, double& value)
+{
+	int variable = find(name);
+
+	return variable >= 0 && vars[variable].rows * vars[variable].cols == 1 &&
+		read(variable, 0, 1, &value);
+}
+
+bool MatFile::write(const QString& path, const std::vector<Column>& columns,
+		    double sample_rate, const Progress& progress)
+{
+#ifdef MATLAB_SUPPORT_SIGGEN
+	const QByteArray file_name = path.toLocal8Bit();
+
+	/* v7.3 takes variables past 2 GiB, it needs matio with HDF5 */
+	mat_t *out = Mat_CreateVer(file_name.constData(), NULL, MAT_FT_MAT73);
+	if (!out) {
+		out = Mat_CreateVer(file_name.constData(), NULL, MAT_FT_MAT5);
+	}
+	if (!out) {
+		return false;
+	}
+
+	QSet<QByteArray> used;
+	bool ok = true;
+
+	used.insert(sampleRateName);
+
+	for (size_t i = 0; ok && i < columns.size(); i++) {
+		const Column &column = columns[i];
+		size_t dims[2] = { column.size, 1 };
+		QByteArray name = variable_name(column.name, used);
+
+		/* Written from the buffer, never copied */
+		matvar_t *var = Mat_VarCreate(name.constData(), MAT_C_DOUBLE,
+				MAT_T_DOUBLE, 2, dims,
+				const_cast<double *>(column.data),
+				MAT_F_DONT_COPY_DATA);
+
+		ok = var && Mat_VarWrite(out, var, MAT_COMPRESSION_NONE) == 0;
+		if (var) {
+			Mat_VarFree(var);
+		}
+
+		if (ok && progress && !progress(i + 1, columns.size())) {
+			ok = false;
+		}
+	}
+
+	if (ok) {
+		size_t dims[2] = { 1, 1 };
+		matvar_t *var = Mat_VarCreate(sampleRateName, MAT_C_DOUBLE,
+				MAT_T_DOUBLE, 2, dims, &sample_rate,
+				MAT_F_DONT_COPY_DATA);
+
+		ok = var && Mat_VarWrite(out, var, MAT_COMPRESSION_NONE) == 0;
+		if (var) {
+			Mat_VarFree(var);
+		}
+	}
+
+	Mat_Close(out);
+
+	if (!ok) {
+		QFile::remove(path);
+	}
+
+	return ok;
+#else
+	Q_UNUSED(path);
+	Q_UNUSED(columns);
+	Q_UNUSED(sample_rate);
+	Q_UNUSED(progress);
+	return false;
+#endif
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAT_FILE_HPP
+#define MAT_FILE_HPP
+
+#include <QDateTime>
+#include <QString>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct _mat_t;
+struct matvar_t;
+
+namespace adiscope {
+
+/*
+ * A MATLAB file opened through matio, only built with
+ * MATLAB_SUPPORT_SIGGEN.
+ *
+ * The handle and the index of the variables are read once and shared by
+ * everyone opening the same file until it changes on the disk, the
+ * data of a variable is only read when asked for, and only the slice
+ * asked for.
+ *
+ * write() saves each column as a variable of its own, straight from
+ * the given buffers; the file is MAT v7.3 when matio has HDF5, else
+ * v5.
+ */
+class MatFile
+{
+public:
+	struct Variable {
+		QString name;
+		size_t rows;
+		size_t cols;
+		/* A vector of real doubles, the only ones the tools read */
+		bool usable;
+	};
+
+	struct Column {
+		QString name;
+		const double *data;
+		size_t size;
+	};
+
+	/* Columns written out of total, returning false cancels */
+	typedef std::function<bool(size_t done, size_t total)> Progress;
+
+	~MatFile();
+
+	/* nullptr when the file can not be read */
+	static std::shared_ptr<MatFile> open(const QString& path);
+
+	static bool write(const QString& path,
+			  const std::vector<Column>& columns,
+			  double sample_rate,
+			  const Progress& progress = Progress());
+
+	const std::vector<Variable>& variables() const;
+	/* -1 when not found */
+	int find(const QString& name) const;
+
+	/* count values of a usable variable, from first */
+	bool read(int variable, size_t first, size_t count, double *out);
+	/* The value of a 1x1 double, such as the sample rate write()
+	 * saves */
+	bool readScalar(const QString& name, double& value);
+
+	static const char *sampleRateName;
+
+private:
+	MatFile();
+	bool load(const QString& path);
+
+	_mat_t *mat;
+	std::vector<matvar_t *> infos;
+	std::vector<Variable> vars;
+	/* matio reads through one FILE position */
+	std::mutex mutex;
+	QDateTime modified;
+	qint64 size;
+};
+}
+
+#endif /* MAT_FILE_HPP */
@@ -20,16 +20,19 @@
 
 #include "dynamicWidget.hpp"
 #include "math.hpp"
+#include "math_expression.hpp"
 
 #include <QLocale>
 #include <QMenu>
+#include <QToolTip>
 
 #include <scopy/math.h>
 
 using namespace adiscope;
 
 Math::Math(QWidget *parent, unsigned int num_inputs) : QWidget(parent),
-	num_inputs(num_inputs)
+	num_inputs(num_inputs),
+	flowgraph_fallback(true)
 {
 	if (num_inputs == 0)
 		throw std::runtime_error("Math widget used with zero inputs");
@@ -168,19 +171,48 @@ void Math::validateFunction()
 {
 	QString function = ui.function->text();
 
+	/* Checked by the parser that computes the channels, the iio_math
+	 * blocks only where the tool falls back to them */
 	try {
-		gr::scopy::iio_math::make(function.toStdString(), num_inputs);
+		try {
+			MathExpression(function.toStdString(), num_inputs);
+		} catch (std::invalid_argument&) {
+			if (!flowgraph_fallback)
+				throw;
+
+			gr::scopy::iio_math::make(function.toStdString(),
+					num_inputs);
+		}
+
+		ui.function->setToolTip(QString());
 
 		Q_EMIT functionValid(function);
 
 		setDynamicProperty(ui.function, "valid", true);
 		setDynamicProperty(ui.btnApply, "valid", true);
-	} catch (std::exception ex) {
-		setDynamicProperty(ui.function, "invalid", true);
-		setDynamicProperty(ui.btnApply, "invalid", true);
+	} catch (std::exception& ex) {
+		showError(QString::fromStdString(ex.what()));
 	}
 }
 
+void Math::showError(const QString& error)
+{
+	ui.function->setToolTip(tr("Invalid function: %1").arg(error));
+	QToolTip::showText(ui.function->mapToGlobal(QPoint(0,
+			ui.function->height())), ui.function->toolTip(),
+			ui.function);
+
+	setDynamicProperty(ui.function, "valid", false);
+	setDynamicProperty(ui.btnApply, "valid", false);
+	setDynamicProperty(ui.function, "invalid", true);
+	setDynamicProperty(ui.btnApply, "invalid", true);
+}
+
+void Math::setFlowgraphFallback(bool enabled)
+{
+	flowgraph_fallback = enabled;
+}
+
 void Math::resetState()
 {
 	setDynamicProperty(ui.function, "valid", false);
@@ -35,9 +35,16 @@ namespace adiscope {
 		explicit Math(QWidget *parent = nullptr,
 				unsigned int num_inputs = 1);
 
+		/* Also accept the functions only the iio_math blocks parse,
+		 * for a tool that falls back to them; on by default */
+		void setFlowgraphFallback(bool enabled);
+
 	public Q_SLOTS:
 		void setFunction(const QString& function);
 
+		/* Marks the function invalid, the error in its tool tip */
+		void showError(const QString& error);
+
 	Q_SIGNALS:
 		void functionValid(const QString& function);
 		void stateReseted();
@@ -53,6 +60,7 @@ namespace adiscope {
 	private:
 		Ui::Math ui;
 		unsigned int num_inputs;
+		bool flowgraph_fallback;
 	};
 }
 
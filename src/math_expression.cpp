@@ -0,0 +1,530 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <stdexcept>
+
+#include "math_expression.hpp"
+
+using namespace adiscope;
+
+namespace {
+/* Samples per instruction, small enough for the stack to stay in cache */
+const size_t block_size = 1024;
+
+struct Slot {
+	bool scalar;
+	float value;
+	float *data;
+};
+
+/* Only ever called with a constant op, so the switch goes away */
+inline float evalOp(int op, float a, float b)
+{
+	switch (op) {
+	case MathExpression::OP_ADD:
+		return a + b;
+	case MathExpression::OP_SUB:
+		return a - b;
+	case MathExpression::OP_MUL:
+		return a * b;
+	case MathExpression::OP_DIV:
+		return a / b;
+	case MathExpression::OP_POW:
+		return std::pow(a, b);
+	case MathExpression::OP_NEG:
+		return -a;
+	case MathExpression::OP_SIN:
+		return std::sin(a);
+	case MathExpression::OP_COS:
+		return std::cos(a);
+	case MathExpression::OP_TAN:
+		return std::tan(a);
+	case MathExpression::OP_ASIN:
+		return std::asin(a);
+	case MathExpression::OP_ACOS:
+		return std::acos(a);
+	case MathExpression::OP_ATAN:
+		return std::atan(a);
+	case MathExpression::OP_SINH:
+		return std::sinh(a);
+	case MathExpression::OP_COSH:
+		return std::cosh(a);
+	case MathExpression::OP_TANH:
+		return std::tanh(a);
+	case MathExpression::OP_LOG:
+		return std::log(a);
+	case MathExpression::OP_LOG10:
+		return std::log10(a);
+	case MathExpression::OP_EXP:
+		return std::exp(a);
+	case MathExpression::OP_SQRT:
+		return std::sqrt(a);
+	case MathExpression::OP_ABS:
+		return std::fabs(a);
+	default:
+		return a;
+	}
+}
+
+template <int OP>
+void combine(Slot& a, const Slot& b, size_t n)
+{
+	if (a.scalar && b.scalar) {
+		a.value = evalOp(OP, a.value, b.value);
+	} else if (a.scalar) {
+		for (size_t i = 0; i < n; i++) {
+			a.data[i] = evalOp(OP, a.value, b.data[i]);
+		}
+	} else if (b.scalar) {
+		for (size_t i = 0; i < n; i++) {
+			a.data[i] = evalOp(OP, a.data[i], b.value);
+		}
+	} else {
+		for (size_t i = 0; i < n; i++) {
+			a.data[i] = evalOp(OP, a.data[i], b.data[i]);
+		}
+	}
+
+	a.scalar = a.scalar && b.scalar;
+}
+
+template <int OP>
+void transform(Slot& a, size_t n)
+{
+	if (a.scalar) {
+		a.value = evalOp(OP, a.value, 0.0f);
+		return;
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		a.data[i] = evalOp(OP, a.data[i], 0.0f);
+	}
+}
+
+void runBinary(int op, Slot& a, const Slot& b, size_t n)
+{
+	switch (op) {
+	case MathExpression::OP_ADD:
+		combine<MathExpression::OP_ADD>(a, b, n);
+		break;
+	case MathExpression::OP_SUB:
+		combine<MathExpression::OP_SUB>(a, b, n);
+		break;
+	case MathExpression::OP_MUL:
+		combine<MathExpression::OP_MUL>(a, b, n);
+		break;
+	case MathExpression::OP_DIV:
+		combine<MathExpression::OP_DIV>(a, b, n);
+		break;
+	case MathExpression::OP_POW:
+		combine<MathExpression::OP_POW>(a, b, n);
+		break;
+	default:
+		break;
+	}
+}
+
+void runUnary(int op, Slot& a, size_t n)
+{
+	switch (op) {
+	case MathExpression::OP_NEG:
+		transform<MathExpression::OP_NEG>(a, n);
+		break;
+	case MathExpression::OP_SIN:
+		transform<MathExpression::OP_SIN>(a, n);
+		break;
+	case MathExpression::OP_COS:
+		transform<MathExpression::OP_COS>(a, n);
+		break;
+	case MathExpression::OP_TAN:
+		transform<MathExpression::OP_TAN>(a, n);
+		break;
+	case MathExpression::OP_ASIN:
+		transform<MathExpression::OP_ASIN>(a, n);
+		break;
+	case MathExpression::OP_ACOS:
+		transform<MathExpression::OP_ACOS>(a, n);
+		break;
+	case MathExpression::OP_ATAN:
+		transform<MathExpression::OP_ATAN>(a, n);
+		break;
+	case MathExpression::OP_SINH:
+		transform<MathExpression::OP_SINH>(a, n);
+		break;
+	case MathExpression::OP_COSH:
+		transform<MathExpression::OP_COSH>(a, n);
+		break;
+	case MathExpression::OP_TANH:
+		transform<MathExpression::OP_TANH>(a, n);
+		break;
+	case MathExpression::OP_LOG:
+		transform<MathExpression::OP_LOG>(a, n);
+		break;
+	case MathExpression::OP_LOG10:
+		transform<MathExpression::OP_LOG10>(a, n);
+		break;
+	case MathExpression::OP_EXP:
+		transform<MathExpression::OP_EXP>(a, n);
+		break;
+	case MathExpression::OP_SQRT:
+		transform<MathExpression::OP_SQRT>(a, n);
+		break;
+	case MathExpression::OP_ABS:
+		transform<MathExpression::OP_ABS>(a, n);
+		break;
+	default:
+		break;
+	}
+}
+
+bool isBinary(MathExpression::Opcode op)
+{
+	return op >= MathExpression::OP_ADD && op <= MathExpression::OP_POW;
+}
+
+const struct {
+	const char *name;
+	MathExpression::Opcode op;
+} functions[] = {
+	{ "sin", MathExpression::OP_SIN },
+	{ "cos", MathExpression::OP_COS },
+	{ "tan", MathExpression::OP_TAN },
+	{ "asin", MathExpression::OP_ASIN },
+	{ "acos", MathExpression::OP_ACOS },
+	{ "atan", MathExpression::OP_ATAN },
+	{ "sinh", MathExpression::OP_SINH },
+	{ "cosh", MathExpression::OP_COSH },
+	{ "tanh", MathExpression::OP_TANH },
+	{ "log", MathExpression::OP_LOG },
+	{ "log10", MathExpression::OP_LOG10 },
+	{ "exp", MathExpression::OP_EXP },
+	{ "sqrt", MathExpression::OP_SQRT },
+	{ "abs", MathExpression::OP_ABS },
+};
+}
+
+MathExpression::MathExpression(const std::string& function,
+		unsigned int nb_inputs) :
+	d_depth(0),
+	d_text(function),
+	d_pos(0),
+	d_nb_inputs(nb_inputs),
+	d_stack(0)
+{
+	parseSum();
+	skipSpaces();
+
+	if (d_pos != d_text.size()) {
+		throw std::invalid_argument("Unexpected character in " +
+				function);
+	}
+
+	d_text.clear();
+}
+
+void MathExpression::skipSpaces()
+{
+	while (d_pos < d_text.size() && std::isspace(d_text[d_pos])) {
+		d_pos++;
+	}
+}
+
+void MathExpression::parseSum()
+{
+	parseProduct();
+
+	for (skipSpaces(); d_pos < d_text.size(); skipSpaces()) {
+		char c = d_text[d_pos];
+
+		if (c != '+' && c != '-') {
+			break;
+		}
+
+		d_pos++;
+		parseProduct();
+		emit(c == '+' ? OP_ADD : OP_SUB);
+	}
+}
+
+void MathExpression::parseProduct()
+{
+	parseUnary();
+
+	for (skipSpaces(); d_pos < d_text.size(); skipSpaces()) {
+		char c = d_text[d_pos];
+
+		if (c != '*' && c != '/') {
+			break;
+		}
+
+		d_pos++;
+		parseUnary();
+		emit(c == '*' ? OP_MUL : OP_DIV);
+	}
+}
+
+void MathExpression::parseUnary()
+{
+	skipSpaces();
+
+	if (d_pos < d_text.size() && d_text[d_pos] == '-') {
+		d_pos++;
+		parseUnary();
+		emit(OP_NEG);
+	} else if (d_pos < d_text.size() && d_text[d_pos] == '+') {
+		d_pos++;
+		parseUnary();
+	} else {
+		parsePower();
+	}
+}
+
+void MathExpression::parsePower()
+{
+	parsePrimary();
+	skipSpaces();
+
+	/* Right associative, and -2^2 is -(2^2) */
+	if (d_pos < d_text.size() && d_text[d_pos] == '^') {
+		d_pos++;
+		parseUnary();
+		emit(OP_POW);
+	}
+}
+
+void MathExpression::parsePrimary()
+{
+	skipSpaces();
+
+	if (d_pos == d_text.size()) {
+		throw std::invalid_argument("Unexpected end of " + d_text);
+	}
+
+	char c = d_text[d_pos];
+
+	if (c == '(') {
+		d_pos++;
+		parseSum();
+		skipSpaces();
+
+		if (d_pos == d_text.size() || d_text[d_pos] != ')') {
+			throw std::invalid_argument("Missing ) in " + d_text);
+		}
+
+		d_pos++;
+		return;
+	}
+
+	/* Parsed by hand, strtod() would follow the locale; the decimal
+	 * separator of the Math widget is that of the locale, the grammar
+	 * has no other use for a comma */
+	if (std::isdigit(c) || c == '.' || c == ',') {
+		double value = 0.0, scale = 1.0;
+		bool digits = false, fraction = false;
+
+		for (; d_pos < d_text.size(); d_pos++) {
+			c = d_text[d_pos];
+
+			if ((c == '.' || c == ',') && !fraction) {
+				fraction = true;
+			} else if (std::isdigit(c)) {
+				digits = true;
+
+				if (fraction) {
+					scale /= 10.0;
+					value += (c - '0') * scale;
+				} else {
+					value = value * 10.0 + (c - '0');
+				}
+			} else {
+				break;
+			}
+		}
+
+		if (!digits) {
+			throw std::invalid_argument("Bad number in " + d_text);
+		}
+
+		/* 1e-3; an e not followed by the exponent is the constant */
+		size_t exp_pos = d_pos + 1;
+
+		if (d_pos < d_text.size() && (d_text[d_pos] == 'e' ||
+					d_text[d_pos] == 'E')) {
+			bool negative = false;
+
+			if (exp_pos < d_text.size() && (d_text[exp_pos] == '+' ||
+						d_text[exp_pos] == '-')) {
+				negative = d_text[exp_pos] == '-';
+				exp_pos++;
+			}
+
+			if (exp_pos < d_text.size() &&
+					std::isdigit(d_text[exp_pos])) {
+				int exponent = 0;
+
+				for (d_pos = exp_pos; d_pos < d_text.size() &&
+						std::isdigit(d_text[d_pos]); d_pos++) {
+					exponent = std::min(exponent * 10 +
+							(d_text[d_pos] - '0'), 9999);
+				}
+
+				value *= std::pow(10.0, negative ? -exponent :
+						exponent);
+			}
+		}
+
+		emit(OP_CONST, value);
+		return;
+	}
+
+	if (!std::isalpha(c)) {
+		throw std::invalid_argument("Unexpected character in " +
+				d_text);
+	}
+
+	size_t start = d_pos;
+
+	while (d_pos < d_text.size() && std::isalnum(d_text[d_pos])) {
+		d_pos++;
+	}
+
+	std::string name = d_text.substr(start, d_pos - start);
+
+	if (name == "pi") {
+		emit(OP_CONST, M_PI);
+		return;
+	}
+
+	if (name == "e") {
+		emit(OP_CONST, M_E);
+		return;
+	}
+
+	if (name == "t" && d_nb_inputs == 1) {
+		emit(OP_INPUT, 0.0f, 0);
+		return;
+	}
+
+	if (name.size() > 1 && name[0] == 't' &&
+	    std::all_of(name.begin() + 1, name.end(), ::isdigit)) {
+		unsigned long input = std::stoul(name.substr(1));
+
+		if (input < d_nb_inputs) {
+			emit(OP_INPUT, 0.0f, input);
+			return;
+		}
+	}
+
+	for (const auto& function : functions) {
+		if (name != function.name) {
+			continue;
+		}
+
+		skipSpaces();
+
+		if (d_pos == d_text.size() || d_text[d_pos] != '(') {
+			throw std::invalid_argument("Missing ( after " + name);
+		}
+
+		parsePrimary();
+		emit(function.op);
+		return;
+	}
+
+	throw std::invalid_argument("Unknown name " + name);
+}
+
+void MathExpression::emit(Opcode op, float value, unsigned int input)
+{
+	size_t size = d_code.size();
+
+	if (op == OP_CONST || op == OP_INPUT) {
+		d_code.push_back({ op, value, input });
+		d_depth = std::max(d_depth, ++d_stack);
+		return;
+	}
+
+	if (isBinary(op)) {
+		d_stack--;
+
+		if (size >= 2 && d_code[size - 2].op == OP_CONST &&
+		    d_code[size - 1].op == OP_CONST) {
+			d_code[size - 2].value = evalOp(op,
+					d_code[size - 2].value,
+					d_code[size - 1].value);
+			d_code.pop_back();
+			return;
+		}
+	} else if (size >= 1 && d_code[size - 1].op == OP_CONST) {
+		d_code[size - 1].value = evalOp(op, d_code[size - 1].value,
+				0.0f);
+		return;
+	}
+
+	d_code.push_back({ op, 0.0f, 0 });
+}
+
+void MathExpression::evaluate(const float *const *inputs, float *out,
+		size_t count) const
+{
+	std::vector<float> buffers(d_depth * block_size);
+	std::vector<Slot> stack(d_depth);
+
+	for (size_t i = 0; i < d_depth; i++) {
+		stack[i].data = &buffers[i * block_size];
+	}
+
+	for (size_t first = 0; first < count; first += block_size) {
+		size_t n = std::min(block_size, count - first);
+		size_t top = 0;
+
+		for (const auto& instruction : d_code) {
+			if (instruction.op == OP_CONST) {
+				stack[top].scalar = true;
+				stack[top].value = instruction.value;
+				top++;
+			} else if (instruction.op == OP_INPUT) {
+				const float *in = inputs[instruction.input] +
+					first;
+
+				std::copy(in, in + n, stack[top].data);
+				stack[top].scalar = false;
+				top++;
+			} else if (isBinary(instruction.op)) {
+				top--;
+				runBinary(instruction.op, stack[top - 1],
+						stack[top], n);
+			} else {
+				runUnary(instruction.op, stack[top - 1], n);
+			}
+		}
+
+		if (stack[0].scalar) {
+			std::fill(out + first, out + first + n,
+					stack[0].value);
+		} else {
+			std::copy(stack[0].data, stack[0].data + n,
+					out + first);
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATH_EXPRESSION_HPP
+#define MATH_EXPRESSION_HPP
+
+#include <string>
+#include <vector>
+
+namespace adiscope {
+	/*
+	 * The functions of the Math widget, parsed once into a postfix
+	 * program and evaluated a block of samples per instruction. The
+	 * iio_math blocks build a flowgraph with one block per operator,
+	 * which moves every sample through a buffer for each of them.
+	 *
+	 * The grammar is the one of the Math widget: numbers (with a point
+	 * or a comma, and an exponent as in 1e-3), pi, e, the t (or t0 ..
+	 * tN with several inputs) variables, + - * / ^, parentheses and
+	 * sin, cos, tan, asin, acos, atan, sinh, cosh, tanh, log, log10,
+	 * exp, sqrt and abs. Constant subexpressions are folded while
+	 * parsing.
+	 */
+	class MathExpression
+	{
+	public:
+		/* The instructions of the compiled program */
+		enum Opcode {
+			OP_CONST,
+			OP_INPUT,
+			OP_ADD,
+			OP_SUB,
+			OP_MUL,
+			OP_DIV,
+			OP_POW,
+			OP_NEG,
+			OP_SIN,
+			OP_COS,
+			OP_TAN,
+			OP_ASIN,
+			OP_ACOS,
+			OP_ATAN,
+			OP_SINH,
+			OP_COSH,
+			OP_TANH,
+			OP_LOG,
+			OP_LOG10,
+			OP_EXP,
+			OP_SQRT,
+			OP_ABS,
+		};
+
+		/* Throws std::invalid_argument when the function does not
+		 * parse or uses a name it does not know */
+		explicit MathExpression(const std::string& function,
+				unsigned int nb_inputs = 1);
+
+		/* out[i] = f(inputs[0][i], .., inputs[nb_inputs - 1][i]) */
+		void evaluate(const float *const *inputs, float *out,
+				size_t count) const;
+
+	private:
+		struct Instruction {
+			Opcode op;
+			float value;
+			unsigned int input;
+		};
+
+		void parseSum();
+		void parseProduct();
+		void parseUnary();
+		void parsePower();
+		void parsePrimary();
+		void skipSpaces();
+		void emit(Opcode op, float value = 0.0f,
+				unsigned int input = 0);
+
+		std::vector<Instruction> d_code;
+		size_t d_depth;
+
+		/* Parser state */
+		std::string d_text;
+		size_t d_pos;
+		unsigned int d_nb_inputs;
+		size_t d_stack;
+	};
+}
+
+#endif /* MATH_EXPRESSION_HPP */
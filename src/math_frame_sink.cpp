@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "math_frame_sink.h"
+#include "math_expression.hpp"
+#include "spectrumUpdateEvents.h"
+
+#include <QCoreApplication>
+
+#include <algorithm>
+#include <volk/volk.h>
+
+using namespace adiscope;
+
+/* Frames of a math channel the GUI may hold, as for a scope sink */
+#define MATH_EVENT_POOL_SIZE 3
+
+MathFrameSink::MathFrameSink(QObject *plot, float min, float max) :
+	d_plot(plot),
+	d_min(min),
+	d_max(max),
+	d_update_time(0),
+	d_last_time(0)
+{
+}
+
+int MathFrameSink::_find(const std::string &name) const
+{
+	for (size_t i = 0; i < d_channels.size(); i++) {
+		if (d_channels[i].name == name) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void MathFrameSink::addChannel(const std::string &name,
+		const std::string &function, unsigned int nb_inputs)
+{
+	Channel channel;
+
+	// Compiled before taking the lock, the frames don't wait for it
+	channel.name = name;
+	channel.expression = std::make_shared<MathExpression>(function,
+			nb_inputs);
+	channel.nb_inputs = nb_inputs;
+	channel.pool = std::make_shared<TimeUpdateBufferPool>(
+			MATH_EVENT_POOL_SIZE, 1);
+	channel.min = channel.max = 0.0f;
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	int index = _find(name);
+	if (index >= 0) {
+		d_channels[index] = channel;
+	} else {
+		d_channels.push_back(channel);
+	}
+}
+
+void MathFrameSink::setFunction(const std::string &name,
+		const std::string &function, unsigned int nb_inputs)
+{
+	auto expression = std::make_shared<MathExpression>(function,
+			nb_inputs);
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	int index = _find(name);
+	if (index >= 0) {
+		d_channels[index].expression = expression;
+		d_channels[index].nb_inputs = nb_inputs;
+	}
+}
+
+void MathFrameSink::removeChannel(const std::string &name)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	int index = _find(name);
+	if (index >= 0) {
+		d_channels.erase(d_channels.begin() + index);
+	}
+}
+
+int MathFrameSink::indexOf(const std::string &name) const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	return _find(name);
+}
+
+unsigned int MathFrameSink::channelCount() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	return d_channels.size();
+}
+
+void MathFrameSink::setInputGain(unsigned int input, float gain)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (input >= d_gains.size()) {
+		d_gains.resize(input + 1, 1.0f);
+	}
+
+	d_gains[input] = gain;
+}
+
+void MathFrameSink::setUpdateTime(double seconds)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_update_time = seconds * gr::high_res_timer_tps();
+	d_last_time = 0;
+}
+
+void MathFrameSink::add_frame_listener(frame_listener *listener)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (std::find(d_listeners.begin(), d_listeners.end(), listener) ==
+			d_listeners.end()) {
+		d_listeners.push_back(listener);
+	}
+}
+
+void MathFrameSink::remove_frame_listener(frame_listener *listener)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_listeners.erase(std::remove(d_listeners.begin(), d_listeners.end(),
+				listener), d_listeners.end());
+}
+
+void MathFrameSink::_evaluate(Channel &channel, int nitems)
+{
+	channel.samples.resize(nitems);
+
+	float *out = channel.samples.data();
+	channel.expression->evaluate(d_inputs.data(), out, nitems);
+
+	// Clamp and find the range of the result in the same pass
+	float lo = d_max, hi = d_min;
+
+	for (int i = 0; i < nitems; i++) {
+		float v = out[i];
+
+		v = v < d_min ? d_min : (v > d_max ? d_max : v);
+		out[i] = v;
+		lo = v < lo ? v : lo;
+		hi = v > hi ? v : hi;
+	}
+
+	channel.min = lo;
+	channel.max = hi;
+}
+
+void MathFrameSink::_post(Channel &channel, int nitems)
+{
+	// Dropped if the GUI hasn't drawn the previous frames yet
+	TimeUpdateBufferPool::Slot *slot = channel.pool->acquire(nitems);
+	if (!slot) {
+		return;
+	}
+
+	std::copy(channel.samples.begin(), channel.samples.begin() + nitems,
+			slot->points[0]);
+	slot->min[0] = channel.min;
+	slot->max[0] = channel.max;
+	slot->tags[0].clear();
+	slot->offset = 0;
+	slot->append = false;
+
+	QCoreApplication::postEvent(d_plot,
+			new IdentifiableTimeUpdateEvent(channel.pool, slot,
+				nitems, channel.name));
+}
+
+void MathFrameSink::frame_ready(const std::vector<const float *> &channels,
+		int nitems)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (nitems <= 0) {
+		return;
+	}
+
+	gr::high_res_timer_type now = gr::high_res_timer_now();
+	bool post = !d_channels.empty() && d_plot &&
+		(now - d_last_time > d_update_time);
+
+	// Nothing is computed if no one is going to look at it
+	if (!post && d_listeners.empty()) {
+		return;
+	}
+
+	if (post) {
+		d_last_time = now;
+	}
+
+	d_inputs.resize(channels.size());
+	d_scaled.resize(channels.size());
+
+	for (size_t i = 0; i < channels.size(); i++) {
+		float gain = i < d_gains.size() ? d_gains[i] : 1.0f;
+
+		if (gain == 1.0f) {
+			d_inputs[i] = channels[i];
+			continue;
+		}
+
+		d_scaled[i].resize(nitems);
+		volk_32f_s32f_multiply_32f(d_scaled[i].data(), channels[i],
+				gain, nitems);
+		d_inputs[i] = d_scaled[i].data();
+	}
+
+	d_frame.assign(channels.begin(), channels.end());
+
+	for (auto &channel : d_channels) {
+		if (channel.nb_inputs > channels.size()) {
+			channel.samples.assign(nitems, 0.0f);
+			channel.min = channel.max = 0.0f;
+		} else {
+			_evaluate(channel, nitems);
+		}
+
+		if (post) {
+			_post(channel, nitems);
+		}
+
+		d_frame.push_back(channel.samples.data());
+	}
+
+	for (auto listener : d_listeners) {
+		listener->frame_ready(d_frame, nitems);
+	}
+}
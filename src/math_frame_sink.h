@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MATH_FRAME_SINK_H
+#define MATH_FRAME_SINK_H
+
+#include "frame_listener.h"
+
+#include <gnuradio/high_res_timer.h>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class QObject;
+
+namespace adiscope {
+
+class MathExpression;
+class TimeUpdateBufferPool;
+
+/*
+ * The math channels of the Oscilloscope, evaluated on the frames of the
+ * time sink instead of in a branch of the flowgraph per channel: each
+ * function is compiled once into a MathExpression and run on the whole
+ * frame, so a math channel only costs something when there is a frame
+ * to show.
+ *
+ * Every channel is posted to the plot under its own name, the way a
+ * scope sink of one input would. The listeners get the frames with the
+ * math channels appended after the inputs, in the order they were
+ * added.
+ */
+class MathFrameSink : public frame_listener
+{
+public:
+	MathFrameSink(QObject *plot, float min, float max);
+
+	/* Both throw std::invalid_argument when the function does not
+	 * parse; the channel is then left as it was */
+	void addChannel(const std::string &name, const std::string &function,
+			unsigned int nb_inputs);
+	void setFunction(const std::string &name,
+			const std::string &function, unsigned int nb_inputs);
+	void removeChannel(const std::string &name);
+
+	/* Position of the channel in the frames of the listeners, after
+	 * the inputs; -1 if there is none with that name */
+	int indexOf(const std::string &name) const;
+	unsigned int channelCount() const;
+
+	/* Scale of an input before the functions see it */
+	void setInputGain(unsigned int input, float gain);
+
+	/* Minimum time between two frames posted to the plot */
+	void setUpdateTime(double seconds);
+
+	void add_frame_listener(frame_listener *listener);
+	void remove_frame_listener(frame_listener *listener);
+
+	void frame_ready(const std::vector<const float *> &channels,
+			int nitems);
+
+private:
+	struct Channel {
+		std::string name;
+		std::shared_ptr<const MathExpression> expression;
+		unsigned int nb_inputs;
+		std::shared_ptr<TimeUpdateBufferPool> pool;
+		std::vector<float> samples;
+		float min, max;
+	};
+
+	mutable std::mutex d_mutex;
+	QObject *d_plot;
+	float d_min, d_max;
+	std::vector<Channel> d_channels;
+	std::vector<float> d_gains;
+	std::vector<frame_listener *> d_listeners;
+
+	gr::high_res_timer_type d_update_time;
+	gr::high_res_timer_type d_last_time;
+
+	/* Scratch space of frame_ready() */
+	std::vector<std::vector<float>> d_scaled;
+	std::vector<const float *> d_inputs;
+	std::vector<const float *> d_frame;
+
+	int _find(const std::string &name) const;
+	void _evaluate(Channel &channel, int nitems);
+	void _post(Channel &channel, int nitems);
+};
+}
+
+#endif // MATH_FRAME_SINK_H
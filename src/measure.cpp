@@ -19,8 +19,10 @@
  */
 
 #include "measure.h"
+#include <algorithm>
 #include <cmath>
 #include "adc_sample_conv.hpp"
+#include "pipeline_trace.hpp"
 #include <qmath.h>
 #include <QDebug>
 
@@ -243,6 +245,44 @@ namespace adiscope {
 			return m_detectedCrossings;
 		}
 
+		/* Start over, so that one object can serve every measure() */
+		void reset(double level, double hysteresis_span)
+		{
+			setLevel(level);
+			setHysteresisSpan(hysteresis_span);
+			m_posCross.resetState();
+			m_negCross.resetState();
+			m_posCrossFound = false;
+			m_negCrossFound = false;
+			m_crossed = false;
+			m_posCrossPoint = 0;
+			m_negCrossPoint = 0;
+			m_detectedCrossings.clear();
+		}
+
+		/* Same as calling crossDetectStep() for every sample of
+		 * [begin, end) that isn't a NaN. While neither detector is
+		 * between its thresholds, a step can only do something if
+		 * the two samples it looks at reach the hysteresis band, so
+		 * the samples that don't are skipped a block at a time. */
+		void detect(double *data, size_t begin, size_t end)
+		{
+			size_t i = begin;
+
+			while (i < end) {
+				if (!m_posCross.isBetweenThresholds() &&
+						!m_negCross.isBetweenThresholds()) {
+					i = nextInBand(data, i, end);
+					if (i >= end)
+						break;
+				}
+
+				if (!qIsNaN(data[i]))
+					crossDetectStep(data, i);
+				i++;
+			}
+		}
+
 		inline void store_closest_val_to_cross_lvl(double *data, size_t i, size_t &point)
 		{
 			double diff1 = qAbs(data[i - 1] - m_level);
@@ -326,6 +366,36 @@ namespace adiscope {
 		}
 
 	private:
+		/* First i in [begin, end) where data[i - 1] and data[i] are
+		 * not both above or both below the band, end if none */
+		size_t nextInBand(const double *data, size_t begin, size_t end) const
+		{
+			const size_t block = 16;
+			double low = std::min(m_low_level, m_high_level);
+			double high = std::max(m_low_level, m_high_level);
+			size_t b = begin;
+
+			for (; b + block <= end; b += block) {
+				bool found = false;
+
+				for (size_t i = b; i < b + block; i++) {
+					found |= (data[i - 1] <= high || data[i] <= high) &&
+						(data[i - 1] >= low || data[i] >= low);
+				}
+
+				if (found)
+					break;
+			}
+
+			for (; b < end; b++) {
+				if ((data[b - 1] <= high || data[b] <= high) &&
+						(data[b - 1] >= low || data[b] >= low))
+					return b;
+			}
+
+			return end;
+		}
+
 		HystLevelPosCross m_posCross;
 		HystLevelNegCross m_negCross;
 
@@ -348,6 +418,153 @@ namespace adiscope {
 	};
 }
 
+namespace {
+	/* The passes measure() can make over the data */
+	enum MeasureStage {
+		STAGE_STATS = 1 << 0,		// min, max, sums
+		STAGE_HISTOGRAM = 1 << 1,	// low, high from the ADC codes
+		STAGE_CROSSINGS = 1 << 2,	// period detection
+		STAGE_LEVELS = 1 << 3,		// 10%, 50%, 90% crossings
+		STAGE_ALL = (1 << 4) - 1,
+	};
+
+	/* The stages each measurement needs, prerequisites included */
+	const int measurement_stages[Measure::DEFAULT_MEASUREMENT_COUNT] = {
+		STAGE_STATS | STAGE_CROSSINGS,			// PERIOD
+		STAGE_STATS | STAGE_CROSSINGS,			// FREQUENCY
+		STAGE_STATS,					// MIN
+		STAGE_STATS,					// MAX
+		STAGE_STATS,					// PEAK_PEAK
+		STAGE_STATS,					// MEAN
+		STAGE_ALL,					// CYCLE_MEAN
+		STAGE_STATS,					// RMS
+		STAGE_ALL,					// CYCLE_RMS
+		STAGE_STATS,					// AC_RMS
+		STAGE_ALL,					// AREA
+		STAGE_ALL,					// CYCLE_AREA
+		STAGE_STATS | STAGE_HISTOGRAM,			// LOW
+		STAGE_STATS | STAGE_HISTOGRAM,			// HIGH
+		STAGE_STATS | STAGE_HISTOGRAM,			// AMPLITUDE
+		STAGE_STATS | STAGE_HISTOGRAM,			// MIDDLE
+		STAGE_STATS | STAGE_HISTOGRAM,			// P_OVER
+		STAGE_STATS | STAGE_HISTOGRAM,			// N_OVER
+		STAGE_ALL,					// RISE
+		STAGE_ALL,					// FALL
+		STAGE_ALL,					// P_WIDTH
+		STAGE_ALL,					// N_WIDTH
+		STAGE_ALL,					// P_DUTY
+		STAGE_ALL,					// N_DUTY
+	};
+
+	/* Min, max and sums of the samples of a range, NaNs left out */
+	struct SampleStats {
+		double min;
+		double max;
+		double sum;
+		double sqr_sum;
+		size_t nan_count;
+	};
+
+	const size_t STATS_BLOCK = 1024;
+
+	/*
+	 * One pass over [begin, end) updating the statistics and, if hist
+	 * isn't null, the histogram of the raw ADC codes.
+	 *
+	 * The work goes a block at a time: a block without NaNs (the usual
+	 * case) goes through a loop with four independent accumulators per
+	 * quantity and no branches, which the compiler can vectorize, and
+	 * a separate loop converting to ADC codes before the histogram
+	 * scatter. Blocks with NaNs take the sample by sample path.
+	 */
+	void accumulateStats(const double *data, size_t begin, size_t end,
+			SampleStats &st, int *hist, int adc_span)
+	{
+		const int hlf_scale = adc_span / 2;
+		const float volts_to_raw =
+			adiscope::adc_sample_conv::convVoltsToSample(1.0);
+		int raw[STATS_BLOCK];
+
+		for (size_t b = begin; b < end; b += STATS_BLOCK) {
+			size_t e = std::min(b + STATS_BLOCK, end);
+			bool has_nan = false;
+
+			for (size_t i = b; i < e; i++)
+				has_nan |= (data[i] != data[i]);
+
+			if (has_nan) {
+				for (size_t i = b; i < e; i++) {
+					double v = data[i];
+
+					if (qIsNaN(v)) {
+						st.nan_count++;
+						continue;
+					}
+
+					st.min = std::min(st.min, v);
+					st.max = std::max(st.max, v);
+					st.sum += v;
+					st.sqr_sum += v * v;
+
+					if (hist) {
+						int r = hlf_scale + (int)((float)v *
+								volts_to_raw);
+						if (r >= 0 && r < adc_span)
+							hist[r] += 1;
+					}
+				}
+				continue;
+			}
+
+			double mn[4], mx[4];
+			double s[4] = { 0, 0, 0, 0 };
+			double sq[4] = { 0, 0, 0, 0 };
+			for (int k = 0; k < 4; k++) {
+				mn[k] = st.min;
+				mx[k] = st.max;
+			}
+
+			size_t i = b;
+			for (; i + 4 <= e; i += 4) {
+				for (int k = 0; k < 4; k++) {
+					double v = data[i + k];
+
+					mn[k] = v < mn[k] ? v : mn[k];
+					mx[k] = v > mx[k] ? v : mx[k];
+					s[k] += v;
+					sq[k] += v * v;
+				}
+			}
+			for (; i < e; i++) {
+				double v = data[i];
+
+				mn[0] = v < mn[0] ? v : mn[0];
+				mx[0] = v > mx[0] ? v : mx[0];
+				s[0] += v;
+				sq[0] += v * v;
+			}
+
+			for (int k = 0; k < 4; k++) {
+				st.min = std::min(st.min, mn[k]);
+				st.max = std::max(st.max, mx[k]);
+			}
+			st.sum += (s[0] + s[1]) + (s[2] + s[3]);
+			st.sqr_sum += (sq[0] + sq[1]) + (sq[2] + sq[3]);
+
+			if (hist) {
+				for (size_t j = b; j < e; j++)
+					raw[j - b] = hlf_scale + (int)((float)data[j] *
+							volts_to_raw);
+
+				for (size_t j = 0; j < e - b; j++) {
+					if (raw[j] >= 0 && raw[j] < adc_span)
+						hist[raw[j]] += 1;
+				}
+			}
+		}
+	}
+}
+
 Measure::Measure(int channel, double *buffer, size_t length):
 	m_channel(channel),
 	m_buffer(buffer),
@@ -356,8 +573,7 @@ Measure::Measure(int channel, double *buffer, size_t length):
 	m_adc_bit_count(0),
 	m_cross_level(0),
 	m_hysteresis_span(0),
-	m_histogram(nullptr),
-	m_cross_detect(nullptr),
+	m_cross_detect(new CrossingDetection(0, 0, "P")),
 	m_gatingEnabled(false)
 {
 
@@ -413,11 +629,16 @@ Measure::Measure(int channel, double *buffer, size_t length):
 
 }
 
+Measure::~Measure()
+{
+	delete m_cross_detect;
+}
+
 bool Measure::highLowFromHistogram(double &low, double &high,
 		double min, double max)
 {
 	bool success = false;
-	int *hist = m_histogram;
+	const int *hist = m_histogram.data();
 	int adc_span = 1 << m_adc_bit_count;
 	int hlf_scale = adc_span / 2;
 
@@ -458,10 +679,29 @@ void Measure::setDataSource(double *buffer, size_t length)
 }
 
 void Measure::measure()
+{
+	PIPELINE_TRACE("Measure::measure");
+
+	int stages = 0;
+
+	for (int i = 0; i < m_measurements.size(); i++) {
+		if (m_measurements[i]->enabled())
+			stages |= measurement_stages[i];
+	}
+
+	compute(stages);
+}
+
+void Measure::measureAll()
+{
+	compute(STAGE_ALL);
+}
+
+void Measure::compute(int stages)
 {
 	clearMeasurements();
 
-	if (!m_buffer || m_buf_length == 0)
+	if (!m_buffer || m_buf_length == 0 || !stages)
 		return;
 
 	double period;
@@ -496,8 +736,8 @@ void Measure::measure()
 	size_t data_length = m_buf_length;
 	size_t count = data_length;
 	int adc_span = 1 << m_adc_bit_count;
-	int hlf_scale = adc_span / 2;
-	bool using_histogram_method = (adc_span > 1);
+	bool using_histogram_method = (adc_span > 1) &&
+		(stages & STAGE_HISTOGRAM);
 
 	int startIndex;
 	int endIndex;
@@ -534,44 +774,27 @@ void Measure::measure()
 		endIndex = data_length;
 	}
 
-	m_cross_detect = new CrossingDetection(m_cross_level, m_hysteresis_span,
-			"P");
+	// The scratch state is kept from one call to the next
+	m_cross_detect->reset(m_cross_level, m_hysteresis_span);
 	if (using_histogram_method)
-		m_histogram = new int[adc_span]{};
-
-	for (ssize_t i = startIndex; i < endIndex; i++) {
-
-		if (qIsNaN(data[i])) {
-			count--;
-			continue;
-		}
-		// Find level crossings (period detection)
-		m_cross_detect->crossDetectStep(data, i);
-
-		// Min
-		if (data[i] < min) {
-			min = data[i];
-		}
-
-		// Max
-		if (data[i] > max) {
-			max = data[i];
-		}
-
-		// Sum of values
-		sum += data[i];
-
-		// Sum of the squares of values
-		sqr_sum += data[i] * data[i];
-
-		// Build histogram
-		if (using_histogram_method) {
-			int raw = hlf_scale + (int)adiscope::adc_sample_conv::
-						convVoltsToSample(data[i]);
-			if (raw >= 0 && raw  < adc_span)
-				m_histogram[raw] += 1;
-		}
+		m_histogram.assign(adc_span, 0);
+
+	// Min, max, sums and histogram in one pass
+	SampleStats stats = { min, max, sum, sqr_sum, 0 };
+	if (startIndex < endIndex) {
+		accumulateStats(data, startIndex, endIndex, stats,
+				using_histogram_method ? m_histogram.data() : nullptr,
+				adc_span);
 	}
+	min = stats.min;
+	max = stats.max;
+	sum = stats.sum;
+	sqr_sum = stats.sqr_sum;
+	count -= stats.nan_count;
+
+	// Find level crossings (period detection)
+	if ((stages & STAGE_CROSSINGS) && startIndex < endIndex)
+		m_cross_detect->detect(data, startIndex, endIndex);
 
 	m_measurements[MIN]->setValue(min);
 	m_measurements[MAX]->setValue(max);
@@ -600,25 +823,19 @@ void Measure::measure()
 	if (using_histogram_method)
 		highLowFromHistogram(low, high, min, max);
 
-	// Low, High, Middle, Amplitude, Overshoot positive/negative
-	m_measurements[LOW]->setValue(low);
-	m_measurements[HIGH]->setValue(high);
-
 	middle = low + (high - low) / 2.0;
-	m_measurements[MIDDLE]->setValue(middle);
-
 	amplitude = high - low;
-	m_measurements[AMPLITUDE]->setValue(amplitude);
-
 	overshoot_p = (max - high) / amplitude * 100;
-	m_measurements[P_OVER]->setValue(overshoot_p);
-
 	overshoot_n = (low - min) / amplitude * 100;
-	m_measurements[N_OVER]->setValue(overshoot_n);
 
-	if (m_histogram != NULL) {
-		delete[] m_histogram;
-		m_histogram = NULL;
+	// Low, High, Middle, Amplitude, Overshoot positive/negative
+	if (stages & STAGE_HISTOGRAM) {
+		m_measurements[LOW]->setValue(low);
+		m_measurements[HIGH]->setValue(high);
+		m_measurements[MIDDLE]->setValue(middle);
+		m_measurements[AMPLITUDE]->setValue(amplitude);
+		m_measurements[P_OVER]->setValue(overshoot_p);
+		m_measurements[N_OVER]->setValue(overshoot_n);
 	}
 
 	// Find Period / Frequency
@@ -652,6 +869,9 @@ void Measure::measure()
 		frequency = 1 / period;
 		m_measurements[FREQUENCY]->setValue(frequency);
 
+		if (!(stages & STAGE_LEVELS))
+			return;
+
 		// Find level crossings (10%, 50%, 90%)
 		double lowRef = low + (0.1 * amplitude);
 		double midRef = low + (0.5 * amplitude);
@@ -771,9 +991,6 @@ void Measure::measure()
 		}
 	}
 
-	delete m_cross_detect;
-	m_cross_detect = NULL;
-
 }
 
 double Measure::sampleRate()
@@ -845,6 +1062,32 @@ void Measure::setGatingEnabled(bool enable){
 	m_gatingEnabled = enable;
 }
 
+void Measure::copySettings(const Measure &other)
+{
+	m_sample_rate = other.m_sample_rate;
+	m_adc_bit_count = other.m_adc_bit_count;
+	m_cross_level = other.m_cross_level;
+	m_hysteresis_span = other.m_hysteresis_span;
+	m_startIndex = other.m_startIndex;
+	m_endIndex = other.m_endIndex;
+	m_gatingEnabled = other.m_gatingEnabled;
+
+	for (int i = 0; i < m_measurements.size(); i++)
+		m_measurements[i]->setEnabled(
+			other.m_measurements[i]->enabled());
+}
+
+void Measure::copyValues(const Measure &other)
+{
+	for (int i = 0; i < m_measurements.size(); i++) {
+		if (other.m_measurements[i]->measured())
+			m_measurements[i]->setValue(
+				other.m_measurements[i]->value());
+		else
+			m_measurements[i]->setMeasured(false);
+	}
+}
+
 QList<std::shared_ptr<MeasurementData>> Measure::measurments()
 {
 	return m_measurements;
@@ -956,18 +1199,30 @@ MeasurementData::axisType MeasurementData::axis() const
  * Class Statistic implementation
  */
 
-Statistic::Statistic():
-	m_sum(0),
+static const int STATISTIC_HIST_BINS = 256;
+
+Statistic::Statistic(unsigned int windowSize):
 	m_min(0),
 	m_max(0),
 	m_dataCount(0),
-	m_average(0)
+	m_average(0),
+	m_m2(0),
+	m_hist(STATISTIC_HIST_BINS, 0),
+	m_hist_low(0),
+	m_hist_bin_width(0),
+	m_window(std::max(windowSize, 1u), 0),
+	m_window_pos(0),
+	m_window_count(0),
+	m_window_pushed(0),
+	m_window_sum(0),
+	m_window_sqr_sum(0)
 {
 }
 
 void Statistic::pushNewData(double data)
 {
-	m_sum += data;
+	if (!qIsFinite(data))
+		return;
 
 	if (!m_dataCount) {
 		m_min = data;
@@ -979,17 +1234,116 @@ void Statistic::pushNewData(double data)
 			m_max = data;
 	}
 
+	// Welford's update of the mean and of the sum of squared deviations
 	m_dataCount += 1;
-	m_average = m_sum / m_dataCount;
+	double delta = data - m_average;
+	m_average += delta / m_dataCount;
+	m_m2 += delta * (data - m_average);
+
+	histogramAdd(data);
+	windowAdd(data);
+}
+
+void Statistic::histogramAdd(double data)
+{
+	const int bins = STATISTIC_HIST_BINS;
+
+	if (m_hist_bin_width == 0) {
+		m_hist_bin_width = std::max(qAbs(data) * 1e-6, 1e-12);
+		m_hist_low = data - m_hist_bin_width * bins / 2;
+	}
+
+	// Double the bin width, merging bins in pairs, until the value
+	// fits; the old range becomes the half next to the new value.
+	while (data < m_hist_low ||
+			data >= m_hist_low + m_hist_bin_width * bins) {
+		bool grow_down = data < m_hist_low;
+		std::vector<double> merged(bins, 0);
+
+		for (int i = 0; i < bins; i++) {
+			int j = i / 2 + (grow_down ? bins / 2 : 0);
+			merged[j] += m_hist[i];
+		}
+
+		if (grow_down)
+			m_hist_low -= m_hist_bin_width * bins;
+		m_hist_bin_width *= 2;
+		m_hist.swap(merged);
+	}
+
+	int bin = (int)((data - m_hist_low) / m_hist_bin_width);
+	m_hist[std::min(std::max(bin, 0), bins - 1)] += 1;
+}
+
+void Statistic::windowAdd(double data)
+{
+	unsigned int size = m_window.size();
+
+	if (m_window_count == size) {
+		double old = m_window[m_window_pos];
+		m_window_sum -= old;
+		m_window_sqr_sum -= old * old;
+	} else {
+		m_window_count++;
+	}
+
+	m_window[m_window_pos] = data;
+	m_window_sum += data;
+	m_window_sqr_sum += data * data;
+	m_window_pos = (m_window_pos + 1) % size;
+
+	// Sum again once per turn, so rounding errors don't build up
+	if (m_window_pos == 0) {
+		m_window_sum = 0;
+		m_window_sqr_sum = 0;
+		for (unsigned int i = 0; i < m_window_count; i++) {
+			m_window_sum += m_window[i];
+			m_window_sqr_sum += m_window[i] * m_window[i];
+		}
+	}
+
+	// Monotonic queues: the front is the extreme of the window
+	unsigned long long idx = m_window_pushed++;
+	unsigned long long first = m_window_pushed - m_window_count;
+
+	while (!m_window_mins.empty() && m_window_mins.back().second >= data)
+		m_window_mins.pop_back();
+	m_window_mins.push_back(std::make_pair(idx, data));
+	while (m_window_mins.front().first < first)
+		m_window_mins.pop_front();
+
+	while (!m_window_maxs.empty() && m_window_maxs.back().second <= data)
+		m_window_maxs.pop_back();
+	m_window_maxs.push_back(std::make_pair(idx, data));
+	while (m_window_maxs.front().first < first)
+		m_window_maxs.pop_front();
+}
+
+void Statistic::windowClear()
+{
+	std::fill(m_window.begin(), m_window.end(), 0);
+	m_window_pos = 0;
+	m_window_count = 0;
+	m_window_pushed = 0;
+	m_window_sum = 0;
+	m_window_sqr_sum = 0;
+	m_window_mins.clear();
+	m_window_maxs.clear();
 }
 
 void Statistic::clear()
 {
-	m_sum = 0;
 	m_min = 0;
 	m_max = 0;
 	m_dataCount = 0;
 	m_average = 0;
+	m_m2 = 0;
+
+	std::fill(m_hist.begin(), m_hist.end(), 0);
+	m_hist_low = 0;
+	m_hist_bin_width = 0;
+
+	windowClear();
 }
 
 double Statistic::average() const
@@ -1011,3 +1365,101 @@ double Statistic::numPushedData() const
 {
 	return m_dataCount;
 }
+
+double Statistic::stdDev() const
+{
+	if (m_dataCount < 2)
+		return 0;
+
+	return sqrt(m_m2 / (m_dataCount - 1));
+}
+
+/* p is in percents; the value is interpolated inside the bin it falls in */
+double Statistic::percentile(double p) const
+{
+	if (!m_dataCount)
+		return 0;
+
+	double target = qBound(0.0, p, 100.0) / 100 * m_dataCount;
+	double cumulated = 0;
+	double value = m_max;
+
+	for (int i = 0; i < STATISTIC_HIST_BINS; i++) {
+		if (m_hist[i] > 0 && cumulated + m_hist[i] >= target) {
+			double frac = (target - cumulated) / m_hist[i];
+			value = m_hist_low + (i + frac) * m_hist_bin_width;
+			break;
+		}
+		cumulated += m_hist[i];
+	}
+
+	return qBound(m_min, value, m_max);
+}
+
+unsigned int Statistic::windowSize() const
+{
+	return m_window.size();
+}
+
+void Statistic::setWindowSize(unsigned int size)
+{
+	size = std::max(size, 1u);
+	if (size == m_window.size())
+		return;
+
+	// Keep the newest values that still fit
+	std::vector<double> newest;
+	unsigned int size_old = m_window.size();
+	unsigned int first = (m_window_pos + size_old - m_window_count) %
+		size_old;
+	unsigned int keep = std::min(m_window_count, size);
+
+	for (unsigned int i = m_window_count - keep; i < m_window_count; i++)
+		newest.push_back(m_window[(first + i) % size_old]);
+
+	m_window.assign(size, 0);
+	windowClear();
+	for (double value : newest)
+		windowAdd(value);
+}
+
+unsigned int Statistic::windowCount() const
+{
+	return m_window_count;
+}
+
+double Statistic::windowAverage() const
+{
+	if (!m_window_count)
+		return 0;
+
+	return m_window_sum / m_window_count;
+}
+
+double Statistic::windowStdDev() const
+{
+	if (m_window_count < 2)
+		return 0;
+
+	double n = m_window_count;
+	double var = (m_window_sqr_sum - m_window_sum * m_window_sum / n) /
+		(n - 1);
+
+	return sqrt(std::max(var, 0.0));
+}
+
+double Statistic::windowMin() const
+{
+	if (m_window_mins.empty())
+		return 0;
+
+	return m_window_mins.front().second;
+}
+
+double Statistic::windowMax() const
+{
+	if (m_window_maxs.empty())
+		return 0;
+
+	return m_window_maxs.front().second;
+}
@@ -23,7 +23,9 @@
 
 #include <QList>
 #include <QString>
+#include <deque>
 #include <memory>
+#include <vector>
 
 namespace adiscope {
 	class CrossingDetection;
@@ -102,9 +104,13 @@ namespace adiscope {
 		};
 
 		Measure(int channel, double *buffer = NULL, size_t length = 0);
+		~Measure();
 
 		void setDataSource(double *buffer, size_t length);
+
+		/* Computes the enabled measurements and what they depend on */
 		void measure();
+		void measureAll();
 		double sampleRate();
 		void setSampleRate(double);
 		unsigned int adcBitCount();
@@ -119,6 +125,10 @@ namespace adiscope {
 		void setEndIndex(int);
 		void setGatingEnabled(bool);
 
+		/* Used to run a copy of this Measure on another thread */
+		void copySettings(const Measure &other);
+		void copyValues(const Measure &other);
+
 		QList<std::shared_ptr<MeasurementData>> measurments();
 		std::shared_ptr<MeasurementData> measurement(int id);
 		int activeMeasurementsCount() const;
@@ -127,6 +137,7 @@ namespace adiscope {
 		bool highLowFromHistogram(double &low, double &high,
 			double min, double max);
 		void clearMeasurements();
+		void compute(int stages);
 
 	private:
 		int m_channel;
@@ -139,16 +150,23 @@ namespace adiscope {
 		int m_startIndex;
 		int m_endIndex;
 		int m_gatingEnabled;
-		int *m_histogram;
+		std::vector<int> m_histogram;
 		CrossingDetection *m_cross_detect;
 
 		QList<std::shared_ptr<MeasurementData>> m_measurements;
 	};
 
+	/*
+	 * Running statistics of a measurement, updated in O(1) per value
+	 * and with bounded memory: the mean and variance since the last
+	 * clear() (Welford), percentiles estimated from a fixed number of
+	 * histogram bins that widen as the values spread out, and the
+	 * mean, deviation, min and max of the last windowSize() values.
+	 */
 	class Statistic
 	{
 	public:
-		Statistic();
+		Statistic(unsigned int windowSize = 100);
 
 		void pushNewData(double data);
 		void clear();
@@ -157,13 +175,41 @@ namespace adiscope {
 		double min() const;
 		double max() const;
 		double numPushedData() const;
+		double stdDev() const;
+		double percentile(double p) const;
+
+		unsigned int windowSize() const;
+		void setWindowSize(unsigned int size);
+		unsigned int windowCount() const;
+		double windowAverage() const;
+		double windowStdDev() const;
+		double windowMin() const;
+		double windowMax() const;
+
+	private:
+		void histogramAdd(double data);
+		void windowAdd(double data);
+		void windowClear();
 
 	private:
-		double m_sum;
 		double m_min;
 		double m_max;
 		double m_dataCount;
 		double m_average;
+		double m_m2;
+
+		std::vector<double> m_hist;
+		double m_hist_low;
+		double m_hist_bin_width;
+
+		std::vector<double> m_window;
+		unsigned int m_window_pos;
+		unsigned int m_window_count;
+		unsigned long long m_window_pushed;
+		double m_window_sum;
+		double m_window_sqr_sum;
+		std::deque<std::pair<unsigned long long, double>> m_window_mins;
+		std::deque<std::pair<unsigned long long, double>> m_window_maxs;
 	};
 }
 
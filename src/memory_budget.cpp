@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "memory_budget.hpp"
+#include "logging_categories.h"
+#include "capture_buffer_pool.hpp"
+
+#include <QApplication>
+
+#include <algorithm>
+#include <limits>
+
+using namespace adiscope;
+
+MemoryBudget::MemoryBudget(QObject *parent) :
+	QObject(parent),
+	limit(0)
+{
+	check_timer.setInterval(1000);
+	connect(&check_timer, &QTimer::timeout, this, &MemoryBudget::check);
+
+	/* The capture buffers kept for reuse go before any history */
+	addUsage(this, "Capture buffers", "Kept for reuse", []() {
+		return CaptureBufferPool::getInstance().cached();
+	});
+	addReclaimer(this, CACHE, [](size_t) {
+		size_t cached = CaptureBufferPool::getInstance().cached();
+
+		CaptureBufferPool::getInstance().trim();
+		return cached;
+	});
+}
+
+MemoryBudget *MemoryBudget::instance()
+{
+	/* Goes away with the application, after the tools */
+	static MemoryBudget *budget = new MemoryBudget(qApp);
+
+	return budget;
+}
+
+void MemoryBudget::_watch(QObject *owner)
+{
+	connect(owner, &QObject::destroyed, this, &MemoryBudget::removeOwner,
+		Qt::UniqueConnection);
+}
+
+void MemoryBudget::addUsage(QObject *owner, const QString& tool,
+			    const QString& name, Usage usage)
+{
+	_watch(owner);
+	accounts.push_back({ owner, tool, name, usage });
+}
+
+void MemoryBudget::addReclaimer(QObject *owner, int priority,
+				Reclaimer reclaimer)
+{
+	_watch(owner);
+
+	/* Stable, the reclaimers of a priority go in the order they came */
+	auto it = std::upper_bound(reclaimers.begin(), reclaimers.end(),
+			priority, [](int p, const Entry& e) {
+		return p < e.priority;
+	});
+	reclaimers.insert(it, { owner, priority, reclaimer });
+}
+
+void MemoryBudget::removeOwner(QObject *owner)
+{
+	accounts.erase(std::remove_if(accounts.begin(), accounts.end(),
+			[=](const Account& a) { return a.owner == owner; }),
+			accounts.end());
+	reclaimers.erase(std::remove_if(reclaimers.begin(), reclaimers.end(),
+			[=](const Entry& e) { return e.owner == owner; }),
+			reclaimers.end());
+}
+
+void MemoryBudget::setBudget(size_t bytes)
+{
+	limit = bytes;
+
+	/* The buffers kept for reuse are at most a small part of it */
+	CaptureBufferPool::getInstance().setCacheLimit(limit ?
+		std::min(CaptureBufferPool::default_cache_limit, limit / 16) :
+		CaptureBufferPool::default_cache_limit);
+
+	if (limit) {
+		check_timer.start();
+		check();
+	} else {
+		check_timer.stop();
+	}
+}
+
+size_t MemoryBudget::budget() const
+{
+	return limit;
+}
+
+size_t MemoryBudget::used() const
+{
+	size_t total = 0;
+
+	for (const Account& account : accounts)
+		total += account.usage();
+
+	return total;
+}
+
+size_t MemoryBudget::available() const
+{
+	if (!limit)
+		return std::numeric_limits<size_t>::max();
+
+	size_t total = used();
+
+	return total < limit ? limit - total : 0;
+}
+
+size_t MemoryBudget::_reclaim(size_t bytes)
+{
+	size_t freed = 0;
+
+	/* A reclaimer may drop its owner, which removes it from the list */
+	const std::vector<Entry> entries = reclaimers;
+
+	for (const Entry& entry : entries) {
+		if (freed >= bytes)
+			break;
+
+		freed += entry.reclaimer(bytes - freed);
+	}
+
+	return freed;
+}
+
+bool MemoryBudget::reserve(size_t bytes)
+{
+	if (!limit)
+		return true;
+
+	size_t free = available();
+
+	if (bytes > free) {
+		_reclaim(bytes - free);
+		free = available();
+	}
+
+	return bytes <= free;
+}
+
+void MemoryBudget::check()
+{
+	const size_t total = used();
+
+	if (!limit || total <= limit)
+		return;
+
+	_reclaim(total - limit);
+
+	const size_t after = used();
+
+	if (after > limit) {
+		CAT_DEBUG_EVERY(CAT_TOOL_LAUNCHER, 10000) << "Over the memory budget:"
+			<< after << "of" << limit << "bytes used";
+		Q_EMIT overBudget(after, limit);
+	}
+}
+
+QVariantMap MemoryBudget::usage() const
+{
+	QVariantMap map;
+	qulonglong total = 0;
+
+	for (const Account& account : accounts) {
+		QVariantMap tool = map.value(account.tool).toMap();
+		qulonglong bytes = account.usage();
+
+		tool[account.name] = tool.value(account.name).toULongLong() +
+			bytes;
+		map[account.tool] = tool;
+		total += bytes;
+	}
+
+	map["used"] = total;
+	map["budget"] = (qulonglong)limit;
+	return map;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORY_BUDGET_HPP
+#define MEMORY_BUDGET_HPP
+
+#include <QObject>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <functional>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Accounts for the large buffers of the tools (capture buffers,
+ * averaging and sweep history, deep logic captures, references) against
+ * one budget shared by all of them.
+ *
+ * The tools report what their buffers hold and check with reserve()
+ * before growing one; what doesn't fit is made smaller or kept in a
+ * file. Past the budget the reclaimers of the tools give up their
+ * history, the most expendable first, rather than the system running
+ * out of memory. The usage is checked again every second, for the
+ * buffers that grow while capturing.
+ *
+ * Used from the GUI thread only. Without a budget it only accounts.
+ */
+class MemoryBudget : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<size_t()> Usage;
+
+	/* Frees up to the given bytes, returns how many it freed */
+	typedef std::function<size_t(size_t bytes)> Reclaimer;
+
+	/* The priorities of the reclaimers, lower ones are called first */
+	enum {
+		CACHE = -10,
+		HISTORY = 0,
+		CAPTURE = 10,
+	};
+
+	static MemoryBudget *instance();
+
+	/* The bytes a buffer of the tool holds; removed with owner */
+	void addUsage(QObject *owner, const QString& tool,
+		      const QString& name, Usage usage);
+
+	void addReclaimer(QObject *owner, int priority, Reclaimer reclaimer);
+
+	/* In bytes, 0 for no budget */
+	void setBudget(size_t bytes);
+	size_t budget() const;
+
+	size_t used() const;
+
+	/* What is left of the budget, the maximum of size_t without one */
+	size_t available() const;
+
+	/* Whether bytes more fit in the budget, after reclaiming from the
+	 * tools if they don't */
+	bool reserve(size_t bytes);
+
+	/* The bytes of each buffer per tool, with the total under "used"
+	 * and the budget under "budget" */
+	QVariantMap usage() const;
+
+Q_SIGNALS:
+	/* Emitted when the reclaimers could not bring the usage back
+	 * within the budget */
+	void overBudget(qulonglong used, qulonglong budget);
+
+private Q_SLOTS:
+	void check();
+	void removeOwner(QObject *owner);
+
+private:
+	struct Account {
+		QObject *owner;
+		QString tool;
+		QString name;
+		Usage usage;
+	};
+
+	struct Entry {
+		QObject *owner;
+		int priority;
+		Reclaimer reclaimer;
+	};
+
+	explicit MemoryBudget(QObject *parent = nullptr);
+
+	void _watch(QObject *owner);
+	size_t _reclaim(size_t bytes);
+
+	std::vector<Account> accounts;
+	std::vector<Entry> reclaimers;
+	size_t limit;
+	QTimer check_timer;
+};
+}
+
+#endif /* MEMORY_BUDGET_HPP */
@@ -0,0 +1,461 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "minmaxplotcurve.h"
+
+#include <qwt_painter.h>
+#include <qwt_scale_map.h>
+#include <qwt_series_data.h>
+#include <QtMath>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+MinMaxPlotCurve::MinMaxPlotCurve(const QString &title):
+	QwtPlotCurve(title),
+	d_pyramid_valid(false),
+	d_pyramid_from(0),
+	d_use_prebuilt(false),
+	d_envelope_valid(false),
+	d_from(0), d_to(0),
+	d_first_x(0), d_last_x(0),
+	d_s1(0), d_s2(0), d_p1(0), d_p2(0),
+	d_sinc(false),
+	d_sinc_valid(false)
+{
+}
+
+void MinMaxPlotCurve::invalidateEnvelope()
+{
+	d_pyramid_valid = false;
+	d_envelope_valid = false;
+	d_sinc_valid = false;
+}
+
+void MinMaxPlotCurve::setSincInterpolation(bool enable)
+{
+	d_sinc = enable;
+	d_sinc_valid = false;
+}
+
+bool MinMaxPlotCurve::sincInterpolation() const
+{
+	return d_sinc;
+}
+
+bool MinMaxPlotCurve::View::operator==(const View &other) const
+{
+	return from == other.from && to == other.to &&
+		first_x == other.first_x && last_x == other.last_x &&
+		s1 == other.s1 && s2 == other.s2 &&
+		p1 == other.p1 && p2 == other.p2;
+}
+
+void MinMaxPlotCurve::setPyramid(std::shared_ptr<const MinMaxPyramid> pyramid)
+{
+	d_prebuilt = pyramid;
+	invalidateEnvelope();
+}
+
+bool MinMaxPlotCurve::usePyramid(int from, int to) const
+{
+	return d_prebuilt && d_prebuilt->levels() && from == 0 &&
+		to + 1 == (int)data()->size();
+}
+
+size_t MinMaxPlotCurve::levelCount() const
+{
+	return d_use_prebuilt ? d_prebuilt->levels() : d_pyramid.size();
+}
+
+void MinMaxPlotCurve::levelEntry(size_t level, size_t index,
+		double &min, double &max) const
+{
+	if (d_use_prebuilt) {
+		d_prebuilt->entry(level, index, min, max);
+	} else {
+		min = d_pyramid[level][index].min;
+		max = d_pyramid[level][index].max;
+	}
+}
+
+void MinMaxPlotCurve::drawLines(QPainter *painter,
+		const QwtScaleMap &xMap, const QwtScaleMap &yMap,
+		const QRectF &canvasRect, int from, int to) const
+{
+	int columns = qCeil(canvasRect.width());
+
+	if (d_sinc && !testCurveAttribute(QwtPlotCurve::Fitted) &&
+			drawSinc(painter, xMap, yMap, canvasRect, from, to)) {
+		return;
+	}
+
+	if (testCurveAttribute(QwtPlotCurve::Fitted) || columns <= 0
+			|| (to - from + 1) <= 2 * columns) {
+		QwtPlotCurve::drawLines(painter, xMap, yMap,
+				canvasRect, from, to);
+		return;
+	}
+
+	const QwtSeriesData<QPointF> *series = data();
+
+	if (!d_envelope_valid || from != d_from || to != d_to
+			|| xMap.s1() != d_s1 || xMap.s2() != d_s2
+			|| xMap.p1() != d_p1 || xMap.p2() != d_p2
+			|| series->sample(from).x() != d_first_x
+			|| series->sample(to).x() != d_last_x) {
+		updateEnvelope(xMap, canvasRect, from, to);
+	}
+
+	QPolygonF polyline(d_envelope.size());
+	QPointF *points = polyline.data();
+	const QPointF *env = d_envelope.constData();
+
+	for (int i = 0; i < d_envelope.size(); i++) {
+		points[i] = QPointF(xMap.transform(env[i].x()),
+				yMap.transform(env[i].y()));
+	}
+
+	QwtPainter::drawPolyline(painter, polyline);
+}
+
+void MinMaxPlotCurve::buildPyramid(int from, int to) const
+{
+	const QwtSeriesData<QPointF> *series = data();
+
+	d_pyramid.clear();
+	d_pyramid_from = from;
+
+	/* First level straight from the samples */
+	int count = to - from + 1;
+	std::vector<MinMax> level((count + PyramidFactor - 1) / PyramidFactor);
+
+	for (size_t b = 0; b < level.size(); b++) {
+		int begin = from + b * PyramidFactor;
+		int end = std::min(begin + PyramidFactor, to + 1);
+		double y = series->sample(begin).y();
+		MinMax mm = { y, y };
+
+		for (int i = begin + 1; i < end; i++) {
+			y = series->sample(i).y();
+			mm.min = std::min(mm.min, y);
+			mm.max = std::max(mm.max, y);
+		}
+
+		level[b] = mm;
+	}
+
+	d_pyramid.push_back(level);
+
+	/* Each next level summarizes PyramidFactor entries of the previous */
+	while (d_pyramid.back().size() > 1) {
+		const std::vector<MinMax> &prev = d_pyramid.back();
+		std::vector<MinMax> next((prev.size() + PyramidFactor - 1)
+				/ PyramidFactor);
+
+		for (size_t b = 0; b < next.size(); b++) {
+			size_t begin = b * PyramidFactor;
+			size_t end = std::min(begin + PyramidFactor, prev.size());
+			MinMax mm = prev[begin];
+
+			for (size_t i = begin + 1; i < end; i++) {
+				mm.min = std::min(mm.min, prev[i].min);
+				mm.max = std::max(mm.max, prev[i].max);
+			}
+
+			next[b] = mm;
+		}
+
+		d_pyramid.push_back(next);
+	}
+
+	d_pyramid_valid = true;
+}
+
+void MinMaxPlotCurve::rangeMinMax(int begin, int end,
+		double &min, double &max) const
+{
+	/* Min/max of the samples in [begin, end). Unaligned edges are
+	 * handled at the finest level, the rest with the coarsest level
+	 * entries that fit, so the cost is bounded by the pyramid height
+	 * instead of by the range length. */
+	const QwtSeriesData<QPointF> *series = data();
+
+	min = max = series->sample(begin).y();
+
+	int b = begin - d_pyramid_from;
+	int e = end - d_pyramid_from;
+
+	while (b < e && (b % PyramidFactor)) {
+		double y = series->sample(d_pyramid_from + b++).y();
+		min = std::min(min, y);
+		max = std::max(max, y);
+	}
+	while (b < e && (e % PyramidFactor)) {
+		double y = series->sample(d_pyramid_from + --e).y();
+		min = std::min(min, y);
+		max = std::max(max, y);
+	}
+
+	/* [b, e) is now aligned on the first level's blocks */
+	b /= PyramidFactor;
+	e /= PyramidFactor;
+
+	size_t levels = levelCount();
+	for (size_t l = 0; l < levels && b < e; l++) {
+		bool last = (l + 1 == levels);
+		double lo, hi;
+
+		while (b < e && (last || (b % PyramidFactor))) {
+			levelEntry(l, b++, lo, hi);
+			min = std::min(min, lo);
+			max = std::max(max, hi);
+		}
+		while (b < e && (last || (e % PyramidFactor))) {
+			levelEntry(l, --e, lo, hi);
+			min = std::min(min, lo);
+			max = std::max(max, hi);
+		}
+
+		b /= PyramidFactor;
+		e /= PyramidFactor;
+	}
+}
+
+int MinMaxPlotCurve::lowerBound(int from, int to, double x) const
+{
+	/* First index in [from, to] with its sample at or after x, to + 1
+	 * if there's none */
+	const QwtSeriesData<QPointF> *series = data();
+	int lo = from, hi = to + 1;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (series->sample(mid).x() < x) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+void MinMaxPlotCurve::updateEnvelope(const QwtScaleMap &xMap,
+		const QRectF &canvasRect, int from, int to) const
+{
+	const QwtSeriesData<QPointF> *series = data();
+	int columns = qCeil(canvasRect.width());
+	double left = canvasRect.left();
+
+	d_use_prebuilt = usePyramid(from, to);
+	if (d_use_prebuilt) {
+		d_pyramid_from = 0;
+		d_pyramid_valid = false;
+	} else if (!d_pyramid_valid || d_pyramid_from != from
+			|| d_from != from || d_to != to) {
+		buildPyramid(from, to);
+	}
+
+	d_envelope.clear();
+	d_envelope.reserve(2 * columns + 2);
+
+	/* The samples next to the canvas edges keep the line running off
+	 * the canvas where it should */
+	int begin = lowerBound(from, to, xMap.invTransform(left));
+	if (begin > from) {
+		d_envelope.append(series->sample(begin - 1));
+	}
+
+	for (int c = 0; c < columns && begin <= to; c++) {
+		int end = lowerBound(begin, to,
+				xMap.invTransform(left + c + 1));
+		if (end == begin) {
+			continue;
+		}
+
+		double min, max;
+		double x = series->sample(begin).x();
+
+		rangeMinMax(begin, end, min, max);
+		d_envelope.append(QPointF(x, min));
+		d_envelope.append(QPointF(x, max));
+
+		begin = end;
+	}
+
+	if (begin <= to) {
+		d_envelope.append(series->sample(begin));
+	}
+
+	d_from = from;
+	d_to = to;
+	d_first_x = series->sample(from).x();
+	d_last_x = series->sample(to).x();
+	d_s1 = xMap.s1();
+	d_s2 = xMap.s2();
+	d_p1 = xMap.p1();
+	d_p2 = xMap.p2();
+	d_envelope_valid = true;
+}
+
+/*
+ * The windowed sinc kernel at each phase: entry (p, k) weighs the sample
+ * n - SincHalfTaps + 1 + k for the point n + p / SincPhases. Blackman
+ * windowed, each phase normalized so that a constant stays constant.
+ */
+static const std::vector<float>& sincTable()
+{
+	static const std::vector<float> table = []() {
+		const int half = MinMaxPlotCurve::SincHalfTaps;
+		const int phases = MinMaxPlotCurve::SincPhases;
+		std::vector<float> taps(phases * 2 * half);
+
+		for (int p = 0; p < phases; p++) {
+			float *h = &taps[p * 2 * half];
+			double sum = 0;
+
+			for (int k = 0; k < 2 * half; k++) {
+				double u = (double)p / phases + half - 1 - k;
+				double sinc = u == 0.0 ? 1.0 :
+					std::sin(M_PI * u) / (M_PI * u);
+				double window = 0.42 +
+					0.5 * std::cos(M_PI * u / half) +
+					0.08 * std::cos(2.0 * M_PI * u / half);
+
+				h[k] = sinc * window;
+				sum += h[k];
+			}
+
+			for (int k = 0; k < 2 * half; k++) {
+				h[k] /= sum;
+			}
+		}
+
+		return taps;
+	}();
+
+	return table;
+}
+
+bool MinMaxPlotCurve::drawSinc(QPainter *painter, const QwtScaleMap &xMap,
+		const QwtScaleMap &yMap, const QRectF &canvasRect,
+		int from, int to) const
+{
+	/* Below this many pixels per sample, straight lines look the same */
+	static const double min_pixels_per_sample = 4.0;
+
+	const QwtSeriesData<QPointF> *series = data();
+
+	if (to - from < 2) {
+		return false;
+	}
+
+	double dx = series->sample(from + 1).x() - series->sample(from).x();
+	double pixels = std::abs(xMap.transform(series->sample(from).x() + dx)
+			- xMap.transform(series->sample(from).x()));
+
+	if (dx <= 0 || pixels < min_pixels_per_sample) {
+		return false;
+	}
+
+	View view = { from, to, series->sample(from).x(),
+		series->sample(to).x(), xMap.s1(), xMap.s2(),
+		xMap.p1(), xMap.p2() };
+
+	if (!d_sinc_valid || !(view == d_sinc_view)) {
+		updateSinc(xMap, canvasRect, from, to);
+		d_sinc_view = view;
+		d_sinc_valid = true;
+	}
+
+	QPolygonF polyline(d_sinc_points.size());
+	QPointF *points = polyline.data();
+	const QPointF *sinc = d_sinc_points.constData();
+
+	for (int i = 0; i < d_sinc_points.size(); i++) {
+		points[i] = QPointF(xMap.transform(sinc[i].x()),
+				yMap.transform(sinc[i].y()));
+	}
+
+	QwtPainter::drawPolyline(painter, polyline);
+
+	return true;
+}
+
+void MinMaxPlotCurve::updateSinc(const QwtScaleMap &xMap,
+		const QRectF &canvasRect, int from, int to) const
+{
+	const QwtSeriesData<QPointF> *series = data();
+	const std::vector<float> &table = sincTable();
+	const int half = SincHalfTaps;
+
+	double x0 = series->sample(from).x();
+	double dx = series->sample(from + 1).x() - x0;
+	double pixels = std::abs(xMap.transform(x0 + dx) - xMap.transform(x0));
+
+	/* About a point per pixel: the fewest phases, a power of two,
+	 * that get there */
+	int phases = 1;
+	while (phases < SincPhases && phases < pixels) {
+		phases *= 2;
+	}
+	int step = SincPhases / phases;
+
+	/* Only the samples on the canvas, and one past each edge */
+	int begin = std::max(from, lowerBound(from, to,
+			xMap.invTransform(canvasRect.left())) - 1);
+	int end = std::min(to, lowerBound(from, to,
+			xMap.invTransform(canvasRect.right())));
+
+	/* The samples each point needs, the edges repeated */
+	auto sample = [&](int i) {
+		return series->sample(std::min(std::max(i, from), to)).y();
+	};
+
+	d_sinc_points.clear();
+	d_sinc_points.reserve((end - begin) * phases + 1);
+
+	std::vector<double> window(2 * half);
+
+	for (int n = begin; n < end; n++) {
+		for (int k = 0; k < 2 * half; k++) {
+			window[k] = sample(n - half + 1 + k);
+		}
+
+		double x = series->sample(n).x();
+
+		for (int p = 0; p < SincPhases; p += step) {
+			const float *h = &table[p * 2 * half];
+			double y = 0;
+
+			for (int k = 0; k < 2 * half; k++) {
+				y += h[k] * window[k];
+			}
+
+			d_sinc_points.append(QPointF(x + dx * p / SincPhases, y));
+		}
+	}
+
+	d_sinc_points.append(series->sample(end));
+}
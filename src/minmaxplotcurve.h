@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINMAXPLOTCURVE_H
+#define MINMAXPLOTCURVE_H
+
+#include <qwt_plot_curve.h>
+#include <QPolygonF>
+
+#include <memory>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Min/max pyramid of a whole series built ahead of time, e.g. cached
+ * with the file the samples come from. Entry b of level l summarizes
+ * the samples [b, b + 1) * MinMaxPlotCurve::PyramidFactor^(l + 1), the
+ * last level has a single entry.
+ */
+class MinMaxPyramid
+{
+public:
+	virtual ~MinMaxPyramid() {}
+
+	virtual size_t levels() const = 0;
+	virtual size_t levelSize(size_t level) const = 0;
+	virtual void entry(size_t level, size_t index,
+			double &min, double &max) const = 0;
+};
+
+/*
+ * Curve drawing long records as a per pixel column min/max envelope
+ * (peak detect), so no glitch gets lost while the cost of a replot only
+ * depends on the canvas width.
+ *
+ * When new data arrives, a min/max pyramid is built in one pass over the
+ * samples (each level summarizing PyramidFactor entries of the level
+ * below). Zooming and panning then read the envelope of every column
+ * from the pyramid, in time proportional to the canvas width rather than
+ * to the record length. The envelope itself is kept in plot coordinates
+ * until the data or the horizontal scale change, so replots that only
+ * move the vertical scale, cursors or markers reuse it as is.
+ *
+ * The x values of the samples must be increasing. Only used for plain
+ * lines with more samples than pixel columns, the other styles are drawn
+ * by QwtPlotCurve as usual.
+ *
+ * Zoomed in to a few pixels per sample, the line can instead be the
+ * sin(x)/x reconstruction of the samples, for uniformly sampled series:
+ * only the visible samples are interpolated, with a windowed sinc
+ * kernel tabulated once per phase, and the result is kept like the
+ * envelope until the data or the horizontal scale change.
+ */
+class MinMaxPlotCurve : public QwtPlotCurve
+{
+public:
+	explicit MinMaxPlotCurve(const QString &title = QString());
+
+	static const int PyramidFactor = 16;
+
+	/* Call after modifying the samples in place */
+	void invalidateEnvelope();
+
+	/* Used instead of building one whenever the whole series is
+	 * drawn; a null pointer goes back to building it */
+	void setPyramid(std::shared_ptr<const MinMaxPyramid> pyramid);
+
+	void setSincInterpolation(bool enable);
+	bool sincInterpolation() const;
+
+	/* Half the taps of the sinc kernel, and its phases per sample */
+	static const int SincHalfTaps = 8;
+	static const int SincPhases = 64;
+
+protected:
+	virtual void drawLines(QPainter *painter,
+			const QwtScaleMap &xMap, const QwtScaleMap &yMap,
+			const QRectF &canvasRect, int from, int to) const;
+
+private:
+	struct MinMax {
+		double min;
+		double max;
+	};
+
+	void buildPyramid(int from, int to) const;
+	bool usePyramid(int from, int to) const;
+	size_t levelCount() const;
+	void levelEntry(size_t level, size_t index,
+			double &min, double &max) const;
+	void rangeMinMax(int begin, int end, double &min, double &max) const;
+	int lowerBound(int from, int to, double x) const;
+	void updateEnvelope(const QwtScaleMap &xMap,
+			const QRectF &canvasRect, int from, int to) const;
+	bool drawSinc(QPainter *painter, const QwtScaleMap &xMap,
+			const QwtScaleMap &yMap, const QRectF &canvasRect,
+			int from, int to) const;
+	void updateSinc(const QwtScaleMap &xMap, const QRectF &canvasRect,
+			int from, int to) const;
+
+	/* d_pyramid[0] summarizes the samples, relative to d_pyramid_from */
+	mutable std::vector< std::vector<MinMax> > d_pyramid;
+	mutable bool d_pyramid_valid;
+	mutable int d_pyramid_from;
+	std::shared_ptr<const MinMaxPyramid> d_prebuilt;
+	mutable bool d_use_prebuilt;
+
+	mutable QPolygonF d_envelope;
+	mutable bool d_envelope_valid;
+	mutable int d_from, d_to;
+	mutable double d_first_x, d_last_x;
+	mutable double d_s1, d_s2, d_p1, d_p2;
+
+	/* What the sinc polyline was computed for */
+	struct View {
+		int from, to;
+		double first_x, last_x;
+		double s1, s2, p1, p2;
+
+		bool operator==(const View &other) const;
+	};
+
+	bool d_sinc;
+	mutable QPolygonF d_sinc_points;
+	mutable bool d_sinc_valid;
+	mutable View d_sinc_view;
+};
+}
+
+#endif // MINMAXPLOTCURVE_H
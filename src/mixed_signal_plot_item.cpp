@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "mixed_signal_plot_item.h"
+#include "capture_store.h"
+
+#include "pulseview/pv/data/logicsegment.hpp"
+
+#include <qwt_scale_map.h>
+#include <QPainter>
+#include <QLineF>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+MixedSignalPlotItem::MixedSignalPlotItem(CaptureStore *store,
+		const QColor &color) :
+	QwtPlotItem(QwtText("Logic")),
+	d_store(store),
+	d_color(color),
+	d_lane_height(20)
+{
+	setItemAttribute(QwtPlotItem::AutoScale, false);
+	setItemAttribute(QwtPlotItem::Legend, false);
+	setZ(100.0);
+}
+
+void MixedSignalPlotItem::setColor(const QColor &color)
+{
+	if (d_color != color) {
+		d_color = color;
+		itemChanged();
+	}
+}
+
+void MixedSignalPlotItem::setLaneHeight(int height)
+{
+	if (d_lane_height != height) {
+		d_lane_height = std::max(height, 4);
+		itemChanged();
+	}
+}
+
+int MixedSignalPlotItem::rtti() const
+{
+	return QwtPlotItem::Rtti_PlotUserItem + 1;
+}
+
+void MixedSignalPlotItem::draw(QPainter *painter, const QwtScaleMap &xMap,
+		const QwtScaleMap &, const QRectF &canvasRect) const
+{
+	auto capture = d_store->logic();
+	if (!capture || !capture->segment || !capture->channel_mask ||
+			capture->sample_rate <= 0.0) {
+		return;
+	}
+
+	const std::shared_ptr<pv::data::LogicSegment> &segment =
+		capture->segment;
+	const uint64_t count = segment->get_sample_count();
+	if (count < 2 || canvasRect.width() <= 0) {
+		return;
+	}
+
+	std::vector<unsigned int> lanes;
+	for (unsigned int i = 0; i < 64; i++) {
+		if ((capture->channel_mask >> i) & 1) {
+			lanes.push_back(i);
+		}
+	}
+
+	/* The samples under the canvas, on the time axis of the trigger */
+	const double rate = capture->sample_rate;
+	const double first = (std::min(xMap.s1(), xMap.s2()) -
+			capture->start_time) * rate;
+	const double last = (std::max(xMap.s1(), xMap.s2()) -
+			capture->start_time) * rate;
+	if (last < 0.0 || first > count - 1) {
+		return;
+	}
+
+	const uint64_t start = std::max(std::floor(first), 0.0);
+	const uint64_t end = std::min<uint64_t>(std::ceil(last), count - 1);
+	if (start >= end) {
+		return;
+	}
+
+	/* Twice the resolution of the canvas, as the logic analyzer does */
+	const float min_length = std::max((last - first) /
+			canvasRect.width() / 2.0, 1.0);
+	segment->get_subsampled_edges(d_edges, start, end, min_length,
+			capture->channel_mask);
+
+	const double lane = std::min<double>(d_lane_height,
+			canvasRect.height() / (2 * lanes.size()));
+	const double high = lane * 0.2, low = lane * 0.8;
+	double top = canvasRect.bottom() - lane * lanes.size();
+
+	std::vector<QLineF> lines;
+	const auto to_x = [&](int64_t sample) {
+		return xMap.transform(capture->start_time + sample / rate);
+	};
+
+	painter->save();
+	painter->setPen(QPen(d_color, 1));
+
+	for (unsigned int ch : lanes) {
+		const auto &edges = d_edges[ch];
+		if (edges.size() < 2) {
+			top += lane;
+			continue;
+		}
+
+		/* A cap from each edge to the next one, and a vertical line
+		 * at each edge between them */
+		lines.clear();
+		for (size_t i = 0; i + 1 < edges.size(); i++) {
+			const double x0 = to_x(edges[i].first);
+			const double x1 = to_x(edges[i + 1].first);
+			const double y = top + (edges[i].second ? high : low);
+
+			lines.emplace_back(x0, y, x1, y);
+			if (i > 0) {
+				lines.emplace_back(x0, top + high, x0, top + low);
+			}
+		}
+
+		painter->drawLines(lines.data(), lines.size());
+
+		if (ch < (unsigned int)capture->channel_names.size()) {
+			painter->drawText(QRectF(canvasRect.left() + 4, top,
+					canvasRect.width(), lane),
+					Qt::AlignLeft | Qt::AlignVCenter,
+					capture->channel_names[ch]);
+		}
+
+		top += lane;
+	}
+
+	painter->restore();
+}
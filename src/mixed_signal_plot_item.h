@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MIXED_SIGNAL_PLOT_ITEM_H
+#define MIXED_SIGNAL_PLOT_ITEM_H
+
+#include <QColor>
+#include <qwt_plot_item.h>
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace adiscope {
+
+class CaptureStore;
+
+/*
+ * Draws the channels of the last logic capture of a store as lanes at
+ * the bottom of a time plot, the x axis being the time from the trigger.
+ * The edges come out of the mip-map of the logic segment at the level
+ * of detail of the canvas, so the cost follows the width of the plot
+ * and not the length of the capture.
+ */
+class MixedSignalPlotItem : public QwtPlotItem
+{
+public:
+	explicit MixedSignalPlotItem(CaptureStore *store,
+			const QColor &color = QColor(0x4a, 0x64, 0xff));
+
+	void setColor(const QColor &color);
+
+	/* Height of a lane in pixels, less if the canvas is too small */
+	void setLaneHeight(int height);
+
+	virtual int rtti() const;
+
+	virtual void draw(QPainter *painter, const QwtScaleMap &xMap,
+			const QwtScaleMap &yMap, const QRectF &canvasRect) const;
+
+private:
+	CaptureStore *d_store;
+	QColor d_color;
+	int d_lane_height;
+
+	/* Scratch space of draw() */
+	mutable std::vector<std::vector<std::pair<int64_t, bool>>> d_edges;
+};
+}
+
+#endif // MIXED_SIGNAL_PLOT_ITEM_H
@@ -27,6 +27,9 @@
 #include "hardware_trigger.hpp"
 #include "ui_network_analyzer.h"
 #include "filemanager.h"
+#include "export_service.hpp"
+#include "pipeline_trace.hpp"
+#include "thread_scheduling.hpp"
 
 #include <gnuradio/analog/sig_source.h>
 
@@ -42,6 +45,8 @@
 #include <gnuradio/blocks/skiphead.h>
 #include <gnuradio/blocks/vector_sink.h>
 #include <gnuradio/top_block.h>
+#include <gnuradio/fft/fft.h>
+#include <gnuradio/fft/window.h>
 #include <boost/make_shared.hpp>
 #include <gnuradio/blocks/stream_to_vector.h>
 #include <gnuradio/blocks/vector_to_stream.h>
@@ -50,8 +55,14 @@
 #include "hw_dac.h"
 
 #include <algorithm>
+#include <cmath>
+#include <complex>
+#include <tuple>
 
 #include <QThread>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QtConcurrentMap>
 #include <QFileDialog>
 #include <QDateTime>
 #include <QSignalBlocker>
@@ -65,107 +76,25 @@
 using namespace adiscope;
 using namespace gr;
 
-void NetworkAnalyzer::_configureDacFlowgraph()
-{
-	// Create the blocks that are used to generate sine waves
-	top_block = make_top_block("Signal Generator");
-	source_block = analog::sig_source_f::make(1, analog::GR_SIN_WAVE,
-			1, 1, 1);
-	f2s_block = blocks::float_to_short::make(1, 1);
-	head_block = blocks::head::make(sizeof(short), 1);
-	vector_block = blocks::vector_sink_s::make();
-
-	// Connect the blocks for the sine wave generation
-	top_block->connect(source_block, 0, f2s_block, 0);
-	top_block->connect(f2s_block, 0, head_block, 0);
-	top_block->connect(head_block, 0, vector_block, 0);
-}
+/* Frequency arrays kept for the sweeps run again */
+static const int max_cached_sweeps = 8;
 
-void NetworkAnalyzer::_configureAdcFlowgraph(size_t buffer_size)
-{
-	if (m_initFlowgraph) {
-
-
-		capture_top_block = make_top_block("Network capture processing");
-
-		// Get the available sample rates for the m2k-adc
-		// Make sure the values are sorted in ascending order (1000,..,100e6)
-		sampleRates = SignalGenerator::get_available_sample_rates(adc);
-		qSort(sampleRates.begin(), sampleRates.end(), qLess<unsigned long>());
-
-		auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
-
-		dc_cancel1 = gnuradio::get_initial_sptr(
-					new cancel_dc_offset_block(1, false));
-		dc_cancel2 = gnuradio::get_initial_sptr(
-					new cancel_dc_offset_block(1, false));
-
-		capture1 = gr::blocks::vector_source_s::make(std::vector<short>(), false, 1);
-		capture2 = gr::blocks::vector_source_s::make(std::vector<short>(), false, 1);
-		f11 = adiscope::frequency_compensation_filter::make(false);
-		f12 = adiscope::frequency_compensation_filter::make(false);
-		f21 = adiscope::frequency_compensation_filter::make(false);
-		f22 = adiscope::frequency_compensation_filter::make(false);
-		s2f1 = gr::blocks::short_to_float::make();
-		s2f2 = gr::blocks::short_to_float::make();
-		goertzel1 = gr::scopy::goertzel_scopy_fc::make(1, 1, 1);
-		goertzel2 = gr::scopy::goertzel_scopy_fc::make(1, 1, 1);
-		copy1 = gr::blocks::copy::make(sizeof(float));
-		copy2 = gr::blocks::copy::make(sizeof(float));
-		head1 = gr::blocks::head::make(sizeof(float), 1);
-		head2 = gr::blocks::head::make(sizeof(float), 1);
-		sink1 = gr::blocks::vector_sink_f::make();
-		sink2 = gr::blocks::vector_sink_f::make();
-		c2m1 = gr::blocks::complex_to_mag_squared::make();
-		c2m2 = gr::blocks::complex_to_mag_squared::make();
-		conj = gr::blocks::multiply_conjugate_cc::make();
-		c2a = gr::blocks::complex_to_arg::make();
-		signal = boost::make_shared<signal_sample>();
-		adc_conv = boost::make_shared<adc_sample_conv>(2, m2k_adc);
-
-		adc_conv->setCorrectionGain(0,
-			m2k_adc->chnCorrectionGain(0));
-		adc_conv->setCorrectionGain(1,
-			m2k_adc->chnCorrectionGain(1));
-
-		capture_top_block->connect(capture1, 0, f11, 0);
-		capture_top_block->connect(capture2, 0, f21, 0);
-		capture_top_block->connect(f11, 0, f12, 0);
-		capture_top_block->connect(f21, 0, f22, 0);
-		capture_top_block->connect(f12, 0, s2f1, 0);
-		capture_top_block->connect(f22, 0, s2f2, 0);
-		capture_top_block->connect(s2f1, 0, dc_cancel1, 0);
-		capture_top_block->connect(s2f2, 0, dc_cancel2, 0);
-
-		capture_top_block->connect(dc_cancel1, 0, goertzel1, 0);
-		capture_top_block->connect(dc_cancel2, 0, goertzel2, 0);
-		capture_top_block->connect(goertzel1, 0, c2m1, 0);
-		capture_top_block->connect(c2m1, 0, signal, 0);
-		capture_top_block->connect(goertzel2, 0, c2m2, 0);
-		capture_top_block->connect(c2m2, 0, signal, 1);
-
-		capture_top_block->connect(goertzel1, 0, conj, 0);
-		capture_top_block->connect(goertzel2, 0, conj, 1);
-		capture_top_block->connect(conj, 0, c2a, 0);
-		capture_top_block->connect(c2a, 0, signal, 2);
-
-		mag1 = 0.0, mag2 = 0.0, phase = 0.0;
-		connect(&*signal, &signal_sample::triggered,
-		[&](const std::vector<float> values) {
-			mag1 = values[0];
-			mag2 = values[1];
-			phase = values[2];
-			captureDone = true;
-		});
+/* Limits of the single capture multisine sweep */
+static const size_t max_multisine_dac_samples = 128 * 1024;
+static const size_t max_multisine_capture = 1024 * 1024;
 
-		capture_top_block->connect(dc_cancel1, 0, adc_conv, 0);
-		capture_top_block->connect(dc_cancel2, 0, adc_conv, 1);
-		capture_top_block->connect(adc_conv, 0, sink1, 0);
-		capture_top_block->connect(adc_conv, 1, sink2, 0);
-	}
+/* Captures of one point at most while waiting for it to settle */
+static const unsigned int max_adaptive_captures = 4;
+
+/* Upper bound of the raw samples kept for the repeated sweeps (32 MiB) */
+static const size_t max_cached_waveform_samples = 16 * 1024 * 1024;
 
-	// Build the flowgraph only once
-	m_initFlowgraph = false;
+bool NetworkAnalyzer::WaveformKey::operator<(const WaveformKey& other) const
+{
+	return std::tie(frequency, amplitude, offset, coefficient, rate,
+			samples_count) <
+		std::tie(other.frequency, other.amplitude, other.offset,
+			 other.coefficient, other.rate, other.samples_count);
 }
 
 NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
@@ -179,10 +108,10 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 	d_cursorsEnabled(false),
 	m_stop(true), amp1(nullptr), amp2(nullptr),
 	wheelEventGuard(nullptr), wasChecked(false),
-	dacs(dacs), justStarted(false),
+	dacs(dacs), justStarted(false), sweepRepeats(1), harmonicsCount(0),
 	iterationsThreadCanceled(false), iterationsThreadReady(false),
 	iterationsThread(nullptr), autoAdjustGain(true),
-	filterDc(false), m_initFlowgraph(true), m_hasReference(false),
+	filterDc(false), waveformCacheSamples(0), m_hasReference(false),
 	m_importDataLoaded(false)
 {
 	iio = iio_manager::get_instance(ctx,
@@ -199,6 +128,16 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 		}
 	}
 
+	// Get the available sample rates for the m2k-adc and the DACs,
+	// read once since the frequency array is built from them
+	// Make sure the values are sorted in ascending order (1000,..,100e6)
+	sampleRates = SignalGenerator::get_available_sample_rates(adc);
+	qSort(sampleRates.begin(), sampleRates.end(), qLess<unsigned long>());
+	dacSampleRates = SignalGenerator::get_available_sample_rates(
+				iio_channel_get_device(dac_channels[0]));
+	qSort(dacSampleRates.begin(), dacSampleRates.end(),
+	      qLess<unsigned long>());
+
 	/* FIXME: TODO: Move this into a HW class / lib M2k */
 	struct iio_device *fabric = iio_context_find_device(ctx, "m2k-fabric");
 
@@ -214,6 +153,8 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 
 	ui->setupUi(this);
 
+	qRegisterMetaType<QVector<double>>("QVector<double>");
+
 	bufferPreviewer = new NetworkAnalyzerBufferViewer();
 	bufferPreviewer->setVisible(false);
 
@@ -352,8 +293,38 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 	captureDelay->setStep(10);
 	captureDelay->setToolTip(tr("After Buffer"));
 
+	adaptiveBox = new QCheckBox(tr("Adaptive settling"), this);
+	adaptiveBox->setToolTip(tr("Wait a few periods of each frequency, "
+				   "at most the settling times, and capture "
+				   "again until the response is stable"));
+
 	ui->pushDelayLayout->addWidget(pushDelay);
 	ui->captureDelayLayout->addWidget(captureDelay);
+	ui->captureDelayLayout->addWidget(adaptiveBox);
+
+	multisineBox = new QCheckBox(tr("Single capture (multisine)"), this);
+	multisineBox->setToolTip(tr("Play all the frequencies at once and "
+				    "measure them from one capture, faster "
+				    "but with less dynamic range"));
+	ui->captureDelayLayout->addWidget(multisineBox);
+
+	reprocessWindowCmb = new QComboBox(this);
+	reprocessWindowCmb->addItems({ tr("Rectangular"), tr("Hann"),
+				       tr("Blackman-Harris") });
+	reprocessWindowCmb->setToolTip(tr("Window of the reprocessing"));
+	reprocessBtn = new QPushButton(tr("Reprocess"), this);
+	reprocessBtn->setMinimumSize(ui->viewInOscBtn->minimumSize());
+	reprocessBtn->setStyleSheet(ui->viewInOscBtn->styleSheet());
+	reprocessBtn->setToolTip(tr("Compute the sweep again from the "
+				    "stored buffers, with the current DC "
+				    "filter and window"));
+	ui->horizontalLayout_20->addWidget(reprocessWindowCmb);
+	ui->horizontalLayout_20->addWidget(reprocessBtn);
+
+	connect(reprocessBtn, &QPushButton::clicked,
+		this, &NetworkAnalyzer::reprocess);
+	connect(&reprocessWatcher, &QFutureWatcher<void>::finished,
+		this, &NetworkAnalyzer::_reprocessDone);
 	startStopRange->insertWidgetIntoLayout(samplesCount, 2, 1);
 	ui->amplitudeLayout->addWidget(amplitude);
 	ui->offsetLayout->addWidget(offset);
@@ -627,8 +598,6 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 	connect(ui->dcFilterBtn, &QPushButton::toggled, [=](bool checked){
 		if (checked != filterDc) {
 			filterDc = checked;
-			dc_cancel1->set_enabled(filterDc);
-			dc_cancel2->set_enabled(filterDc);
 		}
 	});
 
@@ -656,7 +625,8 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 	connect(ui->importBtn, &QPushButton::clicked, [=](){
 		QString fileName = QFileDialog::getOpenFileName(this,
 		    tr("Import"), "", tr("Comma-separated values files (*.csv);;"
-					       "Tab-delimited values files (*.txt)"),
+					       "Tab-delimited values files (*.txt);;"
+					       "Compressed capture archives (*.scarc)"),
 		    nullptr, (m_useNativeDialogs ? QFileDialog::Options() : QFileDialog::DontUseNativeDialog));
 
 		FileManager fm("Network Analyzer");
@@ -667,17 +637,15 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 			ui->importFileLineEdit->setText(fileName);
 			ui->importFileLineEdit->setToolTip(fileName);
 
+			m_importData = fm.readColumns();
+			if (m_importData.size() < 3) {
+				throw FileManagerException("File is corrupted!");
+			}
 			m_importDataLoaded = true;
-			m_importData = fm.read();
 
-			QVector<double> frequency, magnitude, phase;
-
-			for (size_t i = 0; i < m_importData.size(); ++i) {
-				frequency.push_back(m_importData[i][0]);
-				qDebug() << frequency.back();
-				magnitude.push_back(m_importData[i][1]);
-				phase.push_back(m_importData[i][2]);
-			}
+			const QVector<double> &frequency = m_importData[0];
+			const QVector<double> &magnitude = m_importData[1];
+			const QVector<double> &phase = m_importData[2];
 
 			m_dBgraph.addReferenceWaveform(frequency, magnitude);
 			m_phaseGraph.addReferenceWaveform(frequency, phase);
@@ -689,9 +657,6 @@ NetworkAnalyzer::NetworkAnalyzer(struct iio_context *ctx, Filter *filt,
 		}
 
 	});
-
-	_configureDacFlowgraph();
-	_configureAdcFlowgraph();
 }
 
 NetworkAnalyzer::~NetworkAnalyzer()
@@ -700,13 +665,12 @@ NetworkAnalyzer::~NetworkAnalyzer()
 		   &NetworkAnalyzer::readPreferences);
 	startStop(false);
 	ui->runSingleWidget->toggle(false);
+	reprocessWatcher.waitForFinished();
 
 	if (saveOnExit) {
 		api->save(*settings);
 	}
 
-	top_block->disconnect_all();
-
 	if (iterationsThread) {
 		if (iterationsThread->joinable()) {
 			iterationsThreadCanceled = true;
@@ -769,11 +733,50 @@ void NetworkAnalyzer::computeIterations()
 		}
 	}
 
+	// The points change, their statistics no longer apply
+	pointStatistics.clear();
+
+	// The UI is only read here, the thread gets a copy of the settings
+	SweepSettings settings;
+	settings.min_freq = startStopRange->getStartValue();
+	settings.max_freq = startStopRange->getStopValue();
+	settings.steps = (unsigned int) samplesCount->value();
+	settings.is_log = ui->btnIsLog->isChecked();
+
 	// at this point no other thread is using iterationsThreadReady
 	// it is safe to modify without using a lock
 	iterationsThreadCanceled = false;
 	iterationsThreadReady = false;
-	iterationsThread = new boost::thread(boost::bind(&NetworkAnalyzer::computeFrequencyArray, this));
+
+	// A sweep that was already computed starts right away
+	for (int i = 0; i < iterationsCache.size(); i++) {
+		if (iterationsCache[i].first == settings) {
+			iterationsCache.move(i, 0);
+
+			{
+				boost::unique_lock<boost::mutex> lock(
+					iterationsReadyMutex);
+				iterations = iterationsCache.first().second;
+				iterationsThreadReady = true;
+			}
+
+			QMetaObject::invokeMethod(this,
+						  "updateNumSamples",
+						  Qt::QueuedConnection,
+						  Q_ARG(bool, true));
+			iterationsReadyCv.notify_one();
+			return;
+		}
+	}
+
+	iterationsThread = new boost::thread(boost::bind(
+			&NetworkAnalyzer::computeFrequencyArray, this, settings));
+}
+
+bool NetworkAnalyzer::SweepSettings::operator==(const SweepSettings& other) const
+{
+	return min_freq == other.min_freq && max_freq == other.max_freq &&
+		steps == other.steps && is_log == other.is_log;
 }
 
 void NetworkAnalyzer::setMinimumDistanceBetween(SpinBoxA *min, SpinBoxA *max,
@@ -843,6 +846,8 @@ void NetworkAnalyzer::on_btnExport_clicked()
 	QStringList filter;
 	filter += QString(tr("Comma-separated values files (*.csv)"));
 	filter += QString(tr("Tab-delimited values files (*.txt)"));
+	filter += QString(tr("NumPy array files (*.npy)"));
+	filter += QString(tr("Compressed capture archives (*.scarc)"));
 	filter += QString(tr("All Files(*)"));
 
 	QString selectedFilter = filter[0];
@@ -858,18 +863,20 @@ void NetworkAnalyzer::on_btnExport_clicked()
 	}
 
 	if (!fileName.isEmpty()) {
-		FileManager fm("Network Analyzer");
+		std::shared_ptr<FileManager> fm =
+			std::make_shared<FileManager>("Network Analyzer");
 
-		fm.open(fileName, FileManager::EXPORT);
+		fm->open(fileName, FileManager::EXPORT);
 
-		fm.setAdditionalInformation(ui->btnRefChn->isChecked() ?
+		fm->setAdditionalInformation(ui->btnRefChn->isChecked() ?
 					    "Reference channel: 1" : "Reference channel: 2");
 
-		fm.save(m_dBgraph.getXAxisData(), "Frequency(Hz)");
-		fm.save(m_dBgraph.getYAxisData(), "Magnitude(dB)");
-		fm.save(m_phaseGraph.getYAxisData(), "Phase(°)");
+		/* Copies, a new sweep can run while they are written */
+		fm->save(m_dBgraph.getXAxisData(), "Frequency(Hz)");
+		fm->save(m_dBgraph.getYAxisData(), "Magnitude(dB)");
+		fm->save(m_phaseGraph.getYAxisData(), "Phase(°)");
 
-		fm.performWrite();
+		ExportService::instance()->start(this, fileName, fm);
 	}
 }
 
@@ -932,12 +939,9 @@ void NetworkAnalyzer::updateGainMode()
 	}
 }
 
-unsigned long NetworkAnalyzer::_getBestSampleRate(double frequency, const struct iio_device *dev)
+unsigned long NetworkAnalyzer::_getBestSampleRate(double frequency,
+		const QVector<unsigned long>& values)
 {
-	QVector<unsigned long> values = SignalGenerator::get_available_sample_rates(dev);
-
-	qSort(values.begin(), values.end(), qLess<unsigned long>());
-
 	for (const auto &rate : values) {
 		if (rate == values[0]) {
 			continue;
@@ -1006,20 +1010,20 @@ size_t NetworkAnalyzer::_getSamplesCount(double frequency, unsigned long rate, b
 	return size;
 }
 
-void NetworkAnalyzer::computeFrequencyArray()
+void NetworkAnalyzer::computeFrequencyArray(SweepSettings settings)
 {
 	boost::unique_lock<boost::mutex> lock(iterationsReadyMutex);
 
 	iterations.clear();
 
-	unsigned int steps = (unsigned int) samplesCount->value();
-	double min_freq = startStopRange->getStartValue();
-	double max_freq = startStopRange->getStopValue();
+	unsigned int steps = settings.steps;
+	double min_freq = settings.min_freq;
+	double max_freq = settings.max_freq;
 	double log10_min_freq = log10(min_freq);
 	double log10_max_freq = log10(max_freq);
 	double step;
 
-	bool is_log = ui->btnIsLog->isChecked();
+	bool is_log = settings.is_log;
 
 	if (is_log) {
 		step = (log10_max_freq - log10_min_freq) / (double)(steps - 1);
@@ -1027,25 +1031,39 @@ void NetworkAnalyzer::computeFrequencyArray()
 		step = (max_freq - min_freq) / (double)(steps - 1);
 	}
 
+	// The frequencies first, in a loop the compiler can vectorize
+	std::vector<double> frequencies(steps);
+
+	for (unsigned int i = 0; i < steps; ++i) {
+		frequencies[i] = is_log ?
+			pow(10.0, log10_min_freq + (double) i * step) :
+			min_freq + (double) i * step;
+	}
+
 	for (unsigned int i = 0; i < steps; ++i) {
 
 		if (iterationsThreadCanceled) {
 			return;
 		}
 
-		double frequency = 0.0;
-
-		if (is_log) {
-			frequency = pow(10.0,
-					log10_min_freq + (double) i * step);
-		} else {
-			frequency = min_freq + (double) i * step;
-		}
+		double frequency = frequencies[i];
 
-		unsigned long rate = _getBestSampleRate(frequency, iio_channel_get_device(dac_channels[0]));
+		unsigned long rate = _getBestSampleRate(frequency, dacSampleRates);
 		size_t bufferSize = _getSamplesCount(frequency, rate);
 
-		iterations.push_back(networkIteration(frequency, rate, bufferSize));
+		size_t captureSize = 0;
+		size_t captureRate = 0;
+		computeCaptureParams(frequency, captureSize, captureRate);
+		captureSize = groupCaptureSize(captureSize);
+
+		iterations.push_back(networkIteration(frequency, rate, bufferSize,
+						      captureRate, captureSize));
+	}
+
+	// Only read by computeIterations() once this thread is joined
+	iterationsCache.prepend(qMakePair(settings, iterations));
+	while (iterationsCache.size() > max_cached_sweeps) {
+		iterationsCache.removeLast();
 	}
 
 	// Needs to be invoked on the main thread
@@ -1059,40 +1077,10 @@ void NetworkAnalyzer::computeFrequencyArray()
 	iterationsReadyCv.notify_one();
 }
 
-void NetworkAnalyzer::setFilterParameters()
-{
-
-	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
-
-	f11->set_enable(iio->freq_comp_filt[0][0]->get_enable());
-	f12->set_enable(iio->freq_comp_filt[0][1]->get_enable());
-	f21->set_enable(iio->freq_comp_filt[1][0]->get_enable());
-	f22->set_enable(iio->freq_comp_filt[1][1]->get_enable());
-
-	f11->set_TC(iio->freq_comp_filt[0][0]->get_TC());
-	f12->set_TC(iio->freq_comp_filt[0][1]->get_TC());
-	f21->set_TC(iio->freq_comp_filt[1][0]->get_TC());
-	f22->set_TC(iio->freq_comp_filt[1][1]->get_TC());
-
-	f11->set_filter_gain(iio->freq_comp_filt[0][0]->get_filter_gain());
-	f12->set_filter_gain(iio->freq_comp_filt[0][1]->get_filter_gain());
-	f21->set_filter_gain(iio->freq_comp_filt[1][0]->get_filter_gain());
-	f22->set_filter_gain(iio->freq_comp_filt[1][1]->get_filter_gain());
-
-	f11->set_sample_rate(m2k_adc->sampleRate());
-	f12->set_sample_rate(m2k_adc->sampleRate());
-	f21->set_sample_rate(m2k_adc->sampleRate());
-	f22->set_sample_rate(m2k_adc->sampleRate());
-
-	f11->set_high_gain(m2k_adc->chnHwGainMode(0));
-	f12->set_high_gain(m2k_adc->chnHwGainMode(0));
-	f21->set_high_gain(m2k_adc->chnHwGainMode(1));
-	f22->set_high_gain(m2k_adc->chnHwGainMode(1));
-}
-
 void NetworkAnalyzer::goertzel()
 {
 	// Network Analyzer run method using the Goertzel Algorithm (single bin DFT)
+	ThreadScheduling::AcquisitionScope acquisitionScope;
 
 	// Enable the available dac channels
 	for (auto& channel : dac_channels) {
@@ -1101,7 +1089,6 @@ void NetworkAnalyzer::goertzel()
 
 	// Adjust the gain of the ADC channels based on sweep settings
 	updateGainMode();
-	setFilterParameters();
 
 	// Wait for the iterations thread to finish
 	boost::unique_lock<boost::mutex> lock(iterationsReadyMutex);
@@ -1114,189 +1101,796 @@ void NetworkAnalyzer::goertzel()
 
 	justStarted = true;
 
-	for (int i = 0; !m_stop && i < iterations.size(); ++i) {
+	if (multisineBox->isChecked()) {
+		for (unsigned int r = 0; r < sweepRepeats && !m_stop; r++) {
+			multisineSweep();
+		}
+		Q_EMIT sweepDone();
+		return;
+	}
+
+	/*
+	 * The sweep is pipelined: while point i is played and captured,
+	 * the samples for the DAC waveforms of point i + 1 are computed
+	 * on a worker thread. The Goertzel processing is a single pass
+	 * over the ADC buffer, cheap enough to run right after the refill.
+	 */
+	QFuture<QVector<waveform_sptr>> nextWaves;
+
+	/*
+	 * The ADC buffer lives as long as the capture size and rate stay
+	 * the same, which saves the DMA setup and teardown of the points
+	 * in between. With a single kernel buffer each refill still only
+	 * holds samples taken after it was requested.
+	 */
+	size_t adc_buffer_size = 0;
+	size_t adc_buffer_rate = 0;
+
+	configureAdcCapture();
+
+	auto destroyAdcBuffer = [&]() {
+		if (adc_buffer) {
+			iio_buffer_destroy(adc_buffer);
+			adc_buffer = nullptr;
+		}
+	};
+
+	/*
+	 * The repeats of the sweep run the same iterations, their waveforms
+	 * come from the cache and the ADC buffer is kept from one to the
+	 * next; each point is accumulated in pointStatistics by plot().
+	 */
+	for (unsigned int repeat = 0; repeat < sweepRepeats && !m_stop; repeat++) {
+		if (!iterations.isEmpty()) {
+			nextWaves = QtConcurrent::run(this,
+					&NetworkAnalyzer::computeSinWaves,
+					iterations[0].frequency, amplitude->value(),
+					offset->value(), iterations[0].rate,
+					iterations[0].bufferSize);
+		}
+
+		for (int i = 0; !m_stop && i < iterations.size(); ++i) {
 
-		// Get current sweep settings
-		unsigned long rate = iterations[i].rate;
-		size_t samples_count = iterations[i].bufferSize;
-		double frequency = iterations[i].frequency;
+			// Get current sweep settings
+			unsigned long rate = iterations[i].rate;
+			size_t samples_count = iterations[i].bufferSize;
+			double frequency = iterations[i].frequency;
+
+			QVector<waveform_sptr> waves = nextWaves.result();
+
+			if (i + 1 < iterations.size()) {
+				nextWaves = QtConcurrent::run(this,
+						&NetworkAnalyzer::computeSinWaves,
+						iterations[i + 1].frequency,
+						amplitude->value(), offset->value(),
+						iterations[i + 1].rate,
+						iterations[i + 1].bufferSize);
+			}
 
-		double amplitudeValue = amplitude->value();
-		double offsetValue = offset->value();
+			// Create and push the generated sine waves to the DACs
+			QVector<struct iio_buffer *> buffers;
 
-		// Create and push the generated sine waves to the DACs
-		QVector<struct iio_buffer *> buffers;
+			for (int c = 0; c < dac_channels.size(); c++) {
+				const struct iio_device *dev =
+					iio_channel_get_device(dac_channels[c]);
+				iio_device_attr_write_bool(dev, "dma_sync", true);
+				struct iio_buffer *buf_dac = pushSinWave(dev, *waves[c],
+							     rate);
+				buffers.push_back(buf_dac);
 
-		for (const auto& channel : dac_channels) {
-			const struct iio_device *dev = iio_channel_get_device(channel);
-			iio_device_attr_write_bool(dev, "dma_sync", true);
-			struct iio_buffer *buf_dac = generateSinWave(dev,
-						     frequency, amplitudeValue, offsetValue,
-						     rate, samples_count);
-			buffers.push_back(buf_dac);
+				if (!buf_dac) {
+					qCritical() << "Unable to create DAC buffer";
+					break;
+				}
+			}
 
-			if (!buf_dac) {
-				qCritical() << "Unable to create DAC buffer";
-				break;
+			// Sleep before DACs start
+			QThread::msleep(settlingDelay(frequency, pushDelay->value()));
+			for (const auto& channel : dac_channels) {
+				const struct iio_device *dev = iio_channel_get_device(channel);
+				iio_device_attr_write_bool(dev, "dma_sync", false);
 			}
-		}
 
-		// Sleep before DACs start
-		QThread::msleep(pushDelay->value());
-		for (const auto& channel : dac_channels) {
-			const struct iio_device *dev = iio_channel_get_device(channel);
-			iio_device_attr_write_bool(dev, "dma_sync", false);
-		}
 
+			// Capture params for the ADC
+			size_t buffer_size = iterations[i].captureSize;
+			size_t adc_rate = iterations[i].captureRate;
+
+			if (buffer_size == 0) {
+				CAT_DEBUG(CAT_NETWORK_ANALYZER) << "buffer size 0";
+				for (auto& buffer : buffers) {
+					iio_buffer_destroy(buffer);
+				}
+				destroyAdcBuffer();
+				nextWaves.waitForFinished();
+				return;
+			}
+
+			if (buffer_size != adc_buffer_size || adc_rate != adc_buffer_rate) {
+				destroyAdcBuffer();
+				adc_dev->setSampleRate(adc_rate);
+				adc_buffer = iio_device_create_buffer(adc, buffer_size,
+								      false);
+				adc_buffer_size = buffer_size;
+				adc_buffer_rate = adc_rate;
+			}
 
-		size_t buffer_size = 0;
-		size_t adc_rate = 0;
+			if (!adc_buffer) {
+				qCritical() << "Unable to create ADC buffer";
+			} else {
+				PIPELINE_TRACE("iio_buffer_refill");
+				iio_buffer_refill(adc_buffer);
+			}
 
-		// Compute capture params for the ADC
-		computeCaptureParams(frequency, buffer_size, adc_rate);
+			if (!adc_buffer || m_stop) {
+				destroyAdcBuffer();
+				for (auto& buffer : buffers) {
+					iio_buffer_destroy(buffer);
+				}
+				nextWaves.waitForFinished();
+				return;
+			}
 
-		iio_device_attr_write_double(adc, "oversampling_ratio", 1);
-		adc_dev->setSampleRate(adc_rate);
+			/*
+			 * In adaptive mode the point is captured again until two
+			 * consecutive estimates agree, the response has then settled
+			 */
+			CaptureResult result, previous;
+			bool valid = processCapture(frequency, adc_rate, adc_buffer,
+						    result);
+
+			for (unsigned int n = 1; valid && adaptiveBox->isChecked() &&
+					n < max_adaptive_captures && !m_stop; n++) {
+				std::swap(previous, result);
+				{
+					PIPELINE_TRACE("iio_buffer_refill");
+					iio_buffer_refill(adc_buffer);
+				}
+				valid = processCapture(frequency, adc_rate, adc_buffer,
+						       result);
 
-		auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
-		double corr_gain = 1.0;
-		double hw_gain = 1.0;
+				if (valid && isSteadyState(previous, result)) {
+					break;
+				}
+			}
 
-		corr_gain = m2k_adc->chnCorrectionGain(1);
-		hw_gain = m2k_adc->gainAt(m2k_adc->chnHwGainMode(1));
+			if (valid && !m_stop) {
+				publishCapture(frequency, adc_rate, result);
+			}
 
-		if (buffer_size == 0) {
-			qDebug(CAT_NETWORK_ANALYZER) << "buffer size 0";
-			return;
+			// The DAC buffers are cyclic and hold this point's waveform,
+			// they can not be refilled with the next one
+			for (auto& buffer : buffers) {
+				iio_buffer_destroy(buffer);
+			}
+
+			// Sleep before ADC capture
+			QThread::msleep(settlingDelay(frequency, captureDelay->value()));
 		}
+	}
+
+	destroyAdcBuffer();
+	nextWaves.waitForFinished();
+
+	Q_EMIT sweepDone();
+}
+
+namespace {
+/* The frequency compensation of the ADC front end, as in
+ * frequency_compensation_filter, one sample at a time */
+struct CompensationStage {
+	bool enable;
+	float alpha;
+	float gain;
+	short prev;
+	float state;
+
+	CompensationStage(const frequency_compensation_filter::sptr& filt,
+			  int gain_mode, double sample_rate)
+	{
+		float tc = filt->get_TC(gain_mode) * 1.0E-6f;
+
+		enable = filt->get_enable(gain_mode);
+		alpha = tc / (tc + 1.0f / sample_rate);
+		gain = filt->get_filter_gain(gain_mode);
+		prev = 0;
+		state = 0;
+	}
 
-		dc_cancel1->set_buffer_size(buffer_size);
-		dc_cancel2->set_buffer_size(buffer_size);
+	/* The first output needs the second input */
+	short first(short in0, short in1)
+	{
+		prev = in0;
+		state = in1 - in0;
+		return enable ? in0 + (short)(state * gain) : in0;
+	}
 
-		goertzel1->set_freq(frequency);
-		goertzel2->set_freq(frequency);
-		goertzel1->set_len(buffer_size);
-		goertzel2->set_len(buffer_size);
-		goertzel1->set_rate(adc_rate);
-		goertzel2->set_rate(adc_rate);
+	short next(short in)
+	{
+		state = alpha * (state + (float)(in - prev));
+		prev = in;
+		return enable ? in + (short)(state * gain) : in;
+	}
+};
 
+std::vector<CompensationStage> compensationStages(
+		const frequency_compensation_filter::sptr (*filt)[2],
+		const std::shared_ptr<M2kAdc>& m2k_adc, double sample_rate)
+{
+	std::vector<CompensationStage> stages;
 
-		setFilterParameters();
-		// TODO: Use libm2k here
+	for (int ch = 0; ch < 2; ch++) {
+		int gain_mode = m2k_adc->chnHwGainMode(ch);
 
-		std::vector<struct iio_channel *> adc_channels;
+		stages.emplace_back(filt[ch][0], gain_mode, sample_rate);
+		stages.emplace_back(filt[ch][1], gain_mode, sample_rate);
+	}
 
-		unsigned int nb_channels = iio_device_get_channels_count(adc);
-		for (unsigned int i = 0; i < nb_channels; i++) {
-			iio_channel_disable(iio_device_get_channel(adc, i));
-		}
-		for (unsigned int i = 0; i < nb_channels; i++) {
-			struct iio_channel *chn =
-					iio_device_get_channel(adc, i);
-			iio_channel_enable(chn);
-			adc_channels.push_back(chn);
+	return stages;
+}
+
+/*
+ * Both channels of a deinterleaved int16 capture through their two
+ * compensation stages, f(index, channel, sample) for every output
+ */
+template<typename F>
+void forEachCompensated(std::vector<CompensationStage>& stages,
+		const int16_t *const *samples, size_t len, F f)
+{
+	short prev1[2];
+
+	for (int ch = 0; ch < 2; ch++) {
+		short y0 = stages[2 * ch].first(samples[ch][0], samples[ch][1]);
+		short y1 = stages[2 * ch].next(samples[ch][1]);
+
+		prev1[ch] = y1;
+		f(0, ch, stages[2 * ch + 1].first(y0, y1));
+	}
+
+	for (size_t i = 1; i < len; i++) {
+		for (int ch = 0; ch < 2; ch++) {
+			short y = i == 1 ? prev1[ch] :
+				stages[2 * ch].next(samples[ch][i]);
+
+			f(i, ch, stages[2 * ch + 1].next(y));
 		}
+	}
+}
 
+struct GoertzelState {
+	double q1;
+	double q2;
 
-		adc_buffer = iio_device_create_buffer(adc, buffer_size, false);
+	GoertzelState() : q1(0), q2(0) {}
 
-		size_t ret = iio_buffer_refill(adc_buffer);
-		if (m_stop) {
-			iio_buffer_destroy(adc_buffer);
-			adc_buffer = nullptr;
-			for (auto& buffer : buffers) {
-				iio_buffer_destroy(buffer);
-			}
-			return;
+	void push(double coeff, double x)
+	{
+		double q0 = x + coeff * q1 - q2;
+
+		q2 = q1;
+		q1 = q0;
+	}
+
+	/* Same output as gr::fft::goertzel, so the phase keeps its sign */
+	std::complex<double> output(double w, size_t len) const
+	{
+		return std::complex<double>(q1 * std::cos(w) - q2,
+					    -q1 * std::sin(w)) / (double)len;
+	}
+};
+
+/*
+ * Goertzel recurrences of several bins side by side, with the states of
+ * all the bins in arrays: a sample updates every bin in one loop that
+ * the compiler vectorizes, instead of one GoertzelState per bin.
+ */
+struct GoertzelBank {
+	std::vector<double> w;
+	std::vector<double> coeff;
+	std::vector<double> q1;
+	std::vector<double> q2;
+
+	explicit GoertzelBank(const std::vector<double>& bins_w) :
+		w(bins_w), coeff(bins_w.size()),
+		q1(bins_w.size(), 0.0), q2(bins_w.size(), 0.0)
+	{
+		for (size_t k = 0; k < w.size(); k++) {
+			coeff[k] = 2.0 * std::cos(w[k]);
 		}
+	}
 
-		std::vector<std::vector<short>> data;
+	std::complex<double> output(size_t k, size_t len) const
+	{
+		GoertzelState s;
 
-		for (int i = 0; i < 2; ++i) {
-			std::vector<short> d;
-			for (int j = 0; j < buffer_size; ++j) {
-				d.push_back(j);
-			}
-			data.push_back(d);
+		s.q1 = q1[k];
+		s.q2 = q2[k];
+		return s.output(w[k], len);
+	}
+
+	void push(double x)
+	{
+		const size_t n = coeff.size();
+		const double *c = coeff.data();
+		double *s1 = q1.data();
+		double *s2 = q2.data();
+
+		for (size_t k = 0; k < n; k++) {
+			double q0 = x + c[k] * s1[k] - s2[k];
+
+			s2[k] = s1[k];
+			s1[k] = q0;
 		}
+	}
 
-		for (auto chn : adc_channels) {
-			ptrdiff_t p_inc = iio_buffer_step(adc_buffer);
-			uintptr_t p_dat;
-			uintptr_t p_end = (uintptr_t)iio_buffer_end(adc_buffer);
-			unsigned int i;
-			for (i = 0, p_dat = (uintptr_t)iio_buffer_first(adc_buffer, adc_channels[0]);
-					p_dat < p_end; p_dat += p_inc, i++)
-			{
-				for (unsigned int ch = 0; ch < data.size(); ch++) {
-					data[ch][i] = ((int16_t*)p_dat)[ch];
-				}
-			}
+	/* The output of bin k, without the part a constant level of dc
+	 * gave, dc times the states of a bank fed with ones */
+	std::complex<double> output(size_t k, size_t len,
+			const GoertzelBank& unit, double dc) const
+	{
+		GoertzelState s;
+
+		s.q1 = q1[k] - dc * unit.q1[k];
+		s.q2 = q2[k] - dc * unit.q2[k];
+		return s.output(w[k], len);
+	}
+};
+}
+
+void NetworkAnalyzer::configureAdcCapture()
+{
+	// TODO: Use libm2k here
+	iio->set_kernel_buffers_count(1);
+	iio_device_attr_write_double(adc, "oversampling_ratio", 1);
+
+	unsigned int nb_channels = iio_device_get_channels_count(adc);
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		iio_channel_disable(iio_device_get_channel(adc, i));
+	}
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		iio_channel_enable(iio_device_get_channel(adc, i));
+	}
+}
+
+/*
+ * All the sweep frequencies at once: the DACs play a multisine with a
+ * tone near each of them, the ADC captures one period of it and the
+ * transfer function is read from the FFT bins of the tones. The tones
+ * are multiples of the multisine's fundamental, so points closer than
+ * that share a tone.
+ */
+void NetworkAnalyzer::multisineSweep()
+{
+	if (iterations.isEmpty() || dac_channels.isEmpty()) {
+		return;
+	}
+
+	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
+	QVector<double> freqs;
+
+	for (const auto& it : iterations) {
+		freqs.push_back(it.frequency);
+	}
+	qSort(freqs.begin(), freqs.end(), qLess<double>());
+
+	// The tones must stay apart at the low end of the sweep
+	double resolution = freqs.first();
+	for (int i = 1; i < freqs.size(); i++) {
+		if (freqs[i] > freqs[i - 1]) {
+			resolution = std::min(resolution, freqs[i] - freqs[i - 1]);
 		}
+	}
 
-		capture1->rewind();
-		capture1->set_data(data[0]);
-		capture2->rewind();
-		capture2->set_data(data[1]);
+	const QVector<unsigned long>& dac_rates = dacSampleRates;
 
-		{
-			boost::unique_lock<boost::mutex> lock(bufferMutex);
-			sink1->reset();
-			sink2->reset();
+	unsigned long dac_rate = 0;
+	for (const auto& rate : dac_rates) {
+		if (rate / freqs.last() >= 10.0) {
+			dac_rate = rate;
+			break;
 		}
+	}
+	if (!dac_rate && !dac_rates.isEmpty() &&
+			dac_rates.last() / freqs.last() >= 2.5) {
+		dac_rate = dac_rates.last();
+	}
+
+	size_t ignored = 0, adc_rate = 0;
+	computeCaptureParams(freqs.last(), ignored, adc_rate);
+
+	if (!dac_rate || !adc_rate) {
+		qDebug(CAT_NETWORK_ANALYZER) << "No sample rates for the multisine";
+		return;
+	}
+
+	/*
+	 * One period of the DAC buffer has to be a whole number of ADC
+	 * samples, and the DAC buffer size a multiple of 4. a ends up as
+	 * the greatest common divisor of the two rates.
+	 */
+	unsigned long a = dac_rate, b = adc_rate;
+	while (b) {
+		unsigned long t = a % b;
+		a = b;
+		b = t;
+	}
+	size_t dac_period = dac_rate / a;
+	size_t adc_period = adc_rate / a;
+	size_t multiple = dac_period;
+	while (multiple % 4) {
+		multiple *= 2;
+	}
 
-		captureDone = false;
+	double adc_per_dac = (double)adc_rate / dac_rate;
+	size_t max_samples = std::min<size_t>(max_multisine_dac_samples,
+			max_multisine_capture / adc_per_dac);
+	size_t samples = std::ceil(dac_rate / resolution);
 
-		QElapsedTimer t;
-		t.start();
-		// Sleep before ADC capture
-		QThread::msleep(captureDelay->value());
+	samples = std::max<size_t>(samples, SignalGenerator::min_buffer_size);
+	samples = std::min(samples, max_samples);
+	samples = std::max<size_t>(1, samples / multiple) * multiple;
 
-		capture_top_block->run();
+	size_t capture_size = samples / dac_period * adc_period;
+	double fundamental = (double)dac_rate / samples;
+	size_t max_bin = std::min(samples, capture_size) / 2 - 1;
 
-		float dcOffset = 0.0;
-		dcOffset = dc_cancel2->get_dc_offset();
-		dcOffset = adc_sample_conv::convSampleToVolts(dcOffset,
-							corr_gain, 1, 0, hw_gain);
+	std::vector<size_t> point_bins;
+	std::vector<size_t> tones;
 
+	for (const auto& it : iterations) {
+		long bin = std::lround(it.frequency / fundamental);
+		point_bins.push_back(std::min<size_t>(max_bin,
+					std::max(1L, bin)));
+	}
+	tones = point_bins;
+	std::sort(tones.begin(), tones.end());
+	tones.erase(std::unique(tones.begin(), tones.end()), tones.end());
 
-		// Clear the iio_buffers that were created
+	// Play the multisine on all the DACs
+	QVector<struct iio_buffer *> buffers;
+	auto destroyBuffers = [&]() {
 		for (auto& buffer : buffers) {
-			iio_buffer_destroy(buffer);
+			if (buffer) {
+				iio_buffer_destroy(buffer);
+			}
 		}
+		buffers.clear();
+	};
 
+	for (const auto& channel : dac_channels) {
+		const struct iio_device *dev = iio_channel_get_device(channel);
+		std::vector<short> wave = computeMultisine(dev, dac_rate,
+				samples, tones, amplitude->value(),
+				offset->value());
+
+		iio_device_attr_write_bool(dev, "dma_sync", true);
+		struct iio_buffer *buf_dac = pushSinWave(dev, wave, dac_rate);
+		buffers.push_back(buf_dac);
+
+		if (!buf_dac) {
+			qCritical() << "Unable to create DAC buffer";
+			break;
+		}
+	}
+
+	QThread::msleep(pushDelay->value());
+	for (const auto& channel : dac_channels) {
+		const struct iio_device *dev = iio_channel_get_device(channel);
+		iio_device_attr_write_bool(dev, "dma_sync", false);
+	}
+
+	configureAdcCapture();
+	adc_dev->setSampleRate(adc_rate);
+	adc_buffer = iio_device_create_buffer(adc, capture_size, false);
+
+	if (!adc_buffer) {
+		qCritical() << "Unable to create ADC buffer";
+		destroyBuffers();
+		return;
+	}
+
+	{
+		PIPELINE_TRACE("iio_buffer_refill");
+		iio_buffer_refill(adc_buffer);
+	}
+
+	if (m_stop) {
 		iio_buffer_destroy(adc_buffer);
 		adc_buffer = nullptr;
+		destroyBuffers();
+		return;
+	}
 
-		// Process was cancelled
-		if (m_stop) {
-			return;
+	size_t len = adc_samples.load(adc_buffer, adcChannels(), capture_size);
+
+	std::vector<CompensationStage> stages = compensationStages(
+			iio->freq_comp_filt, m2k_adc, adc_rate);
+	gr::fft::fft_real_fwd fft(len);
+	std::vector<std::complex<double>> spectrum[2];
+	BufferPtr captured[2];
+	double sum[2] = { 0, 0 };
+	float comp = m2k_adc->compTable(adc_rate);
+
+	if (len == capture_size) {
+		std::vector<int16_t> codes[2] = { std::vector<int16_t>(len),
+						  std::vector<int16_t>(len) };
+
+		forEachCompensated(stages, adc_samples.channels(), len,
+				[&](size_t i, int ch, short z) {
+			codes[ch][i] = z;
+			sum[ch] += z;
+		});
+
+		for (int ch = 0; ch < 2; ch++) {
+			std::copy(codes[ch].begin(), codes[ch].end(),
+				  fft.get_inbuf());
+			fft.execute();
+
+			for (size_t k : tones) {
+				spectrum[ch].push_back(fft.get_outbuf()[k]);
+			}
+
+			float scale = adc_sample_conv::sampleToVoltsScale(
+					m2k_adc->chnCorrectionGain(ch), comp,
+					m2k_adc->gainAt(m2k_adc->chnHwGainMode(ch)));
+			float dc = filterDc ? sum[ch] / len * scale : 0;
+
+			captured[ch] = BufferPtr(new Buffer(fundamental,
+						adc_rate, scale, -dc,
+						std::move(codes[ch])));
 		}
+	}
 
-		QMetaObject::invokeMethod(this,
-					  "_saveChannelBuffers",
-					  Qt::QueuedConnection,
-					  Q_ARG(double, frequency),
-					  Q_ARG(double, adc_rate),
-					  Q_ARG(std::vector<float>, sink1->data()),
-					  Q_ARG(std::vector<float>, sink2->data()));
+	iio_buffer_destroy(adc_buffer);
+	adc_buffer = nullptr;
+	destroyBuffers();
+
+	if (len != capture_size || m_stop) {
+		return;
+	}
+
+	float dcOffset = adc_sample_conv::convSampleToVolts(sum[1] / len,
+			m2k_adc->chnCorrectionGain(1), 1, 0,
+			m2k_adc->gainAt(m2k_adc->chnHwGainMode(1)));
+
+	QMetaObject::invokeMethod(this,
+				  "_saveChannelBuffers",
+				  Qt::QueuedConnection,
+				  Q_ARG(BufferPtr, captured[0]),
+				  Q_ARG(BufferPtr, captured[1]));
+
+	// Every point gets the response at its tone, in sweep order
+	for (int i = 0; i < iterations.size(); i++) {
+		size_t tone = std::lower_bound(tones.begin(), tones.end(),
+					       point_bins[i]) - tones.begin();
+		const std::complex<double>& x0 = spectrum[0][tone];
+		const std::complex<double>& x1 = spectrum[1][tone];
 
-		// Plot the data captured for this iteration
 		QMetaObject::invokeMethod(this,
 					  "plot",
 					  Qt::QueuedConnection,
-					  Q_ARG(double, frequency),
-					  Q_ARG(double, mag1),
-					  Q_ARG(double, mag2),
-					  Q_ARG(double, phase),
+					  Q_ARG(double, iterations[i].frequency),
+					  Q_ARG(double, std::norm(x0)),
+					  Q_ARG(double, std::norm(x1)),
+					  Q_ARG(double, std::arg(x1 * std::conj(x0))),
 					  Q_ARG(float, dcOffset));
+	}
+}
 
+std::vector<short> NetworkAnalyzer::computeMultisine(
+	const struct iio_device *dev, unsigned long rate,
+	size_t samples_count, const std::vector<size_t>& tones,
+	double amplitude, double offset)
+{
+	/*
+	 * Schroeder phases keep the crest factor low, so each tone gets
+	 * as much of the DAC range as the sum allows. The waveform is
+	 * built from its spectrum with one inverse FFT.
+	 */
+	gr::fft::fft_real_rev ifft(samples_count);
+	gr_complex *spectrum = ifft.get_inbuf();
+	size_t nb_tones = tones.size();
+
+	std::fill(spectrum, spectrum + samples_count / 2 + 1, gr_complex(0, 0));
+	for (size_t j = 0; j < nb_tones; j++) {
+		spectrum[tones[j]] = std::polar(1.0f,
+				(float)std::fmod(-M_PI * j * (j + 1) / nb_tones,
+						 2.0 * M_PI));
+	}
+	ifft.execute();
+
+	const float *wave = ifft.get_outbuf();
+	float peak = 0;
+	for (size_t i = 0; i < samples_count; i++) {
+		peak = std::max(peak, std::abs(wave[i]));
+	}
 
+	double scale = voltsToRawCoefficient(dev, rate);
+	double gain = peak > 0 ? amplitude / 2.0 / peak : 0;
+	std::vector<short> samples(samples_count);
 
+	for (size_t i = 0; i < samples_count; i++) {
+		double raw = std::round((wave[i] * gain + offset) * scale);
 
+		samples[i] = (short)std::min(32767.0, std::max(-32768.0, raw));
 	}
 
-	Q_EMIT sweepDone();
+	return samples;
+}
+
+std::vector<struct iio_channel *> NetworkAnalyzer::adcChannels() const
+{
+	return { iio_device_get_channel(adc, 0),
+		 iio_device_get_channel(adc, 1) };
+}
+
+bool NetworkAnalyzer::processCapture(double frequency, size_t adc_rate,
+		struct iio_buffer *buffer, CaptureResult& result)
+{
+	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
+	size_t len = adc_samples.load(buffer, adcChannels());
+
+	if (len < 2) {
+		return false;
+	}
+
+	double w = 2.0 * M_PI * frequency / adc_rate;
+	double coeff = 2.0 * std::cos(w);
+	float comp = m2k_adc->compTable(adc_rate);
+	std::vector<CompensationStage> stages = compensationStages(
+			iio->freq_comp_filt, m2k_adc, adc_rate);
+	float scale[2];
+
+	for (int ch = 0; ch < 2; ch++) {
+		scale[ch] = adc_sample_conv::sampleToVoltsScale(
+				m2k_adc->chnCorrectionGain(ch), comp,
+				m2k_adc->gainAt(m2k_adc->chnHwGainMode(ch)));
+	}
+
+	/*
+	 * A single pass over the raw samples of both channels does the
+	 * compensation, the Goertzel recurrence and the sums for the DC
+	 * level. The recurrence is linear, so the DC level is taken out
+	 * afterwards with the state of a constant input instead of going
+	 * over the samples a second time.
+	 */
+	std::vector<int16_t> codes[2] = { std::vector<int16_t>(len),
+					  std::vector<int16_t>(len) };
+	GoertzelState state[2], unit;
+	double sum[2] = { 0, 0 };
+
+	// The harmonics below Nyquist, measured from the same samples
+	std::vector<double> harmonics_w;
+	for (unsigned int h = 2; h <= harmonicsCount + 1 &&
+			h * frequency < adc_rate / 2.0; h++) {
+		harmonics_w.push_back(h * w);
+	}
+
+	GoertzelBank harmonics[2] = { GoertzelBank(harmonics_w),
+				      GoertzelBank(harmonics_w) };
+	GoertzelBank harmonics_unit(harmonics_w);
+	bool with_harmonics = !harmonics_w.empty();
+
+	forEachCompensated(stages, adc_samples.channels(), len,
+			[&](size_t i, int ch, short z) {
+		state[ch].push(coeff, z);
+		sum[ch] += z;
+		codes[ch][i] = z;
+
+		if (with_harmonics) {
+			harmonics[ch].push(z);
+		}
+
+		if (ch == 0) {
+			unit.push(coeff, 1.0);
+
+			if (with_harmonics) {
+				harmonics_unit.push(1.0);
+			}
+		}
+	});
+
+	std::complex<double> bins[2];
+
+	for (int ch = 0; ch < 2; ch++) {
+		double mean = sum[ch] / len;
+		GoertzelState s = state[ch];
+		float dc = 0;
+
+		if (filterDc) {
+			s.q1 -= mean * unit.q1;
+			s.q2 -= mean * unit.q2;
+			dc = mean * scale[ch];
+		}
+
+		bins[ch] = s.output(w, len);
+
+		result.harmonics[ch].clear();
+		for (size_t k = 0; k < harmonics_w.size(); k++) {
+			result.harmonics[ch].push_back(std::norm(
+				harmonics[ch].output(k, len, harmonics_unit,
+						     filterDc ? mean : 0.0)));
+		}
+
+		// The preview keeps the codes, the DC filter is its offset
+		result.buffers[ch] = BufferPtr(new Buffer(frequency, adc_rate,
+					scale[ch], -dc, std::move(codes[ch])));
+	}
+
+	result.mag1 = std::norm(bins[0]);
+	result.mag2 = std::norm(bins[1]);
+	result.phase = std::arg(bins[0] * std::conj(bins[1]));
+	result.dcOffset = adc_sample_conv::convSampleToVolts(sum[1] / len,
+			m2k_adc->chnCorrectionGain(1), 1, 0,
+			m2k_adc->gainAt(m2k_adc->chnHwGainMode(1)));
+
+	return true;
+}
+
+bool NetworkAnalyzer::isSteadyState(const CaptureResult& previous,
+		const CaptureResult& current)
+{
+	static const double max_mag_change_db = 0.1;
+	static const double max_phase_change = 1.0 * M_PI / 180.0;
+
+	if (previous.mag1 <= 0 || previous.mag2 <= 0 ||
+			current.mag1 <= 0 || current.mag2 <= 0) {
+		return false;
+	}
+
+	double mag_change = 10.0 * log10((current.mag1 / current.mag2) /
+					 (previous.mag1 / previous.mag2));
+	double phase_change = std::remainder(current.phase - previous.phase,
+					     2.0 * M_PI);
+
+	return std::abs(mag_change) < max_mag_change_db &&
+		std::abs(phase_change) < max_phase_change;
+}
+
+unsigned int NetworkAnalyzer::settlingDelay(double frequency,
+		unsigned int fixed_ms) const
+{
+	if (!adaptiveBox->isChecked()) {
+		return fixed_ms;
+	}
+
+	/* A few periods of the stimulus, the fixed delay stays the worst
+	 * case so low frequencies wait no longer than they used to */
+	static const double settling_periods = 8;
+	double ms = std::ceil(settling_periods * 1000.0 / frequency);
+
+	return (unsigned int)std::min<double>(fixed_ms, ms);
+}
+
+void NetworkAnalyzer::publishCapture(double frequency, size_t adc_rate,
+		const CaptureResult& result)
+{
+	QMetaObject::invokeMethod(this,
+				  "_saveChannelBuffers",
+				  Qt::QueuedConnection,
+				  Q_ARG(BufferPtr, result.buffers[0]),
+				  Q_ARG(BufferPtr, result.buffers[1]));
+
+	// Plot the data captured for this iteration
+	QMetaObject::invokeMethod(this,
+				  "plot",
+				  Qt::QueuedConnection,
+				  Q_ARG(double, frequency),
+				  Q_ARG(double, result.mag1),
+				  Q_ARG(double, result.mag2),
+				  Q_ARG(double, result.phase),
+				  Q_ARG(float, result.dcOffset));
+
+	if (harmonicsCount) {
+		QMetaObject::invokeMethod(this,
+					  "plotHarmonics",
+					  Qt::QueuedConnection,
+					  Q_ARG(double, frequency),
+					  Q_ARG(double, result.mag1),
+					  Q_ARG(double, result.mag2),
+					  Q_ARG(QVector<double>, result.harmonics[0]),
+					  Q_ARG(QVector<double>, result.harmonics[1]));
+	}
 }
 
 void NetworkAnalyzer::onFrequencyBarMoved(int pos)
@@ -1313,14 +1907,11 @@ void NetworkAnalyzer::toggleBufferPreview(bool toggle)
 	ui->nextBtn->setEnabled(toggle);
 }
 
-void NetworkAnalyzer::_saveChannelBuffers(double frequency, double sample_rate, std::vector<float> data1, std::vector<float> data2)
+void NetworkAnalyzer::_saveChannelBuffers(BufferPtr buffer1, BufferPtr buffer2)
 {
 	boost::unique_lock<boost::mutex> lock(bufferMutex);
 
-	Buffer buffer1 = Buffer(frequency, sample_rate, data1.size(), data1);
-	Buffer buffer2 = Buffer(frequency, sample_rate, data2.size(), data2);
-
-	bufferPreviewer->pushBuffers(QPair<Buffer, Buffer>(buffer1, buffer2));
+	bufferPreviewer->pushBuffers(buffer1, buffer2);
 }
 
 void NetworkAnalyzer::computeCaptureParams(double frequency,
@@ -1356,6 +1947,22 @@ void NetworkAnalyzer::computeCaptureParams(double frequency,
 	}
 }
 
+size_t NetworkAnalyzer::groupCaptureSize(size_t buffer_size)
+{
+	/*
+	 * Round up to four significant bits, so that neighbouring points
+	 * ask for the same size and can share the ADC buffer, for at most
+	 * 1/8 more samples captured.
+	 */
+	size_t step = 1;
+
+	while ((buffer_size >> 4) >= step) {
+		step <<= 1;
+	}
+
+	return (buffer_size + step - 1) / step * step;
+}
+
 QPair<double, double> NetworkAnalyzer::getPhaseInterval()
 {
 	double maxValue = phaseMax->value();
@@ -1393,15 +2000,6 @@ void NetworkAnalyzer::plot(double frequency, double mag1, double mag2,
 	}
 
 	double phase_deg = phase * 180.0 / M_PI;
-	double adjusted_phase_deg = phase_deg;
-
-	auto interval = getPhaseInterval();
-
-	if (phase_deg > interval.second) {
-		adjusted_phase_deg = (int)phase_deg - 360;
-	} else if (phase_deg < interval.first) {
-		adjusted_phase_deg = (int)phase_deg + 360;
-	}
 
 	static int index = 0;
 	if (justStarted) {
@@ -1413,7 +2011,8 @@ void NetworkAnalyzer::plot(double frequency, double mag1, double mag2,
 		magBonus = autoUpdateGainMode(mag, magBonus, dcVoltage);
 	}
 
-	ui->currentSampleLabel->setText(QString(tr("Sample: ") + QString::number(1 + currentSample++ )
+	int numSamples = std::max(1, m_dBgraph.getNumSamples());
+	ui->currentSampleLabel->setText(QString(tr("Sample: ") + QString::number(1 + currentSample++ % numSamples)
 						+ " / " + QString::number(m_dBgraph.getNumSamples()) + " "));
 
 	MetricPrefixFormatter d_cursorTimeFormatter;
@@ -1427,12 +2026,7 @@ void NetworkAnalyzer::plot(double frequency, double mag1, double mag2,
 
 	bool hasError = _checkMagForOverrange(mag + magBonus);
 
-	m_dBgraph.plot(frequency, mag + magBonus);
-	m_phaseGraph.plot(frequency, adjusted_phase_deg);
-	ui->xygraph->plot(phase_deg, mag + magBonus);
-	ui->nicholsgraph->plot(phase_deg, mag + magBonus);
-
-	d_frequencyHandle->triggerMove();
+	_plotPoint(frequency, mag + magBonus, phase_deg);
 
 	int responseChanel = ui->btnRefChn->isChecked() ? 1 : 0;
 	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
@@ -1451,6 +2045,275 @@ void NetworkAnalyzer::plot(double frequency, double mag1, double mag2,
 	magBonus = autoUpdateGainMode(mag, magBonus, dcVoltage);
 }
 
+void NetworkAnalyzer::_plotPoint(double frequency, double mag,
+				 double phase_deg)
+{
+	double adjusted_phase_deg = phase_deg;
+
+	auto interval = getPhaseInterval();
+
+	if (phase_deg > interval.second) {
+		adjusted_phase_deg = (int)phase_deg - 360;
+	} else if (phase_deg < interval.first) {
+		adjusted_phase_deg = (int)phase_deg + 360;
+	}
+
+	m_dBgraph.plot(frequency, mag);
+	m_phaseGraph.plot(frequency, adjusted_phase_deg);
+	ui->xygraph->plot(phase_deg, mag);
+	ui->nicholsgraph->plot(phase_deg, mag);
+
+	d_frequencyHandle->triggerMove();
+
+	int point = pointIndex(frequency);
+
+	if (point >= 0) {
+		if (pointStatistics.size() != iterations.size()) {
+			pointStatistics = QVector<PointStatistics>(iterations.size());
+		}
+
+		pointStatistics[point].push(mag, adjusted_phase_deg);
+	}
+}
+
+bool NetworkAnalyzer::processBuffers(const Buffer& first, const Buffer& second,
+		bool filter_dc, int window, unsigned int harmonics,
+		CaptureResult& result)
+{
+	size_t len = std::min(first.size(), second.size());
+
+	if (len < 2 || !first.sampleRate ||
+			first.frequency != second.frequency ||
+			first.sampleRate != second.sampleRate) {
+		return false;
+	}
+
+	double frequency = first.frequency;
+	double w = 2.0 * M_PI * frequency / first.sampleRate;
+	double coeff = 2.0 * std::cos(w);
+
+	std::vector<double> harmonics_w;
+	for (unsigned int h = 2; h <= harmonics + 1 &&
+			h * frequency < first.sampleRate / 2.0; h++) {
+		harmonics_w.push_back(h * w);
+	}
+
+	std::vector<float> weights;
+	if (window == REPROCESS_HANN) {
+		weights = gr::fft::window::hann(len);
+	} else if (window == REPROCESS_BLACKMAN_HARRIS) {
+		weights = gr::fft::window::blackman_harris(len);
+	}
+
+	/*
+	 * The stored codes are already compensated. They are taken in
+	 * volts, so the gain mode of each channel is accounted for; the
+	 * window gain is the same on both channels and on all the bins,
+	 * the ratios don't depend on it.
+	 */
+	const Buffer *buffers[2] = { &first, &second };
+	std::complex<double> bins[2];
+	double means[2];
+
+	for (int ch = 0; ch < 2; ch++) {
+		const std::vector<int16_t>& codes = buffers[ch]->samples;
+		double gain = buffers[ch]->gain;
+		double sum = 0;
+
+		for (size_t i = 0; i < len; i++) {
+			sum += codes[i];
+		}
+		means[ch] = sum / len;
+
+		double dc = filter_dc ? means[ch] : 0.0;
+		GoertzelState state;
+		GoertzelBank bank(harmonics_w);
+
+		for (size_t i = 0; i < len; i++) {
+			double x = (codes[i] - dc) * gain;
+
+			if (!weights.empty()) {
+				x *= weights[i];
+			}
+
+			state.push(coeff, x);
+			if (!harmonics_w.empty()) {
+				bank.push(x);
+			}
+		}
+
+		bins[ch] = state.output(w, len);
+
+		result.harmonics[ch].clear();
+		for (size_t k = 0; k < harmonics_w.size(); k++) {
+			result.harmonics[ch].push_back(std::norm(
+					bank.output(k, len)));
+		}
+	}
+
+	result.mag1 = std::norm(bins[0]);
+	result.mag2 = std::norm(bins[1]);
+	result.phase = std::arg(bins[0] * std::conj(bins[1]));
+	result.dcOffset = second.gain * means[1];
+
+	return true;
+}
+
+void NetworkAnalyzer::reprocess()
+{
+	if (!m_stop || reprocessWatcher.isRunning()) {
+		return;
+	}
+
+	QVector<QPair<BufferPtr, BufferPtr>> buffers;
+	{
+		boost::unique_lock<boost::mutex> lock(bufferMutex);
+		buffers = bufferPreviewer->buffers();
+	}
+
+	if (buffers.isEmpty()) {
+		return;
+	}
+
+	reprocessJobs.clear();
+	for (const auto& pair : buffers) {
+		reprocessJobs.push_back({ pair, CaptureResult(), false });
+	}
+
+	bool filter_dc = filterDc;
+	int window = reprocessWindowCmb->currentIndex();
+	unsigned int harmonics = harmonicsCount;
+
+	reprocessBtn->setEnabled(false);
+	ui->statusLabel->setText(tr("Reprocessing"));
+
+	reprocessWatcher.setFuture(QtConcurrent::map(reprocessJobs,
+			[=](ReprocessJob& job) {
+		job.valid = job.buffers.first && job.buffers.second &&
+			processBuffers(*job.buffers.first,
+				       *job.buffers.second, filter_dc,
+				       window, harmonics, job.result);
+	}));
+}
+
+void NetworkAnalyzer::_reprocessDone()
+{
+	bool response2 = ui->btnRefChn->isChecked();
+
+	// A sweep started in the meantime, its points win
+	if (!m_stop) {
+		reprocessJobs.clear();
+		return;
+	}
+
+	m_dBgraph.reset();
+	m_phaseGraph.reset();
+	ui->xygraph->reset();
+	ui->nicholsgraph->reset();
+	pointStatistics.clear();
+	pointHarmonics.clear();
+
+	for (const ReprocessJob& job : reprocessJobs) {
+		if (!job.valid) {
+			continue;
+		}
+
+		const CaptureResult& r = job.result;
+		double frequency = job.buffers.first->frequency;
+		double phase = response2 ? -r.phase : r.phase;
+		double mag = response2 ?
+			10.0 * log10(r.mag2) - 10.0 * log10(r.mag1) :
+			10.0 * log10(r.mag1) - 10.0 * log10(r.mag2);
+
+		_plotPoint(frequency, mag, phase * 180.0 / M_PI);
+
+		if (harmonicsCount) {
+			plotHarmonics(frequency, r.mag1, r.mag2,
+				      r.harmonics[0], r.harmonics[1]);
+		}
+	}
+
+	reprocessJobs.clear();
+
+	m_dBgraph.sweepDone();
+	m_phaseGraph.sweepDone();
+	reprocessBtn->setEnabled(m_stop);
+	ui->statusLabel->setText(tr("Stopped"));
+}
+
+void NetworkAnalyzer::plotHarmonics(double frequency, double mag1,
+				    double mag2, QVector<double> harmonics1,
+				    QVector<double> harmonics2)
+{
+	bool response2 = ui->btnRefChn->isChecked();
+	double fundamental = response2 ? mag2 : mag1;
+	const QVector<double>& harmonics = response2 ? harmonics2 : harmonics1;
+
+	if (fundamental <= 0 || harmonics.isEmpty()) {
+		return;
+	}
+
+	PointHarmonics point;
+	double total = 0;
+
+	for (double power : harmonics) {
+		total += power;
+		point.levels.push_back(10.0 * log10(power / fundamental));
+	}
+	point.thd = 10.0 * log10(total / fundamental);
+
+	m_dBgraph.plotSecondary(frequency, point.thd);
+
+	int index = pointIndex(frequency);
+
+	if (index >= 0) {
+		if (pointHarmonics.size() != iterations.size()) {
+			pointHarmonics = QVector<PointHarmonics>(iterations.size());
+		}
+
+		pointHarmonics[index] = point;
+	}
+}
+
+int NetworkAnalyzer::pointIndex(double frequency) const
+{
+	// The iterations are sorted by frequency
+	auto it = std::lower_bound(iterations.begin(), iterations.end(),
+			frequency, [](const networkIteration& it, double f) {
+		return it.frequency < f;
+	});
+
+	if (it == iterations.end() || it->frequency != frequency) {
+		return -1;
+	}
+
+	return it - iterations.begin();
+}
+
+void NetworkAnalyzer::PointStatistics::push(double mag, double phase)
+{
+	count++;
+
+	double delta = mag - magMean;
+	magMean += delta / count;
+	magM2 += delta * (mag - magMean);
+
+	// The phase wraps, its distance to the mean is taken in (-180, 180]
+	delta = std::remainder(phase - phaseMean, 360.0);
+	phaseMean += delta / count;
+	phaseM2 += delta * std::remainder(phase - phaseMean, 360.0);
+}
+
+double NetworkAnalyzer::PointStatistics::magStdDev() const
+{
+	return count > 1 ? sqrt(magM2 / (count - 1)) : 0.0;
+}
+
+double NetworkAnalyzer::PointStatistics::phaseStdDev() const
+{
+	return count > 1 ? sqrt(phaseM2 / (count - 1)) : 0.0;
+}
+
 bool NetworkAnalyzer::_checkMagForOverrange(double magnitude)
 {
 	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc_dev);
@@ -1594,6 +2457,9 @@ void NetworkAnalyzer::startStop(bool pressed)
 	ui->responseGainCmb->setEnabled(!pressed);
 	pushDelay->setEnabled(!pressed);
 	captureDelay->setEnabled(!pressed);
+	adaptiveBox->setEnabled(!pressed);
+	multisineBox->setEnabled(!pressed);
+	reprocessBtn->setEnabled(!pressed);
 
 	if (pressed) {
 		if (shouldClear) {
@@ -1604,6 +2470,8 @@ void NetworkAnalyzer::startStop(bool pressed)
 			updateNumSamples(true);
 		}
 		iterationStats.clear();
+		pointStatistics.clear();
+		pointHarmonics.clear();
 		bufferPreviewer->clear();
 		configHwForNetworkAnalyzing();
 		m_stop = false;
@@ -1623,19 +2491,24 @@ void NetworkAnalyzer::startStop(bool pressed)
 	}
 }
 
-struct iio_buffer *NetworkAnalyzer::generateSinWave(
-	const struct iio_device *dev, double frequency,
-	double amplitude, double offset,
+QVector<NetworkAnalyzer::waveform_sptr> NetworkAnalyzer::computeSinWaves(
+	double frequency, double amplitude, double offset,
 	unsigned long rate, size_t samples_count)
 {
-	/* Create the IIO buffer */
-	struct iio_buffer *buf = iio_device_create_buffer(
-					 dev, samples_count, true);
+	QVector<waveform_sptr> waves;
 
-	if (!buf) {
-		return buf;
+	for (const auto& channel : dac_channels) {
+		waves.push_back(computeSinWave(iio_channel_get_device(channel),
+				frequency, amplitude, offset, rate,
+				samples_count));
 	}
 
+	return waves;
+}
+
+float NetworkAnalyzer::voltsToRawCoefficient(const struct iio_device *dev,
+		unsigned long rate) const
+{
 	double vlsb = 1;
 	double corr = 1;
 	for (auto dac : dacs) {
@@ -1650,26 +2523,95 @@ struct iio_buffer *NetworkAnalyzer::generateSinWave(
 		}
 	}
 
-	float volts_to_raw_coef = (-1 * (1 / vlsb) * 16) / corr;
+	return (-1 * (1 / vlsb) * 16) / corr;
+}
+
+NetworkAnalyzer::waveform_sptr NetworkAnalyzer::computeSinWave(
+	const struct iio_device *dev, double frequency,
+	double amplitude, double offset,
+	unsigned long rate, size_t samples_count)
+{
+	float volts_to_raw_coef = voltsToRawCoefficient(dev, rate);
+
+	/*
+	 * A sweep plays the same points every time, so the waveforms are
+	 * kept. The coefficient is part of the key: it changes with the
+	 * device and its calibration.
+	 */
+	WaveformKey key { frequency, amplitude, offset, volts_to_raw_coef,
+			  rate, samples_count };
+
+	{
+		boost::unique_lock<boost::mutex> lock(waveformCacheMutex);
+		auto it = waveformIndex.find(key);
+
+		if (it != waveformIndex.end()) {
+			waveformCache.splice(waveformCache.begin(),
+					     waveformCache, it->second);
+			return it->second->second;
+		}
+	}
+
+	/*
+	 * Phase rotation instead of a sin() per sample, restarted from the
+	 * exact phase every block so the rounding errors do not add up.
+	 * The raw values are rounded and clipped as float_to_short did.
+	 */
+	static const size_t resync_samples = 1024;
+	std::vector<short> *samples = new std::vector<short>(samples_count);
+	waveform_sptr wave(samples);
+	double w = 2.0 * M_PI * frequency / rate;
+	double scale = volts_to_raw_coef;
+	std::complex<double> step = std::polar(1.0, w);
+	std::complex<double> phase;
+
+	for (size_t i = 0; i < samples_count; i++) {
+		if (i % resync_samples == 0) {
+			phase = std::polar(1.0, std::fmod(w * i, 2.0 * M_PI));
+		}
+
+		double raw = std::round((amplitude / 2.0 * phase.imag() +
+					 offset) * scale);
+
+		(*samples)[i] = (short)std::min(32767.0,
+						std::max(-32768.0, raw));
+		phase *= step;
+	}
+
+	boost::unique_lock<boost::mutex> lock(waveformCacheMutex);
+
+	if (waveformIndex.find(key) == waveformIndex.end()) {
+		waveformCache.emplace_front(key, wave);
+		waveformIndex[key] = waveformCache.begin();
+		waveformCacheSamples += samples_count;
+	}
+
+	while (waveformCacheSamples > max_cached_waveform_samples &&
+	       waveformCache.size() > 1) {
+		waveformCacheSamples -= waveformCache.back().first.samples_count;
+		waveformIndex.erase(waveformCache.back().first);
+		waveformCache.pop_back();
+	}
+
+	return wave;
+}
+
+struct iio_buffer *NetworkAnalyzer::pushSinWave(
+	const struct iio_device *dev, const std::vector<short>& samples,
+	unsigned long rate)
+{
+	size_t samples_count = samples.size();
+
+	/* Create the IIO buffer */
+	struct iio_buffer *buf = iio_device_create_buffer(
+					 dev, samples_count, true);
+
+	if (!buf) {
+		return buf;
+	}
 
 	iio_device_attr_write_longlong(dev, "oversampling_ratio", 1);
 
-	// Make sure to clear everything left from the last
-	// sine generation iteration
-	vector_block->reset();
-	head_block->reset();
-	f2s_block->set_scale(volts_to_raw_coef);
-
-	// Setup params for sine wave generation and run
-	source_block->set_sampling_freq(rate);
-	source_block->set_frequency(frequency);
-	source_block->set_amplitude(amplitude / 2.0);
-	source_block->set_offset(offset);
-	source_block->set_phase(0);
-	head_block->set_length(samples_count);
-	top_block->run();
-
-	const std::vector<short>& samples = vector_block->data();
 	const short *data = samples.data();
 
 	for (unsigned int i = 0; i < iio_device_get_channels_count(dev); i++) {
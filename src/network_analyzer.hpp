@@ -29,6 +29,7 @@
 #include "dbgraph.hpp"
 #include "handles_area.hpp"
 #include <QtConcurrentRun>
+#include <QFutureWatcher>
 #include "customPushButton.hpp"
 #include "scroll_filter.hpp"
 #include <scopy/goertzel_scopy_fc.h>
@@ -52,6 +53,10 @@
 #include <gnuradio/blocks/vector_source.h>
 #include "frequency_compensation_filter.h"
 
+#include <list>
+#include <map>
+#include <memory>
+
 #include "oscilloscope.hpp"
 
 #include "TimeDomainDisplayPlot.h"
@@ -59,6 +64,7 @@
 #include "networkanalyzerbufferviewer.h"
 #include "startstoprangewidget.h"
 #include "adc_sample_conv.hpp"
+#include "deinterleaved_buffer.hpp"
 
 extern "C" {
 	struct iio_buffer;
@@ -72,6 +78,8 @@ class NetworkAnalyzer;
 }
 
 class QPushButton;
+class QCheckBox;
+class QComboBox;
 class QJSEngine;
 
 namespace adiscope {
@@ -102,20 +110,33 @@ private:
 	struct iio_channel *amp1, *amp2;
 	std::vector<iio_channel *> dac_channels;
 	iio_buffer *adc_buffer;
+	// Both channels of the last ADC buffer, from the sweep thread
+	DeinterleavedBuffer adc_samples;
 	struct iio_device *adc;
 	std::shared_ptr<GenericAdc> adc_dev;
 	boost::shared_ptr<iio_manager> iio;
 	QList<std::shared_ptr<GenericDac>> dacs;
-	bool m_initFlowgraph;
 
-	// Sine generation blocks
-	gr::top_block_sptr top_block;
-	gr::analog::sig_source_f::sptr source_block;
-	gr::blocks::float_to_short::sptr f2s_block;
-	gr::blocks::head::sptr head_block;
-	gr::blocks::vector_sink_s::sptr vector_block;
+	// Raw DAC samples of the last sine waves, most recently used first
+	typedef std::shared_ptr<const std::vector<short>> waveform_sptr;
+	struct WaveformKey {
+		double frequency;
+		double amplitude;
+		double offset;
+		float coefficient;
+		unsigned long rate;
+		size_t samples_count;
+
+		bool operator<(const WaveformKey& other) const;
+	};
+	typedef std::list<std::pair<WaveformKey, waveform_sptr>> waveform_list;
+	waveform_list waveformCache;
+	std::map<WaveformKey, waveform_list::iterator> waveformIndex;
+	size_t waveformCacheSamples;
+	boost::mutex waveformCacheMutex;
 
 	QVector<unsigned long> sampleRates;
+	QVector<unsigned long> dacSampleRates;
 
 	dBgraph m_dBgraph;
 	dBgraph m_phaseGraph;
@@ -125,17 +146,26 @@ private:
 		NetworkAnalyzerIteration():
 			frequency(0),
 			rate(0),
-			bufferSize(0) {}
+			bufferSize(0),
+			captureRate(0),
+			captureSize(0) {}
 		NetworkAnalyzerIteration(double frequency,
 					 size_t rate,
-					 size_t bufferSize):
+					 size_t bufferSize,
+					 size_t captureRate,
+					 size_t captureSize):
 			frequency(frequency),
 			rate(rate),
-			bufferSize(bufferSize) {}
+			bufferSize(bufferSize),
+			captureRate(captureRate),
+			captureSize(captureSize) {}
 
 		double frequency;
 		size_t rate;
 		size_t bufferSize;
+		// ADC settings, the buffer is kept while they do not change
+		size_t captureRate;
+		size_t captureSize;
 	} networkIteration;
 
 	typedef struct NetworkAnalyzerIterationStats {
@@ -158,6 +188,55 @@ private:
 	QVector<networkIteration> iterations;
 	QVector<NetworkIterationStats> iterationStats;
 
+	// Running mean and variance of one point over the repeated
+	// sweeps (Welford), the phase is in degrees
+	struct PointStatistics {
+		PointStatistics():
+			count(0), magMean(0), magM2(0),
+			phaseMean(0), phaseM2(0) {}
+
+		unsigned int count;
+		double magMean, magM2;
+		double phaseMean, phaseM2;
+
+		void push(double mag, double phase);
+		double magStdDev() const;
+		double phaseStdDev() const;
+	};
+	QVector<PointStatistics> pointStatistics;
+
+	// Distortion of the response channel at each point of the last
+	// sweep, in dB relative to the fundamental: the total and each
+	// harmonic from the second up, those past Nyquist left out
+	struct PointHarmonics {
+		PointHarmonics(): thd(0) {}
+
+		double thd;
+		QVector<double> levels;
+	};
+	QVector<PointHarmonics> pointHarmonics;
+
+	// Harmonics measured along with the fundamental, 0 for none
+	unsigned int harmonicsCount;
+
+	// Sweeps run back to back on each start, 1 for a single sweep
+	unsigned int sweepRepeats;
+
+	int pointIndex(double frequency) const;
+
+	// What the frequency array depends on, read from the UI
+	struct SweepSettings {
+		double min_freq;
+		double max_freq;
+		unsigned int steps;
+		bool is_log;
+
+		bool operator==(const SweepSettings& other) const;
+	};
+
+	// Frequency arrays of the last sweeps, most recent first
+	QList<QPair<SweepSettings, QVector<networkIteration>>> iterationsCache;
+
 	boost::thread *iterationsThread;
 	bool iterationsThreadCanceled;
 	bool iterationsThreadReady;
@@ -165,34 +244,6 @@ private:
 	bool isIterationsThreadReady();
 	bool isIterationsThreadCanceled();
 
-	gr::top_block_sptr capture_top_block;
-	gr::blocks::vector_source_s::sptr capture1;
-	gr::blocks::vector_source_s::sptr capture2;
-	adiscope::frequency_compensation_filter::sptr f11,f12,f21,f22;
-	gr::blocks::short_to_float::sptr s2f1;
-	gr::blocks::short_to_float::sptr s2f2;
-	gr::scopy::goertzel_scopy_fc::sptr goertzel1;
-	gr::scopy::goertzel_scopy_fc::sptr goertzel2;
-	gr::blocks::copy::sptr copy1;
-	gr::blocks::copy::sptr copy2;
-	iio_manager::port_id id1;
-	iio_manager::port_id id2;
-	gr::blocks::head::sptr head1;
-	gr::blocks::head::sptr head2;
-	gr::blocks::vector_sink_f::sptr sink1;
-	gr::blocks::vector_sink_f::sptr sink2;
-	gr::blocks::complex_to_mag_squared::sptr c2m1;
-	gr::blocks::complex_to_mag_squared::sptr c2m2;
-	gr::blocks::multiply_conjugate_cc::sptr conj;
-	gr::filter::dc_blocker_ff::sptr dcBlocker1;
-	gr::filter::dc_blocker_ff::sptr dcBlocker2;
-	gr::blocks::complex_to_arg::sptr c2a;
-	boost::shared_ptr<signal_sample> signal;
-	boost::shared_ptr<adc_sample_conv> adc_conv;
-	boost::shared_ptr<cancel_dc_offset_block> dc_cancel1;
-	boost::shared_ptr<cancel_dc_offset_block> dc_cancel2;
-	float mag1, mag2, phase;
-	bool captureDone;
 	bool filterDc;
 
 	boost::mutex iterationsReadyMutex;
@@ -200,7 +251,6 @@ private:
 	boost::mutex bufferMutex;
 
 	NetworkAnalyzerBufferViewer *bufferPreviewer;
-	QVector<Buffer> capturedData;
 
 	StartStopRangeWidget *startStopRange;
 
@@ -221,6 +271,10 @@ private:
 	PositionSpinButton *phaseMin;
 	PositionSpinButton *pushDelay;
 	PositionSpinButton *captureDelay;
+	QCheckBox *adaptiveBox;
+	QCheckBox *multisineBox;
+	QComboBox *reprocessWindowCmb;
+	QPushButton *reprocessBtn;
 
 	void setMinimumDistanceBetween(SpinBoxA *min, SpinBoxA *max, double distance);
 
@@ -239,15 +293,72 @@ private:
 	QVector<QVector<double>> m_importData;
 
 	void goertzel();
-	void setFilterParameters();
-
-	struct iio_buffer *generateSinWave(
+	// Goertzel estimates of one capture
+	struct CaptureResult {
+		double mag1;
+		double mag2;
+		double phase;
+		float dcOffset;
+		BufferPtr buffers[2];
+		// Power of the harmonics of each channel, as mag1 and mag2
+		QVector<double> harmonics[2];
+	};
+	void configureAdcCapture();
+	void multisineSweep();
+	std::vector<short> computeMultisine(
+		const struct iio_device *dev,
+		unsigned long rate,
+		size_t samples_count,
+		const std::vector<size_t>& tones,
+		double amplitude,
+		double offset);
+	float voltsToRawCoefficient(const struct iio_device *dev,
+				    unsigned long rate) const;
+	std::vector<struct iio_channel *> adcChannels() const;
+	bool processCapture(double frequency, size_t adc_rate,
+			    struct iio_buffer *buffer, CaptureResult& result);
+	void publishCapture(double frequency, size_t adc_rate,
+			    const CaptureResult& result);
+	static bool isSteadyState(const CaptureResult& previous,
+				  const CaptureResult& current);
+
+	// The stored buffers of a point processed again, see reprocess()
+	enum ReprocessWindow {
+		REPROCESS_RECTANGULAR,
+		REPROCESS_HANN,
+		REPROCESS_BLACKMAN_HARRIS,
+	};
+	struct ReprocessJob {
+		QPair<BufferPtr, BufferPtr> buffers;
+		CaptureResult result;
+		bool valid;
+	};
+	QVector<ReprocessJob> reprocessJobs;
+	QFutureWatcher<void> reprocessWatcher;
+	static bool processBuffers(const Buffer& first, const Buffer& second,
+				   bool filter_dc, int window,
+				   unsigned int harmonics,
+				   CaptureResult& result);
+	unsigned int settlingDelay(double frequency,
+				   unsigned int fixed_ms) const;
+
+	QVector<waveform_sptr> computeSinWaves(
+		double frequency,
+		double amplitude,
+		double offset,
+		unsigned long rate,
+		size_t samples_count);
+	waveform_sptr computeSinWave(
 		const struct iio_device *dev,
 		double frequency,
 		double amplitude,
 		double offset,
 		unsigned long rate,
 		size_t samples_count);
+	struct iio_buffer *pushSinWave(
+		const struct iio_device *dev,
+		const std::vector<short>& samples,
+		unsigned long rate);
 
 	void configHwForNetworkAnalyzing();
 
@@ -256,25 +367,29 @@ private:
 	void updateGainMode();
 	void computeCaptureParams(double frequency, size_t& buffer_size,
 				  size_t& adc_rate);
+	static size_t groupCaptureSize(size_t buffer_size);
 
 	QPair<double, double> getPhaseInterval();
 	void computeIterations();
 
 	double autoUpdateGainMode(double magnitude, double magnitudeGain, float dcVoltage);
 
-	void _configureDacFlowgraph();
-
-	void _configureAdcFlowgraph(size_t bufferSize = 0);
-	unsigned long _getBestSampleRate(double frequency, const iio_device *dev);
+	unsigned long _getBestSampleRate(double frequency,
+					 const QVector<unsigned long>& values);
 	size_t _getSamplesCount(double frequency, unsigned long rate, bool perfect = false);
-	void computeFrequencyArray();
+	void computeFrequencyArray(SweepSettings settings);
 
 	bool _checkMagForOverrange(double magnitude);
 private Q_SLOTS:
 	void startStop(bool start);
 	void updateNumSamples(bool force = false);
 	void plot(double frequency, double mag, double mag2, double phase, float dcVoltage);
-	void _saveChannelBuffers(double frequency, double sample_rate, std::vector<float> data1, std::vector<float> data2);
+	void plotHarmonics(double frequency, double mag1, double mag2,
+			   QVector<double> harmonics1,
+			   QVector<double> harmonics2);
+	void _plotPoint(double frequency, double mag, double phase_deg);
+	void _reprocessDone();
+	void _saveChannelBuffers(BufferPtr buffer1, BufferPtr buffer2);
 
 	void toggleCursors(bool en);
 	void onVbar1PixelPosChanged(int pos);
@@ -293,6 +408,11 @@ public Q_SLOTS:
 	void run() override;
 	void stop() override;
 
+	// Recomputes the sweep from the stored buffers with the current
+	// DC filter, harmonics and the window of the buffer preview,
+	// the points in parallel; the device is not touched
+	void reprocess();
+
 Q_SIGNALS:
 	void sweepDone();
 	void showTool();
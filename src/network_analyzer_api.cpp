@@ -20,6 +20,8 @@
 #include "network_analyzer_api.hpp"
 #include "ui_network_analyzer.h"
 
+#include <algorithm>
+
 namespace adiscope {
 void NetworkAnalyzer_API::show()
 {
@@ -156,6 +158,58 @@ void NetworkAnalyzer_API::setRefChannel(int chn)
         net->ui->btnRefChn->setChecked(false);
 }
 
+bool NetworkAnalyzer_API::getAdaptiveSettling() const
+{
+	return net->adaptiveBox->isChecked();
+}
+
+void NetworkAnalyzer_API::setAdaptiveSettling(bool enabled)
+{
+	net->adaptiveBox->setChecked(enabled);
+}
+
+bool NetworkAnalyzer_API::getMultisine() const
+{
+	return net->multisineBox->isChecked();
+}
+
+void NetworkAnalyzer_API::setMultisine(bool enabled)
+{
+	net->multisineBox->setChecked(enabled);
+}
+
+int NetworkAnalyzer_API::getBufferMemoryLimit() const
+{
+	return net->bufferPreviewer->memoryLimit() / (1024 * 1024);
+}
+
+void NetworkAnalyzer_API::setBufferMemoryLimit(int mib)
+{
+	net->bufferPreviewer->setMemoryLimit((size_t)std::max(1, mib) *
+					     1024 * 1024);
+}
+
+int NetworkAnalyzer_API::getSweepRepeats() const
+{
+	return net->sweepRepeats;
+}
+
+void NetworkAnalyzer_API::setSweepRepeats(int repeats)
+{
+	net->sweepRepeats = (unsigned int)std::max(1, repeats);
+}
+
+int NetworkAnalyzer_API::getHarmonics() const
+{
+	return net->harmonicsCount;
+}
+
+void NetworkAnalyzer_API::setHarmonics(int harmonics)
+{
+	net->harmonicsCount = (unsigned int)std::min(std::max(0, harmonics),
+						     16);
+}
+
 bool NetworkAnalyzer_API::getCursors() const
 {
 	return net->d_cursorsEnabled;
@@ -268,4 +322,85 @@ QList<double> NetworkAnalyzer_API::phase() const
 	return list;
 }
 
+QList<double> NetworkAnalyzer_API::magMean() const
+{
+	QList<double> list;
+	for (const auto& stats : net->pointStatistics) {
+		list.push_back(stats.magMean);
+	}
+	return list;
+}
+
+QList<double> NetworkAnalyzer_API::magStdDev() const
+{
+	QList<double> list;
+	for (const auto& stats : net->pointStatistics) {
+		list.push_back(stats.magStdDev());
+	}
+	return list;
+}
+
+QList<double> NetworkAnalyzer_API::phaseMean() const
+{
+	QList<double> list;
+	for (const auto& stats : net->pointStatistics) {
+		list.push_back(stats.phaseMean);
+	}
+	return list;
+}
+
+QList<double> NetworkAnalyzer_API::phaseStdDev() const
+{
+	QList<double> list;
+	for (const auto& stats : net->pointStatistics) {
+		list.push_back(stats.phaseStdDev());
+	}
+	return list;
+}
+
+void NetworkAnalyzer_API::reprocess()
+{
+	net->reprocess();
+}
+
+bool NetworkAnalyzer_API::reprocessing() const
+{
+	// Cleared once the results are plotted
+	return !net->reprocessJobs.isEmpty();
+}
+
+int NetworkAnalyzer_API::getReprocessWindow() const
+{
+	return net->reprocessWindowCmb->currentIndex();
+}
+
+void NetworkAnalyzer_API::setReprocessWindow(int window)
+{
+	if (window >= 0 && window < net->reprocessWindowCmb->count()) {
+		net->reprocessWindowCmb->setCurrentIndex(window);
+	}
+}
+
+QList<double> NetworkAnalyzer_API::thd() const
+{
+	QList<double> list;
+	for (const auto& point : net->pointHarmonics) {
+		list.push_back(point.thd);
+	}
+	return list;
+}
+
+QVariantList NetworkAnalyzer_API::harmonicLevels() const
+{
+	QVariantList list;
+	for (const auto& point : net->pointHarmonics) {
+		QVariantList levels;
+		for (double level : point.levels) {
+			levels.push_back(level);
+		}
+		list.push_back(levels);
+	}
+	return list;
+}
+
 }
@@ -47,6 +47,18 @@ class NetworkAnalyzer_API : public ApiObject
 	Q_PROPERTY(int ref_channel READ getRefChannel
 			WRITE setRefChannel);
 
+	Q_PROPERTY(bool adaptive_settling READ getAdaptiveSettling
+			WRITE setAdaptiveSettling);
+	Q_PROPERTY(bool multisine READ getMultisine WRITE setMultisine);
+	Q_PROPERTY(int buffer_memory_limit READ getBufferMemoryLimit
+			WRITE setBufferMemoryLimit);
+	Q_PROPERTY(int sweep_repeats READ getSweepRepeats
+			WRITE setSweepRepeats);
+	Q_PROPERTY(int harmonics READ getHarmonics WRITE setHarmonics);
+	Q_PROPERTY(int reprocess_window READ getReprocessWindow
+			WRITE setReprocessWindow);
+	Q_PROPERTY(bool reprocessing READ reprocessing STORED false);
+
 	Q_PROPERTY(bool running READ running WRITE run STORED false);
 	Q_PROPERTY(bool cursors READ getCursors WRITE setCursors);
 	Q_PROPERTY(int line_thickness READ getLineThickness WRITE setLineThickness);
@@ -59,6 +71,13 @@ class NetworkAnalyzer_API : public ApiObject
 	Q_PROPERTY(QList<double> data READ data STORED false)
 	Q_PROPERTY(QList<double> phase READ phase STORED false)
 	Q_PROPERTY(QList<double> freq READ freq STORED false)
+	Q_PROPERTY(QList<double> mag_mean READ magMean STORED false)
+	Q_PROPERTY(QList<double> mag_stddev READ magStdDev STORED false)
+	Q_PROPERTY(QList<double> phase_mean READ phaseMean STORED false)
+	Q_PROPERTY(QList<double> phase_stddev READ phaseStdDev STORED false)
+	Q_PROPERTY(QList<double> thd READ thd STORED false)
+	Q_PROPERTY(QVariantList harmonic_levels READ harmonicLevels
+			STORED false)
 public:
 	explicit NetworkAnalyzer_API(NetworkAnalyzer *net) :
 		ApiObject(), net(net) {}
@@ -92,6 +111,24 @@ public:
 	int getRefChannel() const;
 	void setRefChannel(int chn);
 
+	bool getAdaptiveSettling() const;
+	void setAdaptiveSettling(bool enabled);
+
+	bool getMultisine() const;
+	void setMultisine(bool enabled);
+
+	// Memory of the buffer preview, in MiB
+	int getBufferMemoryLimit() const;
+	void setBufferMemoryLimit(int mib);
+
+	// Sweeps averaged into the statistics on each run
+	int getSweepRepeats() const;
+	void setSweepRepeats(int repeats);
+
+	// Harmonics measured at each point besides the fundamental
+	int getHarmonics() const;
+	void setHarmonics(int harmonics);
+
 	bool getCursors() const;
 	void setCursors(bool enabled);
 
@@ -111,10 +148,29 @@ public:
 
 	Q_INVOKABLE void show();
 
+	// Recomputes the sweep from the stored buffers, see reprocessing
+	Q_INVOKABLE void reprocess();
+	bool reprocessing() const;
+
+	// 0 rectangular, 1 Hann, 2 Blackman-Harris
+	int getReprocessWindow() const;
+	void setReprocessWindow(int window);
+
 	QList<double> data() const;
 	QList<double> freq() const;
 	QList<double> phase() const;
 
+	// Per point statistics of the sweeps since the last start
+	QList<double> magMean() const;
+	QList<double> magStdDev() const;
+	QList<double> phaseMean() const;
+	QList<double> phaseStdDev() const;
+
+	// Per point distortion of the last sweep in dB relative to the
+	// fundamental, total and per harmonic from the second up
+	QList<double> thd() const;
+	QVariantList harmonicLevels() const;
+
 private:
 	NetworkAnalyzer *net;
 };
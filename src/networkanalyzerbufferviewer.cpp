@@ -20,21 +20,45 @@
 
 #include "networkanalyzerbufferviewer.h"
 #include "ui_networkanalyzerbufferviewer.h"
+#include "memory_budget.hpp"
 
 #include <qwt_plot_layout.h>
 
 using namespace adiscope;
 
+/* Keeps about a thousand 16k sample pairs */
+static const size_t default_memory_limit = 64 * 1024 * 1024;
+
+static size_t bufferBytes(const BufferPtr& buffer)
+{
+	return buffer ? buffer->size() * sizeof(int16_t) : 0;
+}
+
 NetworkAnalyzerBufferViewer::NetworkAnalyzerBufferViewer(QWidget *parent) :
 	QWidget(parent),
 	d_ui(new Ui::NetworkAnalyzerBufferViewer),
 	d_osc(nullptr),
 	d_selectedBuffersIndex(-1),
-	d_numBuffers(0)
+	d_numBuffers(0),
+	d_nextBuffer(0),
+	d_memoryLimit(default_memory_limit),
+	d_memoryUsed(0)
 {
+	qRegisterMetaType<BufferPtr>("BufferPtr");
+
 	d_ui->setupUi(this);
 
 	_setupPlot();
+
+	/* The samples of the oldest buffers go first when memory runs
+	 * out, their frequencies stay */
+	MemoryBudget *budget = MemoryBudget::instance();
+	budget->addUsage(this, tr("Network Analyzer"), tr("buffer history"),
+			 [=]() { return d_memoryUsed; });
+	budget->addReclaimer(this, MemoryBudget::HISTORY, [=](size_t bytes) {
+		return _enforceMemoryLimit(d_memoryUsed > bytes ?
+					   d_memoryUsed - bytes : 0);
+	});
 }
 
 NetworkAnalyzerBufferViewer::~NetworkAnalyzerBufferViewer()
@@ -47,17 +71,92 @@ void NetworkAnalyzerBufferViewer::setNumBuffers(unsigned int numBuffers)
 	d_numBuffers = numBuffers;
 }
 
-void NetworkAnalyzerBufferViewer::pushBuffers(QPair<Buffer, Buffer> buffers)
+void NetworkAnalyzerBufferViewer::setMemoryLimit(size_t bytes)
+{
+	d_memoryLimit = bytes;
+	_enforceMemoryLimit(d_memoryLimit);
+}
+
+size_t NetworkAnalyzerBufferViewer::memoryLimit() const
+{
+	return d_memoryLimit;
+}
+
+void NetworkAnalyzerBufferViewer::pushBuffers(BufferPtr first, BufferPtr second)
 {
-	if (d_data.size() < d_numBuffers) {
-		d_data.push_back(buffers);
+	if (d_numBuffers <= 0 || !first || !second) {
+		return;
+	}
+
+	if (d_nextBuffer >= d_numBuffers) {
+		d_nextBuffer = 0;
+	}
+
+	if (d_nextBuffer >= d_data.size()) {
+		d_data.push_back(qMakePair(first, second));
 	} else {
-		static int currentBuffer = 0;
-		d_data[currentBuffer++] = buffers;
-		if (currentBuffer == d_numBuffers) {
-			currentBuffer = 0;
+		auto& old = d_data[d_nextBuffer];
+
+		d_memoryUsed -= bufferBytes(old.first) + bufferBytes(old.second);
+		old = qMakePair(first, second);
+	}
+
+	d_memoryUsed += bufferBytes(first) + bufferBytes(second);
+	d_nextBuffer++;
+
+	_enforceMemoryLimit(d_memoryLimit);
+}
+
+QVector<QPair<BufferPtr, BufferPtr>> NetworkAnalyzerBufferViewer::buffers() const
+{
+	QVector<QPair<BufferPtr, BufferPtr>> ordered;
+	int count = d_data.size();
+
+	for (int n = 0; n < count; n++) {
+		ordered.push_back(d_data[(d_nextBuffer + n) % count]);
+	}
+
+	return ordered;
+}
+
+size_t NetworkAnalyzerBufferViewer::_enforceMemoryLimit(size_t limit)
+{
+	/*
+	 * The buffers are written in order, so the oldest ones are those
+	 * following the last write. Their samples are dropped first.
+	 */
+	auto strip = [](const BufferPtr& buffer) {
+		return BufferPtr(new Buffer(buffer->frequency,
+					    buffer->sampleRate, buffer->gain,
+					    buffer->offset,
+					    std::vector<int16_t>()));
+	};
+
+	const size_t used = d_memoryUsed;
+	int count = d_data.size();
+
+	for (int n = 0; n < count && d_memoryUsed > limit; n++) {
+		auto& entry = d_data[(d_nextBuffer + n) % count];
+
+		if (!bufferBytes(entry.first) && !bufferBytes(entry.second)) {
+			continue;
 		}
+
+		d_memoryUsed -= bufferBytes(entry.first) +
+			bufferBytes(entry.second);
+		entry = qMakePair(strip(entry.first), strip(entry.second));
 	}
+
+	return used - d_memoryUsed;
+}
+
+QPair<BufferPtr, BufferPtr> NetworkAnalyzerBufferViewer::getSelectedBuffers() const
+{
+	if (d_selectedBuffersIndex < 0 || d_selectedBuffersIndex >= d_data.size()) {
+		return QPair<BufferPtr, BufferPtr>();
+	}
+
+	return d_data[d_selectedBuffersIndex];
 }
 
 void NetworkAnalyzerBufferViewer::selectBuffersAtIndex(int index, bool moveHandle)
@@ -77,9 +176,12 @@ void NetworkAnalyzerBufferViewer::selectBuffersAtIndex(int index, bool moveHandl
 	}
 
 	QVector<double> xData;
+	const Buffer& first = *d_data[index].first;
+	const Buffer& second = *d_data[index].second;
 
-	double division = 1.0 / d_data[index].first.sampleRate;
-	int n = d_data[index].first.buffer.size() / 2;
+	// The samples are only converted to volts for the buffer shown
+	double division = 1.0 / first.sampleRate;
+	int n = first.size() / 2;
 
 	for (int i = -n; i < n; ++i) {
 		xData.push_back(division * i);
@@ -92,21 +194,25 @@ void NetworkAnalyzerBufferViewer::selectBuffersAtIndex(int index, bool moveHandl
 	double min = 0.0;
 
 	QVector<double> yData1, yData2;
-	for (int i = 0; i < d_data[index].first.buffer.size(); ++i) {
-		if (d_data[index].first.buffer[i] > max) {
-			max = d_data[index].first.buffer[i];
-		} else if (d_data[index].first.buffer[i] < min) {
-			min = d_data[index].first.buffer[i];
+	for (size_t i = 0; i < first.size(); ++i) {
+		float value = first.at(i);
+
+		if (value > max) {
+			max = value;
+		} else if (value < min) {
+			min = value;
 		}
-		yData1.push_back(d_data[index].first.buffer[i]);
+		yData1.push_back(value);
 	}
-	for (int i = 0; i < d_data[index].second.buffer.size(); ++i) {
-		if (d_data[index].second.buffer[i] > max) {
-			max = d_data[index].second.buffer[i];
-		} else if (d_data[index].second.buffer[i] < min) {
-			min = d_data[index].second.buffer[i];
+	for (size_t i = 0; i < second.size(); ++i) {
+		float value = second.at(i);
+
+		if (value > max) {
+			max = value;
+		} else if (value < min) {
+			min = value;
 		}
-		yData2.push_back(d_data[index].second.buffer[i]);
+		yData2.push_back(value);
 	}
 
 	d_plot->setYaxis(min - 1.0, max + 1.0);
@@ -117,7 +223,7 @@ void NetworkAnalyzerBufferViewer::selectBuffersAtIndex(int index, bool moveHandl
 	// Move freq. handle on plot if prev/next button
 	// are used to navigate through the buffers
 	if (moveHandle) {
-		Q_EMIT moveHandleAt(d_data[index].first.frequency);
+		Q_EMIT moveHandleAt(first.frequency);
 	}
 }
 
@@ -125,16 +231,16 @@ void NetworkAnalyzerBufferViewer::selectBuffers(double frequency)
 {
 	int index = -1;
 	for (int i = 0; i < d_data.size() - 1; ++i) {
-		if (d_data[i].first.frequency <= frequency
-				&& frequency <= d_data[i + 1].first.frequency) {
+		if (d_data[i].first->frequency <= frequency
+				&& frequency <= d_data[i + 1].first->frequency) {
 			index = i;
 			break;
 		}
-		if (d_data[i + 1].first.frequency < frequency) {
+		if (d_data[i + 1].first->frequency < frequency) {
 			index = d_data.size() - 1;
 
 		}
-		if (frequency < d_data[i].first.frequency) {
+		if (frequency < d_data[i].first->frequency) {
 			index = 0;
 		}
 	}
@@ -169,6 +275,8 @@ void NetworkAnalyzerBufferViewer::clear()
 {
 	d_data.clear();
 	d_selectedBuffersIndex = -1;
+	d_nextBuffer = 0;
+	d_memoryUsed = 0;
 }
 
 void NetworkAnalyzerBufferViewer::sendBufferToOscilloscope()
@@ -181,15 +289,16 @@ void NetworkAnalyzerBufferViewer::sendBufferToOscilloscope()
 	d_osc->remove_ref_waveform("NA2");
 
 	QVector<double> yData1, yData2;
-	auto index = d_selectedBuffersIndex;
-	for (int i = 0; i < d_data[index].first.buffer.size(); ++i) {
-		yData1.push_back(d_data[index].first.buffer[i]);
+	const Buffer& first = *d_data[d_selectedBuffersIndex].first;
+	const Buffer& second = *d_data[d_selectedBuffersIndex].second;
+	for (size_t i = 0; i < first.size(); ++i) {
+		yData1.push_back(first.at(i));
 	}
-	for (int i = 0; i < d_data[index].second.buffer.size(); ++i) {
-		yData2.push_back(d_data[index].second.buffer[i]);
+	for (size_t i = 0; i < second.size(); ++i) {
+		yData2.push_back(second.at(i));
 	}
-	d_osc->add_ref_waveform("NA1", d_currentXdata, yData1, d_data[index].first.sampleRate);
-	d_osc->add_ref_waveform("NA2", d_currentXdata, yData2, d_data[index].second.sampleRate);
+	d_osc->add_ref_waveform("NA1", d_currentXdata, yData1, first.sampleRate);
+	d_osc->add_ref_waveform("NA2", d_currentXdata, yData2, second.sampleRate);
 
 	d_osc->detached();
 }
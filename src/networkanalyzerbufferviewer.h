@@ -23,6 +23,7 @@
 
 #include <QWidget>
 #include <QPushButton>
+#include <QSharedPointer>
 #include "oscilloscope.hpp"
 
 #include "TimeDomainDisplayPlot.h"
@@ -31,19 +32,30 @@ namespace Ui {
 class NetworkAnalyzerBufferViewer;
 }
 
+/*
+ * One channel of a capture, kept as the int16 codes it was computed
+ * from: the voltage of a sample is offset + gain * code.
+ */
 struct Buffer {
-	Buffer() {}
-	Buffer(double frequency, unsigned int sampleRate,
-	       unsigned int bufferSize, const std::vector<float> &buffer):
+	Buffer(): frequency(0), sampleRate(0), gain(0), offset(0) {}
+	Buffer(double frequency, unsigned int sampleRate, float gain,
+	       float offset, std::vector<int16_t> samples):
 		frequency(frequency), sampleRate(sampleRate),
-		bufferSize(bufferSize), buffer(buffer) {}
+		gain(gain), offset(offset), samples(std::move(samples)) {}
+
+	size_t size() const { return samples.size(); }
+	float at(size_t i) const { return offset + gain * samples[i]; }
 
 	double frequency;
 	unsigned int sampleRate;
-	unsigned int bufferSize;
-	std::vector<float> buffer;
+	float gain;
+	float offset;
+	std::vector<int16_t> samples;
 };
 
+typedef QSharedPointer<const Buffer> BufferPtr;
+Q_DECLARE_METATYPE(BufferPtr)
+
 namespace adiscope {
 class NetworkAnalyzerBufferViewer : public QWidget
 {
@@ -54,10 +66,18 @@ public:
 	~NetworkAnalyzerBufferViewer();
 
 	void clear();
-	void pushBuffers(QPair<Buffer, Buffer> buffers);
+	void pushBuffers(BufferPtr first, BufferPtr second);
 	void setOscilloscope(Oscilloscope *osc);
 
-	QPair<Buffer, Buffer> getSelectedBuffers() const;
+	/* Upper bound of the samples kept, the oldest buffers only keep
+	 * their frequency once it is reached */
+	void setMemoryLimit(size_t bytes);
+	size_t memoryLimit() const;
+
+	QPair<BufferPtr, BufferPtr> getSelectedBuffers() const;
+
+	/* All the buffers kept, oldest first */
+	QVector<QPair<BufferPtr, BufferPtr>> buffers() const;
 
 	void selectBuffersAtIndex(int index, bool moveHandle = true);
 	void selectBuffers(double frequency);
@@ -76,15 +96,20 @@ public Q_SLOTS:
 
 private:
 	void _setupPlot();
+	/* Returns the bytes freed */
+	size_t _enforceMemoryLimit(size_t limit);
 
 private:
 	Ui::NetworkAnalyzerBufferViewer *d_ui;
 	TimeDomainDisplayPlot *d_plot;
-	QVector<QPair<Buffer, Buffer>> d_data;
+	QVector<QPair<BufferPtr, BufferPtr>> d_data;
 	int d_selectedBuffersIndex;
 	Oscilloscope *d_osc;
 	QVector<double> d_currentXdata;
 	int d_numBuffers;
+	int d_nextBuffer;
+	size_t d_memoryLimit;
+	size_t d_memoryUsed;
 };
 }
 
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "noise_generator.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+namespace {
+uint64_t splitmix64(uint64_t& x)
+{
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+	return z ^ (z >> 31);
+}
+
+inline uint32_t rotl(uint32_t x, int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+}
+
+NoiseGenerator::NoiseGenerator(analog::noise_type_t type, float amplitude,
+		uint64_t seed) :
+	d_type(type)
+{
+	/* The same dividers and rails as getNoise() */
+	switch (type) {
+	case analog::GR_IMPULSE:
+		d_scale = amplitude / 15;
+		d_limit = amplitude;
+		break;
+	case analog::GR_GAUSSIAN:
+		d_scale = amplitude / 7;
+		d_limit = amplitude / 2;
+		break;
+	case analog::GR_LAPLACIAN:
+		d_scale = amplitude / 14;
+		d_limit = amplitude / 2;
+		break;
+	default:
+		d_scale = amplitude / 2;
+		d_limit = amplitude / 2;
+		break;
+	}
+
+	/* An all zero state would only give zeros */
+	for (size_t lane = 0; lane < lanes; lane++) {
+		uint64_t a = splitmix64(seed), b = splitmix64(seed);
+
+		d_state[0][lane] = (uint32_t)a;
+		d_state[1][lane] = (uint32_t)(a >> 32);
+		d_state[2][lane] = (uint32_t)b;
+		d_state[3][lane] = (uint32_t)(b >> 32) | 1;
+	}
+}
+
+void NoiseGenerator::fillUniform(float *out)
+{
+	for (size_t i = 0; i < block; i += lanes) {
+		for (size_t lane = 0; lane < lanes; lane++) {
+			uint32_t *s0 = &d_state[0][lane];
+			uint32_t *s1 = &d_state[1][lane];
+			uint32_t *s2 = &d_state[2][lane];
+			uint32_t *s3 = &d_state[3][lane];
+			uint32_t result = *s0 + *s3;
+			uint32_t t = *s1 << 9;
+
+			*s2 ^= *s0;
+			*s3 ^= *s1;
+			*s1 ^= *s2;
+			*s0 ^= *s3;
+			*s2 ^= t;
+			*s3 = rotl(*s3, 11);
+
+			/* The 24 high bits, the low ones of xoshiro128+ are
+			 * weak; never 0 so the logarithms stay finite */
+			out[i + lane] = ((result >> 8) + 1) * (1.0f / 16777216.0f);
+		}
+	}
+}
+
+void NoiseGenerator::add(float *out, size_t count)
+{
+	float u[block];
+
+	for (size_t first = 0; first < count; first += block) {
+		size_t n = std::min(block, count - first);
+		float *o = out + first;
+
+		fillUniform(u);
+
+		switch (d_type) {
+		case analog::GR_GAUSSIAN:
+			for (size_t i = 0; i < block; i += 2) {
+				float r = std::sqrt(-2.0f * std::log(u[i]));
+				float a = 2.0f * (float)M_PI * u[i + 1];
+
+				u[i] = r * std::cos(a);
+				u[i + 1] = r * std::sin(a);
+			}
+			break;
+		case analog::GR_LAPLACIAN:
+			for (size_t i = 0; i < block; i++) {
+				u[i] = u[i] > 0.5f ? -std::log(2.0f * (1.0f - u[i])) :
+					std::log(2.0f * u[i]);
+			}
+			break;
+		case analog::GR_IMPULSE:
+			/* As gr::random::impulse(9) */
+			for (size_t i = 0; i < block; i++) {
+				float z = -(float)M_SQRT2 * std::log(u[i]);
+
+				u[i] = std::fabs(z) <= 9.0f ? 0.0f : z;
+			}
+			break;
+		default:
+			for (size_t i = 0; i < block; i++) {
+				u[i] = 2.0f * u[i] - 1.0f;
+			}
+			break;
+		}
+
+		for (size_t i = 0; i < n; i++) {
+			o[i] += std::min(std::max(u[i] * d_scale, -d_limit),
+					d_limit);
+		}
+	}
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NOISE_GENERATOR_HPP
+#define NOISE_GENERATOR_HPP
+
+#include <gnuradio/analog/noise_type.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace adiscope {
+	/*
+	 * The noise the Signal Generator adds to its signals, with the
+	 * scaling and the clamp of the noise_source_f -> rail_ff pair of
+	 * SignalGenerator::getNoise(), for the signals computed without a
+	 * flowgraph.
+	 *
+	 * The uniform numbers come from several xoshiro128+ generators
+	 * stepped side by side, so the loops over them vectorize; the
+	 * gaussian noise uses the Box-Muller transform on pairs of them.
+	 */
+	class NoiseGenerator
+	{
+	public:
+		NoiseGenerator(gr::analog::noise_type_t type, float amplitude,
+				uint64_t seed);
+
+		/* Adds the next count noise samples to out */
+		void add(float *out, size_t count);
+
+	private:
+		static const size_t lanes = 8;
+		static const size_t block = 256;
+
+		/* block uniform numbers in (0, 1] */
+		void fillUniform(float *out);
+
+		gr::analog::noise_type_t d_type;
+		float d_scale;
+		float d_limit;
+		uint32_t d_state[4][lanes];
+	};
+}
+
+#endif /* NOISE_GENERATOR_HPP */
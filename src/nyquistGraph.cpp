@@ -25,6 +25,7 @@
 #include <QPointF>
 #include <QRect>
 #include <QApplication>
+#include <QTimer>
 
 #include <QDebug>
 
@@ -36,22 +37,26 @@
 #include <qwt_polar_grid.h>
 #include <qwt_polar_marker.h>
 
+#include <algorithm>
+
 namespace adiscope {
 	class NyquistSamplesArray : public QwtArraySeriesData<QwtPointPolar>
 	{
 	public:
 		NyquistSamplesArray() : QwtArraySeriesData<QwtPointPolar>() {}
 
-		void addSample(const QwtPointPolar& point) {
-			d_samples.push_back(point);
-		}
-		void clear() { d_samples.clear(); }
+		void addSample(const QwtPointPolar& point);
+		void clear() { d_samples.clear(); d_bounds = QRectF(); }
 		void reserve(unsigned int nb) { d_samples.reserve(nb); }
-		QRectF boundingRect() const;
+		QRectF boundingRect() const { return d_bounds; }
 
 		QwtPointPolar sample(size_t index) const {
 			return d_samples.at(index);
 		}
+
+	private:
+		// Grown with every sample, the curve is append only
+		QRectF d_bounds;
 	};
 }
 
@@ -61,26 +66,19 @@ using namespace adiscope;
 const QwtInterval radialInterval( 0.0, 10.0 );
 const QwtInterval azimuthInterval( 0.0, 360.0 );
 
-QRectF NyquistSamplesArray::boundingRect() const
+void NyquistSamplesArray::addSample(const QwtPointPolar& point)
 {
-	double xmin = 0.0, xmax = 0.0, ymin = 0.0, ymax = 0.0;
-
-	for (auto it = d_samples.begin();
-			it != d_samples.end(); ++it) {
-		double point_x = it->radius() * cos(it->azimuth());
-		double point_y = it->radius() * sin(it->azimuth());
-
-		if (point_x < xmin)
-			xmin = point_x;
-		else if (point_x > xmax)
-			xmax = point_x;
-		if (point_y < ymin)
-			ymin = point_y;
-		else if (point_y > ymax)
-			ymax = point_y;
-	}
+	double point_x = point.radius() * cos(point.azimuth());
+	double point_y = point.radius() * sin(point.azimuth());
+
+	// The origin is always part of the bounds
+	double xmin = std::min(d_bounds.left(), point_x);
+	double xmax = std::max(d_bounds.right(), point_x);
+	double ymin = std::min(d_bounds.top(), point_y);
+	double ymax = std::max(d_bounds.bottom(), point_y);
 
-	return QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax));
+	d_bounds = QRectF(QPointF(xmin, ymin), QPointF(xmax, ymax));
+	d_samples.push_back(point);
 }
 
 NyquistGraph::NyquistGraph(QWidget *parent) : QwtPolarPlot(parent),
@@ -117,6 +115,11 @@ NyquistGraph::NyquistGraph(QWidget *parent) : QwtPolarPlot(parent),
 
 	curve.setData(samples);
 	curve.attach(this);
+
+	d_replotTimer = new QTimer(this);
+	d_replotTimer->setSingleShot(true);
+	d_replotTimer->setInterval(1000 / 25);
+	connect(d_replotTimer, SIGNAL(timeout()), SLOT(replot()));
 }
 
 NyquistGraph::~NyquistGraph()
@@ -173,7 +176,10 @@ void NyquistGraph::plot(double azimuth, double radius)
 		return;
 
 	samples->addSample(QwtPointPolar(azimuth, radius));
-	replot();
+
+	if (!d_replotTimer->isActive()) {
+		d_replotTimer->start();
+	}
 }
 
 int NyquistGraph::getNumSamples() const
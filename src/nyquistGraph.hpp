@@ -21,7 +21,6 @@
 #ifndef NYQUISTGRAPH_HPP
 #define NYQUISTGRAPH_HPP
 
-#include "customFifo.hpp"
 #include "dbgraph.hpp"
 #include "nyquistplotzoomer.h"
 
@@ -32,6 +31,8 @@
 #include <QPushButton>
 #include <QMouseEvent>
 
+class QTimer;
+
 class QwtPolarGrid;
 
 namespace adiscope {
@@ -98,6 +99,9 @@ namespace adiscope {
 		NyquistPlotZoomer *zoomer;
 		double m_thickness;
 
+		// Coalesces the replots of the points added during a sweep
+		QTimer *d_replotTimer;
+
 	};
 }
 
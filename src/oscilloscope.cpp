@@ -22,15 +22,11 @@
 #include <boost/make_shared.hpp>
 
 /* GNU Radio includes */
-#include <gnuradio/blocks/float_to_complex.h>
-#include <scopy/math.h>
 #include <gnuradio/blocks/sub.h>
 #include <gnuradio/filter/iir_filter_ffd.h>
 #include <gnuradio/blocks/nlog10_ff.h>
 #include <gnuradio/blocks/head.h>
 #include <gnuradio/blocks/null_source.h>
-#include <gnuradio/blocks/null_sink.h>
-#include <gnuradio/blocks/multiply_const.h>
 
 /* Qt includes */
 #include <QtWidgets>
@@ -39,6 +35,9 @@
 #include <QtWidgets/QSpacerItem>
 #include <QSignalBlocker>
 #include <QComboBox>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 /* Local includes */
 #include "logging_categories.h"
@@ -49,14 +48,25 @@
 #include "measurement_gui.h"
 #include "measure_settings.h"
 #include "statistic_widget.h"
+#include "batch_measurement.h"
+#include "mask_test.h"
+#include "eye_diagram.h"
+#include "math_frame_sink.h"
+#include "jitter_analysis.h"
+#include "capture_latency.h"
 #include "state_updater.h"
 #include "osc_capture_params.hpp"
 #include "buffer_previewer.hpp"
 #include "config.h"
 #include "customplotpositionbutton.h"
 #include "channel_widget.hpp"
-#include "signal_sample.hpp"
 #include "filemanager.h"
+#include "export_service.hpp"
+#include "performance_monitor.hpp"
+#include "memory_budget.hpp"
+#include "persistence_map.h"
+#include "capture_store.h"
+#include "mixed_signal_plot_item.h"
 
 #include "oscilloscope_api.hpp"
 
@@ -73,10 +83,14 @@
 #include "ui_oscilloscope.h"
 #include "ui_trigger_settings.h"
 
-#define MAX_MATH_CHANNELS 4
+#define MAX_MATH_CHANNELS 8
 #define MAX_MATH_RANGE SHRT_MAX
 #define MIN_MATH_RANGE SHRT_MIN
 #define MAX_AMPL 25
+#define MAX_SEGMENTS 1024
+#define MASK_MARGIN_DIVS 0.5
+#define MASK_RESULT_UPDATE_MS 250
+#define JITTER_HYSTERESIS_RATIO 0.1f
 
 using namespace adiscope;
 using namespace gr;
@@ -99,7 +113,6 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	xy_plot(nb_channels / 2, this),
 	hist_plot(nb_channels, this),
 	ids(new iio_manager::port_id[nb_channels]),
-	autoset_id(new iio_manager::port_id),
 	hist_ids(new iio_manager::port_id[nb_channels]),
 	fft_is_visible(false), hist_is_visible(false), xy_is_visible(false),
 	statistics_enabled(false),
@@ -113,14 +126,27 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	addChannel(true),
 	index_x(0),
 	index_y(1),
-	ftc(nullptr),
-	locked(false),
 	triggerAcCoupled(false),
 	autosetRequested(false),
 	autosetEnabled(true),
 	memory_adjusted_time_pos(0),
 	plot_samples_sequentially(false),
 	d_displayOneBuffer(true),
+	nb_segments(0),
+	current_segment(0),
+	persistence_enabled(false),
+	acquisition_mode(WaveformAverager::NORMAL),
+	acquisition_count(1),
+	hw_high_res(false),
+	mixed_signal_item(nullptr),
+	display_rate(10),
+	frames_displayed(0),
+	statistics_window(100),
+	histogram_accumulate(false),
+	software_trigger_type(SoftwareTrigger::NONE),
+	software_trigger_runt_high(0),
+	software_trigger_min_width(0),
+	software_trigger_max_width(0),
 	nb_ref_channels(0),
 	lastFunctionValid(false),
 	import_error(""),
@@ -143,10 +169,6 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 		symmBufferMode->setTriggerBufferMaxSize(8192); // 8192 is what hardware supports
 		symmBufferMode->setTimeDivisionCount(plot.xAxisNumDiv());
 	}
-	dc_cancel.push_back(gnuradio::get_initial_sptr(
-			new cancel_dc_offset_block(1, true)));
-	dc_cancel.push_back(gnuradio::get_initial_sptr(
-			new cancel_dc_offset_block(1, true)));
 
 	/* Measurements Settings */
 	measure_settings_init();
@@ -163,8 +185,10 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	this->qt_time_block = adiscope::scope_sink_f::make(0, adc->sampleRate(),
 		"Osc Time", nb_channels, (QObject *)&plot);
 
-	this->qt_fft_block = adiscope::scope_sink_f::make(fft_plot_size, adc->sampleRate(),
-			"Osc Frequency", nb_channels, (QObject *)&fft_plot);
+	// Added as a listener of the time sink only while the FFT is shown
+	fft_frames = std::make_shared<FftFrameSink>((QObject *)&fft_plot,
+			nb_channels);
+	fft_frames->setUpdateTime(1.0 / display_rate);
 
 	this->qt_hist_block = adiscope::histogram_sink_f::make(1024, 250, 0, 20,
 			"Osc Histogram", nb_channels, (QObject *)&hist_plot);
@@ -174,6 +198,38 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 
 	this->qt_time_block->set_trigger_mode(TRIG_MODE_TAG, 0, "buffer_start");
 
+	// The histogram is built from the frames of the time plot
+	this->qt_time_block->add_frame_listener(qt_hist_block.get());
+
+	// So are the measurements of the scripting API's batches
+	batch_measurement = std::make_shared<BatchMeasurement>();
+	this->qt_time_block->add_frame_listener(batch_measurement.get());
+
+	capture_latency = std::make_shared<CaptureLatency>();
+	this->qt_time_block->set_capture_latency(capture_latency);
+
+	// And the mask test, on a thread of its own
+	mask_test = std::make_shared<MaskTest>();
+	mask_test->setFailureCallback([this]() {
+		QMetaObject::invokeMethod(this, "maskTestFailed",
+				Qt::QueuedConnection);
+	});
+	this->qt_time_block->add_frame_listener(mask_test.get());
+
+	// Added as a listener only while enabled
+	eye_diagram = std::make_shared<EyeDiagram>();
+
+	// The math channels, and the XY plot which may show them
+	math_frames = std::make_shared<MathFrameSink>((QObject *)&plot,
+			MIN_MATH_RANGE, MAX_MATH_RANGE);
+	math_frames->setUpdateTime(1.0 / display_rate);
+	this->qt_time_block->add_frame_listener(math_frames.get());
+
+	xy_density_accumulate = false;
+
+	jitter_result.reset(new JitterAnalysis::Result(statistics_window));
+	jitter_channel = -1;
+
 	// Prevent the application from hanging while waiting for a trigger condition
 	iio_context_set_timeout(ctx, UINT_MAX);
 
@@ -233,8 +289,7 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 
 		channels_api.append(new Channel_API(this));
 	}
-	triggerLevelSink = QPair<boost::shared_ptr<signal_sample>, int>(
-				nullptr, -1);
+	ac_trigger_channel = -1;
 
 	connect(ui->rightMenu, SIGNAL(finished(bool)), this,
 			SLOT(rightMenuFinished(bool)));
@@ -262,8 +317,10 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	if (started)
 		iio->lock();
 
+	/* The conversion block reads the raw ADC samples and converts
+	 * them to volts in a single pass */
 	auto adc_samp_conv = gnuradio::get_initial_sptr(
-			new adc_sample_conv(nb_channels, m2k_adc));
+			new adc_sample_conv(nb_channels, m2k_adc, false, true));
 	if (m2k_adc) {
 		adc_samp_conv->setCorrectionGain(0,
 			m2k_adc->chnCorrectionGain(0));
@@ -274,11 +331,9 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		ids[i] = iio->connect(adc_samp_conv, i, i,
-				true, qt_time_block->nsamps());
+				false, qt_time_block->nsamps());
 
 		iio->connect(adc_samp_conv, i, qt_time_block, i);
-
-		iio->connect(adc_samp_conv, i, qt_hist_block, i);
 	}
 
 	adc_samp_conv_block = adc_samp_conv;
@@ -329,28 +384,16 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	plot.setSampleRate(adc->sampleRate(), 1, "");
 	plot.setActiveVertAxis(0);
 
-	started = isIioManagerStarted();
-	if (started)
-		iio->lock();
-
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		plot.Curve(i)->setAxes(
 				QwtAxisId(QwtPlot::xBottom, 0),
 				QwtAxisId(QwtPlot::yLeft, i));
 		plot.addZoomer(i);
 		probe_attenuation.push_back(1);
-		auto multiply = gr::blocks::multiply_const_ff::make(1);
-		auto null_sink = gr::blocks::null_sink::make(sizeof(float));
-		math_probe_atten.push_back(multiply);
-		iio->connect(adc_samp_conv_block, i, math_probe_atten.at(i), 0);
-		iio->connect(math_probe_atten.at(i), 0, null_sink, 0);
 
 		plot.Curve(i)->setTitle("CH " + QString::number(i + 1));
 	}
 
-	if (started)
-		iio->unlock();
-
 
 	plot.levelTriggerA()->setMobileAxis(QwtAxisId(QwtPlot::yLeft, 0));
 	plot.setTriggerAEnabled(trigger_settings.analogEnabled());
@@ -525,6 +568,15 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	connect(gsettings_ui->Histogram_view, SIGNAL(toggled(bool)),
 		SLOT(onHistogram_view_toggled(bool)));
 
+	mask_test_timer = new QTimer(this);
+	mask_test_timer->setInterval(MASK_RESULT_UPDATE_MS);
+	connect(mask_test_timer, SIGNAL(timeout()),
+		SLOT(updateMaskTestResult()));
+	connect(gsettings_ui->maskTest, &QPushButton::toggled,
+		this, &Oscilloscope::setMaskTestEnabled);
+	connect(gsettings_ui->maskStopOnFail, &QPushButton::toggled,
+		[=](bool on) { mask_test->setStopOnFailure(on); });
+
 	ch_ui->btnAutoset->setEnabled(false);
 
 	connect(ui->runSingleWidget, &RunSingleWidget::toggled,
@@ -600,6 +652,12 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 
 	connect(&trigger_settings, SIGNAL(levelChanged(double)),
 		SLOT(onTriggerLevelChanged(double)));
+	connect(&trigger_settings, SIGNAL(levelChanged(double)),
+		SLOT(updateSoftwareTrigger()));
+	connect(&trigger_settings, SIGNAL(sourceChanged(int)),
+		SLOT(updateSoftwareTrigger()));
+	connect(&trigger_settings, SIGNAL(analogTriggerEnabled(bool)),
+		SLOT(updateSoftwareTrigger()));
 
 	connect(&trigger_settings, SIGNAL(triggerModeChanged(int)),
 		this, SLOT(onTriggerModeChanged(int)));
@@ -616,6 +674,9 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	connect(&*iio, SIGNAL(timeout()),
 			SLOT(onIioDataRefillTimeout()));
 	connect(&plot, SIGNAL(newData()), this, SLOT(onPlotNewData()));
+	connect(&plot, SIGNAL(newData()), api, SLOT(capturePlotted()));
+	connect(this, &Tool::displayedChanged,
+		this, &Oscilloscope::onDisplayedChanged);
 
 	connect(ch_ui->cmbMemoryDepth, SIGNAL(currentTextChanged(QString)),
 		this, SLOT(onCmbMemoryDepthChanged(QString)));
@@ -701,23 +762,13 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 			plot.setDisplayScale(probe_attenuation[current_ch_widget]);
 		}
 
-		bool started = isIioManagerStarted();
-		if (started)
-			iio->lock();
-
-		// Update the multiplier value for this channel
-		if (current_ch_widget < math_probe_atten.size()) {
-			math_probe_atten[current_ch_widget]->set_k(value);
+		// The math channels see the attenuated samples, from the
+		// next frame on
+		if (current_ch_widget < nb_channels) {
+			math_frames->setInputGain(current_ch_widget, value);
 		}
 
 		auto max_elem = max_element(probe_attenuation.begin(), probe_attenuation.begin() + nb_channels);
-		for (auto rail : math_rails.values()) {
-			rail->set_lo(MIN_MATH_RANGE);
-			rail->set_hi(MAX_MATH_RANGE);
-		}
-
-		if (started)
-			iio->unlock();
 
 		for (int i = 0; i < nb_channels + nb_math_channels + nb_ref_channels; ++i) {
 			QLabel *label = static_cast<QLabel *>(
@@ -770,6 +821,27 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 	api->load(*settings);
 	api->js_register(engine);
 
+	PerformanceMonitor *perf = PerformanceMonitor::instance();
+	perf->addRate(this, api->objectName(), "frames_acquired", [=]() {
+		return qt_time_block ? (double)qt_time_block->frames_acquired() : 0.0;
+	});
+	perf->addRate(this, api->objectName(), "frames_posted", [=]() {
+		return qt_time_block ? (double)qt_time_block->frames_posted() : 0.0;
+	});
+	perf->addPaintRate(plot.canvas(), api->objectName(), "plot_fps");
+	perf->addGauge(this, api->objectName(), "measure_ms", [=]() {
+		return plot.lastMeasureTime() * 1e3;
+	});
+
+	MemoryBudget *budget = MemoryBudget::instance();
+	budget->addUsage(this, api->objectName(), tr("capture buffers"), [=]() {
+		return (size_t)active_plot_sample_count *
+			(nb_channels + nb_math_channels) * sizeof(float);
+	});
+	budget->addUsage(this, api->objectName(), tr("references"), [=]() {
+		return plot.referenceMemory();
+	});
+
 	plot.setDisplayScale(probe_attenuation[current_channel]);
 	onTriggerSourceChanged(trigger_settings.currentChannel());
 	for (int i = 0; i < nb_channels + nb_math_channels + nb_ref_channels; ++i) {
@@ -826,27 +898,11 @@ Oscilloscope::Oscilloscope(struct iio_context *ctx, Filter *filt,
 int Oscilloscope::binSearchPointOnXaxis(double time)
 {
 	int n = plot.Curve(0)->data()->size();
-	if (time <= plot.Curve(0)->data()->sample(0).x()) {
+	if (n == 0) {
 		return 0;
 	}
-	if (time >= plot.Curve(0)->data()->sample(n - 1).x()) {
-		return n - 1;
-	}
 
-	int left = 0;
-	int right = n - 1;
-	while (left <= right) {
-		int mid = (left + right) / 2;
-		double xData = plot.Curve(0)->data()->sample(mid).x();
-		if (xData == time) {
-			return mid;
-		} else if (xData < time) {
-			left = mid + 1;
-		} else {
-			right = mid - 1;
-		}
-	}
-	return left;
+	return std::min(plot.sampleIndexAt(0, time), n - 1);
 }
 
 void Oscilloscope::resetHistogramDataPoints()
@@ -858,7 +914,7 @@ void Oscilloscope::resetHistogramDataPoints()
 	int posMin = binSearchPointOnXaxis(zoomMinTime);
 	int posMax = binSearchPointOnXaxis(zoomMaxTime);
 
-	hist_plot.setDataInterval(posMin, posMax + 1);
+	qt_hist_block->set_data_interval(posMin, posMax + 1);
 }
 
 bool Oscilloscope::isIioManagerStarted() const
@@ -1033,7 +1089,8 @@ void Oscilloscope::add_ref_waveform(unsigned int chIdx)
 
 	double ref_waveform_timebase = refChannelTimeBase->value();
 
-	int nr_of_samples_in_file = import_data.size();
+	int nr_of_samples_in_file = import_ref ? import_ref->rows() :
+		import_data.size();
 
 	double mid_point_on_screen = (timeBase->value() * 8) - ((
 					     timeBase->value() * 8) - timePosition->value());
@@ -1041,26 +1098,38 @@ void Oscilloscope::add_ref_waveform(unsigned int chIdx)
 	double x_axis_step_size = (ref_waveform_timebase /
 				   (nr_of_samples_in_file / plot.xAxisNumDiv()));
 
-	for (int i = -(nr_of_samples_in_file / 2); i < (nr_of_samples_in_file / 2);
-	     ++i) {
-		xData.push_back(mid_point_on_screen + ((double)i * x_axis_step_size));
-	}
+	if (import_ref) {
+		/* The curve reads the mapped samples, with their cached
+		 * pyramid */
+		int column = chIdx + (import_ref->hasXColumn() ? 1 : 0);
+		double start = mid_point_on_screen -
+			(nr_of_samples_in_file / 2) * x_axis_step_size;
+
+		plot.registerReferenceWaveform(qname,
+				import_ref->seriesData(column, start,
+						       x_axis_step_size),
+				import_ref->pyramid(column));
+	} else {
+		for (int i = -(nr_of_samples_in_file / 2); i < (nr_of_samples_in_file / 2);
+		     ++i) {
+			xData.push_back(mid_point_on_screen + ((double)i * x_axis_step_size));
+		}
 
-	if (!refChannelTimeBase->isEnabled()) chIdx++;
+		if (!refChannelTimeBase->isEnabled()) chIdx++;
 
-	for (int i = 0; i < import_data.size(); ++i) {
-		if (chIdx >= import_data[i].size()) {
-			continue;
+		for (int i = 0; i < import_data.size(); ++i) {
+			if (chIdx >= import_data[i].size()) {
+				continue;
+			}
+			yData.push_back(import_data[i][chIdx]);
 		}
-		yData.push_back(import_data[i][chIdx]);
+
+		plot.registerReferenceWaveform(qname, xData, yData);
 	}
 
-	qDebug() << "Added ref waveform with nr of samples: " << yData.size();
 	qDebug() << "TimeBase: " << refChannelTimeBase->value();
 	qDebug() << "Number of samples in file: " << nr_of_samples_in_file;
 
-	plot.registerReferenceWaveform(qname, xData, yData);
-
 	ChannelWidget *channel_widget = new ChannelWidget(curve_id, true, false,
 	                plot.getLineColor(curve_id).name(), this);
 
@@ -1131,18 +1200,19 @@ void Oscilloscope::add_ref_waveform(unsigned int chIdx)
 	init_selected_measurements(curve_id, {0, 1, 4, 5});
 }
 
-void Oscilloscope::updateTriggerLevelValue(std::vector<float> value)
+void Oscilloscope::updateTriggerLevelValue()
 {
-	if (!triggerLevelSink.first) {
+	if (ac_trigger_channel < 0) {
 		return;
 	}
 
-	triggerLevelSink.first->blockSignals(true);
+	boost::shared_ptr<adc_sample_conv> block =
+	dynamic_pointer_cast<adc_sample_conv>(
+					adc_samp_conv_block);
 
-	float val = dc_cancel.at(triggerLevelSink.second)->get_dc_offset();
+	float val = block->dcOffset(ac_trigger_channel);
 	double m_dc_level = trigger_settings.dcLevel();
 	if ((int)(val*1e3) == (int)(m_dc_level*1e3)) {
-		triggerLevelSink.first->blockSignals(false);
 		return;
 	}
 	if (trigger_settings.analogEnabled()) {
@@ -1150,7 +1220,6 @@ void Oscilloscope::updateTriggerLevelValue(std::vector<float> value)
 		trigger_settings.onSpinboxTriggerLevelChanged(
 					trigger_settings.level());
 	}
-	triggerLevelSink.first->blockSignals(false);
 }
 
 Oscilloscope::~Oscilloscope()
@@ -1161,6 +1230,8 @@ Oscilloscope::~Oscilloscope()
 	ui->runSingleWidget->toggle(false);
 	setDynamicProperty(runButton(), "disabled", false);
 
+	stopRecording();
+
 	bool started = isIioManagerStarted();
 	if (started)
 		iio->lock();
@@ -1168,17 +1239,19 @@ Oscilloscope::~Oscilloscope()
 	for (unsigned int i = 0; i < nb_channels; i++)
 		iio->disconnect(ids[i]);
 
-	if (fft_is_visible) {
-		if (fft_channels.size() > 0) {
-			fft_channels.clear();
-			fft_blocks.clear();
-			ctm_blocks.clear();
-		}
-	}
-
 	if (started)
 		iio->unlock();
 
+	qt_time_block->remove_frame_listener(batch_measurement.get());
+	qt_time_block->remove_frame_listener(fft_frames.get());
+	qt_time_block->remove_frame_listener(mask_test.get());
+	qt_time_block->remove_frame_listener(eye_diagram.get());
+	qt_time_block->remove_frame_listener(math_frames.get());
+	math_frames->remove_frame_listener(qt_xy_block.get());
+	mask_test->setEnabled(false);
+	qt_time_block->set_capture_latency(nullptr);
+	setMixedSignal(false);
+
 	gr::hier_block2_sptr hier = iio->to_hier_block2();
 	qDebug(CAT_OSCILLOSCOPE) << "OSC disconnected:\n" << gr::dot_graph(hier).c_str();
 
@@ -1195,7 +1268,6 @@ Oscilloscope::~Oscilloscope()
 
 	delete[] hist_ids;
 	delete[] ids;
-	delete autoset_id;
 	delete ch_ui;
 	delete gsettings_ui;
 	delete measure_panel_ui;
@@ -1250,7 +1322,8 @@ void Oscilloscope::readPreferences()
 	}
 
 	update_chn_settings_panel(current_ch_widget);
-	m2k_adc->setFilteringEnabled(prefPanel->getOsc_filtering_enabled());
+	applyAdcFiltering();
+	iio->set_kernel_buffers_count(prefPanel->getAdc_kernel_buffers());
 }
 
 void Oscilloscope::toggleMiniHistogramPlotVisible(bool enabled)
@@ -1304,24 +1377,20 @@ void Oscilloscope::init_channel_settings()
 			}
 
 			if (!fileName.isEmpty()) {
-				FileManager fm("Oscilloscope");
-				fm.open(fileName, FileManager::EXPORT);
-
-				QVector<double> time_data, volts_data;
+				std::shared_ptr<FileManager> fm =
+					std::make_shared<FileManager>("Oscilloscope");
+				fm->open(fileName, FileManager::EXPORT);
 
 				QwtPlotCurve *curve = plot.Curve(current_ch_widget);
 
-				for (size_t i = 0; i < curve->data()->size(); ++i) {
-					time_data.push_back(curve->sample(i).x());
-					volts_data.push_back(curve->sample(i).y());
-				}
-
-				fm.save(time_data, "Time(S)");
-				fm.save(volts_data, "Ref");
+				fm->save(FileManager::seriesSnapshot(curve->data(), false),
+					"Time(S)");
+				fm->save(FileManager::seriesSnapshot(curve->data(), true),
+					"Ref");
 
-				fm.setSampleRate(active_sample_rate);
+				fm->setSampleRate(active_sample_rate);
 
-				fm.performWrite();
+				ExportService::instance()->start(this, fileName, fm);
 			}
 		} else {
 			// snapshot
@@ -1349,189 +1418,72 @@ void Oscilloscope::init_channel_settings()
 	});
 }
 
-void Oscilloscope::activateAcCoupling(int i)
+void Oscilloscope::updateAcOutputMultiple(bool stopped)
 {
-	double alpha, beta;
-	bool trigger = (i == trigger_settings.currentChannel())
-			&& trigger_settings.analogEnabled();
-	if (trigger) {
-		trigger_settings.setAcCoupled(true, i);
-	}
-
-	bool started = isIioManagerStarted();
-	if(started) {
-		iio->lock();
-	}
-
 	boost::shared_ptr<adc_sample_conv> block =
 	dynamic_pointer_cast<adc_sample_conv>(
 					adc_samp_conv_block);
 
-	iio->disconnect(block, i, qt_time_block, i);
-	iio->disconnect(adc_samp_conv_block, i, math_probe_atten.at(i), 0);
-
-	iio->connect(block, i, dc_cancel.at(i), 0);
-	iio->connect(dc_cancel.at(i), 0, qt_time_block, i);
-	iio->connect(dc_cancel.at(i), 0, math_probe_atten.at(i), 0);
-
-	iio->disconnect(block, i, qt_hist_block, i);
-	iio->connect(dc_cancel.at(i), 0, qt_hist_block, i);
-
-	if (trigger && !triggerLevelSink.first) {
-		triggerLevelSink.first = boost::make_shared<signal_sample>();
-		triggerLevelSink.second = i;
-		keep_one = gr::blocks::keep_one_in_n::make(sizeof(float), active_sample_count);
-		connect(&*triggerLevelSink.first, SIGNAL(triggered(std::vector<float>)),
-			this, SLOT(updateTriggerLevelValue(std::vector<float>)));
-		iio->connect(dc_cancel.at(i), 0, keep_one, 0);
-		iio->connect(keep_one, 0, triggerLevelSink.first, 0);
-	}
-
-	if (xy_is_visible) {
-		iio->disconnect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-				ftc, 0);
-		iio->disconnect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-				ftc, 1);
-		xy_channels.clear();
-
-		for(unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (chnAcCoupled.at(ch)) {
-				xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      dc_cancel.at(ch), 0));
-			} else {
-				xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      adc_samp_conv_block, ch));
-			}
-		}
+	block->setAcBlockSize(active_sample_count);
 
-		iio->connect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-			     ftc, 0);
-		iio->connect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-			     ftc, 1);
+	/* The mean of a buffer is only known once all of it went through
+	 * the conversion, so the block works on whole buffers while a
+	 * channel is AC coupled. The GNU Radio buffers are sized for it
+	 * when the flowgraph starts. */
+	int multiple = block->acOutputMultiple();
+	if (block->output_multiple() == multiple) {
+		return;
 	}
 
-	if (fft_is_visible) {
-		for (unsigned int i = 0; i < nb_channels; i++) {
-			iio->disconnect(fft_channels.at(i).first, fft_channels.at(i).second,
-					fft_blocks.at(i), 0);
-		}
-		fft_channels.clear();
-
-		for(unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (chnAcCoupled.at(ch)) {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      dc_cancel.at(ch), 0));
-			} else {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      adc_samp_conv_block, ch));
-			}
-
-			iio->connect(fft_channels.at(ch).first, fft_channels.at(ch).second,
-				     fft_blocks.at(ch), 0);
-		}
+	bool started = !stopped && isIioManagerStarted();
+	if(started) {
+		iio->lock();
 	}
 
-	for(int ch = 0; ch < nb_channels; ch++) {
-		iio->set_buffer_size(ids[ch], active_sample_count);
-		dc_cancel.at(ch)->set_buffer_size(active_sample_count);
-	}
+	block->set_output_multiple(multiple);
 
 	if(started) {
 		iio->unlock();
 	}
 }
 
-void Oscilloscope::deactivateAcCoupling(int i)
+void Oscilloscope::activateAcCoupling(int i)
 {
 	bool trigger = (i == trigger_settings.currentChannel())
 			&& trigger_settings.analogEnabled();
 	if (trigger) {
-		trigger_settings.setAcCoupled(false, i);
-	}
-
-	bool started = isIioManagerStarted();
-	if(started) {
-		iio->lock();
+		trigger_settings.setAcCoupled(true, i);
+		ac_trigger_channel = i;
 	}
 
 	boost::shared_ptr<adc_sample_conv> block =
 	dynamic_pointer_cast<adc_sample_conv>(
 					adc_samp_conv_block);
 
-	iio->disconnect(dc_cancel.at(i), 0, math_probe_atten.at(i), 0);
-	iio->connect(adc_samp_conv_block, i, math_probe_atten.at(i), 0);
-
-	iio->disconnect(block, i, dc_cancel.at(i), 0);
-	iio->disconnect(dc_cancel.at(i), 0, qt_time_block, i);
-
-	iio->connect(block, i, qt_time_block, i);
-
-	iio->disconnect(dc_cancel.at(i), 0, qt_hist_block, i);
-	iio->connect(block, i, qt_hist_block, i);
-
-	if (trigger && triggerLevelSink.first) {
-		disconnect(&*triggerLevelSink.first, SIGNAL(triggered(std::vector<float>)),
-			this, SLOT(updateTriggerLevelValue(std::vector<float>)));
-
-		iio->disconnect(dc_cancel.at(i), 0, keep_one, 0);
-		iio->disconnect(keep_one, 0, triggerLevelSink.first, 0);
-		trigger_settings.updateHwVoltLevels(i);
-		triggerLevelSink.first = nullptr;
-		triggerLevelSink.second = -1;
-		keep_one = nullptr;
-	}
-
-	if (xy_is_visible) {
-		iio->disconnect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-				ftc, 0);
-		iio->disconnect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-				ftc, 1);
-		xy_channels.clear();
-
-		for(unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (chnAcCoupled.at(ch) && (ch != i)) {
-				xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      dc_cancel.at(ch), 0));
-			} else {
-				xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      adc_samp_conv_block, ch));
-			}
-		}
+	// Applied by the conversion from its next buffer on, to every
+	// view of the channel
+	block->setAcCoupling(i, true);
+	updateAcOutputMultiple();
+}
 
-		iio->connect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-			     ftc, 0);
-		iio->connect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-			     ftc, 1);
+void Oscilloscope::deactivateAcCoupling(int i)
+{
+	bool trigger = (i == trigger_settings.currentChannel())
+			&& trigger_settings.analogEnabled();
+	if (trigger) {
+		trigger_settings.setAcCoupled(false, i);
 	}
 
-	if (fft_is_visible) {
-		for (unsigned int ch = 0; ch < nb_channels; ch++) {
-			iio->disconnect(fft_channels.at(ch).first, fft_channels.at(ch).second,
-					fft_blocks.at(ch), 0);
-		}
-		fft_channels.clear();
-
-		for(unsigned int ch = 0; ch < nb_channels; ch++) {
-			if (chnAcCoupled.at(ch) && ch != i) {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      dc_cancel.at(ch), 0));
-			} else {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      adc_samp_conv_block, ch));
-			}
-
-			iio->connect(fft_channels.at(ch).first, fft_channels.at(ch).second,
-				     fft_blocks.at(ch), 0);
-		}
-	}
+	boost::shared_ptr<adc_sample_conv> block =
+	dynamic_pointer_cast<adc_sample_conv>(
+					adc_samp_conv_block);
 
-	for(int ch = 0; ch < nb_channels; ch++) {
-		iio->set_buffer_size(ids[ch], active_sample_count);
-		dc_cancel.at(ch)->set_buffer_size(active_sample_count);
-	}
+	block->setAcCoupling(i, false);
+	updateAcOutputMultiple();
 
-	if(started) {
-		iio->unlock();
+	if (trigger && ac_trigger_channel >= 0) {
+		trigger_settings.updateHwVoltLevels(i);
+		ac_trigger_channel = -1;
 	}
 }
 
@@ -1549,47 +1501,19 @@ void Oscilloscope::configureAcCouplingTrigger(bool enabled)
 void Oscilloscope::activateAcCouplingTrigger(int chIdx)
 {
 	trigger_settings.setAcCoupled(true, chIdx);
-	if (!triggerLevelSink.first) {
-		bool started = isIioManagerStarted();
-		if (started) {
-			iio->lock();
-		}
-		triggerLevelSink.first = boost::make_shared<signal_sample>();
-		triggerLevelSink.second = chIdx;
-		keep_one = gr::blocks::keep_one_in_n::make(sizeof(float), 100);
-		connect(&*triggerLevelSink.first, SIGNAL(triggered(std::vector<float>)),
-			this, SLOT(updateTriggerLevelValue(std::vector<float>)));
-		iio->connect(dc_cancel.at(triggerLevelSink.second), 0, keep_one, 0);
-		iio->connect(keep_one, 0, triggerLevelSink.first, 0);
-
-		if (started) {
-			iio->unlock();
-		}
-	}
+
+	/* The level follows the DC offset removed by the conversion,
+	 * read after every frame */
+	ac_trigger_channel = chIdx;
 }
 
 void Oscilloscope::deactivateAcCouplingTrigger()
 {
-	trigger_settings.setAcCoupled(false, triggerLevelSink.second);
-	if (triggerLevelSink.first) {
-		bool started = isIioManagerStarted();
-		if (started) {
-			iio->lock();
-		}
-		/* Disconnect the SLOT */
-		disconnect(&*triggerLevelSink.first, SIGNAL(triggered(std::vector<float>)),
-			this, SLOT(updateTriggerLevelValue(std::vector<float>)));
-		/* Disconnect the GNU Radio block */
-		iio->disconnect(dc_cancel.at(triggerLevelSink.second), 0, keep_one, 0);
-		iio->disconnect(keep_one, 0, triggerLevelSink.first, 0);
-		trigger_settings.updateHwVoltLevels(triggerLevelSink.second);
-		if (started) {
-			iio->unlock();
-		}
+	trigger_settings.setAcCoupled(false, ac_trigger_channel);
+	if (ac_trigger_channel >= 0) {
+		trigger_settings.updateHwVoltLevels(ac_trigger_channel);
 	}
-	triggerLevelSink.first = nullptr;
-	triggerLevelSink.second = -1;
-	keep_one = nullptr;
+	ac_trigger_channel = -1;
 }
 
 void Oscilloscope::configureAcCoupling(int i, bool coupled)
@@ -1602,8 +1526,8 @@ void Oscilloscope::configureAcCoupling(int i, bool coupled)
 	} else if (!coupled && tmp) {
 		deactivateAcCoupling(i);
 	} else if (coupled && tmp) {
-		deactivateAcCoupling(i);
-		activateAcCoupling(i);
+		// Only the size of the buffers may have changed
+		updateAcOutputMultiple();
 	}
 	scaleHistogramPlot();
 }
@@ -1760,6 +1684,12 @@ void Oscilloscope::btnExport_clicked(){
 	QStringList filter;
 	filter += QString(tr("Comma-separated values files (*.csv)"));
 	filter += QString(tr("Tab-delimited values files (*.txt)"));
+	filter += QString(tr("NumPy array files (*.npy)"));
+	filter += QString(tr("Raw ADC sample files (*.bin)"));
+	filter += QString(tr("Compressed capture archives (*.scarc)"));
+#ifdef MATLAB_SUPPORT_SIGGEN
+	filter += QString(tr("MATLAB files (*.mat)"));
+#endif
 	filter += QString(tr("All Files(*)"));
 
 	QString selectedFilter = filter[0];
@@ -1784,32 +1714,47 @@ void Oscilloscope::btnExport_clicked(){
 	}
 
 	if (!fileName.isEmpty()){
-		FileManager fm("Oscilloscope");
-		fm.open(fileName, FileManager::EXPORT);
+		std::shared_ptr<FileManager> fm =
+			std::make_shared<FileManager>("Oscilloscope");
+		fm->open(fileName, FileManager::EXPORT);
 
 		int channels_number = nb_channels + nb_math_channels;
-		QVector<double> time_data;
 
-		for (int i = 0; i < plot.Curve(0)->data()->size(); ++i) {
-			time_data.push_back(plot.Curve(0)->sample(i).x());
-		}
-
-		fm.save(time_data, "Time(S)");
+		boost::shared_ptr<adc_sample_conv> conv =
+			dynamic_pointer_cast<adc_sample_conv>(adc_samp_conv_block);
+		int column = 0;
+		/* Copied before the acquisition resumes, the file is
+		 * written in the background */
+		fm->save(FileManager::seriesSnapshot(plot.Curve(0)->data(), false),
+			"Time(S)");
 
 		for (int i = 0; i < channels_number; ++i){
 			if (exportConfig[i]){
-				QVector<double> data;
-				int samples = plot.Curve(i)->data()->size();
-				for (int j = 0; j < samples; ++j)
-					data.push_back(plot.Curve(i)->data()->sample(j).y());
+				QwtPlotCurve *curve = plot.Curve(i);
 				QString chNo = (i > 1) ? QString::number(i - 1) : QString::number(i + 1);
 
-				fm.save(data, ((i > 1) ? "M" : "CH") + chNo + "(V)");
+				fm->save(FileManager::seriesSnapshot(curve->data(), true),
+					((i > 1) ? "M" : "CH") + chNo + "(V)");
+				column++;
+
+				/* Only the ADC channels go back to codes in the
+				 * raw export, the math ones have no calibration */
+				if (conv && i < nb_channels) {
+					fm->setCalibration(column,
+						adc_sample_conv::sampleToVoltsScale(
+							conv->correctionGain(i),
+							conv->filterCompensation(i),
+							conv->hardwareGain(i)),
+						conv->offset(i));
+				}
 			}
 		}
 
-		fm.setSampleRate(active_sample_rate);
-		fm.performWrite();
+		fm->setSampleRate(active_sample_rate);
+		fm->setMetadata("trigger_position", timePosition->value());
+		fm->setMetadata("time_base", timeBase->value());
+
+		ExportService::instance()->start(this, fileName, fm);
 	}
 	pause(false);
 }
@@ -1826,6 +1771,9 @@ void Oscilloscope::create_add_channel_panel()
 
 	Math *math = new Math(nullptr, nb_channels);
 
+	// The channels are computed by MathExpression only
+	math->setFlowgraphFallback(false);
+
 	math_pair = new QPair<Ui::MathPanel, Math *>(math_ui, math);
 
 	connect(math, &Math::functionValid,
@@ -1966,15 +1914,27 @@ void Oscilloscope::import()
 {
 	QString fileName = QFileDialog::getOpenFileName(this,
 	    tr("Import"), "", tr("Comma-separated values files (*.csv);;"
-				       "Tab-delimited values files (*.txt)"),
+				       "Tab-delimited values files (*.txt);;"
+				       "NumPy array files (*.npy);;"
+				       "Compressed capture archives (*.scarc)"
+#ifdef MATLAB_SUPPORT_SIGGEN
+				       ";;MATLAB files (*.mat)"
+#endif
+				       ),
 	    nullptr, (m_useNativeDialogs ? QFileDialog::Options() : QFileDialog::DontUseNativeDialog));
 
 	FileManager fm("Oscilloscope");
 
 	importSettings->clear();
 	import_data.clear();
+	import_ref.reset();
 
 	try {
+		if (MappedReference::isMappedReference(fileName)) {
+			importMappedReference(fileName);
+			return;
+		}
+
 		fm.open(fileName, FileManager::IMPORT);
 
 		double nrOfSamples = fm.getNrOfSamples();
@@ -2043,48 +2003,32 @@ void Oscilloscope::add_math_channel(const std::string& function)
 		return;
 	}
 
-	auto rail = gr::analog::rail_ff::make(MIN_MATH_RANGE, MAX_MATH_RANGE);
-	auto math = scopy::iio_math::make(function, nb_channels);
 	unsigned int curve_id = nb_channels + nb_math_channels + nb_ref_channels;
 	unsigned int curve_number = find_curve_number();
 
-	nb_math_channels++;
-	probe_attenuation.push_back(1);
-
-	QString qname = QString("Math %1").arg(math_chn_counter++);
+	QString qname = QString("Math %1").arg(math_chn_counter);
 	std::string name = qname.toStdString();
 
-	auto math_sink = adiscope::scope_sink_f::make(
-			noZoomXAxisWidth * m2k_adc->sampleRate() / m2k_adc->oversamplingRatio(),
-			m2k_adc->sampleRate() / m2k_adc->oversamplingRatio(), name, 1, (QObject *)&plot);
-
-	/* Add the math block and the math scope sink into a container, so that
-	 * we can disconnect them when removing the math channel later */
-	auto math_pair = QPair<gr::basic_block_sptr, gr::basic_block_sptr>(
-				math, math_sink);
-	math_sinks.insert(qname, math_pair);
-	math_rails.insert(qname, rail);
-
-	/* Lock the flowgraph if we are already started */
-	bool started = isIioManagerStarted();
-	if (started)
-		iio->lock();
-
-	math_sink->set_trigger_mode(TRIG_MODE_TAG, 0, "buffer_start");
-
-	for (unsigned int i = 0; i < nb_channels; i++) {
-		iio->connect(math_probe_atten.at(i), 0, math, i);
-	}
-	iio->connect(math, 0, rail, 0);
-	iio->connect(rail, 0, math_sink, 0);
-
-	if (started)
-		iio->unlock();
-
 	plot.registerMathWaveform(name, 1,
 			noZoomXAxisWidth *
 			adc->sampleRate());
 
+	/* The function is compiled once, then evaluated on every frame of
+	 * the time sink; nothing is added to the flowgraph */
+	try {
+		math_frames->addChannel(name, function, nb_channels);
+	} catch (std::invalid_argument &e) {
+		qDebug(CAT_OSCILLOSCOPE) << "Invalid math function:"
+					 << e.what();
+		plot.unregisterMathWaveform(name);
+		showMathError(function, e.what());
+		return;
+	}
+
+	math_chn_counter++;
+	nb_math_channels++;
+	probe_attenuation.push_back(1);
+
 	ChannelWidget *channel_widget = new ChannelWidget(curve_id, true, false,
 		plot.getLineColor(curve_id).name(), this);
 
@@ -2208,20 +2152,13 @@ void Oscilloscope::onChannelWidgetDeleteClicked()
 	measure_settings->onChannelRemoved(curve_id);
 
 	if (cw->isMathChannel()) {
+		/* No more frames of it for the plot or the XY view */
+		math_frames->removeChannel(qname.toStdString());
 		plot.unregisterMathWaveform(qname.toStdString());
 
 		exportSettings->removeChannel(curve_id - nb_ref_channels);
 		exportConfig.remove(curve_id - nb_ref_channels);
 
-		/* Lock the flowgraph if we are already started */
-		bool started = isIioManagerStarted();
-
-		if (started) {
-			iio->lock();
-		}
-
-		locked = true;
-
 		gsettings_ui->cmb_x_channel->blockSignals(true);
 		gsettings_ui->cmb_y_channel->blockSignals(true);
 		gsettings_ui->cmb_x_channel->removeItem(curve_id);
@@ -2239,27 +2176,6 @@ void Oscilloscope::onChannelWidgetDeleteClicked()
 		gsettings_ui->cmb_y_channel->blockSignals(false);
 		setup_xy_channels();
 
-		/* Disconnect the blocks from the running flowgraph */
-		auto pair = math_sinks.take(qname);
-		auto rail = math_rails.take(qname);
-
-		for (unsigned int i = 0; i < nb_channels; i++) {
-			iio->disconnect(math_probe_atten.at(i), 0, pair.first, i);
-		}
-
-		iio->disconnect(pair.first, 0, rail, 0);
-		iio->disconnect(rail, 0, pair.second, 0);
-
-		if (xy_is_visible) {
-			setup_xy_channels();
-		}
-
-		locked = false;
-
-		if (started) {
-			iio->unlock();
-		}
-
 		for (unsigned int i = curve_id + 1;
 		     i < nb_channels + nb_math_channels + nb_ref_channels; i++) {
 			ChannelWidget *w = static_cast<ChannelWidget *>(
@@ -2388,10 +2304,6 @@ void Oscilloscope::on_actionClose_triggered()
 void Oscilloscope::toggle_blockchain_flow(bool en)
 {
 	if (en) {
-		if (autosetRequested) {
-			iio->start(autoset_id[0]);
-		}
-
 		for (unsigned int i = 0; i < nb_channels; i++)
 			iio->start(ids[i]);
 
@@ -2400,10 +2312,6 @@ void Oscilloscope::toggle_blockchain_flow(bool en)
 	} else {
 		for (unsigned int i = 0; i < nb_channels; i++)
 			iio->stop(ids[i]);
-
-		if (autosetRequested) {
-			iio->stop(autoset_id[0]);			
-		}
 	}
 }
 
@@ -2428,6 +2336,20 @@ void Oscilloscope::runStopToggled(bool checked)
 
 		writeAllSettingsToHardware();
 
+		qt_time_block->reset_frame_counters();
+		frames_displayed = 0;
+		capture_latency->clear();
+
+		// Running again after a failure starts a new test
+		if (mask_test->halted()) {
+			mask_test->resetCounters();
+		}
+
+		// Re-arm the segmented capture
+		if (nb_segments) {
+			qt_time_block->set_segments(nb_segments);
+		}
+
 		plot.setSampleRate(active_sample_rate, 1, "");
 		plot.setBufferSizeLabelValue(active_plot_sample_count);
 		plot.setSampleRatelabelValue(active_sample_rate);
@@ -2495,88 +2417,28 @@ void Oscilloscope::setChannelWidgetIndex(int chnIdx)
 	}
 }
 
-void Oscilloscope::autosetFFT()
-{
-	auto fft = gnuradio::get_initial_sptr(
-				new fft_block(false, autoset_fft_size));
-
-	auto ctm = blocks::complex_to_mag_squared::make(1);
-	auto log = blocks::nlog10_ff::make(10);
-	if(autoset_id[0]) {
-		iio->disconnect(autoset_id[0]);
-		autoset_id[0] = nullptr;
-	}
-	boost::shared_ptr<adc_sample_conv> block =
-	dynamic_pointer_cast<adc_sample_conv>(adc_samp_conv_block);
-	autosetFFTSink = blocks::vector_sink_f::make();
-	autosetDataSink = blocks::vector_sink_f::make();
-	autoset_id[0] = iio->connect(fft,autosetChannel,0,true);
-	iio->connect(fft,0,ctm,0);
-	iio->connect(ctm,0,log,0);
-	iio->connect(log,0,autosetFFTSink,0);
-}
-
 void Oscilloscope::onFFT_view_toggled(bool visible)
 {
-	/* Lock the flowgraph if we are already started */
-	bool started = isIioManagerStarted();
-	if (started)
-		iio->lock();
-
+	/* Computed on the frames of the time sink, the flowgraph stays
+	 * as it is */
 	if (visible) {
-		qt_fft_block->set_nsamps(fft_plot_size);
-
-		if (fft_is_visible && (fft_channels.size() > 0)) {
-			for (unsigned int i = 0; i < nb_channels; i++) {
-				/** GNU Radio flow: iio(i) ->  fft -> ctm -> qt_fft_block */
-				iio->disconnect(fft_channels.at(i).first, fft_channels.at(i).second,
-						fft_blocks.at(i), 0);
-				iio->disconnect(fft_blocks.at(i), 0, ctm_blocks.at(i), 0);
-				iio->disconnect(ctm_blocks.at(i), 0, qt_fft_block, i);
-			}
-		}
+		fft_frames->setFftSize(fft_plot_size);
 		setFFT_params();
 
-		for (unsigned int i = 0; i < nb_channels; i++) {
-			fft_blocks.push_back(gnuradio::get_initial_sptr(
-						     new fft_block(false, fft_plot_size)));
-			ctm_blocks.push_back(blocks::complex_to_mag_squared::make(1));
-
-			if (chnAcCoupled.at(i)) {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							       dc_cancel.at(i), 0));
-			} else {
-				fft_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							       adc_samp_conv_block, i));
-			}
-
-			iio->connect(fft_channels.at(i).first, fft_channels.at(i).second,
-					fft_blocks.at(i), 0);
-			iio->connect(fft_blocks.at(i), 0, ctm_blocks.at(i), 0);
-			iio->connect(ctm_blocks.at(i), 0, qt_fft_block, i);
+		if (!fft_is_visible) {
+			qt_time_block->add_frame_listener(fft_frames.get());
 		}
 
 		ui->container_fft_plot->show();
 	} else {
 		ui->container_fft_plot->hide();
 
-		if (fft_is_visible && (fft_channels.size() > 0)) {
-			for (unsigned int i = 0; i < nb_channels; i++) {
-				iio->disconnect(fft_channels.at(i).first, fft_channels.at(i).second,
-						fft_blocks.at(i), 0);
-				iio->disconnect(fft_blocks.at(i), 0, ctm_blocks.at(i), 0);
-				iio->disconnect(ctm_blocks.at(i), 0, qt_fft_block, i);
-			}
-			fft_channels.clear();
-			fft_blocks.clear();
-			ctm_blocks.clear();
+		if (fft_is_visible) {
+			qt_time_block->remove_frame_listener(fft_frames.get());
 		}
 	}
 
 	fft_is_visible = visible;
-
-	if (started)
-		iio->unlock();
 }
 
 void Oscilloscope::onHistogram_view_toggled(bool visible)
@@ -2618,18 +2480,10 @@ void Oscilloscope::onXY_view_toggled(bool visible)
 		gsettings_ui->xySettings->hide();
 	}
 
-	/* Lock the flowgraph if we are already started */
-	bool started = isIioManagerStarted();
-	if (started && !locked)
-		iio->lock();
-
 	if (visible) {
 		if(xy_is_visible && index_x == gsettings_ui->cmb_x_channel->currentIndex()
 				&& index_y == gsettings_ui->cmb_y_channel->currentIndex())
 		{
-			xy_is_visible = visible;
-			if (started && !locked)
-				iio->unlock();
 			return;
 		}
 
@@ -2643,66 +2497,22 @@ void Oscilloscope::onXY_view_toggled(bool visible)
 				m2k_adc->chnCorrectionGain(1));
 		}
 
-		if(!ftc)
-			ftc = blocks::float_to_complex::make(1);
-
-		if(xy_channels.size() > 0) {
-			iio->disconnect(xy_channels.at(index_x).first,
-					xy_channels.at(index_x).second,
-					ftc, 0);
-			iio->disconnect(xy_channels.at(index_y).first,
-					xy_channels.at(index_y).second,
-					ftc, 1);
-			xy_channels.clear();
-		}
-
 		index_x = gsettings_ui->cmb_x_channel->currentIndex();
 		index_y = gsettings_ui->cmb_y_channel->currentIndex();
 
-		if(xy_channels.size() == 0) {
-			for(unsigned int i = 0; i < nb_channels; i++) {
-				if (chnAcCoupled.at(i)) {
-					xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-								      dc_cancel.at(i), 0));
-				} else {
-					xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-								      adc_samp_conv_block, i));
-				}
-			}
-			for(auto p : math_sinks) {
-				auto math = p.first;
-				xy_channels.push_back(QPair<gr::basic_block_sptr, int>(
-							      math, 0));
-			}
-		}
-
-		iio->connect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-			     ftc, 0);
-		iio->connect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-			     ftc, 1);
-
-		if(!xy_is_visible)
-			iio->connect(ftc, 0, this->qt_xy_block, 0);
+		// The frames of the math channels carry the physical channels
+		// first and the math channels after them, in the order of the
+		// channel selectors
+		qt_xy_block->set_frame_channels(index_x, index_y);
+		math_frames->add_frame_listener(qt_xy_block.get());
 
 		ui->xy_plot_container->show();
 	} else {
 		ui->xy_plot_container->hide();
-		// Disconnect the XY section from the running flowgraph
-
-		iio->disconnect(xy_channels.at(index_x).first, xy_channels.at(index_x).second,
-				ftc, 0);
-		iio->disconnect(xy_channels.at(index_y).first, xy_channels.at(index_y).second,
-				ftc, 1);
-
-		iio->disconnect(ftc, 0, this->qt_xy_block, 0);
-
-		xy_channels.clear();
+		math_frames->remove_frame_listener(qt_xy_block.get());
 	}
 
 	xy_is_visible = visible;
-
-	if (started && !locked)
-		iio->unlock();
 }
 
 void adiscope::Oscilloscope::on_boxCursors_toggled(bool on)
@@ -3027,6 +2837,29 @@ void Oscilloscope::onCmbMemoryDepthChanged(QString value)
 		return;
 	}
 
+	/* A depth past the memory budget gives way to the deepest one
+	 * that fits, the signal comes back with it */
+	const size_t sample_bytes = (nb_channels + nb_math_channels) *
+		sizeof(float);
+	const size_t current = (size_t)active_plot_sample_count * sample_bytes;
+	const size_t wanted = (size_t)bufferSize * sample_bytes;
+	MemoryBudget *budget = MemoryBudget::instance();
+
+	if (wanted > current && !budget->reserve(wanted - current)) {
+		const size_t fits = budget->available() + current;
+		int index = ch_ui->cmbMemoryDepth->currentIndex();
+
+		while (index > 0 && ch_ui->cmbMemoryDepth->itemText(index)
+				.toULong() * sample_bytes > fits) {
+			index--;
+		}
+
+		CAT_DEBUG(CAT_OSCILLOSCOPE) << "Memory depth" << bufferSize
+			<< "past the memory budget";
+		ch_ui->cmbMemoryDepth->setCurrentIndex(index);
+		return;
+	}
+
 	started = isIioManagerStarted();
 	if (started) {
 		toggle_blockchain_flow(false);
@@ -3075,12 +2908,9 @@ void Oscilloscope::onCmbMemoryDepthChanged(QString value)
 
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		iio->set_buffer_size(ids[i], active_sample_count);
-		dc_cancel.at(i)->set_buffer_size(active_sample_count);
 	}
 
-	for(int ch = 0; ch < nb_channels; ch++) {
-		configureAcCoupling(ch, chnAcCoupled.at(ch));
-	}
+	updateAcOutputMultiple();
 
 	// Compute the appropriate value for fft_size
 	double power;
@@ -3105,37 +2935,484 @@ void Oscilloscope::setSinksDisplayOneBuffer(bool val)
 {
 	d_displayOneBuffer = val;
 	qt_time_block->set_displayOneBuffer(val);
+}
+
+void Oscilloscope::setSegments(unsigned int segments)
+{
+	nb_segments = std::min(segments, (unsigned int)MAX_SEGMENTS);
+	qt_time_block->set_segments(nb_segments);
+}
+
+void Oscilloscope::showSegment(unsigned int index)
+{
+	// Only while stopped, the live data would overwrite it right away
+	if (isIioManagerStarted()) {
+		return;
+	}
 
-	auto it = math_sinks.constBegin();
-	while (it != math_sinks.constEnd()) {
-		scope_sink_f::sptr math_sink = dynamic_pointer_cast<
-				scope_sink_f>(it.value().second);
-		math_sink->set_displayOneBuffer(val);
-		++it;
+	if (index < qt_time_block->segments_captured()) {
+		current_segment = index;
+		qt_time_block->show_segment(index);
 	}
-	qt_fft_block->set_displayOneBuffer(val);
 }
 
-void adiscope::Oscilloscope::onHorizScaleValueChanged(double value)
+void Oscilloscope::setPersistence(bool enabled)
 {
-	cancelZoom();
-	symmBufferMode->setTimeBase(value);
-	SymmetricBufferMode::capture_parameters params = symmBufferMode->captureParameters();
-	active_sample_rate = params.sampleRate;
-	active_sample_count = params.entireBufferSize;
-	active_plot_sample_count = active_sample_count;
-	active_trig_sample_count = -(long long)params.triggerBufferSize;
-	active_time_pos = -params.timePos;
-	memory_adjusted_time_pos = -params.timePos;
+	if (persistence_enabled == enabled) {
+		return;
+	}
 
-	ch_ui->cmbMemoryDepth->blockSignals(true);
-	ch_ui->cmbMemoryDepth->clear();
-	for (auto item : params.availableBufferSizes) {
-		ch_ui->cmbMemoryDepth->addItem(QString::number(item));
+	persistence_enabled = enabled;
+	persistence_maps.clear();
+
+	if (enabled) {
+		for (unsigned int i = 0; i < nb_channels; i++) {
+			auto map = std::make_shared<PersistenceMap>();
+			QwtInterval range = plot.axisInterval(
+					QwtAxisId(QwtPlot::yLeft, i));
+
+			map->setRange(range.minValue(), range.maxValue());
+			persistence_maps.push_back(map);
+		}
 	}
-	ch_ui->cmbMemoryDepth->blockSignals(false);
 
-	// Realign plot data based on the new sample count and trigger position
+	qt_time_block->set_persistence(persistence_maps);
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		plot.setPersistence(i, enabled ? persistence_maps[i] : nullptr);
+	}
+}
+
+void Oscilloscope::setAcquisitionMode(WaveformAverager::Mode mode,
+		unsigned int count, bool hw_high_res)
+{
+	acquisition_mode = mode;
+	acquisition_count = std::max(count, 1u);
+	this->hw_high_res = hw_high_res && m2k_adc;
+
+	bool hw = (mode == WaveformAverager::HIGH_RES && this->hw_high_res);
+	qt_time_block->set_acquisition_mode(hw ? WaveformAverager::NORMAL :
+			mode, acquisition_count);
+
+	applyAdcFiltering();
+}
+
+void Oscilloscope::applyAdcFiltering()
+{
+	if (!m2k_adc) {
+		return;
+	}
+
+	bool hw = (acquisition_mode == WaveformAverager::HIGH_RES &&
+			hw_high_res);
+	m2k_adc->setFilteringEnabled(!hw &&
+			prefPanel->getOsc_filtering_enabled());
+}
+
+void Oscilloscope::setMaskTestEnabled(bool enabled)
+{
+	if (enabled && !mask_test->hasMask() && !mask_test->learning()) {
+		learnMask(MASK_MARGIN_DIVS, active_sample_count / 1000);
+	}
+
+	mask_test->setEnabled(enabled);
+
+	if (enabled) {
+		mask_test_timer->start();
+	} else {
+		mask_test_timer->stop();
+	}
+
+	QSignalBlocker blocker(gsettings_ui->maskTest);
+	gsettings_ui->maskTest->setChecked(enabled);
+	updateMaskTestResult();
+}
+
+void Oscilloscope::learnMask(double margin_divs, unsigned int margin_samples)
+{
+	std::vector<float> dy;
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		ChannelWidget *cw = channelWidgetAtId(i);
+
+		dy.push_back(cw->enableButton()->isChecked() ?
+				margin_divs * plot.VertUnitsPerDiv(i) : -1.0f);
+	}
+
+	mask_test->learn(margin_samples, dy);
+	mask_test->resetCounters();
+}
+
+void Oscilloscope::updateMaskTestResult()
+{
+	if (!mask_test->isEnabled()) {
+		gsettings_ui->maskTestResult->clear();
+		return;
+	}
+
+	QString text = tr("Passed: %1  Failed: %2")
+			.arg(mask_test->passed())
+			.arg(mask_test->failed());
+
+	if (mask_test->skipped()) {
+		text += tr("  Skipped: %1").arg(mask_test->skipped());
+	}
+
+	if (mask_test->halted()) {
+		text += "\n" + tr("Stopped at CH %1, sample %2")
+				.arg(mask_test->lastFailureChannel() + 1)
+				.arg(mask_test->lastFailureSample());
+	}
+
+	gsettings_ui->maskTestResult->setText(text);
+}
+
+void Oscilloscope::maskTestFailed()
+{
+	ui->runSingleWidget->toggle(false);
+	updateMaskTestResult();
+}
+
+void Oscilloscope::updateMapRanges(
+		const std::vector<std::shared_ptr<PersistenceMap>> &maps)
+{
+	for (unsigned int i = 0; i < maps.size(); i++) {
+		QwtInterval range = plot.axisInterval(
+				QwtAxisId(QwtPlot::yLeft, i));
+
+		if (range.minValue() != maps[i]->rangeMin() ||
+				range.maxValue() != maps[i]->rangeMax()) {
+			maps[i]->setRange(range.minValue(), range.maxValue());
+		}
+	}
+}
+
+void Oscilloscope::setEyeDiagram(bool enabled)
+{
+	if (!eye_maps.empty() == enabled) {
+		return;
+	}
+
+	eye_maps.clear();
+
+	if (enabled) {
+		for (unsigned int i = 0; i < nb_channels; i++) {
+			eye_maps.push_back(std::make_shared<PersistenceMap>());
+		}
+		updateMapRanges(eye_maps);
+
+		eye_diagram->setSampleRate(active_sample_rate);
+		eye_diagram->setMaps(eye_maps);
+		qt_time_block->add_frame_listener(eye_diagram.get());
+	} else {
+		qt_time_block->remove_frame_listener(eye_diagram.get());
+		eye_diagram->setMaps(eye_maps);
+	}
+}
+
+void Oscilloscope::setXyDensity(bool enabled, bool accumulate)
+{
+	if (!xy_density_maps.empty() == enabled &&
+			xy_density_accumulate == accumulate) {
+		return;
+	}
+
+	xy_density_accumulate = accumulate;
+	xy_density_maps.clear();
+
+	if (enabled) {
+		for (unsigned int i = 0; i < nb_channels / 2; i++) {
+			xy_density_maps.push_back(
+					std::make_shared<PersistenceMap>(512, 512));
+		}
+		updateXyDensityRanges();
+	}
+
+	qt_xy_block->set_density(xy_density_maps, accumulate);
+
+	for (unsigned int i = 0; i < nb_channels / 2; i++) {
+		xy_plot.setDensity(i, enabled ? xy_density_maps[i] : nullptr);
+	}
+}
+
+void Oscilloscope::clearXyDensity()
+{
+	for (auto &map : xy_density_maps) {
+		map->clear();
+	}
+
+	xy_plot.replot();
+}
+
+void Oscilloscope::updateXyDensityRanges()
+{
+	int x = gsettings_ui->cmb_x_channel->currentIndex();
+	int y = gsettings_ui->cmb_y_channel->currentIndex();
+	auto xInterval = plot.axisInterval(QwtAxisId(QwtPlot::yLeft, x));
+	auto yInterval = plot.axisInterval(QwtAxisId(QwtPlot::yLeft, y));
+
+	for (auto &map : xy_density_maps) {
+		if (xInterval.minValue() != map->columnRangeMin() ||
+				xInterval.maxValue() != map->columnRangeMax()) {
+			map->setColumnRange(xInterval.minValue(),
+					xInterval.maxValue());
+		}
+		if (yInterval.minValue() != map->rangeMin() ||
+				yInterval.maxValue() != map->rangeMax()) {
+			map->setRange(yInterval.minValue(),
+					yInterval.maxValue());
+		}
+	}
+}
+
+bool Oscilloscope::equivalentTime(unsigned int factor, bool add_references)
+{
+	unsigned int segments = qt_time_block->segments_captured();
+	int nitems = qt_time_block->nsamps();
+	int trigger_index = (int)-active_trig_sample_count;
+
+	if (isIioManagerStarted() || !segments || !factor ||
+			trigger_index < 0 || trigger_index >= nitems) {
+		return false;
+	}
+
+	equivalent_time.configure(nb_channels, nitems, factor, trigger_index,
+			trigger_settings.currentChannel());
+	qt_time_block->replay_segments(&equivalent_time);
+
+	if (!equivalent_time.captures() || !add_references) {
+		return equivalent_time.captures() > 0;
+	}
+
+	// On the time axis of the frames, factor times denser
+	auto data = plot.Curve(0)->data();
+	double x0 = data->size() ? data->sample(0).x() : 0.0;
+	double step = 1.0 / (active_sample_rate * factor);
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		if (nb_math_channels + nb_ref_channels == MAX_MATH_CHANNELS) {
+			break;
+		}
+
+		std::vector<float> record;
+		equivalent_time.record(i, record);
+
+		QVector<double> xData(record.size());
+		QVector<double> yData(record.size());
+		for (size_t j = 0; j < record.size(); j++) {
+			xData[j] = x0 + j * step;
+			yData[j] = record[j];
+		}
+
+		add_ref_waveform(QString("ET CH%1").arg(i + 1), xData, yData,
+				active_sample_rate * factor);
+	}
+
+	return true;
+}
+
+void Oscilloscope::analyzeJitter(unsigned int chn, bool accumulate)
+{
+	if (chn >= nb_channels) {
+		return;
+	}
+
+	auto data = dynamic_cast<UniformSampledData *>(
+			plot.Curve(chn)->data());
+	if (!data || !data->size()) {
+		return;
+	}
+
+	std::vector<float> samples(data->yData(),
+			data->yData() + data->size());
+	float level, hysteresis;
+	EdgeDetector::levelOf(samples.data(), samples.size(),
+			JITTER_HYSTERESIS_RATIO, level, hysteresis);
+
+	if (!accumulate || (int)chn != jitter_channel) {
+		jitter_result->clear();
+	}
+
+	JitterAnalysis::analyze(JitterAnalysis::edges(samples.data(),
+				samples.size(), level, hysteresis),
+			plot.sampleRate(), *jitter_result);
+
+	QLayout *layout = jitter_statistics->layout();
+
+	if ((int)chn != jitter_channel) {
+		jitter_channel = chn;
+
+		for (auto widget : jitter_statistics->findChildren<
+				StatisticWidget *>()) {
+			delete widget;
+		}
+
+		const QStringList names = { tr("Period jitter"),
+			tr("Cycle-to-cycle"), tr("TIE") };
+		for (const QString &name : names) {
+			StatisticWidget *statistic =
+				new StatisticWidget(jitter_statistics);
+
+			statistic->initForMeasurement(MeasurementData(name,
+					MeasurementData::HORIZONTAL, "s", chn));
+			statistic->setTitleColor(plot.getLineColor(chn));
+			layout->addWidget(statistic);
+		}
+	}
+
+	auto widgets = jitter_statistics->findChildren<StatisticWidget *>();
+	const Statistic *values[] = { &jitter_result->period,
+		&jitter_result->cycle_to_cycle, &jitter_result->tie };
+
+	for (int i = 0; i < widgets.size() && i < 3; i++) {
+		widgets[i]->updateStatistics(*values[i]);
+	}
+}
+
+void Oscilloscope::setMixedSignal(bool enabled)
+{
+	if (isMixedSignal() == enabled) {
+		return;
+	}
+
+	if (enabled) {
+		mixed_signal_item = new MixedSignalPlotItem(captureStore);
+		mixed_signal_item->attach(&plot);
+
+		// The analog frames go to the store too, next to the logic
+		// capture they are shown with
+		capture_writer = std::make_shared<AnalogCaptureWriter>(
+				captureStore);
+		capture_writer->setTimebase(plot.sampleRate(),
+				plot.dataStartingPoint() / plot.sampleRate());
+		qt_time_block->add_frame_listener(capture_writer.get());
+
+		mixed_signal_conn = connect(captureStore,
+				&CaptureStore::logicChanged, this, [=]() {
+			plot.replot();
+		}, Qt::QueuedConnection);
+	} else {
+		disconnect(mixed_signal_conn);
+
+		qt_time_block->remove_frame_listener(capture_writer.get());
+		capture_writer.reset();
+
+		mixed_signal_item->detach();
+		delete mixed_signal_item;
+		mixed_signal_item = nullptr;
+	}
+
+	plot.replot();
+}
+
+bool Oscilloscope::isMixedSignal() const
+{
+	return mixed_signal_item != nullptr;
+}
+
+void Oscilloscope::setDisplayRate(double fps)
+{
+	// The sinks keep acquiring at full rate, they only post a frame to
+	// the plot once per period; the plot then draws the newest of the
+	// frames it has queued.
+	display_rate = std::max(fps, 1.0);
+
+	qt_time_block->set_update_time(1.0 / display_rate);
+	math_frames->setUpdateTime(1.0 / display_rate);
+	fft_frames->setUpdateTime(1.0 / display_rate);
+}
+
+void Oscilloscope::setStatisticsWindow(unsigned int size)
+{
+	statistics_window = std::max(size, 1u);
+
+	for (int i = 0; i < statistics_data.size(); i++)
+		statistics_data[i].second.setWindowSize(statistics_window);
+
+	jitter_result->period.setWindowSize(statistics_window);
+	jitter_result->cycle_to_cycle.setWindowSize(statistics_window);
+	jitter_result->tie.setWindowSize(statistics_window);
+
+	statisticsUpdateGui();
+}
+
+void Oscilloscope::updateSoftwareTrigger()
+{
+	SoftwareTrigger trigger;
+	int channel = trigger_settings.currentChannel();
+
+	if (trigger_settings.analogEnabled() && channel >= 0 &&
+			channel < nb_channels) {
+		HardwareTrigger::condition cond =
+			adc->getTrigger()->analogCondition(channel);
+
+		trigger.setType(software_trigger_type);
+		trigger.setSlope((cond == HardwareTrigger::FALLING_EDGE ||
+				  cond == HardwareTrigger::LOW) ?
+				 TRIG_SLOPE_NEG : TRIG_SLOPE_POS);
+		trigger.setLevel(trigger_settings.level());
+		trigger.setHysteresis(trigger_settings.hysteresis());
+		trigger.setRuntLevels(trigger_settings.level(),
+				      software_trigger_runt_high);
+		trigger.setPulseWidth(
+			qRound64(software_trigger_min_width * active_sample_rate),
+			qRound64(software_trigger_max_width * active_sample_rate));
+	}
+
+	// In single mode the sweep stops, as with the hardware trigger
+	qt_time_block->set_software_trigger(trigger, channel,
+			!ui->runSingleWidget->singleButtonChecked());
+}
+
+void Oscilloscope::updateCaptureLatencyToolTip()
+{
+	QString text = tr("Capture latency, last %1 captures")
+		.arg(capture_latency->captures());
+
+	for (int i = 0; i < CaptureLatency::INTERVAL_COUNT; i++) {
+		auto interval = static_cast<CaptureLatency::Interval>(i);
+		CaptureLatency::Summary summary =
+			capture_latency->summary(interval);
+
+		text += QString("\n%1: mean %2 ms, min %3 ms, max %4 ms")
+			.arg(CaptureLatency::intervalName(interval))
+			.arg(summary.mean * 1e3, 0, 'f', 3)
+			.arg(summary.min * 1e3, 0, 'f', 3)
+			.arg(summary.max * 1e3, 0, 'f', 3);
+	}
+
+	plot.setTriggerStateToolTip(text);
+}
+
+void Oscilloscope::clearPersistence()
+{
+	for (auto &map : persistence_maps) {
+		map->clear();
+	}
+
+	plot.replot();
+}
+
+void adiscope::Oscilloscope::onHorizScaleValueChanged(double value)
+{
+	cancelZoom();
+	symmBufferMode->setTimeBase(value);
+	SymmetricBufferMode::capture_parameters params = symmBufferMode->captureParameters();
+	active_sample_rate = params.sampleRate;
+	active_sample_count = params.entireBufferSize;
+	active_plot_sample_count = active_sample_count;
+	active_trig_sample_count = -(long long)params.triggerBufferSize;
+	active_time_pos = -params.timePos;
+	memory_adjusted_time_pos = -params.timePos;
+
+	ch_ui->cmbMemoryDepth->blockSignals(true);
+	ch_ui->cmbMemoryDepth->clear();
+	for (auto item : params.availableBufferSizes) {
+		ch_ui->cmbMemoryDepth->addItem(QString::number(item));
+	}
+	ch_ui->cmbMemoryDepth->blockSignals(false);
+
+	// Realign plot data based on the new sample count and trigger position
 	plot.setHorizUnitsPerDiv(value);
 	plot.replot();
 	plot.setDataStartingPoint(active_trig_sample_count);
@@ -3194,8 +3471,8 @@ void adiscope::Oscilloscope::onHorizScaleValueChanged(double value)
 
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		iio->set_buffer_size(ids[i], active_sample_count);
-		dc_cancel.at(i)->set_buffer_size(active_sample_count);
 	}
+	updateAcOutputMultiple(true);
 
 	/* timeout = how long a buffer capture takes + transmission latency. The
 	latter is a guessed value. If we could get a feedback from hardware that
@@ -3259,6 +3536,8 @@ void Oscilloscope::updateXyPlotScales()
 	auto yInterval = plot.axisInterval(QwtAxisId(QwtPlot::yLeft, y));
 	xy_plot.set_axis(xInterval.minValue(), xInterval.maxValue(),
 			 yInterval.minValue(), yInterval.maxValue());
+
+	updateXyDensityRanges();
 }
 
 void adiscope::Oscilloscope::onVertOffsetValueChanged(double value)
@@ -3346,13 +3625,6 @@ void adiscope::Oscilloscope::onTimePositionChanged(double value)
 		return;
 
 	/* Reconfigure the GNU Radio block to receive a different number of samples  */
-	auto chnCoupled = chnAcCoupled;
-	for(int ch = 0; ch < nb_channels; ch++) {
-		if (chnAcCoupled.at(ch)) {
-			configureAcCoupling(ch, !chnAcCoupled.at(ch));
-		}
-	}
-
 	if (started)
 		iio->lock();
 	setAllSinksSampleCount(active_plot_sample_count);
@@ -3374,19 +3646,13 @@ void adiscope::Oscilloscope::onTimePositionChanged(double value)
 
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		iio->set_buffer_size(ids[i], active_sample_count);
-		dc_cancel.at(i)->set_buffer_size(active_sample_count);
 	}
+	updateAcOutputMultiple(true);
 
 	if (started) {
 		iio->unlock();
 	}
 
-	for(int ch = 0; ch < nb_channels; ch++) {
-		if (chnCoupled.at(ch)) {
-			configureAcCoupling(ch, chnCoupled.at(ch));
-		}
-	}
-
 	// Compute the appropriate value for fft_size
 	double power;
 	if (symmBufferMode->isEnhancedMemDepth() || plot_samples_sequentially) {
@@ -3637,8 +3903,27 @@ void Oscilloscope::openEditMathPanel(bool on)
 void Oscilloscope::editMathChannelFunction(int id, const std::string& new_function)
 {
 	ChannelWidget *chn_widget = channelWidgetAtId(id);
-	int current_x = index_x;
-	int current_y = index_y;
+
+	if (chn_widget->function().toStdString() != new_function) {
+		QString qname = chn_widget->deleteButton()->property("curve_name").toString();
+		std::string name = qname.toStdString();
+
+		// Swapped between two frames, the channel keeps its place in
+		// the plot and in the XY view. A bad function stays in the
+		// panel, still being edited.
+		try {
+			math_frames->setFunction(name, new_function, nb_channels);
+		} catch (std::invalid_argument &e) {
+			qDebug(CAT_OSCILLOSCOPE) << "Invalid math function:"
+						 << e.what();
+			math_pair->second->showError(
+					QString::fromUtf8(e.what()));
+			return;
+		}
+
+		chn_widget->setFunction(QString::fromStdString(new_function));
+		setSinksDisplayOneBuffer(d_displayOneBuffer);
+	}
 
 	triggerRightMenuToggle(
 				static_cast<CustomPushButton* >(ui->btnAddMath), false);
@@ -3648,89 +3933,16 @@ void Oscilloscope::editMathChannelFunction(int id, const std::string& new_functi
 	math_pair->second->setFunction("");
 	addChannel = true;
 	ch_ui->btnEditMath->setChecked(false);
+}
 
-	if (chn_widget->function().toStdString() == new_function)
-		return;
-
-	QString qname = chn_widget->deleteButton()->property("curve_name").toString();
-	std::string name = qname.toStdString();
-
-	auto rail = gr::analog::rail_ff::make(MIN_MATH_RANGE, MAX_MATH_RANGE);
-	auto math = scopy::iio_math::make(new_function, nb_channels);
-
-	bool started = isIioManagerStarted();
-	if (started)
-		iio->lock();
-	locked = true;
-	if(xy_is_visible) {
-		gsettings_ui->cmb_x_channel->blockSignals(true);
-		gsettings_ui->cmb_y_channel->blockSignals(true);
-		if(index_x == id)
-			gsettings_ui->cmb_x_channel->setCurrentIndex(id-1);
-		if(index_y == id)
-			gsettings_ui->cmb_y_channel->setCurrentIndex(id-1);
-		gsettings_ui->cmb_x_channel->blockSignals(false);
-		gsettings_ui->cmb_y_channel->blockSignals(false);
-		setup_xy_channels();
-	}
-	auto pair = math_sinks.value(qname);
-	auto rail_old = math_rails.value(qname);
-	for (unsigned int i = 0; i < nb_channels; ++i) {
-		iio->disconnect(math_probe_atten.at(i), 0, pair.first, i);
-	}
-	iio->disconnect(pair.first, 0, rail_old, 0);
-	iio->disconnect(rail_old, 0, pair.second, 0);
-
-	auto math_pair = QPair<gr::basic_block_sptr, gr::basic_block_sptr>(
-				math, pair.second);
-
-	math_sinks.insert(qname, math_pair);
-	math_rails.insert(qname, rail);
-
-	for (unsigned int i = 0; i < nb_channels; ++i) {
-		iio->connect(math_probe_atten.at(i), 0, math, i);
-	}
-	iio->connect(math, 0, rail, 0);
-	iio->connect(rail, 0, pair.second, 0);
-
-	if(xy_is_visible) {
-		gsettings_ui->cmb_x_channel->blockSignals(true);
-		gsettings_ui->cmb_y_channel->blockSignals(true);
-		gsettings_ui->cmb_x_channel->setCurrentIndex(current_x);
-		gsettings_ui->cmb_y_channel->setCurrentIndex(current_y);
-		gsettings_ui->cmb_x_channel->blockSignals(false);
-		gsettings_ui->cmb_y_channel->blockSignals(false);
-		setup_xy_channels();
-	}
-	locked = false;
-	if (started)
-		iio->unlock();
-
-	// If the oscilloscope is not running, create a single run situation only for
-	// the channel that is edited .
-//	else {
-//		QList<QString> keys = math_sinks.keys();
-//		for (const QString &key : keys)
-//			if (key != qname) {
-//				pair = math_sinks.value(key);
-//				for (unsigned int i = 0; i < nb_channels; ++i)
-//					iio->disconnect(adc_samp_conv_block, i, pair.first, i);
-//				iio->disconnect(pair.first, 0, pair.second, 0);
-//			}
-
-//		ui->pushButtonSingle->setChecked(true);
-
-//		for (const QString &key : keys)
-//			if (key != qname) {
-//				pair = math_sinks.value(key);
-//				for (unsigned int i = 0; i < nb_channels; ++i)
-//					iio->connect(adc_samp_conv_block, i, pair.first, i);
-//				iio->connect(pair.first, 0, pair.second, 0);
-//			}
-//	}
-
-	chn_widget->setFunction(QString::fromStdString(new_function));
-	setSinksDisplayOneBuffer(d_displayOneBuffer);
+void Oscilloscope::showMathError(const std::string& function,
+		const char *error)
+{
+	// Back in the Math panel, where the function can be fixed
+	math_pair->second->setFunction(QString::fromStdString(function));
+	math_pair->second->showError(QString::fromUtf8(error));
+	triggerRightMenuToggle(
+			static_cast<CustomPushButton* >(ui->btnAddMath), true);
 }
 
 void Oscilloscope::onMeasuremetsAvailable()
@@ -4067,6 +4279,14 @@ void Oscilloscope::statistics_panel_init()
 	statistics_panel_ui->statistics->setMinimumHeight(dummyStat->height());
 	delete dummyStat;
 
+	// The jitter statistics go after the ones of the measurements, one
+	// level down so that they aren't taken for them
+	jitter_statistics = new QWidget(statistics_panel_ui->statistics);
+	QHBoxLayout *jitterLayout = new QHBoxLayout(jitter_statistics);
+	jitterLayout->setContentsMargins(0, 0, 0, 0);
+	jitterLayout->setSpacing(25);
+	hLayout->addWidget(jitter_statistics);
+
 	statisticsPanel->hide();
 }
 
@@ -4122,7 +4342,7 @@ void Oscilloscope::onStatisticActivated(int id, int chnIdx)
 		return;
 
 	statistics_data.push_back(QPair<std::shared_ptr<MeasurementData>,
-		Statistic>(pmd, Statistic()));
+		Statistic>(pmd, Statistic(statistics_window)));
 
 	/* Add a widget for the new statistic */
 	QWidget *statisticContainer = statistics_panel_ui->statistics;
@@ -4244,7 +4464,7 @@ void Oscilloscope::setupAutosetFreqSweep()
 		trigger_settings.autoTriggerDisable();
 		trigger_settings.setTriggerEnable(false);
 	}
-	autosetSampleRateCnt--;
+	autosetSampleRateCnt = autosetNextSampleRateIdx();
 	active_sample_rate = m2k_adc->availSamplRates()[autosetSampleRateCnt];
 	qt_time_block->set_samp_rate(active_sample_rate);
 	active_sample_count = autosetFFTSize;
@@ -4252,36 +4472,64 @@ void Oscilloscope::setupAutosetFreqSweep()
 	autoset_fft_size = active_sample_count;
 	writeAllSettingsToHardware();
 	last_set_sample_count = active_sample_count;
-	autosetFFT();
-	iio->set_buffer_size(autoset_id[0], autoset_fft_size);
 	for (unsigned int i = 0; i < nb_channels; i++) {
 		iio->set_buffer_size(ids[i], autoset_fft_size);
-		dc_cancel.at(i)->set_buffer_size(active_sample_count);
-	}
-	if (keep_one) {
-		iio->disconnect(dc_cancel.at(triggerLevelSink.second), 0, keep_one, 0);
-		iio->disconnect(keep_one, 0, triggerLevelSink.first, 0);
-		keep_one = gr::blocks::keep_one_in_n::make(sizeof(float), active_sample_count);
-		iio->connect(dc_cancel.at(triggerLevelSink.second), 0, keep_one, 0);
-		iio->connect(keep_one, 0, triggerLevelSink.first, 0);
 	}
+
+	updateAcOutputMultiple(true);
 	if(started)
 		iio->unlock();
 }
 
+int Oscilloscope::autosetNextSampleRateIdx() const
+{
+	const auto& rates = m2k_adc->availSamplRates();
+	int next = autosetSampleRateCnt - 1;
+
+	/* A tone seen at too low a resolution tells which rate puts it at
+	 * a valid index, the rates in between don't need a capture */
+	if (autosetFFTIndex >= autosetNrOfSkippedTones && next > 0) {
+		double freq = autosetFFTIndex * (active_sample_rate /
+						 autoset_fft_size);
+		double max_rate = freq * autosetFFTSize / autosetValidTone;
+
+		while (next > 0 && rates[next] > max_rate)
+			next--;
+	}
+
+	return next;
+}
+
 bool Oscilloscope::autosetFindFrequency()
 {
-	if(autosetFFTSink->data().size())
+	auto samples = plot.Curve(autosetChannel)->data();
+
+	if(samples->size() >= (size_t) autoset_fft_size)
 	{
 		toggle_blockchain_flow(false);
+
+		if (!autoset_spectrum || autoset_spectrum->fft_size() !=
+				(size_t) autoset_fft_size) {
+			autoset_spectrum = power_spectrum::get(autoset_fft_size);
+			autoset_samples.resize(autoset_fft_size);
+			autoset_power.resize(autoset_fft_size / 2 + 1);
+		}
+
+		for (int j = 0; j < autoset_fft_size; j++)
+			autoset_samples[j] = samples->sample(j).y();
+
+		autoset_spectrum->compute_half(autoset_samples.data(),
+				autoset_power.data());
+
 		double max=-INFINITY;
 		size_t maxindex=1;
 		// try skipping the DC offset tones and last few tones that cause
 		// weird results
 
 		for(int j=autosetNrOfSkippedTones ;j<((autoset_fft_size/2)-5);j++) {
-			if(autosetFFTSink->data()[j] > max) {
-			    max = autosetFFTSink->data()[j];
+			double power = 10 * log10(autoset_power[j]);
+			if(power > max) {
+			    max = power;
 			    maxindex=j;
 		    }
 		}
@@ -4291,6 +4539,7 @@ bool Oscilloscope::autosetFindFrequency()
 		if(autosetMaxIndexAmpl < max && (autosetFFTIndex > autosetValidTone)) {
 			autosetFrequency = frequency;
 			autosetMaxIndexAmpl = max;
+			autosetFound = true;
 			return true; // found valid frequency
 		}
 	}
@@ -4299,7 +4548,8 @@ bool Oscilloscope::autosetFindFrequency()
 
 void Oscilloscope::autosetFindPeaks()
 {
-	if(autosetFFTSink->data().size())
+	if(plot.Curve(autosetChannel)->data()->size() >=
+			(size_t) active_sample_count)
 	{
 		double maxVolts = -INFINITY;
 		double minVolts = INFINITY;
@@ -4327,6 +4577,7 @@ void Oscilloscope::requestAutoset()
 		autosetRequested = true;
 		autosetFFTIndex = 0;
 		autosetMaxIndexAmpl = 0;
+		autosetFound = false;
 		setupAutosetFreqSweep();
 		toggle_blockchain_flow(true);
 	}
@@ -4346,18 +4597,18 @@ void Oscilloscope::periodicFlowRestart(bool force)
 		t.start();
 		iio->lock();
 		iio->unlock();
-		qDebug(CAT_OSCILLOSCOPE)<<"Restarted flow @ " << QTime::currentTime().toString("hh:mm:ss") <<"restart took " << t.elapsed() << "ms";
+		CAT_DEBUG_EVERY(CAT_OSCILLOSCOPE, 1000) << "Restarted flow @ " << QTime::currentTime().toString("hh:mm:ss") <<"restart took " << t.elapsed() << "ms";
 	}
 	restartFlowCounter--;
 }
 
 void Oscilloscope::autosetNextStep()
 {
-	static int prevmaxindex=0;
 	// Only consider tone valid if it's index is higher than a preset value
-	// This ensures that a good enough resolution bandwidth is achieved
-	if(autosetSampleRateCnt > 1){
-		prevmaxindex = autosetFFTIndex;
+	// This ensures that a good enough resolution bandwidth is achieved.
+	// Going from the highest rate down, the first valid tone is the
+	// best resolved one that isn't aliased, so the sweep stops there.
+	if(!autosetFound && autosetSampleRateCnt > 1){
 		setupAutosetFreqSweep();
 		toggle_blockchain_flow(true);
 	}
@@ -4374,16 +4625,12 @@ void Oscilloscope::autosetFinalStep() {
 	double voltsperdiv = 1;
 	double triggerlevel = 0;
 
-	if(autoset_id[0]) {
-		iio->disconnect(autoset_id[0]);
-		autoset_id[0] = nullptr;
-	}
 	autosetRequested = false;
 	if(ui->runSingleWidget->runButtonChecked())
 		runStopToggled(true);
 
 	// autoset frequency found
-	if(autosetFFTIndex>1) {
+	if(autosetFound) {
 		timebaseval = (1/autosetFrequency)/2;
 		voltsperdiv = (max(abs(autosetMaxAmpl),
 				   abs(autosetMinAmpl)))/5;
@@ -4440,12 +4687,22 @@ void Oscilloscope::scaleHistogramPlot(bool newData)
 
 		hist_plot.setYaxisSpan(i, min, max);
 	}
-	hist_plot.setAutoScaleX();
+	if (hist_plot.getOrientation() == Qt::Horizontal)
+		qt_hist_block->autoscale_x();
 }
 
 void Oscilloscope::onFilledScreen(bool full, unsigned int nb_samples)
 {
 	if (nb_samples == active_plot_sample_count) {
+		// A re-arming software trigger starts the next sweep by
+		// itself, without restarting the hardware stream
+		if (full && plot_samples_sequentially &&
+				qt_time_block->software_trigger_enabled() &&
+				!ui->runSingleWidget->singleButtonChecked()) {
+			cleanBuffersAllSinks(false);
+			return;
+		}
+
 		d_shouldResetStreaming = full;
 		resetStreamingFlag(full);
 	}
@@ -4457,6 +4714,7 @@ void Oscilloscope::resetStreamingFlag(bool enable)
 	if (started)
 		iio->lock();
 
+	updateSoftwareTrigger();
 	adc->getTrigger()->setStreamingFlag(false);
 	cleanBuffersAllSinks();
 
@@ -4478,18 +4736,10 @@ void Oscilloscope::resetStreamingFlag(bool enable)
 	d_shouldResetStreaming = false;
 }
 
-void Oscilloscope::cleanBuffersAllSinks()
+void Oscilloscope::cleanBuffersAllSinks(bool timeSink)
 {
-	this->qt_time_block->clean_buffers();
-
-	auto it = math_sinks.constBegin();
-	while (it != math_sinks.constEnd()) {
-		scope_sink_f::sptr math_sink = dynamic_pointer_cast<
-				scope_sink_f>(it.value().second);
-		math_sink->clean_buffers();
-		++it;
-	}
-	qt_fft_block->clean_buffers();
+	if (timeSink)
+		this->qt_time_block->clean_buffers();
 }
 
 void Oscilloscope::onIioDataRefillTimeout()
@@ -4498,6 +4748,18 @@ void Oscilloscope::onIioDataRefillTimeout()
 		trigger_is_forced = true;
 }
 
+void Oscilloscope::onDisplayedChanged(bool displayed)
+{
+	// The frames of the time plot still come, as the single captures,
+	// the trigger status, the measurements and the API go by them; only
+	// drawing them waits. The FFT, XY and histogram views only draw.
+	plot.setDisplaySuspended(!displayed);
+
+	fft_frames->setDisplayed(displayed);
+	qt_xy_block->set_displayed(displayed);
+	qt_hist_block->set_displayed(displayed);
+}
+
 void Oscilloscope::onPlotNewData()
 {
 	// Flag the new received data as Triggered or Untriggered.
@@ -4519,6 +4781,28 @@ void Oscilloscope::onPlotNewData()
 
 	updateBufferPreviewer();
 
+	// An AC coupled trigger follows the DC offset of its channel
+	updateTriggerLevelValue();
+
+	frames_displayed++;
+
+	capture_latency->mark(CaptureLatency::PLOTTED);
+	if (frames_displayed % 10 == 1)
+		updateCaptureLatencyToolTip();
+
+	// The counts are binned for a vertical range, start over when it
+	// was moved or scaled
+	updateMapRanges(persistence_maps);
+	updateMapRanges(eye_maps);
+	if (!eye_maps.empty()) {
+		eye_diagram->setSampleRate(active_sample_rate);
+	}
+
+	if (capture_writer) {
+		capture_writer->setTimebase(plot.sampleRate(),
+				plot.dataStartingPoint() / plot.sampleRate());
+	}
+
 	trigger_input = true; //used to read trigger status from Js
 }
 
@@ -4685,15 +4969,6 @@ void Oscilloscope::setAllSinksSampleCount(unsigned long sample_count)
 	this->qt_time_block->set_nsamps(sample_count);
 	this->qt_xy_block->set_nsamps(sample_count);
 	this->qt_hist_block->set_nsamps(sample_count);
-
-	auto it = math_sinks.constBegin();
-	while (it != math_sinks.constEnd()) {
-		scope_sink_f::sptr math_sink = dynamic_pointer_cast<
-				scope_sink_f>(it.value().second);
-		math_sink->set_nsamps(sample_count);
-		++it;
-	}
-	this->qt_fft_block->set_nsamps(fft_plot_size);
 }
 
 void Oscilloscope::writeAllSettingsToHardware()
@@ -4802,3 +5077,157 @@ void Oscilloscope::channelLineWidthChanged(int id)
 		plot.replot();
 	}
 }
+
+void Oscilloscope::importMappedReference(const QString &fileName)
+{
+	import_ref = std::make_shared<MappedReference>(fileName);
+
+	double nrOfSamples = import_ref->rows();
+	double sampRate = import_ref->sampleRate();
+	int first = import_ref->hasXColumn() ? 1 : 0;
+
+	if (sampRate <= 0) {
+		refChannelTimeBase->setEnabled(true);
+	} else {
+		refChannelTimeBase->setEnabled(false);
+		refChannelTimeBase->setValue((nrOfSamples / 16.0) / sampRate);
+	}
+
+	import_error = fileName;
+	Q_EMIT importFileLoaded(true);
+
+	for (int i = first; i < import_ref->columns(); ++i) {
+		importSettings->addChannel(i - first,
+			import_ref->columnName(i).remove("(V)"));
+	}
+
+	/* The preview only needs the shape, a few thousand rows of the
+	 * whole file are enough */
+	if (refChannelTimeBase->isEnabled()) {
+		size_t stride = std::max<size_t>(1, import_ref->rows() / 4096);
+		QVector<QVector<double>> preview;
+
+		for (size_t i = 0; i < import_ref->rows(); i += stride) {
+			QVector<double> row;
+			for (int j = 0; j < import_ref->columns(); ++j) {
+				row.push_back(import_ref->value(i, j));
+			}
+			preview.push_back(row);
+		}
+
+		plot.addPreview(preview, refChannelTimeBase->value(),
+				this->timeBase->value(), timePosition->value());
+	}
+}
+
+bool Oscilloscope::startRecording(const QString &filename)
+{
+	if (isRecording()) {
+		stopRecording();
+	}
+
+	if (!recorder) {
+		recorder = gnuradio::get_initial_sptr(
+				new stream_recorder_sink(nb_channels));
+	}
+
+	if (!recorder->open(filename)) {
+		return false;
+	}
+
+	/* The recorder doesn't use the tags, the other clients keep
+	 * running while it is connected */
+	iio->lock_hot();
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		recorder_ids.push_back(iio->connect(recorder, i, i,
+				false, qt_time_block->nsamps()));
+	}
+	iio->unlock_hot();
+
+	for (auto &id : recorder_ids) {
+		iio->start(id);
+	}
+
+	recording_file = filename;
+
+	return true;
+}
+
+void Oscilloscope::stopRecording()
+{
+	if (recorder_ids.empty()) {
+		return;
+	}
+
+	for (auto &id : recorder_ids) {
+		iio->stop(id);
+	}
+
+	iio->lock_hot();
+	for (auto &id : recorder_ids) {
+		iio->disconnect(id);
+	}
+	iio->unlock_hot();
+	recorder_ids.clear();
+
+	recorder->close();
+
+	if (!writeRecordingInfo()) {
+		qDebug(CAT_OSCILLOSCOPE) << "Can't write the recording info of"
+					 << recording_file;
+	}
+}
+
+bool Oscilloscope::isRecording() const
+{
+	return !recorder_ids.empty();
+}
+
+bool Oscilloscope::writeRecordingInfo() const
+{
+	/* Same sidecar as the raw exports of FileManager, plus the drops */
+	QFileInfo info(recording_file);
+	QFile sidecar(info.path() + "/" + info.completeBaseName() + ".json");
+	if (!sidecar.open(QIODevice::WriteOnly)) {
+		return false;
+	}
+
+	boost::shared_ptr<adc_sample_conv> conv =
+		dynamic_pointer_cast<adc_sample_conv>(adc_samp_conv_block);
+	QJsonArray columns, drops;
+
+	for (unsigned int i = 0; i < nb_channels; i++) {
+		QJsonObject column;
+		column["name"] = "CH" + QString::number(i + 1) + "(V)";
+		if (conv) {
+			column["scale"] = adc_sample_conv::sampleToVoltsScale(
+					conv->correctionGain(i),
+					conv->filterCompensation(i),
+					conv->hardwareGain(i));
+			column["offset"] = conv->offset(i);
+		}
+		columns.append(column);
+	}
+
+	for (const auto &drop : recorder->drops()) {
+		drops.append(QJsonArray() << (qint64)drop.first
+			     << (qint64)drop.second);
+	}
+
+	QJsonObject root;
+	root["file"] = info.fileName();
+	root["dtype"] = "<i2";
+	root["shape"] = QJsonArray() << (qint64)recorder->frames_written()
+				     << (int)nb_channels;
+	root["columns"] = columns;
+	root["sample_rate"] = active_sample_rate;
+	root["tool"] = "Oscilloscope";
+	root["version"] = QString(SCOPY_VERSION_GIT);
+	root["dropped"] = (qint64)recorder->frames_dropped();
+	root["drops"] = drops;
+	root["failed"] = recorder->failed();
+
+	QByteArray json = QJsonDocument(root).toJson();
+
+	return sidecar.write(json) == json.size();
+}
@@ -26,11 +26,7 @@
 /* GNU Radio includes */
 #include <gnuradio/blocks/short_to_float.h>
 #include <iio/device_source.h>
-#include <gnuradio/blocks/complex_to_mag_squared.h>
-#include <gnuradio/analog/rail_ff.h>
-#include <gnuradio/blocks/keep_one_in_n.h>
 #include <gnuradio/blocks/vector_sink.h>
-#include <gnuradio/blocks/multiply_const.h>
 
 
 /* Qt includes */
@@ -48,7 +44,7 @@
 #include "oscilloscope_plot.hpp"
 #include "iio_manager.hpp"
 #include "filter.hpp"
-#include "fft_block.hpp"
+#include "fft_frame_sink.h"
 #include "scope_sink_f.h"
 #include "xy_sink_c.h"
 #include "histogram_sink_f.h"
@@ -63,9 +59,12 @@
 #include "osc_import_settings.h"
 #include "math.hpp"
 #include "scroll_filter.hpp"
-#include "cancel_dc_offset_block.h"
 #include "frequency_compensation_filter.h"
+#include "stream_recorder_sink.hpp"
+#include "mapped_reference.hpp"
 #include "oscilloscope_api.hpp"
+#include "jitter_analysis.h"
+#include "equivalent_time.h"
 
 /*Generated UI */
 #include "ui_math_panel.h"
@@ -95,7 +94,13 @@ namespace adiscope {
 	class StateUpdater;
 	class AnalogBufferPreviewer;
 	class ChannelWidget;
-	class signal_sample;
+	class BatchMeasurement;
+	class MaskTest;
+	class EyeDiagram;
+	class MathFrameSink;
+	class CaptureLatency;
+	class AnalogCaptureWriter;
+	class MixedSignalPlotItem;
 
 	class Oscilloscope : public Tool
 	{
@@ -142,6 +147,9 @@ namespace adiscope {
 		void onHistogram_view_toggled(bool visible);
 		void onXY_view_toggled(bool visible);
 
+		void updateMaskTestResult();
+		void maskTestFailed();
+
 		void on_btnAddMath_toggled(bool);
 		void on_btnCursors_toggled(bool);
 		void on_btnMeasure_toggled(bool);
@@ -198,6 +206,7 @@ namespace adiscope {
 
 		void onIioDataRefillTimeout();
 		void onPlotNewData();
+		void onDisplayedChanged(bool displayed);
 
 		void on_btnSettings_clicked(bool checked);
 		void channelLineWidthChanged(int id);
@@ -213,19 +222,74 @@ namespace adiscope {
 
 		void openEditMathPanel(bool on);
 
-		void updateTriggerLevelValue(std::vector<float> value);
+		void updateTriggerLevelValue();
 		void configureAcCouplingTrigger(bool);
 
 		void readPreferences();
 
 		void onCmbMemoryDepthChanged(QString);
 		void setSinksDisplayOneBuffer(bool);
-		void cleanBuffersAllSinks();
+		void cleanBuffersAllSinks(bool timeSink = true);
 		void resetStreamingFlag(bool);
 		void onFilledScreen(bool, unsigned int);
 
 		void toggleCursorsMode(bool toggled);
 		void toolDetached(bool);
+
+		void setSegments(unsigned int);
+		void showSegment(unsigned int);
+
+		void setPersistence(bool);
+		void clearPersistence();
+
+		/* With hw_high_res the M2K averages oversampled samples
+		 * itself (its filter is bypassed), rather than the sink
+		 * averaging adjacent samples after the decimation */
+		void setAcquisitionMode(WaveformAverager::Mode mode,
+				unsigned int count, bool hw_high_res);
+		void applyAdcFiltering();
+
+		/* The masks are learned from the next frame of the enabled
+		 * channels, margin_divs vertical divisions and
+		 * margin_samples samples around it */
+		void setMaskTestEnabled(bool);
+		void learnMask(double margin_divs, unsigned int margin_samples);
+
+		/* Eye diagrams of all the channels, accumulated from the
+		 * frames until disabled or cleared */
+		void setEyeDiagram(bool);
+
+		/* The XY plot as a density map of its points instead of
+		 * the points, over the ranges of its axes; with accumulate
+		 * the frames add up until cleared */
+		void setXyDensity(bool enabled, bool accumulate);
+		void clearXyDensity();
+		void updateXyDensityRanges();
+		void updateMapRanges(const std::vector<
+				std::shared_ptr<PersistenceMap>> &maps);
+
+		/* Jitter of the last frame of a channel, shown with the
+		 * statistics; with accumulate the values add up to those
+		 * of the previous frames of the same channel */
+		void analyzeJitter(unsigned int chn, bool accumulate);
+
+		/* Equivalent-time record of the captured segments, at
+		 * factor times the sample rate, aligned on the edges of
+		 * the trigger channel; with add_references the channels
+		 * are added as reference waveforms. Only while stopped. */
+		bool equivalentTime(unsigned int factor, bool add_references);
+
+		/* Show the last logic analyzer capture under the channels,
+		 * on the time axis of the trigger */
+		void setMixedSignal(bool);
+		bool isMixedSignal() const;
+
+		void setDisplayRate(double);
+
+		void setStatisticsWindow(unsigned int);
+
+		void updateSoftwareTrigger();
+		void updateCaptureLatencyToolTip();
 	public Q_SLOTS:
 		void requestAutoset();
 		void enableLabels(bool);
@@ -249,6 +313,17 @@ namespace adiscope {
 		unsigned long last_set_sample_count;
 		int zoom_level;
 		bool plot_samples_sequentially, d_displayOneBuffer, d_shouldResetStreaming;
+		unsigned int nb_segments, current_segment;
+		bool persistence_enabled;
+		WaveformAverager::Mode acquisition_mode;
+		unsigned int acquisition_count;
+		bool hw_high_res;
+		double display_rate;
+		uint64_t frames_displayed;
+		std::vector<std::shared_ptr<PersistenceMap>> persistence_maps;
+		std::vector<std::shared_ptr<PersistenceMap>> eye_maps;
+		std::vector<std::shared_ptr<PersistenceMap>> xy_density_maps;
+		bool xy_density_accumulate;
 		double horiz_offset;
 		bool reset_horiz_offset;
 		double time_trigger_offset;
@@ -296,6 +371,8 @@ namespace adiscope {
 		QWidget *ref;
 
 		QVector<QVector<double>> import_data;
+		/* Set instead of import_data for binary references */
+		std::shared_ptr<MappedReference> import_ref;
 		QString import_error;
 		ImportSettings *importSettings;
 		bool lastFunctionValid;
@@ -305,20 +382,34 @@ namespace adiscope {
 		std::shared_ptr<SymmetricBufferMode> symmBufferMode;
 
 		adiscope::scope_sink_f::sptr qt_time_block;
-		adiscope::scope_sink_f::sptr qt_fft_block;
+		std::shared_ptr<FftFrameSink> fft_frames;
 		adiscope::xy_sink_c::sptr qt_xy_block;
 		adiscope::histogram_sink_f::sptr qt_hist_block;
+		std::shared_ptr<BatchMeasurement> batch_measurement;
+		std::shared_ptr<CaptureLatency> capture_latency;
+		std::shared_ptr<MaskTest> mask_test;
+		std::shared_ptr<EyeDiagram> eye_diagram;
+		EquivalentTime equivalent_time;
+		std::unique_ptr<JitterAnalysis::Result> jitter_result;
+		int jitter_channel;
+		QWidget *jitter_statistics;
+		QTimer *mask_test_timer;
+		std::shared_ptr<AnalogCaptureWriter> capture_writer;
+		MixedSignalPlotItem *mixed_signal_item;
+		QMetaObject::Connection mixed_signal_conn;
 		boost::shared_ptr<iio_manager> iio;
 		gr::basic_block_sptr adc_samp_conv_block;
 
-		QMap<QString, QPair<gr::basic_block_sptr,
-		gr::basic_block_sptr>> math_sinks;
-		QMap<QString, boost::shared_ptr<gr::analog::rail_ff>> math_rails;
-		std::vector<boost::shared_ptr<gr::blocks::multiply_const_ff>> math_probe_atten;
+		/* The math channels, computed on the frames of qt_time_block */
+		std::shared_ptr<MathFrameSink> math_frames;
 
 		iio_manager::port_id *ids;
 		iio_manager::port_id *hist_ids;
-		iio_manager::port_id *autoset_id;
+
+		/* Raw ADC samples to disk, straight from the source */
+		stream_recorder_sink::sptr recorder;
+		std::vector<iio_manager::port_id> recorder_ids;
+		QString recording_file;
 
 		ScaleSpinButton *timeBase;
 		PositionSpinButton *timePosition;
@@ -338,10 +429,13 @@ namespace adiscope {
 
 		std::vector<bool> chnAcCoupled;
 		bool triggerAcCoupled;
-		QPair<boost::shared_ptr<signal_sample>, int> triggerLevelSink;
-		boost::shared_ptr<gr::blocks::keep_one_in_n> keep_one;
-		boost::shared_ptr<gr::blocks::vector_sink_f> autosetFFTSink;
-		boost::shared_ptr<gr::blocks::vector_sink_f> autosetDataSink;
+		/* The AC coupled channel the trigger level follows, or -1 */
+		int ac_trigger_channel;
+		/* The spectrum of each autoset capture is computed here
+		 * rather than by blocks connected for the autoset */
+		power_spectrum::sptr autoset_spectrum;
+		std::vector<float> autoset_samples, autoset_power;
+		bool autosetFound;
 
 		bool trigger_is_forced;
 		bool new_data_is_triggered;
@@ -374,6 +468,15 @@ namespace adiscope {
 
 		QList<QPair<std::shared_ptr<MeasurementData>,
 			Statistic>> statistics_data;
+		unsigned int statistics_window;
+		bool histogram_accumulate;
+
+		/* Streaming mode trigger, it follows the analog trigger
+		 * settings; the widths are in seconds */
+		SoftwareTrigger::Type software_trigger_type;
+		double software_trigger_runt_high;
+		double software_trigger_min_width;
+		double software_trigger_max_width;
 
 		QList<CustomPushButton *> menuOrder;
 
@@ -396,7 +499,7 @@ namespace adiscope {
 		void update_measure_for_channel(int ch_idx);
 		QString getChannelRangeStringVDivHelper(int ch);
 		void setAllSinksSampleCount(unsigned long sample_count);
-		void autosetFFT();
+		int autosetNextSampleRateIdx() const;
 
 		void updateRunButton(bool ch_enabled);
 
@@ -424,19 +527,14 @@ namespace adiscope {
 
 		void init_channel_settings();
 		void editMathChannelFunction(int id, const std::string &new_function);
+		void showMathError(const std::string& function, const char *error);
 
-		std::vector<boost::shared_ptr<cancel_dc_offset_block>> dc_cancel;
-		std::vector<QPair<gr::basic_block_sptr, int> > xy_channels;
-		std::vector<QPair<gr::basic_block_sptr, int> > fft_channels;
 		int index_x, index_y;
-		bool locked;
-		boost::shared_ptr<gr::blocks::float_to_complex> ftc;
-		std::vector<gr::basic_block_sptr> fft_blocks;
-		std::vector<gr::basic_block_sptr> ctm_blocks;
 
 		void cancelZoom();
 
 		void configureAcCoupling(int, bool);
+		void updateAcOutputMultiple(bool stopped = false);
 		void activateAcCoupling(int);
 		void deactivateAcCoupling(int);
 		void activateAcCouplingTrigger(int);
@@ -452,6 +550,13 @@ namespace adiscope {
 		void resetHistogramDataPoints();
 		bool isIioManagerStarted() const;
 		void updateXyPlotScales();
+
+		void importMappedReference(const QString &fileName);
+
+		bool startRecording(const QString &filename);
+		void stopRecording();
+		bool isRecording() const;
+		bool writeRecordingInfo() const;
 	};
 }
 #endif /* M2K_OSCILLOSCOPE_H */
@@ -18,6 +18,17 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 #include "oscilloscope_api.hpp"
+#include "batch_measurement.h"
+#include "capture_latency.h"
+#include "mask_test.h"
+#include "eye_diagram.h"
+#include "jitter_analysis.h"
+#include "logging_categories.h"
+
+#include <algorithm>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QThread>
 
 #include "ui_oscilloscope.h"
 #include "measure_settings.h"
@@ -289,6 +300,17 @@ void Oscilloscope_API::setTriggerInput(bool en)
 	osc->setTrigger_input(en);
 }
 
+int Oscilloscope_API::triggerChannels() const
+{
+	return osc->trigger_settings.ui->cmb_source_logic->currentIndex();
+}
+
+void Oscilloscope_API::setTriggerChannels(int val)
+{
+	if (val >= 0 && val < osc->trigger_settings.ui->cmb_source_logic->count())
+		osc->trigger_settings.ui->cmb_source_logic->setCurrentIndex(val);
+}
+
 void Oscilloscope_API::setExternalCondition(int cond)
 {
 	if (cond >= osc->trigger_settings.ui->cmb_extern_condition->count()) {
@@ -384,6 +406,59 @@ void Oscilloscope_API::show()
 	Q_EMIT osc->showTool();
 }
 
+void Oscilloscope_API::beginLoad()
+{
+	if (osc->iio)
+		osc->iio->hold();
+}
+
+void Oscilloscope_API::endLoad()
+{
+	if (osc->iio)
+		osc->iio->release();
+}
+
+void Oscilloscope_API::runSingleAsync(const QJSValue& callback)
+{
+	if (callback.isCallable())
+		single_callbacks.append(callback);
+
+	single(true);
+}
+
+void Oscilloscope_API::onNewData(const QJSValue& callback)
+{
+	if (callback.isCallable())
+		new_data_callbacks.append(callback);
+}
+
+void Oscilloscope_API::clearNewData()
+{
+	new_data_callbacks.clear();
+}
+
+void Oscilloscope_API::callBack(QJSValue callback)
+{
+	QJSValue ret = callback.call();
+	if (ret.isError())
+		qWarning(CAT_OSCILLOSCOPE) << "Exception in callback:"
+					   << ret.toString();
+}
+
+void Oscilloscope_API::capturePlotted()
+{
+	/* The callbacks may queue the next ones */
+	QList<QJSValue> single_done;
+	single_done.swap(single_callbacks);
+
+	QList<QJSValue> each_capture = new_data_callbacks;
+
+	for (const QJSValue& callback : each_capture)
+		callBack(callback);
+	for (const QJSValue& callback : single_done)
+		callBack(callback);
+}
+
 bool Oscilloscope_API::running() const
 {
 	return osc->ui->runSingleWidget->runButtonChecked() || osc->ui->runSingleWidget->singleButtonChecked();
@@ -629,6 +704,615 @@ void Oscilloscope_API::setCursorGateRight(double val)
 	osc->plot.d_gateBar2->setPosition(val);
 }
 
+QVariantList Oscilloscope_API::getAcquisitionStats() const
+{
+	QVariantList list;
+
+	for (unsigned int i = 0; i < osc->nb_channels; i++) {
+		list.append(osc->iio->get_port_stats(
+				osc->ids[i]).toVariantMap());
+	}
+
+	return list;
+}
+
+int Oscilloscope_API::getSegments() const
+{
+	return osc->nb_segments;
+}
+
+void Oscilloscope_API::setSegments(int val)
+{
+	osc->setSegments(std::max(val, 0));
+}
+
+int Oscilloscope_API::getSegmentsCaptured() const
+{
+	return osc->qt_time_block->segments_captured();
+}
+
+QList<double> Oscilloscope_API::getSegmentTimes() const
+{
+	QList<double> list;
+	unsigned int captured = osc->qt_time_block->segments_captured();
+
+	for (unsigned int i = 0; i < captured; i++) {
+		list.append(osc->qt_time_block->segment_time(i));
+	}
+
+	return list;
+}
+
+int Oscilloscope_API::getCurrentSegment() const
+{
+	return osc->current_segment;
+}
+
+void Oscilloscope_API::setCurrentSegment(int val)
+{
+	osc->showSegment(std::max(val, 0));
+}
+
+bool Oscilloscope_API::getPersistence() const
+{
+	return osc->persistence_enabled;
+}
+
+void Oscilloscope_API::setPersistence(bool val)
+{
+	osc->setPersistence(val);
+}
+
+void Oscilloscope_API::clearPersistence()
+{
+	osc->clearPersistence();
+}
+
+int Oscilloscope_API::getAcquisitionMode() const
+{
+	return osc->acquisition_mode;
+}
+
+void Oscilloscope_API::setAcquisitionMode(int val)
+{
+	if (val < WaveformAverager::NORMAL || val > WaveformAverager::HIGH_RES) {
+		return;
+	}
+
+	osc->setAcquisitionMode(static_cast<WaveformAverager::Mode>(val),
+			osc->acquisition_count, osc->hw_high_res);
+}
+
+int Oscilloscope_API::getAcquisitionCount() const
+{
+	return osc->acquisition_count;
+}
+
+void Oscilloscope_API::setAcquisitionCount(int val)
+{
+	osc->setAcquisitionMode(osc->acquisition_mode, std::max(val, 1),
+			osc->hw_high_res);
+}
+
+bool Oscilloscope_API::getHwHighRes() const
+{
+	return osc->hw_high_res;
+}
+
+void Oscilloscope_API::setHwHighRes(bool val)
+{
+	osc->setAcquisitionMode(osc->acquisition_mode,
+			osc->acquisition_count, val);
+}
+
+int Oscilloscope_API::getFramesAveraged() const
+{
+	return osc->qt_time_block->frames_averaged();
+}
+
+void Oscilloscope_API::clearAverage()
+{
+	osc->qt_time_block->clear_average();
+}
+
+bool Oscilloscope_API::getMaskTest() const
+{
+	return osc->mask_test->isEnabled();
+}
+
+void Oscilloscope_API::setMaskTest(bool val)
+{
+	osc->setMaskTestEnabled(val);
+}
+
+bool Oscilloscope_API::getMaskStopOnFailure() const
+{
+	return osc->mask_test->stopOnFailure();
+}
+
+void Oscilloscope_API::setMaskStopOnFailure(bool val)
+{
+	osc->gsettings_ui->maskStopOnFail->setChecked(val);
+	osc->mask_test->setStopOnFailure(val);
+}
+
+QVariantMap Oscilloscope_API::getMaskResults() const
+{
+	QVariantMap results;
+
+	results["passed"] = (qulonglong)osc->mask_test->passed();
+	results["failed"] = (qulonglong)osc->mask_test->failed();
+	results["skipped"] = (qulonglong)osc->mask_test->skipped();
+	results["halted"] = osc->mask_test->halted();
+	results["failure_channel"] = osc->mask_test->lastFailureChannel();
+	results["failure_sample"] = osc->mask_test->lastFailureSample();
+
+	return results;
+}
+
+void Oscilloscope_API::resetMaskCounters()
+{
+	osc->mask_test->resetCounters();
+	osc->updateMaskTestResult();
+}
+
+void Oscilloscope_API::learnMask(double margin_divs, int margin_samples)
+{
+	osc->learnMask(margin_divs, std::max(margin_samples, 0));
+}
+
+void Oscilloscope_API::setMask(int chn, const QList<double> &lower,
+		const QList<double> &upper)
+{
+	if (chn < 0 || chn >= (int)osc->nb_channels) {
+		return;
+	}
+
+	std::vector<float> lo(lower.begin(), lower.end());
+	std::vector<float> hi(upper.begin(), upper.end());
+
+	osc->mask_test->setMask(chn, lo, hi);
+	osc->mask_test->resetCounters();
+}
+
+QVariantMap Oscilloscope_API::getMask(int chn) const
+{
+	QVariantMap map;
+	std::vector<float> lo, hi;
+	QVariantList lower, upper;
+
+	if (chn >= 0 && osc->mask_test->mask(chn, lo, hi)) {
+		for (size_t i = 0; i < lo.size(); i++) {
+			lower.append(lo[i]);
+			upper.append(hi[i]);
+		}
+	}
+
+	map["lower"] = lower;
+	map["upper"] = upper;
+	return map;
+}
+
+void Oscilloscope_API::clearMask()
+{
+	osc->mask_test->clearMask();
+	osc->mask_test->resetCounters();
+}
+
+bool Oscilloscope_API::getEyeDiagram() const
+{
+	return !osc->eye_maps.empty();
+}
+
+void Oscilloscope_API::setEyeDiagram(bool val)
+{
+	osc->setEyeDiagram(val);
+}
+
+double Oscilloscope_API::getEyeBitRate() const
+{
+	return osc->eye_diagram->bitRate();
+}
+
+void Oscilloscope_API::setEyeBitRate(double val)
+{
+	osc->eye_diagram->setBitRate(val);
+}
+
+QList<double> Oscilloscope_API::getEyeUnitIntervals() const
+{
+	QList<double> list;
+
+	for (unsigned int i = 0; i < osc->eye_maps.size(); i++) {
+		list.append(osc->eye_diagram->unitInterval(i));
+	}
+
+	return list;
+}
+
+void Oscilloscope_API::clearEyeDiagram()
+{
+	osc->eye_diagram->clear();
+}
+
+bool Oscilloscope_API::saveEyeDiagram(int chn, const QString &file,
+		int width, int height)
+{
+	if (chn < 0 || chn >= (int)osc->nb_channels) {
+		return false;
+	}
+
+	QImage image = osc->eye_diagram->image(chn, QSize(width, height),
+			osc->plot.Curve(chn)->pen().color());
+
+	return !image.isNull() && image.save(file);
+}
+
+bool Oscilloscope_API::getXyDensity() const
+{
+	return !osc->xy_density_maps.empty();
+}
+
+void Oscilloscope_API::setXyDensity(bool val)
+{
+	osc->setXyDensity(val, osc->xy_density_accumulate);
+}
+
+bool Oscilloscope_API::getXyDensityAccumulate() const
+{
+	return osc->xy_density_accumulate;
+}
+
+void Oscilloscope_API::setXyDensityAccumulate(bool val)
+{
+	osc->setXyDensity(!osc->xy_density_maps.empty(), val);
+}
+
+void Oscilloscope_API::clearXyDensity()
+{
+	osc->clearXyDensity();
+}
+
+static QVariantMap jitterStatistic(const Statistic &statistic)
+{
+	QVariantMap map;
+
+	map["count"] = statistic.numPushedData();
+	map["mean"] = statistic.average();
+	map["std_dev"] = statistic.stdDev();
+	map["min"] = statistic.min();
+	map["max"] = statistic.max();
+	map["pk_pk"] = statistic.max() - statistic.min();
+
+	return map;
+}
+
+static QVariantMap jitterHistogram(const std::vector<double> &values,
+		int bins)
+{
+	QVariantMap map;
+	std::vector<unsigned int> counts;
+	double min;
+	double width = JitterAnalysis::histogram(values, std::max(bins, 1),
+			counts, min);
+
+	QVariantList list;
+	for (unsigned int count : counts) {
+		list.append(count);
+	}
+
+	map["min"] = min;
+	map["bin_width"] = width;
+	map["counts"] = list;
+
+	return map;
+}
+
+QVariantMap Oscilloscope_API::analyzeJitter(int chn, bool accumulate,
+		int bins)
+{
+	QVariantMap map;
+
+	if (chn < 0 || chn >= (int)osc->nb_channels) {
+		return map;
+	}
+
+	osc->analyzeJitter(chn, accumulate);
+
+	const JitterAnalysis::Result &result = *osc->jitter_result;
+
+	map["edges"] = result.edges;
+	map["unit_interval"] = result.unit_interval;
+	map["period"] = jitterStatistic(result.period);
+	map["cycle_to_cycle"] = jitterStatistic(result.cycle_to_cycle);
+	map["tie"] = jitterStatistic(result.tie);
+	map["period_histogram"] = jitterHistogram(result.periods, bins);
+	map["tie_histogram"] = jitterHistogram(result.ties, bins);
+
+	return map;
+}
+
+QVariantMap Oscilloscope_API::equivalentTime(int factor, bool add_references)
+{
+	QVariantMap map;
+
+	if (factor < 1 || !osc->equivalentTime(factor, add_references)) {
+		return map;
+	}
+
+	const EquivalentTime &et = osc->equivalent_time;
+
+	QVariantList channels;
+	for (unsigned int i = 0; i < osc->nb_channels; i++) {
+		std::vector<float> record;
+		et.record(i, record);
+
+		QVariantList samples;
+		for (float sample : record) {
+			samples.append(sample);
+		}
+		channels.append(QVariant(samples));
+	}
+
+	map["captures"] = et.captures();
+	map["rejected"] = et.rejected();
+	map["coverage"] = et.coverage();
+	map["sample_rate"] = osc->active_sample_rate * et.factor();
+	map["channels"] = channels;
+
+	return map;
+}
+
+bool Oscilloscope_API::getMixedSignal() const
+{
+	return osc->isMixedSignal();
+}
+
+void Oscilloscope_API::setMixedSignal(bool val)
+{
+	osc->setMixedSignal(val);
+}
+
+double Oscilloscope_API::getDisplayRate() const
+{
+	return osc->display_rate;
+}
+
+void Oscilloscope_API::setDisplayRate(double val)
+{
+	osc->setDisplayRate(val);
+}
+
+QVariantMap Oscilloscope_API::getFrameTime() const
+{
+	QVariantMap map;
+	uint64_t time, sample;
+
+	if (osc->qt_time_block->frame_time(time, sample)) {
+		map["time"] = (qulonglong)time;
+		map["sample"] = (qulonglong)sample;
+	}
+
+	return map;
+}
+
+QVariantMap Oscilloscope_API::getFrameCounters() const
+{
+	QVariantMap map;
+
+	map["acquired"] = (qulonglong)osc->qt_time_block->frames_acquired();
+	map["posted"] = (qulonglong)osc->qt_time_block->frames_posted();
+	map["displayed"] = (qulonglong)osc->frames_displayed;
+
+	return map;
+}
+
+QVariantMap Oscilloscope_API::getCaptureLatency() const
+{
+	QVariantMap map;
+
+	for (int i = 0; i < CaptureLatency::INTERVAL_COUNT; i++) {
+		auto interval = static_cast<CaptureLatency::Interval>(i);
+		CaptureLatency::Summary summary =
+			osc->capture_latency->summary(interval);
+		QVariantMap values;
+		QVariantList histogram;
+
+		for (unsigned int count : summary.histogram)
+			histogram.append(count);
+
+		values["count"] = summary.count;
+		values["min"] = summary.min;
+		values["max"] = summary.max;
+		values["mean"] = summary.mean;
+		values["bin_width"] = summary.bin_width;
+		values["histogram"] = histogram;
+		map[CaptureLatency::intervalName(interval)] = values;
+	}
+
+	return map;
+}
+
+void Oscilloscope_API::clearCaptureLatency()
+{
+	osc->capture_latency->clear();
+}
+
+bool Oscilloscope_API::isRecording() const
+{
+	return osc->isRecording();
+}
+
+QVariantMap Oscilloscope_API::getRecordingStats() const
+{
+	QVariantMap map;
+
+	if (osc->recorder) {
+		map["written"] = (qulonglong)osc->recorder->frames_written();
+		map["dropped"] = (qulonglong)osc->recorder->frames_dropped();
+		map["failed"] = osc->recorder->failed();
+	}
+
+	return map;
+}
+
+bool Oscilloscope_API::startRecording(const QString &filename)
+{
+	return osc->startRecording(filename);
+}
+
+void Oscilloscope_API::stopRecording()
+{
+	osc->stopRecording();
+}
+
+QList<double> Oscilloscope_API::measureBatch(int count, int timeout_ms)
+{
+	QList<double> list;
+
+	if (count <= 0)
+		return list;
+
+	std::vector<const Measure *> templates;
+	std::vector<BatchMeasurement::Selection> selection;
+
+	for (unsigned int i = 0; i < osc->nb_channels; i++) {
+		Measure *measure = osc->plot.measureOfChannel(i);
+		if (!measure)
+			break;
+
+		measure->setSampleRate(osc->plot.sampleRate());
+		templates.push_back(measure);
+
+		for (int id = 0; id < Measure::DEFAULT_MEASUREMENT_COUNT; id++) {
+			if (measure->measurement(id)->enabled())
+				selection.push_back(std::make_pair(i, id));
+		}
+	}
+
+	if (selection.empty())
+		return list;
+
+	bool was_running = running();
+	osc->batch_measurement->start(count, templates, selection);
+	if (!was_running)
+		run(true);
+
+	QElapsedTimer timer;
+	timer.start();
+	while (!osc->batch_measurement->done() &&
+			timer.elapsed() < timeout_ms) {
+		QCoreApplication::processEvents();
+		QThread::msleep(1);
+	}
+	osc->batch_measurement->cancel();
+
+	if (!was_running)
+		run(false);
+
+	for (double value : osc->batch_measurement->results())
+		list.append(value);
+
+	return list;
+}
+
+bool Oscilloscope_API::getHistogramAccumulate() const
+{
+	return osc->histogram_accumulate;
+}
+
+void Oscilloscope_API::setHistogramAccumulate(bool val)
+{
+	osc->histogram_accumulate = val;
+	osc->qt_hist_block->set_accumulate(val);
+}
+
+int Oscilloscope_API::getStatisticsWindow() const
+{
+	return osc->statistics_window;
+}
+
+void Oscilloscope_API::setStatisticsWindow(int val)
+{
+	osc->setStatisticsWindow(std::max(val, 1));
+}
+
+QVariantList Oscilloscope_API::getStatisticsValues() const
+{
+	QVariantList list;
+
+	for (const auto &each : osc->statistics_data) {
+		const Statistic &stat = each.second;
+		QVariantMap map;
+
+		map["name"] = each.first->name();
+		map["channel"] = each.first->channel();
+		map["count"] = stat.numPushedData();
+		map["average"] = stat.average();
+		map["min"] = stat.min();
+		map["max"] = stat.max();
+		map["std_dev"] = stat.stdDev();
+		map["p5"] = stat.percentile(5);
+		map["median"] = stat.percentile(50);
+		map["p95"] = stat.percentile(95);
+		map["window_count"] = stat.windowCount();
+		map["window_average"] = stat.windowAverage();
+		map["window_std_dev"] = stat.windowStdDev();
+		map["window_min"] = stat.windowMin();
+		map["window_max"] = stat.windowMax();
+		list.append(map);
+	}
+
+	return list;
+}
+
+int Oscilloscope_API::getSoftwareTrigger() const
+{
+	return osc->software_trigger_type;
+}
+
+void Oscilloscope_API::setSoftwareTrigger(int val)
+{
+	if (val < SoftwareTrigger::NONE || val > SoftwareTrigger::RUNT)
+		return;
+
+	osc->software_trigger_type = static_cast<SoftwareTrigger::Type>(val);
+	osc->updateSoftwareTrigger();
+}
+
+double Oscilloscope_API::getSoftwareTriggerRuntHigh() const
+{
+	return osc->software_trigger_runt_high;
+}
+
+void Oscilloscope_API::setSoftwareTriggerRuntHigh(double val)
+{
+	osc->software_trigger_runt_high = val;
+	osc->updateSoftwareTrigger();
+}
+
+double Oscilloscope_API::getSoftwareTriggerMinWidth() const
+{
+	return osc->software_trigger_min_width;
+}
+
+void Oscilloscope_API::setSoftwareTriggerMinWidth(double val)
+{
+	osc->software_trigger_min_width = std::max(val, 0.0);
+	osc->updateSoftwareTrigger();
+}
+
+double Oscilloscope_API::getSoftwareTriggerMaxWidth() const
+{
+	return osc->software_trigger_max_width;
+}
+
+void Oscilloscope_API::setSoftwareTriggerMaxWidth(double val)
+{
+	osc->software_trigger_max_width = std::max(val, 0.0);
+	osc->updateSoftwareTrigger();
+}
+
 QVariantList Oscilloscope_API::getChannels()
 {
 	QVariantList list;
@@ -905,11 +1589,32 @@ QList<double> Channel_API::data() const
 	return list;
 }
 
+QByteArray Channel_API::dataBuffer(qint64 offset, qint64 length) const
+{
+	QByteArray buffer;
+	int index = osc->channels_api.indexOf(const_cast<Channel_API*>(this));
+	if (index < 0)
+		return buffer;
+
+	auto curve_data = osc->plot.Curve(index)->data();
+	if (!dataWindow(curve_data->size(), offset, length))
+		return buffer;
+
+	buffer.resize(length * sizeof(float));
+	float *samples = reinterpret_cast<float *>(buffer.data());
+	for (qint64 i = 0; i < length; i++)
+		samples[i] = curve_data->sample(offset + i).y();
+
+	return buffer;
+}
+
 #define DECLARE_MEASURE(m, t) \
 	double Channel_API::measured_ ## m () const\
 	{\
 		int index = osc->channels_api.indexOf(const_cast<Channel_API*>(this));\
 		auto measData = osc->plot.measurement(Measure::t, index);\
+		if (!measData->enabled())\
+			osc->plot.measureAll(index);\
 		return measData->value();\
 	}
 DECLARE_MEASURE(period, PERIOD)
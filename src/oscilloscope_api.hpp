@@ -22,6 +22,8 @@
 
 #include <oscilloscope.hpp>
 
+#include <QJSValue>
+
 namespace adiscope {
 
 class ApiObject;
@@ -96,6 +98,8 @@ class Oscilloscope_API : public ApiObject
 			WRITE setExternalCondition)
 	Q_PROPERTY(bool trigger_input READ getTriggerInput
 			WRITE setTriggerInput STORED false)
+	Q_PROPERTY(int trigger_channels READ triggerChannels
+			WRITE setTriggerChannels)
 
 	Q_PROPERTY(QList<QString> math_channels
 			READ getMathChannels WRITE setMathChannels
@@ -124,6 +128,98 @@ class Oscilloscope_API : public ApiObject
 	Q_PROPERTY(int memory_depth READ getMemoryDepth
 		   WRITE setMemoryDepth)
 
+	Q_PROPERTY(QVariantList acquisition_stats READ getAcquisitionStats
+		   STORED false)
+
+	Q_PROPERTY(int segments READ getSegments WRITE setSegments)
+	Q_PROPERTY(int segments_captured READ getSegmentsCaptured
+		   STORED false)
+	Q_PROPERTY(QList<double> segment_times READ getSegmentTimes
+		   STORED false)
+	Q_PROPERTY(int current_segment READ getCurrentSegment
+		   WRITE setCurrentSegment STORED false)
+
+	Q_PROPERTY(bool persistence READ getPersistence WRITE setPersistence)
+	Q_PROPERTY(bool mixed_signal READ getMixedSignal WRITE setMixedSignal)
+
+	/* 0: normal, 1: average of the last acquisition_count frames,
+	 * 2: high resolution, mean of acquisition_count adjacent samples
+	 * or, with hw_high_res, the oversampling of the M2K */
+	Q_PROPERTY(int acquisition_mode READ getAcquisitionMode
+		   WRITE setAcquisitionMode)
+	Q_PROPERTY(int acquisition_count READ getAcquisitionCount
+		   WRITE setAcquisitionCount)
+	Q_PROPERTY(bool hw_high_res READ getHwHighRes WRITE setHwHighRes)
+	Q_PROPERTY(int frames_averaged READ getFramesAveraged STORED false)
+
+	/* Every frame is tested against the masks, the results being
+	 * passed, failed and skipped frame counts, halted, and the
+	 * failure_channel and failure_sample of the last failure */
+	Q_PROPERTY(bool mask_test READ getMaskTest WRITE setMaskTest
+		   STORED false)
+	Q_PROPERTY(bool mask_stop_on_failure READ getMaskStopOnFailure
+		   WRITE setMaskStopOnFailure)
+	Q_PROPERTY(QVariantMap mask_results READ getMaskResults
+		   STORED false)
+
+	/* A bit rate of 0 recovers the clock from each frame; the unit
+	 * intervals are those of the last frame, in seconds */
+	Q_PROPERTY(bool eye_diagram READ getEyeDiagram WRITE setEyeDiagram)
+	Q_PROPERTY(double eye_bit_rate READ getEyeBitRate
+		   WRITE setEyeBitRate)
+	Q_PROPERTY(QList<double> eye_unit_intervals
+		   READ getEyeUnitIntervals STORED false)
+
+	/* The XY plot as a density map instead of points */
+	Q_PROPERTY(bool xy_density READ getXyDensity WRITE setXyDensity)
+	Q_PROPERTY(bool xy_density_accumulate READ getXyDensityAccumulate
+		   WRITE setXyDensityAccumulate)
+
+	Q_PROPERTY(double display_rate READ getDisplayRate
+		   WRITE setDisplayRate)
+	Q_PROPERTY(QVariantMap frame_counters READ getFrameCounters
+		   STORED false)
+
+	/* Of the first sample of the last frame: time (acquisition clock,
+	 * in ns, shared by the tools) and sample (index in the stream of
+	 * the device); empty before the first time tagged frame */
+	Q_PROPERTY(QVariantMap frame_time READ getFrameTime STORED false)
+
+	/* For each interval of the last captures (trigger_wait, transfer,
+	 * display, rearm): count, min, max and mean in seconds, and a
+	 * histogram of bin_width wide bins starting at 0 */
+	Q_PROPERTY(QVariantMap capture_latency READ getCaptureLatency
+		   STORED false)
+
+	Q_PROPERTY(bool histogram_accumulate READ getHistogramAccumulate
+		   WRITE setHistogramAccumulate)
+
+	Q_PROPERTY(int statistics_window READ getStatisticsWindow
+		   WRITE setStatisticsWindow)
+	Q_PROPERTY(QVariantList statistics_values READ getStatisticsValues
+		   STORED false)
+
+	/* Streaming mode trigger: 0 off, 1 edge, 2 level, 3 pulse width,
+	 * 4 runt. It uses the source, level, hysteresis and condition of
+	 * the analog trigger; the level is the low one of a runt. */
+	Q_PROPERTY(int software_trigger READ getSoftwareTrigger
+		   WRITE setSoftwareTrigger)
+	Q_PROPERTY(double software_trigger_runt_high
+		   READ getSoftwareTriggerRuntHigh
+		   WRITE setSoftwareTriggerRuntHigh)
+	Q_PROPERTY(double software_trigger_min_width
+		   READ getSoftwareTriggerMinWidth
+		   WRITE setSoftwareTriggerMinWidth)
+	Q_PROPERTY(double software_trigger_max_width
+		   READ getSoftwareTriggerMaxWidth
+		   WRITE setSoftwareTriggerMaxWidth)
+
+	/* Raw int16 samples of the ADC channels, interleaved, recorded
+	 * by startRecording(); frames written and dropped so far */
+	Q_PROPERTY(bool recording READ isRecording STORED false)
+	Q_PROPERTY(QVariantMap recording_stats READ getRecordingStats
+		   STORED false)
+
 public:
 	explicit Oscilloscope_API(Oscilloscope *osc) :
 		ApiObject(), osc(osc) {}
@@ -210,6 +306,9 @@ public:
 	bool getTriggerInput() const;
 	void setTriggerInput(bool en);
 
+	int triggerChannels() const;
+	void setTriggerChannels(int val);
+
 	int internalCondition() const;
 	void setInternalCondition(int cond);
 
@@ -258,10 +357,144 @@ public:
 	int getMemoryDepth();
 	void setMemoryDepth(int val);
 
+	QVariantList getAcquisitionStats() const;
+
+	int getSegments() const;
+	void setSegments(int val);
+	int getSegmentsCaptured() const;
+	QList<double> getSegmentTimes() const;
+	int getCurrentSegment() const;
+	void setCurrentSegment(int val);
+
+	bool getPersistence() const;
+	void setPersistence(bool val);
+	Q_INVOKABLE void clearPersistence();
+
+	int getAcquisitionMode() const;
+	void setAcquisitionMode(int val);
+	int getAcquisitionCount() const;
+	void setAcquisitionCount(int val);
+	bool getHwHighRes() const;
+	void setHwHighRes(bool val);
+	int getFramesAveraged() const;
+	Q_INVOKABLE void clearAverage();
+
+	bool getMaskTest() const;
+	void setMaskTest(bool val);
+	bool getMaskStopOnFailure() const;
+	void setMaskStopOnFailure(bool val);
+	QVariantMap getMaskResults() const;
+	Q_INVOKABLE void resetMaskCounters();
+
+	/* Masks of the enabled channels from the next frame */
+	Q_INVOKABLE void learnMask(double margin_divs = 0.5,
+			int margin_samples = 0);
+	/* One value per sample of the frame, starting at its first one */
+	Q_INVOKABLE void setMask(int chn, const QList<double> &lower,
+			const QList<double> &upper);
+	/* lower and upper lists, empty if the channel has no mask */
+	Q_INVOKABLE QVariantMap getMask(int chn) const;
+	Q_INVOKABLE void clearMask();
+
+	bool getEyeDiagram() const;
+	void setEyeDiagram(bool val);
+	double getEyeBitRate() const;
+	void setEyeBitRate(double val);
+	QList<double> getEyeUnitIntervals() const;
+	Q_INVOKABLE void clearEyeDiagram();
+	/* The eye of a channel as an image file, two unit intervals wide */
+	Q_INVOKABLE bool saveEyeDiagram(int chn, const QString &file,
+			int width = 1024, int height = 512);
+
+	bool getXyDensity() const;
+	void setXyDensity(bool val);
+	bool getXyDensityAccumulate() const;
+	void setXyDensityAccumulate(bool val);
+	Q_INVOKABLE void clearXyDensity();
+
+	/* Jitter of the last frame of a channel, edge times interpolated
+	 * between samples: edges, unit_interval, and period,
+	 * cycle_to_cycle and tie, each with count, mean, std_dev, min,
+	 * max and pk_pk, in seconds; period_histogram and tie_histogram
+	 * of the frame with min, bin_width and counts. With accumulate
+	 * the statistics add up over the calls on the same channel. */
+	Q_INVOKABLE QVariantMap analyzeJitter(int chn, bool accumulate = false,
+			int bins = 64);
+
+	/* Equivalent-time record of the captured segments of a stopped
+	 * segmented capture, factor times the sample rate: captures,
+	 * rejected (no edge of the trigger channel close enough to the
+	 * trigger), coverage of the record, sample_rate and channels,
+	 * the samples of each channel. With add_references, the channels
+	 * are also added as ET CHn reference waveforms. */
+	Q_INVOKABLE QVariantMap equivalentTime(int factor,
+			bool add_references = false);
+
+	bool getMixedSignal() const;
+	void setMixedSignal(bool val);
+
+	/* Measures the next count frames (typically a segmented capture)
+	 * with the measurements enabled on screen. Returns, frame after
+	 * frame, the values of the enabled measurements of channel 0 in
+	 * id order, then those of channel 1, and so on; NaN if a value
+	 * couldn't be measured. Fewer frames on timeout. */
+	Q_INVOKABLE QList<double> measureBatch(int count,
+			int timeout_ms = 10000);
+
+	double getDisplayRate() const;
+	void setDisplayRate(double val);
+	QVariantMap getFrameCounters() const;
+	QVariantMap getFrameTime() const;
+	QVariantMap getCaptureLatency() const;
+	Q_INVOKABLE void clearCaptureLatency();
+
+	bool getHistogramAccumulate() const;
+	void setHistogramAccumulate(bool val);
+
+	int getStatisticsWindow() const;
+	void setStatisticsWindow(int val);
+	QVariantList getStatisticsValues() const;
+
+	int getSoftwareTrigger() const;
+	void setSoftwareTrigger(int val);
+	double getSoftwareTriggerRuntHigh() const;
+	void setSoftwareTriggerRuntHigh(double val);
+	double getSoftwareTriggerMinWidth() const;
+	void setSoftwareTriggerMinWidth(double val);
+	double getSoftwareTriggerMaxWidth() const;
+	void setSoftwareTriggerMaxWidth(double val);
+
+	bool isRecording() const;
+	QVariantMap getRecordingStats() const;
+	/* The calibration, sample rate and drops go to a .json with the
+	 * same base name when the recording stops */
+	Q_INVOKABLE bool startRecording(const QString &filename);
+	Q_INVOKABLE void stopRecording();
+
 	Q_INVOKABLE void show();
 
+	/* Starts a single capture and returns at once; callback is called
+	 * once the capture is on screen, so the script can set up its next
+	 * step meanwhile */
+	Q_INVOKABLE void runSingleAsync(const QJSValue& callback);
+
+	/* Calls callback after each capture, until clearNewData() */
+	Q_INVOKABLE void onNewData(const QJSValue& callback);
+	Q_INVOKABLE void clearNewData();
+
+	protected:
+		void beginLoad() override;
+		void endLoad() override;
+
+	private Q_SLOTS:
+		void capturePlotted();
+
 	private:
 		Oscilloscope *osc;
+		QList<QJSValue> single_callbacks;
+		QList<QJSValue> new_data_callbacks;
+
+		static void callBack(QJSValue callback);
 	};
 
 	class Channel_Digital_Filter_API : public ApiObject
@@ -406,6 +639,11 @@ public:
 
 	Q_INVOKABLE void setColor(int, int, int, int a = 255);
 
+	/* The samples of the last capture as the ArrayBuffer of a
+	 * Float32Array, much faster to read than the data list */
+	Q_INVOKABLE QByteArray dataBuffer(qint64 offset = 0,
+			qint64 length = -1) const;
+
 private:
 	Oscilloscope *osc;
 	QList<Channel_Digital_Filter_API*> digFilters;
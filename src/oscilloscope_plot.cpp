@@ -25,6 +25,8 @@
 
 #include <QHBoxLayout>
 #include <QLabel>
+#include <QtConcurrentRun>
+#include <algorithm>
 
 #define ERROR_VALUE -10000000
 
@@ -66,12 +68,18 @@ CapturePlot::CapturePlot(QWidget *parent,
 	d_timeTriggerMinValue(-1),
 	d_timeTriggerMaxValue(1),
 	d_trackMode(false),
+	d_intersectionNext(0),
+	d_dataGeneration(1),
 	horizCursorsLocked(false),
 	vertCursorsLocked(false),
 	d_horizCursorsEnabled(false),
 	d_vertCursorsEnabled(false),
 	d_bonusWidth(0),
-	d_gatingEnabled(false)
+	d_gatingEnabled(false),
+	d_measureFrame(0),
+	d_measureJobsPending(0),
+	d_measureDirty(false),
+	d_measureTime(0)
 {
 	setMinimumHeight(250);
 	setMinimumWidth(500);
@@ -494,9 +502,15 @@ CapturePlot::CapturePlot(QWidget *parent,
 			SLOT(onGateBar2Moved(double)));
 
 
+	for (Intersection &each : d_intersections) {
+		each.generation = 0;
+	}
+
 	/* Apply measurements for every new batch of data */
 	connect(this, SIGNAL(newData()),
 		SLOT(onNewDataReceived()));
+	connect(this, SIGNAL(measureJobDone(unsigned int)),
+		SLOT(onMeasureJobDone(unsigned int)), Qt::QueuedConnection);
 
 	/* Add offset widgets for each new channel */
 	connect(this, SIGNAL(channelAdded(int)),
@@ -537,6 +551,12 @@ CapturePlot::CapturePlot(QWidget *parent,
 
 CapturePlot::~CapturePlot()
 {
+	d_measurePool.waitForDone();
+	for (MeasureJob *job : d_measureJobsDone) {
+		delete job->worker;
+		delete job;
+	}
+
 	markerIntersection1->detach();
 	markerIntersection2->detach();
 	removeEventFilter(this);
@@ -1218,61 +1238,112 @@ void CapturePlot::updateHandleAreaPadding(bool enabled)
 	d_vCursorHandle2->updatePosition();
 }
 
-double CapturePlot::getHorizontalCursorIntersection(double time)
+/*
+ * The samples are evenly spaced in time, so the index is guessed from the
+ * first and last x, then bracketed by steps doubling away from the guess
+ * and refined by bisection. That is O(1) for uniform data and O(log N) at
+ * worst.
+ */
+int CapturePlot::sampleIndexAt(unsigned int chnIdx, double time)
 {
-	int n = Curve(d_selected_channel)->data()->size();
+	const QwtSeriesData<QPointF> *data = Curve(chnIdx)->data();
+	int n = data->size();
 
-	if (n == 0) {
-		return ERROR_VALUE;
-	} else {
-		double leftTime, rightTime, leftCustom, rightCustom;
-		int rightIndex = -1;
-		int leftIndex = -1;
+	if (n == 0 || time <= data->sample(0).x()) {
+		return 0;
+	}
 
-		int left = 0;
-		int right = n - 1;
+	double first = data->sample(0).x();
+	double last = data->sample(n - 1).x();
 
-		if (Curve(d_selected_channel)->data()->sample(right).x() < time ||
-				Curve(d_selected_channel)->data()->sample(left).x() > time) {
-			return ERROR_VALUE;
-		}
+	if (time > last) {
+		return n;
+	}
+
+	int guess = (int)((time - first) / (last - first) * (n - 1));
+	guess = std::min(std::max(guess, 0), n - 1);
 
-		while (left <= right) {
-			int mid = (left + right) / 2;
-			double xData = Curve(d_selected_channel)->data()->sample(mid).x();
-			if (xData == time) {
-				if (mid > 0) {
-					leftIndex = mid - 1;
-					rightIndex = mid;
-				}
+	// x(lo) < time <= x(hi)
+	int lo, hi;
+
+	if (data->sample(guess).x() < time) {
+		lo = guess;
+		for (int step = 1; ; step *= 2) {
+			hi = std::min(guess + step, n - 1);
+			if (data->sample(hi).x() >= time) {
 				break;
-			} else if (xData < time) {
-				left = mid + 1;
-			} else {
-				right = mid - 1;
 			}
+			lo = hi;
 		}
-
-		if ((leftIndex == -1 || rightIndex == -1) && left > 0) {
-			leftIndex = left - 1;
-			rightIndex = left;
+	} else {
+		hi = guess;
+		for (int step = 1; ; step *= 2) {
+			lo = std::max(guess - step, 0);
+			if (data->sample(lo).x() < time) {
+				break;
+			}
+			hi = lo;
 		}
+	}
+
+	while (hi - lo > 1) {
+		int mid = lo + (hi - lo) / 2;
 
-		if (leftIndex == -1 || rightIndex == -1) {
-			return ERROR_VALUE;
+		if (data->sample(mid).x() < time) {
+			lo = mid;
+		} else {
+			hi = mid;
 		}
+	}
 
-		leftTime = Curve(d_selected_channel)->data()->sample(leftIndex).x();
-		rightTime = Curve(d_selected_channel)->data()->sample(rightIndex).x();
+	return hi;
+}
 
-		leftCustom = Curve(d_selected_channel)->data()->sample(leftIndex).y();
-		rightCustom = Curve(d_selected_channel)->data()->sample(rightIndex).y();
+double CapturePlot::getHorizontalCursorIntersection(double time)
+{
+	const QwtSeriesData<QPointF> *data = Curve(d_selected_channel)->data();
+	int n = data->size();
 
-		double value = (rightCustom - leftCustom) / (rightTime - leftTime) *
-				(time - leftTime) + leftCustom;
+	if (n == 0) {
+		return ERROR_VALUE;
+	}
 
-		return value;
+	double first = data->sample(0).x();
+	double last = data->sample(n - 1).x();
+
+	for (const Intersection &each : d_intersections) {
+		if (each.generation == d_dataGeneration &&
+				each.channel == d_selected_channel &&
+				each.size == n && each.first == first &&
+				each.last == last && each.time == time) {
+			return each.value;
+		}
 	}
+
+	double value = ERROR_VALUE;
+
+	if (time == first) {
+		value = data->sample(0).y();
+	} else if (time > first && time <= last) {
+		int rightIndex = sampleIndexAt(d_selected_channel, time);
+		QPointF left = data->sample(rightIndex - 1);
+		QPointF right = data->sample(rightIndex);
+
+		value = (right.y() - left.y()) / (right.x() - left.x()) *
+				(time - left.x()) + left.y();
+	}
+
+	Intersection &entry = d_intersections[d_intersectionNext];
+	d_intersectionNext = (d_intersectionNext + 1) % 2;
+	entry.generation = d_dataGeneration;
+	entry.channel = d_selected_channel;
+	entry.size = n;
+	entry.first = first;
+	entry.last = last;
+	entry.time = time;
+	entry.value = value;
+
+	return value;
 }
 
 void CapturePlot::displayIntersection()
@@ -1466,6 +1537,9 @@ void CapturePlot::cleanUpJustBeforeChannelRemoval(int chnIdx)
 		}
 		d_measureObjs.removeOne(measure);
 		delete measure;
+
+		// Drop the results of the jobs still running
+		d_measureFrame++;
 	}
 }
 
@@ -1500,6 +1574,21 @@ void CapturePlot::measure()
 	}
 }
 
+void CapturePlot::measureAll(int chnIdx)
+{
+	Measure *measure = measureOfChannel(chnIdx);
+
+	if (measure) {
+		measure->setSampleRate(this->sampleRate());
+		measure->measureAll();
+	}
+}
+
+double CapturePlot::lastMeasureTime() const
+{
+	return d_measureTime;
+}
+
 int CapturePlot::activeMeasurementsCount(int chnIdx)
 {
 	int count = -1;
@@ -1513,29 +1602,104 @@ int CapturePlot::activeMeasurementsCount(int chnIdx)
 
 void CapturePlot::onNewDataReceived()
 {
+	d_dataGeneration++;
+
+	/* Always keep the sources current, measure() runs on them */
+	QVector<double *> sources;
 	int ref_idx = 0;
 	for (int i = 0; i < d_measureObjs.size(); i++) {
 		Measure *measure = d_measureObjs[i];
 		int chn = measure->channel();
+		double *source;
 		if (isReferenceWaveform(Curve(chn))) {
-			measure->setDataSource(d_ref_ydata[ref_idx],
-					       Curve(chn)->data()->size());
+			source = d_ref_ydata[ref_idx];
 			ref_idx++;
 		} else {
 			int count = countReferenceWaveform(chn);
-			measure->setDataSource(d_ydata[chn - count],
-					Curve(chn)->data()->size());
+			source = d_ydata[chn - count];
 		}
+		measure->setDataSource(source, Curve(chn)->data()->size());
+		sources.push_back(source);
 
 		if (isMathWaveform(Curve(chn))) {
 			measure->setAdcBitCount(0);
 		}
 
 		measure->setSampleRate(this->sampleRate());
-		measure->measure();
 	}
 
-	Q_EMIT measurementsAvailable();
+	if (d_measureJobsPending > 0) {
+		d_measureDirty = true;
+		return;
+	}
+	d_measureDirty = false;
+	d_measureFrame++;
+	d_measureTimer.start();
+
+	for (int i = 0; i < d_measureObjs.size(); i++) {
+		Measure *measure = d_measureObjs[i];
+		size_t size = Curve(measure->channel())->data()->size();
+		if (size == 0)
+			continue;
+
+		MeasureJob *job = new MeasureJob;
+		job->frame = d_measureFrame;
+		job->target = measure;
+		job->samples = QVector<double>(size);
+		std::copy(sources[i], sources[i] + size, job->samples.begin());
+		job->worker = new Measure(measure->channel());
+		job->worker->copySettings(*measure);
+		job->worker->setDataSource(job->samples.data(), size);
+
+		d_measureJobsPending++;
+		QtConcurrent::run(&d_measurePool, [this, job]() {
+			unsigned int frame = job->frame;
+
+			job->worker->measure();
+
+			d_measureJobsMutex.lock();
+			d_measureJobsDone.push_back(job);
+			d_measureJobsMutex.unlock();
+
+			Q_EMIT measureJobDone(frame);
+		});
+	}
+
+	if (d_measureJobsPending == 0)
+		Q_EMIT measurementsAvailable();
+}
+
+void CapturePlot::onMeasureJobDone(unsigned int frame)
+{
+	QList<MeasureJob *> jobs;
+
+	d_measureJobsMutex.lock();
+	jobs.swap(d_measureJobsDone);
+	d_measureJobsMutex.unlock();
+
+	/* An earlier call may have already handled this job */
+	if (jobs.isEmpty())
+		return;
+
+	for (MeasureJob *job : jobs) {
+		if (job->frame == d_measureFrame)
+			job->target->copyValues(*job->worker);
+
+		d_measureJobsPending--;
+		delete job->worker;
+		delete job;
+	}
+
+	if (d_measureJobsPending > 0)
+		return;
+
+	if (frame == d_measureFrame) {
+		d_measureTime = d_measureTimer.nsecsElapsed() * 1e-9;
+		Q_EMIT measurementsAvailable();
+	}
+
+	if (d_measureDirty)
+		onNewDataReceived();
 }
 
 QList<std::shared_ptr<MeasurementData>> CapturePlot::measurements(int chnIdx)
@@ -1657,6 +1821,11 @@ void CapturePlot::setTriggerState(int triggerState)
 	d_triggerStateLabel->show();
 }
 
+void CapturePlot::setTriggerStateToolTip(const QString &text)
+{
+	d_triggerStateLabel->setToolTip(text);
+}
+
 void CapturePlot::setCursorReadoutsTransparency(int value)
 {
 	d_cursorReadouts->setTransparency(value);
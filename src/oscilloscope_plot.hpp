@@ -30,6 +30,10 @@
 #include "customplotpositionbutton.h"
 #include "graticule.h"
 
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QThreadPool>
+
 class QLabel;
 
 namespace adiscope {
@@ -100,10 +104,18 @@ namespace adiscope {
 		void removeLeftVertAxis(unsigned int axis);
 
 		void measure();
+		void measureAll(int chnIdx);
 		int activeMeasurementsCount(int chnIdx);
+		/* Seconds the measurements of the last frame took, from
+		 * the queueing of the jobs to the last one done */
+		double lastMeasureTime() const;
 		QList<std::shared_ptr<MeasurementData>> measurements(int chnIdx);
 		std::shared_ptr<MeasurementData> measurement(int id, int chnIdx);
 
+		/* Index of the first sample of the curve at or after time,
+		 * the number of samples if there is none */
+		int sampleIndexAt(unsigned int chnIdx, double time);
+
 		OscPlotZoomer* getZoomer();
 		void setOffsetInterval(double minValue, double maxValue);
 		double getMaxOffsetValue();
@@ -130,6 +142,7 @@ namespace adiscope {
 		void setGatingEnabled(bool enabled);
 
 		void computeMeasurementsForChannel(unsigned int chnIdx, unsigned int sampleRate);
+		Measure* measureOfChannel(int chnIdx) const;
 
 	Q_SIGNALS:
 		void timeTriggerValueChanged(double);
@@ -139,6 +152,7 @@ namespace adiscope {
 		void canvasSizeChanged();
 		void leftGateChanged(double);
 		void rightGateChanged(double);
+		void measureJobDone(unsigned int frame);
 
 	public Q_SLOTS:
 		void setTriggerAEnabled(bool en);
@@ -154,6 +168,7 @@ namespace adiscope {
 		void setBufferSizeLabelValue(int numSamples);
 		void setSampleRatelabelValue(double sampleRate);
 		void setTriggerState(int triggerState);
+		void setTriggerStateToolTip(const QString &text);
 		void setCursorReadoutsTransparency(int value);
 		void moveCursorReadouts(CustomPlotPositionButton::ReadoutsPosition position);
 		void setHorizCursorsLocked(bool value);
@@ -165,7 +180,6 @@ namespace adiscope {
 		virtual void cleanUpJustBeforeChannelRemoval(int chnIdx);
 
 	private:
-		Measure* measureOfChannel(int chnIdx) const;
 		void updateBufferSizeSampleRateLabel(int nsamples, double sr);
 		void updateHandleAreaPadding(bool);
 		double getHorizontalCursorIntersection(double time);
@@ -175,6 +189,7 @@ namespace adiscope {
 	private Q_SLOTS:
 		void onChannelAdded(int);
 		void onNewDataReceived();
+		void onMeasureJobDone(unsigned int frame);
 
 
 		void onHbar1PixelPosChanged(int);
@@ -277,6 +292,22 @@ namespace adiscope {
 		Graticule *graticule;
 
 		bool d_trackMode;
+
+		/* Last cursor intersections, for the frame and x span they
+		 * were looked up in; a cursor move looks up both cursors,
+		 * twice */
+		struct Intersection {
+			unsigned int generation;
+			int channel;
+			int size;
+			double first, last;
+			double time;
+			double value;
+		};
+		Intersection d_intersections[2];
+		unsigned int d_intersectionNext;
+		unsigned int d_dataGeneration;
+
 		QwtPlotMarker *markerIntersection1;
 		QwtPlotMarker *markerIntersection2;
 		bool horizCursorsLocked;
@@ -289,6 +320,28 @@ namespace adiscope {
 		QwtPlotShapeItem *leftGate, *rightGate;
 		QRectF leftGateRect, rightGateRect;
 		bool d_gatingEnabled;
+
+		/*
+		 * The measurements of a frame run on d_measurePool, one job
+		 * per channel working on its own copy of the samples. Only
+		 * one frame is measured at a time; data arriving meanwhile
+		 * is measured once the current frame is in.
+		 */
+		struct MeasureJob {
+			unsigned int frame;
+			Measure *target;
+			Measure *worker;
+			QVector<double> samples;
+		};
+
+		QThreadPool d_measurePool;
+		QMutex d_measureJobsMutex;
+		QList<MeasureJob *> d_measureJobsDone;
+		unsigned int d_measureFrame;
+		int d_measureJobsPending;
+		bool d_measureDirty;
+		QElapsedTimer d_measureTimer;
+		double d_measureTime;
 	};
 }
 
@@ -61,6 +61,8 @@
 #include "dynamicWidget.hpp"
 #include "tool_launcher.hpp"
 #include "pattern_generator_api.hpp"
+#include "capture_store.h"
+#include "pulseview/pv/data/logicsegment.hpp"
 
 // Generated UI
 #include "ui_pattern_generator.h"
@@ -162,6 +164,7 @@ PatternGenerator::PatternGenerator(struct iio_context *ctx, Filter *filt,
 		dev = filt->find_device(ctx,TOOL_PATTERN_GENERATOR);
 		this->no_channels = iio_device_get_channels_count(dev);
 	}
+	stream = new PatternGeneratorStream(dev);
 
 	// UI
 	ui->setupUi(this);
@@ -311,6 +314,7 @@ PatternGenerator::~PatternGenerator()
 	if (!offline_mode) {
 		stopPatternGeneration();
 	}
+	delete stream;
 	setDynamicProperty(runButton(), "disabled", false);
 
 	for (auto var : patterns) {
@@ -902,6 +906,10 @@ bool PatternGenerator::startPatternGeneration(bool cyclic)
 	iio_device_attr_write(dev, "sampling_frequency",
 	                      std::to_string(bufman->getSampleRate()).c_str());
 
+	if (bufman->isStreaming()) {
+		return startPatternStream(cyclic);
+	}
+
 	qDebug(CAT_PATTERN_GENERATOR) << "Creating buffer";
 	txbuf = iio_device_create_buffer(dev, bufman->getBufferSize(), cyclic);
 
@@ -929,11 +937,149 @@ bool PatternGenerator::startPatternGeneration(bool cyclic)
 	return true;
 }
 
+bool PatternGenerator::startPatternStream(bool cyclic)
+{
+	auto offset = std::make_shared<size_t>(0);
+
+	// The pattern is read a chunk at a time, a cyclic one wraps around
+	auto source = [this, offset, cyclic](short *dst, size_t count) {
+		size_t filled = 0;
+
+		while (filled < count) {
+			size_t n = bufman->readBuffer(dst + filled, *offset,
+			                              count - filled);
+
+			if (n == 0) {
+				if (!cyclic || *offset == 0) {
+					break;
+				}
+
+				*offset = 0;
+				continue;
+			}
+
+			*offset += n;
+			filled += n;
+		}
+
+		return filled;
+	};
+
+	qDebug(CAT_PATTERN_GENERATOR) << "Streaming the buffer";
+	diom->lock(chm.get_enabled_mask());
+
+	if (!stream->start(PatternGeneratorBufferManager::maxCyclicBufferSize,
+	                   source)) {
+		qDebug(CAT_PATTERN_GENERATOR) << QString("Could not create buffer - errno: %1 - %2").arg(errno).arg(strerror(errno));
+		diom->unlock();
+		return false;
+	}
+
+	setPGStatus(RUNNING);
+	return true;
+}
+
+bool PatternGenerator::replayCapture(const QList<int>& channels, bool cyclic)
+{
+	auto capture = captureStore ? captureStore->logic() : nullptr;
+
+	if (offline_mode || !dev || !capture || !capture->segment ||
+	    capture->segment->unit_size() > sizeof(short)) {
+		qDebug(CAT_PATTERN_GENERATOR) << "No logic capture to replay";
+		return false;
+	}
+
+	stopPatternGeneration();
+	setPGStatus(CONFIG);
+
+	std::vector<int> mapping(16, -1);
+	uint16_t mask = 0;
+
+	for (int i = 0; i < channels.size() && i < 16; i++) {
+		if (channels[i] >= 0 && channels[i] < no_channels &&
+		    (capture->channel_mask & (1ull << i))) {
+			mapping[i] = channels[i];
+			mask |= 1 << channels[i];
+		}
+	}
+
+	for (int j = 0; j < no_channels; j++) {
+		if (mask & (1<<j)) {
+			auto ch = iio_device_find_channel(dev, channelNames[j], true);
+			iio_channel_enable(ch);
+		}
+	}
+
+	diom->setMode(chm.get_mode_mask());
+
+	uint32_t sampleRate = bufman->adjustSampleRate(capture->sample_rate);
+	if (sampleRate != (uint32_t)capture->sample_rate) {
+		qDebug(CAT_PATTERN_GENERATOR) << "Replaying at" << sampleRate <<
+			"instead of" << capture->sample_rate;
+	}
+	iio_device_attr_write(dev, "sampling_frequency",
+	                      std::to_string(sampleRate).c_str());
+
+	auto remap = std::make_shared<ChannelRemapTable>(mapping);
+	auto offset = std::make_shared<uint64_t>(0);
+	const uint64_t count = capture->segment->get_sample_count();
+	const unsigned int unit_size = capture->segment->unit_size();
+
+	// The segment is read straight into the IIO buffer and remapped there
+	auto source = [capture, remap, offset, count, unit_size, cyclic](
+	                      short *dst, size_t size) {
+		size_t filled = 0;
+
+		while (filled < size && count) {
+			if (*offset == count) {
+				if (!cyclic) {
+					break;
+				}
+				*offset = 0;
+			}
+
+			size_t n = std::min<uint64_t>(size - filled, count - *offset);
+			uint8_t *bytes = reinterpret_cast<uint8_t *>(dst + filled);
+
+			capture->segment->get_samples(bytes, *offset, *offset + n);
+
+			// One byte samples are widened from the end, in place
+			for (size_t i = n; i-- > 0;) {
+				uint16_t val = unit_size == 1 ? bytes[i] :
+					dst[filled + i];
+				dst[filled + i] = (*remap)(val);
+			}
+
+			*offset += n;
+			filled += n;
+		}
+
+		return filled;
+	};
+
+	diom->lock(mask);
+
+	size_t chunk = std::min<uint64_t>(count,
+	        PatternGeneratorBufferManager::maxCyclicBufferSize);
+
+	if (!stream->start(chunk, source)) {
+		qDebug(CAT_PATTERN_GENERATOR) << "Capture replay failed";
+		diom->unlock();
+		setPGStatus(STOPPED);
+		return false;
+	}
+
+	setPGStatus(RUNNING);
+	return true;
+}
+
 void PatternGenerator::stopPatternGeneration()
 {
 	/* Destroy buffer */
 	if (!offline_mode) {
 
+		stream->stop();
+
 		/* Reset Tx Channls*/
 		diom->unlock();
 
@@ -31,6 +31,7 @@
 #include "pg_patterns.hpp"
 #include "pg_channel_manager.hpp"
 #include "pg_buffer_manager.hpp"
+#include "pg_stream.hpp"
 #include "tool.hpp"
 #include "scroll_filter.hpp"
 
@@ -105,6 +106,13 @@ public:
 	bool getUseDecoders() const;
 	void setUseDecoders(bool use_decoders);
 
+	/*
+	 * Plays the last Logic Analyzer capture, LA channel i on the output
+	 * channels[i] (-1 or missing to leave it out), at the capture sample
+	 * rate. The capture is read a chunk at a time as it is pushed.
+	 */
+	bool replayCapture(const QList<int>& channels, bool cyclic);
+
 private Q_SLOTS:
 
 	void generatePattern();
@@ -172,8 +180,10 @@ private:
 	struct iio_device *dev;
 	struct iio_buffer *txbuf;
 	DIOManager *diom;
+	PatternGeneratorStream *stream;
 
 	bool startPatternGeneration(bool cyclic);
+	bool startPatternStream(bool cyclic);
 	void stopPatternGeneration();
 	void toggleRightMenu(QPushButton *btn);
 
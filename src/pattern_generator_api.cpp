@@ -32,6 +32,11 @@ void PatternGenerator_API::show()
 	Q_EMIT pg->showTool();
 }
 
+bool PatternGenerator_API::replay_capture(QList<int> channels, bool cyclic)
+{
+	return pg->replayCapture(channels, cyclic);
+}
+
 void PatternGenerator_API::refreshApi()
 {
 	PatternGeneratorChannelManagerUI *chmui = pg->chmui;
@@ -234,4 +239,15 @@ void PatternGenerator_API::setInactiveHidden(bool en)
 	else
 		pg->chmui->hideDisabled();
 }
+
+bool PatternGenerator_API::streaming() const
+{
+	return pg->bufman->streamingEnabled();
+}
+
+void PatternGenerator_API::setStreaming(bool en)
+{
+	pg->bufman->enableStreaming(en);
+	pg->bufui->updateUi();
+}
 }
@@ -181,6 +181,7 @@ class PatternGenerator_API : public ApiObject
 	Q_PROPERTY(bool running READ running WRITE run STORED false);
 	Q_PROPERTY(bool single READ single WRITE run_single STORED false);
 	Q_PROPERTY(bool inactive_hidden READ inactiveHidden WRITE setInactiveHidden);
+	Q_PROPERTY(bool streaming READ streaming WRITE setStreaming);
 
 public:
 	explicit PatternGenerator_API(PatternGenerator *pg) :
@@ -204,8 +205,11 @@ public:
 	void run_single(bool en);
 	bool inactiveHidden();
 	void setInactiveHidden(bool);
+	bool streaming() const;
+	void setStreaming(bool en);
 
 	Q_INVOKABLE void show();
+	Q_INVOKABLE bool replay_capture(QList<int> channels, bool cyclic = false);
 
 private:
 	void refreshApi();
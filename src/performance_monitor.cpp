@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "performance_monitor.hpp"
+#include "iio_manager.hpp"
+#include "memory_budget.hpp"
+
+#include <QApplication>
+#include <QEvent>
+#include <QHeaderView>
+#include <QSet>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include <algorithm>
+
+using namespace adiscope;
+
+const int PerformanceMonitor::ProbeInterval = 50;
+
+namespace adiscope {
+
+/* The snapshot of the monitor as a tree, refreshed after each sample;
+ * the items keep their place so the expanded ones stay expanded */
+class PerformancePanel : public QWidget
+{
+public:
+	explicit PerformancePanel(PerformanceMonitor *monitor) :
+		QWidget(nullptr, Qt::Tool)
+	{
+		setAttribute(Qt::WA_DeleteOnClose);
+		setWindowTitle(QObject::tr("Performance"));
+		resize(480, 600);
+
+		tree = new QTreeWidget(this);
+		tree->setColumnCount(2);
+		tree->setHeaderLabels(QStringList() << QObject::tr("Counter")
+				      << QObject::tr("Value"));
+		tree->header()->setSectionResizeMode(0,
+				QHeaderView::ResizeToContents);
+
+		QVBoxLayout *layout = new QVBoxLayout(this);
+		layout->setContentsMargins(0, 0, 0, 0);
+		layout->addWidget(tree);
+
+		QObject::connect(monitor, &PerformanceMonitor::updated,
+				 this, [=]() { refresh(monitor->snapshot()); });
+		refresh(monitor->snapshot());
+	}
+
+private:
+	QTreeWidget *tree;
+	QHash<QString, QTreeWidgetItem *> items;
+
+	void refresh(const QVariantMap& snapshot)
+	{
+		QSet<QString> shown;
+
+		fill(nullptr, QString(), snapshot, shown);
+
+		for (const QString& key : items.keys()) {
+			if (shown.contains(key) || !items.contains(key))
+				continue;
+
+			/* The children go with their parent */
+			delete items.value(key);
+			for (auto it = items.begin(); it != items.end();) {
+				if (it.key() == key ||
+				    it.key().startsWith(key + "/"))
+					it = items.erase(it);
+				else
+					++it;
+			}
+		}
+	}
+
+	void fill(QTreeWidgetItem *parent, const QString& path,
+		  const QVariantMap& map, QSet<QString>& shown)
+	{
+		for (auto it = map.cbegin(); it != map.cend(); ++it) {
+			const QString key = path + "/" + it.key();
+			QTreeWidgetItem *item = items.value(key);
+
+			if (!item) {
+				item = parent ? new QTreeWidgetItem(parent) :
+					new QTreeWidgetItem(tree);
+				item->setText(0, it.key());
+				item->setExpanded(!parent);
+				items.insert(key, item);
+			}
+			shown.insert(key);
+
+			if (it.value().type() == QVariant::Map)
+				fill(item, key, it.value().toMap(), shown);
+			else
+				item->setText(1, QString::number(
+					it.value().toDouble(), 'g', 4));
+		}
+	}
+};
+}
+
+PerformanceMonitor::PerformanceMonitor(QObject *parent) :
+	QObject(parent),
+	enabled(false),
+	probe_late_max(0),
+	probe_late_sum(0),
+	probe_count(0)
+{
+	sample_timer.setInterval(1000);
+	connect(&sample_timer, &QTimer::timeout,
+		this, &PerformanceMonitor::sample);
+
+	probe_timer.setInterval(ProbeInterval);
+	connect(&probe_timer, &QTimer::timeout,
+		this, &PerformanceMonitor::probeEventLoop);
+}
+
+PerformanceMonitor *PerformanceMonitor::instance()
+{
+	/* Goes away with the application, after the tools */
+	static PerformanceMonitor *monitor = new PerformanceMonitor(qApp);
+
+	return monitor;
+}
+
+void PerformanceMonitor::_add(QObject *owner, const QString& group,
+			      const QString& name, bool rate, Value value)
+{
+	Counter counter = { owner, group, name, rate, value, value() };
+
+	/* The first counter of an owner ties them all to it */
+	if (std::none_of(counters.cbegin(), counters.cend(),
+			 [=](const Counter& c) { return c.owner == owner; }))
+		connect(owner, &QObject::destroyed,
+			this, &PerformanceMonitor::removeOwner);
+
+	counters.push_back(counter);
+}
+
+void PerformanceMonitor::addRate(QObject *owner, const QString& group,
+				 const QString& name, Value value)
+{
+	_add(owner, group, name, true, value);
+}
+
+void PerformanceMonitor::addGauge(QObject *owner, const QString& group,
+				  const QString& name, Value value)
+{
+	_add(owner, group, name, false, value);
+}
+
+void PerformanceMonitor::addPaintRate(QWidget *widget, const QString& group,
+				      const QString& name)
+{
+	paints.insert(widget, 0);
+	widget->installEventFilter(this);
+
+	_add(widget, group, name, true, [=]() {
+		return (double)paints.value(widget);
+	});
+}
+
+void PerformanceMonitor::removeOwner(QObject *owner)
+{
+	counters.erase(std::remove_if(counters.begin(), counters.end(),
+			[=](const Counter& c) { return c.owner == owner; }),
+			counters.end());
+	paints.remove(owner);
+}
+
+bool PerformanceMonitor::eventFilter(QObject *watched, QEvent *event)
+{
+	if (event->type() == QEvent::Paint) {
+		auto it = paints.find(watched);
+		if (it != paints.end())
+			++it.value();
+	}
+
+	return QObject::eventFilter(watched, event);
+}
+
+void PerformanceMonitor::setEnabled(bool en)
+{
+	enabled = en;
+	_updateRunning();
+}
+
+bool PerformanceMonitor::isEnabled() const
+{
+	return enabled;
+}
+
+void PerformanceMonitor::showPanel()
+{
+	if (!panel) {
+		panel = new PerformancePanel(this);
+		connect(panel.data(), &QObject::destroyed,
+			this, [=]() { _updateRunning(); });
+	}
+
+	panel->show();
+	panel->raise();
+	_updateRunning();
+}
+
+void PerformanceMonitor::_updateRunning()
+{
+	bool run = enabled || panel;
+
+	if (run == sample_timer.isActive())
+		return;
+
+	if (run) {
+		/* The rates start from the values of now */
+		for (Counter& c : counters)
+			c.last = c.value();
+		_sampleBlocks(0);
+
+		probe_late_max = probe_late_sum = 0;
+		probe_count = 0;
+		sample_clock.start();
+		probe_clock.start();
+		sample_timer.start();
+		probe_timer.start();
+	} else {
+		sample_timer.stop();
+		probe_timer.stop();
+		block_items.clear();
+	}
+}
+
+void PerformanceMonitor::probeEventLoop()
+{
+	double late = probe_clock.restart() - ProbeInterval;
+
+	late = std::max(late, 0.0);
+	probe_late_max = std::max(probe_late_max, late);
+	probe_late_sum += late;
+	probe_count++;
+}
+
+QVariantMap PerformanceMonitor::_sampleBlocks(double dt)
+{
+	QVariantMap devices;
+
+	for (const auto& manager : iio_manager::instances()) {
+		const QString device = QString::fromStdString(
+				manager->device_name());
+		QVariantMap blocks;
+
+		for (const auto& s : manager->get_block_stats()) {
+			const QString name = QString::fromStdString(s.name);
+			const QString key = device + "/" + name;
+			const double items = (double)s.items;
+			const double prev = block_items.value(key, items);
+			QVariantMap block;
+
+			block["work_avg_us"] = s.work_avg_us;
+			block["input_full"] = s.input_full;
+			block["output_full"] = s.output_full;
+			/* A restarted flowgraph counts from zero again */
+			block["items_per_s"] = dt > 0 && items >= prev ?
+				(items - prev) / dt : 0.0;
+
+			block_items[key] = items;
+			blocks[name] = block;
+		}
+
+		devices[device] = blocks;
+	}
+
+	return devices;
+}
+
+void PerformanceMonitor::sample()
+{
+	const double dt = sample_clock.restart() * 1e-3;
+	QVariantMap snapshot;
+
+	for (Counter& c : counters) {
+		const double value = c.value();
+		QVariantMap group = snapshot.value(c.group).toMap();
+
+		if (c.rate)
+			group[c.name] = dt > 0 && value >= c.last ?
+				(value - c.last) / dt : 0.0;
+		else
+			group[c.name] = value;
+
+		c.last = value;
+		snapshot[c.group] = group;
+	}
+
+	snapshot["blocks"] = _sampleBlocks(dt);
+
+	QVariantMap gui;
+	gui["event_late_max_ms"] = probe_late_max;
+	gui["event_late_avg_ms"] = probe_count ?
+		probe_late_sum / probe_count : 0.0;
+	snapshot["gui"] = gui;
+	snapshot["memory"] = MemoryBudget::instance()->usage();
+
+	probe_late_max = probe_late_sum = 0;
+	probe_count = 0;
+
+	last = snapshot;
+	Q_EMIT updated();
+}
+
+QVariantMap PerformanceMonitor::snapshot() const
+{
+	return last;
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERFORMANCE_MONITOR_HPP
+#define PERFORMANCE_MONITOR_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QTimer>
+#include <QVariantMap>
+
+#include <functional>
+#include <vector>
+
+class QWidget;
+
+namespace adiscope {
+
+class PerformancePanel;
+
+/*
+ * Gathers once a second what tells where an acquisition bogs down: the
+ * GNU Radio counters of the blocks of every device flowgraph, the
+ * counters the tools register (sink frames, plot paints, measurement
+ * time) and how late the GUI thread serves its events.
+ *
+ * The block counters stay at zero unless the GNU Radio configuration
+ * enables them ([PerfCounters] on = True). Qt does not tell how many
+ * events are queued, the lateness of a periodic timer stands for it.
+ *
+ * Nothing is sampled until the panel or the API enables the monitor.
+ */
+class PerformanceMonitor : public QObject
+{
+	Q_OBJECT
+
+public:
+	typedef std::function<double()> Value;
+
+	static PerformanceMonitor *instance();
+
+	/* A counter of the tool group shown as how much it grew per
+	 * second; it is removed with owner */
+	void addRate(QObject *owner, const QString& group,
+		     const QString& name, Value value);
+
+	/* A value of the tool group shown as it is */
+	void addGauge(QObject *owner, const QString& group,
+		      const QString& name, Value value);
+
+	/* The paint events of widget per second */
+	void addPaintRate(QWidget *widget, const QString& group,
+			  const QString& name);
+
+	void setEnabled(bool en);
+	bool isEnabled() const;
+
+	/* The values of the last second: a map of counter names to
+	 * values per tool group, one map per block under "blocks" for
+	 * each device, the GUI thread under "gui" and the bytes of the
+	 * tool buffers under "memory" (see MemoryBudget) */
+	QVariantMap snapshot() const;
+
+	void showPanel();
+
+Q_SIGNALS:
+	void updated();
+
+protected:
+	bool eventFilter(QObject *watched, QEvent *event);
+
+private Q_SLOTS:
+	void sample();
+	void probeEventLoop();
+	void removeOwner(QObject *owner);
+
+private:
+	struct Counter {
+		QObject *owner;
+		QString group;
+		QString name;
+		bool rate;
+		Value value;
+		double last;
+	};
+
+	explicit PerformanceMonitor(QObject *parent = nullptr);
+
+	void _add(QObject *owner, const QString& group, const QString& name,
+		  bool rate, Value value);
+	void _updateRunning();
+	QVariantMap _sampleBlocks(double dt);
+
+	std::vector<Counter> counters;
+	QHash<QObject *, quint64> paints;
+	QHash<QString, double> block_items;
+
+	bool enabled;
+	QPointer<PerformancePanel> panel;
+
+	QTimer sample_timer;
+	QElapsedTimer sample_clock;
+
+	/* The probe runs every ProbeInterval ms, what it is late by is
+	 * the time the GUI thread was busy with something else */
+	static const int ProbeInterval;
+	QTimer probe_timer;
+	QElapsedTimer probe_clock;
+	double probe_late_max;
+	double probe_late_sum;
+	unsigned int probe_count;
+
+	QVariantMap last;
+};
+}
+
+#endif /* PERFORMANCE_MONITOR_HPP */
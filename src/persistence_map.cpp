@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "persistence_map.h"
+
+#include <QImage>
+#include <qwt_scale_map.h>
+
+#include <algorithm>
+#include <cmath>
+
+using namespace adiscope;
+
+PersistenceMap::PersistenceMap(unsigned int columns, unsigned int rows) :
+	d_columns(columns),
+	d_rows(rows),
+	d_min(-1.0),
+	d_max(1.0),
+	d_col_min(-1.0),
+	d_col_max(1.0),
+	d_counts((size_t)columns * rows, 0),
+	d_max_count(0),
+	d_frames(0)
+{
+}
+
+void PersistenceMap::setRange(double min, double max)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_min = min;
+	d_max = max;
+	std::fill(d_counts.begin(), d_counts.end(), 0);
+	d_max_count = 0;
+	d_frames = 0;
+}
+
+double PersistenceMap::rangeMin() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_min;
+}
+
+double PersistenceMap::rangeMax() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_max;
+}
+
+void PersistenceMap::setColumnRange(double min, double max)
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	d_col_min = min;
+	d_col_max = max;
+	std::fill(d_counts.begin(), d_counts.end(), 0);
+	d_max_count = 0;
+	d_frames = 0;
+}
+
+double PersistenceMap::columnRangeMin() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_col_min;
+}
+
+double PersistenceMap::columnRangeMax() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_col_max;
+}
+
+void PersistenceMap::clear()
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	std::fill(d_counts.begin(), d_counts.end(), 0);
+	d_max_count = 0;
+	d_frames = 0;
+}
+
+void PersistenceMap::accumulate(const float *samples, size_t count)
+{
+	if (!count) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (d_max <= d_min) {
+		return;
+	}
+
+	/* First the bin of every sample, in a plain loop over the samples
+	 * that the compiler can vectorize; -1 marks the out of range ones.
+	 * Then the increments, which can't be vectorized. */
+	d_bins.resize(count);
+
+	const float offset = d_min;
+	const float row_scale = d_rows / (d_max - d_min);
+	const float col_scale = (float)d_columns / count;
+	const int rows = d_rows;
+	const int columns = d_columns;
+	int *bins = d_bins.data();
+
+	for (size_t i = 0; i < count; i++) {
+		int row = (int)std::floor((samples[i] - offset) * row_scale);
+		int col = std::min((int)(i * col_scale), columns - 1);
+
+		bins[i] = (row >= 0 && row < rows) ? row * columns + col : -1;
+	}
+
+	_count_bins(count);
+}
+
+void PersistenceMap::accumulateFolded(const float *samples, size_t count,
+		double ui, double phase)
+{
+	if (!count || !(ui > 0.0)) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (d_max <= d_min) {
+		return;
+	}
+
+	d_bins.resize(count);
+
+	const float offset = d_min;
+	const float row_scale = d_rows / (d_max - d_min);
+	const int rows = d_rows;
+	const int columns = d_columns;
+	int *bins = d_bins.data();
+
+	/* Kept in double, a float position would lose the sub-sample
+	 * phase after a few million samples */
+	const double inv_span = 1.0 / (2.0 * ui);
+	const double start = 0.25 - phase * inv_span;
+
+	for (size_t i = 0; i < count; i++) {
+		int row = (int)std::floor((samples[i] - offset) * row_scale);
+		double x = start + i * inv_span;
+		x -= std::floor(x);
+		int col = std::min((int)(x * columns), columns - 1);
+
+		bins[i] = (row >= 0 && row < rows) ? row * columns + col : -1;
+	}
+
+	_count_bins(count);
+}
+
+void PersistenceMap::accumulateXY(const float *x, const float *y,
+		size_t count, bool restart)
+{
+	_accumulate_xy(x, y, count, restart);
+}
+
+void PersistenceMap::accumulateXY(const double *x, const double *y,
+		size_t count, bool restart)
+{
+	_accumulate_xy(x, y, count, restart);
+}
+
+template <typename T>
+void PersistenceMap::_accumulate_xy(const T *x, const T *y, size_t count,
+		bool restart)
+{
+	if (!count) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	if (d_max <= d_min || d_col_max <= d_col_min) {
+		return;
+	}
+
+	d_bins.resize(count);
+
+	const T row_offset = d_min;
+	const T row_scale = d_rows / (d_max - d_min);
+	const T col_offset = d_col_min;
+	const T col_scale = d_columns / (d_col_max - d_col_min);
+	const int rows = d_rows;
+	const int columns = d_columns;
+	int *bins = d_bins.data();
+
+	for (size_t i = 0; i < count; i++) {
+		int row = (int)std::floor((y[i] - row_offset) * row_scale);
+		int col = (int)std::floor((x[i] - col_offset) * col_scale);
+
+		bins[i] = (row >= 0 && row < rows && col >= 0 && col < columns)
+				? row * columns + col : -1;
+	}
+
+	if (restart) {
+		std::fill(d_counts.begin(), d_counts.end(), 0);
+		d_max_count = 0;
+		d_frames = 0;
+	}
+
+	_count_bins(count);
+}
+
+void PersistenceMap::_count_bins(size_t count)
+{
+	const int *bins = d_bins.data();
+	uint32_t *counts = d_counts.data();
+	uint32_t max_count = d_max_count;
+
+	for (size_t i = 0; i < count; i++) {
+		if (bins[i] >= 0) {
+			max_count = std::max(max_count, ++counts[bins[i]]);
+		}
+	}
+
+	d_max_count = max_count;
+	d_frames++;
+}
+
+uint32_t PersistenceMap::snapshot(std::vector<uint32_t> &counts) const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+
+	counts = d_counts;
+	return d_max_count;
+}
+
+uint64_t PersistenceMap::frames() const
+{
+	std::unique_lock<std::mutex> lock(d_mutex);
+	return d_frames;
+}
+
+/***************************************************************************/
+
+PersistencePlotItem::PersistencePlotItem(
+		const std::shared_ptr<PersistenceMap> &map,
+		const QColor &color) :
+	QwtPlotRasterItem(QString("Persistence")),
+	d_map(map),
+	d_color(color),
+	d_start(0.0),
+	d_end(1.0)
+{
+	setItemAttribute(QwtPlotItem::AutoScale, false);
+	setItemAttribute(QwtPlotItem::Legend, false);
+	setZ(0);
+}
+
+void PersistencePlotItem::setColor(const QColor &color)
+{
+	d_color = color;
+	itemChanged();
+}
+
+void PersistencePlotItem::setTimeRange(double start, double end)
+{
+	d_start = start;
+	d_end = end;
+}
+
+QImage PersistencePlotItem::image(const QSize &size) const
+{
+	double min = d_map->rangeMin(), max = d_map->rangeMax();
+
+	return renderImage(QwtScaleMap(), QwtScaleMap(),
+			QRectF(d_start, min, d_end - d_start, max - min), size);
+}
+
+QwtInterval PersistencePlotItem::interval(Qt::Axis axis) const
+{
+	switch (axis) {
+	case Qt::XAxis:
+		return QwtInterval(d_start, d_end);
+	case Qt::YAxis:
+		return QwtInterval(d_map->rangeMin(), d_map->rangeMax());
+	default:
+		return QwtInterval();
+	}
+}
+
+QImage PersistencePlotItem::renderImage(const QwtScaleMap &xMap,
+		const QwtScaleMap &yMap, const QRectF &area,
+		const QSize &imageSize) const
+{
+	Q_UNUSED(xMap);
+	Q_UNUSED(yMap);
+
+	QImage image(imageSize, QImage::Format_ARGB32);
+	image.fill(Qt::transparent);
+
+	std::vector<uint32_t> counts;
+	uint32_t max_count = d_map->snapshot(counts);
+	double min = d_map->rangeMin(), max = d_map->rangeMax();
+
+	if (!max_count || d_end <= d_start || max <= min
+			|| imageSize.isEmpty()) {
+		return image;
+	}
+
+	const int columns = d_map->columns();
+	const int rows = d_map->rows();
+	const double log_max = std::log1p((double)max_count);
+	const int w = imageSize.width(), h = imageSize.height();
+
+	/* Column of the map under each column of the image */
+	std::vector<int> map_col(w);
+	for (int px = 0; px < w; px++) {
+		double x = area.left() + (px + 0.5) * area.width() / w;
+		map_col[px] = (int)std::floor((x - d_start) /
+				(d_end - d_start) * columns);
+	}
+
+	/* The top row of the image is the highest value */
+	for (int py = 0; py < h; py++) {
+		double y = area.bottom() - (py + 0.5) * area.height() / h;
+		int row = (int)std::floor((y - min) / (max - min) * rows);
+
+		if (row < 0 || row >= rows) {
+			continue;
+		}
+
+		const uint32_t *line = &counts[(size_t)row * columns];
+		QRgb *pixels = reinterpret_cast<QRgb *>(image.scanLine(py));
+
+		for (int px = 0; px < w; px++) {
+			int col = map_col[px];
+
+			if (col < 0 || col >= columns || !line[col]) {
+				continue;
+			}
+
+			int alpha = (int)(255.0 * std::log1p((double)line[col])
+					/ log_max);
+			pixels[px] = qRgba(d_color.red(), d_color.green(),
+					d_color.blue(), std::max(alpha, 24));
+		}
+	}
+
+	return image;
+}
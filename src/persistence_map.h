@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PERSISTENCE_MAP_H
+#define PERSISTENCE_MAP_H
+
+#include <QColor>
+#include <qwt_plot_rasteritem.h>
+
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Hit counts of the samples of one channel, accumulated over many
+ * frames (digital phosphor style persistence). The columns split a frame
+ * in equal slices of samples, the rows split [min, max] in equal value
+ * steps; samples outside of the range are not counted.
+ *
+ * As an XY density map, the columns split [column min, column max] of
+ * the x values instead, each point counting in the bin of its x and y.
+ *
+ * The sink accumulates every complete frame from the acquisition thread,
+ * including the ones that never get plotted, and the plot reads it from
+ * the GUI thread when painting.
+ */
+class PersistenceMap
+{
+public:
+	PersistenceMap(unsigned int columns = 1024, unsigned int rows = 512);
+
+	/* Changing the range starts over */
+	void setRange(double min, double max);
+	double rangeMin() const;
+	double rangeMax() const;
+
+	/* Range of the x values of an XY density map, changing it starts
+	 * over */
+	void setColumnRange(double min, double max);
+	double columnRangeMin() const;
+	double columnRangeMax() const;
+
+	void clear();
+	void accumulate(const float *samples, size_t count);
+
+	/* Eye diagram: the columns span two unit intervals of ui samples
+	 * instead of the frame, with the edges of the frame at phase +
+	 * k * ui landing at a quarter and three quarters of the width */
+	void accumulateFolded(const float *samples, size_t count,
+			double ui, double phase);
+
+	/* XY density: counts the points (x[i], y[i]); with restart the
+	 * previous counts get dropped first, without the plot ever
+	 * seeing the map empty in between */
+	void accumulateXY(const float *x, const float *y, size_t count,
+			bool restart = false);
+	void accumulateXY(const double *x, const double *y, size_t count,
+			bool restart = false);
+
+	/* Copy of the counts, row by row (row 0 is min), returns the
+	 * highest count */
+	uint32_t snapshot(std::vector<uint32_t> &counts) const;
+
+	unsigned int columns() const { return d_columns; }
+	unsigned int rows() const { return d_rows; }
+	uint64_t frames() const;
+
+private:
+	mutable std::mutex d_mutex;
+	unsigned int d_columns, d_rows;
+	double d_min, d_max;
+	double d_col_min, d_col_max;
+	std::vector<uint32_t> d_counts;
+	uint32_t d_max_count;
+	uint64_t d_frames;
+
+	/* Scratch space of accumulate() */
+	std::vector<int> d_bins;
+
+	/* Adds the bins of d_bins, d_mutex being held */
+	void _count_bins(size_t count);
+
+	template <typename T>
+	void _accumulate_xy(const T *x, const T *y, size_t count,
+			bool restart);
+};
+
+/*
+ * Draws a PersistenceMap as an image in the color of its channel, the
+ * intensity growing with the logarithm of the hit count.
+ */
+class PersistencePlotItem : public QwtPlotRasterItem
+{
+public:
+	PersistencePlotItem(const std::shared_ptr<PersistenceMap> &map,
+			const QColor &color);
+
+	void setColor(const QColor &color);
+
+	/* Plot coordinates of the first and past the last sample of a frame */
+	void setTimeRange(double start, double end);
+
+	const std::shared_ptr<PersistenceMap> &map() const { return d_map; }
+
+	virtual QwtInterval interval(Qt::Axis axis) const;
+
+	/* The whole map, for saving it on its own */
+	QImage image(const QSize &size) const;
+
+protected:
+	virtual QImage renderImage(const QwtScaleMap &xMap,
+			const QwtScaleMap &yMap, const QRectF &area,
+			const QSize &imageSize) const;
+
+private:
+	std::shared_ptr<PersistenceMap> d_map;
+	QColor d_color;
+	double d_start, d_end;
+};
+}
+
+#endif // PERSISTENCE_MAP_H
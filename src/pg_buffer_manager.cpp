@@ -19,28 +19,48 @@
  */
 #include "pg_buffer_manager.hpp"
 #include "pattern_generator.hpp"
+#include "capture_buffer_pool.hpp"
+#include "pulseview/pv/data/logic.hpp"
+#include "pulseview/pv/data/logicsegment.hpp"
+
+#include <QJsonDocument>
+
+#include <algorithm>
 
 namespace adiscope {
 
+const uint32_t PatternGeneratorBufferManager::maxCyclicBufferSize = 1048576;
+const uint32_t PatternGeneratorBufferManager::maxStreamBufferSize = 16 * 1048576;
+
 PatternGeneratorBufferManager::PatternGeneratorBufferManager(
         PatternGeneratorChannelManager *chman) : chm(chman)
 {
 	autoSet = true;
 	bufferSize = 1;
-	buffer = new short[bufferSize];
+	buffer = allocateBuffer(bufferSize);
 	sampleRate = 1;
 	start_sample = 0;
 	last_sample = 1;
 	buffer_created = 0;
+	generated_mask = 0;
+	streaming = false;
 }
 
 PatternGeneratorBufferManager::~PatternGeneratorBufferManager()
 {
-	delete[] buffer;
+	CaptureBufferPool::getInstance().release(buffer);
+}
+
+short *PatternGeneratorBufferManager::allocateBuffer(uint32_t size)
+{
+	/* Cleared when the patterns are generated again */
+	return static_cast<short *>(CaptureBufferPool::getInstance()
+			.allocate(size * sizeof(short), false));
 }
 
 void PatternGeneratorBufferManager::update(PatternGeneratorChannelGroup *chg)
 {
+	std::lock_guard<std::mutex> lock(bufferLock);
 	bool sampleRateChanged = false;
 
 	chm->preGenerate();
@@ -69,18 +89,73 @@ void PatternGeneratorBufferManager::update(PatternGeneratorChannelGroup *chg)
 
 	if (bufferSizeChanged) {
 		// recreate local buffer
-		delete[] buffer;
-		buffer = new short[bufferSize];
+		CaptureBufferPool::getInstance().release(buffer);
+		buffer = allocateBuffer(bufferSize);
 	}
 
-	memset(buffer, 0x0000, (bufferSize)*sizeof(short));
-	chm->generatePatterns(buffer, sampleRate, bufferSize);
-
-	if (sampleRateChanged || bufferSizeChanged) {
+	if (sampleRateChanged || bufferSizeChanged || !buffer_created) {
 		// regenerate all
-	} else {
-		// only generate current ?
+		memset(buffer, 0x0000, (bufferSize)*sizeof(short));
+		generated.clear();
+		generated_mask = 0;
+		buffer_created = true;
+	}
+
+	std::map<PatternGeneratorChannelGroup *, QString> keys;
+	std::vector<PatternGeneratorChannelGroup *> changed;
+	uint16_t mask = 0;
+
+	for (auto&& group : *chm->get_channel_groups()) {
+		PatternGeneratorChannelGroup *pgchg =
+		        static_cast<PatternGeneratorChannelGroup *>(group);
+
+		if (!pgchg->is_enabled()) {
+			continue;
+		}
+
+		QString key = groupKey(pgchg);
+		auto it = generated.find(pgchg);
+
+		keys[pgchg] = key;
+		mask |= pgchg->get_mask();
+
+		// only generate the groups that changed
+		if (pgchg == chg || key.isEmpty() || it == generated.end() ||
+		    it->second != key) {
+			changed.push_back(pgchg);
+		}
+	}
+
+	chm->generatePatterns(changed, buffer, sampleRate, bufferSize);
+
+	// the channels no group generates any more go low
+	if (generated_mask & ~mask) {
+		for (uint32_t i = 0; i < bufferSize; i++) {
+			buffer[i] &= mask;
+		}
 	}
+
+	generated.swap(keys);
+	generated_mask = mask;
+}
+
+QString PatternGeneratorBufferManager::groupKey(PatternGeneratorChannelGroup
+                *chg)
+{
+	QJsonObject pattern = Pattern_API::toJson(chg->pattern).toObject();
+
+	// Nothing tells when these changed, they are always generated again
+	if (pattern["name"].toString() == "none") {
+		return QString();
+	}
+
+	QString key = QJsonDocument(pattern).toJson(QJsonDocument::Compact);
+
+	for (int i = 0; i < chg->get_channel_count(); i++) {
+		key += QString(" %1").arg(chg->get_channel(i)->get_id());
+	}
+
+	return key;
 }
 
 void PatternGeneratorBufferManager::enableAutoSet(bool val)
@@ -105,13 +180,48 @@ uint32_t PatternGeneratorBufferManager::adjustSampleRate(
 uint32_t PatternGeneratorBufferManager::adjustBufferSize(
         uint32_t suggestedBufferSize)
 {
-	if (suggestedBufferSize>1048576) {
-		suggestedBufferSize = 1048576;
+	uint32_t maxBufferSize = streaming ? maxStreamBufferSize :
+	                         maxCyclicBufferSize;
+
+	if (suggestedBufferSize>maxBufferSize) {
+		suggestedBufferSize = maxBufferSize;
 	}
 
 	return suggestedBufferSize;
 }
 
+void PatternGeneratorBufferManager::enableStreaming(bool en)
+{
+	streaming = en;
+	// the non periodic patterns may then go past the cyclic buffer
+	chm->setMaxBufferSize(en ? maxStreamBufferSize : 1000000);
+}
+
+bool PatternGeneratorBufferManager::streamingEnabled() const
+{
+	return streaming;
+}
+
+bool PatternGeneratorBufferManager::isStreaming() const
+{
+	return bufferSize > maxCyclicBufferSize;
+}
+
+size_t PatternGeneratorBufferManager::readBuffer(short *dst, size_t offset,
+                size_t count)
+{
+	std::lock_guard<std::mutex> lock(bufferLock);
+
+	if (offset >= bufferSize) {
+		return 0;
+	}
+
+	count = std::min<size_t>(count, bufferSize - offset);
+	memcpy(dst, buffer + offset, count * sizeof(short));
+
+	return count;
+}
+
 uint32_t PatternGeneratorBufferManager::getSampleRate()
 {
 	return sampleRate;
@@ -135,7 +245,8 @@ void PatternGeneratorBufferManager::setBufferSize(uint32_t val)
 PatternGeneratorBufferManagerUi::PatternGeneratorBufferManagerUi(
         QWidget *parent, PatternGeneratorBufferManager *bufmanager,
         QWidget *settingsWidget, PatternGenerator *pg) : QWidget(parent),
-	settingsWidget(settingsWidget), bufman(bufmanager) , pg(pg)
+	settingsWidget(settingsWidget), bufman(bufmanager) , pg(pg),
+	shownSampleRate(0)
 {
 	//sigrok and sigrokdecode initialisation
 	context = sigrok::Context::create();
@@ -157,7 +268,10 @@ PatternGeneratorBufferManagerUi::PatternGeneratorBufferManagerUi(
 void PatternGeneratorBufferManagerUi::updateUi()
 {
 	bufman->update();
-	reloadPVDevice();
+
+	if (!updatePVSamples()) {
+		reloadPVDevice();
+	}
 
 	auto scale = (1/(double)bufman->getSampleRate()) * bufman->getBufferSize() /
 	             (double)main_win->view_->divisionCount();
@@ -195,6 +309,59 @@ void PatternGeneratorBufferManagerUi::reloadPVDevice()
 	pattern_generator_ptr->data_ = bufman->buffer;
 	pattern_generator_ptr->open();
 	main_win->run_stop();
+
+	shown.assign(bufman->buffer, bufman->buffer + bufman->bufferSize);
+	shownSampleRate = bufman->getSampleRate();
+}
+
+bool PatternGeneratorBufferManagerUi::updatePVSamples()
+{
+	const uint32_t size = bufman->bufferSize;
+
+	if (shown.size() != size || shownSampleRate != bufman->getSampleRate() ||
+	    main_win->session_.get_capture_state() != pv::Session::Stopped) {
+		return false;
+	}
+
+	std::shared_ptr<pv::data::Logic> logic =
+	        main_win->session_.get_logic_data();
+
+	if (!logic || logic->logic_segments().empty()) {
+		return false;
+	}
+
+	std::shared_ptr<pv::data::LogicSegment> segment =
+	        logic->logic_segments().front();
+
+	if (segment->is_compressed() || segment->unit_size() != sizeof(short) ||
+	    segment->get_sample_count() != size) {
+		return false;
+	}
+
+	// only the range between the first and the last changed sample
+	// is written to the segment
+	const short *buffer = bufman->buffer;
+	uint32_t first = 0;
+
+	while (first < size && buffer[first] == shown[first]) {
+		first++;
+	}
+
+	if (first == size) {
+		return true;
+	}
+
+	uint32_t last = size - 1;
+
+	while (buffer[last] == shown[last]) {
+		last--;
+	}
+
+	segment->rewrite_payload(first, buffer + first, last - first + 1);
+	std::copy(buffer + first, buffer + last + 1, shown.begin() + first);
+	Q_EMIT main_win->session_.data_received();
+
+	return true;
 }
 
 }
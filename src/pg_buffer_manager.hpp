@@ -24,6 +24,8 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <vector>
+#include <map>
+#include <mutex>
 #include <string.h>
 
 #include <iio.h>
@@ -70,6 +72,18 @@ class PatternGeneratorBufferManager
 	uint32_t sampleRate;
 	PatternGeneratorChannelManager *chm;
 
+	/* What each group in the buffer was generated from, a group whose
+	 * key did not change keeps its bits */
+	std::map<PatternGeneratorChannelGroup *, QString> generated;
+	uint16_t generated_mask;
+	QString groupKey(PatternGeneratorChannelGroup *chg);
+
+	bool streaming;
+	std::mutex bufferLock;
+
+	/* From the capture buffer pool, kept for the next pattern */
+	static short *allocateBuffer(uint32_t size);
+
 public:
 	PatternGeneratorBufferManager(PatternGeneratorChannelManager *chman);
 	~PatternGeneratorBufferManager();
@@ -83,6 +97,18 @@ public:
 	uint32_t getSampleRate();
 	uint32_t getBufferSize();
 
+	/* A buffer longer than maxCyclicBufferSize can be generated, it is
+	 * then streamed instead of pushed once */
+	static const uint32_t maxCyclicBufferSize;
+	static const uint32_t maxStreamBufferSize;
+	void enableStreaming(bool en);
+	bool streamingEnabled() const;
+	bool isStreaming() const;
+
+	/* Copies up to count samples from offset, safe against a
+	 * regeneration running meanwhile */
+	size_t readBuffer(short *dst, size_t offset, size_t count);
+
 	uint32_t bufferSize;
 	short *buffer;
 
@@ -101,6 +127,12 @@ class PatternGeneratorBufferManagerUi : public QWidget
 	std::map<std::string, Glib::VariantBase> options;
 	pv::MainWindow *main_win;
 
+	/* The buffer the plot shows and the rate it was loaded at, an
+	 * update of the same size only rewrites the samples that differ */
+	std::vector<short> shown;
+	uint32_t shownSampleRate;
+	bool updatePVSamples();
+
 public:
 	PatternGeneratorBufferManagerUi(QWidget *parent,
 	                                PatternGeneratorBufferManager *bufmananger, QWidget *settingsWidget,
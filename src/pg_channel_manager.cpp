@@ -29,7 +29,9 @@
 #include "pg_channel_manager.hpp"
 #include "pattern_generator.hpp"
 #include "dynamicWidget.hpp"
+#include <QtConcurrentRun>
 #include <glib.h>
+#include <algorithm>
 #include "boost/math/common_factor.hpp"
 #include "libsigrokdecode/libsigrokdecode.h"
 #include <utils.h>
@@ -1390,15 +1392,72 @@ void PatternGeneratorChannelManager::preGenerate()
 void PatternGeneratorChannelManager::generatePatterns(short *mainBuffer,
                 uint32_t sampleRate, uint32_t bufferSize)
 {
+	std::vector<PatternGeneratorChannelGroup *> groups;
+
 	for (auto&& chg : channel_group) {
 		PatternGeneratorChannelGroup *pgchg =
 		        static_cast<PatternGeneratorChannelGroup *>(chg);
 
 		if (pgchg->is_enabled()) {
-			pgchg->pattern->generate_pattern(sampleRate,bufferSize,
-			                                 pgchg->get_channel_count());
-			commitBuffer(pgchg, mainBuffer, bufferSize);
-			pgchg->pattern->delete_buffer();
+			groups.push_back(pgchg);
+		}
+	}
+
+	generatePatterns(groups, mainBuffer, sampleRate, bufferSize);
+}
+
+void PatternGeneratorChannelManager::generatePatterns(
+        const std::vector<PatternGeneratorChannelGroup *>& groups,
+        short *mainBuffer, uint32_t sampleRate, uint32_t bufferSize)
+{
+	struct Generated {
+		PatternGeneratorChannelGroup *chg;
+		std::vector<PatternRun> runs;
+		bool has_runs;
+	};
+
+	std::vector<Generated> generated(groups.size());
+	QList<QFuture<void>> futures;
+
+	// Patterns made of runs are filled in without a buffer of their own
+	auto generate = [sampleRate, bufferSize](Generated *g) {
+		Pattern *pattern = g->chg->pattern;
+		uint16_t nb_channels = g->chg->get_channel_count();
+
+		g->has_runs = pattern->generate_runs(sampleRate, bufferSize,
+		                                     nb_channels, g->runs);
+		if (!g->has_runs) {
+			pattern->generate_pattern(sampleRate, bufferSize, nb_channels);
+		}
+	};
+
+	/* The groups only share the output words, so each one is generated
+	 * on its own thread and then committed here. The JS patterns stay
+	 * on this thread with their script engine. */
+	for (size_t i = 0; i < groups.size(); i++) {
+		Generated *g = &generated[i];
+
+		g->chg = groups[i];
+
+		if (groups.size() == 1 || dynamic_cast<JSPattern *>(g->chg->pattern)) {
+			generate(g);
+		} else {
+			futures.push_back(QtConcurrent::run([=]() {
+				generate(g);
+			}));
+		}
+	}
+
+	for (auto&& future : futures) {
+		future.waitForFinished();
+	}
+
+	for (auto&& g : generated) {
+		if (g.has_runs) {
+			commitRuns(g.chg, g.runs, mainBuffer, bufferSize);
+		} else {
+			commitBuffer(g.chg, mainBuffer, bufferSize);
+			g.chg->pattern->delete_buffer();
 		}
 	}
 }
@@ -1423,23 +1482,82 @@ short PatternGeneratorChannelManager::remap_buffer(uint8_t *mapping,
 	return ret;
 }
 
+ChannelRemapTable::ChannelRemapTable(const std::vector<int>& mapping)
+{
+	/* The remapping of each byte of a sample is looked up, the tables
+	 * cost 512 remaps where a buffer would cost one per sample */
+	for (int val=0; val<256; val++) {
+		lo[val] = 0;
+		hi[val] = 0;
+
+		for (int bit=0; bit<8; bit++) {
+			if (!(val & (1<<bit))) {
+				continue;
+			}
+
+			if (bit < mapping.size() && mapping[bit] >= 0) {
+				lo[val] |= 1<<mapping[bit];
+			}
+
+			if (bit + 8 < mapping.size() && mapping[bit + 8] >= 0) {
+				hi[val] |= 1<<mapping[bit + 8];
+			}
+		}
+	}
+}
+
 void PatternGeneratorChannelManager::commitBuffer(PatternGeneratorChannelGroup
                 *chg, short *buffer, uint32_t bufferSize)
+{
+	std::vector<int> channel_mapping;
+	short *bufferPtr = chg->pattern->get_buffer();
+
+	for (int i=0; i<chg->get_channel_count(); i++) {
+		channel_mapping.push_back(chg->get_channel(i)->get_id());
+	}
+
+	const ChannelRemapTable remap(channel_mapping);
+	const uint16_t keep_mask = ~chg->get_mask();
+
+	for (uint32_t i=0; i< bufferSize; i++) {
+		buffer[i] = (buffer[i] & keep_mask) | remap(bufferPtr[i]);
+	}
+}
+
+void PatternGeneratorChannelManager::commitRuns(PatternGeneratorChannelGroup
+                *chg, const std::vector<PatternRun>& runs, short *buffer,
+                uint32_t bufferSize)
 {
 	uint8_t channel_mapping[16];
 	memset(channel_mapping,0x00,16*sizeof(uint8_t));
-	short *bufferPtr = chg->pattern->get_buffer();
-	int i=0;
 	auto buffer_channel_mask = (1<<chg->get_channel_count())-1;
 
-	for (i=0; i<chg->get_channel_count(); i++) {
+	for (int i=0; i<chg->get_channel_count(); i++) {
 		channel_mapping[i] = chg->get_channel(i)->get_id();
 	}
 
-	for (auto i=0; i< bufferSize; i++) {
-		auto val = (bufferPtr[i] & buffer_channel_mask);
-		buffer[i] = (buffer[i] & ~(chg->get_mask())) | remap_buffer(channel_mapping,
-		                val);
+	const uint16_t keep_mask = ~chg->get_mask();
+	uint32_t pos = 0;
+
+	for (auto&& run : runs) {
+		if (pos >= bufferSize) {
+			break;
+		}
+
+		const uint32_t length = std::min(run.length, bufferSize - pos);
+		const short value = remap_buffer(channel_mapping,
+		                                 run.value & buffer_channel_mask);
+
+		// A group using all the channels owns the samples outright
+		if (!keep_mask) {
+			std::fill_n(buffer + pos, length, value);
+		} else {
+			for (uint32_t i = pos; i < pos + length; i++) {
+				buffer[i] = (buffer[i] & keep_mask) | value;
+			}
+		}
+
+		pos += length;
 	}
 }
 
@@ -1523,6 +1641,11 @@ uint32_t PatternGeneratorChannelManager::computeSuggestedBufferSize(
 	return bufferSize;
 }
 
+void PatternGeneratorChannelManager::setMaxBufferSize(uint32_t size)
+{
+	maxBufferSize = size;
+}
+
 ////////////////////////////////////// CHANNEL MANAGER UI
 QWidget *PatternGeneratorChannelManagerUI::getSettingsWidget() const
 {
@@ -56,6 +56,24 @@ class PGChannelManagerHeader;
 namespace adiscope {
 class PatternGenerator;
 class PatternGeneratorChannelGroup;
+
+/*
+ * Moves bit i of a 16 bit sample to bit mapping[i], a negative one
+ * dropping it, with a lookup per byte of the sample.
+ */
+class ChannelRemapTable
+{
+	uint16_t lo[256];
+	uint16_t hi[256];
+public:
+	ChannelRemapTable(const std::vector<int>& mapping);
+
+	uint16_t operator()(uint16_t val) const
+	{
+		return lo[val & 0xff] | hi[val >> 8];
+	}
+};
+
 class PatternGeneratorChannelGroupUI;
 class PatternGeneratorChannelManagerUI;
 
@@ -228,7 +246,7 @@ class PatternGeneratorChannelManager : public ChannelManager
 {
 	PatternGeneratorChannelGroup *highlightedChannelGroup;
 	PatternGeneratorChannel *highlightedChannel;
-	const uint32_t maxBufferSize = 1000000;
+	uint32_t maxBufferSize = 1000000;
 
 public:
 	void highlightChannel(PatternGeneratorChannelGroup *chg,
@@ -248,12 +266,20 @@ public:
 	void preGenerate();
 	void generatePatterns(short *mainbuffer, uint32_t sampleRate,
 	                      uint32_t bufferSize);
+	/* Only the bits of the given groups in mainBuffer are written */
+	void generatePatterns(const std::vector<PatternGeneratorChannelGroup *>& groups,
+	                      short *mainBuffer, uint32_t sampleRate,
+	                      uint32_t bufferSize);
 	void commitBuffer(PatternGeneratorChannelGroup *chg, short *mainBuffer,
 	                  uint32_t bufferSize);
+	void commitRuns(PatternGeneratorChannelGroup *chg,
+	                const std::vector<PatternRun>& runs, short *mainBuffer,
+	                uint32_t bufferSize);
 	short remap_buffer(uint8_t *mapping, uint32_t val);
 
 	uint32_t computeSuggestedSampleRate();
 	uint32_t computeSuggestedBufferSize(uint32_t sample_rate);
+	void setMaxBufferSize(uint32_t size);
 	void add_channel_group(PatternGeneratorChannelGroup *chg);
 	PatternGeneratorChannel *get_channel(int);
 	void clearChannels();
@@ -29,9 +29,11 @@
 #include <QMap>
 
 #include <errno.h>
+#include <algorithm>
 #include "boost/math/common_factor.hpp"
 #include "pg_patterns.hpp"
 #include "pattern_generator.hpp"
+#include "logging_categories.h"
 
 using namespace std;
 using namespace adiscope;
@@ -45,7 +47,7 @@ JSConsole::JSConsole(QObject *parent) :
 
 void JSConsole::log(QString msg)
 {
-	qDebug() << "jsConsole: "<< msg;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR) << "jsConsole: "<< msg;
 }
 
 Pattern::Pattern()
@@ -120,6 +122,26 @@ uint8_t Pattern::pre_generate()
 	return 0;
 }
 
+bool Pattern::generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+                            uint16_t number_of_channels, std::vector<PatternRun>& runs)
+{
+	return false;
+}
+
+static void append_run(std::vector<PatternRun>& runs, uint16_t value,
+                       uint32_t length)
+{
+	if (!length) {
+		return;
+	}
+
+	if (!runs.empty() && runs.back().value == value) {
+		runs.back().length += length;
+	} else {
+		runs.push_back({length, value});
+	}
+}
+
 std::string Pattern::toString()
 {
 	return "";
@@ -166,10 +188,10 @@ Pattern *Pattern_API::fromString(QString str)
 		if (doc.isObject()) {
 			obj = doc.object();
 		} else {
-			qDebug() << "Document is not an object" << endl;
+			CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Document is not an object" << endl;
 		}
 	} else {
-		qDebug() << "Invalid JSON...\n" << str << endl;
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Invalid JSON...\n" << str << endl;
 	}
 
 	return fromJson(obj);
@@ -345,12 +367,12 @@ Pattern *Pattern_API::fromJson(QJsonObject obj)
 
 PatternUI::PatternUI(QWidget *parent) : QWidget(parent)
 {
-	qDebug()<<"PatternUICreated";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"PatternUICreated";
 }
 
 PatternUI::~PatternUI()
 {
-	qDebug()<<"PatternUIDestroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"PatternUIDestroyed";
 }
 
 void PatternUI::build_ui(QWidget *parent,uint16_t number_of_channels) {}
@@ -439,15 +461,15 @@ uint8_t ClockPattern::generate_pattern(uint32_t sample_rate,
 				       uint32_t number_of_samples, uint16_t number_of_channels)
 {
 	float f_period_number_of_samples = (float)sample_rate/frequency;
-	qDebug()<<"period_number_of_samples - "<<f_period_number_of_samples;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"period_number_of_samples - "<<f_period_number_of_samples;
 	float f_number_of_periods = number_of_samples / f_period_number_of_samples;
-	qDebug()<<"number_of_periods - " << f_number_of_periods;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"number_of_periods - " << f_number_of_periods;
 	float f_low_number_of_samples = (f_period_number_of_samples *
 					 (100-duty_cycle)) / 100;
-	qDebug()<<"low_number_of_samples - " << f_low_number_of_samples;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"low_number_of_samples - " << f_low_number_of_samples;
 	float f_high_number_of_samples = f_period_number_of_samples -
 					 f_low_number_of_samples;
-	qDebug()<<"high_number_of_samples - " << f_high_number_of_samples;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"high_number_of_samples - " << f_high_number_of_samples;
 
 
 	int period_number_of_samples = (int)round(f_period_number_of_samples);
@@ -478,6 +500,47 @@ uint8_t ClockPattern::generate_pattern(uint32_t sample_rate,
 	return 0;
 }
 
+bool ClockPattern::generate_runs(uint32_t sample_rate,
+				 uint32_t number_of_samples, uint16_t number_of_channels,
+				 std::vector<PatternRun>& runs)
+{
+	float f_period_number_of_samples = (float)sample_rate/frequency;
+	float f_low_number_of_samples = (f_period_number_of_samples *
+					 (100-duty_cycle)) / 100;
+	int period_number_of_samples = (int)round(f_period_number_of_samples);
+	int low_number_of_samples = (int)round(f_low_number_of_samples);
+
+	if (period_number_of_samples==0) {
+		period_number_of_samples=1;
+	}
+
+	int phased = (period_number_of_samples * phase/360);
+	uint32_t i = 0;
+
+	runs.clear();
+
+	// Same levels as generate_pattern, a run to the next edge at a time
+	while (i < number_of_samples) {
+		int pos = (i + phased) % period_number_of_samples;
+		uint32_t length;
+		uint16_t value;
+
+		if (pos < low_number_of_samples) {
+			length = low_number_of_samples - pos;
+			value = 0;
+		} else {
+			length = period_number_of_samples - pos;
+			value = 0xffff;
+		}
+
+		length = std::min(length, number_of_samples - i);
+		append_run(runs, value, length);
+		i += length;
+	}
+
+	return true;
+}
+
 ClockPatternUI::ClockPatternUI(ClockPattern *pattern,
 			       QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
@@ -690,11 +753,21 @@ uint8_t NumberPattern::generate_pattern(uint32_t sample_rate,
 	return 0;
 }
 
+bool NumberPattern::generate_runs(uint32_t sample_rate,
+				  uint32_t number_of_samples, uint16_t number_of_channels,
+				  std::vector<PatternRun>& runs)
+{
+	runs.clear();
+	append_run(runs, nr, number_of_samples);
+
+	return true;
+}
+
 
 NumberPatternUI::NumberPatternUI(NumberPattern *pattern,
 				 QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent), max(0)
 {
-	qDebug()<<"NumberPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"NumberPatternUI created";
 	ui = new Ui::NumberPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
@@ -702,7 +775,7 @@ NumberPatternUI::NumberPatternUI(NumberPattern *pattern,
 
 NumberPatternUI::~NumberPatternUI()
 {
-	qDebug()<<"NumberPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"NumberPatternUI destroyed";
 	delete ui;
 }
 
@@ -718,7 +791,7 @@ void NumberPatternUI::build_ui(QWidget *parent,uint16_t number_of_channels)
 	parent_ = parent;
 	parent->layout()->addWidget(this);
 	max = (1<<number_of_channels)-1;
-	qDebug()<<max;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<max;
 	//ui->numberLineEdit->setValidator(new QIntValidator(0, max, this));
 	ui->numberLineEdit->setText(QString::number(pattern->get_nr()));
 	connect(ui->numberLineEdit,SIGNAL(textChanged(QString)),this,SLOT(parse_ui()));
@@ -735,7 +808,7 @@ void NumberPatternUI::parse_ui()
 	auto val = ui->numberLineEdit->text().toInt(&ok,10);
 
 	if (!ok) {
-		qDebug()<<"Cannot set frequency, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set frequency, not an int";
 	}
 
 	if (val<max && ok) {
@@ -939,38 +1012,93 @@ BinaryCounterPattern::~BinaryCounterPattern()
 }
 
 
-uint8_t BinaryCounterPattern::generate_pattern(uint32_t sample_rate,
-		uint32_t number_of_samples, uint16_t number_of_channels)
+static uint32_t counter_samples_per_count(uint32_t sample_rate,
+		uint32_t frequency)
 {
-	delete_buffer();
-	buffer = new short[number_of_samples];
-	auto samples_per_count = (int)round(((float)sample_rate/(float)frequency));
-	//auto i=init_value;
-	auto i = 0;
-	auto increment = 1;
-	auto start_value = 0;
-	auto end_value = (1<<number_of_channels)-1;
-	auto j=0;
-
-	while (j<number_of_samples) {
-		for (auto k=0; k<samples_per_count; k++,j++) {
-			if (j>=number_of_samples) {
-				break;
-			}
+	return std::max(1, (int)round(((float)sample_rate/(float)frequency)));
+}
 
-			buffer[j] = i;
+/*
+ * The counters go from 0 to all the channels high and wrap around, the
+ * value of a block of samples_per_count samples being encode(count).
+ * Blocks are filled whole, and one sample per count is computed from
+ * the index without a branch so that it vectorizes.
+ */
+template<typename Encode>
+static void fill_counter(short *buffer, uint32_t number_of_samples,
+			 uint32_t samples_per_count, uint32_t mask, Encode encode)
+{
+	if (samples_per_count == 1) {
+		for (uint32_t j=0; j<number_of_samples; j++) {
+			buffer[j] = encode(j & mask);
 		}
 
-		if (i<end_value) {
-			i=i+increment;
-		} else {
-			i=start_value;
-		}
+		return;
+	}
+
+	uint32_t value = 0;
+
+	for (uint32_t j=0; j<number_of_samples; j+=samples_per_count) {
+		uint32_t n = std::min(samples_per_count, number_of_samples - j);
+		std::fill_n(buffer + j, n, (short)encode(value));
+		value = (value + 1) & mask;
+	}
+}
+
+template<typename Encode>
+static bool counter_runs(std::vector<PatternRun>& runs,
+			 uint32_t number_of_samples, uint32_t samples_per_count,
+			 uint32_t mask, Encode encode)
+{
+	// Shorter runs cost more than the samples
+	if (samples_per_count < 16) {
+		return false;
+	}
+
+	uint32_t value = 0;
+
+	runs.clear();
+
+	for (uint32_t j=0; j<number_of_samples; j+=samples_per_count) {
+		append_run(runs, encode(value),
+			   std::min(samples_per_count, number_of_samples - j));
+		value = (value + 1) & mask;
 	}
 
+	return true;
+}
+
+static uint32_t binary_code(uint32_t value)
+{
+	return value;
+}
+
+static uint32_t gray_code(uint32_t value)
+{
+	return value ^ (value >> 1);
+}
+
+uint8_t BinaryCounterPattern::generate_pattern(uint32_t sample_rate,
+		uint32_t number_of_samples, uint16_t number_of_channels)
+{
+	delete_buffer();
+	buffer = new short[number_of_samples];
+	fill_counter(buffer, number_of_samples,
+		     counter_samples_per_count(sample_rate, frequency),
+		     (1<<number_of_channels)-1, binary_code);
+
 	return 0;
 }
 
+bool BinaryCounterPattern::generate_runs(uint32_t sample_rate,
+		uint32_t number_of_samples, uint16_t number_of_channels,
+		std::vector<PatternRun>& runs)
+{
+	return counter_runs(runs, number_of_samples,
+			    counter_samples_per_count(sample_rate, frequency),
+			    (1<<number_of_channels)-1, binary_code);
+}
+
 BinaryCounterPatternUI::BinaryCounterPatternUI(BinaryCounterPattern *pattern,
 		QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
@@ -988,7 +1116,7 @@ BinaryCounterPatternUI::BinaryCounterPatternUI(BinaryCounterPattern *pattern,
 
 BinaryCounterPatternUI::~BinaryCounterPatternUI()
 {
-	qDebug()<<"BinaryCounterPatternUI Destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"BinaryCounterPatternUI Destroyed";
 	delete ui;
 }
 
@@ -1045,33 +1173,26 @@ uint8_t GrayCounterPattern::generate_pattern(uint32_t sample_rate,
 {
 	delete_buffer();
 	buffer = new short[number_of_samples];
-	auto samples_per_count = (int)round(((float)sample_rate/(float)frequency));
 	init_value = 0;
 	end_value =(1<< (number_of_channels))-1;
 	increment = 1;
 	start_value = 0;
-	auto i=init_value;
-	auto j=0;
-
-	while (j<number_of_samples) {
-		for (auto k=0; k<samples_per_count; k++,j++) {
-			if (j>=number_of_samples) {
-				break;
-			}
-
-			buffer[j] = i ^ (i >> 1);
-		}
-
-		if (i<end_value) {
-			i=i+increment;
-		} else {
-			i=start_value;
-		}
-	}
+	fill_counter(buffer, number_of_samples,
+		     counter_samples_per_count(sample_rate, frequency),
+		     end_value, gray_code);
 
 	return 0;
 }
 
+bool GrayCounterPattern::generate_runs(uint32_t sample_rate,
+		uint32_t number_of_samples, uint16_t number_of_channels,
+		std::vector<PatternRun>& runs)
+{
+	return counter_runs(runs, number_of_samples,
+			    counter_samples_per_count(sample_rate, frequency),
+			    (1<<number_of_channels)-1, gray_code);
+}
+
 GrayCounterPatternUI::GrayCounterPatternUI(GrayCounterPattern *pattern,
 		QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
@@ -1087,7 +1208,7 @@ GrayCounterPatternUI::GrayCounterPatternUI(GrayCounterPattern *pattern,
 }
 GrayCounterPatternUI::~GrayCounterPatternUI()
 {
-	qDebug()<<"BinaryCounterPatternUI Destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"BinaryCounterPatternUI Destroyed";
 	delete ui;
 }
 
@@ -1299,7 +1420,7 @@ uint16_t UARTPattern::encapsulateUartFrame(char chr, uint16_t *bits_per_frame)
 		break;
 
 	case SP_PARITY_INVALID:
-		qDebug() << "Invalid parity setting detected";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Invalid parity setting detected";
 	}
 
 	if (!msb_first) {
@@ -1359,7 +1480,7 @@ uint8_t UARTPattern::generate_pattern(uint32_t sample_rate,
 {
 	delete_buffer();
 	uint32_t samples_per_bit = sample_rate/baud_rate;
-	qDebug()<< "samples_per_bit - "<<(float)sample_rate/(float)baud_rate;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<< "samples_per_bit - "<<(float)sample_rate/(float)baud_rate;
 	uint16_t bits_per_frame;
 	encapsulateUartFrame(*(str.c_str()), &bits_per_frame);
 	uint32_t samples_per_frame = samples_per_bit * bits_per_frame;
@@ -1409,11 +1530,57 @@ uint8_t UARTPattern::generate_pattern(uint32_t sample_rate,
 	return 0;
 }
 
+bool UARTPattern::generate_runs(uint32_t sample_rate,
+				uint32_t number_of_samples, uint16_t number_of_channels,
+				std::vector<PatternRun>& runs)
+{
+	uint32_t samples_per_bit = sample_rate/baud_rate;
+	uint16_t bits_per_frame;
+	encapsulateUartFrame(*(str.c_str()), &bits_per_frame);
+	uint32_t samples_per_frame = samples_per_bit * bits_per_frame;
+	const char *str_ptr = str.c_str();
+	uint32_t total = 0;
+
+	runs.clear();
+
+	// A bit is a run, the idle line around the frames merges into one
+	append_run(runs, 1, samples_per_frame/2);
+
+	for (auto i=0; i<str.length(); i++,str_ptr++) {
+		auto frame_to_send = encapsulateUartFrame(*str_ptr, &bits_per_frame);
+
+		for (auto j=0; j<bits_per_frame; j++) {
+			short bit_to_send;
+
+			if (!msb_first) {
+				bit_to_send = (frame_to_send & 0x01);
+				frame_to_send = frame_to_send >> 1;
+			} else {
+				bit_to_send = ((frame_to_send & (1<<(bits_per_frame-1))) ? 1 :
+					       0);
+				frame_to_send = frame_to_send << 1;
+			}
+
+			append_run(runs, bit_to_send, samples_per_bit);
+		}
+	}
+
+	for (auto&& run : runs) {
+		total += run.length;
+	}
+
+	if (total < number_of_samples) {
+		append_run(runs, 1, number_of_samples - total);
+	}
+
+	return true;
+}
+
 
 UARTPatternUI::UARTPatternUI(UARTPattern *pattern,
 			     QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
-	qDebug()<<"UARTPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI created";
 	ui = new Ui::UARTPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
@@ -1421,7 +1588,7 @@ UARTPatternUI::UARTPatternUI(UARTPattern *pattern,
 
 UARTPatternUI::~UARTPatternUI()
 {
-	qDebug()<<"UARTPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI destroyed";
 	delete ui;
 }
 
@@ -1460,9 +1627,9 @@ void UARTPatternUI::parse_ui()
 	auto newStr = ui->CB_baud->currentText() + "/8"
 		      +ui->CB_Parity->currentText()[0] + ui->CB_Stop->currentText();
 	ui->LE_paramsOut->setText(newStr);
-	qDebug()<<ui->LE_paramsOut->text();
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<ui->LE_paramsOut->text();
 	pattern->set_params(ui->LE_paramsOut->text().toStdString());
-	qDebug()<<ui->LE_Data->text();
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<ui->LE_Data->text();
 	pattern->set_string(ui->LE_Data->text().toStdString());
 
 	Q_EMIT patternParamsChanged();
@@ -1697,7 +1864,7 @@ uint8_t I2CPattern::generate_pattern(uint32_t sample_rate,
 I2CPatternUI::I2CPatternUI(I2CPattern *pattern,
 			   QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
-	qDebug()<<"UARTPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI created";
 	ui = new Ui::I2CPatternUI();
 	ui->setupUi(this);
 	frequencySpinButton = new ScaleSpinButton({
@@ -1711,7 +1878,7 @@ I2CPatternUI::I2CPatternUI(I2CPattern *pattern,
 
 I2CPatternUI::~I2CPatternUI()
 {
-	qDebug()<<"UARTPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI destroyed";
 	delete ui;
 }
 
@@ -2026,7 +2193,7 @@ void SPIPattern::setCSPol(bool value)
 SPIPatternUI::SPIPatternUI(SPIPattern *pattern,
 			   QWidget *parent) : PatternUI(parent), pattern(pattern), parent_(parent)
 {
-	qDebug()<<"UARTPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI created";
 	ui = new Ui::SPIPatternUI();
 	ui->setupUi(this);
 	frequencySpinButton = new ScaleSpinButton({
@@ -2040,7 +2207,7 @@ SPIPatternUI::SPIPatternUI(SPIPattern *pattern,
 
 SPIPatternUI::~SPIPatternUI()
 {
-	qDebug()<<"UARTPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"UARTPatternUI destroyed";
 	delete ui;
 }
 
@@ -2171,7 +2338,7 @@ void SPIPatternUI::parse_ui()
 
 JSPattern::JSPattern(QJsonObject obj_) : obj(obj_)
 {
-	qDebug()<<"JSPattern created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JSPattern created";
 	set_name(obj["name"].toString().toStdString());
 	console = new JSConsole();
 	qEngine = nullptr;
@@ -2183,13 +2350,12 @@ JSPattern::JSPattern(QJsonObject obj_) : obj(obj_)
 
 void JSPattern::init()
 {
-
-	if (qEngine!=nullptr) {
-		qEngine->collectGarbage();
-		delete qEngine;
+	// The engine is kept when the settings come back, post_load_ui()
+	// binds the new UI objects over the old ones
+	if (qEngine==nullptr) {
+		qEngine = new QJSEngine();
+		loaded_script.clear();
 	}
-
-	qEngine = new QJSEngine();
 }
 
 void JSPattern::deinit()
@@ -2199,6 +2365,8 @@ void JSPattern::deinit()
 		delete qEngine;
 		qEngine = nullptr;
 	}
+
+	loaded_script.clear();
 }
 
 uint32_t JSPattern::get_min_sampling_freq()
@@ -2208,10 +2376,10 @@ uint32_t JSPattern::get_min_sampling_freq()
 	if (result.isNumber()) {
 		return result.toUInt();
 	} else if (result.isString()) {
-		qDebug() << "Error - return value of get_min_sampling_freq() is a string - " <<
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Error - return value of get_min_sampling_freq() is a string - " <<
 			 result.toString();
 	} else {
-		qDebug() << "Error - get_min_sampling_freq - "<< result.toString();
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Error - get_min_sampling_freq - "<< result.toString();
 	}
 
 	return 0;
@@ -2224,11 +2392,11 @@ uint32_t JSPattern::get_required_nr_of_samples()
 	if (result.isNumber()) {
 		return result.toUInt();
 	} else if (result.isString()) {
-		qDebug() <<
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) <<
 			 "Error - return value of get_required_nr_of_samples() is a string - " <<
 			 result.toString();
 	} else {
-		qDebug() << "Error - get_required_nr_of_samples - "<< result.toString();
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Error - get_required_nr_of_samples - "<< result.toString();
 	}
 
 	return 0;
@@ -2241,10 +2409,10 @@ bool JSPattern::is_periodic()
 	if (result.isBool()) {
 		return result.toBool();
 	} else if (result.isString()) {
-		qDebug() << "Error - return value of is_periodic() is a string - " <<
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Error - return value of is_periodic() is a string - " <<
 			 result.toString();
 	} else {
-		qDebug() << "Error - is_periodic - "<< result.toString();
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "Error - is_periodic - "<< result.toString();
 	}
 
 	return 0;
@@ -2254,13 +2422,20 @@ uint8_t JSPattern::pre_generate()
 {
 	QString fileName(obj["filepath"].toString() +
 			 obj["generate_script"].toString());
-	qDebug()<<fileName;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<fileName;
 	QFile scriptFile(fileName);
 	scriptFile.open(QIODevice::ReadOnly);
 	QTextStream stream(&scriptFile);
 	QString contents = stream.readAll();
 	scriptFile.close();
 
+	// Already in the engine
+	if (contents == loaded_script && !contents.isEmpty()) {
+		return 0;
+	}
+
+	loaded_script = contents;
+
 	qEngine->evaluate("function is_periodic(){ status_window.print(\"is_periodic() not found\")}");
 	qEngine->evaluate("function get_required_nr_of_samples(){ status_window.print(\"get_required_nr_of_samples() not found\")}");
 	qEngine->evaluate("function get_min_sampling_freq(){ status_window.print(\"get_min_sampling_freq() not found\")}");
@@ -2276,13 +2451,13 @@ uint8_t JSPattern::pre_generate()
 bool JSPattern::handle_result(QJSValue result,QString str)
 {
 	if (result.isError()) {
-		qDebug()
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)
 				<< "Uncaught exception at line"
 				<< result.property("lineNumber").toInt()
 				<< ":" << result.toString();
 		return -2;
 	} else {
-		qDebug()<<str<<" - Success";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<str<<" - Success";
 		return 0;
 	}
 
@@ -2295,11 +2470,26 @@ uint8_t JSPattern::generate_pattern(uint32_t sample_rate,
 	this->sample_rate = sample_rate;
 	this->number_of_channels = number_of_channels;
 	this->number_of_samples = number_of_samples;
-	handle_result(qEngine->evaluate("generate()"),"Eval generate");
-	commitBuffer(qEngine->evaluate("pg.buffer"),qEngine->evaluate("pg.buffersize"));
+	QJSValue result = qEngine->evaluate("generate()");
+	handle_result(result,"Eval generate");
+
+	// generate() can return a typed array or leave one in pg.buffer,
+	// copied in one go instead of a sample at a time
+	if (!commitTypedArray(result) &&
+	    !commitTypedArray(qEngine->evaluate("pg.buffer"))) {
+		commitBuffer(qEngine->evaluate("pg.buffer"),qEngine->evaluate("pg.buffersize"));
+	}
+
 	return 0;
 }
 
+void JSPattern::allocate_buffer(uint32_t length)
+{
+	// The channel manager reads number_of_samples, whatever the script gave
+	delete_buffer();
+	buffer = new short[std::max(length, number_of_samples)]();
+}
+
 quint32 JSPattern::get_nr_of_samples()
 {
 	return number_of_samples;
@@ -2317,32 +2507,68 @@ quint32 JSPattern::get_sample_rate()
 
 void JSPattern::JSErrorDialog(QString errorMessage)
 {
-	qDebug()<<"JSErrorDialog: "<<errorMessage;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JSErrorDialog: "<<errorMessage;
 }
 
 void JSPattern::commitBuffer(QJSValue jsBufferValue, QJSValue jsBufferSize)
 {
 	if (!jsBufferValue.isArray()) {
-		qDebug()<<"Not an array";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Not an array";
 		return;
 	}
 
 	if (!jsBufferSize.isNumber()) {
-		qDebug()<<"Not a valid size";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Not a valid size";
 		return;
 	}
 
-	delete_buffer();
-	buffer = new short[jsBufferSize.toInt()];
+	// A single conversion of the array, not a property lookup per sample
+	const QVariantList values = jsBufferValue.toVariant().toList();
+	const int size = std::max(0, std::min(jsBufferSize.toInt(), values.size()));
+
+	allocate_buffer(size);
 
-	for (auto i=0; i<jsBufferSize.toInt(); i++) {
-		if (!jsBufferValue.property(i).isError()) {
-			auto val = jsBufferValue.property(i).toInt();
+	for (auto i=0; i<size; i++) {
+		buffer[i] = values[i].toInt();
+	}
+}
+
+bool JSPattern::commitTypedArray(QJSValue jsArray)
+{
+	static const QStringList integer_arrays = {
+		"Int8Array", "Uint8Array", "Uint8ClampedArray",
+		"Int16Array", "Uint16Array", "Int32Array", "Uint32Array",
+	};
+
+	if (!jsArray.isObject() || !integer_arrays.contains(
+		    jsArray.property("constructor").property("name").toString())) {
+		return false;
+	}
+
+	const QByteArray bytes = jsArray.property("buffer").toVariant().toByteArray();
+	const int unit = jsArray.property("BYTES_PER_ELEMENT").toInt();
+	const int offset = jsArray.property("byteOffset").toInt();
+	const int length = jsArray.property("length").toInt();
+
+	if (offset < 0 || length < 0 || offset + length * unit > bytes.size()) {
+		return false;
+	}
+
+	const char *data = bytes.constData() + offset;
+
+	allocate_buffer(length);
+
+	if (unit == 2) {
+		memcpy(buffer, data, length * sizeof(short));
+	} else {
+		for (auto i=0; i<length; i++) {
+			uint32_t val = 0;
+			memcpy(&val, data + i * unit, unit);
 			buffer[i] = val;
-		} else {
-			buffer[i] = 0;
 		}
 	}
+
+	return true;
 }
 
 JSPatternUIScript_API::JSPatternUIScript_API(QObject *parent,
@@ -2357,7 +2583,7 @@ void JSPatternUIScript_API::parse_ui()
 JSPatternUI::JSPatternUI(JSPattern *pat,QJsonObject obj_,
 			 QWidget *parent) : pattern(pat), parent_(parent), jspat_api(nullptr), PatternUI(parent)
 {
-	qDebug()<<"JSPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JSPatternUI created";
 	loader = nullptr;
 	pattern->ui_form = nullptr;
 	ui = new Ui::GenericJSPatternUI();
@@ -2369,12 +2595,12 @@ JSPatternUI::JSPatternUI(JSPattern *pat,QJsonObject obj_,
 }
 JSPatternUI::~JSPatternUI()
 {
-	qDebug()<<"JSPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JSPatternUI destroyed";
 
 }
 void JSPatternUI::build_ui(QWidget *parent,uint16_t number_of_channels)
 {
-	qDebug()<<"JSPatternUI built";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JSPatternUI built";
 	jspat_api = new JSPatternUIScript_API(this,this);
 	parent_ = parent;
 	parent->layout()->addWidget(this);
@@ -2389,7 +2615,7 @@ void JSPatternUI::build_ui(QWidget *parent,uint16_t number_of_channels)
 		form_name = pattern->ui_form->objectName();
 
 	} else {
-		qDebug() << "file does not exist";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR) << "file does not exist";
 	}
 
 
@@ -2431,7 +2657,7 @@ void JSPatternUI::post_load_ui()
 {
 	QString fileName(pattern->obj["filepath"].toString() +
 			 pattern->obj["ui_script"].toString());
-	qDebug()<<fileName;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<fileName;
 	QFile scriptFile(fileName);
 	scriptFile.open(QIODevice::ReadOnly);
 	QTextStream stream(&scriptFile);
@@ -2609,7 +2835,7 @@ uint32_t LFSRPattern::compute_period()
 
 LFSRPatternUI::LFSRPatternUI(QWidget *parent) : PatternUI(parent)
 {
-	qDebug()<<"LFSRPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"LFSRPatternUI created";
 	ui = new Ui::LFSRPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
@@ -2617,7 +2843,7 @@ LFSRPatternUI::LFSRPatternUI(QWidget *parent) : PatternUI(parent)
 
 LFSRPatternUI::~LFSRPatternUI()
 {
-	qDebug()<<"LFSRPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"LFSRPatternUI destroyed";
 }
 void LFSRPatternUI::build_ui(QWidget *parent)
 {
@@ -2636,7 +2862,7 @@ void LFSRPatternUI::parse_ui()
 	set_lfsr_poly(ui->genPoly->text().toULong(&ok,16));
 
 	if (!ok) {
-		qDebug()<<"LFSR Poly cannot be converted to int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"LFSR Poly cannot be converted to int";
 	}
 
 	set_start_state(ui->startState->text().toULong(&ok,16));
@@ -2684,7 +2910,7 @@ uint8_t ConstantPattern::generate_pattern()
 
 ConstantPatternUI::ConstantPatternUI(QWidget *parent) : PatternUI(parent)
 {
-	qDebug()<<"ConstantPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"ConstantPatternUI created";
 	ui = new Ui::ConstantPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
@@ -2692,7 +2918,7 @@ ConstantPatternUI::ConstantPatternUI(QWidget *parent) : PatternUI(parent)
 
 ConstantPatternUI::~ConstantPatternUI()
 {
-	qDebug()<<"ConstantPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"ConstantPatternUI destroyed";
 }
 void ConstantPatternUI::build_ui(QWidget *parent)
 {
@@ -2727,9 +2953,9 @@ uint8_t PulsePattern::generate_pattern()
 	buffer = new short[number_of_samples];
 
 	float period_number_of_samples = high_number_of_samples+low_number_of_samples;
-	qDebug()<<"period_number_of_samples - "<<period_number_of_samples;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"period_number_of_samples - "<<period_number_of_samples;
 	float number_of_periods = number_of_samples / period_number_of_samples;
-	qDebug()<<"number_of_periods - " << number_of_periods;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"number_of_periods - " << number_of_periods;
 
 	delete_buffer();
 	buffer = new short[number_of_samples];
@@ -2823,14 +3049,14 @@ void PulsePattern::set_divider_init(uint16_t val)
 
 PulsePatternUI::PulsePatternUI(QWidget *parent)
 {
-	qDebug()<<"PulsePatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"PulsePatternUI created";
 	ui = new Ui::PulsePatternUI();
 	ui->setupUi(this);
 	setVisible(false);
 }
 PulsePatternUI::~PulsePatternUI()
 {
-	qDebug()<<"PulsePatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"PulsePatternUI destroyed";
 }
 
 void PulsePatternUI::parse_ui()
@@ -2839,31 +3065,31 @@ void PulsePatternUI::parse_ui()
 	set_start(ui->start_CB->currentText().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set start, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set start, not an int";
 	}
 
 	set_counter_init(ui->counterInit_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set counter_init, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set counter_init, not an int";
 	}
 
 	set_low_number_of_samples(ui->low_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set_low_number_of_samples, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set_low_number_of_samples, not an int";
 	}
 
 	set_high_number_of_samples(ui->high_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set_high_number_of_samples, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set_high_number_of_samples, not an int";
 	}
 
 	set_divider(ui->divider_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set_divider, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set_divider, not an int";
 	}
 
 	if (get_divider()<0) {
@@ -2873,7 +3099,7 @@ void PulsePatternUI::parse_ui()
 	set_divider_init(ui->dividerInit_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set_divider_init, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set_divider_init, not an int";
 	}
 
 }
@@ -2943,14 +3169,14 @@ uint8_t JohnsonCounterPattern::generate_pattern()
 
 JohnsonCounterPatternUI::JohnsonCounterPatternUI(QWidget *parent)
 {
-	qDebug()<<"JohnsonCounterPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JohnsonCounterPatternUI created";
 	ui = new Ui::FrequencyPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
 }
 JohnsonCounterPatternUI::~JohnsonCounterPatternUI()
 {
-	qDebug()<<"JohnsonCounterPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"JohnsonCounterPatternUI destroyed";
 }
 
 void JohnsonCounterPatternUI::parse_ui()
@@ -2959,7 +3185,7 @@ void JohnsonCounterPatternUI::parse_ui()
 	set_frequency(ui->frequencyLineEdit->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set frequency, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set frequency, not an int";
 	}
 }
 
@@ -3076,14 +3302,14 @@ uint8_t WalkingPattern::generate_pattern()
 
 WalkingPatternUI::WalkingPatternUI(QWidget *parent)
 {
-	qDebug()<<"WalkingCounterPatternUI created";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"WalkingCounterPatternUI created";
 	ui = new Ui::WalkingPatternUI();
 	ui->setupUi(this);
 	setVisible(false);
 }
 WalkingPatternUI::~WalkingPatternUI()
 {
-	qDebug()<<"WalkingCounterPatternUI destroyed";
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"WalkingCounterPatternUI destroyed";
 }
 
 void WalkingPatternUI::parse_ui()
@@ -3092,25 +3318,25 @@ void WalkingPatternUI::parse_ui()
 	set_frequency(ui->frequency_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set frequency, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set frequency, not an int";
 	}
 
 	set_length(ui->length_LE->text().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set length_LE, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set length_LE, not an int";
 	}
 
 	set_level(ui->level_CB->currentText().toInt(&ok,10));
 
 	if (!ok) {
-		qDebug()<<"Cannot set frequency, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set frequency, not an int";
 	}
 
 	set_right("Right"==ui->direction_CB->currentText());
 
 	if (!ok) {
-		qDebug()<<"Cannot set frequency, not an int";
+		CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"Cannot set frequency, not an int";
 	}
 }
 
@@ -3192,7 +3418,7 @@ uint8_t ImportPattern::generate_pattern(uint32_t sample_rate,
 				       uint32_t number_of_samples, uint16_t number_of_channels)
 {
 	float f_period_number_of_samples = (float)sample_rate/frequency;
-	qDebug()<<"period_number_of_samples - "<<f_period_number_of_samples;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<"period_number_of_samples - "<<f_period_number_of_samples;
 
 	int period_number_of_samples = (int)round(f_period_number_of_samples);
 	if (period_number_of_samples==0) {
@@ -3506,7 +3732,7 @@ void PatternFactory::init()
 	}
 
 	patterns = pattern_object;
-	qDebug()<<patterns;
+	CAT_DEBUG(CAT_PATTERN_GENERATOR)<<patterns;
 }
 
 
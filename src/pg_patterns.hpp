@@ -120,6 +120,12 @@ public:
 	Q_INVOKABLE void log(QString msg);
 };
 
+/* A stretch of samples of the same value */
+struct PatternRun {
+	uint32_t length;
+	uint16_t value;
+};
+
 class Pattern
 {
 private:
@@ -147,6 +153,11 @@ public:
 	                uint32_t number_of_channels);
 	virtual uint8_t generate_pattern(uint32_t sample_rate,
 	                                 uint32_t number_of_samples, uint16_t number_of_channels) = 0;
+	/* The pattern as runs instead of a buffer, for the patterns made
+	 * of long runs; false if it only has the buffer form */
+	virtual bool generate_runs(uint32_t sample_rate,
+	                           uint32_t number_of_samples, uint16_t number_of_channels,
+	                           std::vector<PatternRun>& runs);
 	virtual void deinit();
 
 	virtual std::string toString();
@@ -200,6 +211,8 @@ public:
 	virtual ~ClockPattern();
 	uint8_t generate_pattern(uint32_t sample_rate, uint32_t number_of_samples,
 	                         uint16_t number_of_channels);
+	bool generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+	                   uint16_t number_of_channels, std::vector<PatternRun>& runs);
 	float get_frequency() const;
 	void set_frequency(float value);
 	float get_duty_cycle() const;
@@ -283,6 +296,8 @@ public:
 	virtual ~BinaryCounterPattern();
 	virtual uint8_t generate_pattern(uint32_t sample_rate,
 	                                 uint32_t number_of_samples, uint16_t number_of_channels);
+	bool generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+	                   uint16_t number_of_channels, std::vector<PatternRun>& runs);
 	uint32_t get_min_sampling_freq();
 	uint32_t get_required_nr_of_samples(uint32_t sample_rate,
 	                                    uint32_t number_of_channels);
@@ -325,6 +340,8 @@ public:
 	virtual ~GrayCounterPattern() {}
 	uint8_t generate_pattern(uint32_t sample_rate,
 	                         uint32_t number_of_samples, uint16_t number_of_channels);
+	bool generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+	                   uint16_t number_of_channels, std::vector<PatternRun>& runs);
 };
 
 class GrayCounterPatternUI : public PatternUI
@@ -370,6 +387,8 @@ public:
 
 	virtual uint8_t generate_pattern(uint32_t sample_rate,
 	                                 uint32_t number_of_samples, uint16_t number_of_channels);
+	bool generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+	                   uint16_t number_of_channels, std::vector<PatternRun>& runs);
 	uint32_t get_min_sampling_freq();
 	uint32_t get_required_nr_of_samples(uint32_t sample_rate,
 	                                    uint32_t number_of_channels);
@@ -545,6 +564,8 @@ public:
 	virtual ~NumberPattern() {}
 	virtual uint8_t generate_pattern(uint32_t sample_rate,
 	                                 uint32_t number_of_samples, uint16_t number_of_channels);
+	bool generate_runs(uint32_t sample_rate, uint32_t number_of_samples,
+	                   uint16_t number_of_channels, std::vector<PatternRun>& runs);
 	uint16_t get_nr() const;
 	void set_nr(const uint16_t& value);
 };
@@ -592,6 +613,8 @@ public:
 	/*Q_INVOKABLE*/ void JSErrorDialog(QString errorMessage);
 	/*Q_INVOKABLE*/ void commitBuffer(QJSValue jsBufferValue,
 	                                  QJSValue jsBufferSize);
+	/* A whole chunk from an integer typed array, false if it is not one */
+	bool commitTypedArray(QJSValue jsArray);
 	bool is_periodic();
 	uint32_t get_min_sampling_freq();
 	uint32_t get_required_nr_of_samples();
@@ -601,6 +624,10 @@ public:
 	                         uint32_t number_of_samples, uint16_t number_of_channels);
 	void deinit();
 	virtual bool handle_result(QJSValue result,QString str = "");
+private:
+	/* The generate script last evaluated in qEngine */
+	QString loaded_script;
+	void allocate_buffer(uint32_t length);
 };
 
 class JSPatternUIStatusWindow : public QObject
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pg_stream.hpp"
+
+#include <iio.h>
+#include <QDebug>
+
+namespace adiscope {
+
+const unsigned int PatternGeneratorStream::kernelBuffers = 4;
+
+PatternGeneratorStream::PatternGeneratorStream(struct iio_device *dev)
+	: dev(dev), txbuf(nullptr), stopRequested(false), running(false)
+{
+}
+
+PatternGeneratorStream::~PatternGeneratorStream()
+{
+	stop();
+}
+
+bool PatternGeneratorStream::start(size_t chunk_size, const Source& source)
+{
+	stop();
+
+	if (!dev || !chunk_size) {
+		return false;
+	}
+
+	iio_device_set_kernel_buffers_count(dev, kernelBuffers);
+	txbuf = iio_device_create_buffer(dev, chunk_size, false);
+
+	if (!txbuf) {
+		qDebug() << "Could not create the stream buffer";
+		return false;
+	}
+
+	this->source = source;
+	stopRequested = false;
+	running = true;
+	thread = std::thread(&PatternGeneratorStream::run, this);
+
+	return true;
+}
+
+void PatternGeneratorStream::stop()
+{
+	stopRequested = true;
+
+	// Wakes a push waiting for room
+	if (thread.joinable()) {
+		iio_buffer_cancel(txbuf);
+		thread.join();
+	}
+
+	if (txbuf) {
+		iio_buffer_destroy(txbuf);
+		txbuf = nullptr;
+	}
+
+	running = false;
+}
+
+bool PatternGeneratorStream::isRunning() const
+{
+	return running;
+}
+
+void PatternGeneratorStream::run()
+{
+	short *start = static_cast<short *>(iio_buffer_start(txbuf));
+	size_t count = static_cast<short *>(iio_buffer_end(txbuf)) - start;
+
+	while (!stopRequested) {
+		size_t filled = source(start, count);
+
+		if (!filled) {
+			break;
+		}
+
+		for (size_t i = filled; i < count; i++) {
+			start[i] = start[filled - 1];
+		}
+
+		if (iio_buffer_push(txbuf) < 0) {
+			break;
+		}
+	}
+
+	running = false;
+}
+
+}
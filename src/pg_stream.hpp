@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PG_STREAM_H
+#define PG_STREAM_H
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+extern "C" {
+	struct iio_buffer;
+	struct iio_device;
+}
+
+namespace adiscope {
+
+/*
+ * Pushes a pattern longer than what a cyclic buffer holds: a thread
+ * fills non-cyclic buffers of chunk_size samples from the source and
+ * pushes them, the kernel queueing a few of them so that the output
+ * does not stop between two pushes.
+ *
+ * The source writes up to count samples in dst and returns how many,
+ * 0 once the pattern is over; a short chunk is padded with its last
+ * sample.
+ */
+class PatternGeneratorStream
+{
+public:
+	typedef std::function<size_t(short *dst, size_t count)> Source;
+
+	PatternGeneratorStream(struct iio_device *dev);
+	~PatternGeneratorStream();
+
+	bool start(size_t chunk_size, const Source& source);
+	void stop();
+	bool isRunning() const;
+
+private:
+	void run();
+
+	struct iio_device *dev;
+	struct iio_buffer *txbuf;
+	Source source;
+	std::thread thread;
+	std::atomic<bool> stopRequested;
+	std::atomic<bool> running;
+
+	static const unsigned int kernelBuffers;
+};
+
+}
+
+#endif // PG_STREAM_H
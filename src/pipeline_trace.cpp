@@ -0,0 +1,249 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "pipeline_trace.hpp"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QThread>
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace adiscope;
+
+std::atomic<bool> PipelineTrace::enabled(false);
+
+namespace {
+
+struct Event {
+	const char *name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+/* Written by its thread only; head counts all the events ever written,
+ * the last Size of them are kept */
+struct Ring {
+	static const uint64_t Size = 16384;
+
+	Ring() : head(0), alive(true), tid(0) {}
+
+	Event events[Size];
+	std::atomic<uint64_t> head;
+	std::atomic<bool> alive;
+
+	/* Guarded by the mutex of the registry */
+	int tid;
+	QByteArray name;
+};
+
+/* The rings of the threads that are gone are kept for the dump, up to
+ * MaxRings rings in all */
+struct Registry {
+	static const size_t MaxRings = 64;
+
+	Registry() : next_tid(1), cleared_at(0) {}
+
+	std::mutex mutex;
+	std::deque<std::shared_ptr<Ring>> rings;
+	int next_tid;
+
+	/* The events that began before are left out of the dump */
+	std::atomic<uint64_t> cleared_at;
+};
+
+Registry& registry()
+{
+	static Registry reg;
+
+	return reg;
+}
+
+struct ThreadRing {
+	std::shared_ptr<Ring> ring;
+
+	~ThreadRing()
+	{
+		if (ring)
+			ring->alive = false;
+	}
+};
+
+thread_local ThreadRing thread_ring;
+
+Ring *currentRing()
+{
+	if (thread_ring.ring)
+		return thread_ring.ring.get();
+
+	std::shared_ptr<Ring> ring = std::make_shared<Ring>();
+	bool gui = QCoreApplication::instance() &&
+		QThread::currentThread() == QCoreApplication::instance()->thread();
+
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+
+	ring->tid = reg.next_tid++;
+	ring->name = gui ? QByteArray("GUI") :
+		QByteArray("thread ") + QByteArray::number(ring->tid);
+
+	for (auto it = reg.rings.begin(); it != reg.rings.end() &&
+			reg.rings.size() >= Registry::MaxRings;) {
+		if ((*it)->alive)
+			++it;
+		else
+			it = reg.rings.erase(it);
+	}
+
+	reg.rings.push_back(ring);
+	thread_ring.ring = ring;
+	return ring.get();
+}
+
+QByteArray escaped(QByteArray str)
+{
+	return str.replace('\\', "\\\\").replace('"', "\\\"");
+}
+
+}
+
+void PipelineTrace::setEnabled(bool en)
+{
+	/* A new trace each time it is turned on */
+	if (en && !enabled.exchange(true))
+		clear();
+	else if (!en)
+		enabled = false;
+}
+
+void PipelineTrace::setThreadName(const char *name)
+{
+	Ring *ring = currentRing();
+	std::lock_guard<std::mutex> lock(registry().mutex);
+
+	ring->name = name;
+}
+
+void PipelineTrace::record(const char *name, uint64_t begin, uint64_t end)
+{
+	Ring *ring = currentRing();
+	uint64_t head = ring->head.load(std::memory_order_relaxed);
+
+	ring->events[head % Ring::Size] = { name, begin, end };
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void PipelineTrace::clear()
+{
+	registry().cleared_at = acquisition_clock::now();
+}
+
+QByteArray PipelineTrace::toJson()
+{
+	Registry& reg = registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	const uint64_t cleared_at = reg.cleared_at;
+
+	struct Copy {
+		int tid;
+		QByteArray name;
+		std::vector<Event> events;
+	};
+	std::vector<Copy> copies;
+	uint64_t origin = std::numeric_limits<uint64_t>::max();
+
+	for (const std::shared_ptr<Ring>& ring : reg.rings) {
+		Copy copy = { ring->tid, ring->name, {} };
+
+		/* The thread keeps writing while the events are copied, the
+		 * ones it wrote over meanwhile are dropped */
+		uint64_t head = ring->head.load(std::memory_order_acquire);
+		uint64_t first = head > Ring::Size ? head - Ring::Size : 0;
+		std::vector<Event> events;
+
+		for (uint64_t i = first; i < head; i++)
+			events.push_back(ring->events[i % Ring::Size]);
+
+		uint64_t after = ring->head.load(std::memory_order_acquire);
+		uint64_t valid = after > Ring::Size ? after - Ring::Size : 0;
+
+		for (uint64_t i = std::max(first, valid); i < head; i++) {
+			const Event& event = events[i - first];
+
+			if (event.begin < cleared_at)
+				continue;
+
+			copy.events.push_back(event);
+			origin = std::min(origin, event.begin);
+		}
+
+		copies.push_back(std::move(copy));
+	}
+
+	/* In us from the first event, as Chrome expects */
+	auto us = [](uint64_t ns) {
+		return QByteArray::number(ns / 1000.0, 'f', 3);
+	};
+
+	QByteArray json;
+	json.append("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+	bool first = true;
+	for (const Copy& copy : copies) {
+		const QByteArray tid = QByteArray::number(copy.tid);
+
+		json.append(first ? "\n" : ",\n");
+		first = false;
+		json.append("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+			    "\"tid\":" + tid + ",\"args\":{\"name\":\"" +
+			    escaped(copy.name) + "\"}}");
+
+		for (const Event& event : copy.events) {
+			json.append(",\n{\"name\":\"");
+			json.append(escaped(event.name));
+			json.append("\",\"cat\":\"pipeline\",\"ph\":\"X\","
+				    "\"pid\":1,\"tid\":" + tid + ",\"ts\":");
+			json.append(us(event.begin - origin));
+			json.append(",\"dur\":");
+			json.append(us(event.end - event.begin));
+			json.append('}');
+		}
+	}
+
+	json.append("\n]}\n");
+	return json;
+}
+
+bool PipelineTrace::dump(const QString& fileName)
+{
+	QFile file(fileName);
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	const QByteArray json = toJson();
+
+	return file.write(json) == json.size();
+}
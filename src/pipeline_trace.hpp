@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PIPELINE_TRACE_HPP
+#define PIPELINE_TRACE_HPP
+
+#include "acquisition_clock.h"
+
+#include <QByteArray>
+#include <QString>
+
+#include <atomic>
+#include <stdint.h>
+
+namespace adiscope {
+
+/*
+ * Records how long the stages between the hardware and the screen take
+ * (buffer refills, sink work, plot updates, measurements, decoding,
+ * exports), each thread into its own ring of the last events. The rings
+ * are written without locks and read back as a Chrome trace, which
+ * chrome://tracing or ui.perfetto.dev show on one timeline.
+ *
+ * The times are those of the acquisition clock, the same as the tags
+ * of the acquisition buffers. A disabled trace costs one relaxed load
+ * per trace point.
+ */
+class PipelineTrace
+{
+public:
+	/* Records the time from its construction to its destruction */
+	class Scope
+	{
+	public:
+		explicit Scope(const char *name) :
+			m_name(PipelineTrace::isEnabled() ? name : nullptr),
+			m_begin(m_name ? acquisition_clock::now() : 0)
+		{
+		}
+
+		~Scope()
+		{
+			if (m_name) {
+				PipelineTrace::record(m_name, m_begin,
+						acquisition_clock::now());
+			}
+		}
+
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char *m_name;
+		uint64_t m_begin;
+	};
+
+	static bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+	static void setEnabled(bool en);
+
+	/* The name the calling thread has in the trace, the threads that
+	 * set none show as "GUI" or by number */
+	static void setThreadName(const char *name);
+
+	/* name must outlive the trace, a string literal */
+	static void record(const char *name, uint64_t begin, uint64_t end);
+
+	static void clear();
+
+	/* The events kept so far in the Chrome trace event format */
+	static QByteArray toJson();
+	static bool dump(const QString& fileName);
+
+private:
+	static std::atomic<bool> enabled;
+};
+}
+
+#define PIPELINE_TRACE_CONCAT_(a, b) a##b
+#define PIPELINE_TRACE_CONCAT(a, b) PIPELINE_TRACE_CONCAT_(a, b)
+
+/* Traces the rest of the enclosing block under name */
+#define PIPELINE_TRACE(name) \
+	adiscope::PipelineTrace::Scope \
+		PIPELINE_TRACE_CONCAT(pipeline_trace_, __LINE__)(name)
+
+#endif /* PIPELINE_TRACE_HPP */
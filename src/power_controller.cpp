@@ -61,30 +61,34 @@ PowerController::PowerController(struct iio_context *ctx,
 		struct iio_channel *chan;
 		/* These are the two ADC amplifiers */
 		chan = iio_device_find_channel(dev3, "voltage0", false);
-		if (chan)
-			iio_channel_attr_write_bool(chan, "powerdown", false);
+		attrs.writeBool(chan, "powerdown", false);
 
 		chan = iio_device_find_channel(dev3, "voltage1", false);
-		if (chan)
-			iio_channel_attr_write_bool(chan, "powerdown", false);
+		attrs.writeBool(chan, "powerdown", false);
 
 		/* ADF4360 globaal clock power down */
-		iio_device_attr_write(dev3, "clk_powerdown", "0");
+		attrs.write(dev3, "clk_powerdown", "0");
 	}
 
 	/* Power down DACs by default */
-	iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", true);
-	if (pd_neg)
-		iio_channel_attr_write_bool(pd_neg, "user_supply_powerdown", true);
-	iio_channel_attr_write_bool(ch1w, "powerdown", true);
-	iio_channel_attr_write_bool(ch2w, "powerdown", true);
+	attrs.writeBool(pd_pos, "user_supply_powerdown", true);
+	attrs.writeBool(pd_neg, "user_supply_powerdown", true);
+	attrs.writeBool(ch1w, "powerdown", true);
+	attrs.writeBool(ch2w, "powerdown", true);
 
 	/* Set the default values */
-	iio_channel_attr_write_longlong(ch1w, "raw", 0LL);
-	iio_channel_attr_write_longlong(ch2w, "raw", 0LL);
+	attrs.writeLongLong(ch1w, "raw", 0LL);
+	attrs.writeLongLong(ch2w, "raw", 0LL);
+	attrs.commit();
 
 	ui->btnSync->click();
 
+	loop = new PowerSupplyLoop(ch1w, ch2w, ch1r, ch2r,
+		[=](int supply, double value) { return dacRaw(supply, value); },
+		[=](int supply, long long raw) {
+			return adcVolts(supply, raw);
+		});
+
 	valuePos = new PositionSpinButton({
 		{"mVolts",1e-3},
 		{"Volts",1e0}
@@ -143,15 +147,16 @@ PowerController::PowerController(struct iio_context *ctx,
 
 PowerController::~PowerController()
 {
+	loop->stop();
+
 	ui->dac1->setChecked(false);
 	ui->dac2->setChecked(false);
 
 	/* Power down DACs */
-	iio_channel_attr_write_bool(ch1w, "powerdown", true);
-	iio_channel_attr_write_bool(ch2w, "powerdown", true);
-	iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", true);
-	if (pd_neg)
-		iio_channel_attr_write_bool(pd_neg, "user_supply_powerdown", true);
+	attrs.writeBool(ch1w, "powerdown", true);
+	attrs.writeBool(ch2w, "powerdown", true);
+	attrs.writeBool(pd_pos, "user_supply_powerdown", true);
+	attrs.writeBool(pd_neg, "user_supply_powerdown", true);
 
 	/* FIXME: TODO: Move this into a HW class / lib M2k */
 	struct iio_device *dev3 = iio_context_find_device(ctx, "m2k-fabric");
@@ -159,21 +164,22 @@ PowerController::~PowerController()
 		struct iio_channel *chan;
 		/* These are the two ADC amplifiers */
 		chan = iio_device_find_channel(dev3, "voltage0", false);
-		if (chan)
-			iio_channel_attr_write_bool(chan, "powerdown", true);
+		attrs.writeBool(chan, "powerdown", true);
 
 		chan = iio_device_find_channel(dev3, "voltage1", false);
-		if (chan)
-			iio_channel_attr_write_bool(chan, "powerdown", true);
+		attrs.writeBool(chan, "powerdown", true);
 
 		/* ADF4360 globaal clock power down */
-		iio_device_attr_write(dev3, "clk_powerdown", "1");
+		attrs.write(dev3, "clk_powerdown", "1");
 	}
 
+	attrs.commit();
+
 	if (saveOnExit) {
 		api->save(*settings);
 	}
 	delete api;
+	delete loop;
 
 	delete ui;
 }
@@ -199,17 +205,47 @@ void PowerController::hideEvent(QHideEvent *event)
 	timer.stop();
 }
 
-void PowerController::dac1_set_value(double value)
+long long PowerController::dacRaw(int supply, double value) const
 {
-	double offset = calibrationParam[QString("offset_pos_dac")];
-	double gain = calibrationParam[QString("gain_pos_dac")];
+	long long val;
+
+	if (supply == 0) {
+		double offset = calibrationParam.value(QString("offset_pos_dac"));
+		double gain = calibrationParam.value(QString("gain_pos_dac"));
 
-	long long val = (value * gain + offset)  * 4095.0 / (5.02 * 1.2 ) ;
+		val = (value * gain + offset)  * 4095.0 / (5.02 * 1.2 ) ;
+	} else {
+		double offset = calibrationParam.value(QString("offset_neg_dac"));
+		double gain = calibrationParam.value(QString("gain_neg_dac"));
+
+		val = (value * gain + offset) * 4095.0 / (-5.1 * 1.2 );
+	}
 
 	if (val < 0 )
 		val = 0;
 
-	iio_channel_attr_write_longlong(ch1w, "raw", val);
+	return val;
+}
+
+double PowerController::adcVolts(int supply, double raw) const
+{
+	if (supply == 0) {
+		double offset = calibrationParam.value(QString("offset_pos_adc"));
+		double gain = calibrationParam.value(QString("gain_pos_adc"));
+
+		return ((raw * 6.4 / 4095.0) + offset) * gain;
+	} else {
+		double offset = calibrationParam.value(QString("offset_neg_adc"));
+		double gain = calibrationParam.value(QString("gain_neg_adc"));
+
+		return ((raw * (-6.4)  / 4095.0) + offset) * gain;
+	}
+}
+
+void PowerController::dac1_set_value(double value)
+{
+	attrs.writeLongLong(ch1w, "raw", dacRaw(0, value));
+	attrs.commit();
 	averageVoltageCh1.clear();
 
 	if (in_sync) {
@@ -222,54 +258,51 @@ void PowerController::dac1_set_value(double value)
 
 void PowerController::dac2_set_value(double value)
 {
-	double offset = calibrationParam[QString("offset_neg_dac")];
-	double gain = calibrationParam[QString("gain_neg_dac")];
-
-	long long val = (value * gain + offset) * 4095.0 / (-5.1 * 1.2 );
-
-	if (val < 0 )
-		val = 0;
-
-	iio_channel_attr_write_longlong(ch2w, "raw", val);
+	attrs.writeLongLong(ch2w, "raw", dacRaw(1, value));
+	attrs.commit();
 	averageVoltageCh2.clear();
 }
 
 void PowerController::dac1_set_enabled(bool enabled)
 {
-	iio_channel_attr_write_bool(ch1w, "powerdown", !enabled);
+	attrs.writeBool(ch1w, "powerdown", !enabled);
 	averageVoltageCh1.clear();
 
 	if (in_sync)
 		dac2_set_enabled(enabled);
 
 	if (pd_neg) { /* For HW Rev. >= C */
-		iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", !enabled);
+		attrs.writeBool(pd_pos, "user_supply_powerdown", !enabled);
 	} else {
 		if (enabled) {
-			iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", false);
+			attrs.writeBool(pd_pos, "user_supply_powerdown", false);
 		} else if (!ui->dac2->isChecked()) {
-			iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", true);
+			attrs.writeBool(pd_pos, "user_supply_powerdown", true);
 		}
 	}
 
+	attrs.commit();
+
 	setDynamicProperty(ui->dac1, "running", enabled);
 }
 
 void PowerController::dac2_set_enabled(bool enabled)
 {
-	iio_channel_attr_write_bool(ch2w, "powerdown", !enabled);
+	attrs.writeBool(ch2w, "powerdown", !enabled);
 	averageVoltageCh2.clear();
 
 	if (pd_neg) { /* For HW Rev. >= C */
-		iio_channel_attr_write_bool(pd_neg, "user_supply_powerdown", !enabled);
+		attrs.writeBool(pd_neg, "user_supply_powerdown", !enabled);
 	} else {
 		if (enabled) {
-			iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", false);
+			attrs.writeBool(pd_pos, "user_supply_powerdown", false);
 		} else if (!ui->dac1->isChecked()) {
-			iio_channel_attr_write_bool(pd_pos, "user_supply_powerdown", true);
+			attrs.writeBool(pd_pos, "user_supply_powerdown", true);
 		}
 	}
 
+	attrs.commit();
+
 	setDynamicProperty(ui->dac2, "running", enabled);
 }
 
@@ -294,16 +327,21 @@ void PowerController::ratioChanged(int percent)
 
 void PowerController::update_lcd()
 {
-	double offset1 = calibrationParam[QString("offset_pos_adc")];
-	double gain1 = calibrationParam[QString("gain_pos_adc")];
-	double offset2 = calibrationParam[QString("offset_neg_adc")];
-	double gain2 = calibrationParam[QString("gain_neg_adc")];
+	/* The loop already reads the supplies */
+	if (loop->isRunning()) {
+		display_readback(loop->readback(0), loop->readback(1));
+		timer.start(TIMER_TIMEOUT_MS);
+		return;
+	}
 
 	long long val1 = 0, val2 = 0;
 	double average1 = 0, average2 = 0;
 
-	iio_channel_attr_read_longlong(ch1r, "raw", &val1);
-	iio_channel_attr_read_longlong(ch2r, "raw", &val2);
+	attrs.read(ch1r, "raw");
+	attrs.read(ch2r, "raw");
+	attrs.commit();
+	attrs.valueLongLong(ch1r, "raw", &val1);
+	attrs.valueLongLong(ch2r, "raw", &val2);
 
 	averageVoltageCh1.push_back(val1);
 	averageVoltageCh2.push_back(val2);
@@ -321,15 +359,33 @@ void PowerController::update_lcd()
 	average1  /= averageVoltageCh1.length();
 	average2  /= averageVoltageCh2.length();
 
-	double value1 = (((double) average1 * 6.4 / 4095.0) + offset1) * gain1;
+	display_readback(adcVolts(0, average1), adcVolts(1, average2));
+
+	timer.start(TIMER_TIMEOUT_MS);
+}
+
+void PowerController::display_readback(double value1, double value2)
+{
 	ui->lcd1->display(value1);
 	ui->scale_dac1->setValue(value1);
 
-	double value2 = (((double) average2 * (-6.4)  / 4095.0) + offset2) * gain2;
 	ui->lcd2->display(value2);
 	ui->scale_dac2->setValue(value2);
+}
 
-	timer.start(TIMER_TIMEOUT_MS);
+void PowerController::startLoop()
+{
+	loop->start();
+}
+
+void PowerController::stopLoop()
+{
+	loop->stop();
+
+	/* The loop wrote the DACs behind the back of the shadow */
+	attrs.invalidate();
+	averageVoltageCh1.clear();
+	averageVoltageCh2.clear();
 }
 
 void PowerController::run()
@@ -25,6 +25,8 @@
 #include <QTimer>
 
 #include "apiObject.hpp"
+#include "iio_attr_transaction.hpp"
+#include "power_supply_loop.hpp"
 #include "spinbox_a.hpp"
 #include "tool.hpp"
 
@@ -79,12 +81,20 @@ namespace adiscope {
 		PositionSpinButton *valuePos;
 		PositionSpinButton *valueNeg;
 		struct iio_channel *ch1w, *ch2w, *ch1r, *ch2r, *pd_pos, *pd_neg;
+		IioAttrTransaction attrs;
+		PowerSupplyLoop *loop;
 		QTimer timer;
 		bool in_sync;
 		QList<long long> averageVoltageCh1;
 		QList<long long> averageVoltageCh2;
 		QMap<QString, double> calibrationParam;
 
+		long long dacRaw(int supply, double value) const;
+		double adcVolts(int supply, double raw) const;
+		void display_readback(double value1, double value2);
+		void startLoop();
+		void stopLoop();
+
 		void showEvent(QShowEvent *event);
 		void hideEvent(QHideEvent *event);
 
@@ -87,4 +87,58 @@ void PowerController_API::setDac2Enabled(bool enable)
 {
 	pw->ui->dac2->setChecked(enable);
 }
+
+bool PowerController_API::loopRunning() const
+{
+	return pw->loop->isRunning();
+}
+
+void PowerController_API::setLoopRunning(bool run)
+{
+	if (run)
+		pw->startLoop();
+	else
+		pw->stopLoop();
+}
+
+double PowerController_API::loopRate() const
+{
+	return pw->loop->rate();
+}
+
+void PowerController_API::setLoopRate(double rate)
+{
+	pw->loop->setRate(rate);
+}
+
+bool PowerController_API::loopRegulation() const
+{
+	return pw->loop->regulation();
+}
+
+void PowerController_API::setLoopRegulation(bool enable)
+{
+	pw->loop->setRegulation(enable);
+}
+
+bool PowerController_API::rampDone() const
+{
+	return pw->loop->rampDone();
+}
+
+double PowerController_API::readbackPos() const
+{
+	return pw->loop->readback(0);
+}
+
+double PowerController_API::readbackNeg() const
+{
+	return pw->loop->readback(1);
+}
+
+void PowerController_API::ramp(double start_pos, double stop_pos,
+		double start_neg, double stop_neg, double seconds)
+{
+	pw->loop->setRamp(start_pos, stop_pos, start_neg, stop_neg, seconds);
+}
 }
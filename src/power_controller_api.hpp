@@ -37,6 +37,16 @@ class PowerController_API : public ApiObject
 	Q_PROPERTY(bool dac1_enabled READ Dac1Enabled WRITE setDac1Enabled);
 	Q_PROPERTY(bool dac2_enabled READ Dac2Enabled WRITE setDac2Enabled);
 
+	/* Readback and regulation loop, run from a worker thread */
+	Q_PROPERTY(bool loop_running READ loopRunning WRITE setLoopRunning
+			STORED false);
+	Q_PROPERTY(double loop_rate READ loopRate WRITE setLoopRate);
+	Q_PROPERTY(bool loop_regulation READ loopRegulation
+			WRITE setLoopRegulation);
+	Q_PROPERTY(bool ramp_done READ rampDone STORED false);
+	Q_PROPERTY(double readback_pos READ readbackPos STORED false);
+	Q_PROPERTY(double readback_neg READ readbackNeg STORED false);
+
 public:
 	explicit PowerController_API(PowerController *pw) :
 		ApiObject(), pw(pw) {}
@@ -60,8 +70,26 @@ public:
 	bool Dac2Enabled() const;
 	void setDac2Enabled(bool enable);
 
+	bool loopRunning() const;
+	void setLoopRunning(bool run);
+
+	double loopRate() const;
+	void setLoopRate(double rate);
+
+	bool loopRegulation() const;
+	void setLoopRegulation(bool enable);
+
+	bool rampDone() const;
+	double readbackPos() const;
+	double readbackNeg() const;
+
 	Q_INVOKABLE void show();
 
+	/* Ramps both supplies from start to stop in the given time, the
+	 * loop must be running */
+	Q_INVOKABLE void ramp(double start_pos, double stop_pos,
+			double start_neg, double stop_neg, double seconds);
+
 private:
 	PowerController *pw;
 };
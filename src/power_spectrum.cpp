@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/fft/window.h>
+#include <volk/volk.h>
+
+#include <map>
+#include <mutex>
+
+#include "power_spectrum.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+/* Idle transforms kept with their plans, all sizes together; a rebuild
+ * of the spectrum analyzer chains releases a few and takes them back */
+#define POWER_SPECTRUM_POOL_SIZE 32
+
+/* Windows of different sizes kept around */
+#define POWER_SPECTRUM_MAX_WINDOWS 16
+
+static std::mutex pool_mutex;
+static std::multimap<std::pair<size_t, unsigned int>, power_spectrum *> pool;
+
+power_spectrum::power_spectrum(size_t fft_size, unsigned int nbthreads)
+	: d_fft_size(fft_size),
+	d_nbthreads(nbthreads),
+	d_fft(fft_size, nbthreads),
+	d_window(hamming(fft_size))
+{
+}
+
+power_spectrum::sptr power_spectrum::get(size_t fft_size,
+		unsigned int nbthreads)
+{
+	power_spectrum *spectrum = nullptr;
+
+	{
+		std::lock_guard<std::mutex> lock(pool_mutex);
+		auto it = pool.find(std::make_pair(fft_size, nbthreads));
+
+		if (it != pool.end()) {
+			spectrum = it->second;
+			pool.erase(it);
+		}
+	}
+
+	/* Planned without the lock, it can take a while */
+	if (!spectrum) {
+		spectrum = new power_spectrum(fft_size, nbthreads);
+	}
+
+	return sptr(spectrum, &power_spectrum::release);
+}
+
+void power_spectrum::release(power_spectrum *spectrum)
+{
+	spectrum->d_window = hamming(spectrum->d_fft_size);
+
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	if (pool.size() >= POWER_SPECTRUM_POOL_SIZE) {
+		delete spectrum;
+		return;
+	}
+
+	pool.insert(std::make_pair(std::make_pair(spectrum->d_fft_size,
+				spectrum->d_nbthreads), spectrum));
+}
+
+std::shared_ptr<const std::vector<float>> power_spectrum::hamming(
+		size_t size)
+{
+	static std::mutex mutex;
+	static std::map<size_t, std::shared_ptr<const std::vector<float>>>
+		windows;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = windows.find(size);
+
+	if (it != windows.end()) {
+		return it->second;
+	}
+
+	if (windows.size() >= POWER_SPECTRUM_MAX_WINDOWS) {
+		windows.clear();
+	}
+
+	auto window = std::make_shared<const std::vector<float>>(
+			fft::window::hamming(size));
+	windows[size] = window;
+
+	return window;
+}
+
+void power_spectrum::set_window(const std::vector<float>& window)
+{
+	if (window.size() == d_fft_size) {
+		d_window = std::make_shared<const std::vector<float>>(window);
+	}
+}
+
+void power_spectrum::compute_half(const float *in, float *out)
+{
+	volk_32f_x2_multiply_32f(d_fft.get_inbuf(), in, d_window->data(),
+			d_fft_size);
+	d_fft.execute();
+	volk_32fc_magnitude_squared_32f(out, d_fft.get_outbuf(),
+			d_fft_size / 2 + 1);
+}
+
+void power_spectrum::compute(const float *in, float *out)
+{
+	size_t half = d_fft_size / 2;
+
+	compute_half(in, out);
+
+	/* A real input only has these bins, the others mirror them */
+	for (size_t k = half + 1; k < d_fft_size; k++) {
+		out[k] = out[d_fft_size - k];
+	}
+}
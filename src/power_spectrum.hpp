@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POWER_SPECTRUM_HPP
+#define POWER_SPECTRUM_HPP
+
+#include <gnuradio/fft/fft.h>
+
+#include <memory>
+#include <vector>
+
+namespace adiscope {
+	/*
+	 * Window, real to complex FFT and squared magnitude of one frame,
+	 * the kernel of fft_power_block, also used outside of a flowgraph
+	 * on frames that were already captured.
+	 *
+	 * Planning an FFT is far more expensive than running it, so the
+	 * transforms come from a pool shared by all the users: one that
+	 * is done with its frames hands it back, the next one asking for
+	 * the same size and threads gets it with its plan ready. The
+	 * Hamming windows are cached the same way.
+	 */
+	class power_spectrum
+	{
+	public:
+		typedef std::shared_ptr<power_spectrum> sptr;
+
+		/* A transform of the pool, or a new one; it goes back to
+		 * the pool with the last reference, its window reset to
+		 * Hamming for the next user */
+		static sptr get(size_t fft_size, unsigned int nbthreads = 1);
+
+		/* The Hamming window of that size, shared */
+		static std::shared_ptr<const std::vector<float>> hamming(
+				size_t size);
+
+		size_t fft_size() const { return d_fft_size; }
+		unsigned int nbthreads() const { return d_nbthreads; }
+
+		/* Ignored unless of fft_size samples */
+		void set_window(const std::vector<float>& window);
+
+		/* fft_size outputs from fft_size inputs: the power of the
+		 * fft_size / 2 + 1 bins of the real input, followed by
+		 * their mirror, as a complex FFT would give them */
+		void compute(const float *in, float *out);
+
+		/* Only the fft_size / 2 + 1 bins */
+		void compute_half(const float *in, float *out);
+
+		/* The fft_size / 2 + 1 complex bins of the last frame
+		 * computed, valid until the next one */
+		const gr_complex *bins() { return d_fft.get_outbuf(); }
+
+	private:
+		power_spectrum(size_t fft_size, unsigned int nbthreads);
+
+		static void release(power_spectrum *spectrum);
+
+		size_t d_fft_size;
+		unsigned int d_nbthreads;
+		gr::fft::fft_real_fwd d_fft;
+		std::shared_ptr<const std::vector<float>> d_window;
+	};
+}
+
+#endif /* POWER_SPECTRUM_HPP */
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "iio_attr_transaction.hpp"
+#include "power_supply_loop.hpp"
+
+using namespace adiscope;
+
+const double PowerSupplyLoop::max_correction = 0.5;
+const double PowerSupplyLoop::regulation_gain = 0.2;
+
+PowerSupplyLoop::PowerSupplyLoop(struct iio_channel *dac_pos,
+				 struct iio_channel *dac_neg,
+				 struct iio_channel *adc_pos,
+				 struct iio_channel *adc_neg,
+				 const DacConversion& to_dac,
+				 const AdcConversion& to_volts) :
+	dac{ dac_pos, dac_neg },
+	adc{ adc_pos, adc_neg },
+	to_dac(to_dac),
+	to_volts(to_volts),
+	running(false),
+	tick_rate(1000.0),
+	regulate(false),
+	profile_changed(false),
+	ramp_done(true)
+{
+	last_readback[0] = 0.0;
+	last_readback[1] = 0.0;
+}
+
+PowerSupplyLoop::~PowerSupplyLoop()
+{
+	stop();
+}
+
+void PowerSupplyLoop::start()
+{
+	if (running) {
+		return;
+	}
+
+	running = true;
+	thread = std::thread(&PowerSupplyLoop::run, this);
+}
+
+void PowerSupplyLoop::stop()
+{
+	running = false;
+
+	if (thread.joinable()) {
+		thread.join();
+	}
+}
+
+bool PowerSupplyLoop::isRunning() const
+{
+	return running;
+}
+
+void PowerSupplyLoop::setRate(double rate)
+{
+	if (rate > 0.0) {
+		tick_rate = rate;
+	}
+}
+
+double PowerSupplyLoop::rate() const
+{
+	return tick_rate;
+}
+
+void PowerSupplyLoop::setRegulation(bool enabled)
+{
+	regulate = enabled;
+}
+
+bool PowerSupplyLoop::regulation() const
+{
+	return regulate;
+}
+
+void PowerSupplyLoop::setRamp(double start_pos, double stop_pos,
+			      double start_neg, double stop_neg,
+			      double seconds)
+{
+	size_t ticks = std::max<size_t>(1, std::llround(std::max(0.0,
+					seconds) * tick_rate));
+	std::vector<double> pos(ticks), neg(ticks);
+
+	for (size_t i = 0; i < ticks; i++) {
+		double t = ticks > 1 ? (double)i / (ticks - 1) : 1.0;
+
+		pos[i] = start_pos + (stop_pos - start_pos) * t;
+		neg[i] = start_neg + (stop_neg - start_neg) * t;
+	}
+
+	std::lock_guard<std::mutex> lock(profile_mutex);
+
+	profile[0].swap(pos);
+	profile[1].swap(neg);
+	profile_changed = true;
+	ramp_done = false;
+}
+
+bool PowerSupplyLoop::rampDone() const
+{
+	return ramp_done;
+}
+
+double PowerSupplyLoop::readback(int supply) const
+{
+	return last_readback[supply & 1];
+}
+
+void PowerSupplyLoop::run()
+{
+	IioAttrTransaction attrs;
+	std::vector<double> points[2];
+	double correction[2] = { 0.0, 0.0 };
+	size_t tick = 0;
+	auto next = std::chrono::steady_clock::now();
+
+	while (running) {
+		{
+			std::lock_guard<std::mutex> lock(profile_mutex);
+
+			if (profile_changed) {
+				points[0].swap(profile[0]);
+				points[1].swap(profile[1]);
+				profile_changed = false;
+				tick = 0;
+			}
+		}
+
+		if (!points[0].empty()) {
+			size_t i = std::min(tick, points[0].size() - 1);
+
+			for (int s = 0; s < 2; s++) {
+				attrs.writeLongLong(dac[s], "raw",
+					to_dac(s, points[s][i] + correction[s]));
+			}
+
+			if (++tick >= points[0].size()) {
+				ramp_done = true;
+			}
+		}
+
+		attrs.read(adc[0], "raw");
+		attrs.read(adc[1], "raw");
+		attrs.commit();
+
+		for (int s = 0; s < 2; s++) {
+			long long raw;
+
+			if (!attrs.valueLongLong(adc[s], "raw", &raw)) {
+				continue;
+			}
+
+			double volts = to_volts(s, raw);
+
+			last_readback[s] = volts;
+
+			if (regulate && !points[s].empty()) {
+				size_t i = std::min(tick, points[s].size()) - 1;
+				double error = points[s][i] - volts;
+
+				correction[s] = std::max(-max_correction,
+					std::min(max_correction, correction[s] +
+						regulation_gain * error));
+			} else {
+				correction[s] = 0.0;
+			}
+		}
+
+		next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+				std::chrono::duration<double>(1.0 / tick_rate));
+
+		/* Don't try to catch up after a stall */
+		auto now = std::chrono::steady_clock::now();
+
+		if (next < now) {
+			next = now;
+		}
+
+		std::this_thread::sleep_until(next);
+	}
+}
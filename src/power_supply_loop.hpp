@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef POWER_SUPPLY_LOOP_HPP
+#define POWER_SUPPLY_LOOP_HPP
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+extern "C" {
+	struct iio_channel;
+}
+
+namespace adiscope {
+
+/*
+ * Drives both power supplies from a worker thread at a fixed rate,
+ * independently of the GUI timer: every tick sends the next point of
+ * the ramp profiles, reads both supplies back in one transaction and,
+ * when regulating, corrects the outputs from the readback.
+ *
+ * The profiles are computed for every tick when the ramp is set, so
+ * the loop only has to step through them; the last point is held
+ * once the ramp is over.
+ *
+ * The regulation integrates the error between the setpoint and the
+ * readback into a correction, clamped to max_correction volts, that
+ * is added to the next setpoint.
+ */
+class PowerSupplyLoop
+{
+public:
+	/* Supply 0 is the positive one, 1 the negative one */
+	typedef std::function<long long(int, double)> DacConversion;
+	typedef std::function<double(int, long long)> AdcConversion;
+
+	PowerSupplyLoop(struct iio_channel *dac_pos,
+			struct iio_channel *dac_neg,
+			struct iio_channel *adc_pos,
+			struct iio_channel *adc_neg,
+			const DacConversion& to_dac,
+			const AdcConversion& to_volts);
+	~PowerSupplyLoop();
+
+	void start();
+	void stop();
+	bool isRunning() const;
+
+	/* Ticks per second */
+	void setRate(double rate);
+	double rate() const;
+
+	void setRegulation(bool enabled);
+	bool regulation() const;
+
+	/* Linear ramps of both supplies, starting at the next tick */
+	void setRamp(double start_pos, double stop_pos,
+		     double start_neg, double stop_neg, double seconds);
+	bool rampDone() const;
+
+	double readback(int supply) const;
+
+private:
+	void run();
+
+	static const double max_correction;
+	static const double regulation_gain;
+
+	struct iio_channel *dac[2];
+	struct iio_channel *adc[2];
+	DacConversion to_dac;
+	AdcConversion to_volts;
+
+	std::thread thread;
+	std::atomic<bool> running;
+	std::atomic<double> tick_rate;
+	std::atomic<bool> regulate;
+
+	mutable std::mutex profile_mutex;
+	std::vector<double> profile[2];
+	bool profile_changed;
+	std::atomic<bool> ramp_done;
+
+	std::atomic<double> last_readback[2];
+};
+}
+
+#endif /* POWER_SUPPLY_LOOP_HPP */
@@ -21,6 +21,9 @@
 #include "preferences.h"
 #include "ui_preferences.h"
 #include "dynamicWidget.hpp"
+#include "gpu_power_spectrum.hpp"
+#include "memory_budget.hpp"
+#include "thread_scheduling.hpp"
 
 #include <QElapsedTimer>
 #include <QDir>
@@ -33,6 +36,24 @@
 
 using namespace adiscope;
 
+/* "2,3" to the core numbers; false if not such a list */
+static bool parseCores(const QString& text, std::vector<int>& cores)
+{
+	cores.clear();
+
+	for (const QString& item : text.split(',', QString::SkipEmptyParts)) {
+		bool isNumber = false;
+		int core = item.trimmed().toInt(&isNumber);
+
+		if (!isNumber || core < 0)
+			return false;
+
+		cores.push_back(core);
+	}
+
+	return true;
+}
+
 Preferences::Preferences(QWidget *parent) :
 	QWidget(parent),
 	ui(new Ui::Preferences),
@@ -54,6 +75,13 @@ Preferences::Preferences(QWidget *parent) :
 	osc_filtering_enabled(true),
 	mini_hist_enabled(false),
 	digital_decoders_enabled(true),
+	lazy_tools_enabled(false),
+	adc_kernel_buffers(4),
+	memory_budget(0),
+	opengl_canvas_enabled(false),
+	gpu_fft_enabled(false),
+	acquisition_cores(""),
+	acquisition_realtime(false),
 	m_initialized(false),
 	show_ADC_digital_filters(false),
 	m_useNativeDialogs(true),
@@ -95,6 +123,47 @@ Preferences::Preferences(QWidget *parent) :
 		}
 
 	});
+	connect(ui->adcKernelBuffers, &QLineEdit::returnPressed, [=]() {
+		bool isNumber = false;
+		int buffers = ui->adcKernelBuffers->text().toInt(&isNumber);
+
+		if (isNumber && buffers >= 1 && buffers <= 64) {
+			setDynamicProperty(ui->adcKernelBuffers, "invalid", false);
+			setDynamicProperty(ui->adcKernelBuffers, "valid", true);
+			adc_kernel_buffers = buffers;
+			Q_EMIT notify();
+		} else {
+			setDynamicProperty(ui->adcKernelBuffers, "valid", false);
+			setDynamicProperty(ui->adcKernelBuffers, "invalid", true);
+		}
+	});
+	connect(ui->memoryBudget, &QLineEdit::returnPressed, [=]() {
+		bool isNumber = false;
+		int mib = ui->memoryBudget->text().toInt(&isNumber);
+
+		if (isNumber && mib >= 0) {
+			setDynamicProperty(ui->memoryBudget, "invalid", false);
+			setDynamicProperty(ui->memoryBudget, "valid", true);
+			setMemory_budget(mib);
+			Q_EMIT notify();
+		} else {
+			setDynamicProperty(ui->memoryBudget, "valid", false);
+			setDynamicProperty(ui->memoryBudget, "invalid", true);
+		}
+	});
+	connect(ui->acquisitionCores, &QLineEdit::returnPressed, [=]() {
+		std::vector<int> cores;
+
+		if (parseCores(ui->acquisitionCores->text(), cores)) {
+			setDynamicProperty(ui->acquisitionCores, "invalid", false);
+			setDynamicProperty(ui->acquisitionCores, "valid", true);
+			setAcquisition_cores(ui->acquisitionCores->text().trimmed());
+			Q_EMIT notify();
+		} else {
+			setDynamicProperty(ui->acquisitionCores, "valid", false);
+			setDynamicProperty(ui->acquisitionCores, "invalid", true);
+		}
+	});
 	connect(ui->saveSessionCheckBox, &QCheckBox::stateChanged, [=](int state) {
 		save_session_on_exit = (!state ? false : true);
 		Q_EMIT notify();
@@ -155,6 +224,34 @@ Preferences::Preferences(QWidget *parent) :
 			m_initialized = true;
 		}
 	});
+	connect(ui->lazyToolsCheckBox, &QCheckBox::stateChanged, [=](int state) {
+		lazy_tools_enabled = (!state ? false : true);
+		Q_EMIT notify();
+	});
+	connect(ui->openglCanvasCheckBox, &QCheckBox::clicked, [=](bool checked){
+		opengl_canvas_enabled = checked;
+		Q_EMIT notify();
+
+		QMessageBox info(this);
+		info.setText(tr("This change will be applied only after a Scopy reset."));
+		info.exec();
+	});
+#ifndef OPENGL_CANVAS
+	ui->openglCanvasCheckBox->setVisible(false);
+	ui->label_opengl->setVisible(false);
+#endif
+	connect(ui->gpuFftCheckBox, &QCheckBox::stateChanged, [=](int state) {
+		setGpu_fft_enabled(!state ? false : true);
+		Q_EMIT notify();
+	});
+	if (!gpu_power_spectrum::supported()) {
+		ui->gpuFftCheckBox->setVisible(false);
+		ui->label_gpu_fft->setVisible(false);
+	}
+	connect(ui->acquisitionRealtimeCheckBox, &QCheckBox::stateChanged, [=](int state) {
+		setAcquisition_realtime(!state ? false : true);
+		Q_EMIT notify();
+	});
 
 	QString preference_ini_file = getPreferenceIniFile();
 	QSettings settings(preference_ini_file, QSettings::IniFormat);
@@ -244,6 +341,16 @@ void Preferences::showEvent(QShowEvent *event)
 	setDynamicProperty(ui->sigGenNrPeriods, "valid", true);
 
 	ui->sigGenNrPeriods->setText(QString::number(sig_gen_periods_nr));
+
+	setDynamicProperty(ui->adcKernelBuffers, "invalid", false);
+	setDynamicProperty(ui->adcKernelBuffers, "valid", true);
+	ui->adcKernelBuffers->setText(QString::number(adc_kernel_buffers));
+	setDynamicProperty(ui->memoryBudget, "invalid", false);
+	setDynamicProperty(ui->memoryBudget, "valid", true);
+	ui->memoryBudget->setText(QString::number(memory_budget));
+	setDynamicProperty(ui->acquisitionCores, "invalid", false);
+	setDynamicProperty(ui->acquisitionCores, "valid", true);
+	ui->acquisitionCores->setText(acquisition_cores);
 	ui->oscLabelsCheckBox->setChecked(osc_labels_enabled);
 	ui->saveSessionCheckBox->setChecked(save_session_on_exit);
 	ui->doubleClickCheckBox->setChecked(double_click_to_detach);
@@ -257,6 +364,10 @@ void Preferences::showEvent(QShowEvent *event)
 	ui->oscFilteringCheckBox->setChecked(osc_filtering_enabled);
 	ui->histCheckBox->setChecked(mini_hist_enabled);
 	ui->decodersCheckBox->setChecked(digital_decoders_enabled);
+	ui->lazyToolsCheckBox->setChecked(lazy_tools_enabled);
+	ui->openglCanvasCheckBox->setChecked(opengl_canvas_enabled);
+	ui->gpuFftCheckBox->setChecked(gpu_fft_enabled);
+	ui->acquisitionRealtimeCheckBox->setChecked(acquisition_realtime);
 	ui->oscADCFiltersCheckBox->setChecked(show_ADC_digital_filters);
 	ui->languageCombo->setCurrentText(language);
 
@@ -295,6 +406,88 @@ void Preferences::setDigital_decoders_enabled(bool value)
 	digital_decoders_enabled = value;
 }
 
+bool Preferences::getLazy_tools_enabled() const
+{
+	return lazy_tools_enabled;
+}
+
+void Preferences::setLazy_tools_enabled(bool value)
+{
+	lazy_tools_enabled = value;
+}
+
+int Preferences::getAdc_kernel_buffers() const
+{
+	return adc_kernel_buffers;
+}
+
+void Preferences::setAdc_kernel_buffers(int value)
+{
+	adc_kernel_buffers = value;
+}
+
+int Preferences::getMemory_budget() const
+{
+	return memory_budget;
+}
+
+void Preferences::setMemory_budget(int value)
+{
+	memory_budget = value;
+	MemoryBudget::instance()->setBudget((size_t)value * 1024 * 1024);
+}
+
+bool Preferences::getOpengl_canvas_enabled() const
+{
+	return opengl_canvas_enabled;
+}
+
+void Preferences::setOpengl_canvas_enabled(bool value)
+{
+	opengl_canvas_enabled = value;
+}
+
+bool Preferences::getGpu_fft_enabled() const
+{
+	return gpu_fft_enabled;
+}
+
+void Preferences::setGpu_fft_enabled(bool value)
+{
+	gpu_fft_enabled = value;
+	gpu_power_spectrum::set_enabled(value);
+}
+
+QString Preferences::getAcquisition_cores() const
+{
+	return acquisition_cores;
+}
+
+void Preferences::setAcquisition_cores(const QString& value)
+{
+	std::vector<int> cores;
+
+	if (!parseCores(value, cores))
+		return;
+
+	acquisition_cores = value;
+
+	/* Set from the GUI thread, which takes the cores left over */
+	ThreadScheduling::getInstance().setAcquisitionCores(cores);
+	ThreadScheduling::getInstance().applyToGuiThread();
+}
+
+bool Preferences::getAcquisition_realtime() const
+{
+	return acquisition_realtime;
+}
+
+void Preferences::setAcquisition_realtime(bool value)
+{
+	acquisition_realtime = value;
+	ThreadScheduling::getInstance().setRealtime(value);
+}
+
 bool Preferences::getOsc_filtering_enabled() const
 {
     return osc_filtering_enabled;
@@ -630,6 +823,79 @@ void Preferences_API::setDigitalDecoders(bool enabled)
 {
 	preferencePanel->digital_decoders_enabled = enabled;
 }
+
+bool Preferences_API::getLazyTools() const
+{
+	return preferencePanel->lazy_tools_enabled;
+}
+
+void Preferences_API::setLazyTools(bool enabled)
+{
+	preferencePanel->lazy_tools_enabled = enabled;
+}
+
+int Preferences_API::getAdcKernelBuffers() const
+{
+	return preferencePanel->adc_kernel_buffers;
+}
+
+void Preferences_API::setAdcKernelBuffers(const int& buffers)
+{
+	if (buffers >= 1 && buffers <= 64)
+		preferencePanel->adc_kernel_buffers = buffers;
+}
+
+int Preferences_API::getMemoryBudget() const
+{
+	return preferencePanel->memory_budget;
+}
+
+void Preferences_API::setMemoryBudget(const int& mib)
+{
+	if (mib >= 0)
+		preferencePanel->setMemory_budget(mib);
+}
+
+bool Preferences_API::getOpenGLCanvas() const
+{
+	return preferencePanel->opengl_canvas_enabled;
+}
+
+void Preferences_API::setOpenGLCanvas(bool enabled)
+{
+	preferencePanel->opengl_canvas_enabled = enabled;
+}
+
+bool Preferences_API::getGpuFft() const
+{
+	return preferencePanel->gpu_fft_enabled;
+}
+
+void Preferences_API::setGpuFft(bool enabled)
+{
+	preferencePanel->setGpu_fft_enabled(enabled);
+}
+
+QString Preferences_API::getAcquisitionCores() const
+{
+	return preferencePanel->acquisition_cores;
+}
+
+void Preferences_API::setAcquisitionCores(const QString& cores)
+{
+	preferencePanel->setAcquisition_cores(cores);
+}
+
+bool Preferences_API::getAcquisitionRealtime() const
+{
+	return preferencePanel->acquisition_realtime;
+}
+
+void Preferences_API::setAcquisitionRealtime(bool enabled)
+{
+	preferencePanel->setAcquisition_realtime(enabled);
+}
+
 bool Preferences::hasNativeDialogs() const
 {
     return m_useNativeDialogs;
@@ -100,6 +100,31 @@ public:
 
 	bool getShowADCFilters() const ;
 	void setShowADCFilters(bool value);
+
+	bool getLazy_tools_enabled() const;
+	void setLazy_tools_enabled(bool value);
+
+	int getAdc_kernel_buffers() const;
+	void setAdc_kernel_buffers(int value);
+
+	/* In MiB, 0 for no limit; see MemoryBudget */
+	int getMemory_budget() const;
+	void setMemory_budget(int value);
+
+	bool getOpengl_canvas_enabled() const;
+	void setOpengl_canvas_enabled(bool value);
+
+	/* For the spectra built from then on; see gpu_power_spectrum */
+	bool getGpu_fft_enabled() const;
+	void setGpu_fft_enabled(bool value);
+
+	/* Comma separated core numbers, empty for no dedicated cores;
+	 * see ThreadScheduling */
+	QString getAcquisition_cores() const;
+	void setAcquisition_cores(const QString& value);
+
+	bool getAcquisition_realtime() const;
+	void setAcquisition_realtime(bool value);
  
 	QStringList getLanguageList();
 	QStringList getOptionsList();
@@ -142,6 +167,13 @@ private:
 	bool show_ADC_digital_filters;
 	bool mini_hist_enabled;
 	bool digital_decoders_enabled;
+	bool lazy_tools_enabled;
+	int adc_kernel_buffers;
+	int memory_budget;
+	bool opengl_canvas_enabled;
+	bool gpu_fft_enabled;
+	QString acquisition_cores;
+	bool acquisition_realtime;
 	bool m_initialized;
 	bool m_useNativeDialogs;
 	QString language;
@@ -170,6 +202,13 @@ class Preferences_API : public ApiObject
 	Q_PROPERTY(bool mini_hist_enabled READ getMiniHist WRITE setMiniHist)
 	Q_PROPERTY(bool digital_decoders READ getDigitalDecoders WRITE setDigitalDecoders)
 	Q_PROPERTY(bool show_ADC_digital_filters READ getShowADCDigitalFilters WRITE setShowADCDigitalFilters)
+	Q_PROPERTY(bool lazy_tools READ getLazyTools WRITE setLazyTools)
+	Q_PROPERTY(int adc_kernel_buffers READ getAdcKernelBuffers WRITE setAdcKernelBuffers)
+	Q_PROPERTY(int memory_budget READ getMemoryBudget WRITE setMemoryBudget)
+	Q_PROPERTY(bool opengl_canvas READ getOpenGLCanvas WRITE setOpenGLCanvas)
+	Q_PROPERTY(bool gpu_fft READ getGpuFft WRITE setGpuFft)
+	Q_PROPERTY(QString acquisition_cores READ getAcquisitionCores WRITE setAcquisitionCores)
+	Q_PROPERTY(bool acquisition_realtime READ getAcquisitionRealtime WRITE setAcquisitionRealtime)
 	Q_PROPERTY(QString language READ getLanguage WRITE setLanguage);
 
 public:
@@ -226,6 +265,27 @@ public:
 	bool getDigitalDecoders() const;
 	void setDigitalDecoders(bool enabled);
 
+	bool getLazyTools() const;
+	void setLazyTools(bool enabled);
+
+	int getAdcKernelBuffers() const;
+	void setAdcKernelBuffers(const int& buffers);
+
+	int getMemoryBudget() const;
+	void setMemoryBudget(const int& mib);
+
+	bool getOpenGLCanvas() const;
+	void setOpenGLCanvas(bool enabled);
+
+	bool getGpuFft() const;
+	void setGpuFft(bool enabled);
+
+	QString getAcquisitionCores() const;
+	void setAcquisitionCores(const QString& cores);
+
+	bool getAcquisitionRealtime() const;
+	void setAcquisitionRealtime(bool enabled);
+
 	QString getLanguage() const;
 	void setLanguage(QString lang);
 
@@ -70,13 +70,22 @@ void AnalogSegment::append_interleaved_samples(const float *data,
 	lock_guard<recursive_mutex> lock(mutex_);
 
 	// If we're out of memory, this will throw std::bad_alloc
-	data_.resize((sample_count_ + sample_count) * sizeof(float));
+	set_capacity(sample_count_ + sample_count);
+
+	uint64_t index = sample_count_;
+	const uint64_t end_index = sample_count_ + sample_count;
+	while (index != end_index) {
+		const uint64_t n = min(end_index - index,
+			chunk_samples() - (index & chunk_mask_));
+
+		float *dst = (float*)sample_ptr(index);
+		const float *dst_end = dst + n;
+		while (dst != dst_end) {
+			*dst++ = *data;
+			data += stride;
+		}
 
-	float *dst = (float*)data_.data() + sample_count_;
-	const float *dst_end = dst + sample_count;
-	while (dst != dst_end) {
-		*dst++ = *data;
-		data += stride;
+		index += n;
 	}
 
 	sample_count_ += sample_count;
@@ -97,8 +106,7 @@ const float* AnalogSegment::get_samples(
 	lock_guard<recursive_mutex> lock(mutex_);
 
 	float *const data = new float[end_sample - start_sample];
-	memcpy(data, (float*)data_.data() + start_sample, sizeof(float) *
-		(end_sample - start_sample));
+	read_samples(start_sample, end_sample - start_sample, data);
 	return data;
 }
 
@@ -155,12 +163,11 @@ void AnalogSegment::append_payload_to_envelope_levels()
 
 	dest_ptr = e0.samples + prev_length;
 
-	// Iterate through the samples to populate the first level mipmap
-	const float *const end_src_ptr = (float*)data_.data() +
-		e0.length * EnvelopeScaleFactor;
-	for (const float *src_ptr = (float*)data_.data() +
-			prev_length * EnvelopeScaleFactor;
-			src_ptr < end_src_ptr; src_ptr += EnvelopeScaleFactor) {
+	// Iterate through the samples to populate the first level mipmap,
+	// a chunk of the segment always holds whole groups of samples
+	for (uint64_t index = prev_length; index < e0.length; index++) {
+		const float *src_ptr =
+			(const float*)sample_ptr(index * EnvelopeScaleFactor);
 		const EnvelopeSample sub_sample = {
 			*min_element(src_ptr, src_ptr + EnvelopeScaleFactor),
 			*max_element(src_ptr, src_ptr + EnvelopeScaleFactor),
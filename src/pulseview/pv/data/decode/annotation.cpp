@@ -27,13 +27,17 @@ extern "C" {
 
 #include "annotation.hpp"
 
+using std::make_shared;
+using std::shared_ptr;
+using std::vector;
+
 namespace pv {
 namespace data {
 namespace decode {
 
-Annotation::Annotation(const srd_proto_data *const pdata) :
-	start_sample_(pdata->start_sample),
-	end_sample_(pdata->end_sample)
+Annotation::Annotation(const srd_proto_data *const pdata, uint64_t offset) :
+	start_sample_(pdata->start_sample + offset),
+	end_sample_(pdata->end_sample + offset)
 {
 	assert(pdata);
 	const srd_proto_data_annotation *const pda =
@@ -42,11 +46,23 @@ Annotation::Annotation(const srd_proto_data *const pdata) :
 
 	format_ = pda->ann_class;
 
+	const shared_ptr<vector<QString>> texts = make_shared<vector<QString>>();
 	const char *const *annotations = (char**)pda->ann_text;
 	while (*annotations) {
-		annotations_.push_back(QString::fromUtf8(*annotations));
+		texts->push_back(QString::fromUtf8(*annotations));
 		annotations++;
 	}
+	annotations_ = texts;
+}
+
+Annotation::Annotation(uint64_t start_sample, uint64_t end_sample,
+	int format, shared_ptr<const vector<QString>> annotations) :
+	start_sample_(start_sample),
+	end_sample_(end_sample),
+	format_(format),
+	annotations_(annotations)
+{
+	assert(annotations_);
 }
 
 uint64_t Annotation::start_sample() const
@@ -66,7 +82,7 @@ int Annotation::format() const
 
 const std::vector<QString>& Annotation::annotations() const
 {
-	return annotations_;
+	return *annotations_;
 }
 
 } // namespace decode
@@ -23,6 +23,9 @@
 
 #include <stdint.h>
 
+#include <memory>
+#include <vector>
+
 #include <QString>
 
 struct srd_proto_data;
@@ -34,7 +37,12 @@ namespace decode {
 class Annotation
 {
 public:
-	Annotation(const srd_proto_data *const pdata);
+	/* The offset is where the samples of the session start */
+	Annotation(const srd_proto_data *const pdata, uint64_t offset = 0);
+
+	/* The texts are shared, RowData keeps one copy of each list */
+	Annotation(uint64_t start_sample, uint64_t end_sample, int format,
+		std::shared_ptr<const std::vector<QString>> annotations);
 
 	uint64_t start_sample() const;
 	uint64_t end_sample() const;
@@ -45,7 +53,7 @@ private:
 	uint64_t start_sample_;
 	uint64_t end_sample_;
 	int format_;
-	std::vector<QString> annotations_;
+	std::shared_ptr<const std::vector<QString>> annotations_;
 };
 
 } // namespace decode
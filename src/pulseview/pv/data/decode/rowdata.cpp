@@ -18,8 +18,15 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#include <algorithm>
+#include <cstdint>
+
 #include "rowdata.hpp"
 
+using std::make_shared;
+using std::max;
+using std::min;
+using std::shared_ptr;
 using std::vector;
 
 namespace pv {
@@ -32,24 +39,205 @@ RowData::RowData()
 
 uint64_t RowData::get_max_sample() const
 {
-	if (annotations_.empty())
+	if (start_.empty())
 		return 0;
-	return annotations_.back().end_sample();
+	return max_end_.back();
+}
+
+size_t RowData::first_overlapping(uint64_t start_sample) const
+{
+	return std::upper_bound(max_end_.begin(), max_end_.end(),
+		start_sample) - max_end_.begin();
+}
+
+Annotation RowData::annotation(size_t i) const
+{
+	return Annotation(start_[i], end_[i], format_[i], texts_[text_[i]]);
+}
+
+size_t RowData::size() const
+{
+	return start_.size();
+}
+
+size_t RowData::text_count() const
+{
+	return texts_.size();
 }
 
 void RowData::get_annotation_subset(
 	vector<pv::data::decode::Annotation> &dest,
 	uint64_t start_sample, uint64_t end_sample) const
 {
-	for (const auto& annotation : annotations_)
-		if (annotation.end_sample() > start_sample &&
-			annotation.start_sample() <= end_sample)
-			dest.push_back(annotation);
+	for (size_t i = first_overlapping(start_sample);
+			i < start_.size() && start_[i] <= end_sample; i++)
+		if (end_[i] > start_sample)
+			dest.push_back(annotation(i));
+}
+
+void RowData::get_annotation_blocks(
+	vector<pv::data::decode::Annotation> &dest,
+	vector<Block> &blocks,
+	uint64_t start_sample, uint64_t end_sample,
+	uint64_t min_length) const
+{
+	size_t i = first_overlapping(start_sample);
+
+	while (i < start_.size() && start_[i] <= end_sample) {
+		// Skip over the biggest group starting here which is too
+		// short to be drawn in any detail
+		const Summary *group = nullptr;
+		unsigned int shift = 0;
+
+		for (int level = IndexLevels - 1; level >= 0 && !group; level--) {
+			shift = (level + 1) * IndexScalePower;
+			if ((i & (((size_t)1 << shift) - 1)) != 0)
+				continue;
+
+			const Summary &s = index_[level][i >> shift];
+			if (s.end_sample - s.start_sample < min_length)
+				group = &s;
+		}
+
+		if (!group) {
+			if (end_[i] > start_sample)
+				dest.push_back(annotation(i));
+			i++;
+			continue;
+		}
+
+		// Blocks closer than min_length make a single one
+		if (!blocks.empty() && group->start_sample <=
+				blocks.back().end_sample + min_length) {
+			Block &b = blocks.back();
+			b.end_sample = max(b.end_sample, group->end_sample);
+			if (b.format != group->format)
+				b.format = -1;
+		} else {
+			blocks.push_back({ group->start_sample,
+				group->end_sample, group->format });
+		}
+
+		i = min<size_t>(start_.size(), i + ((size_t)1 << shift));
+	}
 }
 
 void RowData::push_annotation(const Annotation &a)
 {
-	annotations_.push_back(a);
+	// The decoders mostly emit in order, the insertion is then at the
+	// end and only the new annotation is indexed
+	const size_t first = std::upper_bound(start_.begin(), start_.end(),
+		a.start_sample()) - start_.begin();
+	const uint32_t text = intern(a.annotations());
+
+	if (first == start_.size()) {
+		start_.push_back(a.start_sample());
+		end_.push_back(a.end_sample());
+		format_.push_back(a.format());
+		text_.push_back(text);
+	} else {
+		start_.insert(start_.begin() + first, a.start_sample());
+		end_.insert(end_.begin() + first, a.end_sample());
+		format_.insert(format_.begin() + first, a.format());
+		text_.insert(text_.begin() + first, text);
+	}
+
+	index_from(first);
+}
+
+uint32_t RowData::intern(const vector<QString> &texts)
+{
+	const auto it = text_ids_.find(texts);
+	if (it != text_ids_.end())
+		return it->second;
+
+	const uint32_t id = texts_.size();
+	texts_.push_back(make_shared<const vector<QString>>(texts));
+	text_ids_.emplace(texts, id);
+	return id;
+}
+
+void RowData::drop_before(uint64_t sample)
+{
+	// The decoders emit in order, the old annotations are at the front
+	size_t end = 0;
+	while (end < end_.size() && end_[end] <= sample)
+		end++;
+
+	if (end == 0)
+		return;
+
+	start_.erase(start_.begin(), start_.begin() + end);
+	end_.erase(end_.begin(), end_.begin() + end);
+	format_.erase(format_.begin(), format_.begin() + end);
+	text_.erase(text_.begin(), text_.begin() + end);
+	index_from(0);
+
+	// The texts only the dropped annotations used would pile up in a
+	// long running decode
+	if (texts_.size() > 2 * start_.size())
+		compact_texts();
+}
+
+void RowData::compact_texts()
+{
+	vector<uint32_t> remap(texts_.size(), UINT32_MAX);
+	vector<shared_ptr<const vector<QString>>> texts;
+
+	text_ids_.clear();
+	for (uint32_t &t : text_) {
+		if (remap[t] == UINT32_MAX) {
+			remap[t] = texts.size();
+			text_ids_.emplace(*texts_[t], remap[t]);
+			texts.push_back(texts_[t]);
+		}
+		t = remap[t];
+	}
+
+	texts_.swap(texts);
+}
+
+void RowData::index_from(size_t first)
+{
+	max_end_.resize(first);
+	for (size_t i = first; i < end_.size(); i++)
+		max_end_.push_back(max(i ? max_end_[i - 1] : 0, end_[i]));
+
+	// Each level is built from the one below, only the groups from the
+	// one holding the first changed entry are redone
+	size_t from = first;
+	for (unsigned int level = 0; level < IndexLevels; level++) {
+		const size_t count = level ? index_[level - 1].size() :
+			start_.size();
+		const size_t group = from >> IndexScalePower;
+
+		index_[level].resize(group);
+		for (size_t i = group << IndexScalePower; i < count; i++) {
+			if (level) {
+				add_to_group(index_[level], i >> IndexScalePower,
+					index_[level - 1][i]);
+			} else {
+				add_to_group(index_[level], i >> IndexScalePower,
+					{ start_[i], end_[i], format_[i] });
+			}
+		}
+
+		from = group;
+	}
+}
+
+void RowData::add_to_group(vector<Summary> &summaries, size_t group,
+	const Summary &s)
+{
+	if (group == summaries.size()) {
+		summaries.push_back(s);
+		return;
+	}
+
+	Summary &g = summaries[group];
+	g.end_sample = max(g.end_sample, s.end_sample);
+	if (g.format != s.format)
+		g.format = -1;
 }
 
 } // decode
@@ -21,6 +21,8 @@
 #ifndef PULSEVIEW_PV_DATA_DECODE_ROWDATA_HPP
 #define PULSEVIEW_PV_DATA_DECODE_ROWDATA_HPP
 
+#include <map>
+#include <memory>
 #include <vector>
 
 #include "annotation.hpp"
@@ -31,6 +33,29 @@ namespace decode {
 
 class RowData
 {
+public:
+	/**
+	 * A run of annotations too short to tell apart at the current zoom.
+	 */
+	struct Block
+	{
+		uint64_t start_sample;
+		uint64_t end_sample;
+		int format; // -1 when the annotations have different formats
+	};
+
+private:
+	// Level l summarises the groups of 16^(l+1) annotations
+	static const unsigned int IndexLevels = 5;
+	static const unsigned int IndexScalePower = 4;
+
+	struct Summary
+	{
+		uint64_t start_sample;
+		uint64_t end_sample;
+		int format;
+	};
+
 public:
 	RowData();
 
@@ -44,10 +69,59 @@ public:
 		std::vector<pv::data::decode::Annotation> &dest,
 		uint64_t start_sample, uint64_t end_sample) const;
 
+	/**
+	 * Same as get_annotation_subset(), but the groups of annotations
+	 * which all fit in min_length samples come as blocks instead, so
+	 * the work depends on the visible width and not on the number of
+	 * annotations.
+	 */
+	void get_annotation_blocks(
+		std::vector<pv::data::decode::Annotation> &dest,
+		std::vector<Block> &blocks,
+		uint64_t start_sample, uint64_t end_sample,
+		uint64_t min_length) const;
+
 	void push_annotation(const Annotation &a);
 
+	/**
+	 * The number of annotations, and of the distinct text lists they
+	 * refer to.
+	 */
+	size_t size() const;
+	size_t text_count() const;
+
+	/**
+	 * Removes the annotations which end before the sample.
+	 */
+	void drop_before(uint64_t sample);
+
 private:
-	std::vector<Annotation> annotations_;
+	void index_from(size_t first);
+	static void add_to_group(std::vector<Summary> &summaries,
+		size_t group, const Summary &s);
+	size_t first_overlapping(uint64_t start_sample) const;
+
+	Annotation annotation(size_t i) const;
+	uint32_t intern(const std::vector<QString> &texts);
+	void compact_texts();
+
+private:
+	// The annotations as columns, sorted by start sample. A decoder
+	// repeats a few texts over and over, each list is kept once and
+	// the annotations refer to it by index.
+	std::vector<uint64_t> start_;
+	std::vector<uint64_t> end_;
+	std::vector<int> format_;
+	std::vector<uint32_t> text_;
+
+	std::vector<std::shared_ptr<const std::vector<QString>>> texts_;
+	std::map<std::vector<QString>, uint32_t> text_ids_;
+
+	// The latest end of the annotations up to each one, so the first
+	// one reaching a sample is a binary search away
+	std::vector<uint64_t> max_end_;
+
+	std::vector<Summary> index_[IndexLevels];
 };
 
 }
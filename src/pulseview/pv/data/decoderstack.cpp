@@ -20,6 +20,7 @@
 
 #include <libsigrokdecode/libsigrokdecode.h>
 
+#include <cstdint>
 #include <stdexcept>
 
 #include <QDebug>
@@ -33,6 +34,8 @@
 #include "../session.hpp"
 #include "../view/logicsignal.hpp"
 
+#include "pipeline_trace.hpp"
+
 using std::lock_guard;
 using std::mutex;
 using boost::optional;
@@ -55,9 +58,11 @@ namespace data {
 const double DecoderStack::DecodeMargin = 1.0;
 const double DecoderStack::DecodeThreshold = 0.2;
 const int64_t DecoderStack::DecodeChunkLength = 1024 * 16;
+const int64_t DecoderStack::DecodeBatchLength = 1024 * 1024;
 const unsigned int DecoderStack::DecodeNotifyPeriod = 1024;
 
 mutex DecoderStack::global_srd_mutex_;
+DecodeScheduler DecoderStack::scheduler_;
 
 DecoderStack::DecoderStack(pv::Session &session,
 	const srd_decoder *const dec) :
@@ -67,7 +72,10 @@ DecoderStack::DecoderStack(pv::Session &session,
 	sample_count_(0),
 	frame_complete_(false),
 	samples_decoded_(0),
-	active_decode_index_(0)
+	active_decode_index_(0),
+	decode_base_(0),
+	decoding_(false),
+	visible_end_(INT64_MAX)
 {
 	connect(&session_, SIGNAL(frame_began()),
 		this, SLOT(on_new_frame()));
@@ -201,6 +209,20 @@ void DecoderStack::get_annotation_subset(
 			start_sample, end_sample);
 }
 
+void DecoderStack::get_annotation_blocks(
+	std::vector<pv::data::decode::Annotation> &dest,
+	std::vector<RowData::Block> &blocks,
+	const Row &row, uint64_t start_sample,
+	uint64_t end_sample, uint64_t min_length) const
+{
+	lock_guard<mutex> lock(output_mutex_);
+
+	const auto iter = rows_.find(row);
+	if (iter != rows_.end())
+		(*iter).second.get_annotation_blocks(dest, blocks,
+			start_sample, end_sample, min_length);
+}
+
 QString DecoderStack::error_message()
 {
 	lock_guard<mutex> lock(output_mutex_);
@@ -215,6 +237,7 @@ void DecoderStack::clear()
 	error_message_ = QString();
 	rows_.clear();
 	class_rows_.clear();
+	pending_annotations_.clear();
 }
 
 void DecoderStack::stop_decode()
@@ -228,11 +251,67 @@ void DecoderStack::stop_decode()
 	}
 }
 
-void DecoderStack::begin_decode()
+void DecoderStack::set_visible_end(int64_t sample)
+{
+	visible_end_ = sample;
+}
+
+shared_ptr<LogicSegment> DecoderStack::find_segment() const
 {
 	shared_ptr<pv::view::LogicSignal> logic_signal;
 	shared_ptr<pv::data::Logic> data;
 
+	// We get the logic data of the first channel in the list.
+	// This works because we are currently assuming all
+	// LogicSignals have the same data/segment
+	for (const shared_ptr<decode::Decoder> &dec : stack_)
+		if (dec && !dec->channels().empty() &&
+			((logic_signal = (*dec->channels().begin()).second)) &&
+			((data = logic_signal->logic_data())))
+			break;
+
+	if (!data)
+		return nullptr;
+
+	// Check we have a segment of data
+	const deque< shared_ptr<pv::data::LogicSegment> > &segments =
+		data->logic_segments();
+	if (segments.empty())
+		return nullptr;
+	return segments.front();
+}
+
+bool DecoderStack::resume_decode()
+{
+	if (!segment_ || !error_message_.isEmpty() ||
+			find_segment() != segment_)
+		return false;
+
+	{
+		unique_lock<mutex> lock(input_mutex_);
+		sample_count_ = segment_->get_sample_count();
+		frame_complete_ = false;
+	}
+
+	// Still decoding, it only has to know about the new samples
+	if (decoding_) {
+		input_cond_.notify_one();
+		return true;
+	}
+
+	if (decode_thread_.joinable())
+		decode_thread_.join();
+
+	// Keep the annotations, the new thread picks up from the
+	// last decoded sample
+	interrupt_ = false;
+	decoding_ = true;
+	decode_thread_ = std::thread(&DecoderStack::decode_proc, this);
+	return true;
+}
+
+void DecoderStack::begin_decode()
+{
 	if (decode_thread_.joinable()) {
 		interrupt_ = true;
 		input_cond_.notify_one();
@@ -279,24 +358,9 @@ void DecoderStack::begin_decode()
 		}
 	}
 
-	// We get the logic data of the first channel in the list.
-	// This works because we are currently assuming all
-	// LogicSignals have the same data/segment
-	for (const shared_ptr<decode::Decoder> &dec : stack_)
-		if (dec && !dec->channels().empty() &&
-			((logic_signal = (*dec->channels().begin()).second)) &&
-			((data = logic_signal->logic_data())))
-			break;
-
-	if (!data)
-		return;
-
-	// Check we have a segment of data
-	const deque< shared_ptr<pv::data::LogicSegment> > &segments =
-		data->logic_segments();
-	if (segments.empty())
+	segment_ = find_segment();
+	if (!segment_)
 		return;
-	segment_ = segments.front();
 
 	// Get the samplerate and start time
 	start_time_ = segment_->start_time();
@@ -305,6 +369,7 @@ void DecoderStack::begin_decode()
 		samplerate_ = 1.0;
 
 	interrupt_ = false;
+	decoding_ = true;
 	decode_thread_ = std::thread(&DecoderStack::decode_proc, this);
 }
 
@@ -352,49 +417,73 @@ void DecoderStack::decode_data(
 	const unsigned int chunk_sample_count =
 		DecodeChunkLength / segment_->unit_size();
 
-	for (int64_t i = active_decode_index_; !interrupt_ && i < sample_count;
-			i += chunk_sample_count) {
-
-		const int64_t chunk_end = min(
-			i + chunk_sample_count, sample_count);
-		segment_->get_samples(chunk, i, chunk_end);
+	int64_t i = active_decode_index_;
+	bool failed = false;
 
-		if (srd_session_send(session, i, chunk_end, chunk,
-				(chunk_end - i) * unit_size, unit_size) != SRD_OK) {
-			error_message_ = tr("Decoder reported an error");
+	while (!interrupt_ && !failed && i < sample_count) {
+		// The slot goes back after each batch so the other stacks
+		// get their turn
+		if (!scheduler_.acquire(i < visible_end_, interrupt_))
 			break;
-		}
 
-		{
-			lock_guard<mutex> lock(output_mutex_);
-			samples_decoded_ = chunk_end;
+		const int64_t batch_end = min(i + DecodeBatchLength,
+			sample_count);
+
+		while (!interrupt_ && i < batch_end) {
+			PIPELINE_TRACE("decode chunk");
+
+			const int64_t chunk_end = min(
+				i + (int64_t)chunk_sample_count, batch_end);
+
+			// The decoders read the segment in place when they
+			// can, all the stacks share the same samples
+			const uint8_t *samples =
+				segment_->get_samples_ptr(i, chunk_end);
+			if (!samples) {
+				segment_->get_samples(chunk, i, chunk_end);
+				samples = chunk;
+			}
+
+			if (srd_session_send(session, i - decode_base_,
+					chunk_end - decode_base_, samples,
+					(chunk_end - i) * unit_size,
+					unit_size) != SRD_OK) {
+				error_message_ = tr("Decoder reported an error");
+				failed = true;
+				break;
+			}
+
+			{
+				lock_guard<mutex> lock(output_mutex_);
+				samples_decoded_ = chunk_end;
+				push_pending_annotations();
+			}
+
+			if (i % DecodeNotifyPeriod == 0)
+				new_decode_data();
+
+			i = active_decode_index_ = chunk_end;
 		}
 
-		if (i % DecodeNotifyPeriod == 0)
-			new_decode_data();
-
-		active_decode_index_ = chunk_end;
+		scheduler_.release();
 	}
 
 	new_decode_data();
 }
 
-void DecoderStack::decode_proc()
+srd_session* DecoderStack::create_session(int64_t base)
 {
-	optional<int64_t> sample_count;
 	srd_session *session;
 	srd_decoder_inst *prev_di = nullptr;
 
-	assert(segment_);
-
-	// Prevent any other decode threads from accessing libsigrokdecode
+	// Only one thread at a time sets up a session
 	unique_lock<mutex> srd_lock(global_srd_mutex_, std::defer_lock);
 	do {
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	} while (!interrupt_ && !srd_lock.try_lock());
 
 	if (interrupt_) {
-		return;
+		return nullptr;
 	}
 
 	// Create the session
@@ -402,15 +491,13 @@ void DecoderStack::decode_proc()
 	assert(session);
 
 	// Create the decoders
-	const unsigned int unit_size = segment_->unit_size();
-
 	for (const shared_ptr<decode::Decoder> &dec : stack_) {
 		srd_decoder_inst *const di = dec->create_decoder_inst(session);
 
 		if (!di) {
 			error_message_ = tr("Failed to create decoder instance");
 			srd_session_destroy(session);
-			return;
+			return nullptr;
 		}
 
 		if (prev_di)
@@ -419,11 +506,9 @@ void DecoderStack::decode_proc()
 		prev_di = di;
 	}
 
-	// Get the intial sample count
-	{
-		unique_lock<mutex> input_lock(input_mutex_);
-		sample_count = sample_count_ = segment_->get_sample_count();
-	}
+	// The session counts its samples from the base
+	decode_base_ = base;
+	active_decode_index_ = base;
 
 	// Start the session
 	srd_session_metadata_set(session, SRD_CONF_SAMPLERATE,
@@ -434,14 +519,88 @@ void DecoderStack::decode_proc()
 
 	srd_session_start(session);
 
-	do {
-		decode_data(*sample_count, unit_size, session);
-	} while (error_message_.isEmpty() && (sample_count = wait_for_data()));
+	return session;
+}
 
-	// Destroy the session
+void DecoderStack::destroy_session(srd_session *session)
+{
+	lock_guard<mutex> srd_lock(global_srd_mutex_);
 	srd_session_destroy(session);
 }
 
+int64_t DecoderStack::decode_horizon() const
+{
+	return session_.get_decode_horizon() * samplerate_;
+}
+
+void DecoderStack::drop_annotations_before(int64_t sample)
+{
+	if (sample <= 0)
+		return;
+
+	lock_guard<mutex> lock(output_mutex_);
+	for (auto& row : rows_)
+		row.second.drop_before(sample);
+}
+
+void DecoderStack::push_pending_annotations()
+{
+	for (const auto &p : pending_annotations_)
+		p.first->push_annotation(p.second);
+	pending_annotations_.clear();
+}
+
+void DecoderStack::decode_proc()
+{
+	optional<int64_t> sample_count;
+	srd_session *session;
+
+	assert(segment_);
+
+	const unsigned int unit_size = segment_->unit_size();
+
+	// Get the intial sample count
+	{
+		unique_lock<mutex> input_lock(input_mutex_);
+		sample_count = sample_count_ = segment_->get_sample_count();
+	}
+
+	// A resumed decode carries on where the last one stopped
+	session = create_session(active_decode_index_);
+
+	while (session) {
+		const int64_t horizon = decode_horizon();
+
+		// Too far behind the capture, restart closer to its end;
+		// the decoders lose the state of the protocol
+		if (horizon > 0 && *sample_count - active_decode_index_ > horizon) {
+			destroy_session(session);
+			session = create_session(*sample_count - horizon);
+			if (!session)
+				break;
+		}
+
+		decode_data(*sample_count, unit_size, session);
+
+		if (horizon > 0)
+			drop_annotations_before(active_decode_index_ - horizon);
+
+		if (!error_message_.isEmpty() ||
+				!(sample_count = wait_for_data())) {
+			destroy_session(session);
+			break;
+		}
+	}
+
+	// The annotations of a failed chunk or of the end of the session
+	{
+		lock_guard<mutex> lock(output_mutex_);
+		push_pending_annotations();
+	}
+
+	decoding_ = false;
+}
+
 void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
 {
 	assert(pdata);
@@ -450,9 +609,7 @@ void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
 	DecoderStack *const d = (DecoderStack*)decoder;
 	assert(d);
 
-	lock_guard<mutex> lock(d->output_mutex_);
-
-	const Annotation a(pdata);
+	const Annotation a(pdata, d->decode_base_);
 
 	// Find the row
 	assert(pdata->pdo);
@@ -479,12 +636,16 @@ void DecoderStack::annotation_callback(srd_proto_data *pdata, void *decoder)
 		return;
 	}
 
-	// Add the annotation
-	(*row_iter).second.push_annotation(a);
+	// Queue the annotation, the rows get the whole chunk at once
+	d->pending_annotations_.emplace_back(&(*row_iter).second, a);
 }
 
 void DecoderStack::on_new_frame()
 {
+	// More samples of the segment being decoded, no need to start over
+	if (resume_decode())
+		return;
+
 	begin_decode();
 }
 
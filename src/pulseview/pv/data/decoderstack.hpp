@@ -35,6 +35,7 @@
 #include <QObject>
 #include <QString>
 
+#include "decodescheduler.hpp"
 #include "../data/decode/row.hpp"
 #include "../data/decode/rowdata.hpp"
 #include "../util.hpp"
@@ -76,6 +77,7 @@ private:
 	static const double DecodeMargin;
 	static const double DecodeThreshold;
 	static const int64_t DecodeChunkLength;
+	static const int64_t DecodeBatchLength;
 	static const unsigned int DecodeNotifyPeriod;
 
 public:
@@ -106,6 +108,16 @@ public:
 		const decode::Row &row, uint64_t start_sample,
 		uint64_t end_sample) const;
 
+	/**
+	 * Same as get_annotation_subset() with the annotations too dense
+	 * to draw at min_length samples per pixel gathered into blocks.
+	 */
+	void get_annotation_blocks(
+		std::vector<pv::data::decode::Annotation> &dest,
+		std::vector<decode::RowData::Block> &blocks,
+		const decode::Row &row, uint64_t start_sample,
+		uint64_t end_sample, uint64_t min_length) const;
+
 	QString error_message();
 
 	void clear();
@@ -115,6 +127,13 @@ public:
 	void begin_decode();
 	void stop_decode();
 
+	/**
+	 * The last sample on screen. The decode is sequential, so all the
+	 * samples before it are needed, the scheduler favours the stacks
+	 * which have not got there yet.
+	 */
+	void set_visible_end(int64_t sample);
+
 	QString name();
 
 private:
@@ -125,6 +144,22 @@ private:
 
 	void decode_proc();
 
+	std::shared_ptr<LogicSegment> find_segment() const;
+	bool resume_decode();
+
+	/* A session fed from the base sample of the segment, its decoders
+	 * count their samples from there */
+	srd_session* create_session(int64_t base);
+	void destroy_session(srd_session *session);
+
+	/* The samples of annotations kept behind the decode, 0 for all */
+	int64_t decode_horizon() const;
+	void drop_annotations_before(int64_t sample);
+
+	/* Moves the annotations the decoders emitted since the last call
+	 * to their rows, output_mutex_ must be held */
+	void push_pending_annotations();
+
 	static void annotation_callback(srd_proto_data *pdata,
 		void *decoder);
 
@@ -145,13 +180,14 @@ private:
 	double samplerate_;
 
 	/**
-	 * This mutex prevents more than one thread from accessing
-	 * libsigrokdecode concurrently.
-	 * @todo A proper solution should be implemented to allow multiple
-	 * decode operations in parallel.
+	 * This mutex serializes the creation and destruction of the
+	 * libsigrokdecode sessions, the decoding itself runs in parallel
+	 * in the slots of the scheduler.
 	 */
 	static std::mutex global_srd_mutex_;
 
+	static DecodeScheduler scheduler_;
+
 	std::list< std::shared_ptr<decode::Decoder> > stack_;
 
 	std::shared_ptr<pv::data::LogicSegment> segment_;
@@ -164,15 +200,23 @@ private:
 	mutable std::mutex output_mutex_;
 	int64_t	samples_decoded_;
 	int64_t active_decode_index_;
+	int64_t decode_base_;
 
 	std::map<const decode::Row, decode::RowData> rows_;
 
 	std::map<std::pair<const srd_decoder*, int>, decode::Row> class_rows_;
 
+	// Only the decode thread touches these, the callbacks queue the
+	// annotations without taking output_mutex_
+	std::vector<std::pair<decode::RowData*, decode::Annotation>>
+		pending_annotations_;
+
 	QString error_message_;
 
 	std::thread decode_thread_;
 	std::atomic<bool> interrupt_;
+	std::atomic<bool> decoding_;
+	std::atomic<int64_t> visible_end_;
 
 	friend struct DecoderStackTest::TwoDecoderStack;
 
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include "decodescheduler.hpp"
+
+using std::lock_guard;
+using std::mutex;
+using std::unique_lock;
+
+namespace pv {
+namespace data {
+
+DecodeScheduler::DecodeScheduler(unsigned int slots) :
+	free_slots_(slots ? slots :
+		std::max(1u, std::thread::hardware_concurrency())),
+	urgent_waiting_(0)
+{
+}
+
+bool DecodeScheduler::acquire(bool urgent, const std::atomic<bool> &interrupt)
+{
+	unique_lock<mutex> lock(mutex_);
+
+	if (urgent)
+		urgent_waiting_++;
+
+	// The interrupt is not signalled, check it now and then
+	while (!interrupt && (free_slots_ == 0 ||
+			(!urgent && urgent_waiting_ > 0)))
+		cond_.wait_for(lock, std::chrono::milliseconds(10));
+
+	if (urgent) {
+		urgent_waiting_--;
+		cond_.notify_all();
+	}
+
+	if (interrupt)
+		return false;
+
+	free_slots_--;
+	return true;
+}
+
+void DecodeScheduler::release()
+{
+	{
+		lock_guard<mutex> lock(mutex_);
+		free_slots_++;
+	}
+	cond_.notify_all();
+}
+
+} // namespace data
+} // namespace pv
@@ -0,0 +1,68 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef PULSEVIEW_PV_DATA_DECODESCHEDULER_HPP
+#define PULSEVIEW_PV_DATA_DECODESCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace pv {
+namespace data {
+
+/**
+ * Hands out the decode slots, one per core, to the decoder stacks.
+ *
+ * A stack takes a slot for each batch of samples it decodes and gives it
+ * back after, so with more stacks than cores they take turns instead of
+ * the last ones waiting for the whole decode of the first. The stacks
+ * which have not reached the end of the visible samples yet go first.
+ */
+class DecodeScheduler
+{
+public:
+	/**
+	 * @param slots The number of stacks decoding at once, 0 for one
+	 * per core.
+	 */
+	explicit DecodeScheduler(unsigned int slots = 0);
+
+	/**
+	 * Waits for a free slot.
+	 * @param urgent Whether the batch has visible samples.
+	 * @param interrupt Stops the wait when set.
+	 * @return false if interrupted before a slot was free.
+	 */
+	bool acquire(bool urgent, const std::atomic<bool> &interrupt);
+
+	void release();
+
+private:
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	unsigned int free_slots_;
+	unsigned int urgent_waiting_;
+};
+
+} // namespace data
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DATA_DECODESCHEDULER_HPP
@@ -20,6 +20,7 @@
 
 #include <pulseview/extdef.h>
 
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -27,6 +28,8 @@
 
 #include "logicsegment.hpp"
 
+#include <QFile>
+
 #include <libsigrokcxx/libsigrokcxx.hpp>
 
 using std::lock_guard;
@@ -46,16 +49,80 @@ const int LogicSegment::MipMapScaleFactor = 1 << MipMapScalePower;
 const float LogicSegment::LogMipMapScaleFactor = logf(MipMapScaleFactor);
 const uint64_t LogicSegment::MipMapDataUnit = 64*1024;	// bytes
 
+namespace {
+struct CaptureHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t unit_size;
+	uint64_t chunk_samples;
+	uint64_t sample_count;
+	double samplerate;
+};
+
+/*
+ * Bit ch of the count samples load() reads, into the planes from sample
+ * pos on. The samples go 64 at a time, one channel after the other, so
+ * each run is read from the cache and the inner loop vectorizes.
+ */
+template <typename Load>
+void extract_bit_planes(Load load, const uint8_t *data, uint64_t count,
+	uint64_t pos, unsigned int bits,
+	const std::vector<unsigned int> &channels,
+	std::vector< std::vector<uint64_t> > &planes)
+{
+	for (uint64_t k = 0; k < count; ) {
+		const unsigned int bit = pos & 63;
+		const uint64_t run = std::min<uint64_t>(count - k, 64 - bit);
+
+		for (size_t c = 0; c < channels.size(); c++) {
+			const unsigned int ch = channels[c];
+			uint64_t word = 0;
+
+			if (ch >= bits)
+				continue;
+
+			for (uint64_t j = 0; j < run; j++)
+				word |= ((load(data, k + j) >> ch) & 1) << j;
+
+			planes[c][pos >> 6] |= word << bit;
+		}
+
+		k += run;
+		pos += run;
+	}
+}
+
+const char CaptureMagic[8] = { 'S', 'C', 'O', 'P', 'Y', 'L', 'A', '\0' };
+const uint32_t CaptureVersion = 1;
+// The samples start on a page of their own
+const qint64 CaptureDataOffset = 4096;
+
+bool is_power_of_two(uint64_t value)
+{
+	return value && !(value & (value - 1));
+}
+}
+
 LogicSegment::LogicSegment(shared_ptr<Logic> logic, uint64_t samplerate,
 				const uint64_t expected_num_samples) :
-	Segment(samplerate, logic->unit_size()),
+	LogicSegment(logic->unit_size(), samplerate, expected_num_samples)
+{
+}
+
+LogicSegment::LogicSegment(unsigned int unit_size, uint64_t samplerate,
+				const uint64_t expected_num_samples, bool compressed) :
+	Segment(samplerate, unit_size),
 	last_append_sample_(0),
-	replace_mode(false)
+	replace_mode(false),
+	compressed_(compressed)
 {
-	set_capacity(expected_num_samples);
+	if (!compressed_)
+		set_capacity(expected_num_samples);
 
 	lock_guard<recursive_mutex> lock(mutex_);
 	memset(mip_map_, 0, sizeof(mip_map_));
+	edge_cache_.sig_mask = 0;
 }
 
 LogicSegment::~LogicSegment()
@@ -139,27 +206,161 @@ void LogicSegment::pack_sample(uint8_t *ptr, uint64_t value)
 #endif
 }
 
+uint64_t LogicSegment::read_sample(uint64_t index) const
+{
+	// The chunks have no padding, a whole word only fits before the
+	// last samples of a chunk
+	const uint8_t *ptr = sample_ptr(index);
+
+	if ((index & chunk_mask_) * unit_size_ + sizeof(uint64_t) <=
+			chunk_samples() * unit_size_)
+		return unpack_sample(ptr);
+
+	return read_value(ptr);
+}
+
+uint64_t LogicSegment::read_value(const uint8_t *ptr) const
+{
+	uint64_t value = 0;
+	for (unsigned int i = 0; i < unit_size_ && i < sizeof(value); i++)
+		value |= ((uint64_t)ptr[i]) << (8 * i);
+	return value;
+}
+
+void LogicSegment::write_value(uint8_t *ptr, uint64_t value) const
+{
+	for (unsigned int i = 0; i < unit_size_ && i < sizeof(value); i++)
+		ptr[i] = value >> (8 * i);
+}
+
+bool LogicSegment::is_compressed() const
+{
+	return compressed_;
+}
+
+bool LogicSegment::save(const QString &path) const
+{
+	std::vector<uint8_t*> chunks;
+	uint64_t samples;
+
+	// The chunks never move, the lock is not kept while writing
+	{
+		lock_guard<recursive_mutex> lock(mutex_);
+		chunks = chunks_;
+		samples = sample_count_;
+	}
+
+	QFile file(path);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+		return false;
+
+	CaptureHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CaptureMagic, sizeof(header.magic));
+	header.version = CaptureVersion;
+	header.unit_size = unit_size_;
+	header.chunk_samples = chunk_samples();
+	header.sample_count = samples;
+	header.samplerate = samplerate_;
+
+	if (file.write((const char*)&header, sizeof(header)) != sizeof(header))
+		return false;
+
+	const uint64_t stride = chunk_stride();
+	const uint64_t count = (samples + chunk_mask_) >> chunk_shift_;
+	std::vector<uint8_t> expanded;
+
+	for (uint64_t c = 0; c < count; c++) {
+		const uint64_t first = c << chunk_shift_;
+		const uint64_t n = min(chunk_samples(), samples - first);
+		const uint8_t *data;
+
+		// A compressed segment has no chunks, its runs are expanded
+		if (compressed_) {
+			expanded.resize(n * unit_size_);
+			get_samples(expanded.data(), first, first + n);
+			data = expanded.data();
+		} else {
+			data = chunks[c];
+		}
+
+		const qint64 bytes = n * unit_size_;
+		if (!file.seek(CaptureDataOffset + c * stride) ||
+				file.write((const char*)data, bytes) != bytes)
+			return false;
+	}
+
+	// The last chunk is mapped whole too
+	return file.resize(CaptureDataOffset + count * stride);
+}
+
+shared_ptr<LogicSegment> LogicSegment::open(const QString &path)
+{
+	std::unique_ptr<QFile> file(new QFile(path));
+	if (!file->open(QIODevice::ReadOnly))
+		return nullptr;
+
+	CaptureHeader header;
+	if (file->read((char*)&header, sizeof(header)) != sizeof(header) ||
+			memcmp(header.magic, CaptureMagic, sizeof(header.magic)) ||
+			header.version != CaptureVersion ||
+			!is_power_of_two(header.unit_size) ||
+			header.unit_size > sizeof(uint64_t) ||
+			!is_power_of_two(header.chunk_samples))
+		return nullptr;
+
+	shared_ptr<LogicSegment> segment(new LogicSegment(header.unit_size,
+		header.samplerate));
+
+	if (header.chunk_samples != segment->chunk_samples() ||
+			!segment->map_file(std::move(file), CaptureDataOffset,
+				header.sample_count))
+		return nullptr;
+
+	lock_guard<recursive_mutex> lock(segment->mutex_);
+	segment->append_payload_to_mipmap();
+
+	return segment;
+}
+
 void LogicSegment::append_payload(shared_ptr<Logic> logic)
 {
 	assert(unit_size_ == logic->unit_size());
-	assert((logic->data_length() % unit_size_) == 0);
+
+	append_payload(logic->data_pointer(), logic->data_length());
+}
+
+void LogicSegment::replace_payload(shared_ptr<Logic> logic)
+{
+	assert(unit_size_ ==  logic->unit_size());
+
+	replace_payload(logic->data_pointer(), logic->data_length());
+}
+
+void LogicSegment::append_payload(const void *data, uint64_t length)
+{
+	assert((length % unit_size_) == 0);
 
 	lock_guard<recursive_mutex> lock(mutex_);
 
-	append_data(logic->data_pointer(),
-		logic->data_length() / unit_size_);
+	if (compressed_) {
+		append_transitions((const uint8_t*)data, length / unit_size_);
+		return;
+	}
+
+	append_data(data, length / unit_size_);
 	replace_mode = false;
 	// Generate the first mip-map from the data
 	append_payload_to_mipmap();
 }
 
-void LogicSegment::replace_payload(shared_ptr<Logic> logic)
+void LogicSegment::replace_payload(const void *data, uint64_t length)
 {
-	assert(unit_size_ ==  logic->unit_size());
-	assert((logic->data_length() % unit_size_) == 0);
+	assert((length % unit_size_) == 0);
+	assert(!compressed_);
 	lock_guard<recursive_mutex> lock(mutex_);
 	uint64_t previous_active_index = get_active_sample_index();
-	replace_data(logic->data_pointer(), logic->data_length() / unit_size_);
+	replace_data(data, length / unit_size_);
 
 	replace_mode = true;
 	append_payload_to_mipmap(previous_active_index);
@@ -177,8 +378,153 @@ void LogicSegment::get_samples(uint8_t *const data,
 
 	lock_guard<recursive_mutex> lock(mutex_);
 
-	const size_t size = (end_sample - start_sample) * unit_size_;
-	memcpy(data, (const uint8_t*)data_.data() + start_sample * unit_size_, size);
+	if (!compressed_) {
+		read_samples(start_sample, end_sample - start_sample, data);
+		return;
+	}
+
+	// Expand the runs between the transitions
+	uint8_t *dest_ptr = data;
+	auto t = find_transition(start_sample);
+	for (int64_t index = start_sample; index < end_sample; t++) {
+		const auto next = t + 1;
+		const int64_t run_end = (next == transitions_.end()) ?
+			end_sample : min<int64_t>(end_sample, next->index);
+
+		uint8_t value[sizeof(uint64_t)];
+		write_value(value, t->value);
+		for (; index < run_end; index++) {
+			memcpy(dest_ptr, value, unit_size_);
+			dest_ptr += unit_size_;
+		}
+	}
+}
+
+const uint8_t* LogicSegment::get_samples_ptr(int64_t start_sample,
+	int64_t end_sample) const
+{
+	assert(start_sample >= 0);
+	assert(start_sample < end_sample);
+	assert(end_sample <= (int64_t)sample_count_);
+
+	lock_guard<recursive_mutex> lock(mutex_);
+
+	// The ring of the screen mode is rewritten under the reader
+	if (compressed_ || replace_mode)
+		return nullptr;
+
+	if ((uint64_t)start_sample >> chunk_shift_ !=
+			(uint64_t)(end_sample - 1) >> chunk_shift_)
+		return nullptr;
+
+	return sample_ptr(start_sample);
+}
+
+bool LogicSegment::for_each_chunk(int64_t start_sample, int64_t end_sample,
+	const ChunkFunction &f) const
+{
+	assert(start_sample >= 0);
+	assert(start_sample <= end_sample);
+	assert(end_sample <= (int64_t)get_sample_count());
+
+	std::vector<uint8_t> expanded;
+	uint64_t index = start_sample;
+
+	while (index < (uint64_t)end_sample) {
+		lock_guard<recursive_mutex> lock(mutex_);
+
+		const uint64_t count = min<uint64_t>(end_sample - index,
+			chunk_samples() - (index & chunk_mask_));
+		const uint8_t *data;
+
+		if (compressed_) {
+			expanded.resize(count * unit_size_);
+			get_samples(expanded.data(), index, index + count);
+			data = expanded.data();
+		} else {
+			data = sample_ptr(index);
+		}
+
+		if (!f(data, index, count))
+			return false;
+
+		index += count;
+	}
+
+	return true;
+}
+
+void LogicSegment::get_bit_planes(std::vector< std::vector<uint64_t> > &planes,
+	const std::vector<unsigned int> &channels,
+	int64_t start_sample, int64_t end_sample) const
+{
+	const uint64_t words = (end_sample - start_sample + 63) / 64;
+	const unsigned int us = unit_size_;
+	const unsigned int bits = min(us * 8, 64u);
+
+	planes.assign(channels.size(), std::vector<uint64_t>(words, 0));
+
+	for_each_chunk(start_sample, end_sample, [&](const uint8_t *data,
+			uint64_t first, uint64_t count) {
+		const uint64_t pos = first - start_sample;
+
+		switch (us) {
+		case 1:
+			extract_bit_planes([](const uint8_t *p, uint64_t i) {
+				return (uint64_t)p[i];
+			}, data, count, pos, bits, channels, planes);
+			break;
+		case 2:
+			extract_bit_planes([](const uint8_t *p, uint64_t i) {
+				uint16_t v;
+				memcpy(&v, p + i * 2, 2);
+				return (uint64_t)v;
+			}, data, count, pos, bits, channels, planes);
+			break;
+		case 4:
+			extract_bit_planes([](const uint8_t *p, uint64_t i) {
+				uint32_t v;
+				memcpy(&v, p + i * 4, 4);
+				return (uint64_t)v;
+			}, data, count, pos, bits, channels, planes);
+			break;
+		default:
+			extract_bit_planes([&](const uint8_t *p, uint64_t i) {
+				return read_value(p + i * us);
+			}, data, count, pos, bits, channels, planes);
+			break;
+		}
+
+		return true;
+	});
+}
+
+void LogicSegment::append_transitions(const uint8_t *data, uint64_t samples)
+{
+	uint64_t last = transitions_.empty() ? 0 : transitions_.back().value;
+
+	for (uint64_t i = 0; i < samples; i++, data += unit_size_) {
+		const uint64_t value = read_value(data);
+		if (value != last || transitions_.empty()) {
+			transitions_.push_back({ sample_count_ + i, value });
+			last = value;
+		}
+	}
+
+	sample_count_ += samples;
+	total_sample_count_ += samples;
+	active_sample_index_ = total_sample_count_;
+}
+
+std::vector<LogicSegment::Transition>::const_iterator
+LogicSegment::find_transition(uint64_t index) const
+{
+	// The last transition at or before the index
+	auto t = std::upper_bound(transitions_.begin(), transitions_.end(),
+		index, [](uint64_t i, const Transition &tr) {
+			return i < tr.index;
+		});
+	return (t == transitions_.begin()) ? t : t - 1;
 }
 
 void LogicSegment::reallocate_mipmap_level(MipMapLevel &m)
@@ -194,16 +540,118 @@ void LogicSegment::reallocate_mipmap_level(MipMapLevel &m)
 	}
 }
 
-void LogicSegment::append_payload_to_mipmap(uint64_t prev_active)
+namespace {
+/*
+ * The mipmap reductions for the unit sizes of a machine word. They only
+ * use bitwise operations on whole samples, which keeps the bytes in
+ * place whatever the endianness, and the fixed group length lets the
+ * compiler turn the inner loops into vector operations.
+ */
+template <typename T, int Group>
+T reduce_transitions(const T *src, uint64_t groups, T last, T *dest)
+{
+	for (uint64_t g = 0; g < groups; g++, src += Group) {
+		T accumulator = src[0] ^ last;
+		for (int j = 1; j < Group; j++)
+			accumulator |= src[j] ^ src[j - 1];
+		last = src[Group - 1];
+		*dest++ = accumulator;
+	}
+	return last;
+}
+
+template <typename T, int Group>
+void reduce_level(const T *src, uint64_t count, T *dest)
+{
+	for (uint64_t i = 0; i < count; i++, src += Group) {
+		T accumulator = 0;
+		for (int j = 0; j < Group; j++)
+			accumulator |= src[j];
+		dest[i] = accumulator;
+	}
+}
+}
+
+template <typename T>
+void LogicSegment::append_transitions_to_mipmap(uint64_t index,
+	uint64_t end_index, uint8_t *dest)
+{
+	T last = last_append_sample_;
+
+	// A chunk always holds whole groups, each run of them is
+	// contiguous
+	while (index < end_index) {
+		const uint64_t first = index * MipMapScaleFactor;
+		const uint64_t groups = min(end_index - index,
+			(chunk_samples() - (first & chunk_mask_)) /
+				MipMapScaleFactor);
+
+		last = reduce_transitions<T, MipMapScaleFactor>(
+			(const T*)sample_ptr(first), groups, last, (T*)dest);
+		dest += groups * sizeof(T);
+		index += groups;
+	}
+
+	last_append_sample_ = last;
+}
+
+void LogicSegment::compute_mipmap_level0(uint64_t prev_index,
+	uint64_t end_index)
 {
 	MipMapLevel &m0 = mip_map_[0];
-	uint64_t prev_index;
-	uint64_t end_index;
 	const uint8_t *src_ptr;
 	uint8_t *dest_ptr;
 	uint64_t accumulator;
 	unsigned int diff_counter;
 
+	dest_ptr = (uint8_t*)m0.data + prev_index * unit_size_;
+
+	// Iterate through the samples to populate the first level mipmap,
+	// a chunk of the segment always holds whole groups of samples
+	switch (unit_size_) {
+	case 1:
+		append_transitions_to_mipmap<uint8_t>(prev_index, end_index,
+			dest_ptr);
+		break;
+	case 2:
+		append_transitions_to_mipmap<uint16_t>(prev_index, end_index,
+			dest_ptr);
+		break;
+	case 4:
+		append_transitions_to_mipmap<uint32_t>(prev_index, end_index,
+			dest_ptr);
+		break;
+	case 8:
+		append_transitions_to_mipmap<uint64_t>(prev_index, end_index,
+			dest_ptr);
+		break;
+	default:
+		for (uint64_t index = prev_index; index < end_index; index++) {
+			src_ptr = sample_ptr(index * MipMapScaleFactor);
+
+			// Accumulate transitions which have occurred in this sample
+			accumulator = 0;
+			diff_counter = MipMapScaleFactor;
+			while (diff_counter-- > 0) {
+				const uint64_t sample = read_value(src_ptr);
+				accumulator |= last_append_sample_ ^ sample;
+				last_append_sample_ = sample;
+				src_ptr += unit_size_;
+			}
+
+			pack_sample(dest_ptr, accumulator);
+			dest_ptr += unit_size_;
+		}
+		break;
+	}
+}
+
+void LogicSegment::append_payload_to_mipmap(uint64_t prev_active)
+{
+	MipMapLevel &m0 = mip_map_[0];
+	uint64_t prev_index;
+	uint64_t end_index;
+
 	if(replace_mode)
 	{
 		prev_index = (prev_active > active_sample_index_) ? 0 : prev_active / MipMapScaleFactor;
@@ -221,35 +669,26 @@ void LogicSegment::append_payload_to_mipmap(uint64_t prev_active)
 		return;
 
 	reallocate_mipmap_level(m0);
-
-	dest_ptr = (uint8_t*)m0.data + prev_index * unit_size_;
-
-	// Iterate through the samples to populate the first level mipmap
-	const uint8_t *const end_src_ptr = (uint8_t*)data_.data() +
-		end_index * unit_size_ * MipMapScaleFactor;
-	for (src_ptr = (uint8_t*)data_.data() +
-			prev_index * unit_size_ * MipMapScaleFactor;
-			src_ptr < end_src_ptr;) {
-		// Accumulate transitions which have occurred in this sample
-		accumulator = 0;
-		diff_counter = MipMapScaleFactor;
-		while (diff_counter-- > 0) {
-			const uint64_t sample = unpack_sample(src_ptr);
-			accumulator |= last_append_sample_ ^ sample;
-			last_append_sample_ = sample;
-			src_ptr += unit_size_;
-		}
-
-		pack_sample(dest_ptr, accumulator);
-		dest_ptr += unit_size_;
+	compute_mipmap_level0(prev_index, end_index);
+
+	// The higher levels only matter once zoomed out, appended samples
+	// get them when a query needs them. The ring of the replace mode
+	// is small and rewritten in place, it keeps them up to date.
+	if (replace_mode) {
+		update_mipmap_levels(false);
+		update_mipmap_levels(true, prev_index, end_index);
 	}
+}
 
+void LogicSegment::update_mipmap_levels(bool replace, uint64_t prev_index,
+	uint64_t end_index)
+{
 	// Compute higher level mipmaps
 	for (unsigned int level = 1; level < ScaleStepCount; level++) {
 		MipMapLevel &m = mip_map_[level];
 		const MipMapLevel &ml = mip_map_[level-1];
 
-		if(replace_mode) {
+		if(replace) {
 			end_index = end_index / MipMapScaleFactor;
 			prev_index =  prev_index / MipMapScaleFactor;
 		}
@@ -266,13 +705,48 @@ void LogicSegment::append_payload_to_mipmap(uint64_t prev_active)
 
 		reallocate_mipmap_level(m);
 
-		// Subsample the level lower level
-		src_ptr = (uint8_t*)ml.data +
-			unit_size_ * prev_index * MipMapScaleFactor;
-		const uint8_t *const end_dest_ptr =
-			(uint8_t*)m.data + unit_size_ * end_index;
-		for (dest_ptr = (uint8_t*)m.data +
-				unit_size_ * prev_index;
+		reduce_mipmap_level(level, prev_index, end_index > prev_index ?
+			end_index - prev_index : 0);
+	}
+}
+
+void LogicSegment::reduce_mipmap_level(unsigned int level,
+	uint64_t prev_index, uint64_t count)
+{
+	const MipMapLevel &m = mip_map_[level];
+	const MipMapLevel &ml = mip_map_[level-1];
+	uint64_t accumulator;
+	unsigned int diff_counter;
+
+	// Subsample the level lower level
+	const uint8_t *src_ptr = (uint8_t*)ml.data +
+		unit_size_ * prev_index * MipMapScaleFactor;
+	uint8_t *dest_ptr = (uint8_t*)m.data + unit_size_ * prev_index;
+
+	switch (unit_size_) {
+	case 1:
+		reduce_level<uint8_t, MipMapScaleFactor>(
+			(const uint8_t*)src_ptr, count,
+			(uint8_t*)dest_ptr);
+		break;
+	case 2:
+		reduce_level<uint16_t, MipMapScaleFactor>(
+			(const uint16_t*)src_ptr, count,
+			(uint16_t*)dest_ptr);
+		break;
+	case 4:
+		reduce_level<uint32_t, MipMapScaleFactor>(
+			(const uint32_t*)src_ptr, count,
+			(uint32_t*)dest_ptr);
+		break;
+	case 8:
+		reduce_level<uint64_t, MipMapScaleFactor>(
+			(const uint64_t*)src_ptr, count,
+			(uint64_t*)dest_ptr);
+		break;
+	default:
+		for (const uint8_t *const end_dest_ptr = dest_ptr +
+				unit_size_ * count;
 				dest_ptr < end_dest_ptr;
 				dest_ptr += unit_size_) {
 			accumulator = 0;
@@ -284,14 +758,70 @@ void LogicSegment::append_payload_to_mipmap(uint64_t prev_active)
 
 			pack_sample(dest_ptr, accumulator);
 		}
+		break;
 	}
 }
 
+void LogicSegment::update_mipmap_range(uint64_t start_sample,
+	uint64_t end_sample)
+{
+	const MipMapLevel &m0 = mip_map_[0];
+
+	// Recompute the first level blocks covering the range, the
+	// transition of a block depends on the sample before it
+	uint64_t prev_index = start_sample / MipMapScaleFactor;
+	uint64_t end_index = min(end_sample / MipMapScaleFactor + 1,
+		m0.length);
+	if (prev_index >= end_index)
+		return;
+
+	const uint64_t saved_last_sample = last_append_sample_;
+	last_append_sample_ = (prev_index == 0) ? 0 :
+		read_sample(prev_index * MipMapScaleFactor - 1);
+	compute_mipmap_level0(prev_index, end_index);
+	if (end_index < m0.length)
+		last_append_sample_ = saved_last_sample;
+
+	// The higher levels OR the blocks of the level below, only the
+	// ones covering a recomputed block change
+	for (unsigned int level = 1; level < ScaleStepCount; level++) {
+		const MipMapLevel &m = mip_map_[level];
+
+		prev_index /= MipMapScaleFactor;
+		end_index = min((end_index + MipMapScaleFactor - 1) /
+			MipMapScaleFactor, m.length);
+		if (prev_index >= end_index)
+			break;
+
+		reduce_mipmap_level(level, prev_index, end_index - prev_index);
+	}
+}
+
+void LogicSegment::rewrite_payload(uint64_t start_sample, const void *data,
+	uint64_t samples)
+{
+	assert(!compressed_);
+
+	lock_guard<recursive_mutex> lock(mutex_);
+
+	if (start_sample >= sample_count_)
+		return;
+	samples = min(samples, sample_count_ - start_sample);
+	if (samples == 0)
+		return;
+
+	write_samples(start_sample, samples, (const uint8_t*)data);
+	update_mipmap_range(start_sample, start_sample + samples);
+}
+
 uint64_t LogicSegment::get_sample(uint64_t index) const
 {
 //	assert(index < sample_count_);
 
-	return unpack_sample((uint8_t*)data_.data() + index * unit_size_);
+	if (compressed_)
+		return transitions_.empty() ? 0 : find_transition(index)->value;
+
+	return read_sample(index);
 }
 
 void LogicSegment::get_subsampled_edges(
@@ -312,11 +842,24 @@ void LogicSegment::get_subsampled_edges(
 
 	lock_guard<recursive_mutex> lock(mutex_);
 
+	if (compressed_) {
+		get_compressed_edges(edges, start, end, min_length,
+			1ULL << sig_index);
+		return;
+	}
+
 	const uint64_t block_length = (uint64_t)max(min_length, 1.0f);
 	const unsigned int min_level = max((int)floorf(logf(min_length) /
 		LogMipMapScaleFactor) - 1, 0);
 	const uint64_t sig_mask = 1ULL << sig_index;
 
+	// Past the first level the search relies on the higher ones, they
+	// only have to be complete for a coarse query, a fine one just
+	// zooms in earlier on the blocks they do not cover yet
+	if (min_level > 0 || end - start >=
+			(uint64_t)MipMapScaleFactor * MipMapScaleFactor)
+		update_mipmap_levels(false);
+
 	// Store the initial state
 	last_sample = (get_sample(start) & sig_mask) != 0;
 	edges.push_back(pair<int64_t, bool>(index++, last_sample));
@@ -476,6 +1019,119 @@ void LogicSegment::get_subsampled_edges(
 	edges.push_back(pair<int64_t, bool>(end + 1, end_sample));
 }
 
+void LogicSegment::get_subsampled_edges(
+	std::vector< std::vector<EdgePair> > &edges,
+	uint64_t start, uint64_t end,
+	float min_length, uint64_t sig_mask)
+{
+	assert(end <= get_sample_count());
+	assert(start <= end);
+	assert(min_length > 0);
+
+	lock_guard<recursive_mutex> lock(mutex_);
+
+	unsigned int count = 0;
+	while (count < 64 && (sig_mask >> count))
+		count++;
+	edges.assign(count, std::vector<EdgePair>());
+
+	if (compressed_) {
+		for (unsigned int i = 0; i < count; i++)
+			if ((sig_mask >> i) & 1)
+				get_compressed_edges(edges[i], start, end,
+					min_length, 1ULL << i);
+		return;
+	}
+
+	const uint64_t block_length = (uint64_t)max(min_length, 1.0f);
+	const unsigned int min_level = max((int)floorf(logf(min_length) /
+		LogMipMapScaleFactor) - 1, 0);
+
+	if (min_level > 0 || end - start >=
+			(uint64_t)MipMapScaleFactor * MipMapScaleFactor)
+		update_mipmap_levels(false);
+
+	// Store the initial state
+	uint64_t last = get_sample(start);
+	for (unsigned int i = 0; i < count; i++)
+		if ((sig_mask >> i) & 1)
+			edges[i].push_back(EdgePair(start, (last >> i) & 1));
+
+	// Past a mip-map block the blocks of the level of detail are the
+	// grid the changes are taken from, so they come from a few
+	// subsamples instead of the samples
+	const int grid_power = block_length < (uint64_t)MipMapScaleFactor ?
+		0 : (min_level + 1) * MipMapScalePower;
+	const uint64_t grid_mask = (1ULL << grid_power) - 1;
+
+	// Each block starting at a change of any of the signals gives an
+	// edge to the ones that change in it, the bits of all the signals
+	// are tested at once. A block ends on the grid, where the next
+	// search starts, and the samples from the grid line before its
+	// change have none, so no change is counted twice.
+	uint64_t index = start + 1;
+	while (index + block_length <= end) {
+		index = find_change(index, end, sig_mask, min_level);
+		if (index + block_length > end)
+			break;
+
+		const uint64_t final_index = min(end,
+			(index + block_length + grid_mask) & ~grid_mask);
+		const uint64_t changed = get_changes(
+			max(index & ~grid_mask, start + 1), final_index) &
+			sig_mask;
+		const uint64_t final_sample = get_sample(final_index - 1);
+
+		for (unsigned int i = 0; i < count; i++)
+			if ((changed >> i) & 1)
+				edges[i].push_back(EdgePair(index,
+					(final_sample >> i) & 1));
+
+		index = final_index;
+		last = final_sample;
+	}
+
+	// Add the final state
+	const uint64_t end_sample = get_sample(end);
+	for (unsigned int i = 0; i < count; i++) {
+		if (!((sig_mask >> i) & 1))
+			continue;
+		if (((last ^ end_sample) >> i) & 1)
+			edges[i].push_back(EdgePair(end, (end_sample >> i) & 1));
+		edges[i].push_back(EdgePair(end + 1, (end_sample >> i) & 1));
+	}
+}
+
+void LogicSegment::get_subsampled_edges(std::vector<EdgePair> &edges,
+	uint64_t start, uint64_t end,
+	float min_length, int sig_index, uint64_t sig_mask)
+{
+	assert(sig_index >= 0);
+	assert(sig_index < 64);
+
+	lock_guard<recursive_mutex> lock(mutex_);
+	EdgeCache &c = edge_cache_;
+
+	sig_mask |= 1ULL << sig_index;
+
+	if (c.edges.empty() || c.start != start || c.end != end ||
+			c.min_length != min_length ||
+			(c.sig_mask & sig_mask) != sig_mask ||
+			c.total_sample_count != total_sample_count_ ||
+			c.active_sample_index != active_sample_index_) {
+		get_subsampled_edges(c.edges, start, end, min_length,
+			sig_mask);
+		c.start = start;
+		c.end = end;
+		c.min_length = min_length;
+		c.sig_mask = sig_mask;
+		c.total_sample_count = total_sample_count_;
+		c.active_sample_index = active_sample_index_;
+	}
+
+	edges = c.edges[sig_index];
+}
+
 uint64_t LogicSegment::get_subsample(int level, uint64_t offset) const
 {
 	assert(level >= 0);
@@ -484,6 +1140,158 @@ uint64_t LogicSegment::get_subsample(int level, uint64_t offset) const
 		unit_size_ * offset);
 }
 
+uint64_t LogicSegment::find_change(uint64_t index, uint64_t end,
+	uint64_t sig_mask, unsigned int min_level) const
+{
+	unsigned int level = min_level;
+
+	assert(index > 0);
+
+	while (index < end) {
+		const int level_scale_power = (level + 1) * MipMapScalePower;
+		const uint64_t offset = index >> level_scale_power;
+
+		// Single samples past the blocks this level covers
+		if (offset >= mip_map_[level].length) {
+			if (level > 0) {
+				min_level = 0;
+				level--;
+				continue;
+			}
+
+			if ((get_sample(index) ^ get_sample(index - 1)) &
+					sig_mask)
+				return index;
+			index++;
+			continue;
+		}
+
+		// Without a change in the block holding index, skip to its
+		// end, and zoom out while the block around it has none either
+		if (!(get_subsample(level, offset) & sig_mask)) {
+			index = (offset + 1) << level_scale_power;
+
+			const int next_power = level_scale_power + MipMapScalePower;
+			if (level + 1 < ScaleStepCount &&
+					(index >> next_power) < mip_map_[level + 1].length &&
+					!(get_subsample(level + 1, index >> next_power) &
+						sig_mask))
+				level++;
+			continue;
+		}
+
+		// Zoom in on the change. From the level of detail asked the
+		// change is only located to its block, when the block does
+		// not start before index, the change may be behind it.
+		const bool aligned =
+			(index & ((1ULL << level_scale_power) - 1)) == 0;
+		if (level <= min_level && level > 0 && aligned)
+			return index;
+		if (level > 0) {
+			level--;
+			continue;
+		}
+
+		const uint64_t block_end = min(end, (offset + 1) << level_scale_power);
+		for (; index < block_end; index++)
+			if ((get_sample(index) ^ get_sample(index - 1)) & sig_mask)
+				return index;
+	}
+
+	return end;
+}
+
+uint64_t LogicSegment::get_changes(uint64_t index, uint64_t end) const
+{
+	uint64_t changes = 0;
+	uint64_t prev, sample;
+
+	assert(index > 0);
+
+	// The samples up to the first whole block
+	prev = get_sample(index - 1);
+	for (; index < end && (index & (MipMapScaleFactor - 1)); index++) {
+		sample = get_sample(index);
+		changes |= sample ^ prev;
+		prev = sample;
+	}
+
+	// The largest mip-map blocks starting at index inside the range
+	while (index + MipMapScaleFactor <= end &&
+			(index >> MipMapScalePower) < mip_map_[0].length) {
+		unsigned int level = 0;
+		while (level + 1 < ScaleStepCount) {
+			const int power = (level + 2) * MipMapScalePower;
+			if ((index & ((1ULL << power) - 1)) ||
+					index + (1ULL << power) > end ||
+					(index >> power) >= mip_map_[level + 1].length)
+				break;
+			level++;
+		}
+
+		const int power = (level + 1) * MipMapScalePower;
+		changes |= get_subsample(level, index >> power);
+		index += 1ULL << power;
+	}
+
+	// The samples past the last one
+	if (index < end) {
+		prev = get_sample(index - 1);
+		for (; index < end; index++) {
+			sample = get_sample(index);
+			changes |= sample ^ prev;
+			prev = sample;
+		}
+	}
+
+	return changes;
+}
+
+void LogicSegment::get_compressed_edges(std::vector<EdgePair> &edges,
+	uint64_t start, uint64_t end, float min_length, uint64_t sig_mask) const
+{
+	const uint64_t block_length = (uint64_t)max(min_length, 1.0f);
+
+	// The transitions already are the edges, so instead of a mip-map
+	// search only the ones of this signal have to be picked
+	bool last_sample = (get_sample(start) & sig_mask) != 0;
+	edges.push_back(pair<int64_t, bool>(start, last_sample));
+
+	uint64_t index = start + 1;
+	auto t = std::lower_bound(transitions_.begin(), transitions_.end(),
+		index, [](const Transition &tr, uint64_t i) {
+			return tr.index < i;
+		});
+
+	while (true) {
+		while (t != transitions_.end() &&
+				((t->value & sig_mask) != 0) == last_sample)
+			t++;
+		if (t == transitions_.end() || t->index + block_length > end)
+			break;
+
+		index = t->index;
+		const uint64_t final_index = index + block_length;
+
+		// Take the last sample of the quantization block
+		uint64_t value = t->value;
+		for (t++; t != transitions_.end() && t->index < final_index; t++)
+			value = t->value;
+
+		const bool final_sample = (value & sig_mask) != 0;
+		edges.push_back(pair<int64_t, bool>(index, final_sample));
+
+		index = final_index;
+		last_sample = final_sample;
+	}
+
+	// Add the final state
+	const bool end_sample = get_sample(end) & sig_mask;
+	if (last_sample != end_sample)
+		edges.push_back(pair<int64_t, bool>(end, end_sample));
+	edges.push_back(pair<int64_t, bool>(end + 1, end_sample));
+}
+
 uint64_t LogicSegment::pow2_ceil(uint64_t x, unsigned int power)
 {
 	const uint64_t p = 1 << power;
@@ -23,6 +23,7 @@
 
 #include "segment.hpp"
 
+#include <functional>
 #include <utility>
 #include <vector>
 
@@ -51,6 +52,12 @@ private:
 		void *data;
 	};
 
+	struct Transition
+	{
+		uint64_t index;
+		uint64_t value;
+	};
+
 private:
 	static const unsigned int ScaleStepCount = 10;
 	static const int MipMapScalePower;
@@ -61,26 +68,119 @@ private:
 public:
 	typedef std::pair<int64_t, bool> EdgePair;
 
+	/**
+	 * Gets count samples from the first one on, returns false to stop.
+	 */
+	typedef std::function<bool(const uint8_t *data, uint64_t first,
+		uint64_t count)> ChunkFunction;
+
 public:
 	LogicSegment(std::shared_ptr<sigrok::Logic> logic,
 		uint64_t samplerate, uint64_t expected_num_samples = 0);
+	/**
+	 * A compressed segment only keeps the samples where the value
+	 * changes, which suits the slow signals of long captures. It can
+	 * only be appended to, replace_payload() is not supported.
+	 */
+	LogicSegment(unsigned int unit_size, uint64_t samplerate,
+		uint64_t expected_num_samples = 0, bool compressed = false);
 
 	virtual ~LogicSegment();
 
 	void append_payload(std::shared_ptr<sigrok::Logic> logic);
 	void replace_payload(std::shared_ptr<sigrok::Logic> logic);
 
+	/**
+	 * Appends length bytes of samples of unit_size() bytes each, the
+	 * data is copied.
+	 */
+	void append_payload(const void *data, uint64_t length);
+	void replace_payload(const void *data, uint64_t length);
+
+	/**
+	 * Overwrites the samples from start_sample on in place, only the
+	 * mipmap blocks covering them are recomputed. The segment must not
+	 * be compressed, samples past its end are dropped.
+	 */
+	void rewrite_payload(uint64_t start_sample, const void *data,
+		uint64_t samples);
+
 	void get_samples(uint8_t *const data,
 		int64_t start_sample, int64_t end_sample) const;
 	uint64_t get_sample(uint64_t index) const;
 
+	/**
+	 * The samples from start_sample to end_sample in place, or nullptr
+	 * when they are not stored contiguously and get_samples() has to
+	 * copy them. They stay valid while the segment exists.
+	 */
+	const uint8_t* get_samples_ptr(int64_t start_sample,
+		int64_t end_sample) const;
+
+	/**
+	 * Walks the samples from start_sample to end_sample a chunk at a
+	 * time, read only. The samples are given in place where they are
+	 * stored, copied only for a compressed segment, and a uint64_t can
+	 * be read at any of them. The segment is locked while f has a chunk
+	 * and not in between, so a capture going on is only held back for
+	 * one chunk at a time.
+	 * @return false if f stopped the walk.
+	 */
+	bool for_each_chunk(int64_t start_sample, int64_t end_sample,
+		const ChunkFunction &f) const;
+
+	/**
+	 * The bit planes of channels for the samples from start_sample to
+	 * end_sample: planes[i] holds bit channels[i] of each sample, 64
+	 * samples per word, sample n at bit n % 64 of word n / 64. The
+	 * bits past the last sample are zero.
+	 */
+	void get_bit_planes(std::vector< std::vector<uint64_t> > &planes,
+		const std::vector<unsigned int> &channels,
+		int64_t start_sample, int64_t end_sample) const;
+
+	bool is_compressed() const;
+
+	/**
+	 * Writes the samples to a capture file, the chunks are written as
+	 * they are, without a copy, at the offsets open() maps them back
+	 * from, so a capture is reloaded without reading it through.
+	 */
+	bool save(const QString &path) const;
+	static std::shared_ptr<LogicSegment> open(const QString &path);
+
 private:
 	uint64_t unpack_sample(const uint8_t *ptr) const;
 	void pack_sample(uint8_t *ptr, uint64_t value);
+
+	/* Same as unpack_sample() and pack_sample() but they never touch
+	 * the bytes past the sample, for buffers without padding */
+	uint64_t read_value(const uint8_t *ptr) const;
+	void write_value(uint8_t *ptr, uint64_t value) const;
+
+	/* A sample of the chunks, unpacked without reading past them */
+	uint64_t read_sample(uint64_t index) const;
+
+	void append_transitions(const uint8_t *data, uint64_t samples);
+	std::vector<Transition>::const_iterator find_transition(
+		uint64_t index) const;
 	
 	void reallocate_mipmap_level(MipMapLevel &m);
 
 	void append_payload_to_mipmap(uint64_t prev_active=0);
+	void compute_mipmap_level0(uint64_t prev_index, uint64_t end_index);
+
+	template <typename T>
+	void append_transitions_to_mipmap(uint64_t index, uint64_t end_index,
+		uint8_t *dest);
+
+	/* Extends the levels past the first one to the samples it covers,
+	 * or recomputes the blocks of the range rewritten in replace mode */
+	void update_mipmap_levels(bool replace, uint64_t prev_index = 0,
+		uint64_t end_index = 0);
+	void reduce_mipmap_level(unsigned int level, uint64_t prev_index,
+		uint64_t count);
+	void update_mipmap_range(uint64_t start_sample, uint64_t end_sample);
 
 
 
@@ -99,9 +199,45 @@ public:
 		uint64_t start, uint64_t end,
 		float min_length, int sig_index);
 
+	/**
+	 * The same edges for all the signals of sig_mask in one pass,
+	 * edges[i] holds the ones of signal i. Where several signals
+	 * change in a block of min_length samples they all get their
+	 * edge at its first change.
+	 */
+	void get_subsampled_edges(std::vector< std::vector<EdgePair> > &edges,
+		uint64_t start, uint64_t end,
+		float min_length, uint64_t sig_mask);
+
+	/**
+	 * The edges of one signal out of a pass over all the signals of
+	 * sig_mask. The pass is kept until the range, the level of detail
+	 * or the samples change, so the other signals painted with the
+	 * same parameters, or a repaint that did not move the view, only
+	 * copy theirs.
+	 */
+	void get_subsampled_edges(std::vector<EdgePair> &edges,
+		uint64_t start, uint64_t end,
+		float min_length, int sig_index, uint64_t sig_mask);
+
 private:
 	uint64_t get_subsample(int level, uint64_t offset) const;
 
+	/* The first sample from index on where one of the signals of
+	 * sig_mask changes, end if there is none. From min_level up the
+	 * change is only located to the start of its block at that level,
+	 * that is the sample past index at most */
+	uint64_t find_change(uint64_t index, uint64_t end,
+		uint64_t sig_mask, unsigned int min_level = 0) const;
+
+	/* The signals changing between the samples from index to end and
+	 * the ones before them */
+	uint64_t get_changes(uint64_t index, uint64_t end) const;
+
+	void get_compressed_edges(std::vector<EdgePair> &edges,
+		uint64_t start, uint64_t end,
+		float min_length, uint64_t sig_mask) const;
+
 	static uint64_t pow2_ceil(uint64_t x, unsigned int power);
 
 private:
@@ -109,6 +245,23 @@ private:
 	uint64_t last_append_sample_;
 	bool replace_mode;
 
+	// The compressed samples, the first one at index 0 and then one
+	// for every change of the value
+	const bool compressed_;
+	std::vector<Transition> transitions_;
+
+	struct EdgeCache
+	{
+		uint64_t start;
+		uint64_t end;
+		float min_length;
+		uint64_t sig_mask;
+		uint64_t total_sample_count;
+		uint64_t active_sample_index;
+		std::vector< std::vector<EdgePair> > edges;
+	};
+	EdgeCache edge_cache_;
+
 	friend struct LogicSegmentTest::Pow2;
 	friend struct LogicSegmentTest::Basic;
 	friend struct LogicSegmentTest::LargeData;
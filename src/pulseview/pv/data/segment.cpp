@@ -20,6 +20,10 @@
 
 #include "segment.hpp"
 
+#include <QTemporaryFile>
+
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
@@ -30,7 +34,11 @@ using std::recursive_mutex;
 namespace pv {
 namespace data {
 
+const uint64_t Segment::ChunkSize = 2 * 1024 * 1024;	// bytes
+
 Segment::Segment(uint64_t samplerate, unsigned int unit_size) :
+	chunk_shift_(4),
+	spill_limit_(0),
 	sample_count_(0),
 	total_sample_count_(0),
 	start_time_(0),
@@ -41,6 +49,11 @@ Segment::Segment(uint64_t samplerate, unsigned int unit_size) :
 {
 	lock_guard<recursive_mutex> lock(mutex_);
 	assert(unit_size_ > 0);
+
+	// The mipmaps read whole groups of 16 samples from a chunk
+	while (((uint64_t)unit_size_ << (chunk_shift_ + 1)) <= ChunkSize)
+		chunk_shift_++;
+	chunk_mask_ = (1ULL << chunk_shift_) - 1;
 }
 
 Segment::~Segment()
@@ -85,8 +98,29 @@ void Segment::set_capacity(const uint64_t new_capacity)
 
 	assert(capacity_ >= sample_count_);
 	if (new_capacity > capacity_) {
+		const uint64_t chunk_bytes = chunk_samples() * unit_size_;
+
 		// If we're out of memory, this will throw std::bad_alloc
-		data_.resize((new_capacity * unit_size_) + sizeof(uint64_t));
+		// No padding word, a chunk of 2 MiB is one huge page; the
+		// reads stop at the end of the chunk
+		while ((chunks_.size() << chunk_shift_) < new_capacity) {
+			uint8_t *chunk = nullptr;
+
+			if (spill_limit_ > 0 && capacity() >= spill_limit_)
+				chunk = map_chunk(chunk_bytes);
+
+			// Without a file the chunk stays in memory, in
+			// pages faulted in already and kept for the next
+			// capture once the segment goes away
+			if (!chunk) {
+				owned_chunks_.emplace_back(static_cast<uint8_t*>(
+					adiscope::CaptureBufferPool::getInstance()
+					.allocate(chunk_bytes)));
+				chunk = owned_chunks_.back().get();
+			}
+
+			chunks_.push_back(chunk);
+		}
 		capacity_ = new_capacity;
 	}
 }
@@ -94,10 +128,131 @@ void Segment::set_capacity(const uint64_t new_capacity)
 uint64_t Segment::capacity() const
 {
 	lock_guard<recursive_mutex> lock(mutex_);
-	return data_.size();
+	return (chunks_.size() << chunk_shift_) * unit_size_;
+}
+
+uint64_t Segment::memory_used() const
+{
+	lock_guard<recursive_mutex> lock(mutex_);
+	return owned_chunks_.size() * chunk_samples() * unit_size_;
+}
+
+void Segment::set_spill(uint64_t memory_limit, const QString &dir)
+{
+	lock_guard<recursive_mutex> lock(mutex_);
+
+	spill_limit_ = memory_limit;
+	spill_dir_ = dir;
+}
+
+uint64_t Segment::chunk_stride() const
+{
+	// Whole pages keep every mapping aligned. The word past the chunk
+	// is part of the file format, it is never read
+	const uint64_t page = 4096;
+	const uint64_t bytes = chunk_samples() * unit_size_ + sizeof(uint64_t);
+
+	return (bytes + page - 1) / page * page;
+}
+
+bool Segment::map_file(std::unique_ptr<QFile> file, int64_t offset,
+	uint64_t samples)
+{
+	lock_guard<recursive_mutex> lock(mutex_);
+	assert(chunks_.empty());
+
+	// A sample count the file can't hold would wrap the chunk count
+	const qint64 size = file->size();
+	if (offset < 0 || size < offset ||
+			samples > (uint64_t)(size - offset) / unit_size_)
+		return false;
+
+	const uint64_t stride = chunk_stride();
+	const uint64_t count = (samples + chunk_mask_) >> chunk_shift_;
+
+	if ((uint64_t)(size - offset) / stride < count)
+		return false;
+
+	std::vector<uint8_t*> chunks;
+	for (uint64_t c = 0; c < count; c++) {
+		uint8_t *chunk = file->map(offset + c * stride, stride,
+			QFileDevice::MapPrivateOption);
+
+		// The mappings made so far go away with the file
+		if (!chunk)
+			return false;
+		chunks.push_back(chunk);
+	}
+
+	chunks_.swap(chunks);
+	mapped_file_ = std::move(file);
+	sample_count_ = samples;
+	total_sample_count_ = samples;
+	active_sample_index_ = samples;
+	capacity_ = samples;
+	return true;
+}
+
+uint8_t* Segment::map_chunk(uint64_t bytes)
+{
+	// Whole pages keep every mapping aligned
+	const uint64_t page = 4096;
+	bytes = (bytes + page - 1) / page * page;
+
+	if (!spill_file_) {
+		spill_file_.reset(new QTemporaryFile(
+			spill_dir_ + "/scopy-segment-XXXXXX.raw"));
+		if (!spill_file_->open()) {
+			spill_file_.reset();
+			spill_limit_ = 0;
+			return nullptr;
+		}
+	}
+
+	// The file grows with zeros, as the chunks in memory start
+	const qint64 offset = spill_file_->size();
+	if (!spill_file_->resize(offset + bytes))
+		return nullptr;
+
+	return spill_file_->map(offset, bytes);
+}
+
+uint64_t Segment::chunk_samples() const
+{
+	return chunk_mask_ + 1;
+}
+
+void Segment::read_samples(uint64_t index, uint64_t count, void *dest) const
+{
+	uint8_t *dest_ptr = (uint8_t*)dest;
+
+	while (count > 0) {
+		const uint64_t n = std::min(count,
+			chunk_samples() - (index & chunk_mask_));
+
+		memcpy(dest_ptr, sample_ptr(index), n * unit_size_);
+		dest_ptr += n * unit_size_;
+		index += n;
+		count -= n;
+	}
+}
+
+void Segment::write_samples(uint64_t index, uint64_t count, const void *src)
+{
+	const uint8_t *src_ptr = (const uint8_t*)src;
+
+	while (count > 0) {
+		const uint64_t n = std::min(count,
+			chunk_samples() - (index & chunk_mask_));
+
+		memcpy(sample_ptr(index), src_ptr, n * unit_size_);
+		src_ptr += n * unit_size_;
+		index += n;
+		count -= n;
+	}
 }
 
-void Segment::append_data(void *data, uint64_t samples)
+void Segment::append_data(const void *data, uint64_t samples)
 {
 	lock_guard<recursive_mutex> lock(mutex_);
 
@@ -108,14 +263,13 @@ void Segment::append_data(void *data, uint64_t samples)
 	if (free_space < samples)
 		set_capacity(sample_count_ + samples);
 
-	memcpy((uint8_t*)data_.data() + sample_count_ * unit_size_,
-		data, samples * unit_size_);
+	write_samples(sample_count_, samples, data);
 	sample_count_ += samples;
 	total_sample_count_ += samples;
 	active_sample_index_ = total_sample_count_;
 }
 
-void Segment::replace_data(void *data, uint64_t samples)
+void Segment::replace_data(const void *data, uint64_t samples)
 {
         lock_guard<recursive_mutex> lock(mutex_);
         assert(capacity_ == sample_count_);
@@ -126,14 +280,12 @@ void Segment::replace_data(void *data, uint64_t samples)
         if( samples > free_space )
                 samples_to_copy = free_space;
 
-        memcpy((uint8_t*)data_.data() + active_sample_index_ * unit_size_,
-               data, samples_to_copy * unit_size_);
+        write_samples(active_sample_index_, samples_to_copy, data);
 
         if(samples_to_copy !=  samples) {
                 samples_left =  samples - samples_to_copy;
-                memcpy((uint8_t*)data_.data(),
-                        (uint8_t*)data + samples_to_copy * unit_size_,
-                        samples_left * unit_size_);
+                write_samples(0, samples_left,
+                        (const uint8_t*)data + samples_to_copy * unit_size_);
         }
         total_sample_count_ += samples;
         active_sample_index_ = total_sample_count_ % capacity_;
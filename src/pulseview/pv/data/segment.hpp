@@ -21,10 +21,15 @@
 #ifndef PULSEVIEW_PV_DATA_SEGMENT_HPP
 #define PULSEVIEW_PV_DATA_SEGMENT_HPP
 #include "../util.hpp"
+#include "capture_buffer_pool.hpp"
 #include <thread>
+#include <memory>
 #include <mutex>
 #include <vector>
 
+class QFile;
+class QTemporaryFile;
+
 namespace pv {
 namespace data {
 
@@ -50,7 +55,9 @@ public:
 	 * @brief Increase the capacity of the segment.
 	 *
 	 * Increasing the capacity allows samples to be appended without needing
-	 * to reallocate memory.
+	 * to allocate memory. The samples are kept in chunks of about
+	 * @c ChunkSize bytes, growing the segment only adds chunks and never
+	 * moves the samples already stored.
 	 *
 	 * For the best efficiency @c set_capacity() should be called once before
 	 * @c append_data() is called to set up the segment with the expected number
@@ -73,13 +80,73 @@ public:
 	 */
 	uint64_t capacity() const;
 
+	/**
+	 * @brief The bytes of the chunks held in memory, the ones mapped
+	 * from a file are left out.
+	 */
+	uint64_t memory_used() const;
+
+	/**
+	 * @brief Keep the samples past a size in a file.
+	 *
+	 * Once the segment holds @c memory_limit bytes the next chunks are
+	 * memory-mapped from a temporary file created in @c dir, so a deep
+	 * capture is bounded by the disk instead of the RAM. The file goes
+	 * away with the segment.
+	 *
+	 * @param[in] memory_limit The bytes kept in memory, 0 never spills.
+	 * @param[in] dir The directory of the temporary file.
+	 */
+	void set_spill(uint64_t memory_limit, const QString &dir);
+
 protected:
-	void append_data(void *data, uint64_t samples);
-	void replace_data(void *data, uint64_t samples);
+	void append_data(const void *data, uint64_t samples);
+	void replace_data(const void *data, uint64_t samples);
+
+	/**
+	 * The address of a sample. The samples of a chunk are contiguous,
+	 * @c chunk_samples() of them, a power of two, so any aligned run of
+	 * up to that many samples is contiguous too.
+	 */
+	uint8_t* sample_ptr(uint64_t index) const
+	{
+		return chunks_[index >> chunk_shift_] +
+			(index & chunk_mask_) * unit_size_;
+	}
+
+	uint64_t chunk_samples() const;
+	uint8_t* map_chunk(uint64_t bytes);
+
+	/**
+	 * The bytes a chunk takes in a file, whole pages with room for a
+	 * word past the samples, so each chunk can be mapped on its own.
+	 */
+	uint64_t chunk_stride() const;
+
+	/**
+	 * Maps the chunks of an empty segment from a file, stored from
+	 * @c offset every @c chunk_stride() bytes. The mappings are private,
+	 * the segment never writes to the file. It keeps the file open.
+	 */
+	bool map_file(std::unique_ptr<QFile> file, int64_t offset,
+		uint64_t samples);
+
+	void read_samples(uint64_t index, uint64_t count, void *dest) const;
+	void write_samples(uint64_t index, uint64_t count, const void *src);
 
 protected:
+	static const uint64_t ChunkSize;
+
 	mutable std::recursive_mutex mutex_;
-	std::vector<uint8_t> data_;
+	std::vector<uint8_t*> chunks_;
+	std::vector<std::unique_ptr<uint8_t,
+		adiscope::CaptureBufferPool::Deleter>> owned_chunks_;
+	std::unique_ptr<QTemporaryFile> spill_file_;
+	std::unique_ptr<QFile> mapped_file_;
+	uint64_t spill_limit_;
+	QString spill_dir_;
+	unsigned int chunk_shift_;
+	uint64_t chunk_mask_;
 	uint64_t sample_count_;
 	uint64_t total_sample_count_;
 	uint64_t active_sample_index_;
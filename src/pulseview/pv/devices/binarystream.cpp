@@ -26,9 +26,10 @@
 #include <iio.h>
 #include <iostream>
 #include "logic_analyzer.hpp"
-
-using std::recursive_mutex;
-using std::lock_guard;
+#include "acquisition_clock.h"
+#include "replay_file.hpp"
+#include "pipeline_trace.hpp"
+#include "thread_scheduling.hpp"
 
 namespace pv {
 namespace devices {
@@ -51,7 +52,15 @@ BinaryStream::BinaryStream(const std::shared_ptr<sigrok::Context> &context,
 	autoTrigger(false),
         data_(nullptr),
         stream_mode(false),
-        actual_buffersize(0)
+        actual_buffersize(0),
+        holdoff_ms_(-1),
+	trigger_armed_(false),
+        blocks_head_(0),
+        blocks_tail_(0),
+        refilled_samples_(0),
+        has_block_time_(false),
+        block_time_(0),
+        block_sample_(0)
 {
 	/* 10 buffers, 10ms each -> 250ms before we lose data */
 	if(dev)
@@ -59,6 +68,11 @@ BinaryStream::BinaryStream(const std::shared_ptr<sigrok::Context> &context,
 }
 
 BinaryStream::~BinaryStream() {
+	interrupt_ = true;
+	if (data_)
+		iio_buffer_cancel(data_);
+	stop_refill();
+
 	if (session_)
 		close();
 	input_.reset();
@@ -129,13 +143,32 @@ void BinaryStream::run()
 {
 	if(!dev_)
 		return;
+
+	adiscope::ThreadScheduling::AcquisitionScope acquisitionScope;
+
 	if( running )
 		stop();
 	running = true;
 	size_t nrx = 0;
 	size_t size_to_display;
 	input_->reset();
+
+	/* The input module still sends the header and the end of the
+	 * frames when the samples skip it, an empty send has it start */
+	if (logic_callback_)
+		input_->send(nullptr, 0);
+
+	stream_trigger_.reset();
+	protocol_trigger_.reset();
+	history_.clear();
+	trigger_armed_ = stream_mode && history_.capacity() > 0 &&
+		(stream_trigger_.enabled() || protocol_trigger_.enabled());
+
 	interrupt_ = false;
+	start_refill();
+
+	adiscope::PipelineTrace::setThreadName("LA capture");
+
         while (!interrupt_)
         {
                 nbytes_rx = 0;
@@ -144,11 +177,18 @@ void BinaryStream::run()
                         la->startTimeout();
                 }
 
-                lock_guard<recursive_mutex> lock(data_mutex_);
-		if(data_)
+		Block *block = next_block();
+		if (!block)
+			continue;
+
+		char *samples = block->data;
+		nbytes_rx = block->length;
+
 		{
-                        nbytes_rx = iio_buffer_refill(data_);
-			std::this_thread::sleep_for(std::chrono::milliseconds(5)); // implement soft holdoff of 5ms
+			std::lock_guard<std::mutex> lock(time_mutex_);
+			has_block_time_ = true;
+			block_time_ = block->time;
+			block_sample_ = block->first_sample;
 		}
 
                 if( nbytes_rx > 0 ) {
@@ -156,19 +196,45 @@ void BinaryStream::run()
                                 nbytes_rx -= ((actual_buffersize-buffersize_) * 2);
                         }
 
+			if (trigger_armed_) {
+				const uint16_t *words =
+					reinterpret_cast<const uint16_t *>(samples);
+				const int64_t hit = protocol_trigger_.enabled() ?
+					protocol_trigger_.find(words, nbytes_rx / 2) :
+					stream_trigger_.find(words, nbytes_rx / 2);
+
+				if (hit < 0) {
+					history_.push(samples, nbytes_rx);
+					release_block();
+					continue;
+				}
+
+				/* The history from before the trigger goes
+				 * first, the rest of the block after it */
+				history_.push(samples, hit * 2);
+				const size_t pre = history_.size();
+				history_.drain([this](const char *data, size_t length) {
+					send(const_cast<char *>(data), length);
+				});
+				samples += hit * 2;
+				nbytes_rx -= hit * 2;
+				nrx += pre;
+				trigger_armed_ = false;
+				la->streamTriggered(pre);
+			}
+
                         nrx += nbytes_rx / 2;
                         size_to_display = (nrx > entire_buffersize && !stream_mode) ?
                                                 nbytes_rx-2*(nrx-entire_buffersize) : nbytes_rx;
-                        if(data_)
-                                input_->send(iio_buffer_start(data_), (size_t)(size_to_display));
+                        send(samples, (size_t)(size_to_display));
                         la->bufferSentSignal(false);
 
                         if( nrx >= entire_buffersize && !stream_mode) {
                                 size_t remaining_samples = 2 * (nrx - entire_buffersize);
                                 if( !single_ ) {
                                         input_->end();
-                                        if(data_ && remaining_samples > 0)
-                                                input_->send((char*)iio_buffer_start(data_)+(size_t)(size_to_display),
+                                        if(remaining_samples > 0)
+                                                send(samples+(size_t)(size_to_display),
                                                      remaining_samples);
                                         nrx = 0;
                                         la->bufferSentSignal(true);
@@ -182,16 +248,179 @@ void BinaryStream::run()
                         if( single_ && running && nrx >= entire_buffersize) {
                                 running = false;
                                 interrupt_ = true;
+                                release_block();
                                 stop();
                                 nrx = 0;
+                                continue;
                         }
                 }
+
+		release_block();
         }
+        stop_refill();
         input_->end();
         interrupt_ = false;
         single_ = false;
 }
 
+void BinaryStream::start_refill()
+{
+	stop_refill();
+
+	std::lock_guard<std::mutex> lock(refill_mutex_);
+
+	blocks_head_ = 0;
+	blocks_tail_ = 0;
+	refilled_samples_ = 0;
+
+	/* A replay file given for the logic analyzer stands in for the
+	 * samples of the device, paced to its sample rate */
+	replay_ = adiscope::ReplayFile::open(adiscope::ReplayFile::LOGIC);
+	if (replay_) {
+		double rate = 0;
+
+		iio_device_attr_read_double(dev_, "sampling_frequency", &rate);
+		replay_->setRate(rate * sizeof(uint16_t));
+	}
+
+	refill_thread_ = std::thread(&BinaryStream::refill_proc, this);
+}
+
+void BinaryStream::stop_refill()
+{
+	wake_blocks();
+
+	/* Both stop() and the end of run() get here */
+	std::lock_guard<std::mutex> lock(refill_mutex_);
+
+	if (refill_thread_.joinable() &&
+			refill_thread_.get_id() != std::this_thread::get_id())
+		refill_thread_.join();
+}
+
+void BinaryStream::refill_proc()
+{
+	const int holdoff = holdoff_ms_ >= 0 ? holdoff_ms_ :
+		(stream_mode ? 0 : 5);
+
+	adiscope::PipelineTrace::setThreadName("LA refill");
+
+	/* A refill overwrites the IIO buffer, run() must be done with it */
+	const size_t depth = replay_ ? nb_blocks : 1;
+
+	while (!interrupt_ && data_) {
+		/* Wait for run() to be done with the oldest block */
+		{
+			std::unique_lock<std::mutex> lock(blocks_mutex_);
+			blocks_cond_.wait(lock, [this, depth]() {
+				return interrupt_ ||
+					blocks_tail_ - blocks_head_ < depth;
+			});
+		}
+
+		if (interrupt_)
+			break;
+
+		/* The mutex is never held while waiting for the samples */
+		Block &block = blocks_[blocks_tail_ % nb_blocks];
+		ssize_t nbytes;
+
+		if (replay_) {
+			nbytes = actual_buffersize * sizeof(uint16_t);
+			block.bytes.resize(nbytes);
+			replay_->read(block.bytes.data(), nbytes);
+			block.data = block.bytes.data();
+		} else {
+			PIPELINE_TRACE("iio_buffer_refill");
+
+			nbytes = iio_buffer_refill(data_);
+			block.data = static_cast<char *>(iio_buffer_start(data_));
+		}
+
+		if (nbytes > 0) {
+			block.time = adiscope::acquisition_clock::now();
+			block.first_sample = refilled_samples_;
+			refilled_samples_ += nbytes / 2;
+
+			block.length = nbytes;
+			blocks_tail_.fetch_add(1, std::memory_order_release);
+			wake_blocks();
+		}
+
+		/* Soft holdoff, limits the refresh rate of the screen mode */
+		if (holdoff > 0)
+			std::this_thread::sleep_for(
+				std::chrono::milliseconds(holdoff));
+	}
+}
+
+bool BinaryStream::last_block_time(uint64_t &time, uint64_t &sample) const
+{
+	std::lock_guard<std::mutex> lock(time_mutex_);
+
+	time = block_time_;
+	sample = block_sample_;
+	return has_block_time_;
+}
+
+BinaryStream::Block *BinaryStream::next_block()
+{
+	if (blocks_head_ == blocks_tail_.load(std::memory_order_acquire)) {
+		std::unique_lock<std::mutex> lock(blocks_mutex_);
+
+		/* Wakes up now and then to restart the auto trigger timeout */
+		blocks_cond_.wait_for(lock, std::chrono::milliseconds(100),
+			[this]() {
+				return interrupt_ || blocks_head_ !=
+					blocks_tail_.load(std::memory_order_acquire);
+			});
+	}
+
+	if (blocks_head_ == blocks_tail_.load(std::memory_order_acquire))
+		return nullptr;
+
+	/* Held until release_block(), stop() waits on it before the IIO
+	 * buffer the block points into goes */
+	consume_mutex_.lock();
+
+	return &blocks_[blocks_head_ % nb_blocks];
+}
+
+void BinaryStream::release_block()
+{
+	consume_mutex_.unlock();
+	blocks_head_.fetch_add(1, std::memory_order_release);
+	wake_blocks();
+}
+
+void BinaryStream::wake_blocks()
+{
+	/* Taking the mutex once orders the wake up after the waiter saw
+	 * the old indexes */
+	{
+		std::lock_guard<std::mutex> lock(blocks_mutex_);
+	}
+	blocks_cond_.notify_all();
+}
+
+void BinaryStream::set_holdoff(int ms)
+{
+	holdoff_ms_ = ms;
+}
+
+void BinaryStream::send(void *data, size_t length)
+{
+	/* The samples go from the IIO buffer to the segment in a single
+	 * copy, the input module would first append them to its own
+	 * buffer. The stream is always 16 channels, 2 bytes a sample. */
+	PIPELINE_TRACE("LA samples to segment");
+
+	if (logic_callback_)
+		logic_callback_(data, length, 2);
+	else
+		input_->send(data, length);
+}
+
 void BinaryStream::set_timeout(bool checked)
 {
 	autoTrigger = checked;
@@ -236,6 +465,19 @@ void BinaryStream::set_stream(bool check)
     stream_mode = check;
 }
 
+void BinaryStream::set_stream_trigger(const StreamTrigger &trigger,
+	size_t pretrigger_samples)
+{
+	stream_trigger_ = trigger;
+	if (history_.capacity() != pretrigger_samples)
+		history_.set_capacity(pretrigger_samples, 2);
+}
+
+void BinaryStream::set_protocol_trigger(const ProtocolTrigger &trigger)
+{
+	protocol_trigger_ = trigger;
+}
+
 void BinaryStream::set_options(std::map<std::string, Glib::VariantBase> opt)
 {
 	options_ = opt;
@@ -262,8 +504,14 @@ void BinaryStream::stop()
 	single_ = false;
 	if(data_ )
 		iio_buffer_cancel(data_);
+
+	/* The refill thread must be out of the buffer before it goes */
+	stop_refill();
+
 	if( data_ )
 	{
+		std::lock_guard<std::mutex> lock(consume_mutex_);
+
 		iio_buffer_destroy(data_);
 		data_ = nullptr;
 	}
@@ -24,9 +24,13 @@
 
 #include <libsigrokcxx/libsigrokcxx.hpp>
 #include "device.hpp"
+#include "pretrigger.hpp"
+#include "protocoltrigger.hpp"
+#include <condition_variable>
 #include <thread>
 #include <mutex>
 #include <memory>
+#include <vector>
 
 
 extern "C" {
@@ -35,6 +39,7 @@ extern "C" {
 }
 namespace adiscope {
 	class LogicAnalyzer;
+	class ReplayFile;
 }
 
 namespace pv {
@@ -89,9 +94,33 @@ public:
 
         void set_stream(bool check);
 
+	/**
+	 * Pause after each refill, in ms. A negative value keeps the
+	 * default, 5 ms in screen mode and none when streaming.
+	 */
+	void set_holdoff(int ms);
+
+	/**
+	 * In stream mode, holds the samples back until the trigger is met
+	 * in software, then sends up to pretrigger_samples of the history
+	 * before it. Taken at the next run.
+	 */
+	void set_stream_trigger(const StreamTrigger &trigger,
+		size_t pretrigger_samples);
+
+	/// Triggers on a bus word instead, if enabled.
+	void set_protocol_trigger(const ProtocolTrigger &trigger);
+
         bool get_single();
 
         bool is_running();
+
+	/**
+	 * Acquisition time (acquisition_clock.h, in ns) of the refill of
+	 * the last block sent, and index of its first sample since the
+	 * start of the acquisition; false before the first one.
+	 */
+	bool last_block_time(uint64_t &time, uint64_t &sample) const;
 private:
 	const std::shared_ptr<sigrok::Context> context_;
 	const std::shared_ptr<sigrok::InputFormat> format_;
@@ -100,6 +129,34 @@ private:
 	struct iio_buffer *data_;
 	struct iio_device *dev_;
 	void shutdown();
+	void send(void *data, size_t length);
+
+	/*
+	 * A thread refills the IIO buffer and hands each refill to run()
+	 * through a ring of blocks; only the refill thread moves the tail
+	 * and only run() the head, so the indexes need no lock.
+	 *
+	 * A block of the device points into the IIO buffer, which the next
+	 * refill reuses, so there is one in the ring at a time and the
+	 * kernel buffers queue the samples meanwhile. The blocks of a
+	 * replay file hold their own bytes and fill the whole ring.
+	 */
+	struct Block {
+		std::vector<char> bytes;
+		char *data;
+		ssize_t length;
+		/* acquisition_clock time of the refill, index of the first
+		 * sample since the start */
+		uint64_t time;
+		uint64_t first_sample;
+	};
+
+	void start_refill();
+	void stop_refill();
+	void refill_proc();
+	Block *next_block();
+	void release_block();
+	void wake_blocks();
 	std::ifstream *f;
 	std::atomic<bool> interrupt_;
 	size_t buffersize_;
@@ -110,8 +167,28 @@ private:
 	adiscope::LogicAnalyzer* la;
 	bool autoTrigger;
 	ssize_t nbytes_rx;
-	mutable std::recursive_mutex data_mutex_;
         bool stream_mode;
+	int holdoff_ms_;
+	StreamTrigger stream_trigger_;
+	ProtocolTrigger protocol_trigger_;
+	PreTriggerBuffer history_;
+	bool trigger_armed_;
+
+	static const size_t nb_blocks = 8;
+	Block blocks_[nb_blocks];
+	std::atomic<size_t> blocks_head_;
+	std::atomic<size_t> blocks_tail_;
+	std::thread refill_thread_;
+	std::mutex refill_mutex_;
+	std::mutex blocks_mutex_;
+	std::mutex consume_mutex_;
+	std::condition_variable blocks_cond_;
+	uint64_t refilled_samples_;
+	std::shared_ptr<adiscope::ReplayFile> replay_;
+
+	mutable std::mutex time_mutex_;
+	bool has_block_time_;
+	uint64_t block_time_, block_sample_;
 };
 
 } // namespace devices
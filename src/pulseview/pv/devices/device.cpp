@@ -57,6 +57,11 @@ std::shared_ptr<sigrok::Device> Device::device() const
 	return device_;
 }
 
+void Device::set_logic_callback(LogicCallback callback)
+{
+	logic_callback_ = callback;
+}
+
 template
 uint64_t Device::read_config(const sigrok::ConfigKey*,
 	const uint64_t);
@@ -21,6 +21,7 @@
 #ifndef PULSEVIEW_PV_DEVICES_DEVICE_HPP
 #define PULSEVIEW_PV_DEVICES_DEVICE_HPP
 
+#include <functional>
 #include <memory>
 #include <string>
 
@@ -38,6 +39,17 @@ namespace devices {
 
 class Device
 {
+public:
+	/**
+	 * Receives logic samples straight from the device, without going
+	 * through a sigrok packet.
+	 * @param data The samples, unit_size bytes each.
+	 * @param length The length of the data, in bytes.
+	 * @param unit_size The size of a sample, in bytes.
+	 */
+	typedef std::function<void (const void *data, size_t length,
+		unsigned int unit_size)> LogicCallback;
+
 protected:
 	Device();
 
@@ -74,9 +86,16 @@ public:
 
 	virtual void stop();
 
+	/**
+	 * Sets the receiver of the logic samples of the devices able to
+	 * skip the sigrok packets. The others ignore it.
+	 */
+	void set_logic_callback(LogicCallback callback);
+
 protected:
 	std::shared_ptr<sigrok::Session> session_;
 	std::shared_ptr<sigrok::Device> device_;
+	LogicCallback logic_callback_;
 };
 
 } // namespace devices
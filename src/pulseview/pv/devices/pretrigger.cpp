@@ -0,0 +1,136 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "pretrigger.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using std::min;
+
+namespace pv {
+namespace devices {
+
+const size_t PreTriggerBuffer::MaxSamples = 64 * 1024 * 1024;
+
+StreamTrigger::StreamTrigger() :
+	rising(0),
+	falling(0),
+	high(0),
+	low(0),
+	match_all(false),
+	prev_(0),
+	has_prev_(false)
+{
+}
+
+bool StreamTrigger::enabled() const
+{
+	return (rising | falling | high | low) != 0;
+}
+
+void StreamTrigger::reset()
+{
+	has_prev_ = false;
+}
+
+int64_t StreamTrigger::find(const uint16_t *samples, size_t count)
+{
+	const uint16_t used = rising | falling | high | low;
+
+	if (!used || count == 0)
+		return -1;
+
+	// An edge needs the sample before, the first one of the stream
+	// can only meet the levels
+	if (!has_prev_) {
+		prev_ = samples[0];
+		has_prev_ = true;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		const uint16_t cur = samples[i];
+		const uint16_t met =
+			(~prev_ & cur & rising) | (prev_ & ~cur & falling) |
+			(cur & high) | (~cur & low);
+
+		prev_ = cur;
+
+		if (match_all ? (met & used) == used : (met & used) != 0)
+			return i;
+	}
+
+	return -1;
+}
+
+PreTriggerBuffer::PreTriggerBuffer() :
+	unit_size_(1),
+	head_(0),
+	size_(0)
+{
+}
+
+void PreTriggerBuffer::set_capacity(size_t samples, unsigned int unit_size)
+{
+	unit_size_ = unit_size;
+	data_.assign(min(samples, MaxSamples) * unit_size, 0);
+	data_.shrink_to_fit();
+	clear();
+}
+
+size_t PreTriggerBuffer::capacity() const
+{
+	return data_.size() / unit_size_;
+}
+
+size_t PreTriggerBuffer::size() const
+{
+	return size_ / unit_size_;
+}
+
+void PreTriggerBuffer::clear()
+{
+	head_ = 0;
+	size_ = 0;
+}
+
+void PreTriggerBuffer::push(const char *data, size_t length)
+{
+	const size_t bytes = data_.size();
+
+	if (bytes == 0)
+		return;
+
+	// Only the newest samples fit
+	if (length > bytes) {
+		data += length - bytes;
+		length = bytes;
+	}
+
+	const size_t first = min(length, bytes - head_);
+	memcpy(&data_[head_], data, first);
+	memcpy(&data_[0], data + first, length - first);
+
+	head_ = (head_ + length) % bytes;
+	size_ = min(size_ + length, bytes);
+}
+
+} // namespace devices
+} // namespace pv
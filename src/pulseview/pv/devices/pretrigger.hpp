@@ -0,0 +1,121 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef PULSEVIEW_PV_DEVICES_PRETRIGGER_HPP
+#define PULSEVIEW_PV_DEVICES_PRETRIGGER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pv {
+namespace devices {
+
+/**
+ * A trigger condition on the samples of a 16 channel stream, for the
+ * stream mode where the hardware trigger only starts the stream.
+ *
+ * A bit set in a mask puts that condition on the channel; a channel
+ * with both edges set fires on either. With match_all every channel with
+ * a condition must meet it on the same sample, otherwise any of them.
+ */
+class StreamTrigger
+{
+public:
+	StreamTrigger();
+
+	uint16_t rising;
+	uint16_t falling;
+	uint16_t high;
+	uint16_t low;
+	bool match_all;
+
+	bool enabled() const;
+
+	/// Forget the last sample, for when the stream is not contiguous.
+	void reset();
+
+	/**
+	 * The index in [0, count) of the first sample meeting the
+	 * condition, -1 if none does. The edges are taken from the last
+	 * sample of the previous call.
+	 */
+	int64_t find(const uint16_t *samples, size_t count);
+
+private:
+	uint16_t prev_;
+	bool has_prev_;
+};
+
+/**
+ * Keeps the last samples of a stream while it waits for a trigger found
+ * in software, the oldest ones being overwritten, so that the history
+ * from before the trigger can be sent once it fires.
+ */
+class PreTriggerBuffer
+{
+public:
+	/// The most samples kept, whatever is asked for.
+	static const size_t MaxSamples;
+
+	PreTriggerBuffer();
+
+	/// Capacity in samples, 0 keeps none. Clears the history.
+	void set_capacity(size_t samples, unsigned int unit_size);
+	size_t capacity() const;
+
+	/// The samples held.
+	size_t size() const;
+
+	void clear();
+
+	void push(const char *data, size_t length);
+
+	/**
+	 * Hands the history to f(data, length), oldest first, in at most
+	 * two runs, then clears it.
+	 */
+	template<typename F>
+	void drain(F f)
+	{
+		const size_t bytes = data_.size();
+		const size_t tail = (head_ + bytes - size_) % (bytes ? bytes : 1);
+
+		if (size_ > 0 && tail + size_ > bytes) {
+			f(&data_[tail], bytes - tail);
+			f(&data_[0], size_ - (bytes - tail));
+		} else if (size_ > 0) {
+			f(&data_[tail], size_);
+		}
+
+		clear();
+	}
+
+private:
+	std::vector<char> data_;
+	unsigned int unit_size_;
+	size_t head_;
+	size_t size_;
+};
+
+} // namespace devices
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DEVICES_PRETRIGGER_HPP
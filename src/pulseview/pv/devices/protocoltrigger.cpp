@@ -0,0 +1,234 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include "protocoltrigger.hpp"
+
+#include <cmath>
+
+namespace pv {
+namespace devices {
+
+ProtocolTrigger::ProtocolTrigger() :
+	type(None),
+	channels{0, 1, -1},
+	value(0),
+	mask(0xff),
+	bits(8),
+	samples_per_bit(0),
+	rising_edge(true),
+	pos_(0),
+	has_prev_(false),
+	prev_(0),
+	in_word_(false),
+	word_start_(0),
+	taken_(0),
+	shift_(0)
+{
+}
+
+bool ProtocolTrigger::enabled() const
+{
+	if (bits == 0 || bits > 32 || channels[0] < 0 || channels[0] > 15)
+		return false;
+
+	switch (type) {
+	case Uart:
+		return samples_per_bit >= 2;
+	case I2c:
+	case Spi:
+		return channels[1] >= 0 && channels[1] <= 15 &&
+			channels[2] <= 15;
+	default:
+		return false;
+	}
+}
+
+void ProtocolTrigger::reset()
+{
+	pos_ = 0;
+	has_prev_ = false;
+	in_word_ = false;
+	taken_ = 0;
+	shift_ = 0;
+}
+
+bool ProtocolTrigger::matches() const
+{
+	return ((shift_ ^ value) & mask) == 0;
+}
+
+int64_t ProtocolTrigger::find(const uint16_t *samples, size_t count)
+{
+	if (count == 0 || !enabled())
+		return -1;
+
+	if (!has_prev_) {
+		prev_ = samples[0];
+		has_prev_ = true;
+	}
+
+	int64_t hit;
+
+	switch (type) {
+	case Uart:
+		hit = find_uart(samples, count);
+		break;
+	case I2c:
+		hit = find_i2c(samples, count);
+		break;
+	default:
+		hit = find_spi(samples, count);
+		break;
+	}
+
+	// prev_ only needs to be right at the end of a call
+	prev_ = samples[hit < 0 ? count - 1 : hit];
+	pos_ += count;
+
+	return hit;
+}
+
+int64_t ProtocolTrigger::find_uart(const uint16_t *samples, size_t count)
+{
+	const uint16_t rx = 1 << channels[0];
+	uint16_t prev = prev_;
+	size_t i = 0;
+
+	while (i < count) {
+		if (!in_word_) {
+			// Wait for the falling edge of a start bit
+			for (; i < count; i++) {
+				if ((prev & rx) && !(samples[i] & rx))
+					break;
+				prev = samples[i];
+			}
+
+			if (i == count)
+				break;
+
+			in_word_ = true;
+			word_start_ = pos_ + i;
+			taken_ = 0;
+			shift_ = 0;
+		}
+
+		// Only the middle of each bit is looked at: the start bit,
+		// the data bits and the stop bit
+		const uint64_t next = word_start_ +
+			(uint64_t)((taken_ + 0.5) * samples_per_bit);
+
+		if (next >= pos_ + count)
+			break;
+
+		i = next - pos_;
+		const bool level = samples[i] & rx;
+
+		if (taken_ == 0 && level) {
+			// A glitch, not a start bit
+			in_word_ = false;
+		} else if (taken_ > 0 && taken_ <= bits) {
+			shift_ |= (uint32_t)level << (taken_ - 1);
+		} else if (taken_ > bits) {
+			in_word_ = false;
+			if (level && matches())
+				return i;
+		}
+
+		taken_++;
+		prev = samples[i];
+		i++;
+	}
+
+	return -1;
+}
+
+int64_t ProtocolTrigger::find_i2c(const uint16_t *samples, size_t count)
+{
+	const uint16_t scl = 1 << channels[0];
+	const uint16_t sda = 1 << channels[1];
+	uint16_t prev = prev_;
+
+	for (size_t i = 0; i < count; i++) {
+		const uint16_t cur = samples[i];
+		const uint16_t changed = prev ^ cur;
+
+		prev = cur;
+
+		if (!changed)
+			continue;
+
+		if ((changed & sda) && (cur & scl) && !(changed & scl)) {
+			// SDA falling with SCL high is a start, rising a stop
+			in_word_ = !(cur & sda);
+			taken_ = 0;
+			shift_ = 0;
+		} else if (in_word_ && (changed & scl) && (cur & scl)) {
+			shift_ = (shift_ << 1) | !!(cur & sda);
+			if (++taken_ == 8) {
+				in_word_ = false;
+				if (matches())
+					return i;
+			}
+		}
+	}
+
+	return -1;
+}
+
+int64_t ProtocolTrigger::find_spi(const uint16_t *samples, size_t count)
+{
+	const uint16_t clk = 1 << channels[0];
+	const uint16_t data = 1 << channels[1];
+	const uint16_t cs = channels[2] < 0 ? 0 : 1 << channels[2];
+	const uint32_t word_mask = bits == 32 ? ~0u : (1u << bits) - 1;
+	uint16_t prev = prev_;
+
+	for (size_t i = 0; i < count; i++) {
+		const uint16_t cur = samples[i];
+		const uint16_t changed = prev ^ cur;
+
+		prev = cur;
+
+		if (!changed)
+			continue;
+
+		// A word starts when the chip is selected
+		if (cur & cs) {
+			taken_ = 0;
+			shift_ = 0;
+			continue;
+		}
+
+		if ((changed & clk) && !!(cur & clk) == rising_edge) {
+			shift_ = ((shift_ << 1) | !!(cur & data)) & word_mask;
+			if (++taken_ == bits) {
+				taken_ = 0;
+				if (matches())
+					return i;
+				shift_ = 0;
+			}
+		}
+	}
+
+	return -1;
+}
+
+} // namespace devices
+} // namespace pv
@@ -0,0 +1,99 @@
+/*
+ * This file is part of the PulseView project.
+ *
+ * Copyright (C) 2019 Analog Devices Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef PULSEVIEW_PV_DEVICES_PROTOCOLTRIGGER_HPP
+#define PULSEVIEW_PV_DEVICES_PROTOCOLTRIGGER_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace pv {
+namespace devices {
+
+/**
+ * A trigger on the content of a bus, decoded by a small state machine
+ * as the samples come in instead of by the protocol decoders, so it
+ * keeps up with the stream.
+ *
+ * The word received is compared to value on the bits set in mask:
+ * - Uart: the data bits of a frame, LSB first, idle high and one stop
+ *   bit, on channels[0]. It fires on the middle of the stop bit.
+ * - I2c: the first byte after a (repeated) start, the address and
+ *   the R/W bit, with SCL on channels[0] and SDA on channels[1]. It
+ *   fires on the SCL edge of the last bit.
+ * - Spi: a word of bits, MSB first, sampled on a clock edge, with the
+ *   clock on channels[0], the data on channels[1] and an active low
+ *   chip select on channels[2], -1 for none. Without a chip select the
+ *   words are counted from the start of the stream.
+ */
+class ProtocolTrigger
+{
+public:
+	enum Type {
+		None,
+		Uart,
+		I2c,
+		Spi,
+	};
+
+	ProtocolTrigger();
+
+	Type type;
+	int channels[3];
+	uint32_t value;
+	uint32_t mask;
+	/// Bits in a word, for the UART and SPI.
+	unsigned int bits;
+	/// Samples in a UART bit, the samplerate over the baud rate.
+	double samples_per_bit;
+	/// The SPI data is sampled on the rising clock edge.
+	bool rising_edge;
+
+	bool enabled() const;
+
+	/// Back to waiting for a word, for when the stream is not contiguous.
+	void reset();
+
+	/**
+	 * The index in [0, count) of the sample the matching word ends
+	 * on, -1 if none does. A word can span several calls.
+	 */
+	int64_t find(const uint16_t *samples, size_t count);
+
+private:
+	int64_t find_uart(const uint16_t *samples, size_t count);
+	int64_t find_i2c(const uint16_t *samples, size_t count);
+	int64_t find_spi(const uint16_t *samples, size_t count);
+
+	bool matches() const;
+
+	uint64_t pos_;
+	bool has_prev_;
+	uint16_t prev_;
+	bool in_word_;
+	uint64_t word_start_;
+	unsigned int taken_;
+	uint32_t shift_;
+};
+
+} // namespace devices
+} // namespace pv
+
+#endif // PULSEVIEW_PV_DEVICES_PROTOCOLTRIGGER_HPP
@@ -98,6 +98,9 @@ Session::Session(DeviceManager &device_manager) :
 	timeSpan(0),
 	timespanLimitStream(0),
 	screen_mode_(false),
+	logic_compression_(false),
+	spill_limit_(0),
+	decode_horizon_(0),
 	entire_buffersize_(0)
 {
 }
@@ -162,6 +165,15 @@ void Session::set_device(shared_ptr<devices::Device> device)
 		(shared_ptr<sigrok::Device> device, shared_ptr<Packet> packet) {
 			data_feed_in(device, packet);
 		});
+	device_->set_logic_callback([=]
+		(const void *data, size_t length, unsigned int unit_size) {
+			try {
+				feed_in_logic(data, length, unit_size);
+			} catch (std::bad_alloc) {
+				out_of_memory_ = true;
+				device_->stop();
+			}
+		});
 
 	update_signals();
 	device_selected();
@@ -428,6 +440,32 @@ bool Session::is_screen_mode()
 	return screen_mode_;
 }
 
+void Session::set_logic_compression(bool value)
+{
+	logic_compression_ = value;
+}
+
+bool Session::is_logic_compression() const
+{
+	return logic_compression_;
+}
+
+void Session::set_spill(uint64_t memory_limit, const QString &dir)
+{
+	spill_limit_ = memory_limit;
+	spill_dir_ = dir;
+}
+
+void Session::set_decode_horizon(double seconds)
+{
+	decode_horizon_ = seconds;
+}
+
+double Session::get_decode_horizon() const
+{
+	return decode_horizon_;
+}
+
 void Session::set_samplerate(double value)
 {
 	cur_samplerate_ = value;
@@ -670,10 +708,17 @@ void Session::feed_in_frame_begin()
 }
 
 void Session::feed_in_logic(shared_ptr<Logic> logic)
+{
+	feed_in_logic(logic->data_pointer(), logic->data_length(),
+		logic->unit_size());
+}
+
+void Session::feed_in_logic(const void *data, size_t length,
+	unsigned int unit_size)
 {
 	lock_guard<recursive_mutex> lock(data_mutex_);
 
-	const size_t sample_count = logic->data_length() / logic->unit_size();
+	const size_t sample_count = length / unit_size;
 
 	if (!logic_data_) {
 		// The only reason logic_data_ would not have been created is
@@ -694,7 +739,9 @@ void Session::feed_in_logic(shared_ptr<Logic> logic)
 		// Create a new data segment
 		cur_logic_segment_ = shared_ptr<data::LogicSegment>(
 			new data::LogicSegment(
-				logic, cur_samplerate_, sample_count));
+				unit_size, cur_samplerate_, sample_count,
+				logic_compression_ && !screen_mode_));
+		cur_logic_segment_->set_spill(spill_limit_, spill_dir_);
 		logic_data_->push_segment(cur_logic_segment_);
 
 		// @todo Putting this here means that only listeners querying
@@ -705,12 +752,12 @@ void Session::feed_in_logic(shared_ptr<Logic> logic)
 		new_segment_received();
 	}
 	if( (entire_buffersize_ - get_logic_sample_count() < sample_count)
-			&& screen_mode_) {
-		cur_logic_segment_->replace_payload(logic);
+			&& screen_mode_ && !cur_logic_segment_->is_compressed()) {
+		cur_logic_segment_->replace_payload(data, length);
 	}
 	else {
 		// Append to the existing data segment
-		cur_logic_segment_->append_payload(logic);
+		cur_logic_segment_->append_payload(data, length);
 	}
 	data_received();
 }
@@ -741,6 +788,64 @@ std::shared_ptr<data::Logic> Session::get_logic_data()
 	return logic_data_;
 }
 
+bool Session::save_logic(const QString &path)
+{
+	shared_ptr<data::LogicSegment> segment;
+
+	{
+		lock_guard<recursive_mutex> lock(data_mutex_);
+		if (!logic_data_ || logic_data_->logic_segments().empty())
+			return false;
+		segment = logic_data_->logic_segments().front();
+	}
+
+	return segment->save(path);
+}
+
+bool Session::load_logic(const QString &path)
+{
+	if (get_capture_state() != Stopped)
+		return false;
+
+	shared_ptr<data::LogicSegment> segment =
+		data::LogicSegment::open(path);
+	if (!segment)
+		return false;
+
+	return load_logic(segment);
+}
+
+bool Session::load_logic(shared_ptr<data::LogicSegment> segment)
+{
+	if (get_capture_state() != Stopped || !segment)
+		return false;
+
+	{
+		lock_guard<recursive_mutex> lock(data_mutex_);
+
+		if (!logic_data_)
+			update_signals();
+
+		// The signals read their bits from the samples of the device
+		if (!logic_data_ || (logic_data_->num_channels() + 7) / 8 !=
+				segment->unit_size())
+			return false;
+
+		for (const shared_ptr<data::SignalData> d : get_data())
+			d->clear_old_data();
+
+		cur_samplerate_ = segment->samplerate();
+		logic_data_->push_segment(segment);
+	}
+
+	// Same as a capture, so the views and decoders pick it up
+	frame_began();
+	new_segment_received();
+	data_received();
+	frame_ended();
+	return true;
+}
+
 void Session::feed_in_analog(shared_ptr<Analog> analog)
 {
 	lock_guard<recursive_mutex> lock(data_mutex_);
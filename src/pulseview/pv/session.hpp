@@ -21,6 +21,7 @@
 #ifndef PULSEVIEW_PV_SESSION_HPP
 #define PULSEVIEW_PV_SESSION_HPP
 
+#include <atomic>
 #include <map>
 #include <memory>
 #include <mutex>
@@ -147,6 +148,22 @@ public:
 
 	bool is_screen_mode();
 
+	/* Keep the logic captures as transitions, it has no effect on the
+	 * screen mode ring buffer */
+	void set_logic_compression(bool value);
+
+	bool is_logic_compression() const;
+
+	/* The logic segments keep up to memory_limit bytes in memory and
+	 * map the rest from a file in dir, 0 keeps everything in memory */
+	void set_spill(uint64_t memory_limit, const QString &dir);
+
+	/* The seconds of annotations the decoders keep behind the last
+	 * decoded sample, 0 keeps them all */
+	void set_decode_horizon(double seconds);
+
+	double get_decode_horizon() const;
+
 	void set_samplerate(double value);
 
 	void set_timeSpan(double value);
@@ -161,6 +178,13 @@ public:
 
 	std::shared_ptr<data::Logic> get_logic_data();
 
+	/* Writes the last logic capture to a file load_logic() maps back,
+	 * the loaded capture replaces the data as a new frame would */
+	bool save_logic(const QString &path);
+
+	bool load_logic(const QString &path);
+	bool load_logic(std::shared_ptr<data::LogicSegment> segment);
+
 	void clear_data();
 
 private:
@@ -185,6 +209,9 @@ private:
 
 	void feed_in_logic(std::shared_ptr<sigrok::Logic> logic);
 
+	void feed_in_logic(const void *data, size_t length,
+		unsigned int unit_size);
+
 	void feed_in_analog(std::shared_ptr<sigrok::Analog> analog);
 
 	void data_feed_in(std::shared_ptr<sigrok::Device> device,
@@ -219,6 +246,14 @@ private:
 
 	bool screen_mode_;
 
+	bool logic_compression_;
+
+	uint64_t spill_limit_;
+
+	QString spill_dir_;
+
+	std::atomic<double> decode_horizon_;
+
 	double timeSpan;
 
 	double timespanLimitStream;
@@ -234,6 +234,7 @@ void DecodeTrace::paint_mid(QPainter &p, const ViewItemPaintParams &pp)
 	int y = get_visual_y() - (-v_extents().first/2 ) + v_extents().second + row_offset;
 	pair<uint64_t, uint64_t> sample_range = get_sample_range(
 		pp.left(), pp.right());
+	decoder_stack_->set_visible_end(sample_range.second);
 
 	assert(decoder_stack_);
 	const vector<Row> rows(decoder_stack_->get_visible_rows());
@@ -258,10 +259,17 @@ void DecodeTrace::paint_mid(QPainter &p, const ViewItemPaintParams &pp)
 		boost::hash_combine(base_colour, row.row());
 		base_colour >>= 16;
 
+		// The runs of annotations narrower than a pixel come already
+		// gathered, only the others are drawn one by one
 		vector<Annotation> annotations;
-		decoder_stack_->get_annotation_subset(annotations, row,
-			sample_range.first,sample_range.second);
-		if (!annotations.empty()) {
+		vector<RowData::Block> blocks;
+		decoder_stack_->get_annotation_blocks(annotations, blocks, row,
+			sample_range.first, sample_range.second,
+			max(1.0, get_pixels_offset_samples_per_pixel().second));
+		if (!annotations.empty() || !blocks.empty()) {
+			for (const RowData::Block &b : blocks)
+				draw_annotation_block(b, p, annotation_height, y,
+					base_colour);
 			draw_annotations(annotations, p, annotation_height, pp, y,
 				base_colour, row_title_width);
 
@@ -533,6 +541,33 @@ void DecodeTrace::draw_annotation_block(
 		QRectF(start, top, end - start, bottom - top), h/4, h/4);
 }
 
+void DecodeTrace::draw_annotation_block(
+	const pv::data::decode::RowData::Block &block, QPainter &p, int h,
+	int y, size_t base_colour) const
+{
+	double samples_per_pixel, pixels_offset;
+	tie(pixels_offset, samples_per_pixel) =
+		get_pixels_offset_samples_per_pixel();
+
+	const double start = block.start_sample / samples_per_pixel -
+		pixels_offset;
+	const double end = block.end_sample / samples_per_pixel -
+		pixels_offset;
+
+	const double top = y + .5 - h / 2;
+	const double bottom = y + .5 + h / 2;
+
+	// Mixed formats get the neutral color
+	const bool single_format = block.format >= 0;
+	const size_t colour = (base_colour + block.format) % countof(Colours);
+
+	p.setPen((single_format ? OutlineColours[colour] : Qt::gray));
+	p.setBrush(QBrush((single_format ? Colours[colour] : Qt::gray),
+		Qt::Dense4Pattern));
+	p.drawRoundedRect(
+		QRectF(start, top, max(end - start, 1.0), bottom - top), h/4, h/4);
+}
+
 void DecodeTrace::draw_instant(const pv::data::decode::Annotation &a, QPainter &p,
 	int h, double x, int y) const
 {
@@ -32,6 +32,7 @@
 
 #include "../binding/decoder.hpp"
 #include "../data/decode/row.hpp"
+#include "../data/decode/rowdata.hpp"
 
 struct srd_channel;
 struct srd_decoder;
@@ -147,6 +148,9 @@ private:
 	void draw_annotation_block(std::vector<pv::data::decode::Annotation> annotations,
 		QPainter &p, int h, int y, size_t base_colour) const;
 
+	void draw_annotation_block(const pv::data::decode::RowData::Block &block,
+		QPainter &p, int h, int y, size_t base_colour) const;
+
 	void draw_instant(const pv::data::decode::Annotation &a, QPainter &p,
 		int h, double x, int y) const;
 
@@ -42,6 +42,7 @@
 #include <libsigrokcxx/libsigrokcxx.hpp>
 
 using std::deque;
+using std::dynamic_pointer_cast;
 using std::max;
 using std::make_pair;
 using std::min;
@@ -216,8 +217,19 @@ void LogicSignal::paint_mid(QPainter &p, const ViewItemPaintParams &pp)
 	const uint64_t end_sample = min(max(ceil(end).convert_to<int64_t>(),
 		(int64_t)0), last_sample);
 
+	// The edges of all the enabled signals of the segment come out of
+	// the same pass, the first of them to paint fills the cache
+	uint64_t sig_mask = 0;
+	for (const shared_ptr<Signal> &s : session_.signals()) {
+		const shared_ptr<LogicSignal> l =
+			dynamic_pointer_cast<LogicSignal>(s);
+		if (l && l->data_ == data_ && l->channel()->enabled() &&
+				l->channel()->index() < 64)
+			sig_mask |= 1ULL << l->channel()->index();
+	}
+
 	segment->get_subsampled_edges(edges, start_sample, end_sample,
-		samples_per_pixel / Oversampling, channel_->index());
+		samples_per_pixel / Oversampling, channel_->index(), sig_mask);
 	assert(edges.size() >= 2);
 
 	// Paint the edges
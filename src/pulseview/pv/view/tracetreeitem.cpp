@@ -174,6 +174,9 @@ qreal TraceTreeItem::getCh_thickness() const
 void TraceTreeItem::setCh_thickness(qreal value)
 {
 	ch_thickness = value;
+
+	if (owner_)
+		owner_->row_item_appearance_changed(false, true);
 }
 
 
@@ -473,7 +473,7 @@ void View::enable_coloured_bg(bool state)
 			d->set_coloured_bg(state);
 	}
 
-    viewport_->update();
+	viewport_->invalidate_traces();
 }
 
 bool View::cursors_shown() const
@@ -906,7 +906,7 @@ void View::row_item_appearance_changed(bool label, bool content)
 //	if (label)
 //		header_->update();
 	if (content)
-		viewport_->update();
+		viewport_->invalidate_traces();
 }
 
 void View::time_item_appearance_changed(bool label, bool content)
@@ -1106,7 +1106,7 @@ void View::signals_changed()
 	update_layout();
 
 //	header_->update();
-	viewport_->update();
+	viewport_->invalidate_traces();
 
 	if (reset_scrollbar)
 		set_scroll_default();
@@ -1135,6 +1135,8 @@ void View::capture_state_updated(int state)
 
 void View::data_updated()
 {
+	viewport_->traces_data_changed();
+
 	if (always_zoom_to_fit_ || sticky_scrolling_) {
 		if (!delayed_view_updater_.isActive())
 			delayed_view_updater_.start();
@@ -1142,7 +1144,6 @@ void View::data_updated()
 		determine_time_unit();
 		update_scroll();
 		ruler_->update();
-		viewport_->update();
 	}
 }
 
@@ -1216,7 +1217,7 @@ void View::remove_trace_clones()
 {
 	session_.remove_signal_clones();
 	session_.remove_decode_clones();
-	viewport_->update();
+	viewport_->invalidate_traces();
 }
 
 void View::set_timebase(double value)
@@ -24,6 +24,7 @@
 #include <limits>
 
 #include "signal.hpp"
+#include "tracetreeitem.hpp"
 #include "view.hpp"
 #include "viewitempaintparams.hpp"
 #include "viewport.hpp"
@@ -42,13 +43,18 @@ using std::max;
 using std::min;
 using std::none_of;
 using std::numeric_limits;
+using std::pair;
 using std::shared_ptr;
 using std::stable_sort;
 using std::vector;
 
+using pv::util::Timestamp;
+
 namespace pv {
 namespace view {
 
+const int Viewport::TailMargin = 4;
+
 Viewport::Viewport(View &parent) :
 	ViewWidget(parent),
 	pinch_zoom_active_(false),
@@ -56,7 +62,9 @@ Viewport::Viewport(View &parent) :
 	timeTriggerPixel(0),
 	timeTriggerActive(false),
 	cursorsActive(false),
-	cursorsPixelValues(std::pair<int, int>(0,0))
+	cursorsPixelValues(std::pair<int, int>(0,0)),
+	cache_scale_(0),
+	dirty_from_(0)
 {
 	/* Permits the QWidget to have a visible background */
 	setAttribute(Qt::WA_StyledBackground, true);
@@ -211,22 +219,21 @@ void Viewport::paintEvent(QPaintEvent*)
 	assert(none_of(time_items.begin(), time_items.end(),
 		[](const shared_ptr<TimeItem> &t) { return !t; }));
 
+	const ViewItemPaintParams pp(rect(), view_.scale(), view_.offset(), view_.divisionCount());
+
+	paint_traces(row_items, pp);
+
 	QPainter p(this);
 	p.setRenderHint(QPainter::Antialiasing);
 
-	const ViewItemPaintParams pp(rect(), view_.scale(), view_.offset(), view_.divisionCount());
-
+	// The time items paint nothing in the middle layer, both of their
+	// lower layers go under the rows
 	for (const shared_ptr<TimeItem> t : time_items)
 		t->paint_back(p, pp);
-	for (const shared_ptr<RowItem> r : row_items)
-//		if (!r->isInitial())
-			r->paint_back(p, pp);
-
 	for (const shared_ptr<TimeItem> t : time_items)
 		t->paint_mid(p, pp);
-	for (const shared_ptr<RowItem> r : row_items)
-		if (r->isVisible())
-			r->paint_mid(p, pp);
+
+	p.drawPixmap(0, 0, traces_cache_);
 
 	paint_grid(p, pp);
 
@@ -251,6 +258,89 @@ void Viewport::paintEvent(QPaintEvent*)
 	p.end();
 }
 
+void Viewport::invalidate_traces()
+{
+	dirty_from_ = 0;
+	update();
+}
+
+void Viewport::traces_data_changed()
+{
+	const ViewItemPaintParams pp(rect(), view_.scale(), view_.offset(),
+		view_.divisionCount());
+	const pair<Timestamp, Timestamp> extents = view_.get_time_extents();
+
+	// A running capture which does not overwrite its samples in place
+	// only adds to the right of what is painted. The subsampled edges
+	// and envelopes of the last few pixels may still change.
+	if (view_.session().get_capture_state() == Session::Running &&
+			!view_.session().is_screen_mode() &&
+			extents.first == cache_extents_.first &&
+			extents.second >= cache_extents_.second)
+		dirty_from_ = min(dirty_from_, max(0,
+			time_to_pixel(cache_extents_.second, pp) - TailMargin));
+	else
+		dirty_from_ = 0;
+
+	update();
+}
+
+int Viewport::time_to_pixel(const Timestamp &t,
+	const ViewItemPaintParams &pp) const
+{
+	const double x = ((t - pp.offset()) / pp.scale()).convert_to<double>();
+	return (int)max(min(x, (double)numeric_limits<int>::max()),
+		(double)numeric_limits<int>::min());
+}
+
+void Viewport::paint_traces(const vector< shared_ptr<RowItem> > &rows,
+	const ViewItemPaintParams &pp)
+{
+	vector<CachedRow> cached_rows;
+	for (const shared_ptr<RowItem> &r : rows) {
+		const shared_ptr<TraceTreeItem> t =
+			dynamic_pointer_cast<TraceTreeItem>(r);
+		cached_rows.push_back({ r.get(), r->point(QRect()).y(),
+			t ? t->v_extents() : pair<int, int>(0, 0),
+			r->isVisible() });
+	}
+
+	const qreal ratio = devicePixelRatio();
+	if (traces_cache_.size() != size() * ratio ||
+			cache_scale_ != pp.scale() ||
+			cache_offset_ != pp.offset() ||
+			!(cache_rows_ == cached_rows)) {
+		traces_cache_ = QPixmap(size() * ratio);
+		traces_cache_.setDevicePixelRatio(ratio);
+		dirty_from_ = 0;
+	}
+
+	cache_scale_ = pp.scale();
+	cache_offset_ = pp.offset();
+	cache_rows_.swap(cached_rows);
+	cache_extents_ = view_.get_time_extents();
+
+	if (dirty_from_ >= width())
+		return;
+
+	const QRect dirty(dirty_from_, 0, width() - dirty_from_, height());
+	dirty_from_ = numeric_limits<int>::max();
+
+	QPainter p(&traces_cache_);
+	p.setCompositionMode(QPainter::CompositionMode_Source);
+	p.fillRect(dirty, Qt::transparent);
+	p.setCompositionMode(QPainter::CompositionMode_SourceOver);
+	p.setClipRect(dirty);
+	p.setRenderHint(QPainter::Antialiasing);
+
+	for (const shared_ptr<RowItem> r : rows)
+//		if (!r->isInitial())
+			r->paint_back(p, pp);
+	for (const shared_ptr<RowItem> r : rows)
+		if (r->isVisible())
+			r->paint_mid(p, pp);
+}
+
 void Viewport::paint_cursors(QPainter &p, const ViewItemPaintParams &pp)
 {
 	QPen cursorsLinePen = QPen(QColor(155, 155, 155), 1, Qt::DashLine);
@@ -21,8 +21,11 @@
 #ifndef PULSEVIEW_PV_VIEW_VIEWPORT_HPP
 #define PULSEVIEW_PV_VIEW_VIEWPORT_HPP
 
+#include <vector>
+
 #include <boost/optional.hpp>
 
+#include <QPixmap>
 #include <QTimer>
 #include <QTouchEvent>
 
@@ -36,6 +39,7 @@ class Session;
 namespace pv {
 namespace view {
 
+class RowItem;
 class View;
 class ViewItemPaintParams;
 
@@ -44,6 +48,10 @@ class Viewport : public ViewWidget
 	Q_OBJECT
 
 private:
+	// The columns left of the previous end of the data which a running
+	// capture paints again
+	static const int TailMargin;
+
 	bool dragEnabled = true;
 public:
 	explicit Viewport(View &parent);
@@ -76,6 +84,18 @@ public:
 	void cursorValueChanged_1(int);
 	void cursorValueChanged_2(int);
 	boost::optional<pv::util::Timestamp> getDragOffset();
+
+	/**
+	 * The rows painted the last time are reused until this is called,
+	 * for what does not show in the scale, the offset or the layout.
+	 */
+	void invalidate_traces();
+
+	/**
+	 * The data of the rows changed. Samples appended by a running
+	 * capture only have the part past the previous end painted again.
+	 */
+	void traces_data_changed();
 private:
 	/**
      * Indicates when a view item is being hovered over.
@@ -131,6 +151,10 @@ private:
 	void paint_time_trigger_line(QPainter &p, const ViewItemPaintParams &pp, int pos);
 	void paint_last_sample_cursor(QPainter &p, const ViewItemPaintParams &pp);
 	void paint_cursors(QPainter &p, const ViewItemPaintParams &pp);
+	void paint_traces(const std::vector< std::shared_ptr<RowItem> > &rows,
+		const ViewItemPaintParams &pp);
+	int time_to_pixel(const pv::util::Timestamp &t,
+		const ViewItemPaintParams &pp) const;
 
 	void mouseDoubleClickEvent(QMouseEvent *event);
 	void wheelEvent(QWheelEvent *event);
@@ -153,6 +177,32 @@ private:
 
 	bool cursorsActive;
 	std::pair<int, int> cursorsPixelValues;
+
+	/* What the cached rows were painted at, a difference paints them
+	 * all again */
+	struct CachedRow
+	{
+		const RowItem *item;
+		int y;
+		std::pair<int, int> extents;
+		bool visible;
+
+		bool operator==(const CachedRow &o) const {
+			return item == o.item && y == o.y &&
+				extents == o.extents && visible == o.visible;
+		}
+	};
+
+	/* The back and mid layers of the rows, the cursors, markers and
+	 * labels go on top of it every time */
+	QPixmap traces_cache_;
+	double cache_scale_;
+	pv::util::Timestamp cache_offset_;
+	std::vector<CachedRow> cache_rows_;
+	std::pair<pv::util::Timestamp, pv::util::Timestamp> cache_extents_;
+
+	// The first column to paint again, 0 for all of them
+	int dirty_from_;
 };
 
 } // namespace view
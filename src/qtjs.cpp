@@ -70,6 +70,22 @@ void QtJs::msleep(unsigned long ms)
 	}
 }
 
+bool QtJs::waitFor(QJSValue condition, unsigned long timeout_ms)
+{
+	QElapsedTimer timer;
+
+	timer.start();
+	while (!condition.call().toBool()) {
+		if (timer.hasExpired(timeout_ms))
+			return false;
+
+		QCoreApplication::processEvents();
+		QThread::msleep(1);
+	}
+
+	return true;
+}
+
 void QtJs::printToConsole(const QString& text)
 {
 	cout << text.toStdString() << std::endl;
@@ -24,6 +24,7 @@
 #include <QObject>
 #include <QFuture>
 #include <QFutureWatcher>
+#include <QJSValue>
 class QJSEngine;
 
 namespace adiscope {
@@ -38,6 +39,9 @@ public:
 	Q_INVOKABLE void exit();
 	Q_INVOKABLE void sleep(unsigned long s);
 	Q_INVOKABLE void msleep(unsigned long ms);
+	/* Keeps the application running until condition() is true, e.g.
+	 * set by the callback of an asynchronous call, or timeout ms */
+	Q_INVOKABLE bool waitFor(QJSValue condition, unsigned long timeout_ms);
 	Q_INVOKABLE void printToConsole(const QString& text);
 	Q_INVOKABLE QString readFromConsole(const QString& text);
 
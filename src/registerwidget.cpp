@@ -48,6 +48,11 @@ uint32_t RegisterWidget::getLastAddress(void) const
 	return regMap.getLastAddress();
 }
 
+QList<uint32_t> RegisterWidget::getRegisterAddresses(void) const
+{
+	return regMap.getRegisterAddresses();
+}
+
 void RegisterWidget::createRegMap(const QString *device, int *address,
                                   const QString *source)
 {
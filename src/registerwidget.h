@@ -50,6 +50,7 @@ public:
 	QString getDescription() const;
 	uint32_t getDefaultValue(void) const;
 	uint32_t getLastAddress(void) const;
+	QList<uint32_t> getRegisterAddresses(void) const;
 
 Q_SIGNALS:
 	void valueChanged(int);
@@ -23,7 +23,8 @@
 
 RegmapParser::RegmapParser(QObject *parent,
                            struct iio_context *context) : QObject(parent),
-	ctx(context)
+	ctx(context),
+	lastAddress(0)
 {
 
 }
@@ -110,6 +111,15 @@ bool RegmapParser::xmlFileExists(char *filename)
 }
 int RegmapParser::deviceXmlFileLoad(QString *filename)
 {
+	/* The register view reloads the file on each register change */
+	if (*filename == loadedFile && !registers.isEmpty()) {
+		return 1;
+	}
+
+	loadedFile.clear();
+	registers.clear();
+	lastAddress = 0;
+
 	if (!file.isOpen()) {
 		file.setFileName(*filename);
 
@@ -121,60 +131,80 @@ int RegmapParser::deviceXmlFileLoad(QString *filename)
 		doc.clear();
 
 		if (!file.open(QIODevice::ReadOnly) || !doc.setContent(&file)) {
+			file.close();
 			return 0;
 		}
 	}
 
 	file.close();
+
+	indexRegisters();
+	loadedFile = *filename;
+
 	return 1;
 }
 
-QDomNode *RegmapParser::getRegisterNode(const QString address)
+void RegmapParser::indexRegisters()
 {
-	int i ;
 	bool status;
-	QDomNodeList registers = doc.elementsByTagName("Register");
-	uint32_t lastAddress = registers.item(registers.size() -
-	                                      1).firstChildElement("Address").text().split("0x")[1].toUInt(&status,16);
-	lastNode = registers.item(registers.size() - 1);
-
-	for (i = 0; i < registers.size(); i++) {
-		node = registers.item(i);
-		QDomElement addr = node.firstChildElement("Address");
+	QDomNodeList nodes = doc.elementsByTagName("Register");
 
-		uint hexNode = addr.text().split("0x")[1].toUInt(&status, 16);
-		uint hexAddress = address.split("0x")[1].toUInt(&status, 16);
+	for (int i = 0; i < nodes.size(); i++) {
+		QDomElement addr = nodes.item(i).firstChildElement("Address");
+		QStringList hex = addr.text().split("0x");
 
-		if (hexAddress > lastAddress) {
-			return &lastNode;
-		}
-
-		if (addr.isNull()) {
+		if (addr.isNull() || hex.size() < 2) {
 			continue;
 		}
 
-		if (hexNode == hexAddress) {
-			return &node;
+		uint32_t address = hex[1].toUInt(&status, 16);
+
+		/* The first register of an address is the one looked up */
+		if (!registers.contains(address)) {
+			registers.insert(address, nodes.item(i));
 		}
 	}
 
-	return nullptr;
+	lastNode = nodes.item(nodes.size() - 1);
+	QStringList hex = lastNode.firstChildElement("Address").text().split("0x");
+	lastAddress = hex.size() < 2 ? 0 : hex[1].toUInt(&status, 16);
 }
 
-uint32_t RegmapParser::getLastAddress(void) const
+QDomNode *RegmapParser::getRegisterNode(const QString address)
 {
 	bool status;
+	QStringList hex = address.split("0x");
 
-	QDomNodeList registers = doc.elementsByTagName("Register");
-	QDomNode n = registers.item(registers.size() - 1);
-	QDomElement addr = n.firstChildElement("Address");
-	QStringList temp = addr.text().split("0x");
+	if (hex.size() < 2) {
+		return nullptr;
+	}
 
-	uint32_t lastAddress = addr.text().split("0x")[1].toUInt(&status,16);
+	uint32_t hexAddress = hex[1].toUInt(&status, 16);
 
+	if (!registers.isEmpty() && hexAddress > lastAddress) {
+		return &lastNode;
+	}
+
+	auto it = registers.constFind(hexAddress);
+
+	if (it == registers.constEnd()) {
+		return nullptr;
+	}
+
+	node = it.value();
+	return &node;
+}
+
+uint32_t RegmapParser::getLastAddress(void) const
+{
 	return lastAddress;
 }
 
+QList<uint32_t> RegmapParser::getRegisterAddresses(void) const
+{
+	return registers.keys();
+}
+
 bool RegmapParser::isInputDevice(const struct iio_device *dev)
 {
 	return deviceTypeGet(dev, 1);
@@ -26,6 +26,7 @@
 #include <QFile>
 #include <QDebug>
 #include <QDomDocument>
+#include <QMap>
 
 #define PCORE_VERSION_MAJOR(version) (version >> 16)
 
@@ -46,6 +47,7 @@ public:
 	void writeRegister(const QString *device, const uint32_t u8Address,
 	                   const uint32_t value);
 	uint32_t getLastAddress(void) const;
+	QList<uint32_t> getRegisterAddresses(void) const;
 
 private:
 	void findDeviceXmlFile(const QString *xmlsFolderPath, const QString *device,
@@ -55,6 +57,7 @@ private:
 	bool isInputDevice(const struct iio_device *dev);
 	bool isOutputDevice(const struct iio_device *dev);
 	bool deviceTypeGet(const struct iio_device *dev, int type);
+	void indexRegisters();
 
 private:
 	struct iio_context *ctx;
@@ -63,6 +66,11 @@ private:
 	QDomDocument doc;
 	QDomNode node;
 	QDomNode lastNode;
+
+	/* The Register nodes by address, built once per loaded file */
+	QString loadedFile;
+	QMap<uint32_t, QDomNode> registers;
+	uint32_t lastAddress;
 };
 
 #endif // REGMAPPARSER_H
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replay_file.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+using namespace adiscope;
+
+QString ReplayFile::s_paths[ReplayFile::STREAM_COUNT];
+double ReplayFile::s_speed = 1.0;
+
+void ReplayFile::setPath(Stream stream, const QString &path)
+{
+	s_paths[stream] = path;
+}
+
+QString ReplayFile::path(Stream stream)
+{
+	return s_paths[stream];
+}
+
+void ReplayFile::setSpeed(double speed)
+{
+	s_speed = std::max(speed, 0.0);
+}
+
+double ReplayFile::speed()
+{
+	return s_speed;
+}
+
+std::shared_ptr<ReplayFile> ReplayFile::open(Stream stream)
+{
+	if (s_paths[stream].isEmpty())
+		return nullptr;
+
+	auto file = std::make_shared<ReplayFile>(s_paths[stream]);
+
+	if (!file->isValid()) {
+		qWarning() << "Unable to map the replay file" << s_paths[stream];
+		return nullptr;
+	}
+
+	return file;
+}
+
+ReplayFile::ReplayFile(const QString &path) :
+	d_file(path),
+	d_data(nullptr),
+	d_size(0),
+	d_pos(0),
+	d_rate(0),
+	d_bytes_read(0),
+	d_start(std::chrono::steady_clock::now())
+{
+	if (!d_file.open(QIODevice::ReadOnly) || d_file.size() <= 0)
+		return;
+
+	d_data = d_file.map(0, d_file.size());
+	if (d_data)
+		d_size = d_file.size();
+}
+
+ReplayFile::~ReplayFile()
+{
+	if (d_data)
+		d_file.unmap(const_cast<uchar *>(d_data));
+}
+
+void ReplayFile::setRate(double bytes_per_second)
+{
+	d_rate = bytes_per_second;
+	d_bytes_read = 0;
+	d_start = std::chrono::steady_clock::now();
+}
+
+void ReplayFile::read(void *dst, size_t length)
+{
+	if (!d_data)
+		return;
+
+	uint8_t *out = static_cast<uint8_t *>(dst);
+
+	for (size_t done = 0; done < length; ) {
+		size_t n = std::min(length - done, d_size - d_pos);
+
+		memcpy(out + done, d_data + d_pos, n);
+		done += n;
+		d_pos = (d_pos + n) % d_size;
+	}
+
+	d_bytes_read += length;
+
+	if (d_rate > 0 && s_speed > 0) {
+		std::chrono::duration<double> due(d_bytes_read /
+				(d_rate * s_speed));
+
+		std::this_thread::sleep_until(d_start +
+				std::chrono::duration_cast<
+				std::chrono::steady_clock::duration>(due));
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_FILE_HPP
+#define REPLAY_FILE_HPP
+
+#include <QFile>
+#include <QString>
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+namespace adiscope {
+
+/*
+ * A raw capture played back in place of the samples of a device, so that
+ * a profiling session sees a repeatable input without the hardware. The
+ * file holds the bytes of the IIO buffers as they were read, e.g. the
+ * interleaved int16 pairs of the M2K ADC or the 16 bit words of the logic
+ * analyzer, and is memory-mapped.
+ *
+ * The reads are paced to the rate of the stream times the replay speed
+ * and wrap around at the end of the file; a speed of 0 plays the file as
+ * fast as it is consumed.
+ *
+ * The device context is still needed for its attributes; the files are
+ * given on the command line and picked up by iio_manager and the logic
+ * analyzer's BinaryStream when they start.
+ */
+class ReplayFile
+{
+public:
+	enum Stream {
+		ADC,
+		LOGIC,
+		STREAM_COUNT
+	};
+
+	static void setPath(Stream stream, const QString &path);
+	static QString path(Stream stream);
+	static void setSpeed(double speed);
+	static double speed();
+
+	/* The replay of the stream, nullptr when it plays from the device
+	 * or the file can't be mapped */
+	static std::shared_ptr<ReplayFile> open(Stream stream);
+
+	explicit ReplayFile(const QString &path);
+	~ReplayFile();
+
+	bool isValid() const { return d_data != nullptr; }
+	size_t size() const { return d_size; }
+
+	/* Bytes per second at a speed of 1; restarts the pacing */
+	void setRate(double bytes_per_second);
+
+	/* Copies length bytes from the current position, after waiting for
+	 * the time they would take to arrive from the device */
+	void read(void *dst, size_t length);
+
+private:
+	QFile d_file;
+	const uchar *d_data;
+	size_t d_size;
+	size_t d_pos;
+
+	double d_rate;
+	uint64_t d_bytes_read;
+	std::chrono::steady_clock::time_point d_start;
+
+	static QString s_paths[STREAM_COUNT];
+	static double s_speed;
+};
+
+} /* namespace adiscope */
+
+#endif /* REPLAY_FILE_HPP */
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "replay_source.h"
+#include "pipeline_trace.hpp"
+
+#include <gnuradio/io_signature.h>
+
+#include <iio.h>
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace adiscope;
+
+replay_source::sptr replay_source::make(std::shared_ptr<ReplayFile> file,
+		struct iio_device *dev, unsigned int nb_channels,
+		unsigned long buffer_size)
+{
+	return gnuradio::get_initial_sptr(new replay_source(file, dev,
+				nb_channels, buffer_size));
+}
+
+replay_source::replay_source(std::shared_ptr<ReplayFile> file,
+		struct iio_device *dev, unsigned int nb_channels,
+		unsigned long buffer_size) :
+	gr::sync_block("replay_source",
+			gr::io_signature::make(0, 0, 0),
+			gr::io_signature::make(nb_channels, nb_channels,
+				sizeof(short))),
+	d_file(file),
+	d_dev(dev),
+	d_nb_channels(nb_channels),
+	d_buffer_size(buffer_size),
+	d_channels(nb_channels),
+	d_index(0),
+	d_count(0),
+	d_buffer_start_key(pmt::intern("buffer_start")),
+	d_id(pmt::intern(alias()))
+{
+}
+
+bool replay_source::start()
+{
+	double rate = 0;
+
+	if (d_dev)
+		iio_device_attr_read_double(d_dev, "sampling_frequency", &rate);
+
+	d_file->setRate(rate * d_nb_channels * sizeof(int16_t));
+	d_index = d_count = 0;
+
+	return gr::sync_block::start();
+}
+
+void replay_source::set_buffer_size(unsigned long size)
+{
+	gr::thread::scoped_lock lock(d_setlock);
+
+	d_buffer_size = size;
+}
+
+void replay_source::_refill()
+{
+	d_count = d_buffer_size;
+	d_index = 0;
+	d_raw.resize(d_count * d_nb_channels);
+	d_file->read(d_raw.data(), d_raw.size() * sizeof(int16_t));
+
+	for (auto &channel : d_channels)
+		channel.resize(d_count);
+
+	if (d_nb_channels == 2) {
+		volk_16ic_deinterleave_16i_x2(d_channels[0].data(),
+				d_channels[1].data(),
+				(const lv_16sc_t *)d_raw.data(), d_count);
+	} else {
+		for (unsigned int ch = 0; ch < d_nb_channels; ch++)
+			for (unsigned long i = 0; i < d_count; i++)
+				d_channels[ch][i] = d_raw[i * d_nb_channels + ch];
+	}
+
+	for (unsigned int ch = 0; ch < d_nb_channels; ch++)
+		add_item_tag(ch, nitems_written(ch), d_buffer_start_key,
+				pmt::PMT_T, d_id);
+}
+
+int replay_source::work(int noutput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	PIPELINE_TRACE("replay_source work");
+
+	gr::thread::scoped_lock lock(d_setlock);
+
+	if (d_index == d_count)
+		_refill();
+
+	int n = std::min<unsigned long>(noutput_items, d_count - d_index);
+
+	for (unsigned int ch = 0; ch < d_nb_channels; ch++)
+		memcpy(output_items[ch], &d_channels[ch][d_index],
+				n * sizeof(int16_t));
+
+	d_index += n;
+
+	return n;
+}
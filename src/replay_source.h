@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef REPLAY_SOURCE_H
+#define REPLAY_SOURCE_H
+
+#include <gnuradio/sync_block.h>
+
+#include "replay_file.hpp"
+
+#include <memory>
+#include <vector>
+
+extern "C" {
+	struct iio_device;
+}
+
+namespace adiscope {
+
+/*
+ * Stands in for the IIO device source of iio_manager: the int16 samples
+ * of nb_channels interleaved channels come from a ReplayFile, a buffer at
+ * a time, each buffer tagged "buffer_start" like the device source does.
+ * The pace follows the "sampling_frequency" of the device, read when the
+ * flowgraph starts.
+ */
+class replay_source : public gr::sync_block
+{
+public:
+	typedef boost::shared_ptr<replay_source> sptr;
+
+	static sptr make(std::shared_ptr<ReplayFile> file,
+			 struct iio_device *dev, unsigned int nb_channels,
+			 unsigned long buffer_size);
+
+	bool start();
+
+	int work(int noutput_items,
+		 gr_vector_const_void_star &input_items,
+		 gr_vector_void_star &output_items);
+
+	void set_buffer_size(unsigned long size);
+
+private:
+	std::shared_ptr<ReplayFile> d_file;
+	struct iio_device *d_dev;
+	unsigned int d_nb_channels;
+	unsigned long d_buffer_size;
+
+	/* The current buffer, one row per channel */
+	std::vector<int16_t> d_raw;
+	std::vector<std::vector<int16_t>> d_channels;
+	unsigned long d_index;
+	unsigned long d_count;
+
+	pmt::pmt_t d_buffer_start_key;
+	pmt::pmt_t d_id;
+
+	void _refill();
+
+	replay_source(std::shared_ptr<ReplayFile> file,
+		      struct iio_device *dev, unsigned int nb_channels,
+		      unsigned long buffer_size);
+};
+}
+
+#endif /* REPLAY_SOURCE_H */
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <cstddef>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Fixed capacity FIFO with O(1) push and pop, whose content is always
+ * contiguous in memory so that it can be handed as is to e.g.
+ * QwtPlotCurve::setRawSamples().
+ *
+ * Every element is written twice, at its slot and at the same slot of
+ * a mirror placed right after the storage, so the window starting at
+ * the oldest element never wraps. Pushing to a full buffer drops the
+ * oldest element.
+ */
+template <typename T>
+class RingBuffer
+{
+public:
+	explicit RingBuffer(std::size_t capacity = 0) :
+		first(0), count(0)
+	{
+		setCapacity(capacity);
+	}
+
+	/* Also clears the buffer */
+	void setCapacity(std::size_t capacity)
+	{
+		storage.assign(2 * capacity, T());
+		cap = capacity;
+		clear();
+	}
+
+	std::size_t capacity() const { return cap; }
+	std::size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	bool full() const { return count == cap; }
+
+	void clear()
+	{
+		first = 0;
+		count = 0;
+	}
+
+	void push(const T& value)
+	{
+		if (!cap)
+			return;
+
+		if (full())
+			pop();
+
+		std::size_t pos = (first + count) % cap;
+
+		storage[pos] = value;
+		storage[pos + cap] = value;
+		count++;
+	}
+
+	/* Removes and returns the oldest element, the buffer must not be
+	 * empty */
+	T pop()
+	{
+		T value = storage[first];
+
+		first = (first + 1) % cap;
+		count--;
+
+		return value;
+	}
+
+	/* i = 0 is the oldest element */
+	const T& operator[](std::size_t i) const { return storage[first + i]; }
+	const T& front() const { return storage[first]; }
+	const T& back() const { return storage[first + count - 1]; }
+
+	/* The size() elements, oldest first */
+	const T *data() const { return storage.data() + first; }
+
+private:
+	std::vector<T> storage;
+	std::size_t cap;
+	std::size_t first;
+	std::size_t count;
+};
+}
+
+#endif /* RING_BUFFER_HPP */
@@ -47,11 +47,20 @@
 #endif
 
 #include "trigger_mode.h"
+#include "frame_listener.h"
+#include "software_trigger.h"
+#include "waveform_averager.h"
 #include <gnuradio/sync_block.h>
 #include <qapplication.h>
 
+#include <memory>
+#include <vector>
+
 namespace adiscope {
 
+    class PersistenceMap;
+    class CaptureLatency;
+
     class scope_sink_f : virtual public gr::sync_block
     {
     public:
@@ -78,6 +87,77 @@ namespace adiscope {
       virtual void set_displayOneBuffer(bool) = 0;
       virtual void clean_buffers() = 0;
 
+      /* Segmented memory: the next nsegments triggered frames are kept
+       * back-to-back in pre-allocated storage instead of being plotted,
+       * only the last one is sent to the plot. 0 disables it. Setting
+       * it again re-arms the capture. Only used in one-buffer mode. */
+      virtual void set_segments(unsigned int nsegments) = 0;
+      virtual unsigned int segments() const = 0;
+      virtual unsigned int segments_captured() const = 0;
+
+      /* Capture time of a segment in seconds, relative to the first one */
+      virtual double segment_time(unsigned int index) const = 0;
+
+      /* Acquisition time (acquisition_clock.h, in ns) and index in the
+       * device stream of the first sample of the last complete frame,
+       * from the acquisition time tags; false if none came in */
+      virtual bool frame_time(uint64_t &time, uint64_t &sample) = 0;
+
+      /* Send a captured segment to the plot */
+      virtual void show_segment(unsigned int index) = 0;
+
+      /* Send the captured segments, oldest first, to a listener */
+      virtual void replay_segments(frame_listener *listener) = 0;
+
+      /* Every complete frame of input n gets accumulated into maps[n],
+       * plotted or not. An empty vector disables it. */
+      virtual void set_persistence(
+		      const std::vector< std::shared_ptr<PersistenceMap> > &maps) = 0;
+
+      /* Averaging or high resolution applied to every complete frame
+       * before it reaches the listeners, the persistence and the plot.
+       * Only used in one-buffer mode. Setting it again starts over. */
+      virtual void set_acquisition_mode(WaveformAverager::Mode mode,
+					unsigned int count) = 0;
+      virtual WaveformAverager::Mode acquisition_mode() const = 0;
+      virtual unsigned int acquisition_count() const = 0;
+      virtual unsigned int frames_averaged() const = 0;
+      virtual void clear_average() = 0;
+
+      /* Every complete frame is handed to the listeners too, from the
+       * flowgraph thread; a sweep in streaming mode counts once it
+       * filled the screen. */
+      virtual void add_frame_listener(frame_listener *listener) = 0;
+      virtual void remove_frame_listener(frame_listener *listener) = 0;
+
+      /* Forward the stream tags with the frames posted to the plot; off
+       * by default, as nothing draws them. The tag trigger and the
+       * acquisition time tag are looked for regardless. */
+      virtual void set_tags_enabled(bool en) = 0;
+      virtual bool tags_enabled() const = 0;
+
+      /* Complete frames seen by the sink and frames sent to the plot;
+       * the difference is what the update time throttled away or the
+       * plot was too busy to take. */
+      virtual uint64_t frames_acquired() const = 0;
+      virtual uint64_t frames_posted() const = 0;
+      virtual void reset_frame_counters() = 0;
+
+      /* Trigger of the streaming mode, where the hardware one is off:
+       * a sweep starts at the sample of input channel that meets the
+       * condition, the samples before it are dropped. With rearm the
+       * sink waits for the next trigger once the screen is filled,
+       * otherwise it stops there until the buffers are cleaned, as
+       * with the hardware trigger. A NONE type turns it off. */
+      virtual void set_software_trigger(const SoftwareTrigger &trigger,
+					int channel, bool rearm) = 0;
+      virtual bool software_trigger_enabled() const = 0;
+
+      /* Marks when the sink got ready for a frame, found its start and
+       * completed it. NULL stops it. */
+      virtual void set_capture_latency(
+		      const std::shared_ptr<CaptureLatency> &latency) = 0;
+
       QApplication *d_qApplication;
     };
 
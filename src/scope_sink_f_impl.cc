@@ -47,12 +47,19 @@
 #include <gnuradio/block_detail.h>
 #include <gnuradio/buffer.h>
 #include <gnuradio/prefs.h>
+#include <algorithm>
 #include <string.h>
 #include <volk/volk.h>
 #include <gnuradio/fft/fft.h>
 #include <qwt_symbol.h>
 
 #include "scope_sink_f_impl.h"
+#include "persistence_map.h"
+#include "capture_latency.h"
+#include "acquisition_clock.h"
+#include "sink_copy.h"
+#include "pipeline_trace.hpp"
+#include "capture_buffer_pool.hpp"
 
 using namespace gr;
 
@@ -76,18 +83,21 @@ namespace adiscope {
                    io_signature::make(nconnections, nconnections, sizeof(float)),
                    io_signature::make(0, 0, 0)),
 	d_size(size), d_buffer_size(2*size), d_samp_rate(samp_rate), d_name(name),
-	d_nconnections(nconnections), d_index(0), d_start(0), d_end(size)
+	d_nconnections(nconnections), d_index(0), d_start(0), d_end(size), d_posted(0),
+	d_tags_enabled(false),
+	d_nsegments(0), d_segments_captured(0),
+	d_time_tag_key(pmt::intern(ACQUISITION_TIME_TAG)),
+	d_has_time_tag(false), d_time_tag_offset(0), d_time_tag_time(0),
+	d_time_tag_sample(0), d_has_frame_time(false), d_frame_time(0),
+	d_frame_sample(0),
+	d_frames_acquired(0), d_frames_posted(0),
+	d_sw_trigger_channel(0), d_sw_trigger_rearm(false)
     {
 
 
       for(int n = 0; n < d_nconnections; n++) {
-	d_buffers.push_back((double*)volk_malloc(d_buffer_size*sizeof(double),
-                                                 volk_get_alignment()));
-	memset(d_buffers[n], 0, d_buffer_size*sizeof(double));
-
-	d_fbuffers.push_back((float*)volk_malloc(d_buffer_size*sizeof(float),
-                                                  volk_get_alignment()));
-	memset(d_fbuffers[n], 0, d_buffer_size*sizeof(float));
+	d_fbuffers.push_back((float*)CaptureBufferPool::getInstance()
+			.allocate(d_buffer_size*sizeof(float)));
 
         d_displayOneBuffer = true;
         d_cleanBuffers = true;
@@ -100,6 +110,9 @@ namespace adiscope {
 
       d_tags = std::vector< std::vector<gr::tag_t> >(d_nconnections);
 
+      d_event_pool = std::make_shared<TimeUpdateBufferPool>(
+		      EVENT_POOL_SIZE, d_nconnections);
+
       initialize();
       this->plot = plot;
 
@@ -117,8 +130,7 @@ namespace adiscope {
     scope_sink_f_impl::~scope_sink_f_impl()
     {
       for(int n = 0; n < d_nconnections; n++) {
-	volk_free(d_buffers[n]);
-	volk_free(d_fbuffers[n]);
+	CaptureBufferPool::getInstance().release(d_fbuffers[n]);
       }
     }
 
@@ -180,17 +192,15 @@ namespace adiscope {
 
 	// Resize buffers and replace data
 	for(int n = 0; n < d_nconnections; n++) {
-	  volk_free(d_buffers[n]);
-	  d_buffers[n] = (double*)volk_malloc(d_buffer_size*sizeof(double),
-                                              volk_get_alignment());
-	  memset(d_buffers[n], 0, d_buffer_size*sizeof(double));
-
-	  volk_free(d_fbuffers[n]);
-	  d_fbuffers[n] = (float*)volk_malloc(d_buffer_size*sizeof(float),
-                                               volk_get_alignment());
-	  memset(d_fbuffers[n], 0, d_buffer_size*sizeof(float));
+	  CaptureBufferPool::getInstance().release(d_fbuffers[n]);
+	  d_fbuffers[n] = (float*)CaptureBufferPool::getInstance()
+			  .allocate(d_buffer_size*sizeof(float));
 	}
 
+        // Segments of the old size are of no use
+        _alloc_segments();
+        d_averager.clear();
+
         _reset();
       }
     }
@@ -243,6 +253,7 @@ namespace adiscope {
       d_start = 0;
       d_index = 0;
       d_end = d_size;
+      d_posted = 0;
 
       // Reset the trigger. If in free running mode, ignore the
       // trigger delay and always set trigger to true.
@@ -252,6 +263,13 @@ namespace adiscope {
       } else {
 	      d_triggered = false;
       }
+
+      if(d_latency) {
+        d_latency->mark(CaptureLatency::ARMED);
+        if(d_triggered) {
+          d_latency->mark(CaptureLatency::TRIGGERED);
+        }
+      }
     }
 
     void
@@ -260,19 +278,292 @@ namespace adiscope {
       int trigger_index;
 
       uint64_t nr = nitems_read(d_trigger_channel);
-      std::vector<gr::tag_t> tags;
-      get_tags_in_range(tags, d_trigger_channel,
+      get_tags_in_range(d_work_tags, d_trigger_channel,
 			nr, nr + nitems + 1,
 			d_trigger_tag_key);
-      if(tags.size() > 0) {
+      if(d_work_tags.size() > 0) {
 	d_triggered = true;
-	trigger_index = tags[0].offset - nr;
+	if(d_latency) {
+	  d_latency->mark(CaptureLatency::TRIGGERED);
+	}
+	trigger_index = d_work_tags[0].offset - nr;
 	d_start = d_index + trigger_index;
 	d_end = d_start + d_size;
 	_adjust_tags(-d_start);
       }
     }
 
+    bool
+    scope_sink_f_impl::_post_data(int nitems, int offset, bool append)
+    {
+      // If the GUI still holds all the slots, it didn't keep up with
+      // the previous frames, so drop this one instead of queuing it.
+      TimeUpdateBufferPool::Slot *slot = d_event_pool->acquire(nitems);
+      if (!slot) {
+        return false;
+      }
+
+      // The payload is float, the plot does the widening to double.
+      // Copy and find the range in the same pass, while the samples are
+      // in the cache anyway; the plot's autoscale then doesn't have to
+      // go over them again on the GUI thread.
+      sink_copy_range<float, float>(d_nconnections, slot->points.data(),
+                                    d_fbuffers.data(), d_start + offset,
+                                    nitems, slot->min.data(),
+                                    slot->max.data());
+      slot->tags = d_tags;
+      slot->offset = offset;
+      slot->append = append;
+
+      d_qApplication->postEvent(this->plot,
+                                new IdentifiableTimeUpdateEvent(d_event_pool,
+                                                                slot,
+                                                                nitems,
+                                                                d_name));
+      d_frames_posted++;
+      return true;
+    }
+
+    void
+    scope_sink_f_impl::set_segments(unsigned int nsegments)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      d_nsegments = nsegments;
+      _alloc_segments();
+    }
+
+    unsigned int
+    scope_sink_f_impl::segments() const
+    {
+      return d_nsegments;
+    }
+
+    unsigned int
+    scope_sink_f_impl::segments_captured() const
+    {
+      return d_segments_captured;
+    }
+
+    double
+    scope_sink_f_impl::segment_time(unsigned int index) const
+    {
+      if (index >= d_segments_captured) {
+        return 0;
+      }
+
+      return (double)(d_segment_times[index] - d_segment_times[0]) / 1e9;
+    }
+
+    bool
+    scope_sink_f_impl::frame_time(uint64_t &time, uint64_t &sample)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      time = d_frame_time;
+      sample = d_frame_sample;
+      return d_has_frame_time;
+    }
+
+    void
+    scope_sink_f_impl::_update_time_tag(const std::vector<gr::tag_t> &tags)
+    {
+      // Only the last one matters, the frames start after it
+      for(auto it = tags.rbegin(); it != tags.rend(); ++it) {
+        if(pmt::eq(it->key, d_time_tag_key) &&
+           acquisition_clock::from_tag_value(it->value, d_time_tag_time,
+                                            d_time_tag_sample)) {
+          d_time_tag_offset = it->offset;
+          d_has_time_tag = true;
+          return;
+        }
+      }
+    }
+
+    void
+    scope_sink_f_impl::_update_frame_time(uint64_t frame_start)
+    {
+      d_has_frame_time = d_has_time_tag && d_samp_rate > 0;
+      if(!d_has_frame_time) {
+        return;
+      }
+
+      int64_t after = (int64_t)(frame_start - d_time_tag_offset);
+      d_frame_time = acquisition_clock::time_of(d_time_tag_time, after,
+                                                d_samp_rate);
+      d_frame_sample = d_time_tag_sample + after;
+    }
+
+    void
+    scope_sink_f_impl::show_segment(unsigned int index)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      if (index >= d_segments_captured || !d_qApplication) {
+        return;
+      }
+
+      TimeUpdateBufferPool::Slot *slot = d_event_pool->acquire(d_size);
+      if (!slot) {
+        return;
+      }
+
+      const float *segment = &d_segments[(size_t)index * d_nconnections * d_size];
+      for(int n = 0; n < d_nconnections; n++) {
+        const float *channel = &segment[(size_t)n * d_size];
+        sink_copy_range<float, float>(1, &slot->points[n], &channel, 0,
+                                      d_size, &slot->min[n], &slot->max[n]);
+        slot->tags[n].clear();
+      }
+
+      d_qApplication->postEvent(this->plot,
+                                new IdentifiableTimeUpdateEvent(d_event_pool,
+                                                                slot,
+                                                                d_size,
+                                                                d_name));
+    }
+
+    void
+    scope_sink_f_impl::replay_segments(frame_listener *listener)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      std::vector<const float *> channels(d_nconnections);
+
+      for(unsigned int i = 0; i < d_segments_captured; i++) {
+        const float *segment = &d_segments[(size_t)i * d_nconnections * d_size];
+
+        for(int n = 0; n < d_nconnections; n++) {
+          channels[n] = &segment[(size_t)n * d_size];
+        }
+
+        listener->frame_ready(channels, d_size);
+      }
+    }
+
+    void
+    scope_sink_f_impl::set_persistence(
+		    const std::vector< std::shared_ptr<PersistenceMap> > &maps)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_persistence = maps;
+    }
+
+    void
+    scope_sink_f_impl::set_acquisition_mode(WaveformAverager::Mode mode,
+                                            unsigned int count)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_averager.configure(mode, count);
+    }
+
+    WaveformAverager::Mode
+    scope_sink_f_impl::acquisition_mode() const
+    {
+      return d_averager.mode();
+    }
+
+    unsigned int
+    scope_sink_f_impl::acquisition_count() const
+    {
+      return d_averager.count();
+    }
+
+    unsigned int
+    scope_sink_f_impl::frames_averaged() const
+    {
+      return d_averager.frames();
+    }
+
+    void
+    scope_sink_f_impl::clear_average()
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_averager.clear();
+    }
+
+    void
+    scope_sink_f_impl::add_frame_listener(frame_listener *listener)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      if (std::find(d_listeners.begin(), d_listeners.end(), listener) ==
+          d_listeners.end()) {
+        d_listeners.push_back(listener);
+      }
+    }
+
+    void
+    scope_sink_f_impl::remove_frame_listener(frame_listener *listener)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      d_listeners.erase(std::remove(d_listeners.begin(), d_listeners.end(),
+                                    listener), d_listeners.end());
+    }
+
+    void
+    scope_sink_f_impl::set_tags_enabled(bool en)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      d_tags_enabled = en;
+      if(!en) {
+        for(size_t n = 0; n < d_tags.size(); n++) {
+          d_tags[n].clear();
+        }
+      }
+    }
+
+    bool
+    scope_sink_f_impl::tags_enabled() const
+    {
+      return d_tags_enabled;
+    }
+
+    uint64_t
+    scope_sink_f_impl::frames_acquired() const
+    {
+      return d_frames_acquired;
+    }
+
+    uint64_t
+    scope_sink_f_impl::frames_posted() const
+    {
+      return d_frames_posted;
+    }
+
+    void
+    scope_sink_f_impl::reset_frame_counters()
+    {
+      d_frames_acquired = 0;
+      d_frames_posted = 0;
+    }
+
+    void
+    scope_sink_f_impl::_alloc_segments()
+    {
+      // Allocated up front, so storing a segment is a plain copy
+      d_segments.assign((size_t)d_nsegments * d_nconnections * d_size, 0.0f);
+      d_segment_times.assign(d_nsegments, 0);
+      d_segments_captured = 0;
+    }
+
+    void
+    scope_sink_f_impl::_store_segment()
+    {
+      float *segment = &d_segments[(size_t)d_segments_captured *
+			d_nconnections * d_size];
+
+      for(int n = 0; n < d_nconnections; n++) {
+        memcpy(&segment[(size_t)n * d_size], &d_fbuffers[n][d_start],
+               d_size * sizeof(float));
+      }
+
+      d_segment_times[d_segments_captured++] = d_has_frame_time ?
+              d_frame_time : acquisition_clock::now();
+    }
+
     void
     scope_sink_f_impl::_npoints_resize()
     {
@@ -299,19 +590,66 @@ namespace adiscope {
 
             // Resize buffers and replace data
             for(int n = 0; n < d_nconnections; n++) {
-                    volk_free(d_buffers[n]);
-                    d_buffers[n] = (double*)volk_malloc(d_buffer_size*sizeof(double),
-                                                        volk_get_alignment());
-                    memset(d_buffers[n], 0, d_buffer_size*sizeof(double));
-
-                    volk_free(d_fbuffers[n]);
-                    d_fbuffers[n] = (float*)volk_malloc(d_buffer_size*sizeof(float),
-                                                        volk_get_alignment());
-                    memset(d_fbuffers[n], 0, d_buffer_size*sizeof(float));
+                    CaptureBufferPool::getInstance().release(d_fbuffers[n]);
+                    d_fbuffers[n] = (float*)CaptureBufferPool::getInstance()
+                            .allocate(d_buffer_size*sizeof(float));
             }
 
             _reset();
             d_cleanBuffers = true;
+
+            // The stream starts over
+            d_sw_trigger.reset();
+            d_averager.clear();
+    }
+
+    void
+    scope_sink_f_impl::set_software_trigger(const SoftwareTrigger &trigger,
+                                            int channel, bool rearm)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      d_sw_trigger = trigger;
+      d_sw_trigger.reset();
+      d_sw_trigger_channel = channel;
+      d_sw_trigger_rearm = rearm;
+    }
+
+    bool
+    scope_sink_f_impl::software_trigger_enabled() const
+    {
+      return d_sw_trigger.type() != SoftwareTrigger::NONE;
+    }
+
+    void
+    scope_sink_f_impl::set_capture_latency(
+		    const std::shared_ptr<CaptureLatency> &latency)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      d_latency = latency;
+    }
+
+    bool
+    scope_sink_f_impl::_sw_trigger_active() const
+    {
+      return !d_displayOneBuffer &&
+        d_sw_trigger.type() != SoftwareTrigger::NONE &&
+        d_sw_trigger_channel >= 0 && d_sw_trigger_channel < d_nconnections;
+    }
+
+    int
+    scope_sink_f_impl::_test_software_trigger(const float *in, int nitems)
+    {
+      int trigger_index = d_sw_trigger.find(in, 0, nitems);
+
+      if(trigger_index >= 0) {
+        d_triggered = true;
+        if(d_latency) {
+          d_latency->mark(CaptureLatency::TRIGGERED);
+        }
+      }
+      return trigger_index;
     }
 
     int
@@ -319,8 +657,9 @@ namespace adiscope {
 			   gr_vector_const_void_star &input_items,
 			   gr_vector_void_star &output_items)
     {
+      PIPELINE_TRACE("scope_sink_f work");
+
       int n=0, idx=0;
-      const float *in;
 
       _npoints_resize();
 
@@ -332,74 +671,148 @@ namespace adiscope {
       int nfill = d_end - d_index;                 // how much room left in buffers
       int nitems = std::min(noutput_items, nfill); // num items we can put in buffers
       int nItemsToSend = 0;
-
+      int skip = 0;
+
+      if(_sw_trigger_active()) {
+        // The sweep starts at the trigger, anything before it is dropped
+        if(!d_triggered) {
+          skip = _test_software_trigger(
+                (const float*)input_items[d_sw_trigger_channel],
+                noutput_items);
+          if(skip < 0) {
+            return noutput_items;
+          }
+          nitems = std::min(noutput_items - skip, nfill);
+        }
+      }
       // If tag trigger, look for the trigger
-      if((d_trigger_mode != TRIG_MODE_FREE) && !d_triggered) {
+      else if((d_trigger_mode != TRIG_MODE_FREE) && !d_triggered) {
 	// trigger off a tag key (first one found)
 	if(d_trigger_mode == TRIG_MODE_TAG) {
 	  _test_trigger_tags(nitems);
 	}
-    }
+      }
 
       // Copy data into the buffers.
+      sink_copy<float, float>(d_nconnections, d_fbuffers.data(), d_index,
+                              input_items.data(), skip, nitems);
       for(n = 0; n < d_nconnections; n++) {
-        in = (const float*)input_items[idx];
-	memcpy(&d_fbuffers[n][d_index], &in[0], nitems*sizeof(float));
-        //volk_32f_convert_64f(&d_buffers[n][d_index],
-        //                     &in[1], nitems);
-
-        uint64_t nr = nitems_read(idx);
-        std::vector<gr::tag_t> tags;
-        get_tags_in_range(tags, idx, nr, nr + nitems + 1);
-        for(size_t t = 0; t < tags.size(); t++) {
-          tags[t].offset = tags[t].offset - nr + (d_index-d_start-1);
-	}
-        d_tags[idx].insert(d_tags[idx].end(), tags.begin(), tags.end());
+        uint64_t nr = nitems_read(idx) + skip;
+        if(idx == 0) {
+          get_tags_in_range(d_work_tags, idx, nr, nr + nitems + 1,
+                            d_time_tag_key);
+          _update_time_tag(d_work_tags);
+        }
+        if(d_tags_enabled) {
+          get_tags_in_range(d_work_tags, idx, nr, nr + nitems + 1);
+          for(size_t t = 0; t < d_work_tags.size(); t++) {
+            gr::tag_t tag = d_work_tags[t];
+            tag.offset = tag.offset - nr + (d_index-d_start-1);
+            d_tags[idx].push_back(tag);
+          }
+        }
         idx++;
       }
       d_index += nitems;
 
       // If we've have a full d_size of items in the buffers, plot.
+      bool sweep_done = false, rearm = false;
       if((d_end != 0 && !d_displayOneBuffer) ||
                       ((d_triggered) && (d_index == d_end) && d_end != 0 && d_displayOneBuffer)) {
-              // Copy data to be plotted to start of buffers.
-              for(n = 0; n < d_nconnections; n++) {
-                      if (!d_displayOneBuffer) {
-                              nItemsToSend = d_index;
-                              if (nItemsToSend >= d_size) {
-                                      nItemsToSend = d_size;
+              if (!d_displayOneBuffer) {
+                      nItemsToSend = d_index;
+                      if (nItemsToSend >= d_size) {
+                              nItemsToSend = d_size;
+                              sweep_done = true;
+                              rearm = _sw_trigger_active() &&
+                                      d_sw_trigger_rearm;
+                              if (!rearm) {
                                       d_cleanBuffers = false;
                               }
-                              volk_32f_convert_64f(d_buffers[n], &d_fbuffers[n][d_start], nItemsToSend);
-                      } else {
-                              //memmove(d_buffers[n], &d_buffers[n][d_start], d_size*sizeof(double));
-                              volk_32f_convert_64f(d_buffers[n], &d_fbuffers[n][d_start], d_size);
-                              nItemsToSend = d_size;
                       }
+              } else {
+                      nItemsToSend = d_size;
+              }
+
+              d_frames_acquired++;
+              _update_frame_time(nitems_read(0) + skip + nitems -
+                                 (d_index - d_start));
+
+              if (d_latency && (d_displayOneBuffer || sweep_done)) {
+                      d_latency->mark(CaptureLatency::ACQUIRED);
+              }
+
+              // Everything downstream sees the averaged frame
+              if (d_displayOneBuffer &&
+                              d_averager.mode() != WaveformAverager::NORMAL) {
+                      d_averager_frame.resize(d_nconnections);
+                      for(n = 0; n < d_nconnections; n++) {
+                              d_averager_frame[n] = &d_fbuffers[n][d_start];
+                      }
+                      d_averager.process(d_averager_frame, d_size);
+              }
+
+              if (!d_listeners.empty() &&
+                              (d_displayOneBuffer || sweep_done)) {
+                      d_listener_frame.resize(d_nconnections);
+                      for(n = 0; n < d_nconnections; n++) {
+                              d_listener_frame[n] = &d_fbuffers[n][d_start];
+                      }
+                      for(auto listener : d_listeners) {
+                              listener->frame_ready(d_listener_frame, d_size);
+                      }
+              }
+
+              if (d_displayOneBuffer) {
+                      for(size_t p = 0; p < d_persistence.size() &&
+                                      p < (size_t)d_nconnections; p++) {
+                              d_persistence[p]->accumulate(
+                                              &d_fbuffers[p][d_start], d_size);
+                      }
+              }
+
+              // While filling the segments nothing goes to the plot, so
+              // that the next trigger is caught as soon as possible.
+              // The last segment is always shown.
+              bool segmenting = false, last_segment = false;
+              if (d_displayOneBuffer && d_segments_captured < d_nsegments) {
+                      _store_segment();
+                      last_segment = (d_segments_captured == d_nsegments);
+                      segmenting = !last_segment;
               }
 
               // Plot if we are able to update
-              if((gr::high_res_timer_now() - d_last_time > d_update_time)
-                              || !d_cleanBuffers) {
+              if(!segmenting && ((gr::high_res_timer_now() - d_last_time > d_update_time)
+                              || sweep_done || last_segment)) {
                       d_last_time = gr::high_res_timer_now();
-                      if (d_qApplication) {
-                              d_qApplication->postEvent(this->plot,
-                                                        new IdentifiableTimeUpdateEvent(d_buffers,
-                                                                                        nItemsToSend,
-                                                                                        d_tags,
-                                                                                        d_name));
+                      if (d_qApplication && !d_displayOneBuffer) {
+                              // Only the samples the plot doesn't have yet.
+                              // If they couldn't be posted, they go with
+                              // the next ones.
+                              if (nItemsToSend > d_posted &&
+                                              _post_data(nItemsToSend - d_posted,
+                                                         d_posted, true)) {
+                                      d_posted = nItemsToSend;
+                              }
+                      } else if (d_qApplication) {
+                              _post_data(nItemsToSend);
                       }
               }
 
-              // We've plotting, so reset the state
+              // We've plotting, so reset the state. A re-armed software
+              // trigger didn't see the samples of the sweep, so it
+              // starts over too.
               if (d_displayOneBuffer) {
                       _reset();
+              } else if (rearm) {
+                      _reset();
+                      d_sw_trigger.reset();
               }
       }
 
       if (d_displayOneBuffer && d_index == d_end) {
               _reset();
       }
-      return nitems;
+      return skip + nitems;
     }
 } /* namespace gr */
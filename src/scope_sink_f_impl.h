@@ -43,11 +43,14 @@
 #define M2K_SCOPE_SINK_F_IMPL_H
 
 #include <gnuradio/high_res_timer.h>
+#include <atomic>
 
 #include "scope_sink_f.h"
 #include "TimeDomainDisplayPlot.h"
 #include "FftDisplayPlot.h"
 
+#define EVENT_POOL_SIZE 3
+
 namespace adiscope {
 
     class scope_sink_f_impl : public scope_sink_f
@@ -61,9 +64,17 @@ namespace adiscope {
       int d_nconnections;
 
       int d_index, d_start, d_end;
+
+      // Rolling mode: samples of the current frame already sent
+      int d_posted;
       std::vector<float*> d_fbuffers;
-      std::vector<double*> d_buffers;
       std::vector< std::vector<gr::tag_t> > d_tags;
+      bool d_tags_enabled;
+      // Scratch storage of the tag lookups, reused across work() calls
+      std::vector<gr::tag_t> d_work_tags;
+
+      // Payloads of the events posted to the plot
+      std::shared_ptr<TimeUpdateBufferPool> d_event_pool;
 
       QObject *plot;
 
@@ -79,10 +90,49 @@ namespace adiscope {
       bool d_displayOneBuffer;
       bool d_cleanBuffers;
 
+      // Segmented memory, d_size samples per channel per segment
+      unsigned int d_nsegments;
+      unsigned int d_segments_captured;
+      std::vector<float> d_segments;
+      // On the acquisition clock, in ns
+      std::vector<uint64_t> d_segment_times;
+
+      // Last acquisition time tag seen, at offset of input 0
+      pmt::pmt_t d_time_tag_key;
+      bool d_has_time_tag;
+      uint64_t d_time_tag_offset, d_time_tag_time, d_time_tag_sample;
+
+      bool d_has_frame_time;
+      uint64_t d_frame_time, d_frame_sample;
+
+      std::vector< std::shared_ptr<PersistenceMap> > d_persistence;
+
+      WaveformAverager d_averager;
+      std::vector<float *> d_averager_frame;
+
+      std::vector<frame_listener *> d_listeners;
+      std::vector<const float *> d_listener_frame;
+
+      std::atomic<uint64_t> d_frames_acquired;
+      std::atomic<uint64_t> d_frames_posted;
+
+      SoftwareTrigger d_sw_trigger;
+      int d_sw_trigger_channel;
+      bool d_sw_trigger_rearm;
+
+      std::shared_ptr<CaptureLatency> d_latency;
+
       void _reset();
       void _npoints_resize();
       void _adjust_tags(int adj);
       void _test_trigger_tags(int nitems);
+      bool _sw_trigger_active() const;
+      int _test_software_trigger(const float *in, int nitems);
+      bool _post_data(int nitems, int offset = 0, bool append = false);
+      void _alloc_segments();
+      void _store_segment();
+      void _update_time_tag(const std::vector<gr::tag_t> &tags);
+      void _update_frame_time(uint64_t frame_start);
 
     public:
       scope_sink_f_impl(int size, double samp_rate,
@@ -108,6 +158,40 @@ namespace adiscope {
       void reset();
       void clean_buffers();
 
+      void set_segments(unsigned int nsegments);
+      unsigned int segments() const;
+      unsigned int segments_captured() const;
+      void replay_segments(frame_listener *listener);
+      double segment_time(unsigned int index) const;
+      bool frame_time(uint64_t &time, uint64_t &sample);
+      void show_segment(unsigned int index);
+
+      void set_persistence(
+		      const std::vector< std::shared_ptr<PersistenceMap> > &maps);
+
+      void set_acquisition_mode(WaveformAverager::Mode mode,
+				unsigned int count);
+      WaveformAverager::Mode acquisition_mode() const;
+      unsigned int acquisition_count() const;
+      unsigned int frames_averaged() const;
+      void clear_average();
+
+      void add_frame_listener(frame_listener *listener);
+      void remove_frame_listener(frame_listener *listener);
+
+      void set_tags_enabled(bool en);
+      bool tags_enabled() const;
+
+      uint64_t frames_acquired() const;
+      uint64_t frames_posted() const;
+      void reset_frame_counters();
+
+      void set_software_trigger(const SoftwareTrigger &trigger,
+				int channel, bool rearm);
+      bool software_trigger_enabled() const;
+
+      void set_capture_latency(
+		      const std::shared_ptr<CaptureLatency> &latency);
 
       int work(int noutput_items,
 	       gr_vector_const_void_star &input_items,
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "script_server.hpp"
+#include "logging_categories.h"
+
+#include <QJSEngine>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QtEndian>
+
+#define FRAME_HEADER_SIZE 9
+#define MAX_FRAME_PAYLOAD (64 * 1024 * 1024)
+/* Output left unread by the controller before a stream skips updates */
+#define MAX_STREAM_BACKLOG (16 * 1024 * 1024)
+
+using namespace adiscope;
+
+ScriptServer::ScriptServer(QJSEngine *engine, QObject *parent) :
+	QObject(parent),
+	engine(engine)
+{
+	connect(&server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+ScriptServer::~ScriptServer()
+{
+	for (auto it = clients.begin(); it != clients.end(); ++it) {
+		it.key()->disconnect(this);
+		it.key()->abort();
+		it.key()->deleteLater();
+	}
+}
+
+bool ScriptServer::listen(quint16 port, const QHostAddress& address)
+{
+	if (!server.listen(address, port)) {
+		qWarning(CAT_SCRIPT_SERVER) << "Unable to listen on port" << port
+			<< ":" << server.errorString();
+		return false;
+	}
+
+	qDebug(CAT_SCRIPT_SERVER) << "Listening on"
+		<< server.serverAddress().toString() << server.serverPort();
+	return true;
+}
+
+void ScriptServer::newConnection()
+{
+	while (server.hasPendingConnections()) {
+		QTcpSocket *socket = server.nextPendingConnection();
+
+		socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+		clients.insert(socket, Client());
+
+		connect(socket, SIGNAL(readyRead()), this, SLOT(readFrames()));
+		connect(socket, SIGNAL(disconnected()),
+			this, SLOT(clientDisconnected()));
+
+		qDebug(CAT_SCRIPT_SERVER) << "Controller connected from"
+			<< socket->peerAddress().toString();
+	}
+}
+
+void ScriptServer::clientDisconnected()
+{
+	QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+
+	/* The stream timers are children of the socket */
+	clients.remove(socket);
+	socket->deleteLater();
+}
+
+void ScriptServer::readFrames()
+{
+	QTcpSocket *socket = static_cast<QTcpSocket *>(sender());
+	auto it = clients.find(socket);
+	if (it == clients.end())
+		return;
+
+	it->pending.append(socket->readAll());
+
+	while (it->pending.size() >= FRAME_HEADER_SIZE) {
+		const uchar *header = reinterpret_cast<const uchar *>(
+				it->pending.constData());
+		quint8 type = header[0];
+		quint32 id = qFromBigEndian<quint32>(header + 1);
+		quint32 length = qFromBigEndian<quint32>(header + 5);
+
+		if (length > MAX_FRAME_PAYLOAD) {
+			qWarning(CAT_SCRIPT_SERVER) << "Frame too large, dropping"
+				<< "the controller";
+			socket->abort();
+			return;
+		}
+
+		if ((quint32)it->pending.size() < FRAME_HEADER_SIZE + length)
+			break;
+
+		QByteArray payload = it->pending.mid(FRAME_HEADER_SIZE, length);
+		it->pending.remove(0, FRAME_HEADER_SIZE + length);
+
+		handleFrame(socket, type, id, payload);
+
+		/* The script may have closed the connection */
+		it = clients.find(socket);
+		if (it == clients.end())
+			return;
+	}
+}
+
+void ScriptServer::handleFrame(QTcpSocket *socket, quint8 type, quint32 id,
+			       const QByteArray& payload)
+{
+	switch (type) {
+	case FRAME_EVAL:
+		sendValue(socket, id, engine->evaluate(
+				QString::fromUtf8(payload), "remote"));
+		break;
+	case FRAME_STREAM:
+		startStream(socket, id, payload);
+		break;
+	case FRAME_STOP:
+		stopStream(socket, id);
+		break;
+	default:
+		sendFrame(socket, FRAME_ERROR, id,
+			  QByteArray("Unknown frame type"));
+		break;
+	}
+}
+
+void ScriptServer::startStream(QTcpSocket *socket, quint32 id,
+			       const QByteArray& payload)
+{
+	if (payload.size() < 4) {
+		sendFrame(socket, FRAME_ERROR, id, QByteArray("Missing interval"));
+		return;
+	}
+
+	quint32 interval = qFromBigEndian<quint32>(
+			reinterpret_cast<const uchar *>(payload.constData()));
+	QString expr = QString::fromUtf8(payload.mid(4));
+
+	/* Compiled once, only called on each update */
+	QJSValue fn = engine->evaluate("(function() { return (" + expr +
+				       "); })", "remote");
+	if (fn.isError() || !fn.isCallable()) {
+		sendValue(socket, id, fn);
+		return;
+	}
+
+	stopStream(socket, id);
+
+	Stream stream;
+	stream.expression = fn;
+	stream.timer = new QTimer(socket);
+	stream.timer->setInterval(interval);
+
+	connect(stream.timer, &QTimer::timeout, this, [=]() {
+		if (socket->bytesToWrite() > MAX_STREAM_BACKLOG)
+			return;
+
+		auto it = clients.find(socket);
+		if (it == clients.end() || !it->streams.contains(id))
+			return;
+
+		sendValue(socket, id, it->streams[id].expression.call());
+	});
+
+	clients[socket].streams.insert(id, stream);
+	stream.timer->start();
+}
+
+void ScriptServer::stopStream(QTcpSocket *socket, quint32 id)
+{
+	auto it = clients.find(socket);
+	if (it == clients.end())
+		return;
+
+	auto stream = it->streams.find(id);
+	if (stream == it->streams.end())
+		return;
+
+	stream->timer->stop();
+	stream->timer->deleteLater();
+	it->streams.erase(stream);
+}
+
+void ScriptServer::sendValue(QTcpSocket *socket, quint32 id,
+			     const QJSValue& val)
+{
+	if (val.isError()) {
+		sendFrame(socket, FRAME_ERROR, id, val.toString().toUtf8());
+		return;
+	}
+
+	/* ArrayBuffers come back as byte arrays, they are sent as they
+	 * are */
+	QVariant variant = val.toVariant();
+	if (variant.type() == QVariant::ByteArray) {
+		sendFrame(socket, FRAME_DATA, id, variant.toByteArray());
+	} else if (val.isUndefined()) {
+		sendFrame(socket, FRAME_RESULT, id, QByteArray());
+	} else {
+		sendFrame(socket, FRAME_RESULT, id, val.toString().toUtf8());
+	}
+}
+
+void ScriptServer::sendFrame(QTcpSocket *socket, quint8 type, quint32 id,
+			     const QByteArray& payload)
+{
+	uchar header[FRAME_HEADER_SIZE];
+
+	header[0] = type;
+	qToBigEndian<quint32>(id, header + 1);
+	qToBigEndian<quint32>(payload.size(), header + 5);
+
+	socket->write(reinterpret_cast<const char *>(header), sizeof(header));
+	socket->write(payload);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRIPT_SERVER_HPP
+#define SCRIPT_SERVER_HPP
+
+#include <QHostAddress>
+#include <QJSValue>
+#include <QMap>
+#include <QObject>
+#include <QTcpServer>
+
+class QJSEngine;
+class QTcpSocket;
+class QTimer;
+
+namespace adiscope {
+
+/*
+ * Lets a test controller drive the script engine over TCP.
+ *
+ * Every message is a frame of a 1 byte type, a 4 byte request ID and a
+ * 4 byte payload length, all big endian, followed by the payload:
+ *
+ *  EVAL   script            -> RESULT text, ERROR text or DATA bytes
+ *  STREAM interval, expr    -> DATA bytes every interval ms, until STOP
+ *  STOP   (empty)           -> stops the stream with the same ID
+ *
+ * An expression evaluating to an ArrayBuffer (the dataBuffer() of the
+ * tools) is sent as a DATA frame as it is, everything else as text.
+ * The interval of STREAM is a 4 byte big endian count of milliseconds
+ * followed by the expression, which is compiled once. A stream skips
+ * its updates while the controller has not read the previous ones.
+ */
+class ScriptServer : public QObject
+{
+	Q_OBJECT
+
+public:
+	enum FrameType {
+		FRAME_EVAL = 0x01,
+		FRAME_STREAM = 0x02,
+		FRAME_STOP = 0x03,
+		FRAME_RESULT = 0x81,
+		FRAME_ERROR = 0x82,
+		FRAME_DATA = 0x83,
+	};
+
+	explicit ScriptServer(QJSEngine *engine, QObject *parent = nullptr);
+	~ScriptServer();
+
+	/* Only local controllers are accepted unless address says so */
+	bool listen(quint16 port,
+		    const QHostAddress& address = QHostAddress::LocalHost);
+
+private Q_SLOTS:
+	void newConnection();
+	void readFrames();
+	void clientDisconnected();
+
+private:
+	struct Stream {
+		QJSValue expression;
+		QTimer *timer;
+	};
+
+	struct Client {
+		QByteArray pending;
+		QMap<quint32, Stream> streams;
+	};
+
+	void handleFrame(QTcpSocket *socket, quint8 type, quint32 id,
+			 const QByteArray& payload);
+	void startStream(QTcpSocket *socket, quint32 id,
+			 const QByteArray& payload);
+	void stopStream(QTcpSocket *socket, quint32 id);
+	void sendValue(QTcpSocket *socket, quint32 id, const QJSValue& val);
+	void sendFrame(QTcpSocket *socket, quint8 type, quint32 id,
+		       const QByteArray& payload);
+
+	QJSEngine *engine;
+	QTcpServer server;
+	QMap<QTcpSocket *, Client> clients;
+};
+}
+
+#endif /* SCRIPT_SERVER_HPP */
@@ -0,0 +1,164 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "script_worker.hpp"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJSEngine>
+
+#include <iostream>
+
+using namespace adiscope;
+
+ScriptHost::ScriptHost(QJSEngine *engine, QObject *parent) :
+	QObject(parent), engine(engine)
+{
+}
+
+QVariantMap ScriptHost::read(const QStringList& expressions)
+{
+	QVariantMap result;
+	QVariantList values;
+
+	for (const QString& expr : expressions) {
+		QJSValue val = engine->evaluate(expr, "scopy");
+
+		if (val.isError()) {
+			result.insert("error", val.toString());
+			return result;
+		}
+
+		values.append(val.toVariant());
+	}
+
+	result.insert("values", values);
+	return result;
+}
+
+void ScriptHost::post(const QString& program)
+{
+	/* Nobody waits for the result, errors are only logged */
+	QJSValue val = engine->evaluate(program, "scopy");
+
+	if (val.isError())
+		qWarning() << "Exception in posted script:" << val.toString();
+}
+
+ScriptBridge::ScriptBridge(QJSEngine *engine, ScriptHost *host) :
+	QObject(engine), engine(engine), host(host)
+{
+	QJSValue js_obj = engine->newQObject(this);
+
+	engine->globalObject().setProperty("scopy", js_obj);
+
+	/* The helpers of the GUI engine, usable from this thread */
+	for (const char *name : { "sleep", "msleep", "printToConsole" })
+		engine->globalObject().setProperty(name, js_obj.property(name));
+}
+
+void ScriptBridge::reportError(const QString& message)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+	engine->throwError(message);
+#else
+	qWarning() << "Exception in the GUI engine:" << message;
+#endif
+}
+
+QJSValue ScriptBridge::eval(const QString& program)
+{
+	QJSValue values = read(QStringList() << program);
+
+	return values.isArray() ? values.property(0) : values;
+}
+
+void ScriptBridge::post(const QString& program)
+{
+	QMetaObject::invokeMethod(host, "post", Qt::QueuedConnection,
+				  Q_ARG(QString, program));
+}
+
+QJSValue ScriptBridge::read(const QStringList& expressions)
+{
+	QVariantMap result;
+
+	QMetaObject::invokeMethod(host, "read",
+				  Qt::BlockingQueuedConnection,
+				  Q_RETURN_ARG(QVariantMap, result),
+				  Q_ARG(QStringList, expressions));
+
+	if (result.contains("error")) {
+		reportError(result.value("error").toString());
+		return QJSValue();
+	}
+
+	return engine->toScriptValue(result.value("values").toList());
+}
+
+void ScriptBridge::sleep(unsigned long s)
+{
+	msleep(s * 1000);
+}
+
+void ScriptBridge::msleep(unsigned long ms)
+{
+	/* Nothing else runs on this thread */
+	QThread::msleep(ms);
+}
+
+void ScriptBridge::printToConsole(const QString& text)
+{
+	std::cout << text.toStdString() << std::endl;
+}
+
+ScriptWorker::ScriptWorker(QJSEngine *gui_engine, const QString& program,
+			   const QString& filename, QObject *parent) :
+	QThread(parent),
+	host(gui_engine),
+	program(program),
+	filename(filename),
+	exit_code(EXIT_SUCCESS)
+{
+}
+
+ScriptWorker::~ScriptWorker()
+{
+	wait();
+}
+
+void ScriptWorker::run()
+{
+	QJSEngine engine;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+	engine.installExtensions(QJSEngine::ConsoleExtension);
+#endif
+	new ScriptBridge(&engine, &host);
+
+	QJSValue val = engine.evaluate(program, filename);
+
+	if (val.isError()) {
+		qInfo() << "Exception:" << val.toString();
+		exit_code = EXIT_FAILURE;
+	} else if (!val.isUndefined()) {
+		qInfo() << val.toString();
+	}
+}
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRIPT_WORKER_HPP
+#define SCRIPT_WORKER_HPP
+
+#include <QJSValue>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QVariant>
+
+class QJSEngine;
+
+namespace adiscope {
+
+/*
+ * Runs a script on its own thread and engine, so that waiting on the
+ * hardware doesn't hold back the plots.
+ *
+ * The tools stay on the GUI thread: the script reaches them through
+ * the "scopy" object, whose calls are evaluated by the GUI engine.
+ * eval() waits for the result, post() doesn't wait and read() gets
+ * several values in a single round trip, e.g.
+ *
+ *	scopy.post("osc.running = true")
+ *	msleep(1000)
+ *	var v = scopy.read(["dmm.value_ch1", "dmm.value_ch2"])
+ *
+ * Values cross as QVariants, ArrayBuffers (the dataBuffer() of the
+ * tools) included.
+ */
+class ScriptHost : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit ScriptHost(QJSEngine *engine, QObject *parent = nullptr);
+
+public Q_SLOTS:
+	/* The results under "values", or the message of the exception
+	 * under "error" */
+	QVariantMap read(const QStringList& expressions);
+	void post(const QString& program);
+
+private:
+	QJSEngine *engine;
+};
+
+class ScriptBridge : public QObject
+{
+	Q_OBJECT
+
+public:
+	ScriptBridge(QJSEngine *engine, ScriptHost *host);
+
+	Q_INVOKABLE QJSValue eval(const QString& program);
+	Q_INVOKABLE void post(const QString& program);
+	Q_INVOKABLE QJSValue read(const QStringList& expressions);
+
+	Q_INVOKABLE void sleep(unsigned long s);
+	Q_INVOKABLE void msleep(unsigned long ms);
+	Q_INVOKABLE void printToConsole(const QString& text);
+
+private:
+	void reportError(const QString& message);
+
+	QJSEngine *engine;
+	ScriptHost *host;
+};
+
+class ScriptWorker : public QThread
+{
+	Q_OBJECT
+
+public:
+	ScriptWorker(QJSEngine *gui_engine, const QString& program,
+		     const QString& filename, QObject *parent = nullptr);
+	~ScriptWorker();
+
+	int exitCode() const { return exit_code; }
+
+protected:
+	void run() override;
+
+private:
+	ScriptHost host;
+	QString program;
+	QString filename;
+	int exit_code;
+};
+}
+
+#endif /* SCRIPT_WORKER_HPP */
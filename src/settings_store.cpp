@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "settings_store.hpp"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QIODevice>
+#include <QtConcurrentRun>
+
+using namespace adiscope;
+
+static const quint32 settings_magic = 0x53435354; /* "SCST" */
+static const quint32 settings_version = 1;
+
+static bool readBinary(QIODevice& device, QSettings::SettingsMap& map)
+{
+	QDataStream in(&device);
+	quint32 magic, version;
+
+	in >> magic >> version;
+	if (magic != settings_magic || version != settings_version)
+		return false;
+
+	in.setVersion(QDataStream::Qt_5_0);
+	in >> map;
+
+	return in.status() == QDataStream::Ok;
+}
+
+static bool writeBinary(QIODevice& device, const QSettings::SettingsMap& map)
+{
+	QDataStream out(&device);
+
+	out << settings_magic << settings_version;
+	out.setVersion(QDataStream::Qt_5_0);
+	out << map;
+
+	return out.status() == QDataStream::Ok;
+}
+
+SettingsStore::SettingsStore()
+{
+	writer.setMaxThreadCount(1);
+}
+
+SettingsStore& SettingsStore::getInstance()
+{
+	static SettingsStore Instance;
+
+	return Instance;
+}
+
+QSettings::Format SettingsStore::format()
+{
+	static const QSettings::Format fmt = QSettings::registerFormat(
+			"bin", readBinary, writeBinary);
+
+	return fmt;
+}
+
+QString SettingsStore::directory() const
+{
+	QSettings settings;
+
+	return QFileInfo(settings.fileName()).absolutePath() + "/tools";
+}
+
+/* The working copy of the launcher, see ToolLauncher::saveSettings() */
+QString SettingsStore::legacyFile() const
+{
+	QSettings settings;
+
+	return settings.fileName() + ".bak";
+}
+
+QSettings *SettingsStore::open(const QString& tool)
+{
+	QDir().mkpath(directory());
+
+	QSettings *settings = new QSettings(directory() + "/" + tool + ".bin",
+			format());
+
+	/* Where the tool keeps its window */
+	import(*settings, tool);
+	return settings;
+}
+
+void SettingsStore::release(QSettings *settings)
+{
+	if (!settings)
+		return;
+
+	/* Deleted by the worker, which also writes it */
+	settings->moveToThread(nullptr);
+
+	QtConcurrent::run(&writer, [settings]() {
+		delete settings;
+	});
+}
+
+void SettingsStore::import(QSettings& settings, const QString& group)
+{
+	if (settings.format() != format() ||
+			settings.childGroups().contains(group))
+		return;
+
+	QSettings legacy(legacyFile(), QSettings::IniFormat);
+
+	legacy.beginGroup(group);
+	for (const QString& key : legacy.allKeys())
+		settings.setValue(group + "/" + key, legacy.value(key));
+	legacy.endGroup();
+}
+
+void SettingsStore::flush()
+{
+	writer.waitForDone();
+}
+
+void SettingsStore::clear()
+{
+	flush();
+
+	QDir dir(directory());
+
+	for (const QString& file : dir.entryList({ "*.bin" }, QDir::Files))
+		dir.remove(file);
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SETTINGS_STORE_HPP
+#define SETTINGS_STORE_HPP
+
+#include <QSettings>
+#include <QString>
+#include <QThreadPool>
+
+namespace adiscope {
+
+/*
+ * The saved state of each tool, in a binary file of its own next to the
+ * settings of Scopy. A tool only reads its own file, when it gets built,
+ * rather than all the tools parsing the one INI file of the launcher;
+ * and the file is written on a worker once the tool is done with it,
+ * rather than by the GUI while the tool gets destroyed.
+ *
+ * The state kept so far in the INI file is taken over by the tools the
+ * first time they find nothing in their own file.
+ */
+class SettingsStore
+{
+public:
+	static SettingsStore& getInstance();
+
+	/* The binary format of the files, a QDataStream of the keys */
+	static QSettings::Format format();
+
+	/* The settings of the tool; given back to release() */
+	QSettings *open(const QString& tool);
+
+	/* Written and deleted on the worker, in the order released */
+	void release(QSettings *settings);
+
+	/* Copies group from the INI file if the settings of a tool don't
+	 * have it yet; nothing for other settings */
+	void import(QSettings& settings, const QString& group);
+
+	/* Waits for the settings released so far to be written */
+	void flush();
+
+	/* Removes the files of all the tools, once written */
+	void clear();
+
+private:
+	SettingsStore();
+
+	QString directory() const;
+	QString legacyFile() const;
+
+	/* One thread, so that the writes of a file keep their order */
+	QThreadPool writer;
+};
+}
+
+#endif /* SETTINGS_STORE_HPP */
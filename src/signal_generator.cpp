@@ -24,15 +24,25 @@
 #include "spinbox_a.hpp"
 #include "ui_signal_generator.h"
 #include "channel_widget.hpp"
+#include "spectrumUpdateEvents.h"
+#include "math_expression.hpp"
+#include "noise_generator.hpp"
 
+#include <algorithm>
 #include <cmath>
 
 #include <QBrush>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
 #include <QFileDialog>
 #include <QFileInfo>
 #include <QPalette>
 #include <QSharedPointer>
 #include <QElapsedTimer>
+#include <QtConcurrentMap>
+#include <QtConcurrentRun>
 
 #include <gnuradio/analog/sig_source.h>
 #include <gnuradio/analog/sig_source_waveform.h>
@@ -62,9 +72,6 @@
 #include <scopy/math.h>
 #include <scopy/trapezoidal.h>
 
-#ifdef MATLAB_SUPPORT_SIGGEN
-#include <matio.h>
-#endif
 
 #include <iio.h>
 
@@ -87,6 +94,93 @@ enum {
 
 Q_DECLARE_METATYPE(QSharedPointer<signal_generator_data>);
 
+namespace {
+/* Constants, sine waves and math functions need no flowgraph, their
+ * samples and noise are computed directly */
+bool isSynthesizable(const signal_generator_data& data)
+{
+	if (data.type == SIGNAL_TYPE_MATH) {
+		if (data.function.isEmpty() || data.math_freq <= 0) {
+			return false;
+		}
+
+		/* Names only iio_math knows keep the flowgraph */
+		try {
+			MathExpression(data.function.toStdString());
+		} catch (std::invalid_argument&) {
+			return false;
+		}
+
+		return true;
+	}
+
+	return data.type == SIGNAL_TYPE_CONSTANT ||
+		(data.type == SIGNAL_TYPE_WAVEFORM &&
+		 data.waveform == SG_SIN_WAVE);
+}
+
+/* Calls f(i, volts) for the first count samples of the signal, with the
+ * parameters getSignalSource() gives the sig_source_f */
+template <typename F>
+void synthesize(const signal_generator_data& data, double sample_rate,
+		double phase_correction, size_t count, F f)
+{
+	if (data.type == SIGNAL_TYPE_CONSTANT) {
+		for (size_t i = 0; i < count; i++) {
+			f(i, data.constant);
+		}
+
+		return;
+	}
+
+	if (data.type == SIGNAL_TYPE_MATH) {
+		static const size_t block = 4096;
+
+		MathExpression function(data.function.toStdString());
+		std::vector<float> t(block), volts(block);
+		const float *inputs[] = { t.data() };
+
+		/* t is the 0 .. 2 pi sawtooth iio_math_gen feeds the function,
+		 * a GR saw wave starts at half its amplitude */
+		double start = 0.5 + phase_correction / 360.0;
+		double cycles = data.math_freq / sample_rate;
+
+		for (size_t first = 0; first < count; first += block) {
+			size_t n = std::min(block, count - first);
+
+			for (size_t i = 0; i < n; i++) {
+				double c = start + cycles * (first + i);
+				t[i] = 2.0 * M_PI * (c - std::floor(c));
+			}
+
+			function.evaluate(inputs, volts.data(), n);
+
+			for (size_t i = 0; i < n; i++) {
+				f(first + i, volts[i]);
+			}
+		}
+
+		return;
+	}
+
+	double amplitude = data.amplitude / 2.0;
+	double phase = data.phase + phase_correction;
+
+	if (phase < 0) {
+		phase = phase + 360.0;
+	}
+
+	double phase0 = phase * 0.01745329;
+	double w = 2.0 * M_PI * data.frequency / sample_rate;
+
+	/* The phase of each sample comes from its index, so the error does
+	 * not add up over long buffers as it would with an accumulator */
+	for (size_t i = 0; i < count; i++) {
+		f(i, data.offset + amplitude * std::sin(phase0 + w * i));
+	}
+}
+}
+
 bool SignalGenerator::riffCompare(riff_header_t& ptr,const char *id2)
 {
 	const char riff[]="RIFF";
@@ -125,11 +219,16 @@ SignalGenerator::SignalGenerator(struct iio_context *_ctx,
 	nr_of_periods(2),
 	currentChannel(0), sample_rate(0),
 	settings_group(new QButtonGroup(this)),nb_points(NB_POINTS),
-	channels_group(new QButtonGroup(this))
+	channels_group(new QButtonGroup(this)),
+	streamsStop(false),
+	syncSkew(0.0)
 {
 	zoomT1=0;
 	zoomT2=1;
 	ui->setupUi(this);
+
+	/* The cost is in samples, this keeps up to 64 MiB of waveforms */
+	waveformCache.setMaxCost(32 * 1024 * 1024);
 	this->setAttribute(Qt::WA_DeleteOnClose, true);
 
 	this->plot = new OscilloscopePlot(this);
@@ -375,6 +474,7 @@ SignalGenerator::SignalGenerator(struct iio_context *_ctx,
 		ptr->file_type=FORMAT_NO_FILE;
 		ptr->file_nr_of_channels=0;
 		ptr->file_channel=0;
+		ptr->file_streaming=false;
 
 		ptr->type = SIGNAL_TYPE_CONSTANT;
 		ptr->id = i;
@@ -515,6 +615,11 @@ SignalGenerator::SignalGenerator(struct iio_context *_ctx,
 	        this, SLOT(tabChanged(int)));
 
 	connect(ui->load_file, SIGNAL(pressed()), this, SLOT(loadFile()));
+
+	fileImportWatcher = new QFutureWatcher<QPair<bool,
+			QSharedPointer<signal_generator_data>>>(this);
+	connect(fileImportWatcher, SIGNAL(finished()),
+		this, SLOT(fileImportFinished()));
 	connect(ui->mathWidget, SIGNAL(functionValid(const QString&)),
 	        this, SLOT(setFunction(const QString&)));
 
@@ -530,6 +635,11 @@ SignalGenerator::SignalGenerator(struct iio_context *_ctx,
 
 	time_block_data->time_block->set_update_time(0.001);
 
+	// A preview made while hidden gets drawn once the tool is shown
+	connect(this, &Tool::displayedChanged, [=](bool displayed) {
+		plot->setDisplaySuspended(!displayed);
+	});
+
 	plot->addZoomer(0);
 	resetZoom();
 
@@ -552,6 +662,8 @@ SignalGenerator::~SignalGenerator()
 	}
 	delete api;
 
+	/* An import still running uses this object */
+	fileImportWatcher->waitForFinished();
 	delete fileManager;
 
 	delete plot;
@@ -763,6 +875,9 @@ void SignalGenerator::fileChannelChanged(int value)
 		this->ui->label_size->setText(QString::number(
 		                                      ptr->file_nr_of_samples[ptr->file_channel]) +
 					      tr(" samples"));
+
+		/* Only the selected column or variable is decoded */
+		loadFileChannelData(currentChannel);
 		resetZoom();
 	}
 }
@@ -976,9 +1091,26 @@ void SignalGenerator::updatePreview()
 	static const float MIN_PREVIEW_RANGE = (float)(SHRT_MIN);
 
 	const int nb_points_correction = 16; // generate slightly more points to avoid incomplete scope_sink_f buffer
-	gr::top_block_sptr top = make_top_block("Signal Generator Update");
 	unsigned int i = 0;
 	bool enabled = false;
+	bool native = true;
+
+	for (auto it = channels.begin(); it != channels.end(); ++it) {
+		if ((*it)->enableButton()->isChecked()) {
+			enabled = true;
+			native = native && isSynthesizable(*getData(*it));
+		}
+	}
+
+	/* Knob changes call this for every tick, the flowgraph is only
+	 * worth it for the signals that can not be computed directly */
+	if (native) {
+		updateNativePreview();
+		restartIfRunning(enabled);
+		return;
+	}
+
+	gr::top_block_sptr top = make_top_block("Signal Generator Update");
 
 	time_block_data->time_block->reset();
 	for (auto it = channels.begin(); it != channels.end(); ++it) {
@@ -987,7 +1119,6 @@ void SignalGenerator::updatePreview()
 		if ((*it)->enableButton()->isChecked()) {
 
 			source = getSource((*it), sample_rate, top, true);
-			enabled = true;
 		} else {
 			source = blocks::nop::make(sizeof(float));
 		}
@@ -1006,8 +1137,15 @@ void SignalGenerator::updatePreview()
 	qDebug(CAT_SIGNAL_GENERATOR) << "The slow operation took" << timer.elapsed() << "milliseconds";
 	top->disconnect_all();
 
+	restartIfRunning(enabled);
+}
+
+void SignalGenerator::restartIfRunning(bool enabled)
+{
 	if (ui->run_button->isChecked()) {
-		if (enabled) {
+		if (enabled && (buffers.size() > 0 || streams.size() > 0)) {
+			reloadBuffers();
+		} else if (enabled) {
 			stop();
 			start();
 		} else {
@@ -1049,7 +1187,8 @@ enum sg_file_format SignalGenerator::getFileFormat(QString filePath)
 
 
 bool SignalGenerator::loadParametersFromFile(
-        QSharedPointer<signal_generator_data> ptr,QString filePath)
+        QSharedPointer<signal_generator_data> ptr,QString filePath,
+        FileManager *manager)
 {
 	ptr->file_message="";
 	ptr->file=filePath;
@@ -1126,7 +1265,7 @@ bool SignalGenerator::loadParametersFromFile(
 	if (ptr->file_type==FORMAT_CSV) {
 
 		try {
-			fileManager->open(ptr->file, FileManager::IMPORT);
+			manager->open(ptr->file, FileManager::IMPORT);
 		} catch(FileManagerException &e) {
 			ptr->file_message=QString::fromLocal8Bit(e.what());
 			ptr->file_nr_of_samples.push_back(0);
@@ -1135,15 +1274,15 @@ bool SignalGenerator::loadParametersFromFile(
 		}
 
 		ptr->file_data.clear();
-		ptr->file_nr_of_channels = fileManager->getNrOfChannels();
+		ptr->file_nr_of_channels = manager->getNrOfChannels();
 
-		if(fileManager->getSampleRate())
-			ptr->file_sr = fileManager->getSampleRate();
+		if(manager->getSampleRate())
+			ptr->file_sr = manager->getSampleRate();
 
 		ptr->file_channel=0; // autoselect channel 0
 		for (auto i=0; i<ptr->file_nr_of_channels; i++) {
 			ptr->file_channel_names.push_back("Column " + QString::number(i));
-			ptr->file_nr_of_samples.push_back(fileManager->getNrOfSamples());
+			ptr->file_nr_of_samples.push_back(manager->getNrOfSamples());
 		}
 
 		ptr->file_message="CSV";
@@ -1151,38 +1290,28 @@ bool SignalGenerator::loadParametersFromFile(
 
 #ifdef MATLAB_SUPPORT_SIGGEN
 	if (ptr->file_type==FORMAT_MAT) {
-		mat_t *matfp;
-		matvar_t *matvar;
-		matfp = Mat_Open(filePath.toStdString().c_str(),MAT_ACC_RDONLY);
+		/* Kept open with its index, loadFileChannelData() only
+		 * reads the data of the selected variable */
+		ptr->file_mat = MatFile::open(filePath);
 
-		if (NULL == matfp) {
+		if (!ptr->file_mat) {
 			qDebug(CAT_SIGNAL_GENERATOR)<<"Error opening MAT file "<<filePath;
 			ptr->file_nr_of_samples.push_back(0);
 			ptr->file_message = "MAT file could not be parsed";
 			return false;
 		}
 
-		while ((matvar = Mat_VarReadNextInfo(matfp)) != NULL) {
-
-			/* must be a vector */
-			if (!(matvar->rank !=2 || (matvar->dims[0] > 1 && matvar->dims[1] > 1)
-			      || matvar->class_type != MAT_C_DOUBLE)) {
-				Mat_VarReadDataAll(matfp, matvar);
-
-				if (!matvar->isComplex) {
-					qDebug(CAT_SIGNAL_GENERATOR)<<"Complex buffers not supported";
-					ptr->file_message="Complex buffers not supported";
-					ptr->file_channel_names.push_back(QString(matvar->name));
-					ptr->file_nr_of_samples.push_back(*matvar->dims);
-					ptr->file_nr_of_channels++;
-				}
+		ptr->file_message = "MAT";
+		for (const MatFile::Variable &var : ptr->file_mat->variables()) {
+			/* must be a vector of real doubles */
+			if (!var.usable) {
+				continue;
 			}
 
-			Mat_VarFree(matvar);
-			matvar = NULL;
+			ptr->file_channel_names.push_back(var.name);
+			ptr->file_nr_of_samples.push_back(var.rows * var.cols);
+			ptr->file_nr_of_channels++;
 		}
-
-		Mat_Close(matfp);
 	}
 #endif
 
@@ -1193,8 +1322,6 @@ bool SignalGenerator::loadParametersFromFile(
         return false;
 	}
 
-	ui->fileChannel->setEnabled(ptr->file_nr_of_channels > 1);
-
 	std::shared_ptr<GenericDac> dac ;
 	for(auto ch : channel_dac)
 		if(ptr->iio_ch==ch.first){
@@ -1227,18 +1354,67 @@ void SignalGenerator::reloadFileFromPath()
 
 void SignalGenerator::loadFileFromPath(QString filename){
     auto ptr = getCurrentData();
+    auto imported = importFile(ptr, filename);
+
+    applyImportedFile(ptr, imported.first, imported.second);
+}
+
+QPair<bool, QSharedPointer<signal_generator_data>> SignalGenerator::importFile(
+        QSharedPointer<signal_generator_data> ptr, QString filename)
+{
+    /* May run on a worker: the file is parsed into a copy, with a file
+     * manager of its own */
+    FileManager manager("Signal Generator");
+    QSharedPointer<signal_generator_data> parsed(
+                new signal_generator_data(*ptr));
+
+    parsed->file = filename;
+    bool loaded = loadParametersFromFile(parsed, parsed->file, &manager);
+
+    if (loaded) {
+        loadFileChannelData(parsed, &manager);
+    }
+
+    return qMakePair(loaded, parsed);
+}
+
+void SignalGenerator::applyImportedFile(QSharedPointer<signal_generator_data> ptr,
+                                        bool loaded,
+                                        QSharedPointer<signal_generator_data> parsed)
+{
+    /* Only the file fields, the others may have changed meanwhile */
+    ptr->file = parsed->file;
+    ptr->file_message = parsed->file_message;
+    ptr->file_type = parsed->file_type;
+    ptr->file_sr = parsed->file_sr;
+    ptr->file_amplitude = parsed->file_amplitude;
+    ptr->file_offset = parsed->file_offset;
+    ptr->file_phase = parsed->file_phase;
+    ptr->file_nr_of_channels = parsed->file_nr_of_channels;
+    ptr->file_channel = parsed->file_channel;
+    ptr->file_nr_of_samples = parsed->file_nr_of_samples;
+    ptr->file_channel_names = parsed->file_channel_names;
+    ptr->file_wav_hdr = parsed->file_wav_hdr;
+    ptr->file_data.swap(parsed->file_data);
+
+    if (!loaded) {
+        ptr->file_type=FORMAT_NO_FILE;
+    }
+
+    /* The panel shows another channel, it is updated when selected */
+    if (ptr != getCurrentData()) {
+        return;
+    }
 
-    ptr->file = filename;
     ui->label_path->setText(ptr->file);
     Util::setWidgetNrOfChars(ui->label_path,10,30);
-    bool loaded = loadParametersFromFile(ptr,ptr->file);
 
     fileAmplitude->setEnabled(loaded);
     fileSampleRate->setEnabled(loaded);
     filePhase->setEnabled(loaded);
     fileOffset->setEnabled(loaded);
     if (!loaded) {
-        ptr->file_type=FORMAT_NO_FILE;
+        ui->label_format->setText(ptr->file_message);
         resetZoom();
         return;
     }
@@ -1264,7 +1440,6 @@ void SignalGenerator::loadFileFromPath(QString filename){
     ui->fileChannel->setEnabled(ptr->file_nr_of_channels>1);
     ui->fileChannel->setCurrentIndex(ptr->file_channel);
     ui->fileChannel->blockSignals(false);
-    loadFileChannelData(currentChannel);
     updateRightMenuForChn(currentChannel);
 }
 
@@ -1280,174 +1455,516 @@ void SignalGenerator::loadFile()
 	if(fileName.isEmpty()) { // user hit cancel
 		return;
 	}
-    loadFileFromPath(fileName);
-    updateRightMenuForChn(currentChannel);
-    resetZoom();
+
+	/* Large files take a while to parse, the GUI keeps running and the
+	 * panel shows the import until it is done */
+	fileImportTarget = getCurrentData();
+	ui->load_file->setEnabled(false);
+	ui->label_path->setText(fileName);
+	ui->label_format->setText(tr("Loading..."));
+	fileImportWatcher->setFuture(QtConcurrent::run(this,
+			&SignalGenerator::importFile, fileImportTarget, fileName));
 }
 
-void SignalGenerator::start()
+void SignalGenerator::fileImportFinished()
 {
-	QVector<struct iio_channel *> enabled_channels;
+	auto imported = fileImportWatcher->result();
 
-	m_running = true;
+	ui->load_file->setEnabled(true);
+	applyImportedFile(fileImportTarget, imported.first, imported.second);
+	fileImportTarget.clear();
+	updateRightMenuForChn(currentChannel);
+	resetZoom();
+}
+
+void SignalGenerator::updateAmplifiers()
+{
 	if (amp1 && amp2) {
 		/* FIXME: TODO: Move this into a HW class / lib M2k */
 		iio_channel_attr_write_bool(amp1, "powerdown", /*!(ui->run_button->isChecked() && */ !channels[0]->enableButton()->isChecked());
 		iio_channel_attr_write_bool(amp2, "powerdown", /*!(ui->run_button->isChecked() && */ !channels[1]->enableButton()->isChecked());
 	}
+}
+
+void SignalGenerator::start()
+{
+	m_running = true;
+	updateAmplifiers();
 
 	/* Avoid from being started twice */
-	if (buffers.size() > 0) {
+	if (buffers.size() > 0 || streams.size() > 0) {
 		return;
 	}
 
+	pushBuffers(stageBuffers());
+	startStreams();
+}
+
+void SignalGenerator::reloadBuffers()
+{
+	/* The old buffers keep playing while the new samples are computed */
+	QVector<StagedBuffer> staged = stageBuffers();
+	QByteArray streams_key = streamsKey();
+	bool restart_streams = streams_key != playingStreams;
+
+	updateAmplifiers();
+
+	/* The streams only restart when the streamed channels or their
+	 * files change, before the buffers in case a device goes from a
+	 * stream to a cyclic buffer */
+	if (restart_streams) {
+		stopStreams();
+	}
+
+	/* A device has one buffer at a time and the DAC DMA can't switch
+	 * between two cyclic buffers, so a changed buffer is destroyed
+	 * before its replacement is created. The buffers are replaced all
+	 * together, released by the DMA sync, so the channels stay in
+	 * phase; when none changed they are not touched. */
+	bool changed = staged.size() != playing.size();
+
+	for (int i = 0; !changed && i < staged.size(); i++) {
+		changed = !samePlayback(staged[i], playing[i]);
+	}
+
+	if (changed) {
+		destroyBuffers();
+		pushBuffers(staged);
+	}
+
+	if (restart_streams) {
+		startStreams();
+	}
+}
+
+bool SignalGenerator::samePlayback(const StagedBuffer& a,
+		const StagedBuffer& b)
+{
+	return a.dev == b.dev && a.channels == b.channels &&
+		a.samples == b.samples && a.samples_count == b.samples_count &&
+		a.final_rate == b.final_rate &&
+		a.oversampling == b.oversampling;
+}
+
+void SignalGenerator::destroyBuffers()
+{
+	for (auto each : buffers) {
+		iio_buffer_destroy(each);
+	}
+
+	buffers.clear();
+	playing.clear();
+}
+
+QByteArray SignalGenerator::streamsKey()
+{
+	QByteArray key;
+	QDataStream stream(&key, QIODevice::WriteOnly);
+
 	for (auto it = channels.begin(); it != channels.end(); ++it) {
-		if (!(*it)->enableButton()->isChecked()) {
+		auto ptr = getData(*it);
+
+		if (!(*it)->enableButton()->isChecked() || !isStreamed(*ptr)) {
 			continue;
 		}
 
-		auto chn_data = getData(*it);
+		/* The amplitude and the offset are read while streaming */
+		stream << (int)(it - channels.begin()) << ptr->file
+		       << ptr->file_sr << (quint64)ptr->file_phase;
+	}
 
-		if (chn_data->file_type==FORMAT_NO_FILE && chn_data->type==SIGNAL_TYPE_BUFFER) {
+	return key;
+}
+
+bool SignalGenerator::isStreamed(const signal_generator_data& data)
+{
+	return data.type == SIGNAL_TYPE_BUFFER && data.file_streaming &&
+		data.file_type == FORMAT_BIN_FLOAT;
+}
+
+void SignalGenerator::startStreams()
+{
+	streamsStop = false;
+	playingStreams = streamsKey();
+
+	for (auto it = channels.begin(); it != channels.end(); ++it) {
+		auto ptr = getData(*it);
+
+		if (!(*it)->enableButton()->isChecked() || !isStreamed(*ptr)) {
 			continue;
 		}
 
-		void *ptr = (*it)->property("channel").value<void *>();
-		enabled_channels.append(static_cast<struct iio_channel *>(ptr));
+		void *chn = (*it)->property("channel").value<void *>();
+		streams.append(QtConcurrent::run(this,
+				&SignalGenerator::streamFile,
+				static_cast<struct iio_channel *>(chn), ptr));
+	}
+}
+
+void SignalGenerator::stopStreams()
+{
+	streamsStop = true;
+
+	for (auto& stream : streams) {
+		stream.waitForFinished();
 	}
 
-	if (enabled_channels.size()==0) {
+	streams.clear();
+	playingStreams.clear();
+}
+
+void SignalGenerator::streamFile(struct iio_channel *chn,
+		QSharedPointer<signal_generator_data> ptr)
+{
+	/* A push blocks for about this long, which bounds the stop latency */
+	static const double block_duration = 0.1;
+	static const unsigned int nb_kernel_buffers = 4;
+
+	const struct iio_device *dev = iio_channel_get_device(chn);
+	QFile file(ptr->file);
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		qDebug(CAT_SIGNAL_GENERATOR) << "Unable to open" << ptr->file;
 		return;
 	}
 
-	do {
-		const struct iio_device *dev =
-		        iio_channel_get_device(enabled_channels[0]);
+	/* The file is mapped, only the part being played is paged in */
+	size_t nb_samples = file.size() / sizeof(float);
+	const float *data = reinterpret_cast<const float *>(
+				file.map(0, nb_samples * sizeof(float)));
 
-		/* First, disable all the channels of this device */
-		unsigned int nb = iio_device_get_channels_count(dev);
+	if (!data || nb_samples == 0) {
+		qDebug(CAT_SIGNAL_GENERATOR) << "Unable to map" << ptr->file;
+		return;
+	}
 
-		for (unsigned int i = 0; i < nb; i++) {
-			iio_channel_disable(iio_device_get_channel(dev, i));
-		}
+	unsigned long final_rate;
+	unsigned long oversampling;
 
-		/* Then enable the channels that we want */
-		for (auto each : enabled_channels) {
-			if (dev == iio_channel_get_device(each)) {
-				iio_channel_enable(each);
+	calc_sampling_params(dev, ptr->file_sr, final_rate, oversampling);
+
+	std::shared_ptr<GenericDac> dac;
+	float volts_to_raw_coef = voltsToRawCoef(chn, final_rate, dac);
+	double vmin = dac->vOutL();
+	double vmax = dac->vOutH();
+
+	size_t block_size = std::min<size_t>(std::max<size_t>(4096,
+			ptr->file_sr * block_duration), 1 << 20);
+
+	unsigned int nb = iio_device_get_channels_count(dev);
+
+	for (unsigned int i = 0; i < nb; i++) {
+		iio_channel_disable(iio_device_get_channel(dev, i));
+	}
+
+	iio_channel_enable(chn);
+	iio_device_set_kernel_buffers_count(dev, nb_kernel_buffers);
+
+	struct iio_buffer *buf = iio_device_create_buffer(dev, block_size,
+							  false);
+
+	if (!buf) {
+		qDebug(CAT_SIGNAL_GENERATOR) << "Unable to create stream buffer";
+		return;
+	}
+
+	if (iio_device_find_attr(dev, "oversampling_ratio")) {
+		iio_device_attr_write_longlong(dev,
+		                               "oversampling_ratio", oversampling);
+	}
+
+	iio_device_attr_write_longlong(dev, "sampling_frequency", final_rate);
+
+	qDebug(CAT_SIGNAL_GENERATOR) << QString("Streaming %1 samples in blocks of %2")
+	         .arg(nb_samples).arg(block_size);
+
+	size_t pos = ptr->file_phase % nb_samples;
+
+	while (!streamsStop) {
+		short *out = static_cast<short *>(iio_buffer_first(buf, chn));
+		ptrdiff_t step = iio_buffer_step(buf) / sizeof(short);
+
+		/* The file loops, as the file_source of the cyclic mode */
+		for (size_t i = 0; i < block_size; i++) {
+			double volts = data[pos] * ptr->file_amplitude +
+				ptr->file_offset;
+
+			volts = std::min(std::max(volts, vmin), vmax);
+			float raw = std::round((float)volts * volts_to_raw_coef);
+			out[i * step] = (short)std::min(std::max(raw, -32768.0f),
+							32767.0f);
+
+			if (++pos == nb_samples) {
+				pos = 0;
 			}
 		}
 
-		/* Enable the (optional) DMA sync */
-		iio_device_attr_write_bool(dev, "dma_sync", true);
+		if (iio_buffer_push(buf) < 0) {
+			qDebug(CAT_SIGNAL_GENERATOR) << "Stream push failed";
+			break;
+		}
+	}
 
-		double best_rate = get_best_sample_rate(dev);
-		size_t samples_count = get_samples_count(dev, best_rate);
+	iio_buffer_destroy(buf);
+}
 
-		/* Create the IIO buffer */
-		struct iio_buffer *buf = iio_device_create_buffer(
-		                                 dev, samples_count, true);
+float SignalGenerator::voltsToRawCoef(struct iio_channel *chn,
+		unsigned long final_rate, std::shared_ptr<GenericDac>& dac)
+{
+	double vlsb = 1;
+	double corr = 1; // interpolation correction
+	auto pair_it = std::find_if(channel_dac.begin(),
+	                            channel_dac.end(),
+	                            [&chn](const QPair<struct iio_channel *,
+	std::shared_ptr<GenericDac>>& element) {
+		return element.first == chn;
+	});
 
-		if (!buf || best_rate == 0) {
-			throw std::runtime_error("Unable to create buffer");
+	dac =(*pair_it).second;
+
+	if (pair_it != channel_dac.end()) {
+		vlsb = dac->vlsb();
+		auto m2k_dac = std::dynamic_pointer_cast<M2kDac>
+		               (dac);
+
+		if (m2k_dac) {
+			corr = m2k_dac->compTable(final_rate);
 		}
+	}
 
-		qDebug(CAT_SIGNAL_GENERATOR) << QString("Created buffer with %1 samples at %2 SPS for device %3")
-		         .arg(samples_count).arg(best_rate).arg(
-		                 iio_device_get_name(dev) ?:
-		                 iio_device_get_id(dev));
+	// DAC_RAW = (-Vout / (voltage corresponding to a LSB));
+	// Multiplying with 16 because the HDL considers the DAC data as 16 bit
+	// instead of 12 bit(data is shifted to the left)
+	// Divide by corr when interpolation is used
+	return (-1 * (1 / vlsb) * 16) / corr;
+}
+
+void SignalGenerator::enableDeviceChannels(const struct iio_device *dev,
+		const QVector<struct iio_channel *>& enabled)
+{
+	/* First, disable all the channels of this device */
+	unsigned int nb = iio_device_get_channels_count(dev);
+
+	for (unsigned int i = 0; i < nb; i++) {
+		iio_channel_disable(iio_device_get_channel(dev, i));
+	}
+
+	/* Then enable the channels that we want */
+	for (auto each : enabled) {
+		if (dev == iio_channel_get_device(each)) {
+			iio_channel_enable(each);
+		}
+	}
+}
+
+QVector<SignalGenerator::StagedBuffer> SignalGenerator::stageBuffers()
+{
+	QVector<struct iio_channel *> enabled_channels;
+	QVector<StagedBuffer> staged;
+
+	for (auto it = channels.begin(); it != channels.end(); ++it) {
+		if (!(*it)->enableButton()->isChecked()) {
+			continue;
+		}
 
-		unsigned long final_rate;
-		unsigned long oversampling;
+		auto chn_data = getData(*it);
+
+		if (chn_data->file_type==FORMAT_NO_FILE && chn_data->type==SIGNAL_TYPE_BUFFER) {
+			continue;
+		}
+
+		/* Played by startStreams() */
+		if (isStreamed(*chn_data)) {
+			continue;
+		}
+
+		void *ptr = (*it)->property("channel").value<void *>();
+		enabled_channels.append(static_cast<struct iio_channel *>(ptr));
+	}
+
+	QVector<WaveformJob> jobs;
+
+	while (!enabled_channels.empty()) {
+		StagedBuffer device;
 
-		calc_sampling_params(dev, best_rate, final_rate,
-		                     oversampling);
+		device.dev = iio_channel_get_device(enabled_channels[0]);
+
+		/* The rate and size depend on the enabled channels, this only
+		 * sets the mask of the next buffer */
+		enableDeviceChannels(device.dev, enabled_channels);
+
+		double best_rate;
+		planSampling(device.dev, best_rate, device.samples_count);
+
+		if (best_rate == 0) {
+			throw std::runtime_error("Unable to create buffer");
+		}
+
+		calc_sampling_params(device.dev, best_rate, device.final_rate,
+		                     device.oversampling);
 
 		for (auto each : enabled_channels) {
-			if (dev != iio_channel_get_device(each)) {
+			if (device.dev != iio_channel_get_device(each)) {
 				continue;
 			}
 
 			enabled_channels.remove(enabled_channels.indexOf(each));
 
-			top_block = gr::make_top_block("Signal Generator");
-
 			void *ptr = iio_channel_get_data(each);
 			QWidget *w = static_cast<QWidget *>(ptr);
-			auto source = getSource(w, best_rate, top_block);
-			float volts_to_raw_coef;
-			double vlsb = 1;
-			double corr = 1; // interpolation correction
-			auto pair_it = std::find_if(channel_dac.begin(),
-			                            channel_dac.end(),
-			                            [&each](const QPair<struct iio_channel *,
-			std::shared_ptr<GenericDac>>& element) {
-				return element.first == each;
-			});
-
-			std::shared_ptr<GenericDac> dac =(*pair_it).second;
-
-			if (pair_it != channel_dac.end()) {
-				vlsb = dac->vlsb();
-				auto m2k_dac = std::dynamic_pointer_cast<M2kDac>
-				               (dac);
-
-				if (m2k_dac) {
-					corr = m2k_dac->compTable(final_rate);
-				}
+			std::shared_ptr<GenericDac> dac;
+			float volts_to_raw_coef = voltsToRawCoef(each,
+					device.final_rate, dac);
+
+			device.channels.append(each);
+			device.samples.append(std::vector<short>(
+						      device.samples_count));
+
+			WaveformJob job;
+			job.obj = w;
+			job.sample_rate = best_rate;
+			job.volts_to_raw_coef = volts_to_raw_coef;
+			job.vmin = dac->vOutL();
+			job.vmax = dac->vOutH();
+			job.device = staged.size();
+			job.channel = device.samples.size() - 1;
+			job.key = waveformKey(*getData(w), best_rate,
+					volts_to_raw_coef, job.vmin, job.vmax,
+					device.samples_count);
+
+			if (!findCachedWaveform(job.key, device.samples.back())) {
+				jobs.append(job);
 			}
+		}
+
+		staged.append(device);
+	}
+
+	/* The channels of all the devices are computed at once, the cache
+	 * is only used from this thread */
+	for (auto& job : jobs) {
+		job.samples = &staged[job.device].samples[job.channel];
+	}
+
+	if (jobs.size() > 1) {
+		QtConcurrent::blockingMap(jobs, [this](WaveformJob& job) {
+			generateSamples(job);
+		});
+	} else {
+		for (auto& job : jobs) {
+			generateSamples(job);
+		}
+	}
+
+	for (const auto& job : jobs) {
+		cacheWaveform(job.key, *job.samples);
+	}
+
+	return staged;
+}
+
+void SignalGenerator::generateSamples(const WaveformJob& job)
+{
+	std::vector<short>& samples = *job.samples;
+
+	if (synthesizeSamples(job.obj, job.sample_rate, job.volts_to_raw_coef,
+			      job.vmin, job.vmax, samples.data(), 1,
+			      samples.size())) {
+		return;
+	}
+
+	auto top = gr::make_top_block("Signal Generator");
+	auto source = getSource(job.obj, job.sample_rate, top);
+	auto f2s = blocks::float_to_short::make(1, job.volts_to_raw_coef);
+	auto head = blocks::head::make(sizeof(short), samples.size());
+	auto vector = blocks::vector_sink_s::make();
+	auto clamp = analog::rail_ff::make(job.vmin, job.vmax);
+
+	top->connect(source, 0, clamp, 0);
+	top->connect(clamp,0, f2s,0);
+	top->connect(f2s, 0, head, 0);
+	top->connect(head, 0, vector, 0);
+	top->run();
+
+	samples = vector->data();
+}
+
+void SignalGenerator::pushBuffers(const QVector<StagedBuffer>& staged)
+{
+	for (const auto& device : staged) {
+		const struct iio_device *dev = device.dev;
+
+		enableDeviceChannels(dev, device.channels);
+
+		/* Enable the (optional) DMA sync */
+		iio_device_attr_write_bool(dev, "dma_sync", true);
+
+		/* Create the IIO buffer */
+		struct iio_buffer *buf = iio_device_create_buffer(
+		                                 dev, device.samples_count, true);
+
+		if (!buf) {
+			throw std::runtime_error("Unable to create buffer");
+		}
+
+		qDebug(CAT_SIGNAL_GENERATOR) << QString("Created buffer with %1 samples at %2 SPS for device %3")
+		         .arg(device.samples_count).arg(device.final_rate).arg(
+		                 iio_device_get_name(dev) ?:
+		                 iio_device_get_id(dev));
 
-			// DAC_RAW = (-Vout / (voltage corresponding to a LSB));
-			// Multiplying with 16 because the HDL considers the DAC data as 16 bit
-			// instead of 12 bit(data is shifted to the left)
-			// Divide by corr when interpolation is used
-			volts_to_raw_coef = (-1 * (1 / vlsb) * 16) / corr;
-			auto f2s = blocks::float_to_short::make(1,
-			                                        volts_to_raw_coef);
-			auto head = blocks::head::make(
-			                    sizeof(short), samples_count);
-			auto vector = blocks::vector_sink_s::make();
-			auto clamp = analog::rail_ff::make(dac->vOutL(), dac->vOutH());
-
-			top_block->connect(source, 0, clamp, 0);
-			top_block->connect(clamp,0, f2s,0);
-			top_block->connect(f2s, 0, head, 0);
-			top_block->connect(head, 0, vector, 0);
-			top_block->run();
-
-			const std::vector<short>& samples = vector->data();
-			const short *data = samples.data();
+		for (int c = 0; c < device.channels.size(); c++) {
+			const std::vector<short>& samples = device.samples[c];
 
 			if (samples.size()) {
-				iio_channel_write(each, buf, data,
-			                  samples_count * sizeof(short));
+				iio_channel_write(device.channels[c], buf,
+				                  samples.data(),
+				                  std::min(samples.size(),
+				                           device.samples_count) *
+				                  sizeof(short));
 			}
 		}
 
 		if (iio_device_find_attr(dev, "oversampling_ratio")) {
 			iio_device_attr_write_longlong(dev,
-			                               "oversampling_ratio", oversampling);
+			                               "oversampling_ratio", device.oversampling);
 		}
 
 		iio_device_attr_write_longlong(dev, "sampling_frequency",
-		                               final_rate);
+		                               device.final_rate);
 
 		qDebug(CAT_SIGNAL_GENERATOR) << "Pushed cyclic buffer";
 
-		iio_buffer_push_partial(buf, samples_count);
+		iio_buffer_push_partial(buf, device.samples_count);
 		buffers.append(buf);
-
-	} while (!enabled_channels.empty());
+		playing.append(device);
+	}
 
 	/* Now that we pushed all the buffers, disable the (optional) DMA sync
-	 * for the devices that support it. */
+	 * for the devices that support it. Nothing else runs between the
+	 * writes, their spread is the skew between the devices. */
+	QElapsedTimer timer;
+	qint64 first_release = 0, last_release = 0;
+
+	timer.start();
+
 	for (auto buf : buffers) {
 		const struct iio_device *dev = iio_buffer_get_device(buf);
 
 		iio_device_attr_write_bool(dev, "dma_sync", false);
+		last_release = timer.nsecsElapsed();
+
+		if (buf == buffers.first()) {
+			first_release = last_release;
+		}
 	}
-}
 
+	syncSkew = (last_release - first_release) * 1e-9;
+
+	if (buffers.size() > 1) {
+		qDebug(CAT_SIGNAL_GENERATOR) << "Devices released within"
+					     << syncSkew << "s";
+	}
+}
 
 void SignalGenerator::run()
 {
@@ -1456,12 +1973,8 @@ void SignalGenerator::run()
 
 void SignalGenerator::stop()
 {
-
-	for (auto each : buffers) {
-		iio_buffer_destroy(each);
-	}
-
-	buffers.clear();
+	stopStreams();
+	destroyBuffers();
 
 
 	if (amp1 && amp2) {
@@ -1570,51 +2083,53 @@ void SignalGenerator::loadFileCurrentChannelData()
 
 void SignalGenerator::loadFileChannelData(int chIdx)
 {
-	auto ptr = getData(channels[chIdx]);
+	loadFileChannelData(getData(channels[chIdx]), fileManager);
+}
 
+void SignalGenerator::loadFileChannelData(
+		QSharedPointer<signal_generator_data> ptr, FileManager *manager)
+{
 	if (ptr->type!=SIGNAL_TYPE_BUFFER) {
 		qDebug(CAT_SIGNAL_GENERATOR)<<"loadFileChannelData called without having SIGNAL_TYPE_BUFFER";
 		return;
 	}
 
 	ptr->file_data.clear();
-	if(ptr->file_type == FORMAT_WAVE || ptr->file_type == FORMAT_MAT) // let GR flow load data
+	if(ptr->file_type == FORMAT_WAVE) // let GR flow load data
 		return;
 	try {
-		fileManager->open(ptr->file, FileManager::IMPORT);
-
 		if (ptr->file_type==FORMAT_CSV) {
+			manager->open(ptr->file, FileManager::IMPORT);
 
 			if (ptr->file_channel >= ptr->file_nr_of_channels) {
 				return;
 			}
 
-			for (auto x : fileManager->read(ptr->file_channel)) {
+			for (auto x : manager->read(ptr->file_channel)) {
 				ptr->file_data.push_back(x);
 			}
 		}
 
 #ifdef MATLAB_SUPPORT_SIGGEN
 		if (ptr->file_type==FORMAT_MAT) {
-			mat_t *matfp;
-			matvar_t *matvar;
-
-			matfp = Mat_Open(ptr->file.toStdString().c_str(),MAT_ACC_RDONLY);
+			if (!ptr->file_mat) {
+				ptr->file_mat = MatFile::open(ptr->file);
+			}
 
-			if (NULL == matfp) {
+			if (!ptr->file_mat ||
+					ptr->file_channel >= ptr->file_nr_of_channels) {
 				qDebug(CAT_SIGNAL_GENERATOR)<<"Error opening MAT file "<<ptr->file;
 				return;
 			}
 
-			matvar=Mat_VarRead(matfp,
-					   ptr->file_channel_names[ptr->file_channel].toStdString().c_str());
-			const double *xData = static_cast<const double *>(matvar->data) ;
+			int var = ptr->file_mat->find(
+					ptr->file_channel_names[ptr->file_channel]);
+			size_t count = ptr->file_nr_of_samples[ptr->file_channel];
+			std::vector<double> values(count);
 
-			for (auto i=0; i<ptr->file_nr_of_samples[ptr->file_channel]; ++i) {
-				ptr->file_data.push_back(xData[i]);
+			if (ptr->file_mat->read(var, 0, count, values.data())) {
+				ptr->file_data.assign(values.begin(), values.end());
 			}
-
-			Mat_Close(matfp);
 			return;
 		}
 #endif
@@ -1626,6 +2141,131 @@ void SignalGenerator::loadFileChannelData(int chIdx)
 	}
 }
 
+bool SignalGenerator::synthesizeSamples(QWidget *obj, double sample_rate,
+		float volts_to_raw_coef, double vmin, double vmax,
+		short *out, ptrdiff_t step, size_t samples_count)
+{
+	auto ptr = getData(obj);
+
+	if (!isSynthesizable(*ptr)) {
+		return false;
+	}
+
+	static const size_t noise_block = 4096;
+
+	bool noisy = (int)ptr->noiseType != 0;
+	NoiseGenerator noise(ptr->noiseType, ptr->noiseAmplitude, rand());
+	std::vector<float> noise_samples(noisy ? noise_block : 0);
+
+	/* The same clamp and conversion as rail_ff -> float_to_short */
+	synthesize(*ptr, sample_rate, 0.0, samples_count,
+			[&](size_t i, double volts) {
+		if (noisy) {
+			size_t k = i % noise_block;
+
+			if (k == 0) {
+				std::fill(noise_samples.begin(),
+					  noise_samples.end(), 0.0f);
+				noise.add(noise_samples.data(), noise_block);
+			}
+
+			volts += noise_samples[k];
+		}
+
+		volts = std::min(std::max(volts, vmin), vmax);
+		float raw = std::round((float)volts * volts_to_raw_coef);
+		out[i * step] = (short)std::min(std::max(raw, -32768.0f),
+						32767.0f);
+	});
+
+	return true;
+}
+
+double SignalGenerator::previewPhase(const signal_generator_data& data) const
+{
+	double frequency = data.type == SIGNAL_TYPE_MATH ?
+		data.math_freq : data.frequency;
+
+	/* The preview starts at the left edge of the plot */
+	int full_periods = (int)((double)zoomT1OnScreen * frequency);
+	double phase_in_time = zoomT1OnScreen - full_periods / frequency;
+
+	return (phase_in_time * frequency) * 360.0;
+}
+
+bool SignalGenerator::PreviewKey::operator==(const PreviewKey& other) const
+{
+	return type == other.type && constant == other.constant &&
+		amplitude == other.amplitude && offset == other.offset &&
+		frequency == other.frequency && phase == other.phase &&
+		function == other.function &&
+		noise_type == other.noise_type &&
+		noise_amplitude == other.noise_amplitude &&
+		sample_rate == other.sample_rate &&
+		nb_points == other.nb_points;
+}
+
+void SignalGenerator::updateNativePreview()
+{
+	std::vector<float *> points;
+	std::vector<std::vector<gr::tag_t>> tags(channels.size());
+
+	previewCache.resize(channels.size());
+
+	for (int i = 0; i < channels.size(); i++) {
+		auto& entry = previewCache[i];
+		auto ptr = getData(channels[i]);
+		bool enabled = channels[i]->enableButton()->isChecked();
+
+		PreviewKey key;
+		key.type = enabled ? ptr->type : -1;
+		key.constant = ptr->constant;
+		key.amplitude = ptr->amplitude;
+		key.offset = ptr->offset;
+		key.frequency = ptr->frequency;
+		key.phase = ptr->phase;
+		key.noise_type = ptr->noiseType;
+		key.noise_amplitude = ptr->noiseAmplitude;
+		key.sample_rate = sample_rate;
+		key.nb_points = nb_points;
+
+		if (enabled && key.type == SIGNAL_TYPE_MATH) {
+			key.function = ptr->function;
+			key.frequency = ptr->math_freq;
+		}
+
+		if (enabled && key.type != SIGNAL_TYPE_CONSTANT) {
+			key.phase += previewPhase(*ptr);
+		}
+
+		if (!(entry.first == key) || entry.second.size() != nb_points) {
+			entry.first = key;
+			entry.second.assign(nb_points, 0.0f);
+
+			if (enabled) {
+				float *out = entry.second.data();
+				synthesize(*ptr, sample_rate, key.phase - ptr->phase,
+						nb_points, [=](size_t n, double volts) {
+					out[n] = (float)volts;
+				});
+
+				if ((int)ptr->noiseType != 0) {
+					NoiseGenerator(ptr->noiseType,
+						       ptr->noiseAmplitude,
+						       rand()).add(out, nb_points);
+				}
+			}
+		}
+
+		points.push_back(entry.second.data());
+	}
+
+	/* The event copies the samples, the cache stays untouched */
+	QCoreApplication::postEvent(plot, new IdentifiableTimeUpdateEvent(
+			points, nb_points, tags,
+			time_block_data->time_block->name()));
+}
+
 gr::basic_block_sptr SignalGenerator::getNoise(QWidget *obj, gr::top_block_sptr top)
 {
 	auto ptr = getData(obj);
@@ -1685,9 +2325,7 @@ gr::basic_block_sptr SignalGenerator::getSource(QWidget *obj,
 
 	case SIGNAL_TYPE_WAVEFORM:
 		if (preview) {
-			int full_periods=(int)((double)zoomT1OnScreen*ptr->frequency);
-			double phase_in_time = zoomT1OnScreen - full_periods/ptr->frequency;
-			phase = (phase_in_time*ptr->frequency) * 360.0;
+			phase = previewPhase(*ptr);
 		}
 		generated_wave = getSignalSource(top, samp_rate, *ptr, phase);
 		break;
@@ -2064,10 +2702,176 @@ QVector<unsigned long> SignalGenerator::get_available_sample_rates(
 	return values;
 }
 
+std::vector<double> SignalGenerator::samplingKey(const struct iio_device *dev)
+{
+	std::vector<double> key;
+
+	/* Everything get_best_sample_rate() and get_samples_count() read */
+	for (unsigned int i = 0; i < iio_device_get_channels_count(dev); i++) {
+		struct iio_channel *chn = iio_device_get_channel(dev, i);
+
+		if (!iio_channel_is_enabled(chn)) {
+			continue;
+		}
+
+		QWidget *w = static_cast<QWidget *>(iio_channel_get_data(chn));
+		auto ptr = getData(w);
+		double nb_samples = 0;
+
+		if (ptr->file_channel < ptr->file_nr_of_samples.size()) {
+			nb_samples = ptr->file_nr_of_samples[ptr->file_channel];
+		}
+
+		key.insert(key.end(), { (double)i, (double)ptr->type,
+				(double)ptr->waveform, ptr->frequency,
+				ptr->math_freq, (double)ptr->file_type,
+				ptr->file_sr, nb_samples });
+	}
+
+	return key;
+}
+
+void SignalGenerator::planSampling(const struct iio_device *dev,
+		double& rate, size_t& samples_count)
+{
+	/* Bounds the memory of scripts going over many configurations */
+	static const size_t max_sampling_plans = 1024;
+
+	auto key = std::make_pair(dev, samplingKey(dev));
+	auto it = samplingPlans.find(key);
+
+	if (it != samplingPlans.end()) {
+		rate = it->second.first;
+		samples_count = it->second.second;
+		return;
+	}
+
+	rate = get_best_sample_rate(dev);
+	samples_count = get_samples_count(dev, rate);
+
+	if (samplingPlans.size() >= max_sampling_plans) {
+		samplingPlans.clear();
+	}
+
+	samplingPlans[key] = std::make_pair(rate, samples_count);
+}
+
+const QVector<unsigned long>& SignalGenerator::availableSampleRates(
+		const struct iio_device *dev)
+{
+	auto it = availableRates.find(dev);
+
+	if (it == availableRates.end()) {
+		it = availableRates.insert(std::make_pair(dev,
+				get_available_sample_rates(dev))).first;
+	}
+
+	return it->second;
+}
+
+QByteArray SignalGenerator::waveformKey(const signal_generator_data& data,
+		double sample_rate, float volts_to_raw_coef,
+		double vmin, double vmax, size_t samples_count)
+{
+	if ((int)data.noiseType != 0) {
+		return QByteArray();
+	}
+
+	QByteArray params;
+	QDataStream stream(&params, QIODevice::WriteOnly);
+
+	stream << sample_rate << volts_to_raw_coef << vmin << vmax
+	       << (quint64)samples_count << (int)data.type;
+
+	switch (data.type) {
+	case SIGNAL_TYPE_CONSTANT:
+		stream << data.constant;
+		break;
+	case SIGNAL_TYPE_WAVEFORM:
+		stream << (int)data.waveform << data.amplitude << data.offset
+		       << data.frequency << data.phase << data.dutycycle
+		       << data.rise << data.fall << data.holdh << data.holdl;
+		break;
+	case SIGNAL_TYPE_BUFFER: {
+		/* WAV and binary files are read by the flowgraph, a changed
+		 * file must not hit the samples of the old one */
+		QFileInfo info(data.file);
+
+		stream << info.absoluteFilePath() << info.size()
+		       << info.lastModified() << (int)data.file_type
+		       << (quint64)data.file_channel << data.file_sr
+		       << data.file_amplitude << data.file_offset
+		       << (quint64)data.file_phase;
+		stream.writeRawData(reinterpret_cast<const char *>(
+				data.file_data.data()),
+				data.file_data.size() * sizeof(float));
+		break;
+	}
+	case SIGNAL_TYPE_MATH:
+		stream << data.function << data.math_freq;
+		break;
+	}
+
+	return QCryptographicHash::hash(params, QCryptographicHash::Sha1);
+}
+
+bool SignalGenerator::findCachedWaveform(const QByteArray& key,
+		std::vector<short>& samples)
+{
+	if (key.isEmpty()) {
+		return false;
+	}
+
+	std::vector<short> *cached = waveformCache.object(key);
+
+	if (cached && cached->size() == samples.size()) {
+		samples = *cached;
+		return true;
+	}
+
+	if (waveformCacheDir.isEmpty()) {
+		return false;
+	}
+
+	QFile file(QDir(waveformCacheDir).filePath(key.toHex() + ".raw"));
+	qint64 bytes = samples.size() * sizeof(short);
+
+	if (file.size() != bytes || !file.open(QIODevice::ReadOnly) ||
+	    file.read(reinterpret_cast<char *>(samples.data()), bytes) != bytes) {
+		return false;
+	}
+
+	waveformCache.insert(key, new std::vector<short>(samples),
+			     samples.size());
+	return true;
+}
+
+void SignalGenerator::cacheWaveform(const QByteArray& key,
+		const std::vector<short>& samples)
+{
+	if (key.isEmpty()) {
+		return;
+	}
+
+	waveformCache.insert(key, new std::vector<short>(samples),
+			     samples.size());
+
+	if (waveformCacheDir.isEmpty() || !QDir().mkpath(waveformCacheDir)) {
+		return;
+	}
+
+	QFile file(QDir(waveformCacheDir).filePath(key.toHex() + ".raw"));
+
+	if (file.open(QIODevice::WriteOnly)) {
+		file.write(reinterpret_cast<const char *>(samples.data()),
+			   samples.size() * sizeof(short));
+	}
+}
+
 double SignalGenerator::get_best_sample_rate(
         const struct iio_device *dev)
 {
-	QVector<unsigned long> values = get_available_sample_rates(dev);
+	QVector<unsigned long> values = availableSampleRates(dev);
 
 	/* When using oversampling, we actually want to generate the
 	 * signal with the lowest sample rate possible. */
@@ -2088,7 +2892,7 @@ double SignalGenerator::get_best_sample_rate(
 			return rate;
 		}
 
-		qDebug(CAT_SIGNAL_GENERATOR) << QString("Rate %1 not ideal").arg(rate);
+		CAT_DEBUG(CAT_SIGNAL_GENERATOR) << QString("Rate %1 not ideal").arg(rate);
 	}
 
 	/* If we can't find a perfect sample rate, use the highest one */
@@ -2104,7 +2908,7 @@ double SignalGenerator::get_best_sample_rate(
 			return rate;
 		}
 
-		qDebug(CAT_SIGNAL_GENERATOR) << QString("Rate %1 not possible").arg(rate);
+		CAT_DEBUG(CAT_SIGNAL_GENERATOR) << QString("Rate %1 not possible").arg(rate);
 	}
 
 	throw std::runtime_error("Unable to calculate best sample rate");
@@ -2173,7 +2977,7 @@ void SignalGenerator::calc_sampling_params(const iio_device *dev,
 		out_oversampling_ratio = max_sample_rate / rate;
 		out_sample_rate = max_sample_rate;
 
-		qDebug(CAT_SIGNAL_GENERATOR) << QString("Using oversampling with a ratio of %1")
+		CAT_DEBUG(CAT_SIGNAL_GENERATOR) << QString("Using oversampling with a ratio of %1")
 		         .arg(out_oversampling_ratio);
 	} else {
 		out_sample_rate = rate;
@@ -2235,7 +3039,7 @@ double SignalGenerator::get_best_ratio(double ratio, double max, double *fract)
 		}
 	}
 
-	qDebug(CAT_SIGNAL_GENERATOR) << QString("Input ratio %1, ratio: %2 (fract left %3)")
+	CAT_DEBUG(CAT_SIGNAL_GENERATOR) << QString("Input ratio %1, ratio: %2 (fract left %3)")
 	         .arg(ratio).arg(best_ratio).arg(best_fract);
 
 	if (fract) {
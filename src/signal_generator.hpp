@@ -26,12 +26,19 @@
 #include <gnuradio/top_block.h>
 
 #include <QButtonGroup>
+#include <QCache>
 #include <QPushButton>
 #include <QTreeWidgetItem>
 #include <QSharedPointer>
 #include <QWidget>
 #include <QQueue>
 #include <QSharedPointer>
+#include <QFuture>
+#include <QFutureWatcher>
+
+#include <atomic>
+#include <map>
+#include <vector>
 
 #include "apiObject.hpp"
 #include "filter.hpp"
@@ -40,6 +47,7 @@
 #include "tool.hpp"
 #include "hw_dac.h"
 #include "filemanager.h"
+#include "mat_file.hpp"
 
 #include "gnuradio/analog/noise_type.h"
 
@@ -152,7 +160,6 @@ public:
 private:
 	Ui::SignalGenerator *ui;
 	OscilloscopePlot *plot;
-	gr::top_block_sptr top_block;
 	struct time_block_data *time_block_data;
 	struct iio_channel *amp1, *amp2;
 	QList<std::shared_ptr<GenericDac>> dacs;
@@ -174,6 +181,29 @@ private:
 	unsigned long nb_points;
 	double nr_of_periods;
 
+	/* What the preview of a channel was computed from, the samples are
+	 * only computed again when it changes */
+	struct PreviewKey {
+		PreviewKey(): type(-1), constant(0), amplitude(0), offset(0),
+			frequency(0), phase(0), noise_type(0),
+			noise_amplitude(0), sample_rate(0), nb_points(0) {}
+
+		int type;
+		float constant;
+		double amplitude;
+		float offset;
+		double frequency;
+		double phase;
+		QString function;
+		int noise_type;
+		float noise_amplitude;
+		double sample_rate;
+		unsigned long nb_points;
+
+		bool operator==(const PreviewKey& other) const;
+	};
+	QVector<QPair<PreviewKey, std::vector<float>>> previewCache;
+
 	QButtonGroup *settings_group;
 	QButtonGroup *channels_group;
 	QQueue<QPair<int, bool>> menuButtonActions;
@@ -188,9 +218,73 @@ private:
 	void renameConfigPanel();
 
 	void start();	
+	void updateAmplifiers();
+
+	/* The samples of a device, computed before its buffer is created */
+	struct StagedBuffer {
+		const struct iio_device *dev;
+		QVector<struct iio_channel *> channels;
+		QVector<std::vector<short>> samples;
+		size_t samples_count;
+		unsigned long final_rate;
+		unsigned long oversampling;
+	};
+
+	void enableDeviceChannels(const struct iio_device *dev,
+				  const QVector<struct iio_channel *>& enabled);
+	QVector<StagedBuffer> stageBuffers();
+	void pushBuffers(const QVector<StagedBuffer>& staged);
+	void destroyBuffers();
+
+	/* What each of the buffers plays, in the same order */
+	QVector<StagedBuffer> playing;
+	static bool samePlayback(const StagedBuffer& a, const StagedBuffer& b);
+
+	/* A channel whose samples are not cached, computed on a worker */
+	struct WaveformJob {
+		QWidget *obj;
+		double sample_rate;
+		float volts_to_raw_coef;
+		double vmin;
+		double vmax;
+		int device;
+		int channel;
+		QByteArray key;
+		std::vector<short> *samples;
+	};
+	void generateSamples(const WaveformJob& job);
+
+	/* Replaces the buffers of a running generator without stopping it */
+	void reloadBuffers();
+
+	float voltsToRawCoef(struct iio_channel *chn, unsigned long final_rate,
+			     std::shared_ptr<GenericDac>& dac);
+
+	/* Binary float files in streaming mode are not loaded into a cyclic
+	 * buffer, a thread per channel pushes them block by block */
+	QVector<QFuture<void>> streams;
+	std::atomic<bool> streamsStop;
+
+	/* Time between the release of the first and the last device on
+	 * the last start, in seconds */
+	double syncSkew;
+
+	/* The streamed channels and their files, a change restarts the
+	 * streams */
+	QByteArray streamsKey();
+	QByteArray playingStreams;
+
+	static bool isStreamed(const signal_generator_data& data);
+	void startStreams();
+	void stopStreams();
+	void streamFile(struct iio_channel *chn,
+			QSharedPointer<signal_generator_data> ptr);
 	void resetZoom();
 
 	void updatePreview();
+	void updateNativePreview();
+	void restartIfRunning(bool enabled);
+	double previewPhase(const signal_generator_data& data) const;
 	void updateRightMenuForChn(int chIdx);
 	void updateAndToggleMenu(int chIdx, bool open);
 	void triggerRightMenuToggle(int chIdx, bool checked);
@@ -203,6 +297,13 @@ private:
 	        struct signal_generator_data& data, double phase_correction=0.0);
 
 	gr::basic_block_sptr getNoise(QWidget *obj,gr::top_block_sptr top);
+
+	/* Writes the DAC samples of the constants, sine waves and math
+	 * functions, noise included, to out, every step shorts. Returns false for the signals only the
+	 * flowgraph can generate. */
+	bool synthesizeSamples(QWidget *obj, double sample_rate,
+			       float volts_to_raw_coef, double vmin, double vmax,
+			       short *out, ptrdiff_t step, size_t samples_count);
 	gr::basic_block_sptr getSource(QWidget *obj,
 				       double sample_rate,
 	                               gr::top_block_sptr top, bool     phase_correction=false);
@@ -216,6 +317,35 @@ private:
 				 double sample_rate, bool perfect = false);
 	double get_best_sample_rate(
 	        const struct iio_device *dev);
+
+	/* The rate and buffer size of a device for the current signals, the
+	 * plans are kept per device and signal parameters */
+	void planSampling(const struct iio_device *dev, double& rate,
+			  size_t& samples_count);
+	std::vector<double> samplingKey(const struct iio_device *dev);
+	std::map<std::pair<const struct iio_device *, std::vector<double>>,
+		std::pair<double, size_t>> samplingPlans;
+
+	/* The rates of a device do not change, they are read once */
+	const QVector<unsigned long>& availableSampleRates(
+			const struct iio_device *dev);
+	std::map<const struct iio_device *, QVector<unsigned long>> availableRates;
+
+	/* The DAC samples of a signal, shared by the channels and the starts
+	 * using the same parameters, rate and size. Noisy signals have an
+	 * empty key, they must change on every start. */
+	static QByteArray waveformKey(const signal_generator_data& data,
+				      double sample_rate,
+				      float volts_to_raw_coef,
+				      double vmin, double vmax,
+				      size_t samples_count);
+	bool findCachedWaveform(const QByteArray& key,
+				std::vector<short>& samples);
+	void cacheWaveform(const QByteArray& key,
+			   const std::vector<short>& samples);
+	QCache<QByteArray, std::vector<short>> waveformCache;
+	/* Also kept on disk there across sessions, when not empty */
+	QString waveformCacheDir;
 	//int set_sample_rate(const struct iio_device *dev,
 	//		unsigned long sample_rate);
 	void calc_sampling_params(const struct iio_device *dev,
@@ -235,8 +365,22 @@ private:
 
 	enum sg_file_format getFileFormat(QString filePath);
 	bool loadParametersFromFile(QSharedPointer<signal_generator_data> ptr,
-	                            QString filePath);
+	                            QString filePath, FileManager *manager);
 	void loadFileChannelData(int chIdx);
+	void loadFileChannelData(QSharedPointer<signal_generator_data> ptr,
+	                         FileManager *manager);
+
+	/* Parses a file into a copy of the channel data, safe on a worker,
+	 * and copies the result back on the GUI thread */
+	QPair<bool, QSharedPointer<signal_generator_data>> importFile(
+	        QSharedPointer<signal_generator_data> ptr, QString filename);
+	void applyImportedFile(QSharedPointer<signal_generator_data> ptr,
+	                       bool loaded,
+	                       QSharedPointer<signal_generator_data> parsed);
+
+	QFutureWatcher<QPair<bool, QSharedPointer<signal_generator_data>>>
+		*fileImportWatcher;
+	QSharedPointer<signal_generator_data> fileImportTarget;
 	bool riffCompare(riff_header_t& ptr, const char *id2);
 	bool chunkCompare(chunk_header_t& ptr, const char *id2);
 public Q_SLOTS:
@@ -276,6 +420,7 @@ private Q_SLOTS:
 	void channelWidgetMenuToggled(bool);
 	void rightMenuFinished(bool opened);
 	void loadFile();
+	void fileImportFinished();
 	void rescale();
 
 	void startStop(bool start);
@@ -324,8 +469,12 @@ struct signal_generator_data {
 	QString file;
 	QString file_message;
 	QStringList file_channel_names;
+	// The MAT file and its variable index, read once
+	std::shared_ptr<MatFile> file_mat;
 	enum sg_file_format file_type;
 	wav_header_t file_wav_hdr;
+	// Played from the file instead of a cyclic buffer
+	bool file_streaming;
 	//bool file_loaded;
 	// SIGNAL_TYPE_MATH
 	QString function;
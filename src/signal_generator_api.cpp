@@ -680,4 +680,40 @@ void SignalGenerator_API::setBufferPhase(const QList<double>& list){
     }
     gen->filePhase->setValue(gen->getCurrentData()->file_phase);
 }
+
+QList<bool> SignalGenerator_API::getBufferStreaming() const{
+    QList<bool> list;
+
+    for (int i = 0; i < gen->channels.size(); i++) {
+        auto ptr = gen->getData(gen->channels[i]);
+
+        list.append(ptr->file_streaming);
+    }
+
+    return list;
+}
+
+void SignalGenerator_API::setBufferStreaming(const QList<bool>& list){
+    if (list.size() != gen->channels.size()) {
+        return;
+    }
+
+    for (int i = 0; i < gen->channels.size(); i++) {
+        auto ptr = gen->getData(gen->channels[i]);
+
+        ptr->file_streaming = list.at(i);
+    }
+}
+
+double SignalGenerator_API::getSyncSkew() const{
+    return gen->syncSkew;
+}
+
+QString SignalGenerator_API::getWaveformCacheDir() const{
+    return gen->waveformCacheDir;
+}
+
+void SignalGenerator_API::setWaveformCacheDir(const QString& dir){
+    gen->waveformCacheDir = dir;
+}
 }
@@ -76,6 +76,11 @@ class SignalGenerator_API : public ApiObject
            READ getBufferSampleRate WRITE setBufferSampleRate)
     Q_PROPERTY(QList<double> buffer_phase
            READ getBufferPhase WRITE setBufferPhase)
+    Q_PROPERTY(QList<bool> buffer_streaming
+           READ getBufferStreaming WRITE setBufferStreaming)
+    Q_PROPERTY(double sync_skew READ getSyncSkew STORED false)
+    Q_PROPERTY(QString waveform_cache_dir
+           READ getWaveformCacheDir WRITE setWaveformCacheDir)
 
 
 public:
@@ -139,6 +144,11 @@ public:
     void setBufferSampleRate(const QList<double>& list);
     QList<double> getBufferPhase() const;
     void setBufferPhase(const QList<double>& list);
+    QList<bool> getBufferStreaming() const;
+    void setBufferStreaming(const QList<bool>& list);
+    double getSyncSkew() const;
+    QString getWaveformCacheDir() const;
+    void setWaveformCacheDir(const QString& dir);
 
         Q_INVOKABLE void show();
 
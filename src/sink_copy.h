@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SINK_COPY_H
+#define SINK_COPY_H
+
+#include <stddef.h>
+
+namespace adiscope {
+
+/*
+ * The per-sample loops the display sinks run on every input: copying a
+ * span of each channel into the sink's buffers, converting the sample
+ * type on the way, optionally finding the range of every channel in the
+ * same pass.
+ *
+ * The channel count is a template parameter, so that for the one and two
+ * channel flowgraphs of the M2K the loop over the channels is unrolled
+ * and only the loops over the samples are left, which the compiler
+ * vectorizes for the sample types at hand. NChannels == 0 is the generic
+ * version, taking the count at run time; sink_copy() and
+ * sink_copy_range() pick the right one.
+ */
+template <typename In, typename Out, int NChannels>
+struct sink_channels
+{
+	/* dst[n][dst_offset + i] = src[n][src_offset + i] */
+	static void copy(int nchannels, Out *const *dst, size_t dst_offset,
+			 const void *const *src, size_t src_offset,
+			 size_t nitems)
+	{
+		const int count = NChannels ? NChannels : nchannels;
+
+		for (int n = 0; n < count; n++) {
+			const In *in = static_cast<const In *>(src[n]) +
+				src_offset;
+			Out *out = dst[n] + dst_offset;
+
+			for (size_t i = 0; i < nitems; i++)
+				out[i] = static_cast<Out>(in[i]);
+		}
+	}
+
+	/* dst[n][i] = src[n][src_offset + i], min[n]/max[n] the range of
+	 * the span, 0 if it is empty */
+	static void copy_range(int nchannels, Out *const *dst,
+			       const In *const *src, size_t src_offset,
+			       size_t nitems, float *min, float *max)
+	{
+		const int count = NChannels ? NChannels : nchannels;
+
+		for (int n = 0; n < count; n++) {
+			const In *in = src[n] + src_offset;
+			Out *out = dst[n];
+			Out lo = nitems ? static_cast<Out>(in[0]) : Out();
+			Out hi = lo;
+
+			for (size_t i = 0; i < nitems; i++) {
+				Out v = static_cast<Out>(in[i]);
+
+				out[i] = v;
+				lo = v < lo ? v : lo;
+				hi = v > hi ? v : hi;
+			}
+
+			min[n] = static_cast<float>(lo);
+			max[n] = static_cast<float>(hi);
+		}
+	}
+};
+
+template <typename In, typename Out>
+inline void sink_copy(int nchannels, Out *const *dst, size_t dst_offset,
+		      const void *const *src, size_t src_offset, size_t nitems)
+{
+	switch (nchannels) {
+	case 1:
+		sink_channels<In, Out, 1>::copy(1, dst, dst_offset,
+				src, src_offset, nitems);
+		break;
+	case 2:
+		sink_channels<In, Out, 2>::copy(2, dst, dst_offset,
+				src, src_offset, nitems);
+		break;
+	default:
+		sink_channels<In, Out, 0>::copy(nchannels, dst, dst_offset,
+				src, src_offset, nitems);
+		break;
+	}
+}
+
+template <typename In, typename Out>
+inline void sink_copy_range(int nchannels, Out *const *dst,
+			    const In *const *src, size_t src_offset,
+			    size_t nitems, float *min, float *max)
+{
+	switch (nchannels) {
+	case 1:
+		sink_channels<In, Out, 1>::copy_range(1, dst, src,
+				src_offset, nitems, min, max);
+		break;
+	case 2:
+		sink_channels<In, Out, 2>::copy_range(2, dst, src,
+				src_offset, nitems, min, max);
+		break;
+	default:
+		sink_channels<In, Out, 0>::copy_range(nchannels, dst, src,
+				src_offset, nitems, min, max);
+		break;
+	}
+}
+
+} // namespace adiscope
+
+#endif // SINK_COPY_H
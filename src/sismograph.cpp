@@ -20,14 +20,28 @@
 
 #include "sismograph.hpp"
 
+#include <algorithm>
+
 #include <qwt_plot_layout.h>
 #include <qwt_scale_engine.h>
 
+/* Enough for 60 s of raw samples at 10 Hz, and two weeks in the top
+ * level */
+#define HISTORY_POINTS 1200
+#define HISTORY_FACTOR 10
+#define HISTORY_LEVELS 5
+#define MIN_REPLOT_INTERVAL_MS 40
+
 using namespace adiscope;
 
 Sismograph::Sismograph(QWidget *parent) : QwtPlot(parent),
-	curve("data"), sampleRate(10.0)
+	curve("data"), minCurve("min"), maxCurve("max"), sampleRate(10.0),
+	history(HISTORY_POINTS, HISTORY_FACTOR, HISTORY_LEVELS), level(0)
 {
+	replotTimer.setSingleShot(true);
+	replotTimer.setInterval(MIN_REPLOT_INTERVAL_MS);
+	connect(&replotTimer, SIGNAL(timeout()), this, SLOT(updateCurves()));
+
 	enableAxis(QwtPlot::xBottom, false);
 	enableAxis(QwtPlot::xTop, true);
 
@@ -55,6 +69,8 @@ Sismograph::Sismograph(QWidget *parent) : QwtPlot(parent),
 
 	plotLayout()->setAlignCanvasToScales(true);
 
+	minCurve.setXAxis(QwtPlot::xTop);
+	maxCurve.setXAxis(QwtPlot::xTop);
 	curve.attach(this);
 	curve.setXAxis(QwtPlot::xTop);
 }
@@ -66,14 +82,31 @@ Sismograph::~Sismograph()
 
 void Sismograph::plot(double sample)
 {
-	if (xdata.size() == numSamples + 1)
-		xdata.pop();
-
-	xdata.push(sample);
+	history.push(sample);
 	scaler->setValue(sample);
 
-	curve.setRawSamples(xdata.data(), ydata.data() + (ydata.size() -
-				xdata.size()), xdata.size());
+	if (!replotTimer.isActive())
+		replotTimer.start();
+}
+
+void Sismograph::updateCurves()
+{
+	/* The points of the window, plus the one at its edge */
+	int points = (int) (numSamples / history.span(level)) + 1;
+	int count = std::min(points, (int) history.mean(level).size());
+	const double *times = ydata.data() + (ydata.size() - count);
+
+	/* The points are the oldest first, ending with the newest one */
+	curve.setRawSamples(history.mean(level).data() +
+			history.mean(level).size() - count, times, count);
+
+	if (level > 0) {
+		minCurve.setRawSamples(history.min(level).data() +
+				history.min(level).size() - count, times, count);
+		maxCurve.setRawSamples(history.max(level).data() +
+				history.max(level).size() - count, times, count);
+	}
+
 	replot();
 }
 
@@ -86,14 +119,23 @@ void Sismograph::setNumSamples(int num)
 {
 	numSamples = (unsigned int) num;
 
-	reset();
-	ydata.resize(numSamples + 1);
-	xdata.reserve(numSamples + 1);
+	/* The history is kept, only the level shown changes */
+	level = history.levelFor(numSamples + 1);
+
+	if (level > 0) {
+		minCurve.attach(this);
+		maxCurve.attach(this);
+	} else {
+		minCurve.detach();
+		maxCurve.detach();
+	}
+
+	scaler->startTimer();
 
 	setAxisScale(QwtPlot::yLeft, (double) numSamples / sampleRate, 0.0);
 
 	setSampleRate(sampleRate);
-	replot();
+	updateCurves();
 
 	scaler->setTimeout((double) numSamples * 1000.0 / sampleRate);
 }
@@ -107,19 +149,34 @@ void Sismograph::setSampleRate(double rate)
 {
 	sampleRate = rate;
 
-	for (unsigned int i = 0; i <= numSamples; i++)
-		ydata[i] = (double)(numSamples - i) / sampleRate;
+	updateTimes();
+}
+
+void Sismograph::updateTimes()
+{
+	unsigned long long span = history.span(level);
+	int points = (int) (numSamples / span) + 1;
+
+	ydata.resize(points);
+	for (int i = 0; i < points; i++)
+		ydata[i] = (double)(points - 1 - i) * span / sampleRate;
 }
 
 void Sismograph::reset()
 {
-	xdata.clear();
+	history.clear();
 	scaler->startTimer();
+	updateCurves();
 }
 
 void Sismograph::setColor(const QColor& color)
 {
 	curve.setPen(QPen(color));
+
+	QColor range(color);
+	range.setAlpha(100);
+	minCurve.setPen(QPen(range));
+	maxCurve.setPen(QPen(range));
 }
 
 void Sismograph::updateScale(const QwtScaleDiv div)
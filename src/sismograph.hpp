@@ -21,6 +21,7 @@
 #ifndef SISMOGRAPH_HPP
 #define SISMOGRAPH_HPP
 
+#include <QTimer>
 #include <QVector>
 #include <QWidget>
 
@@ -28,7 +29,7 @@
 #include <qwt_plot_curve.h>
 
 #include "autoScaler.hpp"
-#include "customFifo.hpp"
+#include "trend_store.hpp"
 
 namespace adiscope {
 	class Sismograph : public QwtPlot
@@ -61,14 +62,26 @@ namespace adiscope {
 		void setColor(const QColor& color);
 		void updateScale(const QwtScaleDiv);
 
+	private Q_SLOTS:
+		void updateCurves();
+
 	private:
+		void updateTimes();
+
 		QwtPlotCurve curve;
+		/* The range of each point when they are aggregates */
+		QwtPlotCurve minCurve, maxCurve;
 		unsigned int numSamples;
 		double sampleRate;
 		AutoScaler *scaler;
 
+		/* The curves are updated at most this often, however fast
+		 * the samples come */
+		QTimer replotTimer;
+
+		TrendStore history;
+		unsigned int level;
 		QVector<double> ydata;
-		CustomFifo<double> xdata;
 	};
 }
 
@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "software_trigger.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace adiscope;
+
+namespace {
+	const int SCAN_BLOCK = 32;
+
+	/* First i in [begin, end) where sign * data[i] is below lo or at
+	 * or above hi, end if none. The blocks are checked without
+	 * branches, so the comparisons get vectorized; only the block with
+	 * the hit is searched sample by sample. NaNs never match. */
+	int firstOutside(const float *data, int begin, int end, float sign,
+			float lo, float hi)
+	{
+		int b = begin;
+
+		for (; b + SCAN_BLOCK <= end; b += SCAN_BLOCK) {
+			int hit = 0;
+
+			for (int i = b; i < b + SCAN_BLOCK; i++) {
+				float v = sign * data[i];
+				hit |= (v < lo) | (v >= hi);
+			}
+
+			if (hit)
+				break;
+		}
+
+		for (; b < end; b++) {
+			float v = sign * data[b];
+			if (v < lo || v >= hi)
+				return b;
+		}
+
+		return end;
+	}
+}
+
+SoftwareTrigger::SoftwareTrigger():
+	d_type(NONE),
+	d_sign(1.0f),
+	d_level(0.0f),
+	d_hysteresis(0.0f),
+	d_runt_low(0.0f),
+	d_runt_high(0.0f),
+	d_min_width(0),
+	d_max_width(0),
+	d_state(UNKNOWN),
+	d_consumed(0),
+	d_pulse_start(0)
+{
+	update();
+}
+
+void SoftwareTrigger::setType(Type type)
+{
+	d_type = type;
+	update();
+	reset();
+}
+
+void SoftwareTrigger::setSlope(trigger_slope slope)
+{
+	d_sign = (slope == TRIG_SLOPE_NEG) ? -1.0f : 1.0f;
+	update();
+	reset();
+}
+
+void SoftwareTrigger::setLevel(float level)
+{
+	d_level = level;
+	update();
+}
+
+void SoftwareTrigger::setHysteresis(float hysteresis)
+{
+	d_hysteresis = std::fabs(hysteresis);
+	update();
+}
+
+void SoftwareTrigger::setRuntLevels(float low, float high)
+{
+	d_runt_low = std::min(low, high);
+	d_runt_high = std::max(low, high);
+	update();
+}
+
+void SoftwareTrigger::setPulseWidth(uint64_t min, uint64_t max)
+{
+	d_min_width = min;
+	d_max_width = max;
+}
+
+void SoftwareTrigger::reset()
+{
+	d_state = UNKNOWN;
+	d_consumed = 0;
+	d_pulse_start = 0;
+}
+
+void SoftwareTrigger::update()
+{
+	// The comparisons are done on sign * sample, so that a negative
+	// slope is a positive one upside down
+	if (d_type == RUNT) {
+		d_on = d_sign > 0 ? d_runt_low : -d_runt_high;
+		d_peak = d_sign > 0 ? d_runt_high : -d_runt_low;
+	} else {
+		d_on = d_sign * d_level;
+		d_peak = std::numeric_limits<float>::infinity();
+	}
+	d_off = d_on - d_hysteresis;
+}
+
+bool SoftwareTrigger::step(float v, uint64_t pos)
+{
+	switch (d_state) {
+	case UNKNOWN:
+		// A pulse already going on when the stream started has no
+		// known start, it is let go by
+		if (d_type == LEVEL) {
+			d_state = INACTIVE;
+			return v >= d_on;
+		}
+		d_state = (v >= d_on) ? SKIP : INACTIVE;
+		return false;
+
+	case INACTIVE:
+		if (v < d_on)
+			return false;
+		if (d_type == LEVEL)
+			return true;
+		d_state = (v >= d_peak) ? SKIP : ACTIVE;
+		d_pulse_start = pos;
+		return d_type == EDGE;
+
+	case ACTIVE:
+		if (v >= d_peak) {
+			d_state = SKIP;
+			return false;
+		}
+		if (v >= d_off)
+			return false;
+		d_state = INACTIVE;
+		if (d_type == PULSE_WIDTH) {
+			uint64_t width = pos - d_pulse_start;
+			return width >= d_min_width &&
+				(d_max_width == 0 || width <= d_max_width);
+		}
+		return d_type == RUNT;
+
+	case SKIP:
+		if (v < d_off)
+			d_state = INACTIVE;
+		return false;
+	}
+
+	return false;
+}
+
+int SoftwareTrigger::find(const float *data, int begin, int end)
+{
+	const float inf = std::numeric_limits<float>::infinity();
+	int found = -1;
+	int i = begin;
+
+	if (d_type == NONE) {
+		d_consumed += end - begin;
+		return -1;
+	}
+
+	while (i < end) {
+		// Skip ahead to the first sample that can change the state
+		if (d_state == INACTIVE) {
+			i = firstOutside(data, i, end, d_sign, -inf, d_on);
+		} else if (d_state == ACTIVE) {
+			i = firstOutside(data, i, end, d_sign, d_off, d_peak);
+		} else if (d_state == SKIP) {
+			i = firstOutside(data, i, end, d_sign, d_off, inf);
+		} else if (std::isnan(data[i])) {
+			i++;
+			continue;
+		}
+
+		if (i >= end)
+			break;
+
+		if (step(d_sign * data[i], d_consumed + (i - begin))) {
+			found = i;
+			break;
+		}
+		i++;
+	}
+
+	d_consumed += (found < 0 ? end : found + 1) - begin;
+	return found;
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SOFTWARE_TRIGGER_H
+#define SOFTWARE_TRIGGER_H
+
+#include <stdint.h>
+
+#include "trigger_mode.h"
+
+namespace adiscope {
+
+/*
+ * Trigger conditions evaluated on the samples themselves, for streaming
+ * mode where the hardware trigger is off. The state is kept from one
+ * call to the next, so a pulse spanning two blocks of samples is still
+ * caught; the blocks are expected to follow each other in the stream.
+ *
+ * With a positive slope: EDGE fires when the signal rises to the level,
+ * LEVEL on any sample at or above it, PULSE_WIDTH at the end of a pulse
+ * above the level of the given width and RUNT at the end of a pulse that
+ * rose to the low level but not to the high one. A negative slope turns
+ * all of them upside down. Falling back out of a pulse means going past
+ * the level by the hysteresis.
+ */
+class SoftwareTrigger
+{
+public:
+	enum Type {
+		NONE,
+		EDGE,
+		LEVEL,
+		PULSE_WIDTH,
+		RUNT,
+	};
+
+	SoftwareTrigger();
+
+	Type type() const { return d_type; }
+	void setType(Type type);
+
+	void setSlope(trigger_slope slope);
+	void setLevel(float level);
+	void setHysteresis(float hysteresis);
+
+	/* Thresholds of the runt trigger, the low one replaces the level */
+	void setRuntLevels(float low, float high);
+
+	/* Widths in samples, a max of 0 means no limit */
+	void setPulseWidth(uint64_t min, uint64_t max);
+
+	/* Forget the history, for when the stream is not contiguous */
+	void reset();
+
+	/* Index in [begin, end) of the sample where the condition is met,
+	 * -1 if it isn't. The samples up to that one are consumed, the next
+	 * search is expected to start right after it. */
+	int find(const float *data, int begin, int end);
+
+private:
+	enum State {
+		UNKNOWN,
+		INACTIVE,
+		ACTIVE,
+		SKIP,		// above the level, but not a pulse to count
+	};
+
+	Type d_type;
+	float d_sign;
+	float d_level, d_hysteresis;
+	float d_runt_low, d_runt_high;
+	uint64_t d_min_width, d_max_width;
+
+	/* Thresholds in sign * sample: rising to on starts a pulse, going
+	 * below off ends it, reaching peak means it isn't a runt */
+	float d_on, d_off, d_peak;
+
+	State d_state;
+	uint64_t d_consumed;
+	uint64_t d_pulse_start;
+
+	void update();
+	bool step(float v, uint64_t pos);
+};
+}
+
+#endif // SOFTWARE_TRIGGER_H
@@ -23,6 +23,8 @@
 
 #include "spectrumUpdateEvents.h"
 
+#include <algorithm>
+
 SpectrumUpdateEvent::SpectrumUpdateEvent(const float* fftPoints,
 					 const uint64_t numFFTDataPoints,
 					 const double* realTimeDomainPoints,
@@ -201,10 +203,79 @@ SpectrumFrequencyRangeEvent::GetStopFrequency() const
 /***************************************************************************/
 
 
-TimeUpdateEvent::TimeUpdateEvent(const std::vector<double*> &timeDomainPoints,
+TimeUpdateBufferPool::TimeUpdateBufferPool(size_t nslots, size_t nplots)
+  : _sequence(0),
+    _slots(nslots)
+{
+  for(size_t i = 0; i < nslots; i++) {
+    _slots[i].points = std::vector<float*>(nplots, nullptr);
+    _slots[i].capacity = 0;
+    _slots[i].tags = std::vector< std::vector<gr::tag_t> >(nplots);
+    _slots[i].sequence = 0;
+    _slots[i].offset = 0;
+    _slots[i].append = false;
+    _slots[i].min = std::vector<float>(nplots, 0.0f);
+    _slots[i].max = std::vector<float>(nplots, 0.0f);
+    _free.push_back(&_slots[i]);
+  }
+}
+
+TimeUpdateBufferPool::~TimeUpdateBufferPool()
+{
+  for(size_t i = 0; i < _slots.size(); i++) {
+    for(size_t n = 0; n < _slots[i].points.size(); n++) {
+      delete[] _slots[i].points[n];
+    }
+  }
+}
+
+TimeUpdateBufferPool::Slot *
+TimeUpdateBufferPool::acquire(uint64_t npoints)
+{
+  Slot *slot;
+
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if(_free.empty()) {
+      return nullptr;
+    }
+
+    slot = _free.back();
+    _free.pop_back();
+    slot->sequence = ++_sequence;
+  }
+
+  slot->offset = 0;
+  slot->append = false;
+
+  // Only reallocate when the number of points grows
+  if(slot->capacity < npoints) {
+    for(size_t n = 0; n < slot->points.size(); n++) {
+      delete[] slot->points[n];
+      slot->points[n] = new float[npoints];
+    }
+    slot->capacity = npoints;
+  }
+
+  return slot;
+}
+
+void
+TimeUpdateBufferPool::release(Slot *slot)
+{
+  std::unique_lock<std::mutex> lock(_mutex);
+  _free.push_back(slot);
+}
+
+/***************************************************************************/
+
+
+TimeUpdateEvent::TimeUpdateEvent(const std::vector<float*> &timeDomainPoints,
 				 const uint64_t numTimeDomainDataPoints,
 				 const std::vector< std::vector<gr::tag_t> > &tags)
-  : QEvent(QEvent::Type(SpectrumUpdateEventType))
+  : QEvent(QEvent::Type(SpectrumUpdateEventType)),
+    _slot(nullptr)
 {
   if(numTimeDomainDataPoints < 1) {
     _numTimeDomainDataPoints = 1;
@@ -214,25 +285,54 @@ TimeUpdateEvent::TimeUpdateEvent(const std::vector<double*> &timeDomainPoints,
   }
 
   _nplots = timeDomainPoints.size();
+  _min = std::vector<float>(_nplots, 0.0f);
+  _max = std::vector<float>(_nplots, 0.0f);
   for(size_t i = 0; i < _nplots; i++) {
-    _dataTimeDomainPoints.push_back(new double[_numTimeDomainDataPoints]);
+    _dataTimeDomainPoints.push_back(new float[_numTimeDomainDataPoints]);
     if(numTimeDomainDataPoints > 0) {
       memcpy(_dataTimeDomainPoints[i], timeDomainPoints[i],
-	     _numTimeDomainDataPoints*sizeof(double));
+	     _numTimeDomainDataPoints*sizeof(float));
+
+      auto range = std::minmax_element(timeDomainPoints[i],
+		      timeDomainPoints[i] + numTimeDomainDataPoints);
+      _min[i] = *range.first;
+      _max[i] = *range.second;
     }
   }
 
   _tags = tags;
 }
 
+TimeUpdateEvent::TimeUpdateEvent(const std::shared_ptr<TimeUpdateBufferPool> &pool,
+				 TimeUpdateBufferPool::Slot *slot,
+				 const uint64_t numTimeDomainDataPoints)
+  : QEvent(QEvent::Type(SpectrumUpdateEventType)),
+    _nplots(slot->points.size()),
+    _dataTimeDomainPoints(slot->points),
+    _numTimeDomainDataPoints(numTimeDomainDataPoints),
+    _min(slot->min),
+    _max(slot->max),
+    _pool(pool),
+    _slot(slot)
+{
+  _tags.swap(slot->tags);
+}
+
 TimeUpdateEvent::~TimeUpdateEvent()
 {
+  if(_slot) {
+    // Hand the tag vectors back too, so that their storage gets reused
+    _slot->tags.swap(_tags);
+    _pool->release(_slot);
+    return;
+  }
+
   for(size_t i = 0; i < _nplots; i++) {
     delete[] _dataTimeDomainPoints[i];
   }
 }
 
-const std::vector<double*>
+const std::vector<float*>
 TimeUpdateEvent::getTimeDomainPoints() const
 {
   return _dataTimeDomainPoints;
@@ -250,16 +350,56 @@ TimeUpdateEvent::getTags() const
   return _tags;
 }
 
+bool
+TimeUpdateEvent::isSuperseded() const
+{
+  return _slot && _pool->superseded(_slot);
+}
+
+uint64_t
+TimeUpdateEvent::getOffset() const
+{
+  return _slot ? _slot->offset : 0;
+}
+
+bool
+TimeUpdateEvent::isAppend() const
+{
+  return _slot && _slot->append;
+}
+
+float
+TimeUpdateEvent::getMin(size_t plot) const
+{
+  return _min[plot];
+}
+
+float
+TimeUpdateEvent::getMax(size_t plot) const
+{
+  return _max[plot];
+}
+
 /***************************************************************************/
 
 
-IdentifiableTimeUpdateEvent::IdentifiableTimeUpdateEvent(const std::vector<double*> &timeDomainPoints,
+IdentifiableTimeUpdateEvent::IdentifiableTimeUpdateEvent(const std::vector<float*> &timeDomainPoints,
 				 const uint64_t numTimeDomainDataPoints,
 				 const std::vector< std::vector<gr::tag_t> > &tags,
 				 const std::string &senderName)
   : TimeUpdateEvent(timeDomainPoints, numTimeDomainDataPoints, tags),
     _senderName(senderName)
 {
+}
+
+IdentifiableTimeUpdateEvent::IdentifiableTimeUpdateEvent(
+				 const std::shared_ptr<TimeUpdateBufferPool> &pool,
+				 TimeUpdateBufferPool::Slot *slot,
+				 const uint64_t numTimeDomainDataPoints,
+				 const std::string &senderName)
+  : TimeUpdateEvent(pool, slot, numTimeDomainDataPoints),
+    _senderName(senderName)
+{
 }
 
  IdentifiableTimeUpdateEvent::~IdentifiableTimeUpdateEvent()
@@ -370,14 +510,51 @@ ConstUpdateEvent::ConstUpdateEvent(const std::vector<double*> &realDataPoints,
   }
 }
 
+ConstUpdateEvent::ConstUpdateEvent(const std::shared_ptr<PlotFrameHandoff> &frames)
+  : QEvent(QEvent::Type(SpectrumUpdateEventType)),
+    _nplots(0),
+    _numDataPoints(0),
+    _frames(frames)
+{
+}
+
 ConstUpdateEvent::~ConstUpdateEvent()
 {
+  // The frame belongs to the handoff
+  if(_frames) {
+    return;
+  }
+
   for(size_t i = 0; i < _nplots; i++) {
     delete[] _realDataPoints[i];
     delete[] _imagDataPoints[i];
   }
 }
 
+bool
+ConstUpdateEvent::fetchFrame()
+{
+  if(!_frames) {
+    return true;
+  }
+
+  if(!_frames->fetch()) {
+    return false;
+  }
+
+  const std::vector< std::vector<double> > &frame = _frames->read_buffer();
+  _nplots = frame.size() / 2;
+  _numDataPoints = _nplots ? frame[0].size() : 0;
+  _realDataPoints.clear();
+  _imagDataPoints.clear();
+  for(size_t i = 0; i < _nplots; i++) {
+    _realDataPoints.push_back(const_cast<double*>(frame[i].data()));
+    _imagDataPoints.push_back(const_cast<double*>(frame[_nplots + i].data()));
+  }
+
+  return true;
+}
+
 const std::vector<double*>
 ConstUpdateEvent::getRealPoints() const
 {
@@ -496,31 +673,39 @@ TimeRasterUpdateEvent::getNumDataPoints() const
 /***************************************************************************/
 
 
-HistogramUpdateEvent::HistogramUpdateEvent(const std::vector<double*> &points,
-                                           const uint64_t npoints)
-  : QEvent(QEvent::Type(SpectrumUpdateEventType))
+HistogramUpdateEvent::HistogramUpdateEvent(const std::shared_ptr<HistogramFrameHandoff> &frames)
+  : QEvent(QEvent::Type(SpectrumUpdateEventType)),
+    _nbins(0),
+    _left(0),
+    _right(0),
+    _nsamples(0),
+    _frames(frames)
 {
-  if(npoints < 1) {
-    _npoints = 1;
-  }
-  else {
-    _npoints = npoints;
-  }
-
-  _nplots = points.size();
-  for(size_t i = 0; i < _nplots; i++) {
-    _points.push_back(new double[_npoints]);
-    if(npoints > 0) {
-      memcpy(_points[i], points[i], _npoints*sizeof(double));
-    }
-  }
 }
 
 HistogramUpdateEvent::~HistogramUpdateEvent()
 {
-  for(size_t i = 0; i < _nplots; i++) {
-    delete[] _points[i];
+  // The frame belongs to the handoff
+}
+
+bool
+HistogramUpdateEvent::fetchFrame()
+{
+  if(!_frames->fetch()) {
+    return false;
+  }
+
+  const HistogramFrame &frame = _frames->read_buffer();
+  _nbins = frame.counts.size() ? frame.counts[0].size() : 0;
+  _left = frame.left;
+  _right = frame.right;
+  _nsamples = frame.samples;
+  _points.clear();
+  for(size_t i = 0; i < frame.counts.size(); i++) {
+    _points.push_back(const_cast<double*>(frame.counts[i].data()));
   }
+
+  return true;
 }
 
 const std::vector<double*>
@@ -530,9 +715,27 @@ HistogramUpdateEvent::getDataPoints() const
 }
 
 uint64_t
-HistogramUpdateEvent::getNumDataPoints() const
+HistogramUpdateEvent::getNumBins() const
+{
+  return _nbins;
+}
+
+double
+HistogramUpdateEvent::getLeft() const
+{
+  return _left;
+}
+
+double
+HistogramUpdateEvent::getRight() const
+{
+  return _right;
+}
+
+uint64_t
+HistogramUpdateEvent::getNumSamples() const
 {
-  return _npoints;
+  return _nsamples;
 }
 
 
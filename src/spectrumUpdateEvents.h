@@ -24,16 +24,35 @@
 #include <stdint.h>
 #include <QEvent>
 #include <QString>
+#include <atomic>
 #include <complex>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <gnuradio/high_res_timer.h>
 #include <gnuradio/tags.h>
 
+#include "frame_handoff.h"
+
 static const int SpectrumUpdateEventType = 10005;
 static const int SpectrumWindowCaptionEventType = 10008;
 static const int SpectrumWindowResetEventType = 10009;
 static const int SpectrumFrequencyRangeEventType = 10010;
 
+/* One vector of samples per plotted channel */
+typedef adiscope::frame_handoff< std::vector< std::vector<double> > >
+	PlotFrameHandoff;
+
+/* Bin counts computed by the histogram sink */
+struct HistogramFrame
+{
+  std::vector< std::vector<double> > counts; // one vector per channel
+  double left, right; // center of the first bin, end of the last one
+  uint64_t samples; // samples of one channel the counts are made of
+};
+
+typedef adiscope::frame_handoff<HistogramFrame> HistogramFrameHandoff;
+
 class SpectrumUpdateEvent:public QEvent{
 
 public:
@@ -116,19 +135,83 @@ private:
 };
 
 
+/*
+ * Fixed set of pre-allocated payloads for the TimeUpdateEvent objects a
+ * sink posts to its plot. A slot is handed back to the pool when the
+ * event that carries it is destroyed, i.e. after the plot processed it,
+ * so the sink doesn't allocate on every refresh and can never have more
+ * than the pool size of events waiting in the GUI event queue.
+ * The payload stays in the sink's float format; the plots widen it to
+ * double only while copying it into their curve storage.
+ */
+class TimeUpdateBufferPool
+{
+public:
+  struct Slot {
+    std::vector<float*> points;
+    uint64_t capacity;
+    std::vector< std::vector<gr::tag_t> > tags;
+    uint64_t sequence;
+
+    /* Rolling mode: the points are the samples of the current frame
+     * starting at offset, the ones before were sent earlier. */
+    uint64_t offset;
+    bool append;
+
+    /* Range of the points of each plot, computed by the producer */
+    std::vector<float> min, max;
+  };
+
+  TimeUpdateBufferPool(size_t nslots, size_t nplots);
+  ~TimeUpdateBufferPool();
+
+  /* Returns a free slot able to hold npoints samples per plot, or
+   * nullptr if all the slots are still in use by the GUI. */
+  Slot *acquire(uint64_t npoints);
+  void release(Slot *slot);
+
+  /* True if a newer slot was acquired after this one, the GUI can then
+   * skip drawing it and only draw the newest frame. Appended data is
+   * never superseded, as it only holds part of a frame. */
+  bool superseded(const Slot *slot) const
+      { return !slot->append && slot->sequence != _sequence.load(); }
+
+private:
+  std::atomic<uint64_t> _sequence;
+  std::mutex _mutex;
+  std::vector<Slot> _slots;
+  std::vector<Slot*> _free;
+
+  TimeUpdateBufferPool(const TimeUpdateBufferPool&) = delete;
+  TimeUpdateBufferPool& operator=(const TimeUpdateBufferPool&) = delete;
+};
+
+
 class TimeUpdateEvent: public QEvent
 {
 public:
-  TimeUpdateEvent(const std::vector<double*> &timeDomainPoints,
+  TimeUpdateEvent(const std::vector<float*> &timeDomainPoints,
 		  const uint64_t numTimeDomainDataPoints,
 		  const std::vector< std::vector<gr::tag_t> > &tags);
 
+  /* Carry a payload taken from the pool instead of a private copy */
+  TimeUpdateEvent(const std::shared_ptr<TimeUpdateBufferPool> &pool,
+		  TimeUpdateBufferPool::Slot *slot,
+		  const uint64_t numTimeDomainDataPoints);
+
   ~TimeUpdateEvent();
 
   int which() const;
-  const std::vector<double*> getTimeDomainPoints() const;
+  const std::vector<float*> getTimeDomainPoints() const;
   uint64_t getNumTimeDomainDataPoints() const;
   bool getRepeatDataFlag() const;
+  bool isSuperseded() const;
+  uint64_t getOffset() const;
+  bool isAppend() const;
+
+  /* Smallest and largest of the points of a plot */
+  float getMin(size_t plot) const;
+  float getMax(size_t plot) const;
 
   const std::vector< std::vector<gr::tag_t> > getTags() const;
 
@@ -139,9 +222,13 @@ protected:
 
 private:
   size_t _nplots;
-  std::vector<double*> _dataTimeDomainPoints;
+  std::vector<float*> _dataTimeDomainPoints;
   uint64_t _numTimeDomainDataPoints;
   std::vector< std::vector<gr::tag_t> > _tags;
+  std::vector<float> _min, _max;
+
+  std::shared_ptr<TimeUpdateBufferPool> _pool;
+  TimeUpdateBufferPool::Slot *_slot;
 };
 
 
@@ -151,11 +238,17 @@ private:
 class IdentifiableTimeUpdateEvent: public TimeUpdateEvent
 {
 public:
-  IdentifiableTimeUpdateEvent(const std::vector<double*> &timeDomainPoints,
+  IdentifiableTimeUpdateEvent(const std::vector<float*> &timeDomainPoints,
 		  const uint64_t numTimeDomainDataPoints,
 		  const std::vector< std::vector<gr::tag_t> > &tags,
 		  const std::string &senderName);
 
+  IdentifiableTimeUpdateEvent(
+		  const std::shared_ptr<TimeUpdateBufferPool> &pool,
+		  TimeUpdateBufferPool::Slot *slot,
+		  const uint64_t numTimeDomainDataPoints,
+		  const std::string &senderName);
+
   ~IdentifiableTimeUpdateEvent();
 
   std::string senderName();
@@ -219,8 +312,15 @@ public:
 		   const std::vector<double*> &imagDataPoints,
 		   const uint64_t numDataPoints);
 
+  /* Only notify the plot, which takes the newest frame from the
+   * handoff: the real parts of the channels, then the imaginary ones */
+  ConstUpdateEvent(const std::shared_ptr<PlotFrameHandoff> &frames);
+
   ~ConstUpdateEvent();
 
+  /* Returns false if there's nothing newer than the last frame plotted */
+  bool fetchFrame();
+
   int which() const;
   const std::vector<double*> getRealPoints() const;
   const std::vector<double*> getImagPoints() const;
@@ -237,6 +337,8 @@ private:
   std::vector<double*> _realDataPoints;
   std::vector<double*> _imagDataPoints;
   uint64_t _numDataPoints;
+
+  std::shared_ptr<PlotFrameHandoff> _frames;
 };
 
 
@@ -306,25 +408,31 @@ private:
 class HistogramUpdateEvent: public QEvent
 {
 public:
-  HistogramUpdateEvent(const std::vector<double*> &points,
-                       const uint64_t npoints);
+  /* Only notify the plot, which takes the newest frame from the handoff */
+  HistogramUpdateEvent(const std::shared_ptr<HistogramFrameHandoff> &frames);
 
   ~HistogramUpdateEvent();
 
-  int which() const;
+  /* Returns false if there's nothing newer than the last frame plotted */
+  bool fetchFrame();
+
+  /* One array of getNumBins() counts per channel */
   const std::vector<double*> getDataPoints() const;
-  uint64_t getNumDataPoints() const;
-  bool getRepeatDataFlag() const;
+  uint64_t getNumBins() const;
+  double getLeft() const;
+  double getRight() const;
+  uint64_t getNumSamples() const;
 
   static QEvent::Type Type()
   { return QEvent::Type(SpectrumUpdateEventType); }
 
-protected:
-
 private:
-  size_t _nplots;
   std::vector<double*> _points;
-  uint64_t _npoints;
+  uint64_t _nbins;
+  double _left, _right;
+  uint64_t _nsamples;
+
+  std::shared_ptr<HistogramFrameHandoff> _frames;
 };
 
 
@@ -20,7 +20,6 @@
 
 /* GNU Radio includes */
 #include <gnuradio/blocks/float_to_complex.h>
-#include <gnuradio/blocks/complex_to_mag_squared.h>
 #include <gnuradio/blocks/add_blk.h>
 #include <scopy/math.h>
 #include <gnuradio/analog/sig_source.h>
@@ -28,6 +27,7 @@
 
 /* Qt includes */
 #include <QGridLayout>
+#include <QVBoxLayout>
 #include <QPushButton>
 #include <QButtonGroup>
 #include <QDebug>
@@ -39,20 +39,28 @@
 #include "spectrum_analyzer.hpp"
 #include "filter.hpp"
 #include "math.hpp"
-#include "fft_block.hpp"
+#include "fft_power_block.hpp"
+#include "fft_stitch_block.hpp"
 #include "adc_sample_conv.hpp"
 #include "dynamicWidget.hpp"
 #include "hardware_trigger.hpp"
 #include "channel_widget.hpp"
 #include "db_click_buttons.hpp"
 #include "filemanager.h"
+#include "export_service.hpp"
+#include "performance_monitor.hpp"
+#include "memory_budget.hpp"
 #include "spectrum_analyzer_api.hpp"
+#include "waterfall_display.h"
 
 /* Generated UI */
 #include "ui_spectrum_analyzer.h"
 
 #include <boost/make_shared.hpp>
 #include <iio.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
 #include <iostream>
 
 static const int MAX_REF_CHANNELS = 4;
@@ -108,6 +116,8 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 	ui(new Ui::SpectrumAnalyzer),
 	marker_selector(new DbClickButtons(this)),
 	fft_plot(nullptr),
+	waterfall(nullptr),
+	waterfall_box(nullptr),
 	settings_group(new QButtonGroup(this)),
 	channels_group(new QButtonGroup(this)),
 	adc(adc),
@@ -116,6 +126,13 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 	crt_peak(0),
 	max_peak_count(10),
 	fft_size(32768),
+	fft_overlap(0.0),
+	zoom_decimation(1),
+	sweep_segments(1),
+	active_segments(1),
+	cross_spectrum(false),
+	cross_avg_type(FftDisplayPlot::SAMPLE),
+	cross_avg_history(0),
 	searchVisiblePeaks(true),
 	sample_rate(100e6),
 	sample_rate_divider(1),
@@ -207,9 +224,20 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 		fft_plot->setYaxisMouseGesturesEnabled(i, false);
 	}
 
+	// The waterfall sits under the plot, sharing its frequency axis
+	waterfall = new WaterfallDisplay(this);
+	waterfall->hide();
+
+	QWidget *plots = new QWidget(this);
+	QVBoxLayout *plotsLayout = new QVBoxLayout(plots);
+	plotsLayout->setContentsMargins(0, 0, 0, 0);
+	plotsLayout->setSpacing(0);
+	plotsLayout->addWidget(fft_plot, 2);
+	plotsLayout->addWidget(waterfall, 1);
+
 	QGridLayout *gLayout = static_cast<QGridLayout *>
 	                       (ui->widgetPlotContainer->layout());
-	gLayout->addWidget(fft_plot, 1, 0, 1, 1);
+	gLayout->addWidget(plots, 1, 0, 1, 1);
 
 	// Initialize spectrum channels
 	for (int i = 0 ; i < num_adc_channels; i++) {
@@ -263,6 +291,7 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 		fft_plot->replot();
 
 		setSampleRate(2 * stop);
+		updateZoom();
 
 		/* Re-populate the RBW list with the new available values */
 		ui->cmb_rbw->blockSignals(true);
@@ -271,7 +300,7 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 
 		for (; i < bin_sizes.size(); i++) {
 			ui->cmb_rbw->addItem(freq_formatter.format(
-						     sample_rate / bin_sizes[i], "Hz", 2));
+						     fftSampleRate() / bin_sizes[i], "Hz", 2));
 		}
 
 		ui->cmb_rbw->blockSignals(false);
@@ -284,7 +313,7 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 
 	connect(ui->cmb_rbw, QOverload<int>::of(&QComboBox::currentIndexChanged),
 		[=](int index){
-		startStopRange->setMinimumSpanValue(10 * sample_rate / bin_sizes[index]);
+		startStopRange->setMinimumSpanValue(10 * fftSampleRate() / bin_sizes[index]);
 	});
 
 	// Initialize vertical axis controls
@@ -353,6 +382,10 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 
 	connect(fft_plot, SIGNAL(newData()),
 	        SLOT(singleCaptureDone()));
+	connect(fft_plot, SIGNAL(newData()),
+	        SLOT(updateWaterfall()));
+	connect(this, &Tool::displayedChanged,
+		this, &SpectrumAnalyzer::onDisplayedChanged);
 
 	connect(top, SIGNAL(valueChanged(double)),
 	        SLOT(onTopValueChanged(double)));
@@ -385,11 +418,31 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 	connect(ui->logBtn, &QPushButton::toggled,
 		fft_plot, &FftDisplayPlot::useLogFreq);
 
+	waterfall_box = new QCheckBox(tr("Waterfall"), this);
+	ui->verticalLayout_7->insertWidget(
+		ui->verticalLayout_7->indexOf(ui->logBtn) + 1, waterfall_box);
+	connect(waterfall_box, &QCheckBox::toggled,
+		this, &SpectrumAnalyzer::setWaterfallEnabled);
+
 	api->setObjectName(QString::fromStdString(Filter::tool_name(
 	                           TOOL_SPECTRUM_ANALYZER)));
 	api->load(*settings);
 	api->js_register(engine);
 
+	PerformanceMonitor *perf = PerformanceMonitor::instance();
+	perf->addRate(this, api->objectName(), "frames_acquired", [=]() {
+		return fft_sink ? (double)fft_sink->frames_acquired() : 0.0;
+	});
+	perf->addRate(this, api->objectName(), "frames_posted", [=]() {
+		return fft_sink ? (double)fft_sink->frames_posted() : 0.0;
+	});
+	perf->addPaintRate(fft_plot->canvas(), api->objectName(), "plot_fps");
+
+	MemoryBudget::instance()->addUsage(this, api->objectName(),
+		tr("averaging history"), [=]() {
+		return fft_plot->averageMemory();
+	});
+
 	connect(ui->rightMenu, &MenuAnim::finished, this, &SpectrumAnalyzer::rightMenuFinished);
 	menuOrder.push_back(ui->btnSweep);
 
@@ -465,19 +518,15 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 			}
 
 			if (!fileName.isEmpty()) {
-				FileManager fm("Spectrum Analyzer");
-				fm.open(fileName, FileManager::EXPORT);
-
-				QVector<double> freq_data, mag_data;
-
-				for (size_t i = 0; i < curve->data()->size(); ++i) {
-					freq_data.push_back(curve->sample(i).x());
-					mag_data.push_back(curve->sample(i).y());
-				}
+				std::shared_ptr<FileManager> fm =
+					std::make_shared<FileManager>("Spectrum Analyzer");
+				fm->open(fileName, FileManager::EXPORT);
 
 				QString unit = ui->lblMagUnit->text();
-				fm.save(freq_data, "Frequency(Hz)");
-				fm.save(mag_data, "REF" + QString::number(selected_ch_settings - num_adc_channels + 1)
+				fm->save(FileManager::seriesSnapshot(curve->data(), false),
+					"Frequency(Hz)");
+				fm->save(FileManager::seriesSnapshot(curve->data(), true),
+					"REF" + QString::number(selected_ch_settings - num_adc_channels + 1)
 					+ "(" + unit + ")");
 
 				QString channelDetails;
@@ -505,9 +554,9 @@ SpectrumAnalyzer::SpectrumAnalyzer(struct iio_context *ctx, Filter *filt,
 				channelDetails += importedChannelDetails[selected_ch_settings - num_adc_channels][2];
 				channelDetails += ",";
 
-				fm.setAdditionalInformation(channelDetails);
+				fm->setAdditionalInformation(channelDetails);
 
-				fm.performWrite();
+				ExportService::instance()->start(this, fileName, fm);
 			}
 		}
 	});
@@ -562,6 +611,10 @@ void SpectrumAnalyzer::setNativeDialogs(bool nativeDialogs)
 
 void SpectrumAnalyzer::readPreferences() {
 	fft_plot->setVisiblePeakSearch(prefPanel->getSpectrum_visible_peak_search());
+
+	if (iio) {
+		iio->set_kernel_buffers_count(prefPanel->getAdc_kernel_buffers());
+	}
 }
 
 void SpectrumAnalyzer::btnExportClicked()
@@ -569,6 +622,8 @@ void SpectrumAnalyzer::btnExportClicked()
 	QStringList filter;
 	filter += QString(tr("Comma-separated values files (*.csv)"));
 	filter += QString(tr("Tab-delimited values files (*.txt)"));
+	filter += QString(tr("NumPy array files (*.npy)"));
+	filter += QString(tr("Compressed capture archives (*.scarc)"));
 	filter += QString(tr("All Files(*)"));
 
 	QString selectedFilter = filter[0];
@@ -584,26 +639,25 @@ void SpectrumAnalyzer::btnExportClicked()
 	}
 
 	if (!fileName.isEmpty()) {
-		FileManager fm("Spectrum Analyzer");
-		fm.open(fileName, FileManager::EXPORT);
+		std::shared_ptr<FileManager> fm =
+			std::make_shared<FileManager>("Spectrum Analyzer");
+		fm->open(fileName, FileManager::EXPORT);
 
-		QVector<double> frequency_data;
-		int nr_samples = fft_plot->Curve(0)->data()->size();
-		for (int i = 0; i < nr_samples; ++i) {
-			frequency_data.push_back(fft_plot->Curve(0)->sample(i).x());
-		}
-
-		fm.save(frequency_data, "Frequency(Hz)");
+		/* Copied before the next spectrum replaces them, the file
+		 * is written in the background */
+		QVector<double> freqs = FileManager::seriesSnapshot(
+				fft_plot->Curve(0)->data(), false);
+		fm->save(freqs, "Frequency(Hz)");
 
 		QString channelDetails = "";
 
 		for (int i = 0; i < channels.size(); ++i) {
-			QVector<double> data;
-			for (int j = 0; j < nr_samples; ++j) {
-				data.push_back(fft_plot->Curve(i)->sample(j).y());
-			}
 			QString unit = ui->lblMagUnit->text();
-			fm.save(data, "Amplitude CH" + QString::number(i + 1)
+			QVector<double> values = FileManager::seriesSnapshot(
+					fft_plot->Curve(i)->data(), true);
+			values.resize(std::min(values.size(), freqs.size()));
+			fm->save(values,
+				"Amplitude CH" + QString::number(i + 1)
 				+ "(" + unit + ")");
 
 			/* Save information about the channels averaging type, window and
@@ -635,9 +689,9 @@ void SpectrumAnalyzer::btnExportClicked()
 
 		}
 
-		fm.setAdditionalInformation(channelDetails);
+		fm->setAdditionalInformation(channelDetails);
 
-		fm.performWrite();
+		ExportService::instance()->start(this, fileName, fm);
 	}
 
 }
@@ -773,28 +827,44 @@ void SpectrumAnalyzer::on_btnBrowseFile_clicked()
 {
 	QString fileName = QFileDialog::getOpenFileName(this,
 	    tr("Export"), "", tr("Comma-separated values files (*.csv);;"
-				       "Tab-delimited values files (*.txt)"),
+				       "Tab-delimited values files (*.txt);;"
+				       "NumPy array files (*.npy);;"
+				       "Compressed capture archives (*.scarc)"),
 	    nullptr, (m_useNativeDialogs ? QFileDialog::Options() : QFileDialog::DontUseNativeDialog));
 
 	FileManager fm("Spectrum Analyzer");
 
 	ui->importSettings->clear();
 	import_data.clear();
+	import_ref.reset();
 
 	try {
-		fm.open(fileName, FileManager::IMPORT);
+		QStringList channelDetails;
 
-		for (int i = 0; i < fm.getNrOfChannels(); ++i) {
-			/* Amplitude CHX UNIT => mid(10, 3) strip CHX from column name */
-			ui->importSettings->addChannel(i, fm.getColumnName(i).mid(10, 3));
-		}
+		if (MappedReference::isMappedReference(fileName)) {
+			/* Read in place when a reference is added */
+			import_ref = std::make_shared<MappedReference>(fileName);
+
+			for (int i = 1; i < import_ref->columns(); ++i) {
+				ui->importSettings->addChannel(i - 1,
+					import_ref->columnName(i).mid(10, 3));
+			}
+		} else {
+			fm.open(fileName, FileManager::IMPORT);
+
+			for (int i = 0; i < fm.getNrOfChannels(); ++i) {
+				/* Amplitude CHX UNIT => mid(10, 3) strip CHX from column name */
+				ui->importSettings->addChannel(i, fm.getColumnName(i).mid(10, 3));
+			}
 
-		QVector<QVector<double>> data = fm.read();
-		for (int i = 0; i < data.size(); ++i) {
-			import_data.push_back(data[i]);
+			QVector<QVector<double>> data = fm.read();
+			for (int i = 0; i < data.size(); ++i) {
+				import_data.push_back(data[i]);
+			}
+
+			channelDetails = fm.getAdditionalInformation();
 		}
 
-		QStringList channelDetails = fm.getAdditionalInformation();
 		for (int i = 0; i < channelDetails.size() / 3; ++i) {
 			QStringList currentChannelDetails;
 			for (int j = 0; j < 3; ++j) {
@@ -902,6 +972,14 @@ void SpectrumAnalyzer::add_ref_waveform(unsigned int chIdx)
 	QVector<double> xData;
 	QVector<double> yData;
 
+	if (import_ref) {
+		/* Column 0 holds the frequencies */
+		for (size_t i = 0; i < import_ref->rows(); ++i) {
+			xData.push_back(import_ref->value(i, 0));
+			yData.push_back(import_ref->value(i, chIdx + 1));
+		}
+	}
+
 	for (int i = 0; i < import_data.size(); ++i) {
 		xData.push_back(import_data[i][0]);
 		yData.push_back(import_data[i][chIdx + 1]);
@@ -992,7 +1070,7 @@ void SpectrumAnalyzer::runStopToggled(bool checked)
 			writeAllSettingsToHardware();
 		}
 
-		fft_plot->presetSampleRate(sample_rate);
+		fft_plot->presetSampleRate(plotSampleRate());
 		fft_sink->set_samp_rate(sample_rate);
 		start_blockchain_flow();
 	} else {
@@ -1001,6 +1079,10 @@ void SpectrumAnalyzer::runStopToggled(bool checked)
 
 	if (!checked) {
 		fft_plot->resetAverageHistory();
+
+		if (cross_sink) {
+			cross_sink->reset();
+		}
 	}
 	m_running = checked;
 }
@@ -1045,16 +1127,15 @@ void SpectrumAnalyzer::build_gnuradio_block_chain()
 
 	for (int i = 0; i < num_adc_channels; i++) {
 		auto fft = gnuradio::get_initial_sptr(
-		                   new fft_block(false, fft_size));
-		auto ctm = gr::blocks::complex_to_mag_squared::make(1);
+		                   new fft_power_block(fft_size, fft_overlap,
+		                   fft_power_block::optimal_threads(fft_size,
+		                   num_adc_channels)));
 
-		// iio(i)->fft->ctm->fft_sink
+		// iio(i)->fft->fft_sink
 		fft_ids[i] = iio->connect(fft, i, 0, true, fft_size);
-		iio->connect(fft, 0, ctm, 0);
-		iio->connect(ctm, 0, fft_sink, i);
+		iio->connect(fft, 0, fft_sink, i);
 
 		channels[i]->fft_block = fft;
-		channels[i]->ctm_block = ctm;
 	}
 
 	if (started) {
@@ -1073,8 +1154,9 @@ void SpectrumAnalyzer::build_gnuradio_block_chain_no_ctx()
 
 	for (int i = 0; i < num_adc_channels; i++) {
 		auto fft = gnuradio::get_initial_sptr(
-		                   new fft_block(false, fft_size));
-		auto ctm = gr::blocks::complex_to_mag_squared::make(1);
+		                   new fft_power_block(fft_size, fft_overlap,
+		                   fft_power_block::optimal_threads(fft_size,
+		                   num_adc_channels)));
 
 		auto siggen = gr::analog::sig_source_f::make(100e6,
 		                gr::analog::GR_SIN_WAVE, 5e6 + i * 5e6, 2048);
@@ -1083,13 +1165,12 @@ void SpectrumAnalyzer::build_gnuradio_block_chain_no_ctx()
 		auto add = gr::blocks::add_ff::make();
 
 		//siggen->|
-		//        |->add->fft->ctm->fft_sink
+		//        |->add->fft->fft_sink
 		//noise-->|
 		top_block->connect(siggen, 0, add, 0);
 		top_block->connect(noise, 0, add, 1);
 		top_block->connect(add, 0, fft, 0);
-		top_block->connect(fft, 0, ctm, 0);
-		top_block->connect(ctm, 0, fft_sink, i);
+		top_block->connect(fft, 0, fft_sink, i);
 
 		channels[i]->fft_block = fft;
 	}
@@ -1547,6 +1628,198 @@ void SpectrumAnalyzer::setSampleRate(double sr)
 	sample_rate = new_sr;
 }
 
+void SpectrumAnalyzer::updateZoom()
+{
+	// Narrow spans around a carrier are shifted to DC and decimated
+	// before the FFT, so the FFT bins only cover the span of interest.
+	// A stepped sweep does the same on sweep_segments slices of the
+	// span, for bins sweep_segments times finer.
+	static const unsigned int max_zoom_decimation = 4096;
+
+	double span = startStopRange->getStopValue() -
+	              startStopRange->getStartValue();
+	// Without a context there is no iio_manager to rebuild the
+	// segment chains on
+	unsigned int segments = iio ? sweep_segments : 1;
+	unsigned int decim = 1;
+
+	if (span > 0) {
+		decim = (unsigned int)std::min<double>(max_zoom_decimation,
+		                                      sample_rate * segments / (4 * span));
+	}
+
+	// The zoom only pays off when it decimates
+	if (decim < 2) {
+		decim = 1;
+		segments = 1;
+	}
+
+	zoom_decimation = decim;
+
+	if (segments != active_segments) {
+		active_segments = segments;
+
+		if (iio) {
+			bool started = isIioManagerStarted();
+
+			if (started) {
+				iio->lock();
+			}
+
+			rebuildFftChains(started);
+
+			if (started) {
+				iio->unlock();
+			}
+
+			return;
+		}
+	}
+
+	applyZoom();
+}
+
+void SpectrumAnalyzer::applyZoom()
+{
+	double start = (zoom_decimation > 1) ?
+	               startStopRange->getStartValue() : 0;
+	// Each segment contributes the first quarter of its bins
+	double segment_width = fftSampleRate() / 4;
+
+	for (int i = 0; i < channels.size(); i++) {
+		if (channels[i]->fft_block) {
+			channels[i]->fft_block->set_zoom(sample_rate, start,
+			                                 zoom_decimation);
+		}
+
+		for (size_t k = 0; k < channels[i]->segment_blocks.size(); k++) {
+			channels[i]->segment_blocks[k]->set_zoom(sample_rate,
+			                start + (k + 1) * segment_width,
+			                zoom_decimation);
+		}
+	}
+
+	fft_plot->presetSampleRate(plotSampleRate());
+	fft_plot->presetStartFrequency(start);
+	fft_plot->resetAverageHistory();
+
+	if (cross_sink) {
+		cross_sink->reset();
+	}
+}
+
+double SpectrumAnalyzer::binFrequency(unsigned int bin) const
+{
+	double start = (zoom_decimation > 1) ?
+	               startStopRange->getStartValue() : 0;
+
+	return start + bin * fftSampleRate() / fft_size;
+}
+
+void SpectrumAnalyzer::setCrossSpectrum(bool en)
+{
+	if (en == cross_spectrum) {
+		return;
+	}
+
+	cross_spectrum = en;
+
+	if (!iio) {
+		return;
+	}
+
+	bool started = isIioManagerStarted();
+
+	if (started) {
+		iio->lock();
+	}
+
+	updateCrossSpectrum();
+
+	if (started) {
+		iio->unlock();
+	}
+}
+
+/* With the iio manager locked, if started */
+void SpectrumAnalyzer::updateCrossSpectrum()
+{
+	// The connections to FFT blocks that were since replaced went away
+	// with them
+	if (cross_sink) {
+		for (int i = 0; i < 2; i++) {
+			if (cross_sources[i] == channels[i]->fft_block) {
+				iio->disconnect(cross_sources[i], 1,
+				                cross_sink, i);
+			}
+
+			cross_sources[i].reset();
+		}
+
+		cross_sink.reset();
+	}
+
+	// Not over the stitched segments of a sweep, where no FFT block
+	// sees the whole band
+	if (!cross_spectrum || channels.size() < 2 || active_segments > 1) {
+		return;
+	}
+
+	cross_sink = gnuradio::get_initial_sptr(
+	                     new cross_spectrum_sink(fft_size));
+	cross_avg_history = 0;
+	updateCrossAveraging();
+
+	for (int i = 0; i < 2; i++) {
+		cross_sources[i] = channels[i]->fft_block;
+		iio->connect(cross_sources[i], 1, cross_sink, i);
+	}
+}
+
+/* The cross spectrum is averaged as the first channel is */
+void SpectrumAnalyzer::updateCrossAveraging()
+{
+	if (!cross_sink) {
+		return;
+	}
+
+	FftDisplayPlot::AverageType type = channels[0]->averageType();
+	uint history = (type == FftDisplayPlot::SAMPLE) ? 1 :
+	               channels[0]->averaging();
+
+	if (type == cross_avg_type && history == cross_avg_history) {
+		return;
+	}
+
+	cross_avg_type = type;
+	cross_avg_history = history;
+	cross_sink->set_averaging(type == FftDisplayPlot::EXPONENTIAL_RMS ||
+	                          type == FftDisplayPlot::EXPONENTIAL_DB,
+	                          history);
+}
+
+double SpectrumAnalyzer::fftSampleRate() const
+{
+	return sample_rate / zoom_decimation;
+}
+
+double SpectrumAnalyzer::plotSampleRate() const
+{
+	// The stitched frame holds active_segments quarters of the
+	// decimated band in its displayed half
+	if (active_segments > 1) {
+		return active_segments * fftSampleRate() / 2;
+	}
+
+	return fftSampleRate();
+}
+
+void SpectrumAnalyzer::setSweepSegments(unsigned int segments)
+{
+	sweep_segments = std::max(1u, std::min(segments, 16u));
+	updateZoom();
+}
+
 void SpectrumAnalyzer::setFftSize(uint size)
 {
 	// TO DO: This is cumbersome. We shouldn't have to rebuild the entire
@@ -1560,29 +1833,83 @@ void SpectrumAnalyzer::setFftSize(uint size)
 	}
 
 	fft_size = size;
-	fft_sink->set_nsamps(size);
+	rebuildFftChains(started);
+
+	if (started) {
+		iio->unlock();
+	}
+}
+
+void SpectrumAnalyzer::rebuildFftChains(bool started)
+{
+	// Stepped sweep: one zooming FFT per segment, all fed by the same
+	// capture, joined back into a single frame by the stitch block
+	unsigned int segments = active_segments;
+	uint frame_size = (segments > 1) ? segments * fft_size / 2 : fft_size;
+	uint threads = fft_power_block::optimal_threads(fft_size,
+	               channels.size() * segments);
+
+	fft_sink->set_nsamps(frame_size);
 
 	for (int i = 0; i < channels.size(); i++) {
 		auto fft = gnuradio::get_initial_sptr(
-		                   new fft_block(false, size));
+		                   new fft_power_block(fft_size, fft_overlap,
+		                                       threads));
 
 		iio->disconnect(fft_ids[i]);
-		fft_ids[i] = iio->connect(fft, i, 0, true, size);
-		iio->connect(fft, 0, channels[i]->ctm_block, 0);
-		iio->connect(channels[i]->ctm_block, 0, fft_sink, i);
+		fft_ids[i] = iio->connect(fft, i, 0, true, fft_size);
+
+		channels[i]->fft_block = fft;
+		channels[i]->segment_blocks.clear();
+
+		if (segments > 1) {
+			auto stitch = gnuradio::get_initial_sptr(
+			                      new fft_stitch_block(fft_size,
+			                                           segments));
+
+			iio->connect(fft, 0, stitch, 0);
+
+			for (unsigned int k = 1; k < segments; k++) {
+				auto seg = gnuradio::get_initial_sptr(
+				                   new fft_power_block(fft_size,
+				                                       fft_overlap, threads));
+
+				iio->connect(fft_ids[i], 0, seg, 0);
+				iio->connect(seg, 0, stitch, k);
+				channels[i]->segment_blocks.push_back(seg);
+			}
+
+			iio->connect(stitch, 0, fft_sink, i);
+		} else {
+			iio->connect(fft, 0, fft_sink, i);
+		}
 
 		if (started) {
 			iio->start(fft_ids[i]);
 		}
 
-		channels[i]->fft_block = fft;
-		channels[i]->setFftWindow(channels[i]->fftWindow(), size);
+		channels[i]->setFftWindow(channels[i]->fftWindow(), fft_size);
 
-		iio->set_buffer_size(fft_ids[i], size);
+		iio->set_buffer_size(fft_ids[i], fft_size);
 	}
 
-	if (started) {
-		iio->unlock();
+	updateCrossSpectrum();
+	applyZoom();
+}
+
+void SpectrumAnalyzer::setFftOverlap(double overlap)
+{
+	// Welch overlap between consecutive frames: 0, 50% or 75%
+	if (overlap != 0.5 && overlap != 0.75) {
+		overlap = 0.0;
+	}
+
+	fft_overlap = overlap;
+
+	for (int i = 0; i < channels.size(); i++) {
+		if (channels[i]->fft_block) {
+			channels[i]->fft_block->set_overlap(overlap);
+		}
 	}
 }
 
@@ -1801,6 +2128,13 @@ void SpectrumAnalyzer::singleCaptureDone()
 	}
 }
 
+void SpectrumAnalyzer::onDisplayedChanged(bool displayed)
+{
+	// The markers, the averages and the single captures go on with the
+	// spectra, only drawing them waits
+	fft_plot->setDisplaySuspended(!displayed);
+}
+
 void SpectrumAnalyzer::on_cmb_units_currentIndexChanged(const QString& unit)
 {
 	auto it = std::find_if(mag_types.begin(), mag_types.end(),
@@ -1846,7 +2180,7 @@ void SpectrumAnalyzer::on_btnMarkerTable_toggled(bool checked)
 	int row1 = getGridLayoutPosFromIndex(layout,
 	                                     layout->indexOf(ui->markerTable)).first;
 	int row2 = getGridLayoutPosFromIndex(layout,
-	                                     layout->indexOf(fft_plot)).first;
+	                                     layout->indexOf(fft_plot->parentWidget())).first;
 
 	if (checked) {
 		layout->setRowStretch(row1, 1);
@@ -1877,6 +2211,7 @@ void SpectrumAnalyzer::onTopValueChanged(double top)
 	double rangeValue = range->value();
 	fft_plot->setAxisScale(QwtPlot::yLeft, top - rangeValue, top);
 	fft_plot->replot();
+	waterfall->setMagnitudeRange(top - rangeValue, top);
 }
 
 void SpectrumAnalyzer::onRangeValueChanged(double range)
@@ -1884,6 +2219,41 @@ void SpectrumAnalyzer::onRangeValueChanged(double range)
 	double topValue = top->value();
 	fft_plot->setAxisScale(QwtPlot::yLeft, topValue - range, topValue);
 	fft_plot->replot();
+	waterfall->setMagnitudeRange(topValue - range, topValue);
+}
+
+void SpectrumAnalyzer::setWaterfallEnabled(bool en)
+{
+	if (en) {
+		waterfall->clear();
+	}
+
+	waterfall->setVisible(en);
+}
+
+void SpectrumAnalyzer::updateWaterfall()
+{
+	if (!waterfall->isVisible()) {
+		return;
+	}
+
+	const double *data = fft_plot->channelData(crt_channel_id);
+	int64_t num_points = fft_plot->numPoints();
+
+	if (!data || !num_points) {
+		return;
+	}
+
+	// Only the visible span, so the columns line up with the plot
+	int64_t first = fft_plot->posAtFrequency(
+	                        startStopRange->getStartValue(), crt_channel_id);
+	int64_t last = fft_plot->posAtFrequency(
+	                       startStopRange->getStopValue(), crt_channel_id);
+
+	first = std::max<int64_t>(0, std::min(first, num_points - 1));
+	last = std::max(first + 1, std::min(last, num_points));
+
+	waterfall->addRow(data + first, last - first);
 }
 
 /*
@@ -1962,11 +2332,55 @@ void SpectrumChannel::setAverageType(FftDisplayPlot::AverageType avg_type)
 void SpectrumChannel::setFftWindow(SpectrumAnalyzer::FftWinType win, int taps)
 {
 	m_fft_win = win;
+	m_fft_win_info = windowInfo(win, taps);
+	fft_block->set_window(m_fft_win_info->window);
+
+	for (auto& block : segment_blocks) {
+		block->set_window(m_fft_win_info->window);
+	}
+}
+
+float SpectrumChannel::fftWindowEnbw() const
+{
+	return m_fft_win_info ? m_fft_win_info->enbw : 1.0f;
+}
+
+SpectrumChannel::fft_window_sptr
+SpectrumChannel::windowInfo(SpectrumAnalyzer::FftWinType type, int ntaps)
+{
+	// A handful of types times the RBW sizes; bounded anyway in case
+	// scripts go through many sizes
+	static const size_t max_cached = 64;
+	static std::mutex mutex;
+	static std::map<std::pair<int, int>, fft_window_sptr> cache;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto key = std::make_pair((int)type, ntaps);
+	auto it = cache.find(key);
+
+	if (it != cache.end()) {
+		return it->second;
+	}
+
+	auto info = std::make_shared<FftWindowInfo>();
+	info->window = build_win(type, ntaps);
+
+	double sum = 0, sqr_sum = 0;
+	for (float w : info->window) {
+		sum += w;
+		sqr_sum += w * w;
+	}
+
+	info->coherent_gain = calcCoherentPowerGain(info->window);
+	info->enbw = (sum != 0) ? ntaps * sqr_sum / (sum * sum) : 1.0f;
+	scaletFftWindow(info->window, 1 / info->coherent_gain);
+
+	if (cache.size() >= max_cached) {
+		cache.clear();
+	}
+	cache[key] = info;
 
-	std::vector<float> window = build_win(win, taps);
-	float gain = calcCoherentPowerGain(window);
-	scaletFftWindow(window, 1 / gain);
-	fft_block->set_window(window);
+	return info;
 }
 
 SpectrumAnalyzer::FftWinType SpectrumChannel::fftWindow() const
@@ -2006,7 +2420,7 @@ std::vector<float> SpectrumChannel::build_win(SpectrumAnalyzer::FftWinType type,
 }
 
 float
-SpectrumChannel::calcCoherentPowerGain(const std::vector<float>& win) const
+SpectrumChannel::calcCoherentPowerGain(const std::vector<float>& win)
 {
 	float sum = 0;
 
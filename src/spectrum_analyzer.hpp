@@ -23,12 +23,12 @@
 
 #include <gnuradio/top_block.h>
 #include <gnuradio/fft/window.h>
-#include <gnuradio/blocks/complex_to_mag_squared.h>
 
 #include "apiObject.hpp"
 #include "iio_manager.hpp"
 #include "scope_sink_f.h"
-#include "fft_block.hpp"
+#include "fft_power_block.hpp"
+#include "cross_spectrum_sink.hpp"
 #include "FftDisplayPlot.h"
 #include "osc_adc.h"
 #include "tool.hpp"
@@ -36,10 +36,13 @@
 #include "spinbox_a.hpp"
 #include "customPushButton.hpp"
 #include "startstoprangewidget.h"
+#include "mapped_reference.hpp"
 
 #include <QWidget>
 #include <QQueue>
 
+#include <memory>
+
 extern "C" {
 	struct iio_buffer;
 	struct iio_channel;
@@ -56,9 +59,11 @@ class SpectrumChannel;
 class Filter;
 class ChannelWidget;
 class DbClickButtons;
+class WaterfallDisplay;
 }
 
 class QPushButton;
+class QCheckBox;
 class QButtonGroup;
 class QGridLayout;
 
@@ -133,6 +138,7 @@ private Q_SLOTS:
 	void onPlotSampleRateUpdated(double);
 	void onPlotSampleCountUpdated(uint);
 	void singleCaptureDone();
+	void onDisplayedChanged(bool displayed);
 	void on_btnMarkerTable_toggled(bool checked);
 	void onTopValueChanged(double);
 	void onRangeValueChanged(double);
@@ -143,6 +149,8 @@ private Q_SLOTS:
 	void on_btnBrowseFile_clicked();
 	void on_btnImport_clicked();
 	void onReferenceChannelDeleted();
+	void setWaterfallEnabled(bool);
+	void updateWaterfall();
 
 private:
 	void build_gnuradio_block_chain();
@@ -153,6 +161,17 @@ private:
 	int channelIdOfOpenedSettings() const;
 	void setSampleRate(double sr);
 	void setFftSize(uint size);
+	void setFftOverlap(double overlap);
+	void updateZoom();
+	void applyZoom();
+	void rebuildFftChains(bool started);
+	double fftSampleRate() const;
+	double plotSampleRate() const;
+	void setSweepSegments(unsigned int segments);
+	void setCrossSpectrum(bool en);
+	void updateCrossSpectrum();
+	void updateCrossAveraging();
+	double binFrequency(unsigned int bin) const;
 	void setMarkerEnabled(int ch_idx, int mrk_idx, bool en);
 	void updateWidgetsRelatedToMarker(int mrk_idx);
 	void setCurrentMarkerLabelData(int chIdx, int mkIdx);
@@ -173,6 +192,8 @@ private:
 	QList<CustomPushButton *> menuOrder;
 
 	QVector<QVector<double>> import_data;
+	/* Set instead of import_data for binary references */
+	std::shared_ptr<MappedReference> import_ref;
 	unsigned int nb_ref_channels;
 	QVector<ChannelWidget *> referenceChannels;
 	unsigned int selected_ch_settings;
@@ -185,6 +206,8 @@ private:
 	QButtonGroup *settings_group;
 	QButtonGroup *channels_group;
 	FftDisplayPlot *fft_plot;
+	adiscope::WaterfallDisplay *waterfall;
+	QCheckBox *waterfall_box;
 
 	PositionSpinButton *range;
 	PositionSpinButton *top;
@@ -209,7 +232,19 @@ private:
 	double sample_rate;
 	int sample_rate_divider;
 	uint fft_size;
+	double fft_overlap;
+	unsigned int zoom_decimation;
+	unsigned int sweep_segments;
+	unsigned int active_segments;
 	QList<uint> bin_sizes;
+
+	/* Cross spectrum of the first two channels, from the complex bins
+	 * of their FFT blocks; connected to cross_sources */
+	bool cross_spectrum;
+	adiscope::cross_spectrum_sink::sptr cross_sink;
+	boost::shared_ptr<adiscope::fft_power_block> cross_sources[2];
+	FftDisplayPlot::AverageType cross_avg_type;
+	uint cross_avg_history;
 	MetricPrefixFormatter freq_formatter;
 
 	gr::top_block_sptr top_block;
@@ -236,8 +271,9 @@ class SpectrumChannel: public QObject
 	friend class SpectrumChannel_API;
 
 public:
-	boost::shared_ptr<adiscope::fft_block> fft_block;
-	gr::blocks::complex_to_mag_squared::sptr ctm_block;
+	boost::shared_ptr<adiscope::fft_power_block> fft_block;
+	// Segments after the first one in a stepped sweep
+	std::vector<boost::shared_ptr<adiscope::fft_power_block>> segment_blocks;
 
 	SpectrumChannel(int id, const QString& name, FftDisplayPlot *plot);
 
@@ -272,7 +308,22 @@ public:
 	SpectrumAnalyzer::FftWinType fftWindow() const;
 	void setFftWindow(SpectrumAnalyzer::FftWinType win, int taps);
 
+	// Equivalent noise bandwidth of the window, in bins
+	float fftWindowEnbw() const;
+
 private:
+	// A window already scaled to unity coherent gain, shared by all
+	// the channels using the same type and size
+	struct FftWindowInfo {
+		std::vector<float> window;
+		float coherent_gain;
+		float enbw;
+	};
+	typedef std::shared_ptr<const FftWindowInfo> fft_window_sptr;
+
+	static fft_window_sptr windowInfo(SpectrumAnalyzer::FftWinType type,
+	                                  int ntaps);
+
 	int m_id;
 	QString m_name;
 	float m_line_width;
@@ -280,11 +331,12 @@ private:
 	uint m_averaging;
 	FftDisplayPlot::AverageType m_avg_type;
 	SpectrumAnalyzer::FftWinType m_fft_win;
+	fft_window_sptr m_fft_win_info;
 	FftDisplayPlot *m_plot;
 	ChannelWidget *m_widget;
 
-	float calcCoherentPowerGain(const std::vector<float>& win) const;
-	void scaletFftWindow(std::vector<float>& win, float gain);
+	static float calcCoherentPowerGain(const std::vector<float>& win);
+	static void scaletFftWindow(std::vector<float>& win, float gain);
 
 	static std::vector<float> build_win(SpectrumAnalyzer::FftWinType type,
 	                                    int ntaps);
@@ -21,6 +21,9 @@
 #include "ui_spectrum_analyzer.h"
 #include "channel_widget.hpp"
 #include "db_click_buttons.hpp"
+#include "waterfall_display.h"
+
+#include <QCheckBox>
 
 namespace adiscope {
 int SpectrumChannel_API::type()
@@ -33,6 +36,11 @@ int SpectrumChannel_API::window()
 	return spch->fftWindow();
 }
 
+double SpectrumChannel_API::enbw()
+{
+	return spch->fftWindowEnbw();
+}
+
 int SpectrumChannel_API::averaging()
 {
 	return spch->averaging();
@@ -85,6 +93,39 @@ QList<double> SpectrumChannel_API::freq() const
 	return frequency_data;
 }
 
+QByteArray SpectrumChannel_API::dataBuffer(qint64 offset, qint64 length) const
+{
+	QByteArray buffer;
+	int i = sp->ch_api.indexOf(const_cast<SpectrumChannel_API*>(this));
+	if (i < 0 || !dataWindow(sp->fft_plot->Curve(0)->data()->size(),
+				 offset, length))
+		return buffer;
+
+	buffer.resize(length * sizeof(float));
+	float *samples = reinterpret_cast<float *>(buffer.data());
+	auto curve = sp->fft_plot->Curve(i);
+	for (qint64 j = 0; j < length; ++j) {
+		samples[j] = curve->sample(offset + j).y();
+	}
+	return buffer;
+}
+
+QByteArray SpectrumChannel_API::freqBuffer(qint64 offset, qint64 length) const
+{
+	QByteArray buffer;
+	auto curve = sp->fft_plot->Curve(0);
+	if (!dataWindow(curve->data()->size(), offset, length))
+		return buffer;
+
+	/* Doubles, the frequencies need more than a float's precision */
+	buffer.resize(length * sizeof(double));
+	double *frequency_data = reinterpret_cast<double *>(buffer.data());
+	for (qint64 i = 0; i < length; ++i) {
+		frequency_data[i] = curve->sample(offset + i).x();
+	}
+	return buffer;
+}
+
 int SpectrumMarker_API::chId()
 {
 	return m_chid;
@@ -204,6 +245,18 @@ void SpectrumAnalyzer_API::show()
 	Q_EMIT sp->showTool();
 }
 
+void SpectrumAnalyzer_API::beginLoad()
+{
+	if (sp->iio)
+		sp->iio->hold();
+}
+
+void SpectrumAnalyzer_API::endLoad()
+{
+	if (sp->iio)
+		sp->iio->release();
+}
+
 QVariantList SpectrumAnalyzer_API::getMarkers()
 {
 	QVariantList list;
@@ -235,6 +288,36 @@ void SpectrumAnalyzer_API::single(bool chk)
 	sp->ui->runSingleWidget->single();
 }
 
+QVariantList SpectrumAnalyzer_API::getAcquisitionStats() const
+{
+	QVariantList list;
+
+	if (!sp->iio || !sp->fft_ids) {
+		return list;
+	}
+
+	for (int i = 0; i < sp->num_adc_channels; i++) {
+		list.append(sp->iio->get_port_stats(
+				sp->fft_ids[i]).toVariantMap());
+	}
+
+	return list;
+}
+
+QVariantMap SpectrumAnalyzer_API::getFrameCounters() const
+{
+	QVariantMap map;
+
+	if (!sp->fft_sink) {
+		return map;
+	}
+
+	map["acquired"] = (qulonglong)sp->fft_sink->frames_acquired();
+	map["posted"] = (qulonglong)sp->fft_sink->frames_posted();
+
+	return map;
+}
+
 QVariantList SpectrumAnalyzer_API::getChannels()
 {
 	QVariantList list;
@@ -285,6 +368,72 @@ void SpectrumAnalyzer_API::setResBW(QString s)
 	sp->ui->cmb_rbw->setCurrentText(s);
 }
 
+double SpectrumAnalyzer_API::fftOverlap()
+{
+	return sp->fft_overlap;
+}
+
+void SpectrumAnalyzer_API::setFftOverlap(double overlap)
+{
+	sp->setFftOverlap(overlap);
+}
+
+int SpectrumAnalyzer_API::sweepSegments()
+{
+	return sp->sweep_segments;
+}
+
+void SpectrumAnalyzer_API::setSweepSegments(int segments)
+{
+	sp->setSweepSegments(qMax(1, segments));
+}
+
+bool SpectrumAnalyzer_API::crossSpectrum() const
+{
+	return sp->cross_spectrum;
+}
+
+void SpectrumAnalyzer_API::setCrossSpectrum(bool en)
+{
+	sp->setCrossSpectrum(en);
+}
+
+/* Per bin of the displayed half: the frequency, the cross power of the
+ * first two channels, unscaled, their coherence and the phase of the
+ * second relative to the first in degrees; empty without a frame */
+QVariantMap SpectrumAnalyzer_API::getCrossSpectrumData() const
+{
+	QVariantMap map;
+
+	if (!sp->cross_sink) {
+		return map;
+	}
+
+	sp->updateCrossAveraging();
+
+	std::vector<double> cross_power, coherence, phase;
+	if (!sp->cross_sink->result(cross_power, coherence, phase)) {
+		return map;
+	}
+
+	QVariantList freq, power, coh, ph;
+
+	for (size_t k = 0; k < cross_power.size(); k++) {
+		freq.append(sp->binFrequency(k));
+		power.append(cross_power[k]);
+		coh.append(coherence[k]);
+		ph.append(phase[k]);
+	}
+
+	map["frequency"] = freq;
+	map["cross_power"] = power;
+	map["coherence"] = coh;
+	map["phase"] = ph;
+	map["frames"] = sp->cross_sink->frames();
+
+	return map;
+}
+
 
 QString SpectrumAnalyzer_API::units()
 {
@@ -333,4 +482,24 @@ void SpectrumAnalyzer_API::setLogScale(bool useLogScale)
 {
 	sp->ui->logBtn->setChecked(useLogScale);
 }
+
+bool SpectrumAnalyzer_API::waterfall() const
+{
+	return sp->waterfall_box->isChecked();
+}
+
+void SpectrumAnalyzer_API::setWaterfall(bool en)
+{
+	sp->waterfall_box->setChecked(en);
+}
+
+int SpectrumAnalyzer_API::waterfallHistory() const
+{
+	return sp->waterfall->history();
+}
+
+void SpectrumAnalyzer_API::setWaterfallHistory(int rows)
+{
+	sp->waterfall->setHistory(qMax(1, rows));
+}
 }
@@ -33,6 +33,11 @@ class SpectrumAnalyzer_API : public ApiObject
 	Q_PROPERTY(double stopFreq  READ stopFreq  WRITE setStopFreq);
 	Q_PROPERTY(QString units READ units WRITE setUnits);
 	Q_PROPERTY(QString resBW READ resBW WRITE setResBW);
+	Q_PROPERTY(double fftOverlap READ fftOverlap WRITE setFftOverlap);
+	Q_PROPERTY(int sweepSegments READ sweepSegments WRITE setSweepSegments);
+	Q_PROPERTY(bool crossSpectrum READ crossSpectrum WRITE setCrossSpectrum);
+	Q_PROPERTY(QVariantMap crossSpectrumData READ getCrossSpectrumData
+		   STORED false)
 	Q_PROPERTY(double topScale READ topScale WRITE setTopScale);
 	Q_PROPERTY(double range READ range WRITE setRange);
 	Q_PROPERTY(QVariantList channels READ getChannels);
@@ -41,12 +46,23 @@ class SpectrumAnalyzer_API : public ApiObject
 	           setMarkerTableVisible);
 	Q_PROPERTY(QVariantList markers READ getMarkers);
 	Q_PROPERTY(bool logScale READ getLogScale WRITE setLogScale)
+	Q_PROPERTY(bool waterfall READ waterfall WRITE setWaterfall)
+	Q_PROPERTY(int waterfallHistory READ waterfallHistory
+		   WRITE setWaterfallHistory)
+	Q_PROPERTY(QVariantList acquisitionStats READ getAcquisitionStats
+		   STORED false)
+	Q_PROPERTY(QVariantMap frameCounters READ getFrameCounters
+		   STORED false)
 public:
 	Q_INVOKABLE void show();
 	explicit SpectrumAnalyzer_API(SpectrumAnalyzer *sp) :
 		ApiObject(), sp(sp) {}
 	~SpectrumAnalyzer_API() {}
 
+protected:
+	void beginLoad() override;
+	void endLoad() override;
+
 private:
 	SpectrumAnalyzer *sp;
 	bool running();
@@ -73,6 +89,16 @@ private:
 	QString resBW();
 	void setResBW(QString);
 
+	double fftOverlap();
+	void setFftOverlap(double);
+
+	int sweepSegments();
+	void setSweepSegments(int);
+
+	bool crossSpectrum() const;
+	void setCrossSpectrum(bool en);
+	QVariantMap getCrossSpectrumData() const;
+
 	double topScale();
 	void setTopScale(double);
 
@@ -85,6 +111,15 @@ private:
 	bool getLogScale() const;
 	void setLogScale(bool useLogScale);
 
+	bool waterfall() const;
+	void setWaterfall(bool en);
+
+	int waterfallHistory() const;
+	void setWaterfallHistory(int rows);
+
+	QVariantList getAcquisitionStats() const;
+	QVariantMap getFrameCounters() const;
+
 };
 
 class SpectrumChannel_API : public ApiObject
@@ -93,6 +128,7 @@ class SpectrumChannel_API : public ApiObject
 	Q_PROPERTY(bool enabled READ enabled WRITE enable);
 	Q_PROPERTY(int type READ type WRITE setType);
 	Q_PROPERTY(int window READ window WRITE setWindow);
+	Q_PROPERTY(double enbw READ enbw STORED false);
 	Q_PROPERTY(int averaging READ averaging WRITE setAveraging);
 	Q_PROPERTY(QList<double> data READ data STORED false)
 	Q_PROPERTY(QList<double> freq READ freq STORED false)
@@ -106,6 +142,7 @@ public:
 	bool enabled();
 	int type();
 	int window();
+	double enbw();
 	int averaging();
 
 	void enable(bool);
@@ -116,6 +153,13 @@ public:
 	QList<double> data() const;
 	QList<double> freq() const;
 
+	/* The same data as the ArrayBuffer of a Float32Array, and the
+	 * frequencies as the one of a Float64Array */
+	Q_INVOKABLE QByteArray dataBuffer(qint64 offset = 0,
+			qint64 length = -1) const;
+	Q_INVOKABLE QByteArray freqBuffer(qint64 offset = 0,
+			qint64 length = -1) const;
+
 private:
 	SpectrumAnalyzer *sp;
 	boost::shared_ptr<SpectrumChannel> spch;
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "startup_trace.hpp"
+#include "logging_categories.h"
+
+#include <QDebug>
+
+using namespace adiscope;
+
+QElapsedTimer StartupTrace::timer;
+qint64 StartupTrace::last = 0;
+
+void StartupTrace::phase(const char *name)
+{
+	/* The first phase starts the clock */
+	if (!timer.isValid()) {
+		timer.start();
+		qDebug(CAT_STARTUP) << name;
+		return;
+	}
+
+	qint64 now = timer.elapsed();
+
+	qDebug(CAT_STARTUP) << name << "done at" << now << "ms, took"
+			    << (now - last) << "ms";
+	last = now;
+}
@@ -18,39 +18,27 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef CUSTOM_FIFO_HPP
-#define CUSTOM_FIFO_HPP
+#ifndef STARTUP_TRACE_HPP
+#define STARTUP_TRACE_HPP
 
-#include <QQueue>
-#include <QVector>
+#include <QElapsedTimer>
 
 namespace adiscope {
-	template <typename T>
-	class CustomFifo
-	{
-	public:
-		explicit CustomFifo();
-		~CustomFifo();
 
-		void push(T& data);
-		T& pop();
-
-		void reserve(int size);
-		int size() const;
-		void clear();
-
-		T *data();
-
-	private:
-#if HAS_CONSTEXPR
-		static constexpr bool useQQueue = sizeof(T) <= sizeof(void *);
-#else
-		static const bool useQQueue = false;
-#endif
-
-		QQueue<T> *queue;
-		QVector<T> *vector;
-	};
+/*
+ * Logs the end of each startup phase in the "startup" category, with
+ * the time since main() started and the time the phase itself took.
+ * Shown with QT_LOGGING_RULES="startup.debug=true".
+ */
+class StartupTrace
+{
+public:
+	static void phase(const char *name);
+
+private:
+	static QElapsedTimer timer;
+	static qint64 last;
+};
 }
 
-#endif
+#endif /* STARTUP_TRACE_HPP */
@@ -212,6 +212,7 @@ void StatisticWidget::initForMeasurement(const MeasurementData &data)
 	m_ui->label_avg->setMinimumWidth(m_valueLabelWidth);
 	m_ui->label_min->setMinimumWidth(m_valueLabelWidth);
 	m_ui->label_max->setMinimumWidth(m_valueLabelWidth);
+	m_ui->label_dev->setMinimumWidth(m_valueLabelWidth);
 
 	delete label;
 }
@@ -221,18 +222,37 @@ void StatisticWidget::updateStatistics(const Statistic& data)
 	QString avg_text;
 	QString min_text;
 	QString max_text;
+	QString dev_text;
+	QString tooltip;
 
 	if (data.numPushedData() == 0) {
 		avg_text = "--";
 		min_text = "--";
 		max_text = "--";
+		dev_text = "--";
 	} else {
 		avg_text = m_formatter->format(data.average());
 		min_text = m_formatter->format(data.min());
 		max_text = m_formatter->format(data.max());
+		dev_text = m_formatter->format(data.stdDev());
+
+		tooltip = QString("Count: %1\n"
+			"P5: %2\nMedian: %3\nP95: %4\n"
+			"Last %5: avg %6, dev %7, min %8, max %9")
+			.arg(data.numPushedData())
+			.arg(m_formatter->format(data.percentile(5)))
+			.arg(m_formatter->format(data.percentile(50)))
+			.arg(m_formatter->format(data.percentile(95)))
+			.arg(data.windowCount())
+			.arg(m_formatter->format(data.windowAverage()))
+			.arg(m_formatter->format(data.windowStdDev()))
+			.arg(m_formatter->format(data.windowMin()))
+			.arg(m_formatter->format(data.windowMax()));
 	}
 
 	m_ui->label_avg->setText(avg_text);
 	m_ui->label_min->setText(min_text);
 	m_ui->label_max->setText(max_text);
+	m_ui->label_dev->setText(dev_text);
+	setToolTip(tooltip);
 }
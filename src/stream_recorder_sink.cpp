@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gnuradio/io_signature.h>
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <fcntl.h>
+#endif
+
+#include "stream_recorder_sink.hpp"
+#include "pipeline_trace.hpp"
+
+using namespace adiscope;
+using namespace gr;
+
+stream_recorder_sink::stream_recorder_sink(unsigned int nb_channels,
+		size_t ring_bytes)
+	: sync_block("stream_recorder_sink",
+			io_signature::make(nb_channels, nb_channels,
+				sizeof(int16_t)),
+			io_signature::make(0, 0, 0)),
+	d_nb_channels(std::max(1u, nb_channels)),
+	d_ring_samples(block_bytes / sizeof(int16_t) * 4),
+	d_head(0),
+	d_tail(0),
+	d_direct(false),
+	d_open(false),
+	d_stopping(false),
+	d_failed(false),
+	d_frames(0),
+	d_written(0),
+	d_dropped(0)
+{
+	/* A power of two, so the indexes are masked, of whole blocks, so
+	 * a block never wraps around */
+	while (d_ring_samples * 2 * sizeof(int16_t) <= ring_bytes) {
+		d_ring_samples *= 2;
+	}
+
+	const size_t page = 4096 / sizeof(int16_t);
+	d_storage.resize(d_ring_samples + page);
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(d_storage.data());
+	d_ring = reinterpret_cast<int16_t *>((base + 4095) & ~(uintptr_t)4095);
+}
+
+stream_recorder_sink::~stream_recorder_sink()
+{
+	close();
+}
+
+bool stream_recorder_sink::open(const QString &filename)
+{
+	close();
+
+	d_file.setFileName(filename);
+	if (!d_file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+			 QIODevice::Unbuffered)) {
+		return false;
+	}
+
+	set_direct(true);
+
+	{
+		std::lock_guard<std::mutex> lock(d_drops_mutex);
+		d_drops.clear();
+	}
+
+	d_written = 0;
+	d_dropped = 0;
+	d_failed = false;
+	d_stopping = false;
+
+	std::lock_guard<std::mutex> lock(d_work_mutex);
+
+	/* From the start of the ring, so the blocks stay aligned */
+	d_head = 0;
+	d_tail = 0;
+	d_frames = 0;
+
+	d_thread = std::thread(&stream_recorder_sink::run, this);
+	d_open = true;
+
+	return true;
+}
+
+void stream_recorder_sink::close()
+{
+	{
+		std::lock_guard<std::mutex> lock(d_work_mutex);
+		d_open = false;
+	}
+
+	if (!d_thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(d_mutex);
+		d_stopping = true;
+	}
+	d_wake.notify_one();
+	d_thread.join();
+
+	d_file.close();
+}
+
+bool stream_recorder_sink::is_open() const
+{
+	return d_open;
+}
+
+unsigned int stream_recorder_sink::nb_channels() const
+{
+	return d_nb_channels;
+}
+
+uint64_t stream_recorder_sink::frames_written() const
+{
+	return d_written;
+}
+
+uint64_t stream_recorder_sink::frames_dropped() const
+{
+	return d_dropped;
+}
+
+std::vector<stream_recorder_sink::drop> stream_recorder_sink::drops() const
+{
+	std::lock_guard<std::mutex> lock(d_drops_mutex);
+
+	return d_drops;
+}
+
+bool stream_recorder_sink::failed() const
+{
+	return d_failed;
+}
+
+void stream_recorder_sink::set_direct(bool direct)
+{
+#ifdef __linux__
+	int fd = d_file.handle();
+	int flags = fcntl(fd, F_GETFL);
+
+	if (flags != -1 && fcntl(fd, F_SETFL, direct ? flags | O_DIRECT :
+				 flags & ~O_DIRECT) == 0) {
+		d_direct = direct;
+		return;
+	}
+#endif
+	d_direct = false;
+}
+
+bool stream_recorder_sink::write_block(const int16_t *data, size_t bytes)
+{
+	const char *ptr = reinterpret_cast<const char *>(data);
+
+	if (d_file.write(ptr, bytes) == (qint64)bytes) {
+		return true;
+	}
+
+	/* Some file systems take the flag but refuse the writes */
+	if (d_direct) {
+		set_direct(false);
+		return d_file.write(ptr, bytes) == (qint64)bytes;
+	}
+
+	return false;
+}
+
+void stream_recorder_sink::run()
+{
+	const uint64_t block = block_bytes / sizeof(int16_t);
+	const uint64_t mask = d_ring_samples - 1;
+	std::unique_lock<std::mutex> lock(d_mutex);
+	uint64_t written = 0;
+
+	for (;;) {
+		uint64_t tail = d_tail.load(std::memory_order_relaxed);
+		uint64_t head = d_head.load(std::memory_order_acquire);
+
+		if (head - tail < block) {
+			if (d_stopping) {
+				break;
+			}
+			d_wake.wait_for(lock, std::chrono::milliseconds(100));
+			continue;
+		}
+
+		lock.unlock();
+		bool ok = write_block(&d_ring[tail & mask], block_bytes);
+		lock.lock();
+
+		if (!ok) {
+			d_failed = true;
+			d_open = false;
+			return;
+		}
+
+		d_tail.store(tail + block, std::memory_order_release);
+		written += block;
+		d_written = written / d_nb_channels;
+	}
+
+	/* The last block is short, which the direct writes can't do */
+	uint64_t tail = d_tail.load(std::memory_order_relaxed);
+	uint64_t head = d_head.load(std::memory_order_acquire);
+
+	if (head != tail) {
+		set_direct(false);
+		if (!write_block(&d_ring[tail & mask],
+				(head - tail) * sizeof(int16_t))) {
+			d_failed = true;
+			return;
+		}
+		d_tail.store(head, std::memory_order_release);
+		d_written = head / d_nb_channels;
+	}
+}
+
+int stream_recorder_sink::work(int noutput_items,
+		gr_vector_const_void_star &input_items,
+		gr_vector_void_star &output_items)
+{
+	PIPELINE_TRACE("stream_recorder_sink work");
+
+	std::lock_guard<std::mutex> lock(d_work_mutex);
+
+	if (!d_open) {
+		return noutput_items;
+	}
+
+	const uint64_t mask = d_ring_samples - 1;
+	uint64_t head = d_head.load(std::memory_order_relaxed);
+	uint64_t tail = d_tail.load(std::memory_order_acquire);
+	size_t room = (d_ring_samples - (head - tail)) / d_nb_channels;
+	size_t frames = std::min<size_t>(room, noutput_items);
+
+	for (unsigned int ch = 0; ch < d_nb_channels; ch++) {
+		const int16_t *in = static_cast<const int16_t *>(
+				input_items[ch]);
+		uint64_t pos = head + ch;
+
+		for (size_t i = 0; i < frames; i++, pos += d_nb_channels) {
+			d_ring[pos & mask] = in[i];
+		}
+	}
+
+	d_head.store(head + frames * d_nb_channels,
+			std::memory_order_release);
+
+	/* Consecutive drops make a single run */
+	if (frames < (size_t)noutput_items) {
+		uint64_t first = d_frames + frames;
+		uint64_t count = noutput_items - frames;
+		std::lock_guard<std::mutex> drops_lock(d_drops_mutex);
+
+		if (!d_drops.empty() && d_drops.back().first +
+				d_drops.back().second == first) {
+			d_drops.back().second += count;
+		} else if (d_drops.size() < max_drops) {
+			d_drops.push_back(drop(first, count));
+		}
+		d_dropped += count;
+	}
+
+	d_frames += noutput_items;
+
+	if ((head - tail) + frames * d_nb_channels >=
+			block_bytes / sizeof(int16_t)) {
+		d_wake.notify_one();
+	}
+
+	return noutput_items;
+}
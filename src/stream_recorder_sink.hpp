@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STREAM_RECORDER_SINK_HPP
+#define STREAM_RECORDER_SINK_HPP
+
+#include <gnuradio/sync_block.h>
+
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace adiscope {
+	/*
+	 * Records the raw int16 samples of its inputs to a file,
+	 * interleaved, one frame of nb_channels samples after the other.
+	 *
+	 * work() only copies the samples into a ring and never blocks: the
+	 * flowgraph keeps running at the acquisition rate and a full ring
+	 * drops the frames, which are counted and logged by position. A
+	 * writer thread empties the ring in large blocks aligned in memory
+	 * and in the file, with the page cache bypassed where the system
+	 * allows it (O_DIRECT on Linux), so minutes at several MSPS do not
+	 * evict everything else from memory.
+	 */
+	class stream_recorder_sink : public gr::sync_block
+	{
+	public:
+		typedef boost::shared_ptr<stream_recorder_sink> sptr;
+
+		/* First frame of a run of dropped ones, and its length */
+		typedef std::pair<uint64_t, uint64_t> drop;
+
+		stream_recorder_sink(unsigned int nb_channels,
+				size_t ring_bytes = 64 * 1024 * 1024);
+		~stream_recorder_sink();
+
+		/* Creates the file and starts the writer, the samples
+		 * received until then are ignored */
+		bool open(const QString &filename);
+		/* Writes what is left in the ring and closes the file */
+		void close();
+		bool is_open() const;
+
+		unsigned int nb_channels() const;
+		/* Since open() */
+		uint64_t frames_written() const;
+		uint64_t frames_dropped() const;
+		std::vector<drop> drops() const;
+		/* The file could not be written, the recording stopped */
+		bool failed() const;
+
+		int work(int noutput_items,
+				gr_vector_const_void_star &input_items,
+				gr_vector_void_star &output_items);
+
+	private:
+		static const size_t block_bytes = 1024 * 1024;
+		static const size_t max_drops = 1024;
+
+		void run();
+		bool write_block(const int16_t *data, size_t bytes);
+		void set_direct(bool direct);
+
+		unsigned int d_nb_channels;
+		size_t d_ring_samples;
+		std::vector<int16_t> d_storage;
+		/* Page aligned start of d_storage */
+		int16_t *d_ring;
+		/* Held by work(), so open() and close() never race it */
+		std::mutex d_work_mutex;
+		std::atomic<uint64_t> d_head;
+		std::atomic<uint64_t> d_tail;
+
+		QFile d_file;
+		bool d_direct;
+		std::thread d_thread;
+		std::atomic<bool> d_open;
+		std::atomic<bool> d_stopping;
+		std::atomic<bool> d_failed;
+		std::mutex d_mutex;
+		std::condition_variable d_wake;
+
+		uint64_t d_frames;
+		std::atomic<uint64_t> d_written;
+		std::atomic<uint64_t> d_dropped;
+		mutable std::mutex d_drops_mutex;
+		std::vector<drop> d_drops;
+	};
+}
+
+#endif /* STREAM_RECORDER_SINK_HPP */
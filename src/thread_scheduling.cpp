@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "thread_scheduling.hpp"
+#include "logging_categories.h"
+
+#include <algorithm>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+using namespace adiscope;
+
+/* Above the lowest real-time priority, well below the kernel threads
+ * that serve the USB and network interrupts */
+static const int realtime_priority_offset = 10;
+
+ThreadScheduling::ThreadScheduling() :
+	rt(false)
+{
+}
+
+ThreadScheduling& ThreadScheduling::getInstance()
+{
+	static ThreadScheduling Instance;
+
+	return Instance;
+}
+
+int ThreadScheduling::coreCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadScheduling::setAcquisitionCores(const std::vector<int>& list)
+{
+	std::vector<int> valid;
+	int count = coreCount();
+
+	for (int core : list) {
+		if (core >= 0 && core < count)
+			valid.push_back(core);
+	}
+
+	std::sort(valid.begin(), valid.end());
+	valid.erase(std::unique(valid.begin(), valid.end()), valid.end());
+
+	std::lock_guard<std::mutex> lock(mutex);
+	cores = valid;
+}
+
+std::vector<int> ThreadScheduling::acquisitionCores() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return cores;
+}
+
+void ThreadScheduling::setRealtime(bool enable)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	rt = enable;
+}
+
+bool ThreadScheduling::realtime() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return rt;
+}
+
+void ThreadScheduling::applyToGuiThread()
+{
+	std::vector<int> reserved = acquisitionCores();
+	int count = coreCount();
+	auto isReserved = [&](int core) {
+		return std::binary_search(reserved.begin(), reserved.end(),
+					  core);
+	};
+
+	/* All the cores reserved would leave the GUI none, it keeps
+	 * them all instead */
+	if ((int)reserved.size() >= count)
+		reserved.clear();
+
+#ifdef __linux__
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	for (int core = 0; core < count; core++) {
+		if (!isReserved(core))
+			CPU_SET(core, &set);
+	}
+
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+	DWORD_PTR mask = 0;
+
+	for (int core = 0; core < count && core < 64; core++) {
+		if (!isReserved(core))
+			mask |= (DWORD_PTR)1 << core;
+	}
+
+	SetThreadAffinityMask(GetCurrentThread(), mask);
+#else
+	(void)isReserved;
+#endif
+}
+
+ThreadScheduling::AcquisitionScope::AcquisitionScope() :
+	affinity_set(false),
+	priority_set(false),
+	saved_policy(0),
+	saved_priority(0)
+{
+	ThreadScheduling& scheduling = ThreadScheduling::getInstance();
+	std::vector<int> cores = scheduling.acquisitionCores();
+	bool rt = scheduling.realtime();
+
+#ifdef __linux__
+	if (!cores.empty() && !pthread_getaffinity_np(pthread_self(),
+				sizeof(saved_affinity), &saved_affinity)) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		for (int core : cores)
+			CPU_SET(core, &set);
+
+		affinity_set = !pthread_setaffinity_np(pthread_self(),
+				sizeof(set), &set);
+	}
+#endif
+
+#ifdef _WIN32
+	if (!cores.empty()) {
+		DWORD_PTR mask = 0;
+
+		for (int core : cores) {
+			if (core < 64)
+				mask |= (DWORD_PTR)1 << core;
+		}
+
+		saved_affinity = SetThreadAffinityMask(GetCurrentThread(), mask);
+		affinity_set = saved_affinity != 0;
+	}
+
+	if (rt) {
+		saved_priority = GetThreadPriority(GetCurrentThread());
+		priority_set = SetThreadPriority(GetCurrentThread(),
+				THREAD_PRIORITY_TIME_CRITICAL);
+	}
+#else
+	if (rt) {
+		struct sched_param param;
+
+		if (!pthread_getschedparam(pthread_self(), &saved_policy,
+					   &param)) {
+			saved_priority = param.sched_priority;
+			param.sched_priority = sched_get_priority_min(SCHED_FIFO)
+				+ realtime_priority_offset;
+			priority_set = !pthread_setschedparam(pthread_self(),
+					SCHED_FIFO, &param);
+		}
+	}
+#endif
+
+	if (rt && !priority_set) {
+		CAT_DEBUG_EVERY(CAT_IIO_MANAGER, 60000) << "No real-time "
+			"priority for the acquisition threads, missing rights?";
+	}
+}
+
+ThreadScheduling::AcquisitionScope::~AcquisitionScope()
+{
+#ifdef __linux__
+	if (affinity_set) {
+		pthread_setaffinity_np(pthread_self(), sizeof(saved_affinity),
+				       &saved_affinity);
+	}
+#endif
+
+#ifdef _WIN32
+	if (affinity_set)
+		SetThreadAffinityMask(GetCurrentThread(), saved_affinity);
+
+	if (priority_set)
+		SetThreadPriority(GetCurrentThread(), saved_priority);
+#else
+	if (priority_set) {
+		struct sched_param param;
+
+		param.sched_priority = saved_priority;
+		pthread_setschedparam(pthread_self(), saved_policy, &param);
+	}
+#endif
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef THREAD_SCHEDULING_HPP
+#define THREAD_SCHEDULING_HPP
+
+#include <mutex>
+#include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace adiscope {
+
+/*
+ * Where the threads that move samples off the device run, and at which
+ * priority: the GNU Radio scheduler threads of the flowgraphs, the logic
+ * analyzer stream and the Network Analyzer sweep can get cores of their
+ * own and real-time priority, while the GUI, the decoders and whatever
+ * else the GUI starts keep the other cores.
+ *
+ * The flowgraphs start their threads themselves, so the acquisition
+ * settings are given to the thread that starts them for that long:
+ * on Linux the new threads inherit its affinity and scheduling policy.
+ * Elsewhere only the thread in the scope itself is affected.
+ *
+ * Real-time priority needs the rights for it (CAP_SYS_NICE or an rtprio
+ * limit on Linux); without them the threads keep the default priority.
+ */
+class ThreadScheduling
+{
+public:
+	static ThreadScheduling& getInstance();
+
+	/* Cores of the acquisition threads, none for all of them;
+	 * cores that don't exist are left out */
+	void setAcquisitionCores(const std::vector<int>& cores);
+	std::vector<int> acquisitionCores() const;
+
+	void setRealtime(bool enable);
+	bool realtime() const;
+
+	/* The calling thread, meant to be the GUI, and the threads it
+	 * starts from then on go to the cores left over */
+	void applyToGuiThread();
+
+	/* The calling thread, and the threads it starts while in scope,
+	 * are acquisition threads; the thread gets its settings back
+	 * at the end of the scope */
+	class AcquisitionScope
+	{
+	public:
+		AcquisitionScope();
+		~AcquisitionScope();
+
+		AcquisitionScope(const AcquisitionScope&) = delete;
+		AcquisitionScope& operator=(const AcquisitionScope&) = delete;
+
+	private:
+		bool affinity_set;
+		bool priority_set;
+#ifdef __linux__
+		cpu_set_t saved_affinity;
+#endif
+#ifdef _WIN32
+		unsigned long long saved_affinity;
+#endif
+		int saved_policy;
+		int saved_priority;
+	};
+
+private:
+	ThreadScheduling();
+
+	static int coreCount();
+
+	mutable std::mutex mutex;
+	std::vector<int> cores;
+	bool rt;
+};
+}
+
+#endif /* THREAD_SCHEDULING_HPP */
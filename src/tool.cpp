@@ -21,19 +21,81 @@
 #include "tool.hpp"
 #include "tool_launcher.hpp"
 #include "detachedwindowsmanager.h"
+#include "settings_store.hpp"
 
 #include <QMimeData>
+#include <QPointer>
 
 
 using namespace adiscope;
 
+namespace adiscope {
+
+/* Follows the tool being shown and hidden, and the window it is in, which
+ * changes when it gets detached, being minimized and restored */
+class ToolDisplayWatcher : public QObject
+{
+public:
+	explicit ToolDisplayWatcher(Tool *tool) :
+		QObject(tool), tool(tool)
+	{
+		tool->installEventFilter(this);
+		watchWindow();
+	}
+
+	bool eventFilter(QObject *watched, QEvent *event) override
+	{
+		switch (event->type()) {
+		case QEvent::ParentChange:
+			if (watched == tool) {
+				watchWindow();
+			}
+			/* fall through */
+		case QEvent::Show:
+		case QEvent::Hide:
+		case QEvent::WindowStateChange:
+			tool->updateDisplayed();
+			break;
+		default:
+			break;
+		}
+
+		return false;
+	}
+
+private:
+	void watchWindow()
+	{
+		QWidget *top = tool->QWidget::window();
+
+		if (top == window) {
+			return;
+		}
+
+		if (window) {
+			window->removeEventFilter(this);
+		}
+
+		window = top;
+
+		if (window && window != tool) {
+			window->installEventFilter(this);
+		}
+	}
+
+	Tool *tool;
+	QPointer<QWidget> window;
+};
+}
+
 Tool::Tool(struct iio_context *ctx, ToolMenuItem *toolMenuItem,
 		ApiObject *api, const QString& name,
 		ToolLauncher *parent) :
 	QWidget(static_cast<QWidget *>(parent)),
 	ctx(ctx), run_button(toolMenuItem->getToolStopBtn()), api(api),
 	name(name), saveOnExit(true), isDetached(false), m_running(false),
-	window(nullptr), toolMenuItem(toolMenuItem)
+	window(nullptr), toolMenuItem(toolMenuItem), displayWatcher(nullptr),
+	m_displayed(false)
 {
 	toolMenuItem->setDisabled(false);
 
@@ -42,11 +104,10 @@ Tool::Tool(struct iio_context *ctx, ToolMenuItem *toolMenuItem,
 	connect(parent, &ToolLauncher::launcherClosed,
 		this, &Tool::saveState);
 
-	QSettings oldSettings;
-	QFile tempFile(oldSettings.fileName() + ".bak");
-	settings = new QSettings(tempFile.fileName(), QSettings::IniFormat);
+	settings = SettingsStore::getInstance().open(name);
 
 	prefPanel = parent->getPrefPanel();
+	captureStore = parent->getCaptureStore();
 	connect(prefPanel, &Preferences::notify, this, &Tool::readPreferences);
 
 	readPreferences();
@@ -58,16 +119,22 @@ Tool::Tool(struct iio_context *ctx, ToolMenuItem *toolMenuItem,
 		this, &Tool::detached);
 	connect(this, &Tool::detachedState,
 		toolMenuItem, &ToolMenuItem::setDetached);
+
+	displayWatcher = new ToolDisplayWatcher(this);
 }
 
 Tool::~Tool()
 {
+	/* Hiding the tool while it gets destroyed isn't news to anyone */
+	delete displayWatcher;
+
 	disconnect(prefPanel, &Preferences::notify, this, &Tool::readPreferences);
 
 	run_button->setChecked(false);
 	toolMenuItem->setDisabled(true);
 
-	delete settings;
+	/* Written on a worker, with what the tool saved in it */
+	SettingsStore::getInstance().release(settings);
 
 	if (window) {
 		// If the tool is in a DetachedWindow when it gets
@@ -98,6 +165,23 @@ void Tool::setNativeDialogs(bool nativeDialogs)
 	m_useNativeDialogs = nativeDialogs;
 }
 
+bool Tool::isDisplayed() const
+{
+	return m_displayed;
+}
+
+void Tool::updateDisplayed()
+{
+	/* The window, as the tool itself isn't told about being minimized */
+	bool displayed = isVisible() &&
+		!(QWidget::window()->windowState() & Qt::WindowMinimized);
+
+	if (displayed != m_displayed) {
+		m_displayed = displayed;
+		Q_EMIT displayedChanged(displayed);
+	}
+}
+
 void Tool::readPreferences()
 {
 	saveOnExit = prefPanel->getSave_session_on_exit();
@@ -43,6 +43,8 @@ struct iio_context;
 namespace adiscope {
 class ApiObject;
 class ToolLauncher;
+class CaptureStore;
+class ToolDisplayWatcher;
 
 class Tool : public QWidget
 {
@@ -60,8 +62,14 @@ public:
 	virtual void settingsLoaded();
 	virtual void setNativeDialogs(bool nativeDialogs);
 
+	/* Whether the tool can be seen: neither behind another tool nor in
+	 * a minimized window. What only feeds the plots can stop while it
+	 * isn't, what feeds measurements and logging has to go on. */
+	bool isDisplayed() const;
+
 Q_SIGNALS:
 	void detachedState(bool detached);
+	void displayedChanged(bool displayed);
 
 public Q_SLOTS:
 	virtual void run();
@@ -83,12 +91,21 @@ protected:
 	QSettings *settings;
 	QString name;
 	Preferences *prefPanel;
+	CaptureStore *captureStore;
 	bool saveOnExit;
 	bool isDetached;
 	bool m_running;
 	QMainWindow *window;
 	ToolMenuItem *toolMenuItem;
 	bool m_useNativeDialogs;
+
+private:
+	friend class ToolDisplayWatcher;
+
+	void updateDisplayed();
+
+	ToolDisplayWatcher *displayWatcher;
+	bool m_displayed;
 };
 }
 #endif /* SCOPY_TOOL_HPP */
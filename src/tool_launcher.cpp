@@ -37,6 +37,13 @@
 #include "user_notes.hpp"
 #include "external_script_api.hpp"
 #include "animationmanager.h"
+#include "DisplayPlot.h"
+#include "capture_store.h"
+#include "context_cache.hpp"
+#include "startup_trace.hpp"
+#include "script_server.hpp"
+#include "script_worker.hpp"
+#include "performance_monitor.hpp"
 
 #include "ui_device.h"
 #include "ui_tool_launcher.h"
@@ -54,16 +61,19 @@
 #include <QDesktopWidget>
 #include <QJsonDocument>
 #include <QDesktopServices>
+#include <QShortcut>
 #include <QSpacerItem>
 
 #include <iio.h>
 
 #include "tool_launcher_api.hpp"
+#include "settings_store.hpp"
 
 #include "toolmenu.h"
 #include "toolmenuitem.h"
 
 #define TIMER_TIMEOUT_MS 5000
+#define TIMER_MAX_TIMEOUT_MS 30000
 #define ALIVE_TIMER_TIMEOUT_MS 5000
 
 using namespace adiscope;
@@ -82,12 +92,16 @@ ToolLauncher::ToolLauncher(QString prevCrashDump, QWidget *parent) :
 	calib(nullptr),
 	skip_calibration(false),
 	calibrating(false),
+	tool_stage_running(false),
 	debugger_enabled(false),
 	indexFile(""), deviceInfo(""), pathToFile(""),
 	manual_calibration_enabled(false),
 	devices_btn_group(new QButtonGroup(this)),
 	selectedDev(nullptr),
 	m_use_decoders(true),
+	m_lazy_tools(false),
+	js_ready(false),
+	script_server(nullptr),
 	menu(nullptr),
 	m_useNativeDialogs(true)
 {
@@ -95,6 +109,7 @@ ToolLauncher::ToolLauncher(QString prevCrashDump, QWidget *parent) :
 		notifier.setEnabled(false);
 
 	ui->setupUi(this);
+	StartupTrace::phase("Launcher UI");
 
 	setWindowIcon(QIcon(":/icon.ico"));
 	QApplication::setWindowIcon(QIcon(":/icon.ico"));
@@ -105,9 +120,19 @@ ToolLauncher::ToolLauncher(QString prevCrashDump, QWidget *parent) :
 	prefPanel = new Preferences(this);
 	prefPanel->setVisible(false);
 
+	captureStore = new CaptureStore(this);
+
+	// The performance panel has no menu entry, it is for debugging
+	QShortcut *perfShortcut = new QShortcut(
+		QKeySequence(Qt::CTRL + Qt::SHIFT + Qt::Key_P), this);
+	connect(perfShortcut, &QShortcut::activated, this, []() {
+		PerformanceMonitor::instance()->showPanel();
+	});
+
 	notesPanel = new UserNotes(this);
 
 	notesPanel->setVisible(false);
+	StartupTrace::phase("Preferences and notes");
 
 	connect(ui->prefBtn, &QPushButton::clicked, [=](){
 		swapMenu(static_cast<QWidget*>(prefPanel));
@@ -119,9 +144,14 @@ ToolLauncher::ToolLauncher(QString prevCrashDump, QWidget *parent) :
 	connect(prefPanel, &Preferences::reset, this, &ToolLauncher::resetSession);
 	connect(prefPanel, &Preferences::notify, this, &ToolLauncher::readPreferences);
 
-	const QVector<QString>& uris = searchDevices();
-	for (const QString& each : uris)
-		addContext(each);
+	/* The network devices used before are probed in parallel, each
+	 * one is added as soon as it answers */
+	for (const QString& uri : ContextCache::getInstance().knownUris()) {
+		if (uri.startsWith("ip:")) {
+			QtConcurrent::run(std::bind(&ToolLauncher::probeUri,
+						    this, uri));
+		}
+	}
 
 	current = ui->homeWidget;
 
@@ -149,24 +179,28 @@ ToolLauncher::ToolLauncher(QString prevCrashDump, QWidget *parent) :
 	ui->btnHome->toggle();
 
 	loadToolTips(false);
+	StartupTrace::phase("Home page and tool menu");
 
-#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
-	js_engine.installExtensions(QJSEngine::ConsoleExtension);
-#endif
-	QtJs *js_object = new QtJs(&js_engine);
-	js_engine.globalObject().setProperty("fileIO",
-				js_engine.newQObject(new JsFileIo(this)));
-	tl_api->js_register(&js_engine);
+	/* Nothing can run a script before the event loop does, so the
+	 * engine is set up once the window is on screen */
+	QTimer::singleShot(0, this, [=]() {
+		setupJsEngine();
+	});
 
 	connect(&notifier, SIGNAL(activated(int)), this, SLOT(hasText()));
 
 	search_timer = new QTimer();
 	connect(search_timer, SIGNAL(timeout()), this, SLOT(search()));
 	connect(&watcher, SIGNAL(finished()), this, SLOT(update()));
-	search_timer->start(TIMER_TIMEOUT_MS);
+	search_interval = TIMER_TIMEOUT_MS;
+
+	/* The first scan runs on a worker too, the devices show up a
+	 * moment after the window instead of holding it back */
+	search();
 
 	alive_timer = new QTimer();
 	connect(alive_timer, SIGNAL(timeout()), this, SLOT(ping()));
+	connect(&ping_watcher, SIGNAL(finished()), this, SLOT(pingDone()));
 
 	QSettings oldSettings;
 	QFile scopy(oldSettings.fileName());
@@ -242,6 +276,9 @@ void ToolLauncher::_setupToolMenu()
 void ToolLauncher::_toolSelected(enum tool tool)
 {
 	Tool *selectedTool = nullptr;
+
+	buildLazyTool(tool);
+
 	switch(tool) {
 	case TOOL_OSCILLOSCOPE:
 		selectedTool = oscilloscope;
@@ -289,6 +326,7 @@ void ToolLauncher::_toolSelected(enum tool tool)
 void ToolLauncher::readPreferences()
 {
 	m_use_decoders = prefPanel->getDigital_decoders_enabled();
+	m_lazy_tools = prefPanel->getLazy_tools_enabled();
 
 	ui->btnNotes->setVisible(prefPanel->getUser_notes_active());
 	allowExternalScript(prefPanel->getExternal_script_enabled());
@@ -298,6 +336,7 @@ void ToolLauncher::readPreferences()
 	}
 
 	AnimationManager::getInstance().toggleAnimations(prefPanel->getAnimations_enabled());
+	DisplayPlot::setOpenGLCanvasEnabled(prefPanel->getOpengl_canvas_enabled());
 }
 
 void ToolLauncher::loadIndexPageFromContent(QString fileLocation)
@@ -449,6 +488,7 @@ void ToolLauncher::resetSession()
 	fileBak.open(QFile::WriteOnly);
 	fileScopy.resize(0);
 	fileBak.resize(0);
+	SettingsStore::getInstance().clear();
 
 	if (connectedDev) {
 		connectedDev->setChecked(true);
@@ -468,8 +508,37 @@ void ToolLauncher::saveSettings()
 	QFile::copy(tempFile.fileName(), scopyFile.fileName());
 }
 
+void ToolLauncher::setupJsEngine()
+{
+	if (js_ready)
+		return;
+
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+	js_engine.installExtensions(QJSEngine::ConsoleExtension);
+#endif
+	QtJs *js_object = new QtJs(&js_engine);
+	js_engine.globalObject().setProperty("fileIO",
+				js_engine.newQObject(new JsFileIo(this)));
+	tl_api->js_register(&js_engine);
+
+	js_ready = true;
+	StartupTrace::phase("Script engine");
+}
+
+bool ToolLauncher::listenForScripts(quint16 port)
+{
+	setupJsEngine();
+
+	if (!script_server)
+		script_server = new ScriptServer(&js_engine, this);
+
+	return script_server->listen(port);
+}
+
 void ToolLauncher::runProgram(const QString& program, const QString& fn)
 {
+	setupJsEngine();
+
 	QJSValue val = js_engine.evaluate(program, fn);
 
 	int ret = EXIT_SUCCESS;
@@ -484,6 +553,21 @@ void ToolLauncher::runProgram(const QString& program, const QString& fn)
 	qApp->exit(ret);
 }
 
+void ToolLauncher::runProgramThreaded(const QString& program,
+				      const QString& fn)
+{
+	setupJsEngine();
+
+	ScriptWorker *worker = new ScriptWorker(&js_engine, program, fn, this);
+
+	connect(worker, &QThread::finished, this, [=]() {
+		/* Exit application */
+		qApp->exit(worker->exitCode());
+	});
+
+	worker->start();
+}
+
 void ToolLauncher::search()
 {
 	search_timer->stop();
@@ -524,6 +608,10 @@ out_destroy_context:
 
 void ToolLauncher::updateListOfDevices(const QVector<QString>& uris)
 {
+	bool changed = false;
+
+	ContextCache::getInstance().retainUsb(QStringList::fromVector(uris));
+
 	//Delete devices that are in the devices list but not found anymore when scanning
 
 	int pos = 0;
@@ -546,6 +634,7 @@ void ToolLauncher::updateListOfDevices(const QVector<QString>& uris)
 			}
 			delete dev;
 			devices.erase(devices.begin() + pos);
+			changed = true;
 		} else {
 			pos++;
 		}
@@ -557,11 +646,20 @@ void ToolLauncher::updateListOfDevices(const QVector<QString>& uris)
 
 		auto dev = getDevice(uri);
 
-		if (!dev)
+		if (!dev) {
 			addContext(uri);
+			changed = true;
+		}
 	}
 
-	search_timer->start(TIMER_TIMEOUT_MS);
+	/* Scan less often while nothing is plugged or unplugged */
+	if (changed) {
+		search_interval = TIMER_TIMEOUT_MS;
+	} else {
+		search_interval = qMin(search_interval * 2, TIMER_MAX_TIMEOUT_MS);
+	}
+
+	search_timer->start(search_interval);
 }
 
 void ToolLauncher::loadToolTips(bool connected){
@@ -606,6 +704,8 @@ ToolLauncher::~ToolLauncher()
 	delete tl_api;
 	delete ui;
 
+	/* The settings of the tools are written on a worker */
+	SettingsStore::getInstance().flush();
 	saveSettings();
 }
 
@@ -621,6 +721,7 @@ void ToolLauncher::forgetDeviceBtn_clicked(QString uri)
 	if (previousIp == uri.mid(3)) {
 		previousIp = "";
 	}
+	ContextCache::getInstance().forget(uri);
 	DeviceWidget *dev = nullptr;
 	for(auto d : devices) {
 		if (d == sender()) {
@@ -665,7 +766,12 @@ void ToolLauncher::forgetDeviceBtn_clicked(QString uri)
 
 QPushButton *ToolLauncher::addContext(const QString& uri)
 {
-	auto tempCtx = iio_create_context_from_uri(uri.toStdString().c_str());
+	/* Probed again on a worker meanwhile */
+	auto existing = getDevice(uri);
+	if (existing)
+		return existing->deviceButton();
+
+	auto tempCtx = ContextCache::getInstance().take(uri);
 	if (!tempCtx)
 		return nullptr;
 
@@ -683,7 +789,7 @@ QPushButton *ToolLauncher::addContext(const QString& uri)
 	}
 
 	delete tempFilter;
-	iio_context_destroy(tempCtx);
+	ContextCache::getInstance().put(uri, tempCtx);
 	tempCtx = nullptr;
 
 	auto connectBtn = deviceWidget->connectButton();
@@ -979,12 +1085,12 @@ void adiscope::ToolLauncher::deviceBtn_clicked(bool pressed)
 
 	if (pressed && !getConnectedDevice()) {
 		if (dev) {
-			auto tempCtx = iio_create_context_from_uri(dev->uri().toStdString().c_str());
+			auto tempCtx = ContextCache::getInstance().take(dev->uri());
 			if (tempCtx) {
 				auto tempFilter = new Filter(tempCtx);
 				menu->loadToolsFromFilter(tempFilter);
 				delete tempFilter;
-				iio_context_destroy(tempCtx);
+				ContextCache::getInstance().put(dev->uri(), tempCtx);
 			}
 		}
 
@@ -1016,12 +1122,17 @@ void adiscope::ToolLauncher::disconnect()
 		iio->stop_all();
 		alive_timer->stop();
 
+		/* Done with the context, and no answer left to come */
+		ping_watcher.waitForFinished();
+		ping_watcher.setFuture(QFuture<int>());
+
 		ui->saveBtn->parentWidget()->setEnabled(false);
 
 		destroyContext();
 		loadToolTips(false);
 		resetStylesheets();
-		search_timer->start(TIMER_TIMEOUT_MS);
+		search_interval = TIMER_TIMEOUT_MS;
+		search_timer->start(search_interval);
 	}
 
 	/* Update the list of devices now */
@@ -1030,9 +1141,23 @@ void adiscope::ToolLauncher::disconnect()
 
 void adiscope::ToolLauncher::ping()
 {
-	int ret = iio_context_get_version(ctx, nullptr, nullptr, nullptr);
+	/* On a worker, a slow link doesn't hold the GUI back */
+	if (!ctx || ping_watcher.isRunning())
+		return;
+
+	struct iio_context *pinged = ctx;
+
+	ping_watcher.setFuture(QtConcurrent::run([=]() {
+		return iio_context_get_version(pinged, nullptr, nullptr, nullptr);
+	}));
+}
+
+void adiscope::ToolLauncher::pingDone()
+{
+	if (!ctx || !ping_watcher.future().resultCount())
+		return;
 
-	if (ret < 0)
+	if (ping_watcher.result() < 0)
 		disconnect();
 }
 
@@ -1104,6 +1229,18 @@ void adiscope::ToolLauncher::connectBtn_clicked(bool pressed)
 
 void adiscope::ToolLauncher::destroyContext()
 {
+	tool_stages.clear();
+
+	for (auto it = lazy_tools.begin(); it != lazy_tools.end(); ++it) {
+		QObject::disconnect(it.value().run_connection);
+		menu->getToolMenuItemFor(it.key())->setDisabled(true);
+	}
+	lazy_tools.clear();
+	session_file.clear();
+
+	/* libsigrokdecode is reloaded on the next connection */
+	decoders_future.waitForFinished();
+
 	if (dio) {
 		delete dio;
 		dio = nullptr;
@@ -1134,6 +1271,9 @@ void adiscope::ToolLauncher::destroyContext()
 		logic_analyzer = nullptr;
 	}
 
+	// The captures belong to the device that is going away
+	captureStore->clear();
+
 	if (pattern_generator) {
 		delete pattern_generator;
 		pattern_generator = nullptr;
@@ -1213,11 +1353,12 @@ bool ToolLauncher::loadDecoders(QString path)
 
 void adiscope::ToolLauncher::saveRunningToolsBeforeCalibration()
 {
-	if(dmm->isRunning()) calibration_saved_tools.push_back(dmm);
-	if(oscilloscope->isRunning()) calibration_saved_tools.push_back(oscilloscope);
-	if(signal_generator->isRunning()) calibration_saved_tools.push_back(signal_generator);
-	if(spectrum_analyzer->isRunning()) calibration_saved_tools.push_back(spectrum_analyzer);
-	if(network_analyzer->isRunning()) calibration_saved_tools.push_back(network_analyzer);
+	// Tools built on demand may not exist yet
+	if(dmm && dmm->isRunning()) calibration_saved_tools.push_back(dmm);
+	if(oscilloscope && oscilloscope->isRunning()) calibration_saved_tools.push_back(oscilloscope);
+	if(signal_generator && signal_generator->isRunning()) calibration_saved_tools.push_back(signal_generator);
+	if(spectrum_analyzer && spectrum_analyzer->isRunning()) calibration_saved_tools.push_back(spectrum_analyzer);
+	if(network_analyzer && network_analyzer->isRunning()) calibration_saved_tools.push_back(network_analyzer);
 }
 
 void adiscope::ToolLauncher::stopToolsBeforeCalibration()
@@ -1260,10 +1401,26 @@ void adiscope::ToolLauncher::calibrationFailedCallback()
 
 void adiscope::ToolLauncher::initialCalibration()
 {
-	bool ok = true;
+	if (skip_calibration) {
+		return;
+	}
+
+	/* A board already calibrated at about this temperature only has
+	 * its offsets checked, still on this worker */
+	bool cached = false;
+
+	if (calib->isInitialized()) {
+		calib->setHardwareInCalibMode();
+		cached = calib->loadCachedCalibration();
+		calib->restoreHardwareFromCalibMode();
+	}
 
-	if (!skip_calibration) {
-		ok = calibrate();
+	if (cached) {
+		Q_EMIT adcCalibrationDone();
+		Q_EMIT dacCalibrationDone();
+		Q_EMIT calibrationDone();
+	} else {
+		calibrate();
 	}
 }
 
@@ -1304,6 +1461,7 @@ bool adiscope::ToolLauncher::calibrate()
 	calibrating=false;
 
 	if (ok) {
+		calib->storeCalibration();
 		Q_EMIT adcCalibrationDone();
 		Q_EMIT dacCalibrationDone();
 		Q_EMIT calibrationDone();
@@ -1315,117 +1473,204 @@ bool adiscope::ToolLauncher::calibrate()
 	return ok;
 }
 
+void adiscope::ToolLauncher::queueToolStage(const std::function<void()>& stage)
+{
+	tool_stages.enqueue(stage);
+
+	if (!tool_stage_running && tool_stages.size() == 1) {
+		QMetaObject::invokeMethod(this, "runToolStage",
+					  Qt::QueuedConnection);
+	}
+}
+
+void adiscope::ToolLauncher::runToolStage()
+{
+	if (tool_stages.isEmpty()) {
+		return;
+	}
+
+	auto stage = tool_stages.dequeue();
+
+	tool_stage_running = true;
+	stage();
+	tool_stage_running = false;
+
+	if (!tool_stages.isEmpty()) {
+		QMetaObject::invokeMethod(this, "runToolStage",
+					  Qt::QueuedConnection);
+	}
+}
+
+void adiscope::ToolLauncher::addTool(enum tool tool,
+	const std::function<void()>& build)
+{
+	if (!m_lazy_tools) {
+		queueToolStage(build);
+		return;
+	}
+
+	/* The entry can be used right away, the tool is only built when it
+	 * is first opened or started */
+	ToolMenuItem *item = menu->getToolMenuItemFor(tool);
+	LazyTool lazy;
+
+	lazy.build = build;
+	lazy.run_connection = connect(item->getToolStopBtn(),
+		&QPushButton::toggled, [=](bool checked) {
+		if (checked && buildLazyTool(tool)) {
+			/* Toggle again, now that the tool follows the button */
+			QPushButton *btn = item->getToolStopBtn();
+
+			btn->blockSignals(true);
+			btn->setChecked(false);
+			btn->blockSignals(false);
+			btn->setChecked(true);
+		}
+	});
+
+	item->setDisabled(false);
+	lazy_tools.insert(tool, lazy);
+}
+
+bool adiscope::ToolLauncher::buildLazyTool(enum tool tool)
+{
+	auto it = lazy_tools.find(tool);
+
+	if (it == lazy_tools.end()) {
+		return false;
+	}
+
+	LazyTool lazy = it.value();
+	int built = toolList.size();
+
+	lazy_tools.erase(it);
+	QObject::disconnect(lazy.run_connection);
+
+	/* Its saved state is read by the constructor, a session loaded
+	 * since connecting is applied on top of it */
+	lazy.build();
+
+	for (int i = built; i < toolList.size(); i++) {
+		toolList[i]->setNativeDialogs(m_useNativeDialogs);
+	}
+
+	if (!session_file.isEmpty()) {
+		tl_api->loadTool(tool, session_file);
+	}
+
+	return true;
+}
+
 void adiscope::ToolLauncher::enableAdcBasedTools()
 {
 	if (filter->compatible(TOOL_OSCILLOSCOPE)) {
-		oscilloscope = new Oscilloscope(ctx, filter, adc,
-						menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE),
-						&js_engine, this);
-		toolList.push_back(oscilloscope);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE)->getToolStopBtn());
-		connect(oscilloscope, &Oscilloscope::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE)->getToolBtn()->click();
+		addTool(TOOL_OSCILLOSCOPE, [=]() {
+			oscilloscope = new Oscilloscope(ctx, filter, adc,
+							menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE),
+							&js_engine, this);
+			toolList.push_back(oscilloscope);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE)->getToolStopBtn());
+			connect(oscilloscope, &Oscilloscope::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_OSCILLOSCOPE)->getToolBtn()->click();
+			});
 		});
 	}
 
 	if (filter->compatible(TOOL_DMM)) {
-		dmm = new DMM(ctx, filter, adc, menu->getToolMenuItemFor(TOOL_DMM),
-				&js_engine, this);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_DMM)->getToolStopBtn());
-		toolList.push_back(dmm);
-		connect(dmm, &DMM::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_DMM)->getToolBtn()->click();
+		addTool(TOOL_DMM, [=]() {
+			dmm = new DMM(ctx, filter, adc, menu->getToolMenuItemFor(TOOL_DMM),
+					&js_engine, this);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_DMM)->getToolStopBtn());
+			toolList.push_back(dmm);
+			connect(dmm, &DMM::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_DMM)->getToolBtn()->click();
+			});
 		});
 	}
 
 	if (filter->compatible(TOOL_DEBUGGER)) {
-		debugger = new Debugger(ctx, filter,menu->getToolMenuItemFor(TOOL_DEBUGGER),
-				&js_engine, this);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_DEBUGGER)->getToolStopBtn());
-		QObject::connect(debugger, &Debugger::newDebuggerInstance, this,
-				 &ToolLauncher::addDebugWindow);
+		queueToolStage([=]() {
+			debugger = new Debugger(ctx, filter,menu->getToolMenuItemFor(TOOL_DEBUGGER),
+					&js_engine, this);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_DEBUGGER)->getToolStopBtn());
+			QObject::connect(debugger, &Debugger::newDebuggerInstance, this,
+					 &ToolLauncher::addDebugWindow);
+		});
 	}
 
 	if (filter->compatible(TOOL_CALIBRATION)) {
-		manual_calibration = new ManualCalibration(ctx, filter,menu->getToolMenuItemFor(TOOL_CALIBRATION),
-				&js_engine, this, calib);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_CALIBRATION)->getToolStopBtn());
-		toolList.push_back(manual_calibration);
+		queueToolStage([=]() {
+			manual_calibration = new ManualCalibration(ctx, filter,menu->getToolMenuItemFor(TOOL_CALIBRATION),
+					&js_engine, this, calib);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_CALIBRATION)->getToolStopBtn());
+			toolList.push_back(manual_calibration);
+		});
 	}
 
 	if (filter->compatible(TOOL_SPECTRUM_ANALYZER)) {
-		spectrum_analyzer = new SpectrumAnalyzer(ctx, filter, adc,
-			menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER),&js_engine, this);
-		toolList.push_back(spectrum_analyzer);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER)->getToolStopBtn());
-		connect(spectrum_analyzer, &SpectrumAnalyzer::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER)->getToolBtn()->click();
+		addTool(TOOL_SPECTRUM_ANALYZER, [=]() {
+			spectrum_analyzer = new SpectrumAnalyzer(ctx, filter, adc,
+				menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER),&js_engine, this);
+			toolList.push_back(spectrum_analyzer);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER)->getToolStopBtn());
+			connect(spectrum_analyzer, &SpectrumAnalyzer::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_SPECTRUM_ANALYZER)->getToolBtn()->click();
+			});
 		});
 	}
 
 	if (filter->compatible((TOOL_NETWORK_ANALYZER))) {
-
-		network_analyzer = new NetworkAnalyzer(ctx, filter, adc, dacs,
-			menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER), &js_engine, this);
-		adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER)->getToolStopBtn());
-		toolList.push_back(network_analyzer);
-		connect(network_analyzer, &NetworkAnalyzer::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER)->getToolBtn()->click();
+		addTool(TOOL_NETWORK_ANALYZER, [=]() {
+			// The buffer previewer shows its captures in the oscilloscope
+			buildLazyTool(TOOL_OSCILLOSCOPE);
+			network_analyzer = new NetworkAnalyzer(ctx, filter, adc, dacs,
+				menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER), &js_engine, this);
+			adc_users_group.addButton(menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER)->getToolStopBtn());
+			toolList.push_back(network_analyzer);
+			connect(network_analyzer, &NetworkAnalyzer::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_NETWORK_ANALYZER)->getToolBtn()->click();
+			});
+			network_analyzer->setOscilloscope(oscilloscope);
 		});
-		network_analyzer->setOscilloscope(oscilloscope);
 	}
 
-	Q_EMIT adcToolsCreated();
+	queueToolStage([=]() {
+		Q_EMIT adcToolsCreated();
+	});
 }
 
 
 void adiscope::ToolLauncher::enableDacBasedTools()
 {
 	if (filter->compatible(TOOL_SIGNAL_GENERATOR)) {
-		signal_generator = new SignalGenerator(ctx, dacs, filter,
-			menu->getToolMenuItemFor(TOOL_SIGNAL_GENERATOR), &js_engine, this);
-		toolList.push_back(signal_generator);
-		connect(signal_generator, &SignalGenerator::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_SIGNAL_GENERATOR)->getToolBtn()->click();
+		addTool(TOOL_SIGNAL_GENERATOR, [=]() {
+			signal_generator = new SignalGenerator(ctx, dacs, filter,
+				menu->getToolMenuItemFor(TOOL_SIGNAL_GENERATOR), &js_engine, this);
+			toolList.push_back(signal_generator);
+			connect(signal_generator, &SignalGenerator::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_SIGNAL_GENERATOR)->getToolBtn()->click();
+			});
 		});
 	}
-	if (pathToFile != "") {
-		this->tl_api->load(pathToFile);
-	}
 
-	Q_EMIT dacToolsCreated();
-	selectedDev->connectButton()->setText(tr("Disconnect"));
-	selectedDev->connectButton()->setEnabled(true);
+	queueToolStage([=]() {
+		if (pathToFile != "") {
+			this->tl_api->load(pathToFile);
+		}
 
-	for (auto &tool : toolList) {
-		tool->setNativeDialogs(m_useNativeDialogs);
-		qDebug() << tool << " will use native dialogs: " << m_useNativeDialogs;
-	}
+		Q_EMIT dacToolsCreated();
+		selectedDev->connectButton()->setText(tr("Disconnect"));
+		selectedDev->connectButton()->setEnabled(true);
+
+		for (auto &tool : toolList) {
+			tool->setNativeDialogs(m_useNativeDialogs);
+			qDebug() << tool << " will use native dialogs: " << m_useNativeDialogs;
+		}
+	});
 }
 
-bool adiscope::ToolLauncher::switchContext(const QString& uri)
+void adiscope::ToolLauncher::probeHardware()
 {
-	destroyContext();
-
-	if (uri.startsWith("ip:")) {
-		previousIp = uri.mid(3);
-	}
-
-	auto dev = getDevice(uri);
-	if (dev->infoPage()->ctx()) {
-		ctx = dev->infoPage()->ctx();
-	} else {
-		ctx = iio_create_context_from_uri(uri.toStdString().c_str());
-	}
-
-	if (!ctx) {
-		return false;
-	}
-
-	alive_timer->start(ALIVE_TIMER_TIMEOUT_MS);
-
-	filter = new Filter(ctx);
-
 	dacs.clear();
 
 	// Find available DACs
@@ -1459,6 +1704,55 @@ bool adiscope::ToolLauncher::switchContext(const QString& uri)
 			dacs.push_back(dac);
 		}
 	}
+}
+
+bool adiscope::ToolLauncher::switchContext(const QString& uri)
+{
+	destroyContext();
+
+	if (uri.startsWith("ip:")) {
+		previousIp = uri.mid(3);
+	}
+
+	auto dev = getDevice(uri);
+	if (dev->infoPage()->ctx()) {
+		ctx = dev->infoPage()->ctx();
+	} else {
+		ctx = ContextCache::getInstance().take(uri);
+	}
+
+	if (!ctx) {
+		return false;
+	}
+
+	ContextCache::getInstance().remember(uri);
+
+	alive_timer->start(ALIVE_TIMER_TIMEOUT_MS);
+
+	filter = new Filter(ctx);
+
+	bool digital_decoders = m_use_decoders &&
+		(filter->compatible(TOOL_LOGIC_ANALYZER)
+		 || filter->compatible(TOOL_PATTERN_GENERATOR));
+
+	/* The protocol decoders load and the ADC and DACs are probed on
+	 * workers, only the widgets are built here */
+	if (digital_decoders) {
+		decoders_future = QtConcurrent::run(this,
+			&ToolLauncher::loadDecoders,
+			QCoreApplication::applicationDirPath() + "/decoders");
+	}
+
+	QFuture<void> probe = QtConcurrent::run(this,
+		&ToolLauncher::probeHardware);
+
+	if (filter->compatible(TOOL_PATTERN_GENERATOR)
+	    || filter->compatible(TOOL_DIGITALIO)) {
+		dioManager = new DIOManager(ctx,filter);
+
+	}
+
+	probe.waitForFinished();
 
 	auto m2k_adc = std::dynamic_pointer_cast<M2kAdc>(adc);
 	std::shared_ptr<M2kDac> m2k_dac_a;
@@ -1474,71 +1768,73 @@ bool adiscope::ToolLauncher::switchContext(const QString& uri)
 	calib = new Calibration(ctx, &js_engine, m2k_adc, m2k_dac_a, m2k_dac_b);
 	calib->initialize();
 
+	if (!m_use_decoders && (filter->compatible(TOOL_LOGIC_ANALYZER)
+	    || filter->compatible(TOOL_PATTERN_GENERATOR))) {
+		search_timer->stop();
 
-	if (filter->compatible(TOOL_PATTERN_GENERATOR)
-	    || filter->compatible(TOOL_DIGITALIO)) {
-		dioManager = new DIOManager(ctx,filter);
-
+		QMessageBox info(this);
+		info.setText(tr("Digital decoders support is disabled. Some features may be missing"));
+		info.exec();
 	}
 
-	if (filter->compatible(TOOL_LOGIC_ANALYZER)
-	    || filter->compatible(TOOL_PATTERN_GENERATOR)) {
+	if (filter->compatible(TOOL_DIGITALIO)) {
+		addTool(TOOL_DIGITALIO, [=]() {
+			dio = new DigitalIO(ctx, filter, menu->getToolMenuItemFor(TOOL_DIGITALIO),
+					dioManager, &js_engine, this);
+			toolList.push_back(dio);
+			connect(dio, &DigitalIO::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_DIGITALIO)->getToolBtn()->click();
+			});
+		});
+	}
 
-		if (!m_use_decoders) {
-			search_timer->stop();
 
-			QMessageBox info(this);
-			info.setText(tr("Digital decoders support is disabled. Some features may be missing"));
-			info.exec();
-		} else {
-			bool success = loadDecoders(QCoreApplication::applicationDirPath() +
-						    "/decoders");
+	if (filter->compatible(TOOL_POWER_CONTROLLER)) {
+		addTool(TOOL_POWER_CONTROLLER, [=]() {
+			power_control = new PowerController(ctx, menu->getToolMenuItemFor(TOOL_POWER_CONTROLLER),
+					&js_engine, this);
+			toolList.push_back(power_control);
+			connect(power_control, &PowerController::showTool, [=]() {
+				menu->getToolMenuItemFor(TOOL_POWER_CONTROLLER)->getToolBtn()->click();
+			});
+		});
+	}
 
-			if (!success) {
+	/* The digital tools need the decoders, wait for them to load */
+	if (digital_decoders) {
+		queueToolStage([=]() {
+			if (!decoders_future.result()) {
 				search_timer->stop();
 
 				QMessageBox error(this);
 				error.setText(tr("There was a problem initializing libsigrokdecode. Some features may be missing"));
 				error.exec();
 			}
-		}
-	}
-
-	if (filter->compatible(TOOL_DIGITALIO)) {
-		dio = new DigitalIO(ctx, filter, menu->getToolMenuItemFor(TOOL_DIGITALIO),
-				dioManager, &js_engine, this);
-		toolList.push_back(dio);
-		connect(dio, &DigitalIO::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_DIGITALIO)->getToolBtn()->click();
-		});
-	}
-
-
-	if (filter->compatible(TOOL_POWER_CONTROLLER)) {
-		power_control = new PowerController(ctx, menu->getToolMenuItemFor(TOOL_POWER_CONTROLLER),
-				&js_engine, this);
-		toolList.push_back(power_control);
-		connect(power_control, &PowerController::showTool, [=]() {
-			menu->getToolMenuItemFor(TOOL_POWER_CONTROLLER)->getToolBtn()->click();
 		});
 	}
 
 	if (filter->compatible(TOOL_LOGIC_ANALYZER)) {
-		logic_analyzer = new LogicAnalyzer(ctx, filter, menu->getToolMenuItemFor(TOOL_LOGIC_ANALYZER),
-				&js_engine, this);
-		toolList.push_back(logic_analyzer);
-		connect(logic_analyzer, &LogicAnalyzer::showTool, [=]() {
-			 menu->getToolMenuItemFor(TOOL_LOGIC_ANALYZER)->getToolBtn()->click();
+		addTool(TOOL_LOGIC_ANALYZER, [=]() {
+			decoders_future.waitForFinished();
+			logic_analyzer = new LogicAnalyzer(ctx, filter, menu->getToolMenuItemFor(TOOL_LOGIC_ANALYZER),
+					&js_engine, this);
+			toolList.push_back(logic_analyzer);
+			connect(logic_analyzer, &LogicAnalyzer::showTool, [=]() {
+				 menu->getToolMenuItemFor(TOOL_LOGIC_ANALYZER)->getToolBtn()->click();
+			});
 		});
 	}
 
 
 	if (filter->compatible((TOOL_PATTERN_GENERATOR))) {
-		pattern_generator = new PatternGenerator(ctx, filter,
-				 menu->getToolMenuItemFor(TOOL_PATTERN_GENERATOR), &js_engine,dioManager, this);
-		toolList.push_back(pattern_generator);
-		connect(pattern_generator, &PatternGenerator::showTool, [=]() {
-			 menu->getToolMenuItemFor(TOOL_PATTERN_GENERATOR)->getToolBtn()->click();
+		addTool(TOOL_PATTERN_GENERATOR, [=]() {
+			decoders_future.waitForFinished();
+			pattern_generator = new PatternGenerator(ctx, filter,
+					 menu->getToolMenuItemFor(TOOL_PATTERN_GENERATOR), &js_engine,dioManager, this);
+			toolList.push_back(pattern_generator);
+			connect(pattern_generator, &PatternGenerator::showTool, [=]() {
+				 menu->getToolMenuItemFor(TOOL_PATTERN_GENERATOR)->getToolBtn()->click();
+			});
 		});
 	}
 
@@ -1593,8 +1889,11 @@ void ToolLauncher::calibrationThreadWatcherFinished()
 	QObject::disconnect(this, SIGNAL(dacCalibrationDone()),
 		   this, SLOT(enableDacBasedTools()));
 
-	getConnectedDevice()->calibrateButton()->setEnabled(true);
-	connect(getConnectedDevice()->calibrateButton(), SIGNAL(clicked()),this, SLOT(requestCalibration()));
+	/* Calibrating again stops the running tools, they must exist */
+	queueToolStage([=]() {
+		getConnectedDevice()->calibrateButton()->setEnabled(true);
+		connect(getConnectedDevice()->calibrateButton(), SIGNAL(clicked()),this, SLOT(requestCalibration()));
+	});
 }
 
 void ToolLauncher::hasText()
@@ -1602,6 +1901,8 @@ void ToolLauncher::hasText()
 	QTextStream in(stdin);
 	QTextStream out(stdout);
 
+	setupJsEngine();
+
 	js_cmd.append(in.readLine());
 
 	unsigned int nb_open_braces = js_cmd.count(QChar('{'));
@@ -1629,28 +1930,30 @@ void ToolLauncher::hasText()
 
 void ToolLauncher::checkIp(const QString& ip)
 {
-	if (iio_create_network_context(ip.toStdString().c_str())) {
+	if (probeUri("ip:" + ip)) {
 		previousIp = ip;
-
-		QString uri = "ip:" + ip;
-
-		bool found = false;
-		for (auto dev : devices) {
-			if (dev->uri() == uri) {
-				found = true;
-				break;
-			}
-		}
-
-		if (!found)
-			QMetaObject::invokeMethod(this, "addContext",
-						Qt::QueuedConnection,
-						Q_ARG(const QString&, uri));
 	} else {
 		previousIp = "";
 	}
 }
 
+bool ToolLauncher::probeUri(const QString& uri)
+{
+	auto probe = ContextCache::getInstance().take(uri);
+
+	if (!probe) {
+		return false;
+	}
+
+	/* Kept for adding the device and connecting to it */
+	ContextCache::getInstance().put(uri, probe);
+
+	QMetaObject::invokeMethod(this, "addContext",
+				  Qt::QueuedConnection,
+				  Q_ARG(const QString&, uri));
+	return true;
+}
+
 void ToolLauncher::toolDetached(bool detached)
 {
 	Tool *tool = static_cast<Tool *>(QObject::sender());
@@ -1691,6 +1994,11 @@ Preferences *ToolLauncher::getPrefPanel() const
 	return prefPanel;
 }
 
+CaptureStore *ToolLauncher::getCaptureStore() const
+{
+	return captureStore;
+}
+
 Calibration *ToolLauncher::getCalibration() const
 {
 	return calib;
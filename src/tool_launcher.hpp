@@ -26,6 +26,7 @@
 #include <QJSEngine>
 #include <QMainWindow>
 #include <QPair>
+#include <QQueue>
 #include <QSocketNotifier>
 #include <QVector>
 #include <QButtonGroup>
@@ -34,6 +35,8 @@
 #include <info_widget.h>
 #include <QTextBrowser>
 
+#include <functional>
+
 #include "apiObject.hpp"
 #include "dmm.hpp"
 #include "filter.hpp"
@@ -70,6 +73,8 @@ class SpectrumAnalyzer;
 class Debugger;
 class ManualCalibration;
 class UserNotes;
+class CaptureStore;
+class ScriptServer;
 
 class ToolLauncher : public QMainWindow
 {
@@ -82,9 +87,13 @@ public:
 	~ToolLauncher();
 
 	Q_INVOKABLE void runProgram(const QString& program, const QString& fn);
+	/* Same, but with the script on its own thread (see ScriptWorker) */
+	Q_INVOKABLE void runProgramThreaded(const QString& program,
+					    const QString& fn);
 	InfoWidget *infoWidget;
 
 	Preferences *getPrefPanel() const;
+	CaptureStore *getCaptureStore() const;
 	Calibration *getCalibration() const;
 	bool eventFilter(QObject *watched, QEvent *event);
 
@@ -94,6 +103,9 @@ public:
 	bool hasNativeDialogs() const;
 	void setNativeDialogs(bool nativeDialogs);
 
+	/* Accept scripts and stream captures to controllers on port */
+	bool listenForScripts(quint16 port);
+
 Q_SIGNALS:
 	void connectionDone(bool success);
 	void adcCalibrationDone();
@@ -120,6 +132,7 @@ private Q_SLOTS:
 	void search();
 	void update();
 	void ping();
+	void pingDone();
 
 	void btnOscilloscope_clicked();
 	void btnSignalGenerator_clicked();
@@ -158,6 +171,7 @@ private Q_SLOTS:
 	void restartToolsAfterCalibration();
 	void calibrationFailedCallback();
 	void calibrationThreadWatcherFinished();
+	void runToolStage();
 private:
 	QList<Tool*> calibration_saved_tools;
 	void loadToolTips(bool connected);
@@ -165,11 +179,17 @@ private:
 	void swapMenu(QWidget *menu);
 	void destroyContext();
 	bool loadDecoders(QString path);
+	void setupJsEngine();
+	void probeHardware();
+	void queueToolStage(const std::function<void()>& stage);
+	void addTool(enum tool tool, const std::function<void()>& build);
+	bool buildLazyTool(enum tool tool);
 	bool switchContext(const QString& uri);
 	void resetStylesheets();
 	void initialCalibration();
 	bool calibrate();
 	void checkIp(const QString& ip);
+	bool probeUri(const QString& uri);
 	void disconnect();
 	void saveSettings();
 	Q_INVOKABLE QPushButton *addContext(const QString& hostname);
@@ -201,10 +221,31 @@ private:
 	QVector<Tool*> toolList;
 
 	QTimer *search_timer, *alive_timer;
+
+	/* The ping of the device in use, a network round trip */
+	QFutureWatcher<int> ping_watcher;
+	int search_interval;
 	QFutureWatcher<QVector<QString>> watcher;
 	QFuture<QVector<QString>> future;
 	QFuture<void> calibration_thread;
 	QFutureWatcher<void> calibration_thread_watcher;
+	QFuture<bool> decoders_future;
+
+	/*
+	 * The tools are built one per pass of the event loop, while the
+	 * decoders load and the board calibrates on workers, so each of
+	 * them can be used as soon as it exists.
+	 */
+	QQueue<std::function<void()>> tool_stages;
+	bool tool_stage_running;
+
+	/* Tools left to build on first use, with the Preferences option */
+	struct LazyTool {
+		std::function<void()> build;
+		QMetaObject::Connection run_connection;
+	};
+	QMap<enum tool, LazyTool> lazy_tools;
+	QString session_file;
 
 	DMM *dmm;
 	PowerController *power_control;
@@ -222,6 +263,7 @@ private:
 	QSettings *settings;
 	Preferences *prefPanel;
 	UserNotes *notesPanel;
+	CaptureStore *captureStore;
 
 	QButtonGroup adc_users_group;
 
@@ -255,6 +297,9 @@ private:
 
 	DeviceWidget* selectedDev;
 	bool m_use_decoders;
+	bool m_lazy_tools;
+	bool js_ready;
+	ScriptServer *script_server;
 
 	bool m_useNativeDialogs;
 
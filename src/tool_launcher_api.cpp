@@ -23,6 +23,10 @@
 #include "spectrum_analyzer.hpp"
 #include "apiobjectmanager.h"
 #include "debugger.h"
+#include "kernel_benchmark.hpp"
+#include "performance_monitor.hpp"
+#include "memory_budget.hpp"
+#include "pipeline_trace.hpp"
 
 #include <QJsonDocument>
 
@@ -73,6 +77,46 @@ void ToolLauncher_API::enable_debugger(bool enabled)
 	tl->prefPanel->setDebugger_enabled(enabled);
 }
 
+bool ToolLauncher_API::performanceMonitorEnabled() const
+{
+	return PerformanceMonitor::instance()->isEnabled();
+}
+
+void ToolLauncher_API::enablePerformanceMonitor(bool en)
+{
+	PerformanceMonitor::instance()->setEnabled(en);
+}
+
+QVariantMap ToolLauncher_API::getPerformance() const
+{
+	return PerformanceMonitor::instance()->snapshot();
+}
+
+void ToolLauncher_API::showPerformancePanel()
+{
+	PerformanceMonitor::instance()->showPanel();
+}
+
+QVariantMap ToolLauncher_API::getMemoryUsage() const
+{
+	return MemoryBudget::instance()->usage();
+}
+
+bool ToolLauncher_API::pipelineTraceEnabled() const
+{
+	return PipelineTrace::isEnabled();
+}
+
+void ToolLauncher_API::enablePipelineTrace(bool en)
+{
+	PipelineTrace::setEnabled(en);
+}
+
+bool ToolLauncher_API::dumpPipelineTrace(const QString& file)
+{
+	return PipelineTrace::dump(file);
+}
+
 bool ToolLauncher_API::manual_calibration_enabled() const
 {
 	return tl->manual_calibration_enabled;
@@ -199,6 +243,77 @@ void ToolLauncher_API::load(const QString& file)
 
 	for (auto tool : tl->toolList)
 		tool->settingsLoaded();
+
+	// Kept for the tools that are only built when first opened
+	tl->session_file = file;
+}
+
+void ToolLauncher_API::loadTool(enum tool tool, const QString& file)
+{
+	QSettings settings(file, QSettings::IniFormat);
+	Tool *loaded = nullptr;
+
+	switch (tool) {
+	case TOOL_OSCILLOSCOPE:
+		if (tl->oscilloscope) {
+			tl->oscilloscope->api->load(settings);
+			loaded = tl->oscilloscope;
+		}
+		break;
+	case TOOL_DMM:
+		if (tl->dmm) {
+			tl->dmm->api->load(settings);
+			loaded = tl->dmm;
+		}
+		break;
+	case TOOL_POWER_CONTROLLER:
+		if (tl->power_control) {
+			tl->power_control->api->load(settings);
+			loaded = tl->power_control;
+		}
+		break;
+	case TOOL_SIGNAL_GENERATOR:
+		if (tl->signal_generator) {
+			tl->signal_generator->api->load(settings);
+			loaded = tl->signal_generator;
+		}
+		break;
+	case TOOL_LOGIC_ANALYZER:
+		if (tl->logic_analyzer) {
+			tl->logic_analyzer->api->load(settings);
+			loaded = tl->logic_analyzer;
+		}
+		break;
+	case TOOL_DIGITALIO:
+		if (tl->dio) {
+			tl->dio->api->load(settings);
+			loaded = tl->dio;
+		}
+		break;
+	case TOOL_PATTERN_GENERATOR:
+		if (tl->pattern_generator) {
+			tl->pattern_generator->api->load(settings);
+			loaded = tl->pattern_generator;
+		}
+		break;
+	case TOOL_NETWORK_ANALYZER:
+		if (tl->network_analyzer) {
+			tl->network_analyzer->api->load(settings);
+			loaded = tl->network_analyzer;
+		}
+		break;
+	case TOOL_SPECTRUM_ANALYZER:
+		if (tl->spectrum_analyzer) {
+			tl->spectrum_analyzer->api->load(settings);
+			loaded = tl->spectrum_analyzer;
+		}
+		break;
+	default:
+		break;
+	}
+
+	if (loaded)
+		loaded->settingsLoaded();
 }
 
 bool ToolLauncher_API::enableExtern(bool en)
@@ -219,6 +334,13 @@ bool ToolLauncher_API::enableCalibScript(bool en)
 	return true;
 }
 
+QVariantMap ToolLauncher_API::benchmarkKernels(int size, int iterations)
+{
+	KernelBenchmark benchmark(std::max(size, 0), std::max(iterations, 0));
+
+	return benchmark.run();
+}
+
 bool ToolLauncher_API::reset()
 {
 	bool did_reconnect = false;
@@ -48,6 +48,18 @@ class ToolLauncher_API: public ApiObject
 
 	Q_PROPERTY(bool manual_calibration READ manual_calibration_enabled WRITE enable_manual_calibration)
 
+	/* See PerformanceMonitor, the values are those of the last second */
+	Q_PROPERTY(bool performance_monitor READ performanceMonitorEnabled
+		   WRITE enablePerformanceMonitor STORED false)
+	Q_PROPERTY(QVariantMap performance READ getPerformance STORED false)
+
+	/* The bytes of the buffers of each tool, see MemoryBudget */
+	Q_PROPERTY(QVariantMap memory_usage READ getMemoryUsage STORED false)
+
+	/* See PipelineTrace, turning it on starts a new trace */
+	Q_PROPERTY(bool pipeline_trace READ pipelineTraceEnabled
+		   WRITE enablePipelineTrace STORED false)
+
 public:
 	explicit ToolLauncher_API(ToolLauncher *tl) : ApiObject(), tl(tl) {}
 	~ToolLauncher_API() {}
@@ -67,6 +79,15 @@ public:
 	bool debugger_enabled();
 	void enable_debugger(bool);
 
+	bool performanceMonitorEnabled() const;
+	void enablePerformanceMonitor(bool);
+	QVariantMap getPerformance() const;
+
+	QVariantMap getMemoryUsage() const;
+
+	bool pipelineTraceEnabled() const;
+	void enablePipelineTrace(bool);
+
 	bool manual_calibration_enabled() const;
 	void enable_manual_calibration(bool);
 
@@ -104,11 +125,22 @@ public:
 	Q_INVOKABLE void disconnect();
 
 	Q_INVOKABLE void load(const QString& file);
+	void loadTool(enum tool tool, const QString& file);
 	Q_INVOKABLE void save(const QString& file);
 	Q_INVOKABLE bool reset();
 	Q_INVOKABLE bool enableExtern(bool);
 	Q_INVOKABLE bool enableCalibScript(bool);
 
+	/* Mean time of one call, in us, of the DSP and storage routines
+	 * on inputs of the given size; see KernelBenchmark */
+	Q_INVOKABLE QVariantMap benchmarkKernels(int size = 65536,
+						 int iterations = 100);
+
+	Q_INVOKABLE void showPerformancePanel();
+
+	/* Writes the pipeline trace as a Chrome trace JSON file */
+	Q_INVOKABLE bool dumpPipelineTrace(const QString& file);
+
 private:
 	ToolLauncher *tl;
 };
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "trend_store.hpp"
+
+#include <algorithm>
+
+using namespace adiscope;
+
+TrendStore::TrendStore(unsigned int points, unsigned int factor,
+		       unsigned int levels) :
+	nb_points(points), aggr_factor(std::max(factor, 2u))
+{
+	levels = std::max(levels, 1u);
+
+	means.resize(levels);
+	mins.resize(levels);
+	maxs.resize(levels);
+	pending.resize(levels);
+
+	for (unsigned int i = 0; i < levels; i++) {
+		means[i].setCapacity(points);
+
+		if (i > 0) {
+			mins[i].setCapacity(points);
+			maxs[i].setCapacity(points);
+		}
+	}
+
+	clear();
+}
+
+void TrendStore::clear()
+{
+	for (unsigned int i = 0; i < levels(); i++) {
+		means[i].clear();
+		mins[i].clear();
+		maxs[i].clear();
+		pending[i] = Accumulator{0.0, 0.0, 0.0, 0};
+	}
+}
+
+void TrendStore::push(double sample)
+{
+	means[0].push(sample);
+
+	if (levels() > 1)
+		aggregate(1, sample, sample, sample);
+}
+
+void TrendStore::aggregate(unsigned int level, double min, double max,
+			   double mean)
+{
+	Accumulator& acc = pending[level];
+
+	if (acc.count == 0) {
+		acc.min = min;
+		acc.max = max;
+		acc.sum = 0.0;
+	} else {
+		acc.min = std::min(acc.min, min);
+		acc.max = std::max(acc.max, max);
+	}
+
+	acc.sum += mean;
+
+	if (++acc.count < aggr_factor)
+		return;
+
+	double level_mean = acc.sum / acc.count;
+
+	mins[level].push(acc.min);
+	maxs[level].push(acc.max);
+	means[level].push(level_mean);
+	acc.count = 0;
+
+	if (level + 1 < levels())
+		aggregate(level + 1, acc.min, acc.max, level_mean);
+}
+
+unsigned long long TrendStore::span(unsigned int level) const
+{
+	unsigned long long samples = 1;
+
+	for (unsigned int i = 0; i < level; i++)
+		samples *= aggr_factor;
+
+	return samples;
+}
+
+unsigned int TrendStore::levelFor(unsigned long long samples) const
+{
+	for (unsigned int i = 0; i < levels(); i++) {
+		if (samples <= nb_points * span(i))
+			return i;
+	}
+
+	return levels() - 1;
+}
+
+const RingBuffer<double>& TrendStore::min(unsigned int level) const
+{
+	return level ? mins[level] : means[0];
+}
+
+const RingBuffer<double>& TrendStore::max(unsigned int level) const
+{
+	return level ? maxs[level] : means[0];
+}
+
+const RingBuffer<double>& TrendStore::mean(unsigned int level) const
+{
+	return means[level];
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TREND_STORE_HPP
+#define TREND_STORE_HPP
+
+#include <vector>
+
+#include "ring_buffer.hpp"
+
+namespace adiscope {
+
+/*
+ * History of a slow signal (e.g. DMM readings) over hours or days, in
+ * constant memory.
+ *
+ * Level 0 keeps the last points() raw samples. Each level above holds
+ * points() aggregates, each one the min, max and mean of factor()
+ * consecutive entries of the level below, so level k reaches back
+ * points() * factor()^k samples.
+ */
+class TrendStore
+{
+public:
+	TrendStore(unsigned int points, unsigned int factor,
+		   unsigned int levels);
+
+	void push(double sample);
+	void clear();
+
+	unsigned int points() const { return nb_points; }
+	unsigned int factor() const { return aggr_factor; }
+	unsigned int levels() const { return (unsigned int) mins.size(); }
+
+	/* Samples per entry of the given level */
+	unsigned long long span(unsigned int level) const;
+
+	/* The lowest level able to show the given number of samples in
+	 * points() entries, the highest one if none can */
+	unsigned int levelFor(unsigned long long samples) const;
+
+	/* The entries of a level, oldest first. At level 0 the three of
+	 * them are the raw samples. */
+	const RingBuffer<double>& min(unsigned int level) const;
+	const RingBuffer<double>& max(unsigned int level) const;
+	const RingBuffer<double>& mean(unsigned int level) const;
+
+private:
+	struct Accumulator {
+		double min, max, sum;
+		unsigned int count;
+	};
+
+	void aggregate(unsigned int level, double min, double max,
+		       double mean);
+
+	unsigned int nb_points;
+	unsigned int aggr_factor;
+
+	/* Index 0 is the raw level, its min and max are not used */
+	std::vector<RingBuffer<double>> mins, maxs, means;
+	std::vector<Accumulator> pending;
+};
+}
+
+#endif /* TREND_STORE_HPP */
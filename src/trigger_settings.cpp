@@ -42,6 +42,7 @@ struct TriggerSettings::trigg_channel_config {
 	double hyst_step;
 	double hyst_val;
 	double dc_level;
+	int condition;
 };
 
 const std::vector<std::pair<std::string, HardwareTrigger::out_select>> TriggerSettings::externalTriggerOutMapping = {
@@ -57,6 +58,7 @@ TriggerSettings::TriggerSettings(std::shared_ptr<GenericAdc> adc,
 	adc(adc),
 	trigger(adc->getTrigger()),
 	current_channel(0),
+	source_combination(HardwareTrigger::COMBINE_NONE),
 	temporarily_disabled(false),
 	adc_running(false),
 	trigger_raw_delay(0),
@@ -66,6 +68,7 @@ TriggerSettings::TriggerSettings(std::shared_ptr<GenericAdc> adc,
 
 	for (uint i = 0; i < trigger->numChannels(); i++) {
 		struct trigg_channel_config config = {};
+		config.hyst_val = 50e-3;
 		trigg_configs.push_back(config);
 	}
 
@@ -89,6 +92,12 @@ TriggerSettings::TriggerSettings(std::shared_ptr<GenericAdc> adc,
 		ui->cmb_source->addItem(QString("Channel %1").arg(i + 1));
 	}
 
+	// The device only combines two channels
+	if (trigger->numChannels() != 2) {
+		ui->lbl_source_logic->setVisible(false);
+		ui->cmb_source_logic->setVisible(false);
+	}
+
 	trigger_auto_mode = ui->btnTrigger->isChecked();
 
 	auto m2k_adc = dynamic_pointer_cast<M2kAdc>(adc);
@@ -194,6 +203,11 @@ long long TriggerSettings::triggerDelay() const
 	return trigger_raw_delay;
 }
 
+HardwareTrigger::combination TriggerSettings::sourceCombination() const
+{
+	return source_combination;
+}
+
 double TriggerSettings::dcLevel() const
 {
 	return trigg_configs[current_channel].dc_level;
@@ -277,6 +291,14 @@ void TriggerSettings::on_cmb_source_currentIndexChanged(int index)
 	Q_EMIT sourceChanged(index);
 }
 
+void TriggerSettings::on_cmb_source_logic_currentIndexChanged(int index)
+{
+	source_combination = static_cast<HardwareTrigger::combination>(index);
+
+	if (adc_running)
+		write_ui_settings_to_hawrdware();
+}
+
 void TriggerSettings::onSpinboxTriggerLevelChanged(double value)
 {
 	level_hw_write(value);
@@ -292,6 +314,7 @@ void TriggerSettings::onSpinboxTriggerHystChanged(double value)
 
 void TriggerSettings::on_cmb_condition_currentIndexChanged(int index)
 {
+	trigg_configs[current_channel].condition = index;
 	analog_cond_hw_write(index);
 }
 
@@ -388,13 +411,7 @@ void TriggerSettings::on_cmb_analog_extern_currentIndexChanged(int index)
 		int n = static_cast<int>(HardwareTrigger::DIGITAL) + 1;
 
 		mode = static_cast<HardwareTrigger::mode>(n + index);
-		try {
-			trigger->setTriggerMode(current_channel, mode);
-		}
-		catch (std::exception& e)
-		{
-			qDebug() << e.what();
-		}
+		mode_hw_write(mode);
 	}
 }
 
@@ -535,6 +552,7 @@ void TriggerSettings::write_ui_settings_to_hawrdware()
 	level_hw_write(trigger_level->value());
 	hysteresis_hw_write(trigger_hysteresis->value());
 	delay_hw_write(trigger_raw_delay + daisyChainCompensation);
+	other_channels_hw_write();
 }
 
 void TriggerSettings::setupExternalTriggerDirection()
@@ -627,8 +645,15 @@ void TriggerSettings:: mode_hw_write(int mode)
 {
 	if (adc_running) {
 		try {
-			trigger->setTriggerMode(current_channel,
-				static_cast<HardwareTrigger::mode>(mode));
+			// Combined channels share the mode of the source
+			for (uint i = 0; i < trigger->numChannels(); i++) {
+				if (i == (uint)current_channel ||
+						source_combination !=
+						HardwareTrigger::COMBINE_NONE) {
+					trigger->setTriggerMode(i,
+						static_cast<HardwareTrigger::mode>(mode));
+				}
+			}
 		}
 		catch (std::exception& e)
 		{
@@ -650,6 +675,12 @@ void TriggerSettings::source_hw_write(int source)
 {
 	if (adc_running) {
 		try {
+			// Combinations are between the analog conditions
+			if (source_combination != HardwareTrigger::COMBINE_NONE &&
+					ui->intern_en->isChecked()) {
+				trigger->setSourceCombination(source_combination);
+				return;
+			}
 			trigger->setSourceChannel(source,
 						  ui->intern_en->isChecked(), // analog trigger on
 						  (ui->extern_en->isChecked() && ui->cmb_extern_src->currentIndex()==0)); // extern trigger on & ext trigger in
@@ -660,6 +691,45 @@ void TriggerSettings::source_hw_write(int source)
 	}
 }
 
+/*
+ * When the channels are combined the others take part in the trigger as
+ * well, with the settings they had when they were last the source.
+ */
+void TriggerSettings::other_channels_hw_write()
+{
+	if (!adc_running || source_combination == HardwareTrigger::COMBINE_NONE)
+		return;
+
+	// There is one external trigger, all of them see it the same way
+	HardwareTrigger::condition digital_cond =
+		(ui->cmb_extern_src->currentIndex() == 0) ?
+		static_cast<HardwareTrigger::condition>(
+			ui->cmb_extern_condition->currentIndex()) :
+		HardwareTrigger::FALLING_EDGE;
+
+	for (int i = 0; i < trigg_configs.size(); i++) {
+		if (i == current_channel)
+			continue;
+
+		const trigg_channel_config &config = trigg_configs[i];
+
+		try {
+			trigger->setLevel(i, (int)adc->convVoltsToSample(i,
+				config.level_val));
+			trigger->setHysteresis(i,
+				(int)adc->convVoltsDiffToSampleDiff(i,
+					config.hyst_val));
+			trigger->setAnalogCondition(i,
+				static_cast<HardwareTrigger::condition>(
+					config.condition));
+			trigger->setDigitalCondition(i, digital_cond);
+		}
+		catch (std::exception& e) {
+			qDebug() << e.what();
+		}
+	}
+}
+
 void adiscope::TriggerSettings::on_spin_daisyChain_valueChanged(int arg1)
 {
     setTriggerDelay(trigger_raw_delay);
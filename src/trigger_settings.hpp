@@ -73,6 +73,7 @@ namespace adiscope {
 		bool triggerIsArmed() const;
 		enum TriggerMode triggerMode() const;
 		long long triggerDelay() const;
+		HardwareTrigger::combination sourceCombination() const;
 		void setDcLevelCoupled(double);
 		void setAcCoupled(bool, int);
 
@@ -109,6 +110,7 @@ namespace adiscope {
 		void on_cmb_extern_condition_currentIndexChanged(int);
 		void on_intern_en_toggled(bool);
 		void on_cmb_source_currentIndexChanged(int);
+		void on_cmb_source_logic_currentIndexChanged(int);
 		void on_extern_en_toggled(bool);
 		void on_extern_to_en_toggled(bool);
 		void on_cmb_analog_extern_currentIndexChanged(int);
@@ -127,6 +129,7 @@ namespace adiscope {
 		void digital_cond_hw_write(int cond);
 		void mode_hw_write(int mode);
 		void source_hw_write(int source);
+		void other_channels_hw_write();
 
 		void ui_reconf_on_intern_toggled(bool);
 		void ui_reconf_on_extern_toggled(bool);
@@ -149,6 +152,7 @@ namespace adiscope {
 		PositionSpinButton *trigger_level;
 		PositionSpinButton *trigger_hysteresis;
 		int current_channel;
+		HardwareTrigger::combination source_combination;
 		bool temporarily_disabled;
 		bool trigger_auto_mode;
 		long long trigger_raw_delay;
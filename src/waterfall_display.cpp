@@ -0,0 +1,173 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "waterfall_display.h"
+
+#include <QPainter>
+
+#include <algorithm>
+
+using namespace adiscope;
+
+/* A row never needs more columns than a screen has pixels */
+static const uint max_columns = 2048;
+
+WaterfallDisplay::WaterfallDisplay(QWidget *parent) :
+	QWidget(parent),
+	m_history(256),
+	m_newest(-1),
+	m_rows(0),
+	m_min(-200),
+	m_max(0)
+{
+	// Dark blue to cyan to yellow to red
+	const QColor stops[] = { QColor(0x14, 0x14, 0x16), QColor(0, 0, 160),
+		QColor(0, 200, 220), QColor(240, 230, 0), QColor(230, 20, 20) };
+	const int nb_stops = sizeof(stops) / sizeof(stops[0]);
+
+	m_colors.resize(256);
+	for (int i = 0; i < m_colors.size(); i++) {
+		double pos = (double)i / (m_colors.size() - 1) * (nb_stops - 1);
+		int s = std::min((int)pos, nb_stops - 2);
+		double t = pos - s;
+
+		m_colors[i] = qRgb(
+			stops[s].red() + t * (stops[s + 1].red() - stops[s].red()),
+			stops[s].green() + t * (stops[s + 1].green() - stops[s].green()),
+			stops[s].blue() + t * (stops[s + 1].blue() - stops[s].blue()));
+	}
+
+	setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+WaterfallDisplay::~WaterfallDisplay()
+{
+}
+
+uint WaterfallDisplay::history() const
+{
+	return m_history;
+}
+
+void WaterfallDisplay::setHistory(uint rows)
+{
+	rows = std::max(1u, rows);
+
+	if (rows == m_history) {
+		return;
+	}
+
+	m_history = rows;
+	m_image = QImage();
+	clear();
+}
+
+void WaterfallDisplay::setMagnitudeRange(double min, double max)
+{
+	if (max <= min) {
+		return;
+	}
+
+	// Only the rows drawn from now on use the new range
+	m_min = min;
+	m_max = max;
+}
+
+void WaterfallDisplay::clear()
+{
+	m_newest = -1;
+	m_rows = 0;
+
+	if (!m_image.isNull()) {
+		m_image.fill(m_colors[0]);
+	}
+
+	update();
+}
+
+QRgb WaterfallDisplay::colorOf(double value) const
+{
+	double t = (value - m_min) / (m_max - m_min);
+	int idx = (int)(t * (m_colors.size() - 1));
+
+	return m_colors[std::max(0, std::min(idx, m_colors.size() - 1))];
+}
+
+void WaterfallDisplay::addRow(const double *data, uint num_points)
+{
+	if (!num_points) {
+		return;
+	}
+
+	uint columns = std::min(num_points, max_columns);
+
+	if (m_image.width() != (int)columns ||
+			m_image.height() != (int)m_history) {
+		m_image = QImage(columns, m_history, QImage::Format_RGB32);
+		m_image.fill(m_colors[0]);
+		m_newest = -1;
+		m_rows = 0;
+	}
+
+	// Rows are filled upwards, so from the newest one down the image
+	// reads newest to oldest before wrapping to row 0
+	m_newest = (m_newest <= 0) ? m_history - 1 : m_newest - 1;
+	m_rows = std::min(m_rows + 1, m_history);
+
+	QRgb *line = reinterpret_cast<QRgb *>(m_image.scanLine(m_newest));
+
+	// Several bins per column keep their highest value, so narrow
+	// emissions stay visible
+	for (uint c = 0; c < columns; c++) {
+		uint first = (uint64_t)c * num_points / columns;
+		uint last = std::max(first + 1,
+				(uint)((uint64_t)(c + 1) * num_points / columns));
+
+		line[c] = colorOf(*std::max_element(data + first, data + last));
+	}
+
+	update();
+}
+
+void WaterfallDisplay::paintEvent(QPaintEvent *event)
+{
+	Q_UNUSED(event);
+
+	QPainter painter(this);
+
+	painter.fillRect(rect(), m_colors[0]);
+
+	if (m_image.isNull() || !m_rows) {
+		return;
+	}
+
+	// The ring in two blits: newest..end on top, then 0..newest
+	double row_height = (double)height() / m_history;
+	int w = m_image.width();
+	int top_rows = m_history - m_newest;
+
+	painter.drawImage(QRectF(0, 0, width(), top_rows * row_height),
+			m_image, QRectF(0, m_newest, w, top_rows));
+
+	if (m_rows == m_history && m_newest > 0) {
+		painter.drawImage(QRectF(0, top_rows * row_height, width(),
+				m_newest * row_height),
+				m_image, QRectF(0, 0, w, m_newest));
+	}
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef WATERFALL_DISPLAY_H
+#define WATERFALL_DISPLAY_H
+
+#include <QImage>
+#include <QVector>
+#include <QWidget>
+
+namespace adiscope {
+/*
+ * Spectrogram of the last history() traces, newest on top. Each trace
+ * is drawn once into one row of a circular image, so adding a trace
+ * only updates that row and painting only blits the two halves of the
+ * ring.
+ */
+class WaterfallDisplay : public QWidget
+{
+	Q_OBJECT
+
+public:
+	explicit WaterfallDisplay(QWidget *parent = nullptr);
+	~WaterfallDisplay();
+
+	uint history() const;
+	void setHistory(uint rows);
+
+	void setMagnitudeRange(double min, double max);
+
+	void addRow(const double *data, uint num_points);
+	void clear();
+
+protected:
+	void paintEvent(QPaintEvent *event);
+
+private:
+	QRgb colorOf(double value) const;
+
+	QImage m_image;
+	QVector<QRgb> m_colors;
+	uint m_history;
+	int m_newest;
+	uint m_rows;
+	double m_min;
+	double m_max;
+};
+}
+
+#endif // WATERFALL_DISPLAY_H
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "waveform_averager.h"
+
+#include <volk/volk.h>
+
+#include <algorithm>
+#include <string.h>
+
+using namespace adiscope;
+
+WaveformAverager::WaveformAverager() :
+	d_mode(NORMAL),
+	d_count(1),
+	d_frames(0),
+	d_size(0)
+{
+}
+
+WaveformAverager::~WaveformAverager()
+{
+	_free_sums();
+}
+
+void WaveformAverager::configure(Mode mode, unsigned int count)
+{
+	d_mode = mode;
+	d_count = std::max(count, 1u);
+	clear();
+}
+
+void WaveformAverager::clear()
+{
+	d_frames = 0;
+}
+
+unsigned int WaveformAverager::frames() const
+{
+	return d_frames;
+}
+
+void WaveformAverager::_free_sums()
+{
+	for (auto sum : d_sums) {
+		volk_free(sum);
+	}
+	d_sums.clear();
+	d_size = 0;
+}
+
+void WaveformAverager::process(const std::vector<float *> &channels,
+		int nitems)
+{
+	if (nitems <= 0 || d_count < 2) {
+		return;
+	}
+
+	switch (d_mode) {
+	case AVERAGE:
+		_average(channels, nitems);
+		break;
+	case HIGH_RES:
+		_high_res(channels, nitems);
+		break;
+	default:
+		break;
+	}
+}
+
+void WaveformAverager::_average(const std::vector<float *> &channels,
+		int nitems)
+{
+	if (nitems != d_size || channels.size() != d_sums.size()) {
+		_free_sums();
+		for (size_t n = 0; n < channels.size(); n++) {
+			d_sums.push_back((float *)volk_malloc(
+					nitems * sizeof(float),
+					volk_get_alignment()));
+		}
+		d_size = nitems;
+		d_frames = 0;
+	}
+
+	unsigned int frames = d_frames;
+
+	for (size_t n = 0; n < channels.size(); n++) {
+		float *sum = d_sums[n];
+		float *frame = channels[n];
+
+		if (!frames) {
+			memcpy(sum, frame, nitems * sizeof(float));
+		} else {
+			// Once full, the oldest share of the sum makes room
+			// for the new frame
+			if (frames == d_count) {
+				volk_32f_s32f_multiply_32f(sum, sum,
+						(float)(d_count - 1) / d_count,
+						nitems);
+			}
+			volk_32f_x2_add_32f(sum, sum, frame, nitems);
+		}
+	}
+
+	if (frames < d_count) {
+		frames++;
+	}
+	d_frames = frames;
+
+	for (size_t n = 0; n < channels.size(); n++) {
+		volk_32f_s32f_multiply_32f(channels[n], d_sums[n],
+				1.0f / frames, nitems);
+	}
+}
+
+void WaveformAverager::_high_res(const std::vector<float *> &channels,
+		int nitems)
+{
+	// The window is cut short at the edges of the frame
+	const int before = (d_count - 1) / 2;
+	const int after = d_count - 1 - before;
+
+	d_scratch.resize(nitems);
+
+	for (auto frame : channels) {
+		// The running sum is kept in double, a float one would drift
+		// over a long frame
+		double sum = 0.0;
+		int lo = 0, hi = 0;
+
+		for (int i = 0; i < nitems; i++) {
+			int first = std::max(i - before, 0);
+			int last = std::min(i + after + 1, nitems);
+
+			while (hi < last) {
+				sum += frame[hi++];
+			}
+			while (lo < first) {
+				sum -= frame[lo++];
+			}
+			d_scratch[i] = sum / (hi - lo);
+		}
+
+		memcpy(frame, d_scratch.data(), nitems * sizeof(float));
+	}
+
+	d_frames = 1;
+}
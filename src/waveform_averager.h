@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2019 Analog Devices Inc.
+ *
+ * This file is part of Scopy
+ * (see http://www.github.com/analogdevicesinc/scopy).
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAVEFORM_AVERAGER_H
+#define WAVEFORM_AVERAGER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <vector>
+
+namespace adiscope {
+
+/*
+ * Acquisition modes applied to the complete frames of a sink before they
+ * are measured or plotted.
+ *
+ * AVERAGE keeps a running sum of the frames of each channel: the first
+ * count frames are summed up, then each new frame replaces 1/count of the
+ * sum, so the shown frame is the average of the last ~count frames.
+ * Made for a triggered repetitive signal, the frames have to line up.
+ *
+ * HIGH_RES replaces each sample with the mean of the count samples
+ * around it (boxcar), which trades bandwidth for resolution within a
+ * single frame.
+ */
+class WaveformAverager
+{
+public:
+	enum Mode {
+		NORMAL = 0,
+		AVERAGE = 1,
+		HIGH_RES = 2,
+	};
+
+	WaveformAverager();
+	~WaveformAverager();
+
+	/* Changing either starts over */
+	void configure(Mode mode, unsigned int count);
+	Mode mode() const { return d_mode; }
+	unsigned int count() const { return d_count; }
+
+	void clear();
+
+	/* Replaces the nitems samples of each channel in place. A frame
+	 * of another size or channel count starts over. */
+	void process(const std::vector<float *> &channels, int nitems);
+
+	/* Frames currently in the average */
+	unsigned int frames() const;
+
+private:
+	Mode d_mode;
+	unsigned int d_count;
+	std::atomic<unsigned int> d_frames;
+
+	/* One volk aligned sum per channel */
+	std::vector<float *> d_sums;
+	int d_size;
+
+	/* Scratch space of the boxcar */
+	std::vector<float> d_scratch;
+
+	void _free_sums();
+	void _average(const std::vector<float *> &channels, int nitems);
+	void _high_res(const std::vector<float *> &channels, int nitems);
+
+	WaveformAverager(const WaveformAverager &) = delete;
+	WaveformAverager &operator=(const WaveformAverager &) = delete;
+};
+}
+
+#endif // WAVEFORM_AVERAGER_H
@@ -50,9 +50,14 @@
 #include <qapplication.h>
 #include <gnuradio/filter/firdes.h>
 
+#include "frame_listener.h"
+
 namespace adiscope {
 
-    class xy_sink_c : virtual public gr::sync_block
+    class PersistenceMap;
+
+    class xy_sink_c : virtual public gr::sync_block,
+                      public frame_listener
     {
     public:
       // gr::qtgui::xy_sink_c::sptr
@@ -71,6 +76,24 @@ namespace adiscope {
       virtual int nsamps() const = 0;
       virtual void reset() = 0;
 
+      /* As a frame_listener, plot channel y of the frames against
+       * channel x (on every input) */
+      virtual void set_frame_channels(int x, int y) = 0;
+
+      /* Density mode: every complete frame, plotted or not, gets
+       * binned into maps[n] for input n and the plot only gets told to
+       * repaint them, instead of receiving the points; without
+       * accumulate a frame replaces the previous ones. An empty vector
+       * gets back to the points. */
+      virtual void set_density(
+		      const std::vector< std::shared_ptr<PersistenceMap> > &maps,
+		      bool accumulate) = 0;
+
+      /* Whether the plot can be seen; while it can't, nothing is posted
+       * to it and only the accumulating density maps are kept up. On by
+       * default. */
+      virtual void set_displayed(bool displayed) = 0;
+
       QApplication *d_qApplication;
     };
 
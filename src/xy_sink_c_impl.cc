@@ -51,6 +51,8 @@
 
 #include "xy_sink_c_impl.h"
 #include"spectrumUpdateEvents.h"
+#include "persistence_map.h"
+#include "pipeline_trace.hpp"
 
 using namespace gr;
 
@@ -74,7 +76,9 @@ namespace adiscope {
 		   io_signature::make(nconnections, nconnections, sizeof(gr_complex)),
 		   io_signature::make(0, 0, 0)),
 	d_size(size), d_buffer_size(2*size), d_name(name),
-	d_nconnections(nconnections), d_index(0), d_start(0), d_end(size)
+	d_nconnections(nconnections), d_index(0), d_start(0), d_end(size),
+	d_frame_x(0), d_frame_y(1), d_density_accumulate(false),
+	d_displayed(true)
     {
 
       for(int i = 0; i < d_nconnections; i++) {
@@ -93,6 +97,7 @@ namespace adiscope {
 
       initialize();
       this->plot = (ConstellationDisplayPlot*)plot;
+      d_frames = std::make_shared<PlotFrameHandoff>();
    }
 
     xy_sink_c_impl::~xy_sink_c_impl()
@@ -193,11 +198,97 @@ namespace adiscope {
     {
     }
 
+    void
+    xy_sink_c_impl::set_frame_channels(int x, int y)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_frame_x = x;
+      d_frame_y = y;
+    }
+
+    void
+    xy_sink_c_impl::set_density(
+		    const std::vector< std::shared_ptr<PersistenceMap> > &maps,
+		    bool accumulate)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+      d_density = maps;
+      d_density_accumulate = accumulate;
+    }
+
+    void
+    xy_sink_c_impl::set_displayed(bool displayed)
+    {
+      d_displayed = displayed;
+    }
+
+    void
+    xy_sink_c_impl::_post_density()
+    {
+      // The maps are read when painting, a replot is all it takes
+      if(d_displayed &&
+         gr::high_res_timer_now() - d_last_time > d_update_time) {
+        d_last_time = gr::high_res_timer_now();
+
+        if (d_qApplication)
+          QMetaObject::invokeMethod(plot, "replot", Qt::QueuedConnection);
+      }
+    }
+
+    void
+    xy_sink_c_impl::frame_ready(const std::vector<const float *> &channels,
+                                int nitems)
+    {
+      gr::thread::scoped_lock lock(d_setlock);
+
+      if(d_frame_x < 0 || d_frame_y < 0 ||
+         d_frame_x >= (int)channels.size() ||
+         d_frame_y >= (int)channels.size()) {
+        return;
+      }
+
+      // A map that doesn't add up is only good for being shown
+      if(!d_density.empty() && !d_displayed && !d_density_accumulate) {
+        return;
+      }
+
+      if(!d_density.empty()) {
+        for(size_t n = 0; n < d_density.size(); n++) {
+          d_density[n]->accumulateXY(channels[d_frame_x], channels[d_frame_y],
+                                   nitems, !d_density_accumulate);
+        }
+        _post_density();
+        return;
+      }
+
+      if(!d_displayed ||
+         gr::high_res_timer_now() - d_last_time <= d_update_time) {
+        return;
+      }
+      d_last_time = gr::high_res_timer_now();
+
+      // Same layout as the frames from work(), real parts first
+      std::vector< std::vector<double> > &frame = d_frames->write_buffer();
+      frame.resize(2 * d_nconnections);
+      for(int n = 0; n < d_nconnections; n++) {
+        frame[n].resize(nitems);
+        volk_32f_convert_64f_u(frame[n].data(), channels[d_frame_x], nitems);
+        frame[d_nconnections + n].resize(nitems);
+        volk_32f_convert_64f_u(frame[d_nconnections + n].data(),
+                               channels[d_frame_y], nitems);
+      }
+
+      if (d_frames->publish() && d_qApplication)
+        d_qApplication->postEvent(plot, new ConstUpdateEvent(d_frames));
+    }
+
     int
     xy_sink_c_impl::work(int noutput_items,
 			    gr_vector_const_void_star &input_items,
 			    gr_vector_void_star &output_items)
     {
+      PIPELINE_TRACE("xy_sink_c work");
+
       int n=0;
       const gr_complex *in;
 
@@ -224,14 +315,34 @@ namespace adiscope {
           memmove(d_residbufs_imag[n], &d_residbufs_imag[n][d_start], d_size*sizeof(double));
         }
 
-        // Plot if we are able to update
-        if(gr::high_res_timer_now() - d_last_time > d_update_time) {
+        // Plot if we are able to update, the density maps or the points.
+        // The real parts go first in the frame, followed by the
+        // imaginary ones.
+        if(!d_density.empty() && !d_displayed && !d_density_accumulate) {
+          // Not shown, and not adding up either
+        } else if(!d_density.empty()) {
+          for(size_t n = 0; n < d_density.size() &&
+                      n < (size_t)d_nconnections; n++) {
+            d_density[n]->accumulateXY(d_residbufs_real[n],
+                                     d_residbufs_imag[n], d_size,
+                                     !d_density_accumulate);
+          }
+          _post_density();
+        } else if(d_displayed &&
+                  gr::high_res_timer_now() - d_last_time > d_update_time) {
           d_last_time = gr::high_res_timer_now();
-          if (d_qApplication)
+
+          std::vector< std::vector<double> > &frame = d_frames->write_buffer();
+          frame.resize(2 * d_nconnections);
+          for(n = 0; n < d_nconnections; n++) {
+            frame[n].assign(d_residbufs_real[n], d_residbufs_real[n] + d_size);
+            frame[d_nconnections + n].assign(d_residbufs_imag[n],
+                                             d_residbufs_imag[n] + d_size);
+          }
+
+          if (d_frames->publish() && d_qApplication)
 		d_qApplication->postEvent(plot,
-                                    new ConstUpdateEvent(d_residbufs_real,
-							 d_residbufs_imag,
-							 d_size));
+                                    new ConstUpdateEvent(d_frames));
         }
 
         // We've plotting, so reset the state
@@ -44,6 +44,8 @@
 
 #include <gnuradio/high_res_timer.h>
 
+#include <atomic>
+
 #include "xy_sink_c.h"
 #include "ConstellationDisplayPlot.h"
 
@@ -59,16 +61,23 @@ namespace adiscope {
       int d_nconnections;
 
       int d_index, d_start, d_end;
+      int d_frame_x, d_frame_y;
       std::vector<double*> d_residbufs_real;
       std::vector<double*> d_residbufs_imag;
 
       ConstellationDisplayPlot *plot;
+      std::shared_ptr<PlotFrameHandoff> d_frames;
+
+      std::vector< std::shared_ptr<PersistenceMap> > d_density;
+      bool d_density_accumulate;
+      std::atomic<bool> d_displayed;
 
       gr::high_res_timer_type d_update_time;
       gr::high_res_timer_type d_last_time;
 
       void _reset();
       void _npoints_resize();
+      void _post_density();
 
     public:
       xy_sink_c_impl(int size,
@@ -87,6 +96,16 @@ namespace adiscope {
       int nsamps() const;
       void reset();
 
+      void set_frame_channels(int x, int y);
+      void frame_ready(const std::vector<const float *> &channels,
+                       int nitems);
+
+      void set_density(
+		      const std::vector< std::shared_ptr<PersistenceMap> > &maps,
+		      bool accumulate);
+
+      void set_displayed(bool displayed);
+
       int work(int noutput_items,
 	       gr_vector_const_void_star &input_items,
 	       gr_vector_void_star &output_items);